@@ -12,6 +12,12 @@ msbuild func\source\vmon_func.vcxproj /p:Configuration=Release;Platform=Win32;Ta
 msbuild func\source\vmon_func.vcxproj /p:Configuration=Debug;Platform=x64;TargetOsVersion=Win7;EnableInf2cat=false
 msbuild func\source\vmon_func.vcxproj /p:Configuration=Release;Platform=x64;TargetOsVersion=Win7;EnableInf2cat=false
 
+set CWD=%CD%\pipeline\source
+cmd /c "call C:\WinDDK\7600.16385.1\bin\setenv.bat C:\WinDDK\7600.16385.1\  chk x86 WIN7 & cd /d %CWD% & build -cgz"
+cmd /c "call C:\WinDDK\7600.16385.1\bin\setenv.bat C:\WinDDK\7600.16385.1\  fre x86 WIN7 & cd /d %CWD% & build -cgz"
+cmd /c "call C:\WinDDK\7600.16385.1\bin\setenv.bat C:\WinDDK\7600.16385.1\  chk x64 WIN7 & cd /d %CWD% & build -cgz"
+cmd /c "call C:\WinDDK\7600.16385.1\bin\setenv.bat C:\WinDDK\7600.16385.1\  fre x64 WIN7 & cd /d %CWD% & build -cgz"
+
 set CWD=%CD%\notify\source
 cmd /c "call C:\WinDDK\7600.16385.1\bin\setenv.bat C:\WinDDK\7600.16385.1\  chk x86 WIN7 & cd /d %CWD% & build -cgz"
 cmd /c "call C:\WinDDK\7600.16385.1\bin\setenv.bat C:\WinDDK\7600.16385.1\  fre x86 WIN7 & cd /d %CWD% & build -cgz"
@@ -426,6 +426,7 @@ LJB_VMON_EvtDevicePrepareHardware(
     KeInitializeSpinLock(&dev_ctx->event_req_lock);
     InitializeListHead(&dev_ctx->event_req_list);
     KeInitializeSpinLock(&dev_ctx->ioctl_lock);
+    KeInitializeSpinLock(&dev_ctx->trace_lock);
 
     KdPrint((__FUNCTION__": entered\n"));
 
@@ -651,7 +652,9 @@ LJB_VMON_EvtDeviceContextCleanup(
     IN WDFDEVICE Device
     )
 {
-    UNREFERENCED_PARAMETER(Device);
+    LJB_VMON_CTX * CONST    dev_ctx = LJB_VMON_GetVMonCtx(Device);
+
+    LJB_VMON_TraceDeInit(dev_ctx);
 }
 
 /*++
@@ -31,29 +31,59 @@ LJB_VMON_GenericIoctl(
     NTSTATUS                                ntStatus;
     UINT                                    i;
     LJB_VMON_PRIMARY_SURFACE *              this_surface;
-
+    ULONG64                                 trace_start;
+    ULONG                                   trace_frame_id;
+    PVOID                                   trace_surface;
+    ULONG                                   edid_size;
+    UCHAR *                                 edid_block;
+    UCHAR                                   edid_checksum;
+
+    trace_start = LJB_VMON_TraceTimestamp(dev_ctx);
+    trace_frame_id = 0;
+    trace_surface = NULL;
     this_surface = NULL;
     *BytesReturned = 0;
     ntStatus = STATUS_NOT_SUPPORTED;
     switch (IoctlCode)
     {
     case LCI_PROXYKMD_GET_EDID:
-        if (OutputBufferSize < 128)
+        if (OutputBufferSize < EDID_BLOCK_SIZE)
         {
             LJB_VMON_Printf(dev_ctx, DBGLVL_ERROR,
                 (__FUNCTION__
                 ": OutputBufferSize(0x%x) too small, required 0x%x bytes?\n",
                 OutputBufferSize,
-                128
+                EDID_BLOCK_SIZE
                 ));
             ntStatus = STATUS_BUFFER_TOO_SMALL;
             break;
         }
+
+        /*
+         * as many whole blocks as fit, the base block at least. An EDID cut
+         * short has its base block say so: the extension count is that of
+         * the blocks returned, and the checksum made up for it.
+         */
+        edid_size = dev_ctx->EdidSize;
+        if (edid_size < EDID_BLOCK_SIZE)
+            edid_size = EDID_BLOCK_SIZE;
+        if (edid_size > OutputBufferSize)
+            edid_size = (ULONG) (OutputBufferSize - OutputBufferSize % EDID_BLOCK_SIZE);
         RtlCopyMemory(
             OutputBuffer,
             dev_ctx->EdidBlock,
-            128
+            edid_size
             );
+        edid_block = OutputBuffer;
+        if (edid_block[EDID_EXTENSION_COUNT] != edid_size / EDID_BLOCK_SIZE - 1)
+        {
+            edid_block[EDID_EXTENSION_COUNT] = (UCHAR) (edid_size / EDID_BLOCK_SIZE - 1);
+            edid_checksum = 0;
+            for (i = 0; i < EDID_CHECKSUM; i++)
+                edid_checksum = (UCHAR) (edid_checksum + edid_block[i]);
+            edid_block[EDID_CHECKSUM] = (UCHAR) (0x100 - edid_checksum);
+        }
+        *BytesReturned = edid_size;
         ntStatus = STATUS_SUCCESS;
         break;
 
@@ -71,6 +101,7 @@ LJB_VMON_GenericIoctl(
         }
 
         pCreateData = InputBuffer;
+        trace_surface = pCreateData->hPrimarySurface;
         for (i = 0; i < NUM_OF_BUFFERS_PER_SURFACE; i++)
         {
             primary_surface = LJB_VMON_GetPoolZero(sizeof(*primary_surface));
@@ -128,6 +159,7 @@ LJB_VMON_GenericIoctl(
          * Locate primary_surface with matched hPrimarySurface
          */
         destroy_data = InputBuffer;
+        trace_surface = destroy_data->hPrimarySurface;
         list_head = &dev_ctx->surface_list;
         primary_surface = NULL;
         next_entry = NULL;
@@ -192,6 +224,8 @@ LJB_VMON_GenericIoctl(
         }
 
         surface_update = InputBuffer;
+        trace_frame_id = surface_update->FrameId;
+        trace_surface = surface_update->hPrimarySurface;
         KeAcquireSpinLock(&dev_ctx->ioctl_lock, &old_irql_ioctl);
         dev_ctx->LatestFrameId = surface_update->FrameId;
         dev_ctx->hLatestPrimarySurface = surface_update->hPrimarySurface;
@@ -253,6 +287,15 @@ LJB_VMON_GenericIoctl(
                 STATUS_SUCCESS,
                 sizeof(*out_event_data)
                 );
+            LJB_VMON_TraceEvent(
+                dev_ctx,
+                LJB_VMON_TRACE_WAIT_COMPLETE,
+                IoctlCode,
+                trace_frame_id,
+                trace_surface,
+                0,
+                STATUS_SUCCESS
+                );
             LJB_VMON_FreePool(wait_event_req);
         } while (wait_event_req != NULL);
         KeReleaseSpinLock(&dev_ctx->ioctl_lock, old_irql_ioctl);
@@ -484,6 +527,15 @@ LJB_VMON_GenericIoctl(
                 STATUS_SUCCESS,
                 sizeof(*out_event_data)
                 );
+            LJB_VMON_TraceEvent(
+                dev_ctx,
+                LJB_VMON_TRACE_WAIT_COMPLETE,
+                IoctlCode,
+                0,
+                NULL,
+                0,
+                STATUS_SUCCESS
+                );
             LJB_VMON_FreePool(wait_event_req);
         } while (wait_event_req != NULL);
         break;
@@ -561,6 +613,15 @@ LJB_VMON_GenericIoctl(
                 STATUS_SUCCESS,
                 sizeof(*out_event_data)
                 );
+            LJB_VMON_TraceEvent(
+                dev_ctx,
+                LJB_VMON_TRACE_WAIT_COMPLETE,
+                IoctlCode,
+                0,
+                NULL,
+                0,
+                STATUS_SUCCESS
+                );
             LJB_VMON_FreePool(wait_event_req);
         } while (wait_event_req != NULL);
         break;
@@ -569,5 +630,14 @@ LJB_VMON_GenericIoctl(
         break;
     }
 
+    LJB_VMON_TraceEvent(
+        dev_ctx,
+        LJB_VMON_TRACE_NOTIFY,
+        IoctlCode,
+        trace_frame_id,
+        trace_surface,
+        trace_start,
+        ntStatus
+        );
     return ntStatus;
 }
\ No newline at end of file
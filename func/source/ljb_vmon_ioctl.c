@@ -38,6 +38,8 @@ LJB_VMON_EvtIoDeviceControl(
     WDFDEVICE               Device = WdfIoQueueGetDevice(Queue);
     LJB_VMON_CTX * CONST    dev_ctx = LJB_VMON_GetVMonCtx(Device);
     UCHAR *                 edid_block;
+    UCHAR                   edid_checksum;
+    ULONG                   i;
     NTSTATUS                ntStatus= STATUS_SUCCESS;
     ULONG                   bytes_written = 0;
 
@@ -46,7 +48,7 @@ LJB_VMON_EvtIoDeviceControl(
     switch (IoControlCode)
     {
     case IOCTL_LJB_VMON_PLUGIN_MONITOR:
-        if (input_buffer_length < 128)
+        if (input_buffer_length < EDID_BLOCK_SIZE)
         {
             LJB_VMON_Printf(dev_ctx, DBGLVL_ERROR,
                 (__FUNCTION__
@@ -56,10 +58,21 @@ LJB_VMON_EvtIoDeviceControl(
             ntStatus = STATUS_BUFFER_TOO_SMALL;
             break;
         }
+        if (input_buffer_length > sizeof(dev_ctx->EdidBlock) ||
+            input_buffer_length % EDID_BLOCK_SIZE != 0)
+        {
+            LJB_VMON_Printf(dev_ctx, DBGLVL_ERROR,
+                (__FUNCTION__
+                ": input_buffer_length(%u) not whole EDID blocks?\n",
+                input_buffer_length
+                ));
+            ntStatus = STATUS_INVALID_PARAMETER;
+            break;
+        }
 
         ntStatus = WdfRequestRetrieveInputBuffer(
             Request,
-            128,
+            input_buffer_length,
             &edid_block,
             NULL);
 
@@ -73,7 +86,36 @@ LJB_VMON_EvtIoDeviceControl(
             break;
         }
 
-        RtlCopyMemory(dev_ctx->EdidBlock, edid_block, 128);
+        /*
+         * the base block tells how many extensions follow it. Fewer is what
+         * a vmon.exe that sends only its 128-byte base block does; the base
+         * block is then made to say so, the extension count that of the
+         * blocks sent and the checksum made up for it, the way GET_EDID cuts
+         * an EDID short. More than the count says is an error.
+         */
+        if ((edid_block[EDID_EXTENSION_COUNT] + 1) * EDID_BLOCK_SIZE < input_buffer_length)
+        {
+            LJB_VMON_Printf(dev_ctx, DBGLVL_ERROR,
+                (__FUNCTION__
+                ": %u extension blocks in %u bytes?\n",
+                edid_block[EDID_EXTENSION_COUNT],
+                input_buffer_length
+                ));
+            ntStatus = STATUS_INVALID_PARAMETER;
+            break;
+        }
+
+        RtlCopyMemory(dev_ctx->EdidBlock, edid_block, input_buffer_length);
+        dev_ctx->EdidSize = (ULONG) input_buffer_length;
+        if (dev_ctx->EdidBlock[EDID_EXTENSION_COUNT] != input_buffer_length / EDID_BLOCK_SIZE - 1)
+        {
+            dev_ctx->EdidBlock[EDID_EXTENSION_COUNT] =
+                (UCHAR) (input_buffer_length / EDID_BLOCK_SIZE - 1);
+            edid_checksum = 0;
+            for (i = 0; i < EDID_CHECKSUM; i++)
+                edid_checksum = (UCHAR) (edid_checksum + dev_ctx->EdidBlock[i]);
+            dev_ctx->EdidBlock[EDID_CHECKSUM] = (UCHAR) (0x100 - edid_checksum);
+        }
         IoSetDeviceInterfaceState(
             &dev_ctx->lci_interface_path,
             TRUE);
@@ -81,7 +123,8 @@ LJB_VMON_EvtIoDeviceControl(
         break;
 
     case IOCTL_LJB_VMON_UNPLUG_MONITOR:
-        RtlZeroMemory(dev_ctx->EdidBlock, 128);
+        RtlZeroMemory(dev_ctx->EdidBlock, sizeof(dev_ctx->EdidBlock));
+        dev_ctx->EdidSize = 0;
         IoSetDeviceInterfaceState(
             &dev_ctx->lci_interface_path,
             FALSE);
@@ -128,6 +171,22 @@ LJB_VMON_EvtIoDeviceControl(
             output_buffer_length);
         return;
 
+    case IOCTL_LJB_VMON_TRACE_CONTROL:
+        LJB_VMON_TraceControl(
+            dev_ctx,
+            Request,
+            input_buffer_length,
+            output_buffer_length);
+        return;
+
+    case IOCTL_LJB_VMON_TRACE_DRAIN:
+        LJB_VMON_TraceDrain(
+            dev_ctx,
+            Request,
+            input_buffer_length,
+            output_buffer_length);
+        return;
+
     default:
         ntStatus = STATUS_INVALID_DEVICE_REQUEST;
         break;
@@ -154,7 +213,10 @@ LJB_VMON_WaitForMonitorEvent(
     NTSTATUS                    ntStatus = STATUS_SUCCESS;
     ULONG                       bytes_returned = 0;
     KIRQL                       old_irql_ioctl;
+    ULONG64                     trace_start;
+    ULONG                       trace_frame_id = 0;
 
+    trace_start = LJB_VMON_TraceTimestamp(dev_ctx);
     if (input_buffer_length < sizeof(LJB_VMON_MONITOR_EVENT))
     {
         LJB_VMON_Printf(dev_ctx, DBGLVL_ERROR,
@@ -278,6 +340,15 @@ LJB_VMON_WaitForMonitorEvent(
             output_event.Flags.PointerShapeChange = TRUE;
         }
     }
+
+    if (input_flags.PowerChange)
+    {
+        if (input_data->Powered != dev_ctx->Powered)
+        {
+            output_event.Flags.PowerChange = TRUE;
+            output_event.Powered = dev_ctx->Powered;
+        }
+    }
     KeReleaseSpinLock(&dev_ctx->ioctl_lock, old_irql_ioctl);
 
     if (output_event.Flags.Value != 0)
@@ -285,6 +356,7 @@ LJB_VMON_WaitForMonitorEvent(
         ntStatus = STATUS_SUCCESS;
         *output_data = output_event;
         bytes_returned = sizeof(*output_data);
+        trace_frame_id = output_event.FrameId;
     }
     else
     {
@@ -308,6 +380,19 @@ LJB_VMON_WaitForMonitorEvent(
         request->Request = wdf_request;
         request->in_event_data = input_data;
         request->out_event_data = output_data;
+
+        /*
+         * the request may be completed as soon as it is on the list
+         */
+        LJB_VMON_TraceEvent(
+            dev_ctx,
+            LJB_VMON_TRACE_WAIT_REQUEST,
+            IOCTL_LJB_VMON_WAIT_FOR_MONITOR_EVENT,
+            input_data->FrameId,
+            NULL,
+            trace_start,
+            STATUS_PENDING
+            );
         KeAcquireSpinLock(&dev_ctx->event_req_lock, &old_irql);
         InsertTailList(&dev_ctx->event_req_list, &request->list_entry);
         KeReleaseSpinLock(&dev_ctx->event_req_lock, old_irql);
@@ -322,6 +407,15 @@ exit:
         ntStatus,
         (ULONG_PTR) bytes_returned
         );
+    LJB_VMON_TraceEvent(
+        dev_ctx,
+        LJB_VMON_TRACE_WAIT_REQUEST,
+        IOCTL_LJB_VMON_WAIT_FOR_MONITOR_EVENT,
+        trace_frame_id,
+        NULL,
+        trace_start,
+        ntStatus
+        );
 }
 
 VOID
@@ -336,9 +430,11 @@ LJB_VMON_GetPointerShape(
     NTSTATUS                ntStatus = STATUS_SUCCESS;
     ULONG                   bytes_written = 0;
     KIRQL                   old_irql_ioctl;
+    ULONG64                 trace_start;
 
     UNREFERENCED_PARAMETER(input_buffer_length);
 
+    trace_start = LJB_VMON_TraceTimestamp(dev_ctx);
     if (output_buffer_length < sizeof(POINTER_SHAPE_DATA))
     {
         LJB_VMON_Printf(dev_ctx, DBGLVL_ERROR,
@@ -384,6 +480,15 @@ LJB_VMON_GetPointerShape(
 
 exit:
     WdfRequestCompleteWithInformation(wdf_request, ntStatus, (ULONG_PTR) bytes_written);
+    LJB_VMON_TraceEvent(
+        dev_ctx,
+        LJB_VMON_TRACE_POINTER_SHAPE,
+        IOCTL_LJB_VMON_GET_POINTER_SHAPE,
+        0,
+        NULL,
+        trace_start,
+        ntStatus
+        );
 }
 
 VOID
@@ -411,7 +516,13 @@ LJB_VMON_BltBitmap(
     LIST_ENTRY *                    list_entry;
     LIST_ENTRY *                    next_entry;
     KIRQL                           old_irql;
+    ULONG64                         trace_start;
+    ULONG64                         trace_copy_start;
+    ULONG                           trace_frame_id = 0;
+    PVOID                           trace_surface = NULL;
+    NTSTATUS                        copy_status;
 
+    trace_start = LJB_VMON_TraceTimestamp(dev_ctx);
     if (input_buffer_length < sizeof(BLT_DATA))
     {
         LJB_VMON_Printf(dev_ctx, DBGLVL_ERROR,
@@ -497,6 +608,7 @@ LJB_VMON_BltBitmap(
         ntStatus = STATUS_UNSUCCESSFUL;
         goto exit;
     }
+    trace_surface = primary_surface->hPrimarySurface;
 
     if (primary_surface->Width != input_blt_data->Width ||
         primary_surface->Height != input_blt_data->Height)
@@ -582,7 +694,8 @@ LJB_VMON_BltBitmap(
     BltData.pPrimaryBuffer = primary_surface->remote_buffer;
     BltData.pShadowBuffer = SystemFrameBuffer;
     BltData.BufferSize = FrameBufferSize;
-    (VOID) (*lci_interface->pfnGenericIoctl)(
+    trace_copy_start = LJB_VMON_TraceTimestamp(dev_ctx);
+    copy_status = (*lci_interface->pfnGenericIoctl)(
         lci_interface->ProviderContext,
         LCI_USBAV_BLT_PRIMARY_TO_SHADOW,
         &BltData,
@@ -591,10 +704,20 @@ LJB_VMON_BltBitmap(
         0,
         &bytes_return
         );
+    LJB_VMON_TraceEvent(
+        dev_ctx,
+        LJB_VMON_TRACE_BLT_COPY,
+        LCI_USBAV_BLT_PRIMARY_TO_SHADOW,
+        dev_ctx->LatestFrameId,
+        trace_surface,
+        trace_copy_start,
+        copy_status
+        );
 
     output_blt_data->Width = primary_surface->Width;
     output_blt_data->Height = primary_surface->Height;
     output_blt_data->FrameId = dev_ctx->LatestFrameId;
+    trace_frame_id = output_blt_data->FrameId;
     output_blt_data->FrameBufferSize = FrameBufferSize;
     output_blt_data->FrameBuffer = input_blt_data->FrameBuffer;
 
@@ -605,6 +728,15 @@ LJB_VMON_BltBitmap(
 
 exit:
     WdfRequestCompleteWithInformation(wdf_request, ntStatus, (ULONG_PTR) bytes_written);
+    LJB_VMON_TraceEvent(
+        dev_ctx,
+        LJB_VMON_TRACE_BLT,
+        IOCTL_LJB_VMON_BLT_BITMAP,
+        trace_frame_id,
+        trace_surface,
+        trace_start,
+        ntStatus
+        );
 }
 
 VOID
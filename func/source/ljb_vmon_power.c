@@ -32,6 +32,85 @@ Environment:
 #pragma alloc_text(PAGE, DbgDevicePowerString)
 #endif // ALLOC_PRAGMA
 
+/*
+ * Record whether the device is in D0, and complete the queued
+ * IOCTL_LJB_VMON_WAIT_FOR_MONITOR_EVENT requests that wait for it to change.
+ * Not pageable: D0Entry calls it on the power up path.
+ */
+static VOID
+LJB_VMON_NotifyPowerChange(
+    __in LJB_VMON_CTX *     dev_ctx,
+    __in BOOLEAN            Powered
+    )
+{
+    LJB_VMON_WAIT_FOR_EVENT_REQ *   wait_event_req;
+    LIST_ENTRY * CONST              list_head = &dev_ctx->event_req_list;
+    LIST_ENTRY *                    list_entry;
+    KIRQL                           old_irql;
+    KIRQL                           old_irql_ioctl;
+
+    KeAcquireSpinLock(&dev_ctx->ioctl_lock, &old_irql_ioctl);
+    dev_ctx->Powered = Powered;
+    KeReleaseSpinLock(&dev_ctx->ioctl_lock, old_irql_ioctl);
+
+    do
+    {
+        LJB_VMON_WAIT_FOR_EVENT_REQ *   this_request;
+        LJB_VMON_MONITOR_EVENT *        out_event_data;
+
+        wait_event_req = NULL;
+        KeAcquireSpinLock(&dev_ctx->event_req_lock, &old_irql);
+        for (list_entry = list_head->Flink;
+            list_entry != list_head;
+            list_entry = list_entry->Flink)
+        {
+            this_request = CONTAINING_RECORD(
+                list_entry,
+                LJB_VMON_WAIT_FOR_EVENT_REQ,
+                list_entry
+                );
+            if (this_request->in_event_data == NULL)
+                continue;
+
+            if (this_request->in_event_data->Flags.PowerChange)
+            {
+                RemoveEntryList(&this_request->list_entry);
+                wait_event_req = this_request;
+                break;
+            }
+        }
+        KeReleaseSpinLock(&dev_ctx->event_req_lock, old_irql);
+        if (wait_event_req == NULL)
+            break;
+
+        out_event_data = wait_event_req->out_event_data;
+        RtlZeroMemory(out_event_data, sizeof(*out_event_data));
+        out_event_data->Flags.PowerChange = 1;
+        out_event_data->Powered = Powered;
+        LJB_VMON_Printf(dev_ctx, DBGLVL_FLOW,
+            (__FUNCTION__
+            ": complete Request(%p), Powered(%u)\n",
+            wait_event_req,
+            Powered
+            ));
+        WdfRequestCompleteWithInformation(
+            wait_event_req->Request,
+            STATUS_SUCCESS,
+            sizeof(*out_event_data)
+            );
+        LJB_VMON_TraceEvent(
+            dev_ctx,
+            LJB_VMON_TRACE_WAIT_COMPLETE,
+            IOCTL_LJB_VMON_WAIT_FOR_MONITOR_EVENT,
+            0,
+            NULL,
+            0,
+            STATUS_SUCCESS
+            );
+        LJB_VMON_FreePool(wait_event_req);
+    } while (wait_event_req != NULL);
+}
+
 
 NTSTATUS
 LJB_VMON_EvtDeviceD0Entry(
@@ -69,12 +148,12 @@ Return Value:
 
 --*/
 {
-    UNREFERENCED_PARAMETER(Device);
     UNREFERENCED_PARAMETER(RecentPowerState);
 
     KdPrint(("LJB_VMON_EvtDeviceD0Entry - coming from %s\n",
               DbgDevicePowerString(RecentPowerState)));
 
+    LJB_VMON_NotifyPowerChange(LJB_VMON_GetVMonCtx(Device), TRUE);
     return STATUS_SUCCESS;
 }
 
@@ -107,7 +186,6 @@ Return Value:
                   The Framework will attempt to tear down the stack.
 --*/
 {
-    UNREFERENCED_PARAMETER(Device);
     UNREFERENCED_PARAMETER(PowerState);
 
     PAGED_CODE();
@@ -115,6 +193,10 @@ Return Value:
     KdPrint(("LJB_VMON_EvtDeviceD0Exit %s\n",
               DbgDevicePowerString(PowerState)));
 
+    /*
+     * the user app parks capture until the device is back in D0
+     */
+    LJB_VMON_NotifyPowerChange(LJB_VMON_GetVMonCtx(Device), FALSE);
     return STATUS_SUCCESS;
 }
 
@@ -9,6 +9,7 @@
 #include "driver.h"
 #include "public.h"
 #include "ljb_vmon_ioctl.h"
+#include "ljb_vmon_trace.h"
 #include "lci_display_internal_ioctl.h"
 
 #define LJB_VMON_POOL_TAG (ULONG) 'VMON'
@@ -68,6 +69,9 @@ LJB_VMON_GetPoolZero(
 
 
 #define MAX_POINTER_SIZE            (256*256*4)   /* width(256)/height(256)/4Byte */
+#define EDID_BLOCK_SIZE             128
+#define EDID_EXTENSION_COUNT        126           /* byte of the base block */
+#define EDID_CHECKSUM               127           /* byte of every block */
 #define FRAME_UPDATE_WINDOW         (0x10000)
 
 typedef struct _LJB_VMON_PRIMARY_SURFACE
@@ -115,6 +119,20 @@ typedef struct _LJB_VMON_WAIT_FOR_EVENT_REQ
     LJB_VMON_MONITOR_EVENT *        out_event_data;
     } LJB_VMON_WAIT_FOR_EVENT_REQ;
 
+/*
+ * One binary trace ring per processor, see ljb_vmon_trace.c. Writers reserve
+ * a record with an interlocked increment of WriteIndex, the drain owns
+ * ReadIndex. Both count records and wrap at 2^32.
+ */
+#define LJB_VMON_TRACE_RECORDS_PER_CPU      2048    /* power of 2 */
+
+typedef struct _LJB_VMON_TRACE_RING
+    {
+    volatile LONG                   WriteIndex;
+    ULONG                           ReadIndex;
+    LJB_VMON_TRACE_RECORD           Records[LJB_VMON_TRACE_RECORDS_PER_CPU];
+    } LJB_VMON_TRACE_RING;
+
 typedef struct _LJB_VMON_CTX
     {
     WDFWMIINSTANCE                  WmiDeviceArrivalEvent;
@@ -127,9 +145,10 @@ typedef struct _LJB_VMON_CTX
 
 
     /*
-     * EDID
+     * EDID, the base block and its extensions; EdidSize is 0 while unplugged
      */
-    UCHAR                           EdidBlock[128];
+    UCHAR                           EdidBlock[LCI_DEFAULT_EDID_DATA_SIZE];
+    ULONG                           EdidSize;
 
     LCI_GENERIC_INTERFACE           TargetGenericInterface;
     LONG                            InterfaceReferenceCount;
@@ -167,6 +186,20 @@ typedef struct _LJB_VMON_CTX
 
     D3DKMDT_VIDPN_PRESENT_PATH_TRANSFORMATION   ContentTransformation;
 
+    /*
+     * TRUE from D0Entry to D0Exit, under ioctl_lock
+     */
+    BOOLEAN                                     Powered;
+
+    /*
+     * binary trace, allocated by the first IOCTL_LJB_VMON_TRACE_CONTROL
+     * and kept until the device context is cleaned up
+     */
+    KSPIN_LOCK                                  trace_lock;
+    LJB_VMON_TRACE_RING *                       TraceRings;
+    ULONG                                       TraceNumCpus;
+    volatile LONG                               TraceEnabled;
+    LARGE_INTEGER                               TraceFrequency;
 
     } LJB_VMON_CTX;
 
@@ -295,5 +328,42 @@ LJB_VMON_UnlockBuffer(
     __in size_t             OutputBufferLength
     );
 
+VOID
+LJB_VMON_TraceControl(
+    __in LJB_VMON_CTX *     dev_ctx,
+    __in WDFREQUEST         wdf_request,
+    __in size_t             InputBufferLength,
+    __in size_t             OutputBufferLength
+    );
+
+VOID
+LJB_VMON_TraceDrain(
+    __in LJB_VMON_CTX *     dev_ctx,
+    __in WDFREQUEST         wdf_request,
+    __in size_t             InputBufferLength,
+    __in size_t             OutputBufferLength
+    );
+
+ULONG64
+LJB_VMON_TraceTimestamp(
+    __in LJB_VMON_CTX *     dev_ctx
+    );
+
+VOID
+LJB_VMON_TraceEvent(
+    __in LJB_VMON_CTX *     dev_ctx,
+    __in USHORT             EventId,
+    __in ULONG              IoctlCode,
+    __in ULONG              FrameId,
+    __in_opt PVOID          Surface,
+    __in ULONG64            StartTimestamp,
+    __in NTSTATUS           Status
+    );
+
+VOID
+LJB_VMON_TraceDeInit(
+    __in LJB_VMON_CTX *     dev_ctx
+    );
+
 #endif  // _LJB_VMON_PRIVATE_H_
 
@@ -0,0 +1,366 @@
+#include "ljb_vmon_private.h"
+
+/*
+ * Binary event trace.
+ *
+ * LJB_VMON_Printf is too expensive to leave on in the notification path, so
+ * the hot paths also log fixed size LJB_VMON_TRACE_RECORDs, see
+ * ljb_vmon_trace.h. Each processor has its own ring. A writer reserves a
+ * record with an interlocked increment of its ring's WriteIndex, clears the
+ * Sequence of that record, fills it in and stores Sequence last, so no lock
+ * is taken on the traced paths and writers on different processors do not
+ * share a cache line. A writer preempted between the increment and the
+ * Sequence store, or lapped by others on the same ring, only costs its own
+ * record: the drain checks Sequence before and after copying a record and
+ * counts the ones that do not match as dropped.
+ *
+ * Drains are serialized by trace_lock. The rings are allocated on the first
+ * enable and not freed before the device context is cleaned up, so a writer
+ * that saw TraceEnabled set never touches freed memory.
+ */
+
+#define LJB_VMON_TRACE_INDEX(i)     ((i) & (LJB_VMON_TRACE_RECORDS_PER_CPU - 1))
+
+ULONG64
+LJB_VMON_TraceTimestamp(
+    __in LJB_VMON_CTX *     dev_ctx
+    )
+{
+    if (dev_ctx->TraceEnabled == 0)
+        return 0;
+
+    return (ULONG64) KeQueryPerformanceCounter(NULL).QuadPart;
+}
+
+/*
+ * Log one event. StartTimestamp is what LJB_VMON_TraceTimestamp returned when
+ * the event began, or 0 for an event without duration.
+ */
+VOID
+LJB_VMON_TraceEvent(
+    __in LJB_VMON_CTX *     dev_ctx,
+    __in USHORT             EventId,
+    __in ULONG              IoctlCode,
+    __in ULONG              FrameId,
+    __in_opt PVOID          Surface,
+    __in ULONG64            StartTimestamp,
+    __in NTSTATUS           Status
+    )
+{
+    LJB_VMON_TRACE_RING *       ring;
+    LJB_VMON_TRACE_RECORD *     record;
+    ULONG64                     now;
+    ULONG64                     duration;
+    ULONG                       cpu;
+    ULONG                       index;
+
+    if (dev_ctx->TraceEnabled == 0)
+        return;
+
+    now = (ULONG64) KeQueryPerformanceCounter(NULL).QuadPart;
+    cpu = KeGetCurrentProcessorNumberEx(NULL);
+    if (cpu >= dev_ctx->TraceNumCpus)
+        cpu %= dev_ctx->TraceNumCpus;
+
+    ring = &dev_ctx->TraceRings[cpu];
+    index = (ULONG) InterlockedIncrement(&ring->WriteIndex) - 1;
+    record = &ring->Records[LJB_VMON_TRACE_INDEX(index)];
+
+    record->Sequence = 0;
+    KeMemoryBarrier();
+    if (StartTimestamp != 0 && StartTimestamp <= now)
+    {
+        duration = now - StartTimestamp;
+        record->Timestamp = StartTimestamp;
+        record->Duration = duration > MAXULONG ? MAXULONG : (ULONG) duration;
+    }
+    else
+    {
+        record->Timestamp = now;
+        record->Duration = 0;
+    }
+    record->EventId = EventId;
+    record->Cpu = (UCHAR) cpu;
+    record->Reserved = 0;
+    record->IoctlCode = IoctlCode;
+    record->FrameId = FrameId;
+    record->Surface = (ULONG64) (ULONG_PTR) Surface;
+    record->Status = (ULONG) Status;
+    KeMemoryBarrier();
+    record->Sequence = index + 1;
+}
+
+VOID
+LJB_VMON_TraceControl(
+    __in LJB_VMON_CTX *     dev_ctx,
+    __in WDFREQUEST         wdf_request,
+    __in size_t             input_buffer_length,
+    __in size_t             output_buffer_length
+    )
+{
+    LJB_VMON_TRACE_CONTROL_DATA *   control_data;
+    LJB_VMON_TRACE_RING *           trace_rings;
+    ULONG                           num_cpus;
+    ULONG                           enable;
+    NTSTATUS                        ntStatus = STATUS_SUCCESS;
+    ULONG                           bytes_written = 0;
+    KIRQL                           old_irql;
+
+    PAGED_CODE();
+
+    if (input_buffer_length < sizeof(LJB_VMON_TRACE_CONTROL_DATA) ||
+        output_buffer_length < sizeof(LJB_VMON_TRACE_CONTROL_DATA))
+    {
+        LJB_VMON_Printf(dev_ctx, DBGLVL_ERROR,
+            (__FUNCTION__
+            ": input_buffer_length(%u)/output_buffer_length(%u) too small?\n",
+            input_buffer_length,
+            output_buffer_length
+            ));
+        ntStatus = STATUS_BUFFER_TOO_SMALL;
+        goto exit;
+    }
+
+    ntStatus = WdfRequestRetrieveInputBuffer(
+            wdf_request,
+            sizeof(LJB_VMON_TRACE_CONTROL_DATA),
+            &control_data,
+            NULL);
+
+    if (!NT_SUCCESS(ntStatus))
+    {
+        LJB_VMON_Printf(dev_ctx, DBGLVL_ERROR,
+            (__FUNCTION__
+            ": WdfRequestRetrieveInputBuffer failed with 0x%08x?\n",
+            ntStatus
+            ));
+        goto exit;
+    }
+    enable = control_data->Enable;
+
+    ntStatus = WdfRequestRetrieveOutputBuffer(
+            wdf_request,
+            sizeof(LJB_VMON_TRACE_CONTROL_DATA),
+            &control_data,
+            NULL);
+
+    if (!NT_SUCCESS(ntStatus))
+    {
+        LJB_VMON_Printf(dev_ctx, DBGLVL_ERROR,
+            (__FUNCTION__
+            ": WdfRequestRetrieveOutputBuffer failed with 0x%08x?\n",
+            ntStatus
+            ));
+        goto exit;
+    }
+
+    if (enable && dev_ctx->TraceRings == NULL)
+    {
+        num_cpus = KeQueryActiveProcessorCountEx(ALL_PROCESSOR_GROUPS);
+        if (num_cpus == 0)
+            num_cpus = 1;
+        if (num_cpus > 256)
+            num_cpus = 256;
+
+        trace_rings = LJB_VMON_GetPoolZero(num_cpus * sizeof(LJB_VMON_TRACE_RING));
+        if (trace_rings == NULL)
+        {
+            LJB_VMON_Printf(dev_ctx, DBGLVL_ERROR,
+                (__FUNCTION__
+                ": unable to allocate %u trace rings?\n",
+                num_cpus
+                ));
+            ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+            goto exit;
+        }
+
+        KeAcquireSpinLock(&dev_ctx->trace_lock, &old_irql);
+        if (dev_ctx->TraceRings == NULL)
+        {
+            KeQueryPerformanceCounter(&dev_ctx->TraceFrequency);
+            dev_ctx->TraceNumCpus = num_cpus;
+            dev_ctx->TraceRings = trace_rings;
+            trace_rings = NULL;
+        }
+        KeReleaseSpinLock(&dev_ctx->trace_lock, old_irql);
+
+        if (trace_rings != NULL)
+            LJB_VMON_FreePool(trace_rings);
+    }
+
+    /*
+     * TraceRings and TraceNumCpus are visible before TraceEnabled is
+     */
+    KeMemoryBarrier();
+    InterlockedExchange(&dev_ctx->TraceEnabled, enable ? 1 : 0);
+
+    LJB_VMON_Printf(dev_ctx, DBGLVL_FLOW,
+        (__FUNCTION__
+        ": trace %s, %u rings\n",
+        enable ? "enabled" : "disabled",
+        dev_ctx->TraceNumCpus
+        ));
+
+    RtlZeroMemory(control_data, sizeof(*control_data));
+    control_data->Enable = enable ? 1 : 0;
+    control_data->NumCpus = dev_ctx->TraceNumCpus;
+    control_data->RecordsPerCpu = LJB_VMON_TRACE_RECORDS_PER_CPU;
+    control_data->TimestampFrequency = dev_ctx->TraceFrequency.QuadPart;
+    bytes_written = sizeof(*control_data);
+
+exit:
+    WdfRequestCompleteWithInformation(wdf_request, ntStatus, (ULONG_PTR) bytes_written);
+}
+
+/*
+ * Copy what ring has logged since the last drain to records, at most
+ * max_records of them. Returns how many were copied, adding the lost ones to
+ * *dropped.
+ */
+static ULONG
+LJB_VMON_TraceDrainRing(
+    __in LJB_VMON_TRACE_RING *      ring,
+    __out LJB_VMON_TRACE_RECORD *   records,
+    __in ULONG                      max_records,
+    __inout ULONG *                 dropped
+    )
+{
+    LJB_VMON_TRACE_RECORD *     record;
+    ULONG                       write_index;
+    ULONG                       read_index;
+    ULONG                       sequence;
+    ULONG                       num_records;
+
+    write_index = (ULONG) ring->WriteIndex;
+    read_index = ring->ReadIndex;
+    if (write_index - read_index > LJB_VMON_TRACE_RECORDS_PER_CPU)
+    {
+        *dropped += write_index - read_index - LJB_VMON_TRACE_RECORDS_PER_CPU;
+        read_index = write_index - LJB_VMON_TRACE_RECORDS_PER_CPU;
+    }
+
+    num_records = 0;
+    while (read_index != write_index && num_records < max_records)
+    {
+        record = &ring->Records[LJB_VMON_TRACE_INDEX(read_index)];
+        sequence = record->Sequence;
+        KeMemoryBarrier();
+        if (sequence != read_index + 1)
+        {
+            /*
+             * Either the writer of this record has not finished yet, or a
+             * writer a lap ahead is reusing it. Leave the former for the
+             * next drain.
+             */
+            if ((ULONG) ring->WriteIndex - read_index <= LJB_VMON_TRACE_RECORDS_PER_CPU)
+                break;
+
+            (*dropped)++;
+            read_index++;
+            continue;
+        }
+
+        records[num_records] = *record;
+        KeMemoryBarrier();
+        if (record->Sequence != sequence)
+        {
+            (*dropped)++;
+            read_index++;
+            continue;
+        }
+
+        num_records++;
+        read_index++;
+    }
+    ring->ReadIndex = read_index;
+    return num_records;
+}
+
+VOID
+LJB_VMON_TraceDrain(
+    __in LJB_VMON_CTX *     dev_ctx,
+    __in WDFREQUEST         wdf_request,
+    __in size_t             input_buffer_length,
+    __in size_t             output_buffer_length
+    )
+{
+    LJB_VMON_TRACE_DRAIN_DATA *     drain_data;
+    LJB_VMON_TRACE_RECORD *         records;
+    size_t                          buffer_length;
+    ULONG                           max_records;
+    ULONG                           num_records;
+    ULONG                           dropped;
+    ULONG                           cpu;
+    NTSTATUS                        ntStatus = STATUS_SUCCESS;
+    ULONG                           bytes_written = 0;
+    KIRQL                           old_irql;
+
+    UNREFERENCED_PARAMETER(input_buffer_length);
+
+    if (output_buffer_length < sizeof(LJB_VMON_TRACE_DRAIN_DATA))
+    {
+        LJB_VMON_Printf(dev_ctx, DBGLVL_ERROR,
+            (__FUNCTION__
+            ": output_buffer_length(%u) too small?\n",
+            output_buffer_length
+            ));
+        ntStatus = STATUS_BUFFER_TOO_SMALL;
+        goto exit;
+    }
+
+    ntStatus = WdfRequestRetrieveOutputBuffer(
+            wdf_request,
+            sizeof(LJB_VMON_TRACE_DRAIN_DATA),
+            &drain_data,
+            &buffer_length);
+
+    if (!NT_SUCCESS(ntStatus))
+    {
+        LJB_VMON_Printf(dev_ctx, DBGLVL_ERROR,
+            (__FUNCTION__
+            ": WdfRequestRetrieveOutputBuffer failed with 0x%08x?\n",
+            ntStatus
+            ));
+        goto exit;
+    }
+
+    records = (LJB_VMON_TRACE_RECORD *) (drain_data + 1);
+    max_records = (ULONG) ((buffer_length - sizeof(*drain_data)) /
+        sizeof(LJB_VMON_TRACE_RECORD));
+    num_records = 0;
+    dropped = 0;
+
+    KeAcquireSpinLock(&dev_ctx->trace_lock, &old_irql);
+    for (cpu = 0; cpu < dev_ctx->TraceNumCpus && num_records < max_records; cpu++)
+    {
+        num_records += LJB_VMON_TraceDrainRing(
+            &dev_ctx->TraceRings[cpu],
+            records + num_records,
+            max_records - num_records,
+            &dropped
+            );
+    }
+    KeReleaseSpinLock(&dev_ctx->trace_lock, old_irql);
+
+    drain_data->NumRecords = num_records;
+    drain_data->DroppedRecords = dropped;
+    drain_data->Timestamp = (ULONG64) KeQueryPerformanceCounter(NULL).QuadPart;
+    bytes_written = sizeof(*drain_data) + num_records * sizeof(LJB_VMON_TRACE_RECORD);
+
+exit:
+    WdfRequestCompleteWithInformation(wdf_request, ntStatus, (ULONG_PTR) bytes_written);
+}
+
+VOID
+LJB_VMON_TraceDeInit(
+    __in LJB_VMON_CTX *     dev_ctx
+    )
+{
+    dev_ctx->TraceEnabled = 0;
+    if (dev_ctx->TraceRings != NULL)
+    {
+        LJB_VMON_FreePool(dev_ctx->TraceRings);
+        dev_ctx->TraceRings = NULL;
+        dev_ctx->TraceNumCpus = 0;
+    }
+}
@@ -0,0 +1,117 @@
+/*!
+    \file       dispmprt.h
+    \brief      Minimal display miniport stand-in for host builds
+    \details    Just the D3DKMDT and DXGK definitions that
+                include/lci_display_internal_ioctl.h and func/source need, so
+                the ProxyKMD contract can be exercised on Linux. Like
+                host/include/windows.h it is only on the include path of host
+                builds.
+ */
+
+#ifndef _LJB_HOST_DISPMPRT_H_
+#define _LJB_HOST_DISPMPRT_H_
+
+#include <ntddk.h>
+
+/*
+ * d3dkmdt.h
+ */
+#define _D3DKMDT_H
+
+typedef UINT                D3DDDI_VIDEO_PRESENT_SOURCE_ID;
+
+typedef enum _D3DKMDT_VIDPN_PRESENT_PATH_SCALING
+{
+    D3DKMDT_VPPS_UNINITIALIZED  = 0,
+    D3DKMDT_VPPS_IDENTITY       = 1,
+    D3DKMDT_VPPS_CENTERED       = 2,
+    D3DKMDT_VPPS_STRETCHED      = 3,
+} D3DKMDT_VIDPN_PRESENT_PATH_SCALING;
+
+typedef enum _D3DKMDT_VIDPN_PRESENT_PATH_ROTATION
+{
+    D3DKMDT_VPPR_UNINITIALIZED  = 0,
+    D3DKMDT_VPPR_IDENTITY       = 1,
+    D3DKMDT_VPPR_ROTATE90       = 2,
+    D3DKMDT_VPPR_ROTATE180      = 3,
+    D3DKMDT_VPPR_ROTATE270      = 4,
+} D3DKMDT_VIDPN_PRESENT_PATH_ROTATION;
+
+typedef struct _D3DKMDT_VIDPN_PRESENT_PATH_SCALING_SUPPORT
+{
+    UINT    Identity    : 1;
+    UINT    Centered    : 1;
+    UINT    Stretched   : 1;
+} D3DKMDT_VIDPN_PRESENT_PATH_SCALING_SUPPORT;
+
+typedef struct _D3DKMDT_VIDPN_PRESENT_PATH_ROTATION_SUPPORT
+{
+    UINT    Identity    : 1;
+    UINT    Rotate90    : 1;
+    UINT    Rotate180   : 1;
+    UINT    Rotate270   : 1;
+} D3DKMDT_VIDPN_PRESENT_PATH_ROTATION_SUPPORT;
+
+typedef struct _D3DKMDT_VIDPN_PRESENT_PATH_TRANSFORMATION
+{
+    D3DKMDT_VIDPN_PRESENT_PATH_SCALING          Scaling;
+    D3DKMDT_VIDPN_PRESENT_PATH_SCALING_SUPPORT  ScalingSupport;
+    D3DKMDT_VIDPN_PRESENT_PATH_ROTATION         Rotation;
+    D3DKMDT_VIDPN_PRESENT_PATH_ROTATION_SUPPORT RotationSupport;
+} D3DKMDT_VIDPN_PRESENT_PATH_TRANSFORMATION;
+
+/*
+ * d3dkmddi.h
+ */
+#define _D3DKMDDI_H_
+
+typedef struct _DXGK_POINTERFLAGS
+{
+    union
+    {
+        struct
+        {
+            UINT    Monochrome      : 1;
+            UINT    Color           : 1;
+            UINT    MaskedColor     : 1;
+            UINT    Reserved        :29;
+        };
+        UINT        Value;
+    };
+} DXGK_POINTERFLAGS;
+
+typedef struct _DXGK_SETPOINTERPOSITIONFLAGS
+{
+    union
+    {
+        struct
+        {
+            UINT    Visible         : 1;
+            UINT    Procedural      : 1;
+            UINT    Reserved        :30;
+        };
+        UINT        Value;
+    };
+} DXGK_SETPOINTERPOSITIONFLAGS;
+
+typedef struct _DXGKARG_SETPOINTERPOSITION
+{
+    D3DDDI_VIDEO_PRESENT_SOURCE_ID  VidPnSourceId;
+    INT                             X;
+    INT                             Y;
+    DXGK_SETPOINTERPOSITIONFLAGS    Flags;
+} DXGKARG_SETPOINTERPOSITION;
+
+typedef struct _DXGKARG_SETPOINTERSHAPE
+{
+    DXGK_POINTERFLAGS               Flags;
+    UINT                            Width;
+    UINT                            Height;
+    UINT                            Pitch;
+    CONST VOID *                    pPixels;
+    UINT                            XHot;
+    UINT                            YHot;
+    D3DDDI_VIDEO_PRESENT_SOURCE_ID  VidPnSourceId;
+} DXGKARG_SETPOINTERSHAPE;
+
+#endif /* _LJB_HOST_DISPMPRT_H_ */
@@ -0,0 +1,35 @@
+/*!
+    \file       guiddef.h
+    \brief      GUID type and DEFINE_GUID for host builds
+    \details    As with the SDK header, DEFINE_GUID declares the GUID unless
+                INITGUID is defined, in which case it defines it; the macro
+                part is outside the include guard so that including
+                initguid.h later switches it over.
+ */
+
+#ifndef _LJB_HOST_GUIDDEF_H_
+#define _LJB_HOST_GUIDDEF_H_
+
+#include <windows.h>
+
+typedef struct _GUID
+{
+    ULONG   Data1;
+    USHORT  Data2;
+    USHORT  Data3;
+    UCHAR   Data4[8];
+} GUID;
+
+typedef GUID *          LPGUID;
+typedef CONST GUID *    LPCGUID;
+
+#endif /* _LJB_HOST_GUIDDEF_H_ */
+
+#undef DEFINE_GUID
+#ifdef INITGUID
+#define DEFINE_GUID(name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) \
+    CONST GUID name = { l, w1, w2, { b1, b2, b3, b4, b5, b6, b7, b8 } }
+#else
+#define DEFINE_GUID(name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) \
+    extern CONST GUID name
+#endif
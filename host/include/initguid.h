@@ -0,0 +1,7 @@
+/*!
+    \file       initguid.h
+    \brief      Makes DEFINE_GUID define rather than declare, for host builds
+ */
+
+#define INITGUID
+#include <guiddef.h>
@@ -0,0 +1,385 @@
+/*!
+    \file       ntddk.h
+    \brief      Minimal kernel API stand-in for building func/source on Linux
+    \details    Covers what the monitor driver's notification, wait, blit and
+                cleanup paths use: status codes, spin locks, interlocked
+                operations, list macros, pool, MDLs, processor numbers, the
+                performance counter and debug print, so those
+                files compile unmodified into a user-space program. The
+                out-of-line parts live in host/source/vmon_host_wdk.c.
+
+                Spin locks are real locks that yield when contended, since a
+                user thread, unlike a CPU at DISPATCH_LEVEL, can be preempted
+                while holding one; IRQLs are not modelled. Pool and MDLs are
+                counted so a harness can check for leaks. SEH try/except runs
+                the guarded block and never the handler.
+
+                __FUNCTION__ is not a string literal in gcc, so it is replaced
+                by __FILE__ for the debug messages that paste it.
+ */
+
+#ifndef _LJB_HOST_NTDDK_H_
+#define _LJB_HOST_NTDDK_H_
+
+#include <windows.h>
+#include <guiddef.h>
+#include <assert.h>
+
+#ifndef DBG
+#define DBG                 0
+#endif
+
+#define __FUNCTION__        __FILE__
+
+#define try                 if (1)
+#define except(Filter)      else if (0)
+#define EXCEPTION_EXECUTE_HANDLER   1
+
+#define PAGED_CODE()
+#define ASSERT(e)           assert(e)
+
+/*
+ * status codes
+ */
+typedef LONG                NTSTATUS;
+
+#define NT_SUCCESS(Status)              (((NTSTATUS) (Status)) >= 0)
+
+#define STATUS_SUCCESS                  ((NTSTATUS) 0x00000000L)
+#define STATUS_PENDING                  ((NTSTATUS) 0x00000103L)
+#define STATUS_UNSUCCESSFUL             ((NTSTATUS) 0xC0000001L)
+#define STATUS_INVALID_HANDLE           ((NTSTATUS) 0xC0000008L)
+#define STATUS_INVALID_PARAMETER        ((NTSTATUS) 0xC000000DL)
+#define STATUS_INVALID_DEVICE_REQUEST   ((NTSTATUS) 0xC0000010L)
+#define STATUS_BUFFER_TOO_SMALL         ((NTSTATUS) 0xC0000023L)
+#define STATUS_INSUFFICIENT_RESOURCES   ((NTSTATUS) 0xC000009AL)
+#define STATUS_NOT_SUPPORTED            ((NTSTATUS) 0xC00000BBL)
+#define STATUS_CANCELLED                ((NTSTATUS) 0xC0000120L)
+
+/*
+ * I/O control codes
+ */
+#define CTL_CODE(DeviceType, Function, Method, Access)  \
+    (((DeviceType) << 16) | ((Access) << 14) | ((Function) << 2) | (Method))
+
+#define FILE_DEVICE_UNKNOWN             0x00000022
+#define FILE_DEVICE_BUS_EXTENDER        0x0000002a
+#define METHOD_BUFFERED                 0
+#define METHOD_IN_DIRECT                1
+#define METHOD_OUT_DIRECT               2
+#define METHOD_NEITHER                  3
+#define FILE_ANY_ACCESS                 0
+#define FILE_READ_DATA                  1
+#define FILE_WRITE_DATA                 2
+
+/*
+ * debug print
+ */
+ULONG
+DbgPrint(
+    __in PCSTR  Format,
+    ...
+    );
+
+#if DBG
+#define KdPrint(_x_)        DbgPrint _x_
+#else
+#define KdPrint(_x_)
+#endif
+
+/*
+ * strings and objects the driver only passes around
+ */
+typedef USHORT              WCHAR;
+typedef WCHAR *             PWSTR;
+
+typedef struct _UNICODE_STRING
+{
+    USHORT  Length;
+    USHORT  MaximumLength;
+    PWSTR   Buffer;
+} UNICODE_STRING, *PUNICODE_STRING;
+
+typedef struct _DEVICE_OBJECT
+{
+    PVOID   DeviceExtension;
+} DEVICE_OBJECT, *PDEVICE_OBJECT;
+
+typedef struct _DRIVER_OBJECT
+{
+    PVOID   DriverExtension;
+} DRIVER_OBJECT, *PDRIVER_OBJECT;
+
+typedef struct _INTERFACE
+{
+    USHORT  Size;
+    USHORT  Version;
+    PVOID   Context;
+    VOID    (*InterfaceReference)(PVOID Context);
+    VOID    (*InterfaceDereference)(PVOID Context);
+} INTERFACE, *PINTERFACE;
+
+typedef NTSTATUS
+DRIVER_INITIALIZE(
+    __in PDRIVER_OBJECT     DriverObject,
+    __in PUNICODE_STRING    RegistryPath
+    );
+
+typedef enum _DEVICE_POWER_STATE
+{
+    PowerDeviceUnspecified = 0,
+    PowerDeviceD0,
+    PowerDeviceD1,
+    PowerDeviceD2,
+    PowerDeviceD3,
+    PowerDeviceMaximum
+} DEVICE_POWER_STATE;
+
+NTSTATUS
+IoRegisterDeviceInterface(
+    __in PDEVICE_OBJECT     PhysicalDeviceObject,
+    __in CONST GUID *       InterfaceClassGuid,
+    __in_opt PUNICODE_STRING ReferenceString,
+    __out PUNICODE_STRING   SymbolicLinkName
+    );
+
+NTSTATUS
+IoSetDeviceInterfaceState(
+    __in PUNICODE_STRING    SymbolicLinkName,
+    __in BOOLEAN            Enable
+    );
+
+VOID
+RtlFreeUnicodeString(
+    __inout PUNICODE_STRING UnicodeString
+    );
+
+/*
+ * spin locks
+ */
+typedef UCHAR               KIRQL;
+typedef volatile LONG       KSPIN_LOCK;
+
+#define PASSIVE_LEVEL       0
+#define DISPATCH_LEVEL      2
+
+VOID
+HostWdkAcquireSpinLock(
+    __in KSPIN_LOCK *   SpinLock
+    );
+
+#define KeInitializeSpinLock(SpinLock)  (*(SpinLock) = 0)
+#define KeAcquireSpinLock(SpinLock, OldIrql)    \
+    (*(OldIrql) = PASSIVE_LEVEL, HostWdkAcquireSpinLock(SpinLock))
+#define KeReleaseSpinLock(SpinLock, NewIrql)    \
+    ((void) (NewIrql), __atomic_store_n((SpinLock), 0, __ATOMIC_RELEASE))
+
+/*
+ * doubly linked lists
+ */
+typedef struct _LIST_ENTRY
+{
+    struct _LIST_ENTRY *    Flink;
+    struct _LIST_ENTRY *    Blink;
+} LIST_ENTRY, *PLIST_ENTRY;
+
+#define CONTAINING_RECORD(address, type, field) \
+    ((type *) ((PCHAR) (address) - offsetof(type, field)))
+
+FORCEINLINE VOID
+InitializeListHead(
+    __out PLIST_ENTRY   ListHead
+    )
+{
+    ListHead->Flink = ListHead->Blink = ListHead;
+}
+
+FORCEINLINE BOOLEAN
+IsListEmpty(
+    __in CONST LIST_ENTRY * ListHead
+    )
+{
+    return (BOOLEAN) (ListHead->Flink == ListHead);
+}
+
+FORCEINLINE BOOLEAN
+RemoveEntryList(
+    __in PLIST_ENTRY    Entry
+    )
+{
+    PLIST_ENTRY CONST   Flink = Entry->Flink;
+    PLIST_ENTRY CONST   Blink = Entry->Blink;
+
+    Blink->Flink = Flink;
+    Flink->Blink = Blink;
+    return (BOOLEAN) (Flink == Blink);
+}
+
+FORCEINLINE PLIST_ENTRY
+RemoveHeadList(
+    __inout PLIST_ENTRY ListHead
+    )
+{
+    PLIST_ENTRY CONST   Entry = ListHead->Flink;
+
+    RemoveEntryList(Entry);
+    return Entry;
+}
+
+FORCEINLINE VOID
+InsertTailList(
+    __inout PLIST_ENTRY ListHead,
+    __inout PLIST_ENTRY Entry
+    )
+{
+    PLIST_ENTRY CONST   Blink = ListHead->Blink;
+
+    Entry->Flink = ListHead;
+    Entry->Blink = Blink;
+    Blink->Flink = Entry;
+    ListHead->Blink = Entry;
+}
+
+FORCEINLINE VOID
+InsertHeadList(
+    __inout PLIST_ENTRY ListHead,
+    __inout PLIST_ENTRY Entry
+    )
+{
+    PLIST_ENTRY CONST   Flink = ListHead->Flink;
+
+    Entry->Flink = Flink;
+    Entry->Blink = ListHead;
+    Flink->Blink = Entry;
+    ListHead->Flink = Entry;
+}
+
+/*
+ * pool
+ */
+typedef enum _POOL_TYPE
+{
+    NonPagedPool = 0,
+    PagedPool = 1
+} POOL_TYPE;
+
+PVOID
+ExAllocatePoolWithTag(
+    __in POOL_TYPE  PoolType,
+    __in SIZE_T     NumberOfBytes,
+    __in ULONG      Tag
+    );
+
+VOID
+ExFreePoolWithTag(
+    __in PVOID      P,
+    __in ULONG      Tag
+    );
+
+/*
+ * MDLs describe the caller's buffer as is; there is only one address space
+ */
+typedef struct _MDL
+{
+    PVOID       VirtualAddress;
+    ULONG       ByteCount;
+    BOOLEAN     Locked;
+} MDL, *PMDL;
+
+typedef enum _KPROCESSOR_MODE
+{
+    KernelMode = 0,
+    UserMode = 1
+} KPROCESSOR_MODE;
+
+typedef enum _LOCK_OPERATION
+{
+    IoReadAccess = 0,
+    IoWriteAccess = 1,
+    IoModifyAccess = 2
+} LOCK_OPERATION;
+
+typedef enum _MM_PAGE_PRIORITY
+{
+    LowPagePriority = 0,
+    NormalPagePriority = 16,
+    HighPagePriority = 32
+} MM_PAGE_PRIORITY;
+
+PMDL
+IoAllocateMdl(
+    __in PVOID      VirtualAddress,
+    __in ULONG      Length,
+    __in BOOLEAN    SecondaryBuffer,
+    __in BOOLEAN    ChargeQuota,
+    __in PVOID      Irp
+    );
+
+VOID
+IoFreeMdl(
+    __in PMDL       Mdl
+    );
+
+VOID
+MmProbeAndLockPages(
+    __inout PMDL            Mdl,
+    __in KPROCESSOR_MODE    AccessMode,
+    __in LOCK_OPERATION     Operation
+    );
+
+VOID
+MmUnlockPages(
+    __inout PMDL            Mdl
+    );
+
+#define MmGetSystemAddressForMdlSafe(Mdl, Priority) \
+    ((void) (Priority), (Mdl)->VirtualAddress)
+
+/*
+ * processors, timing and ordering; processor numbers are those of the host
+ */
+#define MAXULONG                0xffffffff
+#define ALL_PROCESSOR_GROUPS    0xffff
+
+typedef struct _PROCESSOR_NUMBER
+{
+    USHORT  Group;
+    UCHAR   Number;
+    UCHAR   Reserved;
+} PROCESSOR_NUMBER, *PPROCESSOR_NUMBER;
+
+ULONG
+KeQueryActiveProcessorCountEx(
+    __in USHORT             GroupNumber
+    );
+
+ULONG
+KeGetCurrentProcessorNumberEx(
+    __out_opt PPROCESSOR_NUMBER ProcNumber
+    );
+
+FORCEINLINE LARGE_INTEGER
+KeQueryPerformanceCounter(
+    __out_opt LARGE_INTEGER *   PerformanceFrequency
+    )
+{
+    LARGE_INTEGER   Counter;
+
+    if (PerformanceFrequency != NULL)
+        QueryPerformanceFrequency(PerformanceFrequency);
+    QueryPerformanceCounter(&Counter);
+    return Counter;
+}
+
+#define KeMemoryBarrier()       __sync_synchronize()
+
+/*
+ * accounting for harnesses
+ */
+LONG
+HostWdkOutstandingAllocations(VOID);
+
+ULONG64
+HostWdkContendedSpinLocks(VOID);
+
+#endif /* _LJB_HOST_NTDDK_H_ */
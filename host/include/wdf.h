@@ -0,0 +1,602 @@
+/*!
+    \file       wdf.h
+    \brief      Minimal KMDF stand-in for building func/source on Linux
+    \details    Enough of the framework for ljb_vmon_driver_entry.c and the
+                I/O paths to compile unmodified and run in one process: the
+                driver, device, queue and file objects are plain structures,
+                a device carries its context, and requests carry their
+                buffers the way METHOD_BUFFERED and internal IOCTLs present
+                them. Configuration the host has no use for (power policy,
+                idle, wake) is accepted and ignored.
+
+                There is no I/O manager. A harness plays the PnP manager and
+                the I/O manager with the HostWdf* routines at the end of this
+                file, implemented in host/source/vmon_host_wdk.c.
+ */
+
+#ifndef _LJB_HOST_WDF_H_
+#define _LJB_HOST_WDF_H_
+
+#include <ntddk.h>
+
+/*
+ * handles
+ */
+typedef struct _WDF_HOST_OBJECT *   WDFOBJECT;
+typedef WDFOBJECT                   WDFDRIVER;
+typedef WDFOBJECT                   WDFDEVICE;
+typedef WDFOBJECT                   WDFQUEUE;
+typedef WDFOBJECT                   WDFFILEOBJECT;
+typedef WDFOBJECT                   WDFCMRESLIST;
+typedef WDFOBJECT                   WDFWMIINSTANCE;
+typedef struct _WDF_HOST_REQUEST *  WDFREQUEST;
+typedef struct _WDFDEVICE_INIT      WDFDEVICE_INIT, *PWDFDEVICE_INIT;
+
+#define WDF_NO_OBJECT_ATTRIBUTES    NULL
+#define WDF_NO_HANDLE               NULL
+#define WDF_NO_EVENT_CALLBACK       NULL
+
+typedef enum _WDF_POWER_DEVICE_STATE
+{
+    WdfPowerDeviceInvalid = 0,
+    WdfPowerDeviceD0,
+    WdfPowerDeviceD1,
+    WdfPowerDeviceD2,
+    WdfPowerDeviceD3,
+    WdfPowerDeviceD3Final,
+    WdfPowerDevicePrepareForHibernation,
+    WdfPowerDeviceMaximum
+} WDF_POWER_DEVICE_STATE;
+
+/*
+ * event callbacks
+ */
+typedef NTSTATUS EVT_WDF_DRIVER_DEVICE_ADD(WDFDRIVER Driver, PWDFDEVICE_INIT DeviceInit);
+typedef VOID EVT_WDF_DRIVER_UNLOAD(WDFDRIVER Driver);
+typedef VOID EVT_WDF_OBJECT_CONTEXT_CLEANUP(WDFOBJECT Object);
+typedef VOID EVT_WDF_DEVICE_CONTEXT_CLEANUP(WDFDEVICE Device);
+typedef NTSTATUS EVT_WDF_DEVICE_D0_ENTRY(WDFDEVICE Device, WDF_POWER_DEVICE_STATE PreviousState);
+typedef NTSTATUS EVT_WDF_DEVICE_D0_EXIT(WDFDEVICE Device, WDF_POWER_DEVICE_STATE TargetState);
+typedef NTSTATUS EVT_WDF_DEVICE_PREPARE_HARDWARE(WDFDEVICE Device, WDFCMRESLIST ResourcesRaw, WDFCMRESLIST ResourcesTranslated);
+typedef NTSTATUS EVT_WDF_DEVICE_RELEASE_HARDWARE(WDFDEVICE Device, WDFCMRESLIST ResourcesTranslated);
+typedef VOID EVT_WDF_DEVICE_SURPRISE_REMOVAL(WDFDEVICE Device);
+typedef NTSTATUS EVT_WDF_DEVICE_SELF_MANAGED_IO_INIT(WDFDEVICE Device);
+typedef NTSTATUS EVT_WDF_DEVICE_ARM_WAKE_FROM_S0(WDFDEVICE Device);
+typedef NTSTATUS EVT_WDF_DEVICE_ARM_WAKE_FROM_SX(WDFDEVICE Device);
+typedef VOID EVT_WDF_DEVICE_DISARM_WAKE_FROM_S0(WDFDEVICE Device);
+typedef VOID EVT_WDF_DEVICE_DISARM_WAKE_FROM_SX(WDFDEVICE Device);
+typedef VOID EVT_WDF_DEVICE_WAKE_FROM_S0_TRIGGERED(WDFDEVICE Device);
+typedef VOID EVT_WDF_DEVICE_WAKE_FROM_SX_TRIGGERED(WDFDEVICE Device);
+typedef VOID EVT_WDF_DEVICE_FILE_CREATE(WDFDEVICE Device, WDFREQUEST Request, WDFFILEOBJECT FileObject);
+typedef VOID EVT_WDF_FILE_CLOSE(WDFFILEOBJECT FileObject);
+typedef VOID EVT_WDF_FILE_CLEANUP(WDFFILEOBJECT FileObject);
+typedef VOID EVT_WDF_IO_IN_CALLER_CONTEXT(WDFDEVICE Device, WDFREQUEST Request);
+typedef VOID EVT_WDF_IO_QUEUE_IO_DEFAULT(WDFQUEUE Queue, WDFREQUEST Request);
+typedef VOID EVT_WDF_IO_QUEUE_IO_READ(WDFQUEUE Queue, WDFREQUEST Request, size_t Length);
+typedef VOID EVT_WDF_IO_QUEUE_IO_WRITE(WDFQUEUE Queue, WDFREQUEST Request, size_t Length);
+typedef VOID EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL(WDFQUEUE Queue, WDFREQUEST Request, size_t OutputBufferLength, size_t InputBufferLength, ULONG IoControlCode);
+typedef VOID EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL(WDFQUEUE Queue, WDFREQUEST Request, size_t OutputBufferLength, size_t InputBufferLength, ULONG IoControlCode);
+typedef VOID EVT_WDF_IO_QUEUE_IO_STOP(WDFQUEUE Queue, WDFREQUEST Request, ULONG ActionFlags);
+typedef NTSTATUS EVT_WDF_WMI_INSTANCE_QUERY_INSTANCE(WDFWMIINSTANCE WmiInstance, ULONG OutBufferSize, PVOID OutBuffer, PULONG BufferUsed);
+typedef NTSTATUS EVT_WDF_WMI_INSTANCE_SET_INSTANCE(WDFWMIINSTANCE WmiInstance, ULONG InBufferSize, PVOID InBuffer);
+typedef NTSTATUS EVT_WDF_WMI_INSTANCE_SET_ITEM(WDFWMIINSTANCE WmiInstance, ULONG DataItemId, ULONG InBufferSize, PVOID InBuffer);
+typedef NTSTATUS EVT_WDF_WMI_INSTANCE_EXECUTE_METHOD(WDFWMIINSTANCE WmiInstance, ULONG MethodId, ULONG InBufferSize, ULONG OutBufferSize, PVOID Buffer, PULONG BufferUsed);
+
+typedef EVT_WDF_DRIVER_DEVICE_ADD *                 PFN_WDF_DRIVER_DEVICE_ADD;
+typedef EVT_WDF_DRIVER_UNLOAD *                     PFN_WDF_DRIVER_UNLOAD;
+typedef EVT_WDF_OBJECT_CONTEXT_CLEANUP *            PFN_WDF_OBJECT_CONTEXT_CLEANUP;
+typedef EVT_WDF_DEVICE_D0_ENTRY *                   PFN_WDF_DEVICE_D0_ENTRY;
+typedef EVT_WDF_DEVICE_D0_EXIT *                    PFN_WDF_DEVICE_D0_EXIT;
+typedef EVT_WDF_DEVICE_PREPARE_HARDWARE *           PFN_WDF_DEVICE_PREPARE_HARDWARE;
+typedef EVT_WDF_DEVICE_RELEASE_HARDWARE *           PFN_WDF_DEVICE_RELEASE_HARDWARE;
+typedef EVT_WDF_DEVICE_SURPRISE_REMOVAL *           PFN_WDF_DEVICE_SURPRISE_REMOVAL;
+typedef EVT_WDF_DEVICE_SELF_MANAGED_IO_INIT *       PFN_WDF_DEVICE_SELF_MANAGED_IO_INIT;
+typedef EVT_WDF_DEVICE_ARM_WAKE_FROM_S0 *           PFN_WDF_DEVICE_ARM_WAKE_FROM_S0;
+typedef EVT_WDF_DEVICE_ARM_WAKE_FROM_SX *           PFN_WDF_DEVICE_ARM_WAKE_FROM_SX;
+typedef EVT_WDF_DEVICE_DISARM_WAKE_FROM_S0 *        PFN_WDF_DEVICE_DISARM_WAKE_FROM_S0;
+typedef EVT_WDF_DEVICE_DISARM_WAKE_FROM_SX *        PFN_WDF_DEVICE_DISARM_WAKE_FROM_SX;
+typedef EVT_WDF_DEVICE_WAKE_FROM_S0_TRIGGERED *     PFN_WDF_DEVICE_WAKE_FROM_S0_TRIGGERED;
+typedef EVT_WDF_DEVICE_WAKE_FROM_SX_TRIGGERED *     PFN_WDF_DEVICE_WAKE_FROM_SX_TRIGGERED;
+typedef EVT_WDF_DEVICE_FILE_CREATE *                PFN_WDF_DEVICE_FILE_CREATE;
+typedef EVT_WDF_FILE_CLOSE *                        PFN_WDF_FILE_CLOSE;
+typedef EVT_WDF_FILE_CLEANUP *                      PFN_WDF_FILE_CLEANUP;
+typedef EVT_WDF_IO_IN_CALLER_CONTEXT *              PFN_WDF_IO_IN_CALLER_CONTEXT;
+typedef EVT_WDF_IO_QUEUE_IO_DEFAULT *               PFN_WDF_IO_QUEUE_IO_DEFAULT;
+typedef EVT_WDF_IO_QUEUE_IO_READ *                  PFN_WDF_IO_QUEUE_IO_READ;
+typedef EVT_WDF_IO_QUEUE_IO_WRITE *                 PFN_WDF_IO_QUEUE_IO_WRITE;
+typedef EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL *        PFN_WDF_IO_QUEUE_IO_DEVICE_CONTROL;
+typedef EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL *
+                                                    PFN_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL;
+typedef EVT_WDF_IO_QUEUE_IO_STOP *                  PFN_WDF_IO_QUEUE_IO_STOP;
+
+/*
+ * object attributes and contexts
+ */
+typedef struct _WDF_OBJECT_CONTEXT_TYPE_INFO
+{
+    ULONG           Size;
+    PCSTR           ContextName;
+    SIZE_T          ContextSize;
+} WDF_OBJECT_CONTEXT_TYPE_INFO;
+
+typedef struct _WDF_OBJECT_ATTRIBUTES
+{
+    ULONG                                   Size;
+    PFN_WDF_OBJECT_CONTEXT_CLEANUP          EvtCleanupCallback;
+    PFN_WDF_OBJECT_CONTEXT_CLEANUP          EvtDestroyCallback;
+    CONST WDF_OBJECT_CONTEXT_TYPE_INFO *    ContextTypeInfo;
+} WDF_OBJECT_ATTRIBUTES;
+
+FORCEINLINE VOID
+WDF_OBJECT_ATTRIBUTES_INIT(
+    __out WDF_OBJECT_ATTRIBUTES *   Attributes
+    )
+{
+    RtlZeroMemory(Attributes, sizeof(*Attributes));
+    Attributes->Size = sizeof(*Attributes);
+}
+
+#define WDF_TYPE_NAME_TO_TYPE_INFO(_contexttype)    WDF_##_contexttype##_TYPE_INFO
+
+#define WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(_attributes, _contexttype)     \
+    (WDF_OBJECT_ATTRIBUTES_INIT(_attributes),                                   \
+    (_attributes)->ContextTypeInfo = &WDF_TYPE_NAME_TO_TYPE_INFO(_contexttype))
+
+PVOID
+WdfObjectGetTypedContextWorker(
+    __in WDFOBJECT                              Handle,
+    __in CONST WDF_OBJECT_CONTEXT_TYPE_INFO *   TypeInfo
+    );
+
+#define WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(_contexttype, _castingfunction)     \
+    static CONST WDF_OBJECT_CONTEXT_TYPE_INFO                                   \
+        WDF_TYPE_NAME_TO_TYPE_INFO(_contexttype) =                              \
+    {                                                                           \
+        sizeof(WDF_OBJECT_CONTEXT_TYPE_INFO),                                   \
+        #_contexttype,                                                          \
+        sizeof(_contexttype)                                                    \
+    };                                                                          \
+    FORCEINLINE _contexttype *                                                  \
+    _castingfunction(                                                           \
+        __in WDFOBJECT  Handle                                                  \
+        )                                                                       \
+    {                                                                           \
+        return (_contexttype *) WdfObjectGetTypedContextWorker(                 \
+            Handle,                                                             \
+            &WDF_TYPE_NAME_TO_TYPE_INFO(_contexttype)                           \
+            );                                                                  \
+    }
+
+/*
+ * driver
+ */
+typedef struct _WDF_DRIVER_CONFIG
+{
+    ULONG                       Size;
+    PFN_WDF_DRIVER_DEVICE_ADD   EvtDriverDeviceAdd;
+    PFN_WDF_DRIVER_UNLOAD       EvtDriverUnload;
+    ULONG                       DriverInitFlags;
+    ULONG                       DriverPoolTag;
+} WDF_DRIVER_CONFIG;
+
+FORCEINLINE VOID
+WDF_DRIVER_CONFIG_INIT(
+    __out WDF_DRIVER_CONFIG *       Config,
+    __in PFN_WDF_DRIVER_DEVICE_ADD  EvtDriverDeviceAdd
+    )
+{
+    RtlZeroMemory(Config, sizeof(*Config));
+    Config->Size = sizeof(*Config);
+    Config->EvtDriverDeviceAdd = EvtDriverDeviceAdd;
+}
+
+NTSTATUS
+WdfDriverCreate(
+    __in PDRIVER_OBJECT             DriverObject,
+    __in PUNICODE_STRING            RegistryPath,
+    __in_opt WDF_OBJECT_ATTRIBUTES * DriverAttributes,
+    __in WDF_DRIVER_CONFIG *        DriverConfig,
+    __out_opt WDFDRIVER *           Driver
+    );
+
+/*
+ * device initialization
+ */
+typedef struct _WDF_PNPPOWER_EVENT_CALLBACKS
+{
+    ULONG                               Size;
+    PFN_WDF_DEVICE_D0_ENTRY             EvtDeviceD0Entry;
+    PFN_WDF_DEVICE_D0_EXIT              EvtDeviceD0Exit;
+    PFN_WDF_DEVICE_PREPARE_HARDWARE     EvtDevicePrepareHardware;
+    PFN_WDF_DEVICE_RELEASE_HARDWARE     EvtDeviceReleaseHardware;
+    PFN_WDF_DEVICE_SELF_MANAGED_IO_INIT EvtDeviceSelfManagedIoInit;
+    PFN_WDF_DEVICE_SURPRISE_REMOVAL     EvtDeviceSurpriseRemoval;
+} WDF_PNPPOWER_EVENT_CALLBACKS;
+
+FORCEINLINE VOID
+WDF_PNPPOWER_EVENT_CALLBACKS_INIT(
+    __out WDF_PNPPOWER_EVENT_CALLBACKS *    Callbacks
+    )
+{
+    RtlZeroMemory(Callbacks, sizeof(*Callbacks));
+    Callbacks->Size = sizeof(*Callbacks);
+}
+
+typedef struct _WDF_POWER_POLICY_EVENT_CALLBACKS
+{
+    ULONG                                   Size;
+    PFN_WDF_DEVICE_ARM_WAKE_FROM_S0         EvtDeviceArmWakeFromS0;
+    PFN_WDF_DEVICE_DISARM_WAKE_FROM_S0      EvtDeviceDisarmWakeFromS0;
+    PFN_WDF_DEVICE_WAKE_FROM_S0_TRIGGERED   EvtDeviceWakeFromS0Triggered;
+    PFN_WDF_DEVICE_ARM_WAKE_FROM_SX         EvtDeviceArmWakeFromSx;
+    PFN_WDF_DEVICE_DISARM_WAKE_FROM_SX      EvtDeviceDisarmWakeFromSx;
+    PFN_WDF_DEVICE_WAKE_FROM_SX_TRIGGERED   EvtDeviceWakeFromSxTriggered;
+} WDF_POWER_POLICY_EVENT_CALLBACKS;
+
+FORCEINLINE VOID
+WDF_POWER_POLICY_EVENT_CALLBACKS_INIT(
+    __out WDF_POWER_POLICY_EVENT_CALLBACKS *    Callbacks
+    )
+{
+    RtlZeroMemory(Callbacks, sizeof(*Callbacks));
+    Callbacks->Size = sizeof(*Callbacks);
+}
+
+typedef struct _WDF_FILEOBJECT_CONFIG
+{
+    ULONG                       Size;
+    PFN_WDF_DEVICE_FILE_CREATE  EvtDeviceFileCreate;
+    PFN_WDF_FILE_CLOSE          EvtFileClose;
+    PFN_WDF_FILE_CLEANUP        EvtFileCleanup;
+} WDF_FILEOBJECT_CONFIG;
+
+FORCEINLINE VOID
+WDF_FILEOBJECT_CONFIG_INIT(
+    __out WDF_FILEOBJECT_CONFIG *   FileEventCallbacks,
+    __in_opt PFN_WDF_DEVICE_FILE_CREATE EvtDeviceFileCreate,
+    __in_opt PFN_WDF_FILE_CLOSE     EvtFileClose,
+    __in_opt PFN_WDF_FILE_CLEANUP   EvtFileCleanup
+    )
+{
+    RtlZeroMemory(FileEventCallbacks, sizeof(*FileEventCallbacks));
+    FileEventCallbacks->Size = sizeof(*FileEventCallbacks);
+    FileEventCallbacks->EvtDeviceFileCreate = EvtDeviceFileCreate;
+    FileEventCallbacks->EvtFileClose = EvtFileClose;
+    FileEventCallbacks->EvtFileCleanup = EvtFileCleanup;
+}
+
+VOID
+WdfDeviceInitSetPnpPowerEventCallbacks(
+    __in PWDFDEVICE_INIT                DeviceInit,
+    __in WDF_PNPPOWER_EVENT_CALLBACKS * PnpPowerEventCallbacks
+    );
+
+VOID
+WdfDeviceInitSetPowerPolicyEventCallbacks(
+    __in PWDFDEVICE_INIT                    DeviceInit,
+    __in WDF_POWER_POLICY_EVENT_CALLBACKS * PowerPolicyEventCallbacks
+    );
+
+VOID
+WdfDeviceInitSetFileObjectConfig(
+    __in PWDFDEVICE_INIT                DeviceInit,
+    __in WDF_FILEOBJECT_CONFIG *        FileObjectConfig,
+    __in_opt WDF_OBJECT_ATTRIBUTES *    FileObjectAttributes
+    );
+
+VOID
+WdfDeviceInitSetIoInCallerContextCallback(
+    __in PWDFDEVICE_INIT                DeviceInit,
+    __in PFN_WDF_IO_IN_CALLER_CONTEXT   EvtIoInCallerContext
+    );
+
+/*
+ * device
+ */
+NTSTATUS
+WdfDeviceCreate(
+    __inout PWDFDEVICE_INIT *           DeviceInit,
+    __in_opt WDF_OBJECT_ATTRIBUTES *    DeviceAttributes,
+    __out WDFDEVICE *                   Device
+    );
+
+NTSTATUS
+WdfDeviceCreateDeviceInterface(
+    __in WDFDEVICE                      Device,
+    __in CONST GUID *                   InterfaceClassGUID,
+    __in_opt PUNICODE_STRING            ReferenceString
+    );
+
+PDEVICE_OBJECT
+WdfDeviceWdmGetPhysicalDevice(
+    __in WDFDEVICE                      Device
+    );
+
+NTSTATUS
+WdfFdoQueryForInterface(
+    __in WDFDEVICE                      Fdo,
+    __in LPCGUID                        InterfaceType,
+    __out PINTERFACE                    Interface,
+    __in USHORT                         Size,
+    __in USHORT                         Version,
+    __in_opt PVOID                      InterfaceSpecificData
+    );
+
+NTSTATUS
+WdfDeviceEnqueueRequest(
+    __in WDFDEVICE                      Device,
+    __in WDFREQUEST                     Request
+    );
+
+WDFDEVICE
+WdfFileObjectGetDevice(
+    __in WDFFILEOBJECT                  FileObject
+    );
+
+typedef enum _WDF_POWER_POLICY_S0_IDLE_CAPABILITIES
+{
+    IdleCapsInvalid = 0,
+    IdleCannotWakeFromS0,
+    IdleCanWakeFromS0,
+    IdleUsbSelectiveSuspend
+} WDF_POWER_POLICY_S0_IDLE_CAPABILITIES;
+
+typedef struct _WDF_DEVICE_POWER_POLICY_IDLE_SETTINGS
+{
+    ULONG                                   Size;
+    WDF_POWER_POLICY_S0_IDLE_CAPABILITIES   IdleCaps;
+    DEVICE_POWER_STATE                      DxState;
+    ULONG                                   IdleTimeout;
+    BOOLEAN                                 Enabled;
+} WDF_DEVICE_POWER_POLICY_IDLE_SETTINGS;
+
+FORCEINLINE VOID
+WDF_DEVICE_POWER_POLICY_IDLE_SETTINGS_INIT(
+    __out WDF_DEVICE_POWER_POLICY_IDLE_SETTINGS *   Settings,
+    __in WDF_POWER_POLICY_S0_IDLE_CAPABILITIES      IdleCaps
+    )
+{
+    RtlZeroMemory(Settings, sizeof(*Settings));
+    Settings->Size = sizeof(*Settings);
+    Settings->IdleCaps = IdleCaps;
+    Settings->DxState = PowerDeviceD3;
+    Settings->Enabled = TRUE;
+}
+
+typedef struct _WDF_DEVICE_POWER_POLICY_WAKE_SETTINGS
+{
+    ULONG                                   Size;
+    DEVICE_POWER_STATE                      DxState;
+    BOOLEAN                                 Enabled;
+} WDF_DEVICE_POWER_POLICY_WAKE_SETTINGS;
+
+FORCEINLINE VOID
+WDF_DEVICE_POWER_POLICY_WAKE_SETTINGS_INIT(
+    __out WDF_DEVICE_POWER_POLICY_WAKE_SETTINGS *   Settings
+    )
+{
+    RtlZeroMemory(Settings, sizeof(*Settings));
+    Settings->Size = sizeof(*Settings);
+    Settings->DxState = PowerDeviceD3;
+    Settings->Enabled = TRUE;
+}
+
+NTSTATUS
+WdfDeviceAssignS0IdleSettings(
+    __in WDFDEVICE                                  Device,
+    __in WDF_DEVICE_POWER_POLICY_IDLE_SETTINGS *    Settings
+    );
+
+NTSTATUS
+WdfDeviceAssignSxWakeSettings(
+    __in WDFDEVICE                                  Device,
+    __in WDF_DEVICE_POWER_POLICY_WAKE_SETTINGS *    Settings
+    );
+
+/*
+ * queues
+ */
+typedef enum _WDF_IO_QUEUE_DISPATCH_TYPE
+{
+    WdfIoQueueDispatchInvalid = 0,
+    WdfIoQueueDispatchSequential,
+    WdfIoQueueDispatchParallel,
+    WdfIoQueueDispatchManual
+} WDF_IO_QUEUE_DISPATCH_TYPE;
+
+typedef struct _WDF_IO_QUEUE_CONFIG
+{
+    ULONG                                       Size;
+    WDF_IO_QUEUE_DISPATCH_TYPE                  DispatchType;
+    BOOLEAN                                     DefaultQueue;
+    PFN_WDF_IO_QUEUE_IO_DEFAULT                 EvtIoDefault;
+    PFN_WDF_IO_QUEUE_IO_READ                    EvtIoRead;
+    PFN_WDF_IO_QUEUE_IO_WRITE                   EvtIoWrite;
+    PFN_WDF_IO_QUEUE_IO_DEVICE_CONTROL          EvtIoDeviceControl;
+    PFN_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL EvtIoInternalDeviceControl;
+    PFN_WDF_IO_QUEUE_IO_STOP                    EvtIoStop;
+} WDF_IO_QUEUE_CONFIG;
+
+FORCEINLINE VOID
+WDF_IO_QUEUE_CONFIG_INIT_DEFAULT_QUEUE(
+    __out WDF_IO_QUEUE_CONFIG *     Config,
+    __in WDF_IO_QUEUE_DISPATCH_TYPE DispatchType
+    )
+{
+    RtlZeroMemory(Config, sizeof(*Config));
+    Config->Size = sizeof(*Config);
+    Config->DispatchType = DispatchType;
+    Config->DefaultQueue = TRUE;
+}
+
+NTSTATUS
+WdfIoQueueCreate(
+    __in WDFDEVICE                      Device,
+    __in WDF_IO_QUEUE_CONFIG *          Config,
+    __in_opt WDF_OBJECT_ATTRIBUTES *    QueueAttributes,
+    __out_opt WDFQUEUE *                Queue
+    );
+
+WDFDEVICE
+WdfIoQueueGetDevice(
+    __in WDFQUEUE                       Queue
+    );
+
+/*
+ * requests
+ */
+typedef enum _WDF_REQUEST_TYPE
+{
+    WdfRequestTypeCreate = 0x0,
+    WdfRequestTypeClose = 0x2,
+    WdfRequestTypeRead = 0x3,
+    WdfRequestTypeWrite = 0x4,
+    WdfRequestTypeDeviceControl = 0xE,
+    WdfRequestTypeDeviceControlInternal = 0xF
+} WDF_REQUEST_TYPE;
+
+typedef struct _WDF_REQUEST_PARAMETERS
+{
+    USHORT              Size;
+    WDF_REQUEST_TYPE    Type;
+    union
+    {
+        struct
+        {
+            size_t      OutputBufferLength;
+            size_t      InputBufferLength;
+            ULONG       IoControlCode;
+            PVOID       Type3InputBuffer;
+        } DeviceIoControl;
+    } Parameters;
+} WDF_REQUEST_PARAMETERS;
+
+FORCEINLINE VOID
+WDF_REQUEST_PARAMETERS_INIT(
+    __out WDF_REQUEST_PARAMETERS *  Parameters
+    )
+{
+    RtlZeroMemory(Parameters, sizeof(*Parameters));
+    Parameters->Size = sizeof(*Parameters);
+}
+
+/*
+ * The driver passes typed pointers for the buffer out parameters, which
+ * MSVC converts to PVOID * silently and gcc does not.
+ */
+NTSTATUS
+HostWdfRequestRetrieveInputBuffer(
+    __in WDFREQUEST     Request,
+    __in size_t         MinimumRequiredLength,
+    __out PVOID *       Buffer,
+    __out_opt size_t *  Length
+    );
+
+NTSTATUS
+HostWdfRequestRetrieveOutputBuffer(
+    __in WDFREQUEST     Request,
+    __in size_t         MinimumRequiredSize,
+    __out PVOID *       Buffer,
+    __out_opt size_t *  Length
+    );
+
+#define WdfRequestRetrieveInputBuffer(Request, MinimumRequiredLength, Buffer, Length)  \
+    HostWdfRequestRetrieveInputBuffer((Request), (MinimumRequiredLength), (PVOID *) (Buffer), (Length))
+#define WdfRequestRetrieveOutputBuffer(Request, MinimumRequiredSize, Buffer, Length)   \
+    HostWdfRequestRetrieveOutputBuffer((Request), (MinimumRequiredSize), (PVOID *) (Buffer), (Length))
+
+VOID
+WdfRequestCompleteWithInformation(
+    __in WDFREQUEST     Request,
+    __in NTSTATUS       Status,
+    __in ULONG_PTR      Information
+    );
+
+#define WdfRequestComplete(Request, Status) \
+    WdfRequestCompleteWithInformation((Request), (Status), 0)
+
+VOID
+WdfRequestGetParameters(
+    __in WDFREQUEST                 Request,
+    __out WDF_REQUEST_PARAMETERS *  Parameters
+    );
+
+VOID
+WdfRequestStopAcknowledge(
+    __in WDFREQUEST     Request,
+    __in BOOLEAN        Requeue
+    );
+
+/*
+ * Name:  WDF_HOST_REQUEST
+ *
+ * Description:
+ *    A request as the harness builds it. For METHOD_BUFFERED codes the
+ *    driver sees one system buffer holding the input, copied back to
+ *    OutputBuffer on completion, as the I/O manager does; other codes see
+ *    the caller's buffers. Completion runs EvtComplete on the completing
+ *    thread, which may hold driver spin locks, so it must not block.
+ *    Completing a request twice aborts.
+ */
+typedef VOID WDF_HOST_REQUEST_COMPLETE(WDFREQUEST Request, PVOID Context);
+
+typedef struct _WDF_HOST_REQUEST
+{
+    WDF_REQUEST_TYPE                Type;
+    ULONG                           IoControlCode;
+    PVOID                           InputBuffer;
+    size_t                          InputBufferLength;
+    PVOID                           OutputBuffer;
+    size_t                          OutputBufferLength;
+    PVOID                           SystemBuffer;
+
+    WDF_HOST_REQUEST_COMPLETE *     EvtComplete;
+    PVOID                           CompleteContext;
+    volatile LONG                   Completed;
+    NTSTATUS                        Status;
+    ULONG_PTR                       Information;
+} WDF_HOST_REQUEST;
+
+/*
+ * the harness side
+ */
+NTSTATUS
+HostWdfRequestInit(
+    __out WDFREQUEST                    Request,
+    __in WDF_REQUEST_TYPE               Type,
+    __in ULONG                          IoControlCode,
+    __in_opt PVOID                      InputBuffer,
+    __in size_t                         InputBufferLength,
+    __out_opt PVOID                     OutputBuffer,
+    __in size_t                         OutputBufferLength,
+    __in_opt WDF_HOST_REQUEST_COMPLETE * EvtComplete,
+    __in_opt PVOID                      CompleteContext
+    );
+
+VOID
+HostWdfSendRequest(
+    __in WDFDEVICE                      Device,
+    __in WDFREQUEST                     Request
+    );
+
+NTSTATUS
+HostWdfAddDevice(
+    __out WDFDEVICE *                   Device
+    );
+
+NTSTATUS
+HostWdfStartDevice(
+    __in WDFDEVICE                      Device
+    );
+
+VOID
+HostWdfSurpriseRemoveDevice(
+    __in WDFDEVICE                      Device
+    );
+
+VOID
+HostWdfRemoveDevice(
+    __in WDFDEVICE                      Device
+    );
+
+#endif /* _LJB_HOST_WDF_H_ */
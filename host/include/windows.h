@@ -0,0 +1,361 @@
+/*!
+    \file       windows.h
+    \brief      Minimal Win32 stand-in for building portable modules on Linux
+    \details    Only what the pipeline library and the host tools use. This
+                header is never seen by the WDK build; it is found first on
+                the include path of host builds only (-I host/include).
+                Threads and events are built on pthreads, so host builds
+                that use them link with -pthread.
+ */
+
+#ifndef _LJB_HOST_WINDOWS_H_
+#define _LJB_HOST_WINDOWS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+/*
+ * basic types, LLP64 sized as on Windows
+ */
+#define VOID                void
+#define CONST               const
+typedef char                CHAR;
+typedef unsigned char       UCHAR;
+typedef unsigned char       BYTE;
+typedef unsigned char       BOOLEAN;
+typedef int16_t             SHORT;
+typedef uint16_t            USHORT;
+typedef uint16_t            WORD;
+typedef int32_t             INT;
+typedef uint32_t            UINT;
+typedef int32_t             LONG;
+typedef uint32_t            ULONG;
+typedef uint32_t            DWORD;
+typedef int                 BOOL;
+typedef int32_t             INT32;
+typedef uint32_t            UINT32;
+typedef int64_t             INT64;
+typedef uint64_t            UINT64;
+typedef int64_t             LONGLONG;
+typedef uint64_t            ULONGLONG;
+typedef int64_t             LONG64;
+typedef uint64_t            ULONG64;
+typedef uint8_t             UINT8;
+typedef uint16_t            UINT16;
+typedef intptr_t            LONG_PTR;
+typedef uintptr_t           ULONG_PTR;
+typedef size_t              SIZE_T;
+typedef void *              PVOID;
+typedef void *              LPVOID;
+typedef void *              HANDLE;
+typedef char *              PCHAR;
+typedef const char *        PCSTR;
+typedef UCHAR *             PUCHAR;
+typedef ULONG *             PULONG;
+
+typedef union _LARGE_INTEGER
+{
+    struct
+    {
+        DWORD   LowPart;
+        LONG    HighPart;
+    };
+    LONGLONG    QuadPart;
+} LARGE_INTEGER;
+
+#ifndef TRUE
+#define TRUE                1
+#endif
+#ifndef FALSE
+#define FALSE               0
+#endif
+
+#define FORCEINLINE         static inline
+#define WINAPI
+#define __cdecl
+
+#define UNREFERENCED_PARAMETER(P)           ((void) (P))
+#define DBG_UNREFERENCED_LOCAL_VARIABLE(V)  ((void) (V))
+
+/*
+ * interlocked operations, full barriers as on Windows
+ */
+#define InterlockedIncrement(p)             __sync_add_and_fetch((p), 1)
+#define InterlockedDecrement(p)             __sync_sub_and_fetch((p), 1)
+#define InterlockedExchangeAdd(p, v)        __sync_fetch_and_add((p), (v))
+#define InterlockedExchange(p, v)           __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define InterlockedCompareExchange(p, v, c) __sync_val_compare_and_swap((p), (c), (v))
+
+#if defined(__i386__) || defined(__x86_64__)
+#define YieldProcessor()                    __builtin_ia32_pause()
+#else
+#define YieldProcessor()                    __sync_synchronize()
+#endif
+
+/*
+ * SAL annotations
+ */
+#define IN
+#define OUT
+#define OPTIONAL
+#define _Use_decl_annotations_
+#define __in
+#define __in_opt
+#define __in_z
+#define __out
+#define __out_opt
+#define __inout
+#define __inout_opt
+#define __checkReturn
+#define __drv_aliasesMem
+#define __drv_formatString(x)
+#define __in_bcount(x)
+#define __out_bcount(x)
+#define __in_ecount(x)
+#define __out_ecount(x)
+#define __inout_ecount(x)
+
+/*
+ * memory
+ */
+#define RtlCopyMemory(d, s, l)      memcpy((d), (s), (l))
+#define RtlMoveMemory(d, s, l)      memmove((d), (s), (l))
+#define RtlZeroMemory(d, l)         memset((d), 0, (l))
+#define RtlFillMemory(d, l, f)      memset((d), (f), (l))
+#define FIELD_OFFSET(t, f)          ((LONG) offsetof(t, f))
+
+#define HEAP_ZERO_MEMORY            0x00000008
+
+FORCEINLINE HANDLE GetProcessHeap(VOID)
+{
+    return (HANDLE) 1;
+}
+
+FORCEINLINE PVOID HeapAlloc(HANDLE hHeap, DWORD dwFlags, SIZE_T dwBytes)
+{
+    (void) hHeap;
+    return (dwFlags & HEAP_ZERO_MEMORY) ? calloc(1, dwBytes) : malloc(dwBytes);
+}
+
+FORCEINLINE BOOL HeapFree(HANDLE hHeap, DWORD dwFlags, PVOID lpMem)
+{
+    (void) hHeap;
+    (void) dwFlags;
+    free(lpMem);
+    return TRUE;
+}
+
+/*
+ * processor features
+ */
+#define PF_XMMI64_INSTRUCTIONS_AVAILABLE    10
+
+FORCEINLINE BOOL IsProcessorFeaturePresent(DWORD ProcessorFeature)
+{
+#if defined(__SSE2__)
+    return ProcessorFeature == PF_XMMI64_INSTRUCTIONS_AVAILABLE;
+#else
+    (void) ProcessorFeature;
+    return FALSE;
+#endif
+}
+
+/*
+ * timing
+ */
+FORCEINLINE BOOL QueryPerformanceFrequency(LARGE_INTEGER * lpFrequency)
+{
+    lpFrequency->QuadPart = 1000000000LL;
+    return TRUE;
+}
+
+FORCEINLINE BOOL QueryPerformanceCounter(LARGE_INTEGER * lpPerformanceCount)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    lpPerformanceCount->QuadPart = (LONGLONG) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    return TRUE;
+}
+
+/*
+ * threads and events. A HANDLE is a refcounted object holding the signaled
+ * state; a thread's handle is a manual-reset event set when the thread
+ * returns. No named events, no WaitForMultipleObjects.
+ */
+#define INFINITE            0xFFFFFFFF
+#define WAIT_OBJECT_0       0
+#define WAIT_TIMEOUT        258
+
+typedef DWORD (WINAPI * LPTHREAD_START_ROUTINE)(LPVOID lpParameter);
+
+typedef struct _LJB_HOST_OBJECT
+{
+    pthread_mutex_t             Mutex;
+    pthread_cond_t              Cond;
+    LONG                        References;
+    BOOLEAN                     ManualReset;
+    BOOLEAN                     Signaled;
+    LPTHREAD_START_ROUTINE      StartAddress;
+    LPVOID                      Parameter;
+} LJB_HOST_OBJECT;
+
+FORCEINLINE VOID LjbHostRelease(LJB_HOST_OBJECT * Object)
+{
+    if (InterlockedDecrement(&Object->References) == 0)
+    {
+        pthread_cond_destroy(&Object->Cond);
+        pthread_mutex_destroy(&Object->Mutex);
+        free(Object);
+    }
+}
+
+FORCEINLINE HANDLE CreateEvent(PVOID lpEventAttributes, BOOL bManualReset, BOOL bInitialState, PCSTR lpName)
+{
+    LJB_HOST_OBJECT *   Object;
+
+    (void) lpEventAttributes;
+    if (lpName != NULL)
+        return NULL;
+    Object = calloc(1, sizeof(*Object));
+    if (Object == NULL)
+        return NULL;
+    pthread_mutex_init(&Object->Mutex, NULL);
+    pthread_cond_init(&Object->Cond, NULL);
+    Object->References = 1;
+    Object->ManualReset = bManualReset ? TRUE : FALSE;
+    Object->Signaled = bInitialState ? TRUE : FALSE;
+    return Object;
+}
+
+FORCEINLINE BOOL SetEvent(HANDLE hEvent)
+{
+    LJB_HOST_OBJECT * CONST Object = hEvent;
+
+    pthread_mutex_lock(&Object->Mutex);
+    Object->Signaled = TRUE;
+    pthread_cond_broadcast(&Object->Cond);
+    pthread_mutex_unlock(&Object->Mutex);
+    return TRUE;
+}
+
+FORCEINLINE BOOL ResetEvent(HANDLE hEvent)
+{
+    LJB_HOST_OBJECT * CONST Object = hEvent;
+
+    pthread_mutex_lock(&Object->Mutex);
+    Object->Signaled = FALSE;
+    pthread_mutex_unlock(&Object->Mutex);
+    return TRUE;
+}
+
+FORCEINLINE DWORD WaitForSingleObject(HANDLE hHandle, DWORD dwMilliseconds)
+{
+    LJB_HOST_OBJECT * CONST Object = hHandle;
+    struct timespec         Deadline;
+    DWORD                   Result = WAIT_OBJECT_0;
+
+    if (dwMilliseconds != INFINITE)
+    {
+        clock_gettime(CLOCK_REALTIME, &Deadline);
+        Deadline.tv_sec += dwMilliseconds / 1000;
+        Deadline.tv_nsec += (long) (dwMilliseconds % 1000) * 1000000L;
+        if (Deadline.tv_nsec >= 1000000000L)
+        {
+            Deadline.tv_sec++;
+            Deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&Object->Mutex);
+    while (!Object->Signaled)
+    {
+        if (dwMilliseconds == INFINITE)
+            pthread_cond_wait(&Object->Cond, &Object->Mutex);
+        else if (pthread_cond_timedwait(&Object->Cond, &Object->Mutex, &Deadline) != 0)
+        {
+            Result = WAIT_TIMEOUT;
+            break;
+        }
+    }
+    if (Result == WAIT_OBJECT_0 && !Object->ManualReset)
+        Object->Signaled = FALSE;
+    pthread_mutex_unlock(&Object->Mutex);
+    return Result;
+}
+
+FORCEINLINE void * LjbHostThreadStart(void * Context)
+{
+    LJB_HOST_OBJECT * CONST Object = Context;
+
+    Object->StartAddress(Object->Parameter);
+    SetEvent(Object);
+    LjbHostRelease(Object);
+    return NULL;
+}
+
+FORCEINLINE HANDLE CreateThread(
+    PVOID lpThreadAttributes,
+    SIZE_T dwStackSize,
+    LPTHREAD_START_ROUTINE lpStartAddress,
+    LPVOID lpParameter,
+    DWORD dwCreationFlags,
+    DWORD * lpThreadId
+    )
+{
+    LJB_HOST_OBJECT *   Object;
+    pthread_t           Thread;
+
+    (void) lpThreadAttributes;
+    (void) dwStackSize;
+    if (dwCreationFlags != 0)
+        return NULL;
+    Object = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Object == NULL)
+        return NULL;
+    Object->StartAddress = lpStartAddress;
+    Object->Parameter = lpParameter;
+    Object->References = 2;     // the handle and the thread
+    if (pthread_create(&Thread, NULL, &LjbHostThreadStart, Object) != 0)
+    {
+        Object->References = 1;
+        LjbHostRelease(Object);
+        return NULL;
+    }
+    pthread_detach(Thread);
+    if (lpThreadId != NULL)
+        *lpThreadId = 0;
+    return Object;
+}
+
+FORCEINLINE BOOL CloseHandle(HANDLE hObject)
+{
+    LjbHostRelease(hObject);
+    return TRUE;
+}
+
+FORCEINLINE BOOL SwitchToThread(VOID)
+{
+    return sched_yield() == 0;
+}
+
+typedef struct _SYSTEM_INFO
+{
+    DWORD       dwNumberOfProcessors;
+} SYSTEM_INFO;
+
+FORCEINLINE VOID GetSystemInfo(SYSTEM_INFO * lpSystemInfo)
+{
+    long    Processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+    lpSystemInfo->dwNumberOfProcessors = (Processors > 0) ? (DWORD) Processors : 1;
+}
+
+#endif /* _LJB_HOST_WINDOWS_H_ */
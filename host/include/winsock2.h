@@ -0,0 +1,118 @@
+/*!
+    \file       winsock2.h
+    \brief      Minimal Winsock stand-in for building portable modules on Linux
+    \details    Only what the pipeline library and the host tools use, on
+                BSD sockets. A SOCKET is a file descriptor. WSASend gathers
+                with sendmsg and never raises SIGPIPE. Address lengths are
+                int, as in Winsock.
+ */
+
+#ifndef _LJB_HOST_WINSOCK2_H_
+#define _LJB_HOST_WINSOCK2_H_
+
+#include <windows.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+typedef int                 SOCKET;
+
+#define INVALID_SOCKET      (-1)
+#define SOCKET_ERROR        (-1)
+#define SD_BOTH             SHUT_RDWR
+#define MAKEWORD(a, b)      ((WORD) (((BYTE) (a)) | (((WORD) (BYTE) (b)) << 8)))
+
+typedef struct _WSABUF
+{
+    ULONG       len;
+    CHAR *      buf;
+} WSABUF, *LPWSABUF;
+
+typedef struct WSAData
+{
+    WORD        wVersion;
+    WORD        wHighVersion;
+} WSADATA;
+
+#define accept(s, a, l)         accept((s), (a), (socklen_t *) (l))
+#define getsockname(s, a, l)    getsockname((s), (a), (socklen_t *) (l))
+#define recvfrom(s, b, n, f, a, l) recvfrom((s), (b), (n), (f), (a), (socklen_t *) (l))
+#define getsockopt(s, v, o, b, l) getsockopt((s), (v), (o), (b), (socklen_t *) (l))
+
+FORCEINLINE int WSAStartup(WORD wVersionRequested, WSADATA * lpWSAData)
+{
+    lpWSAData->wVersion = wVersionRequested;
+    lpWSAData->wHighVersion = wVersionRequested;
+    return 0;
+}
+
+FORCEINLINE int WSACleanup(VOID)
+{
+    return 0;
+}
+
+FORCEINLINE int WSAGetLastError(VOID)
+{
+    return errno;
+}
+
+FORCEINLINE int closesocket(SOCKET s)
+{
+    return close(s);
+}
+
+FORCEINLINE int ioctlsocket(SOCKET s, long cmd, u_long * argp)
+{
+    int         Value = (int) *argp;
+
+    if (ioctl(s, cmd, &Value) < 0)
+        return SOCKET_ERROR;
+    *argp = (u_long) Value;
+    return 0;
+}
+
+#define LJB_HOST_MAX_WSABUF 1024
+
+FORCEINLINE int WSASend(
+    SOCKET s,
+    LPWSABUF lpBuffers,
+    DWORD dwBufferCount,
+    DWORD * lpNumberOfBytesSent,
+    DWORD dwFlags,
+    PVOID lpOverlapped,
+    PVOID lpCompletionRoutine
+    )
+{
+    struct iovec    Vectors[LJB_HOST_MAX_WSABUF];
+    struct msghdr   Message;
+    ssize_t         Sent;
+    DWORD           i;
+
+    if (dwBufferCount > LJB_HOST_MAX_WSABUF || lpOverlapped != NULL || lpCompletionRoutine != NULL)
+    {
+        errno = EINVAL;
+        return SOCKET_ERROR;
+    }
+    for (i = 0; i < dwBufferCount; i++)
+    {
+        Vectors[i].iov_base = lpBuffers[i].buf;
+        Vectors[i].iov_len = lpBuffers[i].len;
+    }
+    memset(&Message, 0, sizeof(Message));
+    Message.msg_iov = Vectors;
+    Message.msg_iovlen = dwBufferCount;
+
+    Sent = sendmsg(s, &Message, (int) dwFlags | MSG_NOSIGNAL);
+    if (Sent < 0)
+        return SOCKET_ERROR;
+    *lpNumberOfBytesSent = (DWORD) Sent;
+    return 0;
+}
+
+#endif /* _LJB_HOST_WINSOCK2_H_ */
@@ -0,0 +1,7 @@
+/*!
+    \file       wmilib.h
+    \brief      Empty WMI library stand-in for host builds
+    \details    ljb_vmon_private.h includes it, but nothing the host builds of
+                func/source compile uses it; ljb_vmon_wmi.c is left out of
+                them.
+ */
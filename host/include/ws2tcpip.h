@@ -0,0 +1,14 @@
+/*!
+    \file       ws2tcpip.h
+    \brief      Minimal Winsock TCP/IP stand-in for building on Linux
+    \details    Name resolution and IP level socket options.
+ */
+
+#ifndef _LJB_HOST_WS2TCPIP_H_
+#define _LJB_HOST_WS2TCPIP_H_
+
+#include <winsock2.h>
+#include <netdb.h>
+#include <netinet/ip.h>
+
+#endif /* _LJB_HOST_WS2TCPIP_H_ */
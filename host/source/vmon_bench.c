@@ -0,0 +1,3275 @@
+/*!
+    \file       vmon_bench.c
+    \brief      Host benchmark and self-check for the pipeline library
+    \details    Builds and runs on Linux against host/include/windows.h:
+
+                gcc -std=gnu89 -O2 -Wall -Wno-unknown-pragmas -pthread \
+                    -Ihost/include -Iinclude -Ipipeline/source \
+                    host/source/vmon_bench.c pipeline/source/ljb_vmon_cursor.c \
+                    pipeline/source/ljb_vmon_damage.c \
+                    pipeline/source/ljb_vmon_edid.c \
+                    pipeline/source/ljb_vmon_motion.c \
+                    pipeline/source/ljb_vmon_net_receiver.c \
+                    pipeline/source/ljb_vmon_net_sink.c \
+                    pipeline/source/ljb_vmon_sink.c \
+                    pipeline/source/ljb_vmon_tile_encoder.c \
+                    pipeline/source/ljb_vmon_tile_dct.c \
+                    pipeline/source/ljb_vmon_tile_decoder.c \
+                    pipeline/source/ljb_vmon_usb_loopback.c \
+                    pipeline/source/ljb_vmon_usb_sink.c \
+                    pipeline/source/ljb_vmon_workload.c \
+                    -lm -o vmon_bench
+
+                vmon_bench [cursor|workload|damage|motion|codec|lossy|scaling|
+                            net|usb|credit|edid] [-n iterations]
+
+                Every suite first checks its optimized kernels against a
+                scalar reference and exits with status 1 on any mismatch, then
+                prints one JSON object per measurement.
+ */
+
+#include <winsock2.h>
+#include <windows.h>
+#include <math.h>
+#include "ljb_vmon_ioctl.h"
+#include "ljb_vmon_cursor.h"
+#include "ljb_vmon_damage.h"
+#include "ljb_vmon_edid.h"
+#include "ljb_vmon_motion.h"
+#include "ljb_vmon_net.h"
+#include "ljb_vmon_tile_codec.h"
+#include "ljb_vmon_usb.h"
+#include "ljb_vmon_workload.h"
+
+#define SURFACE_WIDTH       1920
+#define SURFACE_HEIGHT      1080
+
+static UINT32   RandomState = 0x12345678;
+
+static UINT32
+BenchRandom(VOID)
+{
+    RandomState ^= RandomState << 13;
+    RandomState ^= RandomState >> 17;
+    RandomState ^= RandomState << 5;
+    return RandomState;
+}
+
+static double
+BenchNow(VOID)
+{
+    LARGE_INTEGER   Counter;
+    LARGE_INTEGER   Frequency;
+
+    QueryPerformanceCounter(&Counter);
+    QueryPerformanceFrequency(&Frequency);
+    return (double) Counter.QuadPart / (double) Frequency.QuadPart;
+}
+
+static VOID
+FillRandom(
+    __out UCHAR *   Buffer,
+    __in SIZE_T     Size
+    )
+{
+    SIZE_T  i;
+
+    for (i = 0; i < Size; i++)
+        Buffer[i] = (UCHAR) BenchRandom();
+}
+
+/*
+ * Build a cursor shape of the given DXGK format. Color cursors get a mix of
+ * fully transparent, fully opaque and partially transparent pixels, which is
+ * what real cursors with anti-aliased edges look like.
+ */
+static VOID
+MakeShape(
+    __out POINTER_SHAPE_DATA *  Shape,
+    __in UINT                   Format,
+    __in UINT                   Size
+    )
+{
+    UINT    i;
+
+    RtlZeroMemory(Shape, sizeof(*Shape));
+    Shape->Flags.Value = Format;
+    Shape->Width = Size;
+    Shape->Height = Size;
+    if (Format == 1)
+    {
+        Shape->Pitch = (Size + 7) / 8;
+        FillRandom(Shape->Buffer, Shape->Pitch * Size * 2);
+        return;
+    }
+
+    Shape->Pitch = Size * 4;
+    FillRandom(Shape->Buffer, Shape->Pitch * Size);
+    for (i = 0; i < Size * Size; i++)
+    {
+        UCHAR * CONST   pA = &Shape->Buffer[i * 4 + 3];
+
+        if (Format == 4)
+            *pA = (*pA & 1) ? 0xFF : 0;
+        else if (*pA < 64)
+            *pA = 0;
+        else if (*pA > 192)
+            *pA = 0xFF;
+    }
+}
+
+/*
+ * The cursor compositing routine as it was in ljb_vmon_pixel_main.c before
+ * the compositor module, kept verbatim apart from its parameters so the new
+ * kernels can be checked against it.
+ */
+static VOID
+LegacyDrawCursor(
+    __in POINTER_SHAPE_DATA *   PointerShapeData,
+    __in INT                    PosX,
+    __in INT                    PosY,
+    __inout PVOID               FrameBuffer,
+    __in UINT32                 SurfaceWidth,
+    __in UINT32                 SurfaceHeight
+    )
+{
+    HANDLE CONST    hDefaultHeap = GetProcessHeap();
+    UINT32 CONST    SurfacePitch = SurfaceWidth * 4;
+    INT             CurPosX;
+    INT             CurPosY;
+    UINT            CurWidth;
+    UINT            CurHeight;
+    UINT            CurPitch;
+    UINT            ShadowCursorWidth;
+    UINT            ShadowCursorHeight;
+    UCHAR *         pCurBitmap;
+    UCHAR *         pFinalBlendCurBuffer;
+    UCHAR *         pFinalBlendCurBufferStart;
+    UCHAR *         pOrigSurfPos;
+    UCHAR *         ShadowBitmapPosition;
+    UINT            row;
+
+    CurPosX = PosX;
+    CurPosY = PosY;
+
+    if (CurPosX > 0)
+    {
+       if ((UINT)CurPosX >= SurfaceWidth)
+           return;
+    }
+    if (CurPosY > 0)
+    {
+       if ((UINT)CurPosY >= SurfaceHeight)
+           return;
+    }
+
+    CurWidth    = PointerShapeData->Width;
+    CurHeight   = PointerShapeData->Height;
+    CurPitch    = PointerShapeData->Pitch;
+
+    ShadowCursorWidth = CurWidth;
+    ShadowCursorHeight= CurHeight;
+    pCurBitmap  = PointerShapeData->Buffer;
+
+    if (CurPosX >= 0)
+    {
+        if ((CurPosX + CurWidth) >= (SurfaceWidth - 1))
+            ShadowCursorWidth = SurfaceWidth - 1 - CurPosX;
+    }
+    else
+    {
+        ShadowCursorWidth = CurWidth + CurPosX;
+        CurPosX = 0;
+    }
+
+    if (CurPosY >= 0)
+    {
+        if ((CurPosY + CurHeight) >= (SurfaceHeight - 1))
+            ShadowCursorHeight = SurfaceHeight - 1 - CurPosY;
+    }
+    else
+    {
+        ShadowCursorHeight = CurHeight + CurPosY;
+        CurPosY = 0;
+    }
+
+    if (ShadowCursorWidth == 0 || ShadowCursorHeight == 0 || ShadowCursorWidth > CurWidth || ShadowCursorHeight > CurHeight)
+    {
+        return;
+    }
+
+    pFinalBlendCurBufferStart = HeapAlloc(
+        hDefaultHeap,
+        HEAP_ZERO_MEMORY,
+        ShadowCursorWidth * ShadowCursorHeight * 4
+        );
+    if (pFinalBlendCurBufferStart == NULL)
+        return;
+
+    pFinalBlendCurBuffer = pFinalBlendCurBufferStart;
+    ShadowBitmapPosition= (UCHAR *)FrameBuffer + CurPosY * SurfacePitch + CurPosX * 4;
+    pOrigSurfPos = ShadowBitmapPosition;
+
+    if (PointerShapeData->Flags.Value == 1)
+    {
+        UCHAR * pANDMask;
+        UCHAR * pXORMask;
+        UINT iByte;
+        UINT iBit;
+
+        for(row = 0; row < ShadowCursorHeight; row++)
+        {
+            pANDMask = pCurBitmap;
+            pXORMask = pCurBitmap + CurHeight * CurPitch;
+            for (iByte = 0, iBit = 7; iByte < ShadowCursorWidth * 4; iByte +=4, iBit--)
+                {
+                if ((*pANDMask >> iBit) & 1)
+                {
+                    *((ULONG *) (pFinalBlendCurBuffer + iByte)) =
+                        *((ULONG *) (pOrigSurfPos + iByte)) & 0xFFFFFFFF;
+                }
+                else
+                {
+                    *((ULONG *) (pFinalBlendCurBuffer + iByte)) =
+                        *((ULONG *) (pOrigSurfPos + iByte)) & 0;
+                }
+
+                if ((*pXORMask >> iBit) & 1)
+                {
+                    *((ULONG *) (pFinalBlendCurBuffer + iByte)) ^= 0xFFFFFFFF;
+                }
+                else
+                {
+                    *((ULONG *) (pFinalBlendCurBuffer + iByte)) ^= 0;
+                }
+
+                if (iBit == 0)
+                {
+                    pANDMask++;
+                    pXORMask++;
+                    iBit = 8;
+                }
+            }
+            pOrigSurfPos += SurfaceWidth * 4;
+            pFinalBlendCurBuffer += ShadowCursorWidth * 4;
+            pCurBitmap += CurPitch;
+        }
+    }
+    else
+    {
+        UCHAR CurA;
+        SIZE_T AbsCurPosX;
+        SIZE_T AbsCurPosY;
+        UINT i;
+
+        CurPosX = PosX;
+        CurPosY = PosY;
+
+        AbsCurPosX = abs(CurPosX);
+        AbsCurPosY = abs(CurPosY);
+
+        if (CurPosX < 0 && CurPosY < 0)
+        {
+            pCurBitmap += AbsCurPosY * CurPitch + AbsCurPosX * 4;
+        }
+
+        else if (CurPosX < 0)
+        {
+            pCurBitmap += AbsCurPosX * 4;
+        }
+
+        else if (CurPosY < 0)
+        {
+            pCurBitmap += AbsCurPosY * CurPitch;
+        }
+
+        if (PointerShapeData->Flags.Value == 2)
+        {
+            UCHAR CurR, CurG, CurB;
+            UCHAR SurfR, SurfG, SurfB;
+
+            for(row = 0; row < ShadowCursorHeight; ++row)
+            {
+                for (i = 0; i < ShadowCursorWidth * 4; i +=4)
+                {
+                    SurfB = pOrigSurfPos[i];
+                    SurfG = pOrigSurfPos[i + 1];
+                    SurfR = pOrigSurfPos[i + 2];
+
+                    CurB = pCurBitmap[i];
+                    CurG = pCurBitmap[i + 1];
+                    CurR = pCurBitmap[i + 2];
+                    CurA = pCurBitmap[i + 3];
+
+                    pFinalBlendCurBuffer[i] = SurfB + (((CurB - SurfB) * CurA) / 255);
+                    pFinalBlendCurBuffer[i + 1] = SurfG + (((CurG - SurfG) * CurA) / 255);
+                    pFinalBlendCurBuffer[i + 2] = SurfR + (((CurR - SurfR) * CurA) / 255);
+                    pFinalBlendCurBuffer[i + 3] = pOrigSurfPos[i + 3];
+                }
+                pOrigSurfPos += SurfaceWidth * 4;
+                pCurBitmap += CurPitch;
+                pFinalBlendCurBuffer += ShadowCursorWidth * 4;
+            }
+        }
+
+        if (PointerShapeData->Flags.Value == 4)
+        {
+            for(row = 0; row < ShadowCursorHeight; ++row)
+            {
+                for (i = 0; i < ShadowCursorWidth * 4; i +=4)
+                {
+                    CurA = pCurBitmap[i + 3];
+                    if (CurA == 0)
+                    {
+                        *((ULONG *) (pFinalBlendCurBuffer + i)) =
+                            *((ULONG *) (pCurBitmap + i));
+                    }
+                    else
+                    {
+                        *((ULONG *) (pFinalBlendCurBuffer + i)) =
+                            *((ULONG *) (pOrigSurfPos + i)) ^ *((ULONG *) (pCurBitmap + i));
+                    }
+                    pFinalBlendCurBuffer[i+3] = pOrigSurfPos[i+3];
+                }
+                pCurBitmap += CurPitch;
+                pOrigSurfPos += SurfaceWidth * 4;
+                pFinalBlendCurBuffer += ShadowCursorWidth *4;
+            }
+        }
+    }
+
+    pOrigSurfPos = ShadowBitmapPosition;
+    pFinalBlendCurBuffer = pFinalBlendCurBufferStart;
+    for(row = 0; row < ShadowCursorHeight; ++row)
+    {
+        RtlCopyMemory(
+            pOrigSurfPos,
+            pFinalBlendCurBuffer,
+            ShadowCursorWidth * 4
+            );
+        pOrigSurfPos += SurfaceWidth * 4;
+        pFinalBlendCurBuffer += ShadowCursorWidth * 4;
+    }
+
+    HeapFree(hDefaultHeap, 0 , pFinalBlendCurBufferStart);
+}
+
+static CONST CHAR *
+FormatName(
+    __in UINT   Format
+    )
+{
+    switch (Format)
+    {
+    case 1:     return "monochrome";
+    case 2:     return "color";
+    case 4:     return "masked_color";
+    default:    return "unknown";
+    }
+}
+
+static UINT CONST   CursorFormats[] = { 1, 2, 4 };
+static UINT CONST   CursorSizes[] = { 32, 64, 256 };
+
+#define ARRAY_COUNT(a)  (sizeof(a) / sizeof((a)[0]))
+
+/*
+ * Compare the SSE2 and scalar compositor paths with each other at every kind
+ * of position, including all four edges and corners, and with the legacy
+ * routine wherever the legacy routine clipped correctly: fully inside the
+ * surface and not touching the last column/row, plus negative positions for
+ * the 32bpp formats.
+ */
+static BOOLEAN
+CursorSelfCheck(
+    __in LJB_VMON_CURSOR_COMPOSITOR *   Compositor,
+    __in POINTER_SHAPE_DATA *           Shape,
+    __in UCHAR *                        Original,
+    __in UCHAR *                        FrameA,
+    __in UCHAR *                        FrameB
+    )
+{
+    SIZE_T CONST    FrameSize = (SIZE_T) SURFACE_WIDTH * SURFACE_HEIGHT * 4;
+    BOOLEAN CONST   HasSse2 = Compositor->UseSse2;
+    UINT            f, s, i;
+    INT             PosX, PosY;
+    BOOLEAN         LegacyComparable;
+
+    for (f = 0; f < ARRAY_COUNT(CursorFormats); f++)
+    for (s = 0; s < ARRAY_COUNT(CursorSizes); s++)
+    {
+        INT CONST   Size = (INT) CursorSizes[s];
+        INT CONST   EdgeX[] = { -Size + 1, -Size / 2, -1, 0, 1, 17,
+                                SURFACE_WIDTH - Size - 2, SURFACE_WIDTH - Size - 1,
+                                SURFACE_WIDTH - Size, SURFACE_WIDTH - 1 };
+        INT CONST   EdgeY[] = { -Size + 1, -Size / 2, -1, 0, 1, 9,
+                                SURFACE_HEIGHT - Size - 2, SURFACE_HEIGHT - Size - 1,
+                                SURFACE_HEIGHT - Size, SURFACE_HEIGHT - 1 };
+
+        MakeShape(Shape, CursorFormats[f], CursorSizes[s]);
+        LJB_VMON_CursorSetShape(Compositor, Shape);
+
+        for (i = 0; i < ARRAY_COUNT(EdgeX) * ARRAY_COUNT(EdgeY) + 64; i++)
+        {
+            if (i < ARRAY_COUNT(EdgeX) * ARRAY_COUNT(EdgeY))
+            {
+                PosX = EdgeX[i % ARRAY_COUNT(EdgeX)];
+                PosY = EdgeY[i / ARRAY_COUNT(EdgeX)];
+            }
+            else
+            {
+                PosX = (INT) (BenchRandom() % (SURFACE_WIDTH - Size - 1));
+                PosY = (INT) (BenchRandom() % (SURFACE_HEIGHT - Size - 1));
+            }
+
+            RtlCopyMemory(FrameA, Original, FrameSize);
+            RtlCopyMemory(FrameB, Original, FrameSize);
+
+            Compositor->UseSse2 = FALSE;
+            LJB_VMON_CursorDraw(Compositor, PosX, PosY, FrameA, SURFACE_WIDTH, SURFACE_HEIGHT);
+            LJB_VMON_CursorDiscardSave(Compositor);
+            Compositor->UseSse2 = HasSse2;
+            LJB_VMON_CursorDraw(Compositor, PosX, PosY, FrameB, SURFACE_WIDTH, SURFACE_HEIGHT);
+            if (memcmp(FrameA, FrameB, FrameSize) != 0)
+            {
+                fprintf(stderr, "cursor: %s %dx%d at (%d, %d): SSE2 differs from scalar\n",
+                    FormatName(CursorFormats[f]), Size, Size, PosX, PosY);
+                return FALSE;
+            }
+
+            LJB_VMON_CursorRestore(Compositor);
+            if (memcmp(FrameB, Original, FrameSize) != 0)
+            {
+                fprintf(stderr, "cursor: %s %dx%d at (%d, %d): restore incomplete\n",
+                    FormatName(CursorFormats[f]), Size, Size, PosX, PosY);
+                return FALSE;
+            }
+
+            LegacyComparable =
+                PosX + Size < SURFACE_WIDTH - 1 &&
+                PosY + Size < SURFACE_HEIGHT - 1 &&
+                ((PosX >= 0 && PosY >= 0) || CursorFormats[f] != 1);
+            if (!LegacyComparable)
+                continue;
+
+            RtlCopyMemory(FrameB, Original, FrameSize);
+            LegacyDrawCursor(Shape, PosX, PosY, FrameB, SURFACE_WIDTH, SURFACE_HEIGHT);
+            if (memcmp(FrameA, FrameB, FrameSize) != 0)
+            {
+                fprintf(stderr, "cursor: %s %dx%d at (%d, %d): differs from legacy routine\n",
+                    FormatName(CursorFormats[f]), Size, Size, PosX, PosY);
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+static VOID
+CursorBenchOne(
+    __in LJB_VMON_CURSOR_COMPOSITOR *   Compositor,
+    __in POINTER_SHAPE_DATA *           Shape,
+    __in UCHAR *                        Frame,
+    __in CONST CHAR *                   Kernel,
+    __in UINT                           Iterations
+    )
+{
+    UINT CONST  Size = Shape->Width;
+    double      Start, Elapsed;
+    UINT        i;
+    INT         PosX, PosY;
+
+    Start = BenchNow();
+    for (i = 0; i < Iterations; i++)
+    {
+        PosX = (INT) ((i * 37) % (SURFACE_WIDTH - Size - 1));
+        PosY = (INT) ((i * 11) % (SURFACE_HEIGHT - Size - 1));
+        if (Kernel[0] == 'l')
+        {
+            LegacyDrawCursor(Shape, PosX, PosY, Frame, SURFACE_WIDTH, SURFACE_HEIGHT);
+        }
+        else
+        {
+            LJB_VMON_CursorDraw(Compositor, PosX, PosY, Frame, SURFACE_WIDTH, SURFACE_HEIGHT);
+            LJB_VMON_CursorRestore(Compositor);
+        }
+    }
+    Elapsed = BenchNow() - Start;
+
+    printf("{\"suite\":\"cursor\",\"format\":\"%s\",\"size\":%u,\"kernel\":\"%s\","
+        "\"iterations\":%u,\"ns_per_draw\":%.1f,\"mpixels_per_sec\":%.1f}\n",
+        FormatName(Shape->Flags.Value),
+        Size,
+        Kernel,
+        Iterations,
+        Elapsed * 1e9 / Iterations,
+        (double) Size * Size * Iterations / Elapsed / 1e6);
+}
+
+/*
+ * Cursor compositing: legacy routine vs. compositor scalar vs. compositor
+ * SSE2 for each format at 32x32, 64x64 and 256x256. Compositor timings
+ * include saving and restoring the pixels under the cursor, which the
+ * legacy routine also did on every draw.
+ */
+static int
+CursorSuite(
+    __in UINT   Iterations
+    )
+{
+    SIZE_T CONST                FrameSize = (SIZE_T) SURFACE_WIDTH * SURFACE_HEIGHT * 4;
+    LJB_VMON_CURSOR_COMPOSITOR  Compositor;
+    POINTER_SHAPE_DATA *        Shape;
+    UCHAR *                     Original;
+    UCHAR *                     FrameA;
+    UCHAR *                     FrameB;
+    BOOLEAN                     HasSse2;
+    BOOLEAN                     Passed;
+    UINT                        f, s;
+
+    Shape = malloc(sizeof(*Shape));
+    Original = malloc(FrameSize);
+    FrameA = malloc(FrameSize);
+    FrameB = malloc(FrameSize);
+    if (Shape == NULL || Original == NULL || FrameA == NULL || FrameB == NULL ||
+        !LJB_VMON_CursorInit(&Compositor))
+    {
+        fprintf(stderr, "cursor: out of memory\n");
+        return 1;
+    }
+    FillRandom(Original, FrameSize);
+    HasSse2 = Compositor.UseSse2;
+
+    Passed = CursorSelfCheck(&Compositor, Shape, Original, FrameA, FrameB);
+    if (Passed)
+    {
+        RtlCopyMemory(FrameA, Original, FrameSize);
+        for (f = 0; f < ARRAY_COUNT(CursorFormats); f++)
+        for (s = 0; s < ARRAY_COUNT(CursorSizes); s++)
+        {
+            UINT CONST  Count = Iterations * 32 / CursorSizes[s] * 32 / CursorSizes[s];
+
+            MakeShape(Shape, CursorFormats[f], CursorSizes[s]);
+            LJB_VMON_CursorSetShape(&Compositor, Shape);
+
+            CursorBenchOne(&Compositor, Shape, FrameA, "legacy", Count ? Count : 1);
+            Compositor.UseSse2 = FALSE;
+            CursorBenchOne(&Compositor, Shape, FrameA, "scalar", Count ? Count : 1);
+            Compositor.UseSse2 = HasSse2;
+            if (HasSse2)
+                CursorBenchOne(&Compositor, Shape, FrameA, "sse2", Count ? Count : 1);
+        }
+    }
+
+    LJB_VMON_CursorDeInit(&Compositor);
+    free(FrameB);
+    free(FrameA);
+    free(Original);
+    free(Shape);
+    return Passed ? 0 : 1;
+}
+
+/*
+ * Check one present of a workload against the frame before it: every pixel
+ * that changed must be inside the reported damage, and a reported move must
+ * reproduce the moved pixels exactly.
+ */
+static BOOLEAN
+WorkloadCheckFrame(
+    __in CONST LJB_VMON_WORKLOAD_FRAME *    Frame,
+    __in CONST ULONG *                      Previous,
+    __in CONST ULONG *                      Current,
+    __out ULONG64 *                         ChangedPixels
+    )
+{
+    CONST LJB_VMON_RECT *   Move = &Frame->MoveRect;
+    UINT                    x, y, i;
+    BOOLEAN                 Covered;
+
+    *ChangedPixels = 0;
+    for (y = 0; y < SURFACE_HEIGHT; y++)
+    {
+        CONST ULONG * CONST Old = Previous + (SIZE_T) y * SURFACE_WIDTH;
+        CONST ULONG * CONST New = Current + (SIZE_T) y * SURFACE_WIDTH;
+
+        if (memcmp(Old, New, SURFACE_WIDTH * 4) == 0)
+            continue;
+        for (x = 0; x < SURFACE_WIDTH; x++)
+        {
+            if (Old[x] == New[x])
+                continue;
+            (*ChangedPixels)++;
+            Covered = FALSE;
+            for (i = 0; i < Frame->Damage.NumRects && !Covered; i++)
+            {
+                CONST LJB_VMON_RECT * CONST Rect = &Frame->Damage.Rects[i];
+
+                Covered = (BOOLEAN) (
+                    (LONG) x >= Rect->Left && (LONG) x < Rect->Right &&
+                    (LONG) y >= Rect->Top && (LONG) y < Rect->Bottom);
+            }
+            if (!Covered)
+            {
+                fprintf(stderr, "frame %lu: pixel (%u, %u) changed outside the damage\n",
+                    (unsigned long) Frame->FrameIndex, x, y);
+                return FALSE;
+            }
+        }
+    }
+
+    if (!Frame->HasMove)
+        return TRUE;
+    for (y = (UINT) Move->Top; y < (UINT) Move->Bottom; y++)
+    {
+        if (memcmp(
+                Current + (SIZE_T) y * SURFACE_WIDTH + Move->Left,
+                Previous + (SIZE_T) (y - Frame->MoveDy) * SURFACE_WIDTH + Move->Left - Frame->MoveDx,
+                (SIZE_T) (Move->Right - Move->Left) * 4) != 0)
+        {
+            fprintf(stderr, "frame %lu: row %u does not match the reported move\n",
+                (unsigned long) Frame->FrameIndex, y);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * Synthetic desktop workloads: for each kind, check the reported damage
+ * and moves of every present against the pixels, check that a second
+ * instance with the same seed paints the same frames, then time painting
+ * alone. Iterations / 20 presents per kind, 1000 by default.
+ */
+static int
+WorkloadSuite(
+    __in UINT   Iterations
+    )
+{
+    SIZE_T CONST            FrameSize = (SIZE_T) SURFACE_WIDTH * SURFACE_HEIGHT * 4;
+    UINT CONST              Frames = Iterations / 20 ? Iterations / 20 : 1;
+    LJB_VMON_WORKLOAD       Workload;
+    LJB_VMON_WORKLOAD       Replay;
+    LJB_VMON_WORKLOAD_FRAME Frame;
+    LJB_VMON_WORKLOAD_FRAME ReplayFrame;
+    ULONG *                 Current;
+    ULONG *                 Previous;
+    ULONG *                 Other;
+    ULONG64                 Changed;
+    ULONG64                 ChangedPixels;
+    ULONG64                 DamagedPixels;
+    UINT                    DamagedFrames;
+    UINT                    Moves;
+    double                  Start, Elapsed;
+    BOOLEAN                 Passed;
+    UINT                    k, i;
+
+    Current = malloc(FrameSize);
+    Previous = malloc(FrameSize);
+    Other = malloc(FrameSize);
+    if (Current == NULL || Previous == NULL || Other == NULL)
+    {
+        fprintf(stderr, "workload: out of memory\n");
+        return 1;
+    }
+
+    Passed = TRUE;
+    for (k = 0; k < LJB_VMON_WORKLOAD_COUNT && Passed; k++)
+    {
+        if (!LJB_VMON_WorkloadInit(&Workload, k, SURFACE_WIDTH, SURFACE_HEIGHT, 1) ||
+            !LJB_VMON_WorkloadInit(&Replay, k, SURFACE_WIDTH, SURFACE_HEIGHT, 1))
+        {
+            fprintf(stderr, "workload: out of memory\n");
+            Passed = FALSE;
+            break;
+        }
+
+        /*
+         * fill with something the first present has to overwrite
+         */
+        FillRandom((UCHAR *) Current, FrameSize);
+        FillRandom((UCHAR *) Other, FrameSize);
+        ChangedPixels = 0;
+        DamagedPixels = 0;
+        DamagedFrames = 0;
+        Moves = 0;
+        for (i = 0; i < Frames && Passed; i++)
+        {
+            RtlCopyMemory(Previous, Current, FrameSize);
+            LJB_VMON_WorkloadNextFrame(&Workload, Current, SURFACE_WIDTH * 4, &Frame);
+            LJB_VMON_WorkloadNextFrame(&Replay, Other, SURFACE_WIDTH * 4, &ReplayFrame);
+            if (i != 0)
+            {
+                Passed = WorkloadCheckFrame(&Frame, Previous, Current, &Changed);
+                ChangedPixels += Changed;
+                DamagedPixels += LJB_VMON_DamageArea(&Frame.Damage);
+                DamagedFrames += Frame.Damage.NumRects != 0;
+                Moves += Frame.HasMove;
+            }
+            if (Passed && (memcmp(Current, Other, FrameSize) != 0 ||
+                           memcmp(&Frame, &ReplayFrame, sizeof(Frame)) != 0))
+            {
+                fprintf(stderr, "frame %u: same seed, different frame\n", i);
+                Passed = FALSE;
+            }
+        }
+        LJB_VMON_WorkloadDeInit(&Replay);
+        LJB_VMON_WorkloadDeInit(&Workload);
+        if (!Passed)
+        {
+            fprintf(stderr, "workload: %s failed\n", LJB_VMON_WorkloadName(k));
+            break;
+        }
+
+        if (!LJB_VMON_WorkloadInit(&Workload, k, SURFACE_WIDTH, SURFACE_HEIGHT, 1))
+        {
+            Passed = FALSE;
+            break;
+        }
+        Start = BenchNow();
+        for (i = 0; i < Frames; i++)
+            LJB_VMON_WorkloadNextFrame(&Workload, Current, SURFACE_WIDTH * 4, &Frame);
+        Elapsed = BenchNow() - Start;
+        LJB_VMON_WorkloadDeInit(&Workload);
+
+        /*
+         * ratios are over the presents after the first, which is always
+         * a full frame
+         */
+        printf("{\"suite\":\"workload\",\"workload\":\"%s\",\"width\":%u,\"height\":%u,"
+            "\"frames\":%u,\"us_per_frame\":%.1f,\"damaged_frames\":%u,\"moves\":%u,"
+            "\"damage_ratio\":%.6f,\"changed_ratio\":%.6f}\n",
+            LJB_VMON_WorkloadName(k),
+            SURFACE_WIDTH,
+            SURFACE_HEIGHT,
+            Frames,
+            Elapsed * 1e6 / Frames,
+            DamagedFrames,
+            Moves,
+            Frames > 1 ? (double) DamagedPixels / ((double) SURFACE_WIDTH * SURFACE_HEIGHT * (Frames - 1)) : 0.0,
+            Frames > 1 ? (double) ChangedPixels / ((double) SURFACE_WIDTH * SURFACE_HEIGHT * (Frames - 1)) : 0.0);
+    }
+
+    free(Other);
+    free(Previous);
+    free(Current);
+    return Passed ? 0 : 1;
+}
+
+/*
+ * Reference for the damage tracker: compare every tile of Current with
+ * Previous and count the tiles that differ. If Damage is given, each of them
+ * must be inside it.
+ */
+static BOOLEAN
+DamageCompareTiles(
+    __in CONST UCHAR *              Previous,
+    __in CONST UCHAR *              Current,
+    __in_opt CONST LJB_VMON_DAMAGE *Damage,
+    __out UINT *                    ChangedTiles
+    )
+{
+    UINT CONST  Pitch = SURFACE_WIDTH * 4;
+    UINT        x, y, row, i;
+    UINT        Cols, Rows;
+    BOOLEAN     Covered;
+
+    *ChangedTiles = 0;
+    for (y = 0; y < SURFACE_HEIGHT; y += LJB_VMON_DAMAGE_TILE_SIZE)
+    {
+        Rows = SURFACE_HEIGHT - y;
+        if (Rows > LJB_VMON_DAMAGE_TILE_SIZE)
+            Rows = LJB_VMON_DAMAGE_TILE_SIZE;
+        for (x = 0; x < SURFACE_WIDTH; x += LJB_VMON_DAMAGE_TILE_SIZE)
+        {
+            Cols = SURFACE_WIDTH - x;
+            if (Cols > LJB_VMON_DAMAGE_TILE_SIZE)
+                Cols = LJB_VMON_DAMAGE_TILE_SIZE;
+            for (row = 0; row < Rows; row++)
+            {
+                if (memcmp(
+                        Previous + (SIZE_T) (y + row) * Pitch + x * 4,
+                        Current + (SIZE_T) (y + row) * Pitch + x * 4,
+                        Cols * 4) != 0)
+                    break;
+            }
+            if (row == Rows)
+                continue;
+
+            (*ChangedTiles)++;
+            if (Damage == NULL)
+                continue;
+            Covered = FALSE;
+            for (i = 0; i < Damage->NumRects && !Covered; i++)
+            {
+                Covered = (BOOLEAN) (
+                    (LONG) x >= Damage->Rects[i].Left &&
+                    (LONG) (x + Cols) <= Damage->Rects[i].Right &&
+                    (LONG) y >= Damage->Rects[i].Top &&
+                    (LONG) (y + Rows) <= Damage->Rects[i].Bottom);
+            }
+            if (!Covered)
+            {
+                fprintf(stderr, "damage: tile (%u, %u) changed outside the damage\n", x, y);
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * Compare the SSE2 and scalar tile hashes with each other at every tile
+ * width and a few heights, and check that flipping bits spread over each
+ * row, and swapping two rows or two stripes of a row, changes the hash.
+ */
+static BOOLEAN
+DamageHashSelfCheck(
+    __inout LJB_VMON_DAMAGE_TRACKER *   Tracker,
+    __inout UCHAR *                     Frame
+    )
+{
+    static CONST UINT   Heights[] = { 1, 7, 63, 64 };
+    UINT CONST          Pitch = SURFACE_WIDTH * 4;
+    BOOLEAN CONST       HasSse2 = Tracker->UseSse2;
+    UCHAR               Row[LJB_VMON_DAMAGE_TILE_SIZE * 4];
+    ULONG64             Hash, Scalar;
+    ULONG *             Pixel;
+    UINT                Cols, h, i, Bit;
+    BOOLEAN             Passed = TRUE;
+
+    FillRandom(Frame, (SIZE_T) Pitch * LJB_VMON_DAMAGE_TILE_SIZE);
+    for (Cols = 1; Cols <= LJB_VMON_DAMAGE_TILE_SIZE && Passed; Cols++)
+    for (h = 0; h < ARRAY_COUNT(Heights) && Passed; h++)
+    {
+        Tracker->UseSse2 = FALSE;
+        Scalar = LJB_VMON_DamageHashTile(Tracker, Frame, Pitch, Cols, Heights[h]);
+        Tracker->UseSse2 = HasSse2;
+        Hash = LJB_VMON_DamageHashTile(Tracker, Frame, Pitch, Cols, Heights[h]);
+        if (Hash != Scalar)
+        {
+            fprintf(stderr, "damage: %ux%u tile: SSE2 hash differs from scalar\n",
+                Cols, Heights[h]);
+            Passed = FALSE;
+            break;
+        }
+        if (Heights[h] != LJB_VMON_DAMAGE_TILE_SIZE)
+            continue;
+
+        for (i = 0; i < LJB_VMON_DAMAGE_TILE_SIZE && Passed; i++)
+        for (Bit = 0; Bit < 32 && Passed; Bit += 7)
+        {
+            Pixel = (ULONG *) (Frame + (SIZE_T) i * Pitch) + (i * 5 + Bit) % Cols;
+            *Pixel ^= 1u << Bit;
+            if (LJB_VMON_DamageHashTile(Tracker, Frame, Pitch, Cols, Heights[h]) == Hash)
+            {
+                fprintf(stderr, "damage: %u pixel wide tile, bit %u of row %u not hashed\n",
+                    Cols, Bit, i);
+                Passed = FALSE;
+            }
+            *Pixel ^= 1u << Bit;
+        }
+
+        RtlCopyMemory(Row, Frame, Cols * 4);
+        RtlCopyMemory(Frame, Frame + Pitch * 9, Cols * 4);
+        RtlCopyMemory(Frame + Pitch * 9, Row, Cols * 4);
+        if (LJB_VMON_DamageHashTile(Tracker, Frame, Pitch, Cols, Heights[h]) == Hash)
+        {
+            fprintf(stderr, "damage: %u pixel wide tile, rows 0 and 9 swapped not hashed\n", Cols);
+            Passed = FALSE;
+        }
+        RtlCopyMemory(Frame + Pitch * 9, Frame, Cols * 4);
+        RtlCopyMemory(Frame, Row, Cols * 4);
+
+        if (Cols >= 32)
+        {
+            RtlCopyMemory(Row, Frame, 64);
+            RtlCopyMemory(Frame, Frame + 64, 64);
+            RtlCopyMemory(Frame + 64, Row, 64);
+            if (LJB_VMON_DamageHashTile(Tracker, Frame, Pitch, Cols, Heights[h]) == Hash)
+            {
+                fprintf(stderr, "damage: %u pixel wide tile, stripes swapped not hashed\n", Cols);
+                Passed = FALSE;
+            }
+            RtlCopyMemory(Frame + 64, Frame, 64);
+            RtlCopyMemory(Frame, Row, 64);
+        }
+    }
+    Tracker->UseSse2 = HasSse2;
+    return Passed;
+}
+
+#define DAMAGE_KERNELS      3       // scalar hash, SSE2 hash, shadow compare
+#define DAMAGE_ROUNDS       20
+
+/*
+ * Tile hash damage tracking: check the hash kernels, then check that on
+ * every workload each changed tile is reported and a present that changed
+ * nothing reports no damage at all, and count the presents the tracker
+ * suppresses. Then time tracking an unchanged 1080p frame with each kernel
+ * against comparing it with a copy of the previous one. Iterations / 20
+ * presents per workload.
+ */
+static int
+DamageSuite(
+    __in UINT   Iterations
+    )
+{
+    SIZE_T CONST            FrameSize = (SIZE_T) SURFACE_WIDTH * SURFACE_HEIGHT * 4;
+    UINT CONST              Frames = Iterations / 20 ? Iterations / 20 : 1;
+    LJB_VMON_DAMAGE_TRACKER Tracker;
+    LJB_VMON_DAMAGE         Damage;
+    LJB_VMON_WORKLOAD       Workload;
+    LJB_VMON_WORKLOAD_FRAME Frame;
+    UCHAR *                 Current;
+    UCHAR *                 Previous;
+    BOOLEAN                 HasSse2;
+    UINT                    ChangedTiles;
+    UINT                    PassedOn;
+    UINT                    Unchanged;
+    double                  Start, Elapsed;
+    double                  Best[DAMAGE_KERNELS];
+    BOOLEAN                 Passed;
+    UINT                    Rounds;
+    UINT                    k, i, r;
+
+    Current = malloc(FrameSize);
+    Previous = malloc(FrameSize);
+    if (Current == NULL || Previous == NULL)
+    {
+        fprintf(stderr, "damage: out of memory\n");
+        return 1;
+    }
+    LJB_VMON_DamageTrackerInit(&Tracker);
+    HasSse2 = Tracker.UseSse2;
+
+    Passed = DamageHashSelfCheck(&Tracker, Current);
+    for (k = 0; k < LJB_VMON_WORKLOAD_COUNT && Passed; k++)
+    {
+        if (!LJB_VMON_WorkloadInit(&Workload, k, SURFACE_WIDTH, SURFACE_HEIGHT, 1))
+        {
+            fprintf(stderr, "damage: out of memory\n");
+            Passed = FALSE;
+            break;
+        }
+
+        LJB_VMON_DamageTrackerInvalidate(&Tracker);
+        FillRandom(Current, FrameSize);
+        PassedOn = 0;
+        Unchanged = 0;
+        for (i = 0; i < Frames && Passed; i++)
+        {
+            RtlCopyMemory(Previous, Current, FrameSize);
+            LJB_VMON_WorkloadNextFrame(&Workload, Current, SURFACE_WIDTH * 4, &Frame);
+            LJB_VMON_DamageTrackerUpdate(
+                &Tracker,
+                Current,
+                SURFACE_WIDTH,
+                SURFACE_HEIGHT,
+                SURFACE_WIDTH * 4,
+                &Damage
+                );
+            PassedOn += Damage.NumRects != 0;
+            if (i == 0)
+                continue;
+
+            Passed = DamageCompareTiles(Previous, Current, &Damage, &ChangedTiles);
+            Unchanged += ChangedTiles == 0;
+            if (Passed && ChangedTiles == 0 && Damage.NumRects != 0)
+            {
+                fprintf(stderr, "damage: frame %u changed nothing but was reported\n", i);
+                Passed = FALSE;
+            }
+        }
+        LJB_VMON_WorkloadDeInit(&Workload);
+        if (!Passed)
+        {
+            fprintf(stderr, "damage: %s failed\n", LJB_VMON_WorkloadName(k));
+            break;
+        }
+
+        printf("{\"suite\":\"damage\",\"workload\":\"%s\",\"presents\":%u,"
+            "\"passed_on\":%u,\"suppressed\":%u,\"unchanged\":%u}\n",
+            LJB_VMON_WorkloadName(k),
+            Frames,
+            PassedOn,
+            Frames - PassedOn,
+            Unchanged);
+    }
+
+    if (Passed)
+    {
+        /*
+         * the worst case for either approach: a frame that did not change
+         * has to be read whole.
+         */
+        FillRandom(Current, FrameSize);
+        RtlCopyMemory(Previous, Current, FrameSize);
+        LJB_VMON_DamageTrackerInvalidate(&Tracker);
+        LJB_VMON_DamageTrackerUpdate(&Tracker, Current, SURFACE_WIDTH, SURFACE_HEIGHT,
+            SURFACE_WIDTH * 4, &Damage);
+
+        /*
+         * the kernels take turns, a few rounds each, and the fastest round
+         * of each is reported so that a noisy neighbour does not decide
+         * which of them wins.
+         */
+        for (k = 0; k < DAMAGE_KERNELS; k++)
+            Best[k] = 0;
+        Rounds = Frames < DAMAGE_ROUNDS ? Frames : DAMAGE_ROUNDS;
+        for (r = 0; r < Rounds; r++)
+        {
+            for (k = 0; k < DAMAGE_KERNELS; k++)
+            {
+                if (k == 1 && !HasSse2)
+                    continue;
+                Tracker.UseSse2 = (BOOLEAN) (k == 1);
+
+                Start = BenchNow();
+                for (i = 0; i < Frames / Rounds; i++)
+                {
+                    if (k == 2)
+                    {
+                        (VOID) DamageCompareTiles(Previous, Current, NULL, &ChangedTiles);
+                        continue;
+                    }
+                    LJB_VMON_DamageTrackerUpdate(&Tracker, Current, SURFACE_WIDTH,
+                        SURFACE_HEIGHT, SURFACE_WIDTH * 4, &Damage);
+                }
+                Elapsed = (BenchNow() - Start) / (Frames / Rounds);
+                if (Best[k] == 0 || Elapsed < Best[k])
+                    Best[k] = Elapsed;
+            }
+        }
+        Tracker.UseSse2 = HasSse2;
+
+        for (k = 0; k < DAMAGE_KERNELS; k++)
+        {
+            if (k == 1 && !HasSse2)
+                continue;
+            printf("{\"suite\":\"damage\",\"kernel\":\"%s\",\"width\":%u,\"height\":%u,"
+                "\"frames\":%u,\"us_per_frame\":%.1f,\"gbytes_per_sec\":%.2f,\"state_bytes\":%u}\n",
+                k == 0 ? "tile_hash_scalar" : k == 1 ? "tile_hash_sse2" : "compare_shadow",
+                SURFACE_WIDTH,
+                SURFACE_HEIGHT,
+                Rounds * (Frames / Rounds),
+                Best[k] * 1e6,
+                (double) FrameSize / Best[k] / 1e9,
+                k == 2 ? (UINT) FrameSize : Tracker.MaxTiles * (UINT) sizeof(ULONG64));
+        }
+    }
+
+    LJB_VMON_DamageTrackerDeInit(&Tracker);
+    free(Previous);
+    free(Current);
+    return Passed ? 0 : 1;
+}
+
+/*
+ * What a receiver holding the previous frame does with a frame update: the
+ * copies first, then the residual pixels.
+ */
+static VOID
+MotionApply(
+    __inout UCHAR *                 Canvas,
+    __in CONST UCHAR *              Current,
+    __in CONST LJB_VMON_MOTION *    Motion
+    )
+{
+    UINT CONST                  Pitch = SURFACE_WIDTH * 4;
+    CONST LJB_VMON_COPY_RECT *  pCopy;
+    CONST LJB_VMON_RECT *       pRect;
+    LONG                        Rows, row, y;
+    UINT                        i;
+
+    for (i = 0; i < Motion->NumCopies; i++)
+    {
+        pCopy = &Motion->Copies[i];
+        Rows = pCopy->Dst.Bottom - pCopy->Dst.Top;
+        for (y = 0; y < Rows; y++)
+        {
+            row = (pCopy->Dst.Top > pCopy->SrcTop) ? Rows - 1 - y : y;
+            memmove(
+                Canvas + (SIZE_T) (pCopy->Dst.Top + row) * Pitch + pCopy->Dst.Left * 4,
+                Canvas + (SIZE_T) (pCopy->SrcTop + row) * Pitch + pCopy->SrcLeft * 4,
+                (pCopy->Dst.Right - pCopy->Dst.Left) * 4
+                );
+        }
+    }
+
+    for (i = 0; i < Motion->Residual.NumRects; i++)
+    {
+        pRect = &Motion->Residual.Rects[i];
+        for (y = pRect->Top; y < pRect->Bottom; y++)
+        {
+            RtlCopyMemory(
+                Canvas + (SIZE_T) y * Pitch + pRect->Left * 4,
+                Current + (SIZE_T) y * Pitch + pRect->Left * 4,
+                (pRect->Right - pRect->Left) * 4
+                );
+        }
+    }
+}
+
+/*
+ * Run every workload through damage tracking and motion detection, replay
+ * each update on a receiver's copy of the previous frame and check that it
+ * rebuilds the new frame exactly. Report the pixel bytes of the damage
+ * against what copies plus residual cost, how many presents the workload
+ * says moved content and in how many a copy was found, and the time spent
+ * detecting. Iterations / 20 presents per workload.
+ */
+static int
+MotionSuite(
+    __in UINT   Iterations
+    )
+{
+    SIZE_T CONST                FrameSize = (SIZE_T) SURFACE_WIDTH * SURFACE_HEIGHT * 4;
+    UINT CONST                  Frames = Iterations / 20 ? Iterations / 20 : 1;
+    LJB_VMON_DAMAGE_TRACKER     Tracker;
+    LJB_VMON_MOTION_DETECTOR *  Detector;
+    LJB_VMON_MOTION             Motion;
+    LJB_VMON_DAMAGE             Damage;
+    LJB_VMON_WORKLOAD           Workload;
+    LJB_VMON_WORKLOAD_FRAME     Frame;
+    UCHAR *                     Current;
+    UCHAR *                     Canvas;
+    ULONG64                     DamageBytes;
+    ULONG64                     SentBytes;
+    UINT                        Updates;
+    UINT                        Copies;
+    UINT                        Moves;
+    UINT                        MovesFound;
+    double                      Start, Elapsed;
+    BOOLEAN                     Passed;
+    UINT                        k, i;
+
+    Current = malloc(FrameSize);
+    Canvas = malloc(FrameSize);
+    Detector = malloc(sizeof(*Detector));
+    if (Current == NULL || Canvas == NULL || Detector == NULL)
+    {
+        fprintf(stderr, "motion: out of memory\n");
+        return 1;
+    }
+    LJB_VMON_DamageTrackerInit(&Tracker);
+    LJB_VMON_MotionInit(Detector);
+
+    Passed = TRUE;
+    for (k = 0; k < LJB_VMON_WORKLOAD_COUNT && Passed; k++)
+    {
+        if (!LJB_VMON_WorkloadInit(&Workload, k, SURFACE_WIDTH, SURFACE_HEIGHT, 1))
+        {
+            fprintf(stderr, "motion: out of memory\n");
+            Passed = FALSE;
+            break;
+        }
+
+        LJB_VMON_DamageTrackerInvalidate(&Tracker);
+        LJB_VMON_MotionInvalidate(Detector);
+        FillRandom(Current, FrameSize);
+        DamageBytes = 0;
+        SentBytes = 0;
+        Updates = 0;
+        Copies = 0;
+        Moves = 0;
+        MovesFound = 0;
+        Elapsed = 0;
+        for (i = 0; i < Frames && Passed; i++)
+        {
+            LJB_VMON_WorkloadNextFrame(&Workload, Current, SURFACE_WIDTH * 4, &Frame);
+            LJB_VMON_DamageTrackerUpdate(
+                &Tracker,
+                Current,
+                SURFACE_WIDTH,
+                SURFACE_HEIGHT,
+                SURFACE_WIDTH * 4,
+                &Damage
+                );
+            if (Damage.NumRects == 0)
+                continue;
+
+            Start = BenchNow();
+            LJB_VMON_MotionUpdate(
+                Detector,
+                Current,
+                SURFACE_WIDTH,
+                SURFACE_HEIGHT,
+                SURFACE_WIDTH * 4,
+                &Damage,
+                &Motion
+                );
+            Elapsed += BenchNow() - Start;
+
+            MotionApply(Canvas, Current, &Motion);
+            if (memcmp(Canvas, Current, FrameSize) != 0)
+            {
+                fprintf(stderr, "motion: frame %u rebuilt wrong from %u copies\n",
+                    i, Motion.NumCopies);
+                Passed = FALSE;
+                break;
+            }
+
+            if (i == 0)
+                continue;
+            Updates++;
+            DamageBytes += LJB_VMON_DamageArea(&Damage) * 4;
+            SentBytes += Motion.NumCopies * sizeof(LJB_VMON_COPY_RECT) +
+                LJB_VMON_DamageArea(&Motion.Residual) * 4;
+            Copies += Motion.NumCopies;
+            Moves += Frame.HasMove;
+            MovesFound += Frame.HasMove && Motion.NumCopies != 0;
+        }
+        LJB_VMON_WorkloadDeInit(&Workload);
+        if (!Passed)
+        {
+            fprintf(stderr, "motion: %s failed\n", LJB_VMON_WorkloadName(k));
+            break;
+        }
+
+        printf("{\"suite\":\"motion\",\"workload\":\"%s\",\"updates\":%u,"
+            "\"damage_bytes\":%llu,\"sent_bytes\":%llu,\"ratio\":%.2f,\"copies\":%u,"
+            "\"moves\":%u,\"moves_found\":%u,\"us_per_update\":%.1f}\n",
+            LJB_VMON_WorkloadName(k),
+            Updates,
+            (unsigned long long) DamageBytes,
+            (unsigned long long) SentBytes,
+            SentBytes ? (double) DamageBytes / (double) SentBytes : 0.0,
+            Copies,
+            Moves,
+            MovesFound,
+            Updates ? Elapsed * 1e6 / (Updates + 1) : 0.0);
+    }
+
+    LJB_VMON_MotionDeInit(Detector);
+    LJB_VMON_DamageTrackerDeInit(&Tracker);
+    free(Detector);
+    free(Canvas);
+    free(Current);
+    return Passed ? 0 : 1;
+}
+
+/*
+ * Run every workload through damage tracking and the tile codec. Each
+ * update is encoded on one thread and on one per processor, which must give
+ * the same stream, decoded onto a receiver's copy of the frame, which must
+ * come out exact, and decoded once more one byte short, which must fail.
+ * Report the compression of the damage, encode and decode throughput in
+ * damaged megabytes per second and how many tiles of each type were sent.
+ * Iterations / 20 presents per workload.
+ */
+static int
+CodecSuite(
+    __in UINT   Iterations
+    )
+{
+    SIZE_T CONST                FrameSize = (SIZE_T) SURFACE_WIDTH * SURFACE_HEIGHT * 4;
+    UINT CONST                  Frames = Iterations / 20 ? Iterations / 20 : 1;
+    LJB_VMON_DAMAGE_TRACKER     Tracker;
+    LJB_VMON_TILE_ENCODER *     Single;
+    LJB_VMON_TILE_ENCODER *     Multi;
+    LJB_VMON_DAMAGE             Damage;
+    LJB_VMON_WORKLOAD           Workload;
+    LJB_VMON_WORKLOAD_FRAME     Frame;
+    LJB_VMON_TILE_STATS         Stats;
+    CONST UCHAR *               Data;
+    CONST UCHAR *               MultiData;
+    SIZE_T                      DataSize;
+    SIZE_T                      MultiDataSize;
+    SIZE_T                      BytesUsed;
+    UCHAR *                     Current;
+    UCHAR *                     Canvas;
+    ULONG64                     DamageBytes;
+    ULONG64                     EncodedBytes;
+    double                      Start;
+    double                      EncodeTime, MultiTime, DecodeTime;
+    BOOLEAN                     Passed;
+    UINT                        k, i, t;
+
+    Current = malloc(FrameSize);
+    Canvas = malloc(FrameSize);
+    Single = malloc(sizeof(*Single));
+    Multi = malloc(sizeof(*Multi));
+    if (Current == NULL || Canvas == NULL || Single == NULL || Multi == NULL)
+    {
+        fprintf(stderr, "codec: out of memory\n");
+        return 1;
+    }
+    LJB_VMON_DamageTrackerInit(&Tracker);
+    if (!LJB_VMON_TileEncoderInit(Single, 1) || !LJB_VMON_TileEncoderInit(Multi, 0))
+    {
+        fprintf(stderr, "codec: unable to start the encoder threads\n");
+        return 1;
+    }
+
+    Passed = TRUE;
+    for (k = 0; k < LJB_VMON_WORKLOAD_COUNT && Passed; k++)
+    {
+        if (!LJB_VMON_WorkloadInit(&Workload, k, SURFACE_WIDTH, SURFACE_HEIGHT, 1))
+        {
+            fprintf(stderr, "codec: out of memory\n");
+            Passed = FALSE;
+            break;
+        }
+
+        LJB_VMON_DamageTrackerInvalidate(&Tracker);
+        RtlZeroMemory(&Single->Stats, sizeof(Single->Stats));
+        FillRandom(Current, FrameSize);
+        DamageBytes = 0;
+        EncodedBytes = 0;
+        EncodeTime = 0;
+        MultiTime = 0;
+        DecodeTime = 0;
+        for (i = 0; i < Frames && Passed; i++)
+        {
+            LJB_VMON_WorkloadNextFrame(&Workload, Current, SURFACE_WIDTH * 4, &Frame);
+            LJB_VMON_DamageTrackerUpdate(
+                &Tracker,
+                Current,
+                SURFACE_WIDTH,
+                SURFACE_HEIGHT,
+                SURFACE_WIDTH * 4,
+                &Damage
+                );
+            if (Damage.NumRects == 0)
+                continue;
+
+            Start = BenchNow();
+            Passed = LJB_VMON_TileEncode(
+                Single,
+                Current,
+                SURFACE_WIDTH * 4,
+                Damage.Rects,
+                Damage.NumRects,
+                &Data,
+                &DataSize
+                );
+            EncodeTime += BenchNow() - Start;
+
+            Start = BenchNow();
+            Passed = Passed && LJB_VMON_TileEncode(
+                Multi,
+                Current,
+                SURFACE_WIDTH * 4,
+                Damage.Rects,
+                Damage.NumRects,
+                &MultiData,
+                &MultiDataSize
+                );
+            MultiTime += BenchNow() - Start;
+            if (!Passed)
+            {
+                fprintf(stderr, "codec: out of memory\n");
+                break;
+            }
+            if (DataSize != MultiDataSize || memcmp(Data, MultiData, DataSize) != 0)
+            {
+                fprintf(stderr, "codec: frame %u encoded differently on %u threads\n",
+                    i, Multi->NumThreads);
+                Passed = FALSE;
+                break;
+            }
+
+            Start = BenchNow();
+            Passed = LJB_VMON_TileDecode(
+                Data,
+                DataSize,
+                Damage.Rects,
+                Damage.NumRects,
+                Canvas,
+                SURFACE_WIDTH,
+                SURFACE_HEIGHT,
+                SURFACE_WIDTH * 4,
+                &BytesUsed
+                );
+            DecodeTime += BenchNow() - Start;
+            if (!Passed || BytesUsed != DataSize || memcmp(Canvas, Current, FrameSize) != 0)
+            {
+                fprintf(stderr, "codec: frame %u decoded wrong\n", i);
+                Passed = FALSE;
+                break;
+            }
+            if (LJB_VMON_TileDecode(
+                    Data,
+                    DataSize - 1,
+                    Damage.Rects,
+                    Damage.NumRects,
+                    Canvas,
+                    SURFACE_WIDTH,
+                    SURFACE_HEIGHT,
+                    SURFACE_WIDTH * 4,
+                    NULL))
+            {
+                fprintf(stderr, "codec: frame %u decoded from a truncated stream\n", i);
+                Passed = FALSE;
+                break;
+            }
+            RtlCopyMemory(Canvas, Current, FrameSize);
+
+            DamageBytes += LJB_VMON_DamageArea(&Damage) * 4;
+            EncodedBytes += DataSize;
+        }
+        LJB_VMON_WorkloadDeInit(&Workload);
+        if (!Passed)
+        {
+            fprintf(stderr, "codec: %s failed\n", LJB_VMON_WorkloadName(k));
+            break;
+        }
+
+        Stats = Single->Stats;
+        printf("{\"suite\":\"codec\",\"workload\":\"%s\",\"damage_bytes\":%llu,"
+            "\"encoded_bytes\":%llu,\"ratio\":%.2f,\"encode_mbps\":%.0f,"
+            "\"encode_mbps_threads\":%.0f,\"threads\":%u,\"decode_mbps\":%.0f,\"tiles\":{",
+            LJB_VMON_WorkloadName(k),
+            (unsigned long long) DamageBytes,
+            (unsigned long long) EncodedBytes,
+            EncodedBytes ? (double) DamageBytes / (double) EncodedBytes : 0.0,
+            EncodeTime > 0 ? DamageBytes / EncodeTime / 1e6 : 0.0,
+            MultiTime > 0 ? DamageBytes / MultiTime / 1e6 : 0.0,
+            Multi->NumThreads,
+            DecodeTime > 0 ? DamageBytes / DecodeTime / 1e6 : 0.0);
+        for (t = 0; t < LJB_VMON_TILE_TYPES; t++)
+        {
+            static CONST CHAR * CONST TypeNames[LJB_VMON_TILE_TYPES] =
+            {
+                "solid", "palette", "palette_rle", "lz", "raw", "dct"
+            };
+
+            printf("%s\"%s\":%llu", t ? "," : "", TypeNames[t],
+                (unsigned long long) Stats.Tiles[t]);
+        }
+        printf("}}\n");
+    }
+
+    LJB_VMON_TileEncoderDeInit(Multi);
+    LJB_VMON_TileEncoderDeInit(Single);
+    LJB_VMON_DamageTrackerDeInit(&Tracker);
+    free(Multi);
+    free(Single);
+    free(Canvas);
+    free(Current);
+    return Passed ? 0 : 1;
+}
+
+/*
+ * Check the SSE2 forward DCT against the scalar one on random blocks and
+ * time both. Then run workloads through damage tracking and two encoders,
+ * one lossless and one with the lossy path at a given quality, decoding the
+ * lossy stream (with the refreshes it asks for) onto a receiver's copy of
+ * the frame. Report both stream sizes and the link rate they need at 60
+ * presents per second, how many tiles went out lossy, the error of the
+ * damaged pixels as received, and encode throughput. After the last
+ * present, encode empty frames until the refreshes are done: the receiver
+ * must then hold the frame exactly, and text workloads must never have
+ * gone lossy. Iterations / 20 presents per run.
+ */
+static int
+LossySuite(
+    __in UINT   Iterations
+    )
+{
+    static CONST struct
+    {
+        LJB_VMON_WORKLOAD_KIND  Kind;
+        UINT                    Quality;
+        BOOLEAN                 Text;
+    } Runs[] =
+    {
+        { LJB_VMON_WORKLOAD_IDLE,       75, TRUE  },
+        { LJB_VMON_WORKLOAD_TYPING,     75, TRUE  },
+        { LJB_VMON_WORKLOAD_DRAG,       75, FALSE },
+        { LJB_VMON_WORKLOAD_SCROLL,     75, TRUE  },
+        { LJB_VMON_WORKLOAD_VIDEO,      75, FALSE },
+        { LJB_VMON_WORKLOAD_SLIDESHOW,  75, FALSE },
+        { LJB_VMON_WORKLOAD_VIDEO,      25, FALSE },
+        { LJB_VMON_WORKLOAD_VIDEO,      50, FALSE },
+        { LJB_VMON_WORKLOAD_VIDEO,      90, FALSE },
+    };
+    SIZE_T CONST                FrameSize = (SIZE_T) SURFACE_WIDTH * SURFACE_HEIGHT * 4;
+    UINT CONST                  Frames = Iterations / 20 ? Iterations / 20 : 1;
+    UINT CONST                  Blocks = 20000;
+    LJB_VMON_DAMAGE_TRACKER     Tracker;
+    LJB_VMON_TILE_ENCODER *     Lossless;
+    LJB_VMON_TILE_ENCODER *     Lossy;
+    LJB_VMON_DAMAGE             Damage;
+    LJB_VMON_DAMAGE             Sent;
+    LJB_VMON_WORKLOAD           Workload;
+    LJB_VMON_WORKLOAD_FRAME     Frame;
+    CONST UCHAR *               Data;
+    SIZE_T                      DataSize;
+    SHORT *                     Samples;
+    SHORT                       Scalar[64];
+    SHORT                       Sse2[64];
+    UCHAR *                     Current;
+    UCHAR *                     Canvas;
+    ULONG64                     DamageBytes;
+    ULONG64                     LosslessBytes;
+    ULONG64                     LossyBytes;
+    ULONG64                     LossyTiles;
+    ULONG64                     AllTiles;
+    SIZE_T                      LossySize;
+    ULONG64                     RefreshPixels;
+    ULONG64                     ErrorPixels;
+    double                      SquaredError;
+    double                      Difference;
+    double                      Start, EncodeTime, ScalarTime, Sse2Time;
+    double                      Mse;
+    BOOLEAN                     Passed;
+    UINT                        Updates;
+    UINT                        r, i, b;
+    LONG                        x, y;
+
+    Current = malloc(FrameSize);
+    Canvas = malloc(FrameSize);
+    Lossless = malloc(sizeof(*Lossless));
+    Lossy = malloc(sizeof(*Lossy));
+    Samples = malloc(Blocks * 64 * sizeof(SHORT));
+    if (Current == NULL || Canvas == NULL || Lossless == NULL || Lossy == NULL || Samples == NULL)
+    {
+        fprintf(stderr, "lossy: out of memory\n");
+        return 1;
+    }
+    if (!LJB_VMON_TileEncoderInit(Lossless, 1) || !LJB_VMON_TileEncoderInit(Lossy, 0))
+    {
+        fprintf(stderr, "lossy: unable to start the encoder threads\n");
+        return 1;
+    }
+
+    for (i = 0; i < Blocks * 64; i++)
+        Samples[i] = (SHORT) ((i & 64) ? (LONG) (BenchRandom() % 256) - 128 :
+                                         (LONG) (BenchRandom() % 2) * 255 - 128);
+    Passed = TRUE;
+    for (b = 0; b < Blocks && Passed; b++)
+    {
+        LJB_VMON_TileForwardDct(FALSE, Samples + b * 64, Scalar);
+        LJB_VMON_TileForwardDct(TRUE, Samples + b * 64, Sse2);
+        if (memcmp(Scalar, Sse2, sizeof(Scalar)) != 0)
+        {
+            fprintf(stderr, "lossy: SSE2 DCT of block %u differs\n", b);
+            Passed = FALSE;
+        }
+    }
+    Start = BenchNow();
+    for (b = 0; b < Blocks; b++)
+        LJB_VMON_TileForwardDct(FALSE, Samples + b * 64, Scalar);
+    ScalarTime = BenchNow() - Start;
+    Start = BenchNow();
+    for (b = 0; b < Blocks; b++)
+        LJB_VMON_TileForwardDct(TRUE, Samples + b * 64, Sse2);
+    Sse2Time = BenchNow() - Start;
+    if (Passed)
+        printf("{\"suite\":\"lossy\",\"kernel\":\"fdct\",\"scalar_ns\":%.1f,\"sse2_ns\":%.1f}\n",
+            ScalarTime * 1e9 / Blocks, Sse2Time * 1e9 / Blocks);
+
+    LJB_VMON_DamageTrackerInit(&Tracker);
+    for (r = 0; r < sizeof(Runs) / sizeof(Runs[0]) && Passed; r++)
+    {
+        if (!LJB_VMON_WorkloadInit(&Workload, Runs[r].Kind, SURFACE_WIDTH, SURFACE_HEIGHT, 1) ||
+            !LJB_VMON_TileEncoderSetLossy(Lossy, SURFACE_WIDTH, SURFACE_HEIGHT, Runs[r].Quality))
+        {
+            fprintf(stderr, "lossy: out of memory\n");
+            Passed = FALSE;
+            break;
+        }
+
+        LJB_VMON_DamageTrackerInvalidate(&Tracker);
+        RtlZeroMemory(&Lossy->Stats, sizeof(Lossy->Stats));
+        FillRandom(Current, FrameSize);
+        DamageBytes = 0;
+        LosslessBytes = 0;
+        LossyBytes = 0;
+        RefreshPixels = 0;
+        ErrorPixels = 0;
+        SquaredError = 0;
+        EncodeTime = 0;
+        Updates = 0;
+        for (i = 0; Passed; i++)
+        {
+            /*
+             * the workload's presents, then empty frames until no refresh
+             * is left
+             */
+            if (i < Frames)
+            {
+                LJB_VMON_WorkloadNextFrame(&Workload, Current, SURFACE_WIDTH * 4, &Frame);
+                LJB_VMON_DamageTrackerUpdate(
+                    &Tracker,
+                    Current,
+                    SURFACE_WIDTH,
+                    SURFACE_HEIGHT,
+                    SURFACE_WIDTH * 4,
+                    &Damage
+                    );
+                if (Damage.NumRects == 0)
+                    continue;
+            }
+            else if (i < Frames + LJB_VMON_TILE_REFRESH_FRAMES + 1)
+                LJB_VMON_DamageReset(&Damage);
+            else
+                break;
+
+            Sent = Damage;
+            LJB_VMON_TileEncoderAddRefresh(Lossy, &Sent);
+            Start = BenchNow();
+            Passed = LJB_VMON_TileEncode(
+                Lossy,
+                Current,
+                SURFACE_WIDTH * 4,
+                Sent.Rects,
+                Sent.NumRects,
+                &Data,
+                &DataSize
+                );
+            EncodeTime += BenchNow() - Start;
+            LossySize = DataSize;
+            Passed = Passed && LJB_VMON_TileDecode(
+                Data,
+                DataSize,
+                Sent.Rects,
+                Sent.NumRects,
+                Canvas,
+                SURFACE_WIDTH,
+                SURFACE_HEIGHT,
+                SURFACE_WIDTH * 4,
+                NULL
+                );
+            if (!Passed)
+            {
+                fprintf(stderr, "lossy: frame %u failed to encode or decode\n", i);
+                break;
+            }
+            if (i == 0 || i >= Frames)
+            {
+                RefreshPixels += (i == 0) ? 0 : LJB_VMON_DamageArea(&Sent);
+                continue;
+            }
+
+            Passed = LJB_VMON_TileEncode(
+                Lossless,
+                Current,
+                SURFACE_WIDTH * 4,
+                Damage.Rects,
+                Damage.NumRects,
+                &Data,
+                &DataSize
+                );
+            if (!Passed)
+            {
+                fprintf(stderr, "lossy: out of memory\n");
+                break;
+            }
+
+            Updates++;
+            DamageBytes += LJB_VMON_DamageArea(&Damage) * 4;
+            LosslessBytes += DataSize;
+            LossyBytes += LossySize;
+            RefreshPixels += LJB_VMON_DamageArea(&Sent) - LJB_VMON_DamageArea(&Damage);
+            for (b = 0; b < Damage.NumRects; b++)
+            {
+                for (y = Damage.Rects[b].Top; y < Damage.Rects[b].Bottom; y++)
+                for (x = Damage.Rects[b].Left * 4; x < Damage.Rects[b].Right * 4; x++)
+                {
+                    if ((x & 3) == 3)
+                        continue;
+                    Difference = (double) Canvas[(SIZE_T) y * SURFACE_WIDTH * 4 + x] -
+                                 (double) Current[(SIZE_T) y * SURFACE_WIDTH * 4 + x];
+                    SquaredError += Difference * Difference;
+                }
+                ErrorPixels += (ULONG64) (Damage.Rects[b].Right - Damage.Rects[b].Left) *
+                               (Damage.Rects[b].Bottom - Damage.Rects[b].Top);
+            }
+        }
+        LJB_VMON_WorkloadDeInit(&Workload);
+
+        if (Passed && memcmp(Canvas, Current, FrameSize) != 0)
+        {
+            fprintf(stderr, "lossy: frame not restored by the refreshes\n");
+            Passed = FALSE;
+        }
+        LossyTiles = Lossy->Stats.Tiles[LJB_VMON_TILE_DCT];
+        AllTiles = 0;
+        for (b = 0; b < LJB_VMON_TILE_TYPES; b++)
+            AllTiles += Lossy->Stats.Tiles[b];
+        if (Passed && Runs[r].Text && LossyTiles != 0)
+        {
+            fprintf(stderr, "lossy: %llu text tiles went out lossy\n",
+                (unsigned long long) LossyTiles);
+            Passed = FALSE;
+        }
+        if (!Passed)
+        {
+            fprintf(stderr, "lossy: %s failed\n", LJB_VMON_WorkloadName(Runs[r].Kind));
+            break;
+        }
+
+        Mse = ErrorPixels ? SquaredError / (ErrorPixels * 3.0) : 0.0;
+        printf("{\"suite\":\"lossy\",\"workload\":\"%s\",\"quality\":%u,\"updates\":%u,"
+            "\"damage_bytes\":%llu,\"lossless_bytes\":%llu,\"lossy_bytes\":%llu,"
+            "\"lossless_mbit_60hz\":%.1f,\"lossy_mbit_60hz\":%.1f,\"dct_tiles\":%llu,"
+            "\"tiles\":%llu,\"refresh_pixels\":%llu,\"psnr_db\":%.2f,\"encode_mbps\":%.0f}\n",
+            LJB_VMON_WorkloadName(Runs[r].Kind),
+            Runs[r].Quality,
+            Updates,
+            (unsigned long long) DamageBytes,
+            (unsigned long long) LosslessBytes,
+            (unsigned long long) LossyBytes,
+            Updates ? LosslessBytes * 8.0 * 60 / Updates / 1e6 : 0.0,
+            Updates ? LossyBytes * 8.0 * 60 / Updates / 1e6 : 0.0,
+            (unsigned long long) LossyTiles,
+            (unsigned long long) AllTiles,
+            (unsigned long long) RefreshPixels,
+            Mse > 0 ? 10.0 * log10(255.0 * 255.0 / Mse) : 99.0,
+            EncodeTime > 0 ? DamageBytes / EncodeTime / 1e6 : 0.0);
+    }
+
+    /*
+     * parked while nobody sees the monitor: the buffers go, the change
+     * history stays, and the receiver, which kept its frame, is brought up
+     * to date by what changed meanwhile and the refreshes
+     */
+    if (Passed)
+    {
+        LJB_VMON_TileEncoderTrim(Lossy);
+        Passed = Lossy->Cells != NULL && Lossy->Frames[0].Output == NULL;
+        FillRandom(Current, FrameSize / 4);
+        LJB_VMON_DamageTrackerUpdate(
+            &Tracker,
+            Current,
+            SURFACE_WIDTH,
+            SURFACE_HEIGHT,
+            SURFACE_WIDTH * 4,
+            &Damage
+            );
+
+        /*
+         * the first submit carries the damage; the lossy cells it leaves
+         * are refreshed after LJB_VMON_TILE_REFRESH_FRAMES quiet ones
+         */
+        for (i = 0; Passed && i < LJB_VMON_TILE_REFRESH_FRAMES + 2; i++)
+        {
+            Sent = Damage;
+            LJB_VMON_TileEncoderAddRefresh(Lossy, &Sent);
+            Passed = LJB_VMON_TileEncode(
+                    Lossy,
+                    Current,
+                    SURFACE_WIDTH * 4,
+                    Sent.Rects,
+                    Sent.NumRects,
+                    &Data,
+                    &DataSize
+                    ) &&
+                LJB_VMON_TileDecode(
+                    Data,
+                    DataSize,
+                    Sent.Rects,
+                    Sent.NumRects,
+                    Canvas,
+                    SURFACE_WIDTH,
+                    SURFACE_HEIGHT,
+                    SURFACE_WIDTH * 4,
+                    NULL
+                    );
+            LJB_VMON_DamageReset(&Damage);
+        }
+        if (!Passed || memcmp(Canvas, Current, FrameSize) != 0)
+        {
+            fprintf(stderr, "lossy: frame not restored after a trim\n");
+            Passed = FALSE;
+        }
+    }
+    LJB_VMON_TileEncoderDeInit(Lossy);
+    LJB_VMON_TileEncoderDeInit(Lossless);
+    LJB_VMON_DamageTrackerDeInit(&Tracker);
+    free(Samples);
+    free(Lossy);
+    free(Lossless);
+    free(Canvas);
+    free(Current);
+    return Passed ? 0 : 1;
+}
+
+#define SCALING_WIDTH       3840
+#define SCALING_HEIGHT      2160
+
+static ULONG64
+BenchHashBytes(
+    __in CONST UCHAR *  Data,
+    __in SIZE_T         Size
+    )
+{
+    ULONG64 Hash = 0xCBF29CE484222325ULL;
+    SIZE_T  i;
+
+    for (i = 0; i < Size; i++)
+        Hash = (Hash ^ Data[i]) * 0x100000001B3ULL;
+    return Hash;
+}
+
+/*
+ * Encode 4K workloads with the tile encoder on 1 to 16 threads, one frame
+ * at a time ("sync") and with the next frame submitted before the last one
+ * is completed ("pipelined"). Every frame is blitted from the workload into
+ * one of two capture buffers first, as the capture loop would. Every
+ * stream must match the one thread stream byte for byte. Reports frames
+ * per second, encode time per frame when not overlapped, speedup over one
+ * thread and the share of tiles workers stole. Iterations / 400 frames per
+ * run; past the number of processors the speedup levels off.
+ */
+static int
+ScalingSuite(
+    __in UINT   Iterations
+    )
+{
+    static CONST LJB_VMON_WORKLOAD_KIND Kinds[] =
+    {
+        LJB_VMON_WORKLOAD_DRAG,
+        LJB_VMON_WORKLOAD_SCROLL,
+        LJB_VMON_WORKLOAD_VIDEO,
+    };
+    static CONST UINT                   ThreadCounts[] = { 1, 2, 4, 8, 16 };
+    SIZE_T CONST                Pitch = (SIZE_T) SCALING_WIDTH * 4;
+    SIZE_T CONST                FrameSize = Pitch * SCALING_HEIGHT;
+    UINT CONST                  Frames = Iterations / 400 ? Iterations / 400 : 1;
+    LJB_VMON_TILE_ENCODER *     Encoder;
+    LJB_VMON_WORKLOAD           Workload;
+    LJB_VMON_WORKLOAD_FRAME *   FrameInfo;
+    CONST LJB_VMON_RECT *       pRect;
+    CONST UCHAR *               Data;
+    SIZE_T                      DataSize;
+    SYSTEM_INFO                 SystemInfo;
+    UCHAR *                     Current;
+    UCHAR *                     Buffers[2];
+    ULONG64 *                   Reference;
+    ULONG64                     DamageBytes;
+    ULONG64                     Encoded, Stolen;
+    double                      Start, Elapsed, EncodeTime;
+    double                      BaseElapsed[2];
+    CHAR                        EncodeMs[32];
+    BOOLEAN                     Pipelined;
+    BOOLEAN                     Passed;
+    UINT                        k, n, m, i, f, r, w;
+    LONG                        y;
+
+    GetSystemInfo(&SystemInfo);
+    Current = malloc(FrameSize);
+    Buffers[0] = malloc(FrameSize);
+    Buffers[1] = malloc(FrameSize);
+    Encoder = malloc(sizeof(*Encoder));
+    FrameInfo = malloc(Frames * sizeof(*FrameInfo));
+    Reference = malloc(Frames * sizeof(*Reference));
+    if (Current == NULL || Buffers[0] == NULL || Buffers[1] == NULL || Encoder == NULL ||
+        FrameInfo == NULL || Reference == NULL)
+    {
+        fprintf(stderr, "scaling: out of memory\n");
+        return 1;
+    }
+
+    Passed = TRUE;
+    BaseElapsed[0] = BaseElapsed[1] = 0;
+    for (k = 0; k < sizeof(Kinds) / sizeof(Kinds[0]) && Passed; k++)
+    for (n = 0; n < sizeof(ThreadCounts) / sizeof(ThreadCounts[0]) && Passed; n++)
+    {
+        if (!LJB_VMON_TileEncoderInit(Encoder, ThreadCounts[n]))
+        {
+            fprintf(stderr, "scaling: unable to start the encoder threads\n");
+            Passed = FALSE;
+            LJB_VMON_TileEncoderDeInit(Encoder);
+            break;
+        }
+
+        for (m = 0; m < 2 && Passed; m++)
+        {
+            Pipelined = (BOOLEAN) (m == 1);
+            if (!LJB_VMON_WorkloadInit(&Workload, Kinds[k], SCALING_WIDTH, SCALING_HEIGHT, 1))
+            {
+                fprintf(stderr, "scaling: out of memory\n");
+                Passed = FALSE;
+                break;
+            }
+            RtlZeroMemory(Current, FrameSize);
+            Encoded = 0;
+            Stolen = 0;
+            for (w = 0; w < Encoder->NumThreads; w++)
+            {
+                Encoded -= Encoder->Workers[w].TilesEncoded;
+                Stolen -= Encoder->Workers[w].TilesStolen;
+            }
+            DamageBytes = 0;
+            EncodeTime = 0;
+
+            Start = BenchNow();
+            for (i = 0; i <= Frames && Passed; i++)
+            {
+                if (i < Frames)
+                {
+                    LJB_VMON_WorkloadNextFrame(&Workload, Current, (UINT) Pitch, &FrameInfo[i]);
+                    for (r = 0; r < FrameInfo[i].Damage.NumRects; r++)
+                    {
+                        pRect = &FrameInfo[i].Damage.Rects[r];
+                        for (y = pRect->Top; y < pRect->Bottom; y++)
+                        {
+                            RtlCopyMemory(
+                                Buffers[i & 1] + y * Pitch + pRect->Left * 4,
+                                Current + y * Pitch + pRect->Left * 4,
+                                (pRect->Right - pRect->Left) * 4
+                                );
+                        }
+                    }
+                    DamageBytes += LJB_VMON_DamageArea(&FrameInfo[i].Damage) * 4;
+                }
+
+                if (!Pipelined)
+                {
+                    if (i == Frames)
+                        break;
+                    EncodeTime -= BenchNow();
+                    Passed = LJB_VMON_TileEncode(
+                        Encoder,
+                        Buffers[i & 1],
+                        (UINT) Pitch,
+                        FrameInfo[i].Damage.Rects,
+                        FrameInfo[i].Damage.NumRects,
+                        &Data,
+                        &DataSize
+                        );
+                    EncodeTime += BenchNow();
+                    f = i;
+                }
+                else
+                {
+                    /*
+                     * frame i goes in before frame i - 1 comes out
+                     */
+                    if (i < Frames)
+                    {
+                        Passed = LJB_VMON_TileEncoderSubmit(
+                            Encoder,
+                            Buffers[i & 1],
+                            (UINT) Pitch,
+                            FrameInfo[i].Damage.Rects,
+                            FrameInfo[i].Damage.NumRects
+                            );
+                    }
+                    if (i == 0 || !Passed)
+                        continue;
+                    Passed = LJB_VMON_TileEncoderComplete(Encoder, &Data, &DataSize);
+                    f = i - 1;
+                }
+                if (!Passed)
+                {
+                    fprintf(stderr, "scaling: frame %u failed to encode\n", i);
+                    break;
+                }
+
+                if (n == 0 && !Pipelined)
+                    Reference[f] = BenchHashBytes(Data, DataSize) ^ DataSize;
+                else if (Reference[f] != (BenchHashBytes(Data, DataSize) ^ DataSize))
+                {
+                    fprintf(stderr, "scaling: %s frame %u differs on %u threads%s\n",
+                        LJB_VMON_WorkloadName(Kinds[k]), f, Encoder->NumThreads,
+                        Pipelined ? ", pipelined" : "");
+                    Passed = FALSE;
+                }
+            }
+            Elapsed = BenchNow() - Start;
+            LJB_VMON_WorkloadDeInit(&Workload);
+            if (!Passed)
+                break;
+
+            for (w = 0; w < Encoder->NumThreads; w++)
+            {
+                Encoded += Encoder->Workers[w].TilesEncoded;
+                Stolen += Encoder->Workers[w].TilesStolen;
+            }
+            if (n == 0)
+                BaseElapsed[m] = Elapsed;
+            if (Pipelined)
+                sprintf(EncodeMs, "null");
+            else
+                sprintf(EncodeMs, "%.2f", EncodeTime * 1e3 / Frames);
+            printf("{\"suite\":\"scaling\",\"workload\":\"%s\",\"width\":%u,\"height\":%u,"
+                "\"mode\":\"%s\",\"threads\":%u,\"processors\":%u,\"frames\":%u,"
+                "\"damage_mb_per_frame\":%.1f,\"fps\":%.1f,\"encode_ms\":%s,"
+                "\"speedup\":%.2f,\"stolen\":%.3f}\n",
+                LJB_VMON_WorkloadName(Kinds[k]),
+                SCALING_WIDTH,
+                SCALING_HEIGHT,
+                Pipelined ? "pipelined" : "sync",
+                Encoder->NumThreads,
+                (UINT) SystemInfo.dwNumberOfProcessors,
+                Frames,
+                DamageBytes / 1e6 / Frames,
+                Frames / Elapsed,
+                EncodeMs,
+                BaseElapsed[m] / Elapsed,
+                Encoded ? (double) Stolen / Encoded : 0.0);
+        }
+        LJB_VMON_TileEncoderDeInit(Encoder);
+    }
+
+    free(Reference);
+    free(FrameInfo);
+    free(Encoder);
+    free(Buffers[1]);
+    free(Buffers[0]);
+    free(Current);
+    return Passed ? 0 : 1;
+}
+
+#define NET_SHAPE_SIZE      64
+
+/*
+ * The receiving end of the net suite, on its own thread: takes senders one
+ * after the other and keeps the latency of every frame and cursor position.
+ */
+typedef struct _NET_BENCH_RECEIVER
+{
+    LJB_VMON_NET_RECEIVER   Receiver;
+    HANDLE                  hProgress;      // a frame, a position or the end of a session
+    volatile LONG           Stop;
+    volatile LONG           Frames;
+    volatile LONG           Positions;
+    volatile LONG           Sessions;
+    ULONG *                 FrameLatency;
+    ULONG *                 CursorLatency;
+    UINT                    MaxSamples;
+} NET_BENCH_RECEIVER;
+
+static DWORD WINAPI
+NetReceiverThread(
+    __in LPVOID     Context
+    )
+{
+    NET_BENCH_RECEIVER * CONST  Bench = Context;
+    LJB_VMON_NET_EVENT          Event;
+    LONG                        n;
+
+    while (!Bench->Stop)
+    {
+        if (!LJB_VMON_NetReceiverAccept(&Bench->Receiver))
+            continue;
+        do
+        {
+            LJB_VMON_NetReceiverPoll(&Bench->Receiver, 100, &Event);
+            if (Event.Type == LJB_VMON_NET_EVENT_FRAME)
+            {
+                n = Bench->Frames;
+                if ((UINT) n < Bench->MaxSamples)
+                    Bench->FrameLatency[n] = Event.Latency;
+                InterlockedIncrement(&Bench->Frames);
+                SetEvent(Bench->hProgress);
+            }
+            else if (Event.Type == LJB_VMON_NET_EVENT_CURSOR_POSITION)
+            {
+                n = Bench->Positions;
+                if ((UINT) n < Bench->MaxSamples)
+                    Bench->CursorLatency[n] = Event.Latency;
+                InterlockedIncrement(&Bench->Positions);
+                SetEvent(Bench->hProgress);
+            }
+        } while (Event.Type != LJB_VMON_NET_EVENT_CLOSED);
+        InterlockedIncrement(&Bench->Sessions);
+        SetEvent(Bench->hProgress);
+    }
+    return 0;
+}
+
+static int
+CompareUlong(
+    __in CONST VOID *   a,
+    __in CONST VOID *   b
+    )
+{
+    ULONG CONST x = *(CONST ULONG *) a;
+    ULONG CONST y = *(CONST ULONG *) b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Wait until Counter reaches Target; FALSE if the receiver stalls.
+ */
+static BOOLEAN
+NetWaitFor(
+    __in NET_BENCH_RECEIVER *   Bench,
+    __in volatile LONG *        Counter,
+    __in LONG                   Target
+    )
+{
+    while (InterlockedCompareExchange(Counter, 0, 0) < Target)
+    {
+        if (WaitForSingleObject(Bench->hProgress, 5000) == WAIT_TIMEOUT)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Send frame FrameId of Current through Sink, with the strip of rows from
+ * Top changed on it, or whole if Rows is 0.
+ */
+static VOID
+NetSendStrip(
+    __in LJB_VMON_SINK *        Sink,
+    __inout UCHAR *             Current,
+    __in ULONG                  FrameId,
+    __in LONG                   Top,
+    __in LONG                   Rows
+    )
+{
+    UINT CONST              Pitch = SURFACE_WIDTH * 4;
+    LJB_VMON_SINK_FRAME     Frame;
+    LJB_VMON_DAMAGE         Damage;
+
+    FillRandom(Current + (SIZE_T) Top * Pitch, (SIZE_T) (Rows ? Rows : SURFACE_HEIGHT) * Pitch);
+    Damage.NumRects = 1;
+    Damage.Rects[0].Left = 0;
+    Damage.Rects[0].Top = Top;
+    Damage.Rects[0].Right = SURFACE_WIDTH;
+    Damage.Rects[0].Bottom = Top + Rows;
+
+    RtlZeroMemory(&Frame, sizeof(Frame));
+    Frame.FrameId = FrameId;
+    Frame.Width = SURFACE_WIDTH;
+    Frame.Height = SURFACE_HEIGHT;
+    Frame.Pitch = Pitch;
+    Frame.Buffer = Current;
+    Frame.Damage = Rows ? &Damage : NULL;
+    Sink->pfnFrameUpdate(Sink->SinkContext, &Frame);
+}
+
+/*
+ * Cut the frame channel of a raw sender under it. The frame that fails
+ * must reach the receiver once the sink is back, resumed on the frame the
+ * receiver kept rather than sent whole. Reports how long the sink took to
+ * come back and what the frame after cost.
+ */
+static BOOLEAN
+NetReconnectCheck(
+    __in NET_BENCH_RECEIVER *   Bench,
+    __in LJB_VMON_NET_SINK *    NetSink,
+    __in PCSTR                  Address,
+    __inout UCHAR *             Current
+    )
+{
+    SIZE_T CONST        FrameSize = (SIZE_T) SURFACE_WIDTH * 4 * SURFACE_HEIGHT;
+    LJB_VMON_SINK       Sink;
+    TARGET_MODE_DATA    Mode;
+    ULONG64             FrameBytes;
+    LONG                Sessions;
+    double              Start, Elapsed;
+    BOOLEAN             Passed;
+
+    Sessions = Bench->Sessions;
+    Bench->Frames = 0;
+    if (!LJB_VMON_NetSinkInit(NetSink, Address, FALSE, 0))
+    {
+        fprintf(stderr, "net: unable to connect to %s\n", Address);
+        LJB_VMON_NetSinkDeInit(NetSink);
+        return FALSE;
+    }
+    LJB_VMON_NetSinkGetSink(NetSink, &Sink);
+
+    RtlZeroMemory(&Mode, sizeof(Mode));
+    Mode.Enabled = 1;
+    Mode.Width = SURFACE_WIDTH;
+    Mode.Height = SURFACE_HEIGHT;
+    Sink.pfnModeChange(Sink.SinkContext, &Mode);
+    NetSendStrip(&Sink, Current, 1, 0, 0);
+    Passed = NetWaitFor(Bench, &Bench->Frames, 1);
+
+    /*
+     * frame 2 fails on the dead channel and the sink goes without credit
+     * until the reconnect thread has it back
+     */
+    shutdown((SOCKET) NetSink->FrameSocket, SD_BOTH);
+    NetSendStrip(&Sink, Current, 2, 100, 16);
+    Start = BenchNow();
+    if (Passed && WaitForSingleObject(NetSink->hCreditEvent, 5000) != WAIT_OBJECT_0)
+    {
+        fprintf(stderr, "net: the sink did not reconnect\n");
+        Passed = FALSE;
+    }
+    Elapsed = BenchNow() - Start;
+
+    FrameBytes = NetSink->Stats.FrameBytes;
+    if (Passed)
+    {
+        NetSendStrip(&Sink, Current, 3, 600, 16);
+        Passed = NetWaitFor(Bench, &Bench->Frames, 2);
+    }
+    FrameBytes = NetSink->Stats.FrameBytes - FrameBytes;
+    if (Passed &&
+        (!Bench->Receiver.Resumed || NetSink->Stats.Resumes != 1 ||
+         FrameBytes * 4 > FrameSize))
+    {
+        fprintf(stderr, "net: the sink did not resume after reconnecting\n");
+        Passed = FALSE;
+    }
+    if (Passed && memcmp(Bench->Receiver.Pixels, Current, FrameSize) != 0)
+    {
+        fprintf(stderr, "net: the frame cut off was not resent\n");
+        Passed = FALSE;
+    }
+    if (Passed)
+    {
+        printf("{\"suite\":\"net\",\"workload\":\"reconnect\",\"encoding\":\"raw\","
+            "\"reconnect_ms\":%.2f,\"resumed\":true,\"kb_after_reconnect\":%.1f,"
+            "\"kb_full_frame\":%.1f}\n",
+            Elapsed * 1e3,
+            FrameBytes / 1e3,
+            FrameSize / 1e3);
+    }
+
+    LJB_VMON_NetSinkDeInit(NetSink);
+    if (!NetWaitFor(Bench, &Bench->Sessions, Sessions + 2))
+    {
+        fprintf(stderr, "net: the receiver did not see the sender leave\n");
+        Passed = FALSE;
+    }
+    return Passed;
+}
+
+/*
+ * Stream workloads through the network sink to a receiver over loopback,
+ * raw and tile encoded, from damage and motion as the capture loop finds
+ * them, with a cursor position after every frame. The receiver's frame and
+ * cursor must end up as sent. Reports frames per second and megabits per
+ * second of the whole loop, workload and damage tracking included, the
+ * send calls and buffers per frame the gathering takes, and frame and
+ * cursor latency from the send to the receiver having applied it. Both ends
+ * share one machine, so the numbers are of the protocol and the stack, not
+ * of a link. Iterations / 100 presents per run. Last, a sender has its
+ * frame channel cut and must come back to where the receiver was.
+ */
+static int
+NetSuite(
+    __in UINT   Iterations
+    )
+{
+    static CONST struct
+    {
+        LJB_VMON_WORKLOAD_KIND  Kind;
+        BOOLEAN                 Tiles;
+    } Runs[] =
+    {
+        { LJB_VMON_WORKLOAD_TYPING,     FALSE },
+        { LJB_VMON_WORKLOAD_DRAG,       FALSE },
+        { LJB_VMON_WORKLOAD_SCROLL,     FALSE },
+        { LJB_VMON_WORKLOAD_VIDEO,      FALSE },
+        { LJB_VMON_WORKLOAD_TYPING,     TRUE  },
+        { LJB_VMON_WORKLOAD_DRAG,       TRUE  },
+        { LJB_VMON_WORKLOAD_SCROLL,     TRUE  },
+        { LJB_VMON_WORKLOAD_VIDEO,      TRUE  },
+    };
+    UINT CONST                  Pitch = SURFACE_WIDTH * 4;
+    SIZE_T CONST                FrameSize = (SIZE_T) Pitch * SURFACE_HEIGHT;
+    UINT CONST                  Frames = Iterations / 100 ? Iterations / 100 : 1;
+    NET_BENCH_RECEIVER *        Bench;
+    LJB_VMON_NET_SINK *         NetSink;
+    LJB_VMON_SINK               Sink;
+    LJB_VMON_DAMAGE_TRACKER     Tracker;
+    LJB_VMON_MOTION_DETECTOR *  Detector;
+    LJB_VMON_MOTION             Motion;
+    LJB_VMON_DAMAGE             Damage;
+    LJB_VMON_WORKLOAD           Workload;
+    LJB_VMON_WORKLOAD_FRAME     WorkloadFrame;
+    LJB_VMON_SINK_FRAME         Frame;
+    TARGET_MODE_DATA            Mode;
+    POINTER_SHAPE_DATA *        Shape;
+    POINTER_POSITION_DATA       Position;
+    HANDLE                      hThread;
+    CHAR                        Address[32];
+    UCHAR *                     Current;
+    ULONG64                     CursorDatagrams;
+    ULONG                       NumFrames;
+    LONG                        Positions;
+    LONG                        Sessions;
+    double                      Start, Elapsed;
+    BOOLEAN                     Passed;
+    UINT                        r, i;
+
+    Current = malloc(FrameSize);
+    Bench = calloc(1, sizeof(*Bench));
+    NetSink = malloc(sizeof(*NetSink));
+    Detector = malloc(sizeof(*Detector));
+    Shape = malloc(sizeof(*Shape));
+    if (Current == NULL || Bench == NULL || NetSink == NULL || Detector == NULL || Shape == NULL)
+    {
+        fprintf(stderr, "net: out of memory\n");
+        return 1;
+    }
+    Bench->MaxSamples = Frames;
+    Bench->FrameLatency = malloc(Frames * sizeof(ULONG));
+    Bench->CursorLatency = malloc(Frames * sizeof(ULONG));
+    Bench->hProgress = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (Bench->FrameLatency == NULL || Bench->CursorLatency == NULL || Bench->hProgress == NULL)
+    {
+        fprintf(stderr, "net: out of memory\n");
+        return 1;
+    }
+    if (!LJB_VMON_NetReceiverInit(&Bench->Receiver, 0))
+    {
+        fprintf(stderr, "net: unable to listen on the loopback\n");
+        return 1;
+    }
+    sprintf(Address, "127.0.0.1:%u", Bench->Receiver.Port);
+    hThread = CreateThread(NULL, 0, &NetReceiverThread, Bench, 0, NULL);
+    if (hThread == NULL)
+    {
+        fprintf(stderr, "net: unable to start the receiver\n");
+        return 1;
+    }
+    LJB_VMON_DamageTrackerInit(&Tracker);
+    LJB_VMON_MotionInit(Detector);
+    MakeShape(Shape, 2, NET_SHAPE_SIZE);
+
+    Passed = TRUE;
+    for (r = 0; r < sizeof(Runs) / sizeof(Runs[0]) && Passed; r++)
+    {
+        if (!LJB_VMON_WorkloadInit(&Workload, Runs[r].Kind, SURFACE_WIDTH, SURFACE_HEIGHT, 1))
+        {
+            fprintf(stderr, "net: out of memory\n");
+            Passed = FALSE;
+            break;
+        }
+
+        /*
+         * the receiver is waiting for the next sender, its counters are ours
+         */
+        Sessions = Bench->Sessions;
+        CursorDatagrams = Bench->Receiver.Stats.CursorDatagrams;
+        Bench->Frames = 0;
+        Bench->Positions = 0;
+        if (!LJB_VMON_NetSinkInit(NetSink, Address, Runs[r].Tiles, 0))
+        {
+            fprintf(stderr, "net: unable to connect to %s\n", Address);
+            LJB_VMON_NetSinkDeInit(NetSink);
+            LJB_VMON_WorkloadDeInit(&Workload);
+            Passed = FALSE;
+            break;
+        }
+        LJB_VMON_NetSinkGetSink(NetSink, &Sink);
+
+        RtlZeroMemory(&Mode, sizeof(Mode));
+        Mode.Enabled = 1;
+        Mode.Width = SURFACE_WIDTH;
+        Mode.Height = SURFACE_HEIGHT;
+        Sink.pfnModeChange(Sink.SinkContext, &Mode);
+        Sink.pfnCursorShape(Sink.SinkContext, Shape);
+        LJB_VMON_DamageTrackerInvalidate(&Tracker);
+        LJB_VMON_MotionInvalidate(Detector);
+        FillRandom(Current, FrameSize);
+
+        NumFrames = 0;
+        Start = BenchNow();
+        for (i = 0; i < Frames; i++)
+        {
+            LJB_VMON_WorkloadNextFrame(&Workload, Current, Pitch, &WorkloadFrame);
+            LJB_VMON_DamageTrackerUpdate(
+                &Tracker,
+                Current,
+                SURFACE_WIDTH,
+                SURFACE_HEIGHT,
+                Pitch,
+                &Damage
+                );
+            if (Damage.NumRects != 0)
+            {
+                LJB_VMON_MotionUpdate(
+                    Detector,
+                    Current,
+                    SURFACE_WIDTH,
+                    SURFACE_HEIGHT,
+                    Pitch,
+                    &Damage,
+                    &Motion
+                    );
+                Frame.FrameId = i;
+                Frame.Width = SURFACE_WIDTH;
+                Frame.Height = SURFACE_HEIGHT;
+                Frame.Pitch = Pitch;
+                Frame.Buffer = Current;
+                Frame.Damage = (NumFrames != 0) ? &Damage : NULL;
+                Frame.Motion = (NumFrames != 0) ? &Motion : NULL;
+                Sink.pfnFrameUpdate(Sink.SinkContext, &Frame);
+                NumFrames++;
+            }
+
+            Position.X = (INT) (i * 7 % SURFACE_WIDTH);
+            Position.Y = (INT) (i * 3 % SURFACE_HEIGHT);
+            Position.Visible = TRUE;
+            Sink.pfnCursorPosition(Sink.SinkContext, &Position);
+
+            /*
+             * the frame must be in before the workload draws over Current
+             */
+            if (!NetWaitFor(Bench, &Bench->Frames, NumFrames))
+            {
+                fprintf(stderr, "net: frame %u never arrived\n", i);
+                Passed = FALSE;
+                break;
+            }
+        }
+        Elapsed = BenchNow() - Start;
+
+        if (Passed && NetSink->Stats.DroppedFrames != 0)
+        {
+            fprintf(stderr, "net: the sink dropped %llu frames\n",
+                (unsigned long long) NetSink->Stats.DroppedFrames);
+            Passed = FALSE;
+        }
+        if (Passed &&
+            memcmp(Bench->Receiver.Pixels, Current, FrameSize) != 0)
+        {
+            fprintf(stderr, "net: the received frame differs\n");
+            Passed = FALSE;
+        }
+
+        /*
+         * datagrams may be lost or late; a last position, newer than any
+         * sent, must come out on top.
+         */
+        Position.X = SURFACE_WIDTH - 1;
+        Position.Y = SURFACE_HEIGHT - 1;
+        Positions = InterlockedCompareExchange(&Bench->Positions, 0, 0);
+        Sink.pfnCursorPosition(Sink.SinkContext, &Position);
+        while (Passed)
+        {
+            if (!NetWaitFor(Bench, &Bench->Positions, Positions + 1))
+                Passed = FALSE;
+            Positions = InterlockedCompareExchange(&Bench->Positions, 0, 0);
+            if (Bench->Receiver.CursorX == Position.X && Bench->Receiver.CursorY == Position.Y)
+                break;
+        }
+        if (Passed &&
+            (Bench->Receiver.ShapeSerial != NetSink->ShapeSerial ||
+             memcmp(Bench->Receiver.Shape->Buffer, Shape->Buffer, LJB_VMON_CursorShapeSize(Shape)) != 0))
+            Passed = FALSE;
+        if (!Passed)
+            fprintf(stderr, "net: the received cursor differs\n");
+
+        if (Passed)
+        {
+            qsort(Bench->FrameLatency, NumFrames, sizeof(ULONG), &CompareUlong);
+            if ((UINT) Positions > Frames)
+                Positions = Frames;
+            qsort(Bench->CursorLatency, Positions, sizeof(ULONG), &CompareUlong);
+            printf("{\"suite\":\"net\",\"workload\":\"%s\",\"encoding\":\"%s\",\"frames\":%u,"
+                "\"fps\":%.1f,\"mbit_per_s\":%.1f,\"kb_per_frame\":%.1f,"
+                "\"sends_per_frame\":%.2f,\"buffers_per_frame\":%.1f,"
+                "\"latency_us\":{\"p50\":%u,\"p99\":%u,\"max\":%u},"
+                "\"cursor_latency_us\":{\"p50\":%u,\"p99\":%u,\"max\":%u},"
+                "\"cursor_datagrams\":%llu,\"cursor_lost\":%llu}\n",
+                LJB_VMON_WorkloadName(Runs[r].Kind),
+                Runs[r].Tiles ? "tile" : "raw",
+                (UINT) NumFrames,
+                NumFrames / Elapsed,
+                NetSink->Stats.FrameBytes * 8 / Elapsed / 1e6,
+                NetSink->Stats.FrameBytes / 1e3 / NumFrames,
+                (double) NetSink->Stats.Sends / NumFrames,
+                (double) NetSink->Stats.Buffers / NumFrames,
+                (UINT) Bench->FrameLatency[NumFrames / 2],
+                (UINT) Bench->FrameLatency[NumFrames * 99 / 100],
+                (UINT) Bench->FrameLatency[NumFrames - 1],
+                (UINT) Bench->CursorLatency[Positions / 2],
+                (UINT) Bench->CursorLatency[Positions * 99 / 100],
+                (UINT) Bench->CursorLatency[Positions - 1],
+                (unsigned long long) NetSink->Stats.CursorDatagrams,
+                (unsigned long long) (NetSink->Stats.CursorDatagrams -
+                                      (Bench->Receiver.Stats.CursorDatagrams - CursorDatagrams)));
+        }
+
+        /*
+         * let the receiver see the sender go before the next one comes
+         */
+        LJB_VMON_NetSinkDeInit(NetSink);
+        LJB_VMON_WorkloadDeInit(&Workload);
+        if (!NetWaitFor(Bench, &Bench->Sessions, Sessions + 1))
+        {
+            fprintf(stderr, "net: the receiver did not see the sender leave\n");
+            Passed = FALSE;
+        }
+    }
+
+    if (Passed)
+        Passed = NetReconnectCheck(Bench, NetSink, Address, Current);
+
+    /*
+     * the receiver thread leaves after one more session
+     */
+    InterlockedExchange(&Bench->Stop, 1);
+    if (LJB_VMON_NetSinkInit(NetSink, Address, FALSE, 0))
+    {
+        LJB_VMON_NetSinkDeInit(NetSink);
+        WaitForSingleObject(hThread, INFINITE);
+    }
+    else
+        LJB_VMON_NetSinkDeInit(NetSink);
+    CloseHandle(hThread);
+
+    LJB_VMON_MotionDeInit(Detector);
+    LJB_VMON_DamageTrackerDeInit(&Tracker);
+    LJB_VMON_NetReceiverDeInit(&Bench->Receiver);
+    CloseHandle(Bench->hProgress);
+    free(Bench->CursorLatency);
+    free(Bench->FrameLatency);
+    free(Shape);
+    free(Detector);
+    free(NetSink);
+    free(Bench);
+    free(Current);
+    return Passed ? 0 : 1;
+}
+
+/*
+ * Stream workloads through the USB sink into the loopback endpoint, tile
+ * encoded, from damage and motion as the capture loop finds them, over a
+ * high speed link (512 byte packets, 40 MB/s, 250 us to complete) and a
+ * SuperSpeed one (1024 byte packets, 400 MB/s, 100 us), for queue depths of
+ * 1 to 8 transfers of 64 KB and, at depth 4, of 16 KB and 256 KB. The
+ * device must end up with the last frame. Reports frames per second of the
+ * whole loop, the share of the time the bus carried data, what padding to
+ * whole packets costs, how often and how long the VMON thread waited for a
+ * transfer to complete, and the latency from the send to the device having
+ * rebuilt the frame. Iterations / 400 presents per run.
+ */
+static int
+UsbSuite(
+    __in UINT   Iterations
+    )
+{
+    static CONST struct
+    {
+        CONST CHAR *    Name;
+        ULONG           MaxPacketSize;
+        ULONG           Bandwidth;
+        ULONG           Latency;
+    } Links[] =
+    {
+        { "high_speed",     LJB_VMON_USB_HS_PACKET_SIZE,    40000000,   250 },
+        { "super_speed",    LJB_VMON_USB_SS_PACKET_SIZE,    400000000,  100 },
+    };
+    static CONST LJB_VMON_WORKLOAD_KIND Kinds[] =
+    {
+        LJB_VMON_WORKLOAD_TYPING,
+        LJB_VMON_WORKLOAD_DRAG,
+        LJB_VMON_WORKLOAD_VIDEO,
+    };
+    static CONST struct
+    {
+        UINT            Depth;
+        ULONG           TransferSize;
+    } Queues[] =
+    {
+        { 1,    64 * 1024   },
+        { 2,    64 * 1024   },
+        { 4,    64 * 1024   },
+        { 8,    64 * 1024   },
+        { 4,    16 * 1024   },
+        { 4,    256 * 1024  },
+    };
+    UINT CONST                  Pitch = SURFACE_WIDTH * 4;
+    SIZE_T CONST                FrameSize = (SIZE_T) Pitch * SURFACE_HEIGHT;
+    UINT CONST                  Frames = Iterations / 400 ? Iterations / 400 : 1;
+    LJB_VMON_USB_LOOPBACK *     Loopback;
+    LJB_VMON_USB_SINK *         UsbSink;
+    LJB_VMON_SINK               Sink;
+    LJB_VMON_DAMAGE_TRACKER     Tracker;
+    LJB_VMON_MOTION_DETECTOR *  Detector;
+    LJB_VMON_MOTION             Motion;
+    LJB_VMON_DAMAGE             Damage;
+    LJB_VMON_WORKLOAD           Workload;
+    LJB_VMON_WORKLOAD_FRAME     WorkloadFrame;
+    LJB_VMON_SINK_FRAME         Frame;
+    TARGET_MODE_DATA            Mode;
+    UCHAR *                     Current;
+    ULONG                       NumFrames;
+    double                      Start, Elapsed;
+    BOOLEAN                     Passed;
+    UINT                        l, k, q, i;
+
+    Current = malloc(FrameSize);
+    Loopback = malloc(sizeof(*Loopback));
+    UsbSink = malloc(sizeof(*UsbSink));
+    Detector = malloc(sizeof(*Detector));
+    if (Current == NULL || Loopback == NULL || UsbSink == NULL || Detector == NULL)
+    {
+        fprintf(stderr, "usb: out of memory\n");
+        return 1;
+    }
+    LJB_VMON_DamageTrackerInit(&Tracker);
+    LJB_VMON_MotionInit(Detector);
+
+    Passed = TRUE;
+    for (l = 0; l < sizeof(Links) / sizeof(Links[0]) && Passed; l++)
+    for (k = 0; k < sizeof(Kinds) / sizeof(Kinds[0]) && Passed; k++)
+    for (q = 0; q < sizeof(Queues) / sizeof(Queues[0]) && Passed; q++)
+    {
+        if (!LJB_VMON_WorkloadInit(&Workload, Kinds[k], SURFACE_WIDTH, SURFACE_HEIGHT, 1))
+        {
+            fprintf(stderr, "usb: out of memory\n");
+            Passed = FALSE;
+            break;
+        }
+        if (!LJB_VMON_UsbLoopbackInit(
+                Loopback,
+                Links[l].MaxPacketSize,
+                Links[l].Bandwidth,
+                Links[l].Latency) ||
+            !LJB_VMON_UsbSinkInit(
+                UsbSink,
+                &Loopback->Endpoint,
+                Queues[q].TransferSize,
+                Queues[q].Depth,
+                TRUE,
+                0,
+                0))
+        {
+            fprintf(stderr, "usb: unable to set up the sink\n");
+            Passed = FALSE;
+        }
+        LJB_VMON_UsbSinkGetSink(UsbSink, &Sink);
+
+        RtlZeroMemory(&Mode, sizeof(Mode));
+        Mode.Enabled = 1;
+        Mode.Width = SURFACE_WIDTH;
+        Mode.Height = SURFACE_HEIGHT;
+        if (Passed)
+            Sink.pfnModeChange(Sink.SinkContext, &Mode);
+        LJB_VMON_DamageTrackerInvalidate(&Tracker);
+        LJB_VMON_MotionInvalidate(Detector);
+        FillRandom(Current, FrameSize);
+
+        /*
+         * the sink is done with a frame when it returns; the workload may
+         * draw over Current while transfers are still in flight.
+         */
+        NumFrames = 0;
+        Start = BenchNow();
+        for (i = 0; i < Frames && Passed; i++)
+        {
+            LJB_VMON_WorkloadNextFrame(&Workload, Current, Pitch, &WorkloadFrame);
+            LJB_VMON_DamageTrackerUpdate(
+                &Tracker,
+                Current,
+                SURFACE_WIDTH,
+                SURFACE_HEIGHT,
+                Pitch,
+                &Damage
+                );
+            if (Damage.NumRects == 0)
+                continue;
+            LJB_VMON_MotionUpdate(
+                Detector,
+                Current,
+                SURFACE_WIDTH,
+                SURFACE_HEIGHT,
+                Pitch,
+                &Damage,
+                &Motion
+                );
+            Frame.FrameId = i;
+            Frame.Width = SURFACE_WIDTH;
+            Frame.Height = SURFACE_HEIGHT;
+            Frame.Pitch = Pitch;
+            Frame.Buffer = Current;
+            Frame.Damage = (NumFrames != 0) ? &Damage : NULL;
+            Frame.Motion = (NumFrames != 0) ? &Motion : NULL;
+            Sink.pfnFrameUpdate(Sink.SinkContext, &Frame);
+            NumFrames++;
+        }
+        while (Passed && InterlockedCompareExchange(&UsbSink->InFlight, 0, 0) != 0)
+            SwitchToThread();
+        Elapsed = BenchNow() - Start;
+
+        if (Passed &&
+            (UsbSink->Stats.DroppedFrames != 0 ||
+             Loopback->Broken ||
+             Loopback->Stats.Frames != NumFrames ||
+             Loopback->Stats.Bytes != UsbSink->Stats.FrameBytes + UsbSink->Stats.PadBytes +
+                 sizeof(LJB_VMON_NET_HEADER) + sizeof(LJB_VMON_NET_MODE_CHANGE) ||
+             Loopback->Stats.Bytes % Links[l].MaxPacketSize != 0 ||
+             memcmp(Loopback->Device.Pixels, Current, FrameSize) != 0))
+        {
+            fprintf(stderr, "usb: %s %s depth %u: the device differs\n",
+                Links[l].Name,
+                LJB_VMON_WorkloadName(Kinds[k]),
+                Queues[q].Depth);
+            Passed = FALSE;
+        }
+        if (Passed)
+        {
+            printf("{\"suite\":\"usb\",\"link\":\"%s\",\"workload\":\"%s\",\"transfer_kb\":%u,"
+                "\"depth\":%u,\"frames\":%u,\"fps\":%.1f,\"mbyte_per_s\":%.1f,"
+                "\"bus_busy\":%.2f,\"pad_percent\":%.2f,\"transfers_per_frame\":%.1f,"
+                "\"waits_per_frame\":%.2f,\"wait_ms_per_frame\":%.2f,"
+                "\"latency_us\":{\"mean\":%.0f,\"max\":%u}}\n",
+                Links[l].Name,
+                LJB_VMON_WorkloadName(Kinds[k]),
+                (UINT) (Queues[q].TransferSize / 1024),
+                Queues[q].Depth,
+                (UINT) NumFrames,
+                NumFrames / Elapsed,
+                Loopback->Stats.Bytes / Elapsed / 1e6,
+                Loopback->Stats.BusyTime / 1e6 / Elapsed,
+                100.0 * UsbSink->Stats.PadBytes / Loopback->Stats.Bytes,
+                (double) UsbSink->Stats.Transfers / NumFrames,
+                (double) UsbSink->Stats.Waits / NumFrames,
+                UsbSink->Stats.WaitTime / 1e3 / NumFrames,
+                (double) Loopback->Stats.LatencySum / NumFrames,
+                (UINT) Loopback->Stats.LatencyMax);
+        }
+
+        LJB_VMON_UsbSinkDeInit(UsbSink);
+        LJB_VMON_UsbLoopbackDeInit(Loopback);
+        LJB_VMON_WorkloadDeInit(&Workload);
+    }
+
+    LJB_VMON_MotionDeInit(Detector);
+    LJB_VMON_DamageTrackerDeInit(&Tracker);
+    free(Detector);
+    free(UsbSink);
+    free(Loopback);
+    free(Current);
+    return Passed ? 0 : 1;
+}
+
+/*
+ * A sink that keeps up with anything: it copies the damage of every frame
+ * into a frame of its own.
+ */
+typedef struct _BENCH_MIRROR
+{
+    UCHAR *     Pixels;
+} BENCH_MIRROR;
+
+static VOID
+MirrorFrameUpdate(
+    __in PVOID                          SinkContext,
+    __in CONST LJB_VMON_SINK_FRAME *    Frame
+    )
+{
+    BENCH_MIRROR * CONST    Mirror = SinkContext;
+    LJB_VMON_DAMAGE         Damage;
+    CONST LJB_VMON_RECT *   pRect;
+    UINT                    i;
+    LONG                    row;
+
+    if (Frame->Damage != NULL)
+        Damage = *Frame->Damage;
+    else
+        LJB_VMON_DamageSetFull(&Damage, Frame->Width, Frame->Height);
+    for (i = 0; i < Damage.NumRects; i++)
+    {
+        pRect = &Damage.Rects[i];
+        for (row = pRect->Top; row < pRect->Bottom; row++)
+            RtlCopyMemory(
+                Mirror->Pixels + (SIZE_T) row * Frame->Pitch + pRect->Left * 4,
+                (CONST UCHAR *) Frame->Buffer + (SIZE_T) row * Frame->Pitch + pRect->Left * 4,
+                (pRect->Right - pRect->Left) * 4);
+    }
+}
+
+/*
+ * Report what a capture loop that blits at the time of Due has from Surface
+ * to the sinks, the way LJB_VMON_PixelMain does; Captured stands for its
+ * frame buffer.
+ */
+static VOID
+CreditBlt(
+    __inout LJB_VMON_SINK_LIST *        SinkList,
+    __inout LJB_VMON_DAMAGE_TRACKER *   Tracker,
+    __inout LJB_VMON_MOTION_DETECTOR *  Detector,
+    __in CONST UCHAR *                  Surface,
+    __out UCHAR *                       Captured,
+    __in ULONG                          FrameId,
+    __in BOOLEAN                        First
+    )
+{
+    UINT CONST                  Pitch = SURFACE_WIDTH * 4;
+    LJB_VMON_DAMAGE             Damage;
+    LJB_VMON_MOTION             Motion;
+    LJB_VMON_SINK_FRAME         Frame;
+
+    RtlCopyMemory(Captured, Surface, (SIZE_T) Pitch * SURFACE_HEIGHT);
+    LJB_VMON_DamageTrackerUpdate(Tracker, Captured, SURFACE_WIDTH, SURFACE_HEIGHT, Pitch, &Damage);
+    if (Damage.NumRects == 0)
+        return;
+    LJB_VMON_MotionUpdate(Detector, Captured, SURFACE_WIDTH, SURFACE_HEIGHT, Pitch, &Damage, &Motion);
+    Frame.FrameId = FrameId;
+    Frame.Width = SURFACE_WIDTH;
+    Frame.Height = SURFACE_HEIGHT;
+    Frame.Pitch = Pitch;
+    Frame.Buffer = Captured;
+    Frame.Damage = First ? NULL : &Damage;
+    Frame.Motion = First ? NULL : &Motion;
+    LJB_VMON_SinkListFrameUpdate(SinkList, &Frame);
+}
+
+/*
+ * Present workloads at 60 Hz into the USB sink over a high speed link too
+ * slow for them (512 byte packets, 20 MB/s, 250 us to complete), 4
+ * transfers of 64 KB deep, without flow control and with 1 and 2 frames of
+ * credit. Without it the capture loop blocks on the link and falls behind
+ * the presents; with it, presents made while the sink has no credit are not
+ * blitted, and the next blit carries them all as one update. A frame that
+ * does not fit the transfers in flight still waits for them, whatever the
+ * credit; then only 1 keeps the loop on time. Last, with 1 frame of credit
+ * next to a sink that keeps up: every present is blitted for that one, the
+ * USB sink misses those it has no credit for and is caught up with what it
+ * missed as damage. The device, and that sink, must end up with the last
+ * present. Reports frames reported per present, how far behind its present
+ * each blit was, the frames the USB sink missed and was caught up with,
+ * the latency from the send to the device having rebuilt the frame, and
+ * the link rate. Iterations / 400 presents per run.
+ */
+static int
+CreditSuite(
+    __in UINT   Iterations
+    )
+{
+    static CONST LJB_VMON_WORKLOAD_KIND Kinds[] =
+    {
+        LJB_VMON_WORKLOAD_DRAG,
+        LJB_VMON_WORKLOAD_VIDEO,
+    };
+    static CONST struct
+    {
+        UINT            Credits;
+        BOOLEAN         Mirror;
+    } Configs[] =
+    {
+        { 0,    FALSE   },
+        { 1,    FALSE   },
+        { 2,    FALSE   },
+        { 1,    TRUE    },
+    };
+    double CONST                Interval = 1.0 / 60;
+    UINT CONST                  Pitch = SURFACE_WIDTH * 4;
+    SIZE_T CONST                FrameSize = (SIZE_T) Pitch * SURFACE_HEIGHT;
+    UINT CONST                  Presents = Iterations / 400 ? Iterations / 400 : 1;
+    LJB_VMON_USB_LOOPBACK *     Loopback;
+    LJB_VMON_USB_SINK *         UsbSink;
+    LJB_VMON_SINK_LIST *        SinkList;
+    LJB_VMON_SINK               Sink;
+    LJB_VMON_SINK               MirrorSink;
+    BENCH_MIRROR                Mirror;
+    LJB_VMON_DAMAGE_TRACKER     Tracker;
+    LJB_VMON_MOTION_DETECTOR *  Detector;
+    LJB_VMON_WORKLOAD           Workload;
+    LJB_VMON_WORKLOAD_FRAME     WorkloadFrame;
+    TARGET_MODE_DATA            Mode;
+    HANDLE                      hIdleEvent;
+    UCHAR *                     Surface;
+    UCHAR *                     Captured;
+    ULONG64                     Blits;
+    double                      Start, Due, Now, Elapsed;
+    double                      LagSum, LagMax;
+    BOOLEAN                     BltPending;
+    BOOLEAN                     Passed;
+    UINT                        k, c, i;
+    DWORD                       Timeout;
+
+    Surface = malloc(FrameSize);
+    Captured = malloc(FrameSize);
+    Mirror.Pixels = malloc(FrameSize);
+    Loopback = malloc(sizeof(*Loopback));
+    UsbSink = malloc(sizeof(*UsbSink));
+    SinkList = malloc(sizeof(*SinkList));
+    Detector = malloc(sizeof(*Detector));
+    hIdleEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (Surface == NULL || Captured == NULL || Mirror.Pixels == NULL || Loopback == NULL ||
+        UsbSink == NULL || SinkList == NULL || Detector == NULL || hIdleEvent == NULL)
+    {
+        fprintf(stderr, "credit: out of memory\n");
+        return 1;
+    }
+    LJB_VMON_DamageTrackerInit(&Tracker);
+    LJB_VMON_MotionInit(Detector);
+    RtlZeroMemory(&MirrorSink, sizeof(MirrorSink));
+    MirrorSink.SinkContext = &Mirror;
+    MirrorSink.pfnFrameUpdate = &MirrorFrameUpdate;
+
+    Passed = TRUE;
+    for (k = 0; k < sizeof(Kinds) / sizeof(Kinds[0]) && Passed; k++)
+    for (c = 0; c < sizeof(Configs) / sizeof(Configs[0]) && Passed; c++)
+    {
+        if (!LJB_VMON_WorkloadInit(&Workload, Kinds[k], SURFACE_WIDTH, SURFACE_HEIGHT, 1))
+        {
+            fprintf(stderr, "credit: out of memory\n");
+            Passed = FALSE;
+            break;
+        }
+        if (!LJB_VMON_UsbLoopbackInit(
+                Loopback,
+                LJB_VMON_USB_HS_PACKET_SIZE,
+                20000000,
+                250) ||
+            !LJB_VMON_UsbSinkInit(
+                UsbSink,
+                &Loopback->Endpoint,
+                0,
+                4,
+                TRUE,
+                0,
+                Configs[c].Credits))
+        {
+            fprintf(stderr, "credit: unable to set up the sink\n");
+            Passed = FALSE;
+        }
+        LJB_VMON_UsbSinkGetSink(UsbSink, &Sink);
+        LJB_VMON_SinkListInit(SinkList);
+        if (Passed && !LJB_VMON_SinkListAdd(SinkList, &Sink))
+            Passed = FALSE;
+        if (Passed && Configs[c].Mirror && !LJB_VMON_SinkListAdd(SinkList, &MirrorSink))
+            Passed = FALSE;
+
+        RtlZeroMemory(&Mode, sizeof(Mode));
+        Mode.Enabled = 1;
+        Mode.Width = SURFACE_WIDTH;
+        Mode.Height = SURFACE_HEIGHT;
+        if (Passed)
+            LJB_VMON_SinkListModeChange(SinkList, &Mode);
+        LJB_VMON_DamageTrackerInvalidate(&Tracker);
+        LJB_VMON_MotionInvalidate(Detector);
+        FillRandom(Surface, FrameSize);
+
+        /*
+         * present i is due at Start + i * Interval; a blit is as late as
+         * the present it catches up with.
+         */
+        Blits = 0;
+        LagSum = LagMax = 0;
+        BltPending = FALSE;
+        Start = BenchNow();
+        for (i = 0; i < Presents && Passed; i++)
+        {
+            Due = Start + i * Interval;
+            for (;;)
+            {
+                Now = BenchNow();
+                if (BltPending && LJB_VMON_SinkListHasCredit(SinkList))
+                {
+                    CreditBlt(SinkList, &Tracker, Detector, Surface, Captured, i, Blits == 0);
+                    Blits++;
+                    BltPending = FALSE;
+                    LagSum += Now - (Due - Interval);
+                    if (Now - (Due - Interval) > LagMax)
+                        LagMax = Now - (Due - Interval);
+                }
+                LJB_VMON_SinkListCatchUp(SinkList);
+                if (Now >= Due)
+                    break;
+                Timeout = (DWORD) ((Due - Now) * 1000) + 1;
+                WaitForSingleObject(
+                    (BltPending || LJB_VMON_SinkListIsBehind(SinkList)) ?
+                        Sink.hCreditEvent : hIdleEvent,
+                    Timeout);
+            }
+            LJB_VMON_WorkloadNextFrame(&Workload, Surface, Pitch, &WorkloadFrame);
+            if (LJB_VMON_SinkListHasCredit(SinkList))
+            {
+                Now = BenchNow();
+                CreditBlt(SinkList, &Tracker, Detector, Surface, Captured, i, Blits == 0);
+                Blits++;
+                LagSum += Now - Due;
+                if (Now - Due > LagMax)
+                    LagMax = Now - Due;
+            }
+            else
+                BltPending = TRUE;
+        }
+
+        /*
+         * the last present goes once there is credit for it
+         */
+        while (Passed && (BltPending || LJB_VMON_SinkListIsBehind(SinkList)))
+        {
+            if (!BltPending)
+            {
+                LJB_VMON_SinkListCatchUp(SinkList);
+                if (LJB_VMON_SinkListIsBehind(SinkList))
+                    WaitForSingleObject(Sink.hCreditEvent, INFINITE);
+            }
+            else if (LJB_VMON_SinkListHasCredit(SinkList))
+            {
+                Now = BenchNow();
+                CreditBlt(SinkList, &Tracker, Detector, Surface, Captured, i, Blits == 0);
+                Blits++;
+                BltPending = FALSE;
+                LagSum += Now - Due;
+                if (Now - Due > LagMax)
+                    LagMax = Now - Due;
+            }
+            else
+                WaitForSingleObject(Sink.hCreditEvent, INFINITE);
+        }
+        while (Passed && InterlockedCompareExchange(&UsbSink->InFlight, 0, 0) != 0)
+            SwitchToThread();
+        Elapsed = BenchNow() - Start;
+
+        if (Passed &&
+            (UsbSink->Stats.DroppedFrames != 0 ||
+             Loopback->Broken ||
+             Loopback->Stats.Frames != UsbSink->Stats.Frames ||
+             memcmp(Loopback->Device.Pixels, Surface, FrameSize) != 0 ||
+             (Configs[c].Mirror && memcmp(Mirror.Pixels, Surface, FrameSize) != 0)))
+        {
+            fprintf(stderr, "credit: %s credits %u%s: the device differs\n",
+                LJB_VMON_WorkloadName(Kinds[k]),
+                Configs[c].Credits,
+                Configs[c].Mirror ? " with a mirror" : "");
+            Passed = FALSE;
+        }
+        if (Passed)
+        {
+            printf("{\"suite\":\"credit\",\"workload\":\"%s\",\"credits\":%u,\"mirror\":%s,"
+                "\"presents\":%u,\"blits\":%llu,\"frames\":%llu,\"credit_stalls\":%llu,"
+                "\"missed\":%llu,\"catch_ups\":%llu,"
+                "\"blit_lag_ms\":{\"mean\":%.1f,\"max\":%.1f},"
+                "\"latency_us\":{\"mean\":%.0f,\"max\":%u},\"mbyte_per_s\":%.1f,"
+                "\"seconds\":%.2f}\n",
+                LJB_VMON_WorkloadName(Kinds[k]),
+                Configs[c].Credits,
+                Configs[c].Mirror ? "true" : "false",
+                Presents,
+                (unsigned long long) Blits,
+                (unsigned long long) UsbSink->Stats.Frames,
+                (unsigned long long) SinkList->Stats.CreditStalls,
+                (unsigned long long) SinkList->Stats.CreditSkips,
+                (unsigned long long) SinkList->Stats.CatchUps,
+                Blits ? LagSum * 1e3 / Blits : 0.0,
+                LagMax * 1e3,
+                Loopback->Stats.Frames ?
+                    (double) Loopback->Stats.LatencySum / Loopback->Stats.Frames : 0.0,
+                (UINT) Loopback->Stats.LatencyMax,
+                Loopback->Stats.Bytes / Elapsed / 1e6,
+                Elapsed);
+        }
+
+        LJB_VMON_UsbSinkDeInit(UsbSink);
+        LJB_VMON_UsbLoopbackDeInit(Loopback);
+        LJB_VMON_WorkloadDeInit(&Workload);
+    }
+
+    LJB_VMON_MotionDeInit(Detector);
+    LJB_VMON_DamageTrackerDeInit(&Tracker);
+    CloseHandle(hIdleEvent);
+    free(Detector);
+    free(SinkList);
+    free(UsbSink);
+    free(Loopback);
+    free(Mirror.Pixels);
+    free(Captured);
+    free(Surface);
+    return Passed ? 0 : 1;
+}
+
+/*
+ * Pick the modes to advertise for USB 2.0 and 3.0 links, tile coded, and
+ * for Fast and Gigabit Ethernet, raw and tile coded. Every mode must fit
+ * its link and be the largest rate of its resolution that does; 4K must
+ * come up at 30 Hz on USB 2.0 and at 60 Hz on Gigabit Ethernet with
+ * tiles, and so must it on a link without a limit. Then generate the EDID
+ * of each, parse it back and check that it advertises every mode chosen,
+ * and that the parser rejects a bad checksum, a wrong extension count and
+ * a detailed timing whose sync overruns its blanking. Reports the modes
+ * and the EDID size of every link.
+ */
+static int
+EdidSuite(
+    __in UINT   Iterations
+    )
+{
+    static CONST struct
+    {
+        CONST CHAR *    Name;
+        ULONG64         Bandwidth;
+        UINT            BitsPerPixel;
+    } Links[] =
+    {
+        { "unlimited",          0,              LJB_VMON_EDID_BPP_RAW   },
+        { "usb2_tiles",         40000000,       LJB_VMON_EDID_BPP_TILE  },
+        { "usb3_tiles",         400000000,      LJB_VMON_EDID_BPP_TILE  },
+        { "fast_ethernet_raw",  11750000,       LJB_VMON_EDID_BPP_RAW   },
+        { "fast_ethernet_tiles",11750000,       LJB_VMON_EDID_BPP_TILE  },
+        { "gigabit_raw",        117500000,      LJB_VMON_EDID_BPP_RAW   },
+        { "gigabit_tiles",      117500000,      LJB_VMON_EDID_BPP_TILE  },
+    };
+    static CONST UINT   Rates[] = { 144, 120, 60, 50, 30 };
+    LJB_VMON_EDID_LINK  Link;
+    LJB_VMON_EDID_MODE  Modes[LJB_VMON_EDID_MAX_MODES];
+    LJB_VMON_EDID_MODE  Parsed[LJB_VMON_EDID_MAX_PARSED_MODES];
+    LJB_VMON_EDID_MODE  Faster;
+    UCHAR               Edid[LJB_VMON_EDID_MAX_SIZE];
+    UCHAR               Bad[LJB_VMON_EDID_MAX_SIZE];
+    UINT                NumModes;
+    UINT                NumParsed;
+    UINT                EdidSize;
+    UINT                Expect4K;
+    UINT                l, i, r;
+    BOOLEAN             Passed;
+
+    (void) Iterations;
+    Passed = TRUE;
+    for (l = 0; l < sizeof(Links) / sizeof(Links[0]); l++)
+    {
+        RtlZeroMemory(&Link, sizeof(Link));
+        Link.Bandwidth = Links[l].Bandwidth;
+        Link.BitsPerPixel = Links[l].BitsPerPixel;
+        NumModes = LJB_VMON_EdidSelectModes(&Link, Modes, LJB_VMON_EDID_MAX_MODES);
+        if (NumModes == 0)
+        {
+            fprintf(stderr, "edid: %s: no mode\n", Links[l].Name);
+            Passed = FALSE;
+            continue;
+        }
+
+        for (i = 0; i < NumModes; i++)
+        {
+            BOOLEAN Wrong;
+
+            Wrong = !LJB_VMON_EdidTimingFits(&Modes[i]) ||
+                    (!LJB_VMON_EdidModeFits(&Link, &Modes[i]) && NumModes > 1);
+
+            /*
+             * up to 60 Hz, largest first and no faster rate up to 60 Hz
+             * fits; above, no faster rate fits
+             */
+            for (r = 0; r < sizeof(Rates) / sizeof(Rates[0]) && Rates[r] > Modes[i].Refresh; r++)
+            {
+                if (Modes[i].Refresh <= 60 && Rates[r] > 60)
+                    continue;
+                Faster = Modes[i];
+                Faster.Refresh = Rates[r];
+                if (LJB_VMON_EdidModeFits(&Link, &Faster) && LJB_VMON_EdidTimingFits(&Faster))
+                    Wrong = TRUE;
+            }
+            if (i != 0 && Modes[i].Refresh <= 60 && Modes[i - 1].Refresh <= 60 &&
+                (ULONG64) Modes[i].Width * Modes[i].Height >
+                    (ULONG64) Modes[i - 1].Width * Modes[i - 1].Height)
+                Wrong = TRUE;
+            if (Wrong)
+            {
+                fprintf(stderr, "edid: %s: %ux%u@%u is wrong\n",
+                    Links[l].Name, Modes[i].Width, Modes[i].Height, Modes[i].Refresh);
+                Passed = FALSE;
+            }
+        }
+
+        Expect4K = 0;
+        if (strcmp(Links[l].Name, "usb2_tiles") == 0)
+            Expect4K = 30;
+        else if (strcmp(Links[l].Name, "gigabit_tiles") == 0 ||
+                 strcmp(Links[l].Name, "unlimited") == 0)
+            Expect4K = 60;
+        if (Expect4K != 0 &&
+            (Modes[0].Width != 3840 || Modes[0].Height != 2160 || Modes[0].Refresh != Expect4K))
+        {
+            fprintf(stderr, "edid: %s: %ux%u@%u preferred, 3840x2160@%u expected\n",
+                Links[l].Name, Modes[0].Width, Modes[0].Height, Modes[0].Refresh, Expect4K);
+            Passed = FALSE;
+        }
+
+        EdidSize = LJB_VMON_EdidBuild(Modes, NumModes, Edid, sizeof(Edid));
+        if (!LJB_VMON_EdidParse(Edid, EdidSize, Parsed, LJB_VMON_EDID_MAX_PARSED_MODES, &NumParsed))
+        {
+            fprintf(stderr, "edid: %s: the EDID generated does not parse\n", Links[l].Name);
+            Passed = FALSE;
+            NumParsed = 0;
+        }
+        for (i = 0; i < NumModes; i++)
+        {
+            if (!LJB_VMON_EdidFindMode(Parsed, NumParsed, &Modes[i]))
+            {
+                fprintf(stderr, "edid: %s: %ux%u@%u not advertised\n",
+                    Links[l].Name, Modes[i].Width, Modes[i].Height, Modes[i].Refresh);
+                Passed = FALSE;
+            }
+        }
+
+        if (EdidSize > LJB_VMON_EDID_BLOCK_SIZE)
+        {
+            /*
+             * the base block alone claims an extension it does not have
+             */
+            if (LJB_VMON_EdidParse(Edid, LJB_VMON_EDID_BLOCK_SIZE, Parsed,
+                    LJB_VMON_EDID_MAX_PARSED_MODES, &NumParsed))
+            {
+                fprintf(stderr, "edid: %s: extension count not checked\n", Links[l].Name);
+                Passed = FALSE;
+            }
+        }
+        RtlCopyMemory(Bad, Edid, EdidSize);
+        Bad[EdidSize - 2] ^= 0x01;
+        if (LJB_VMON_EdidParse(Bad, EdidSize, Parsed, LJB_VMON_EDID_MAX_PARSED_MODES, &NumParsed))
+        {
+            fprintf(stderr, "edid: %s: checksum not checked\n", Links[l].Name);
+            Passed = FALSE;
+        }
+        RtlCopyMemory(Bad, Edid, EdidSize);
+        Bad[54 + 8] = 0xFF;                     // horizontal sync offset of the preferred mode
+        Bad[LJB_VMON_EDID_BLOCK_SIZE - 1] -= 0xFF - Edid[54 + 8];
+        if (LJB_VMON_EdidParse(Bad, EdidSize, Parsed, LJB_VMON_EDID_MAX_PARSED_MODES, &NumParsed))
+        {
+            fprintf(stderr, "edid: %s: detailed timing not checked\n", Links[l].Name);
+            Passed = FALSE;
+        }
+
+        printf("{\"suite\":\"edid\",\"link\":\"%s\",\"mbyte_per_s\":%.1f,\"bits_per_pixel\":%.2f,"
+            "\"edid_bytes\":%u,\"modes\":[",
+            Links[l].Name,
+            Links[l].Bandwidth / 1e6,
+            Links[l].BitsPerPixel / 100.0,
+            EdidSize);
+        for (i = 0; i < NumModes; i++)
+            printf("%s\"%ux%u@%u\"", i ? "," : "", Modes[i].Width, Modes[i].Height, Modes[i].Refresh);
+        printf("]}\n");
+    }
+    return Passed ? 0 : 1;
+}
+
+int
+main(
+    int     argc,
+    char ** argv
+    )
+{
+    CONST CHAR *    Suite = "all";
+    UINT            Iterations = 20000;
+    int             Status = 0;
+    int             i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            Iterations = (UINT) strtoul(argv[++i], NULL, 0);
+        else
+            Suite = argv[i];
+    }
+
+    if (strcmp(Suite, "all") == 0 || strcmp(Suite, "cursor") == 0)
+        Status |= CursorSuite(Iterations);
+    if (strcmp(Suite, "all") == 0 || strcmp(Suite, "workload") == 0)
+        Status |= WorkloadSuite(Iterations);
+    if (strcmp(Suite, "all") == 0 || strcmp(Suite, "damage") == 0)
+        Status |= DamageSuite(Iterations);
+    if (strcmp(Suite, "all") == 0 || strcmp(Suite, "motion") == 0)
+        Status |= MotionSuite(Iterations);
+    if (strcmp(Suite, "all") == 0 || strcmp(Suite, "codec") == 0)
+        Status |= CodecSuite(Iterations);
+    if (strcmp(Suite, "all") == 0 || strcmp(Suite, "lossy") == 0)
+        Status |= LossySuite(Iterations);
+    if (strcmp(Suite, "all") == 0 || strcmp(Suite, "scaling") == 0)
+        Status |= ScalingSuite(Iterations);
+    if (strcmp(Suite, "all") == 0 || strcmp(Suite, "net") == 0)
+        Status |= NetSuite(Iterations);
+    if (strcmp(Suite, "all") == 0 || strcmp(Suite, "usb") == 0)
+        Status |= UsbSuite(Iterations);
+    if (strcmp(Suite, "all") == 0 || strcmp(Suite, "credit") == 0)
+        Status |= CreditSuite(Iterations);
+    if (strcmp(Suite, "all") == 0 || strcmp(Suite, "edid") == 0)
+        Status |= EdidSuite(Iterations);
+
+    return Status;
+}
@@ -0,0 +1,1334 @@
+/*!
+    \file       vmon_func_bench.c
+    \brief      Frame path benchmarks of the func/source driver
+    \details    Runs the driver's notification, wait and blit code, linked
+                unmodified against the host kernel and KMDF stand-ins, behind
+                a simulated ProxyKMD, and measures what vmon.exe sees of it.
+                Builds and runs on Linux:
+
+                gcc -std=gnu89 -O2 -Wall -Wno-unknown-pragmas -Wno-multichar \
+                    -pthread -Ihost/include -Iinclude -Ifunc/source \
+                    host/source/vmon_func_bench.c host/source/vmon_host_wdk.c \
+                    func/source/ljb_vmon_driver_entry.c \
+                    func/source/ljb_vmon_power.c \
+                    func/source/ljb_vmon_io_in_caller_ctx.c \
+                    func/source/ljb_vmon_io_stop.c \
+                    func/source/ljb_vmon_ioctl.c \
+                    func/source/ljb_vmon_internal_ioctl.c \
+                    func/source/ljb_vmon_generic_ioctl.c \
+                    func/source/ljb_vmon_guid.c \
+                    func/source/ljb_vmon_trace.c \
+                    -o vmon_func_bench
+
+                vmon_func_bench [wake|blt|cursor|monitors|trace]
+                                [-n iterations] [-o trace_file]
+
+                wake        PRIMARY_SURFACE_UPDATE to the waiting thread
+                            running again with the completed
+                            WAIT_FOR_MONITOR_EVENT, in microseconds
+                blt         IOCTL_LJB_VMON_BLT_BITMAP throughput at 720p,
+                            1080p, 1440p and 4K, for one second each
+                cursor      CURSOR_UPDATE to the waiting thread running
+                            again, for position and for shape updates
+                monitors    wait events per second sustained with 1 to 16
+                            monitors, each with its own consumer thread and
+                            a producer posting whenever that consumer waits,
+                            for one second each
+                trace       cost of one binary trace event, on and off,
+                            surface update wakeup latency with the trace
+                            off and on, then a capture loop (update, wait,
+                            blit) of iterations frames drained the way
+                            vmon.exe /trace does, into trace_file if given
+
+                Every monitor is a device instance of its own with one
+                primary surface. Prints one JSON object per measurement and
+                exits with status 1 when a request fails or pool leaks.
+ */
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <errno.h>
+#include "ljb_vmon_private.h"
+
+#define BENCH_MAX_MONITORS      16
+#define BENCH_CURSOR_SIZE       64
+#define BENCH_RUN_SECONDS       1.0
+#define BENCH_TRACE_EVENTS      1000000
+#define BENCH_TRACE_CHUNK       256     /* frames between two drains */
+
+typedef struct _BENCH_MONITOR
+{
+    WDFDEVICE               Device;
+    LCI_GENERIC_INTERFACE   ProxyInterface;     // up-calls serviced here
+    LCI_GENERIC_INTERFACE   MonitorInterface;   // down-calls go here
+
+    UINT                    Width;
+    UINT                    Height;
+    HANDLE                  hPrimarySurface;
+    UCHAR *                 Buffer;
+    SIZE_T                  BufferSize;
+    ULONG                   FrameId;
+    INT                     CursorX;
+} BENCH_MONITOR;
+
+typedef struct _BENCH_WAITER
+{
+    BENCH_MONITOR *         Monitor;
+    WDF_HOST_REQUEST        Request;
+    sem_t                   Done;
+    LJB_VMON_MONITOR_EVENT  Seen;
+    LJB_VMON_MONITOR_EVENT  Event;
+} BENCH_WAITER;
+
+static volatile LONG    BenchErrors;
+
+/*
+ * the driver's WMI code is not part of the host build
+ */
+NTSTATUS
+VMON_WmiRegistration(
+    __in WDFDEVICE Device
+    )
+{
+    UNREFERENCED_PARAMETER(Device);
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+LJB_VMON_FireArrivalEvent(
+    __in WDFDEVICE  Device
+    )
+{
+    UNREFERENCED_PARAMETER(Device);
+    return STATUS_SUCCESS;
+}
+
+static ULONGLONG
+BenchTicks(VOID)
+{
+    LARGE_INTEGER   Counter;
+
+    QueryPerformanceCounter(&Counter);
+    return (ULONGLONG) Counter.QuadPart;
+}
+
+static double
+BenchSeconds(
+    __in ULONGLONG  Ticks
+    )
+{
+    LARGE_INTEGER   Frequency;
+
+    QueryPerformanceFrequency(&Frequency);
+    return (double) Ticks / (double) Frequency.QuadPart;
+}
+
+static int
+CompareTicks(
+    CONST VOID *    a,
+    CONST VOID *    b
+    )
+{
+    ULONGLONG CONST x = *(CONST ULONGLONG *) a;
+    ULONGLONG CONST y = *(CONST ULONGLONG *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Print "latency_us":{...} for Count samples, which get sorted.
+ */
+static VOID
+PrintLatency(
+    __inout ULONGLONG * Samples,
+    __in UINT           Count
+    )
+{
+    qsort(Samples, Count, sizeof(ULONGLONG), &CompareTicks);
+    printf("\"latency_us\":{\"min\":%.1f,\"p50\":%.1f,\"p90\":%.1f,"
+        "\"p99\":%.1f,\"max\":%.1f}",
+        BenchSeconds(Samples[0]) * 1e6,
+        BenchSeconds(Samples[Count / 2]) * 1e6,
+        BenchSeconds(Samples[(Count * 9) / 10]) * 1e6,
+        BenchSeconds(Samples[(Count * 99) / 100]) * 1e6,
+        BenchSeconds(Samples[Count - 1]) * 1e6
+        );
+}
+
+/*
+ * Name:  ProxyGenericIoctl
+ *
+ * Description:
+ *    The up-calls the driver makes into ProxyKMD. Only the blit matters
+ *    here; it copies the monitor's one surface.
+ */
+static NTSTATUS
+ProxyGenericIoctl(
+    __in PVOID          ProviderContext,
+    __in ULONG          IoctlCode,
+    __in_opt PVOID      InputBuffer,
+    __in SIZE_T         InputBufferSize,
+    __out_opt PVOID     OutputBuffer,
+    __in SIZE_T         OutputBufferSize,
+    __out ULONG *       BytesReturned
+    )
+{
+    BENCH_MONITOR * CONST   Monitor = ProviderContext;
+    LCI_USBAV_BLT_DATA *    BltData;
+    NTSTATUS                ntStatus;
+
+    UNREFERENCED_PARAMETER(OutputBuffer);
+    UNREFERENCED_PARAMETER(OutputBufferSize);
+    *BytesReturned = 0;
+    ntStatus = STATUS_NOT_SUPPORTED;
+    switch (IoctlCode)
+    {
+    case LCI_USBAV_BLT_PRIMARY_TO_SHADOW:
+        if (InputBufferSize < sizeof(LCI_USBAV_BLT_DATA))
+        {
+            ntStatus = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+        BltData = InputBuffer;
+        if (BltData->hPrimarySurface != Monitor->hPrimarySurface ||
+            BltData->pPrimaryBuffer != Monitor->Buffer)
+        {
+            ntStatus = STATUS_INVALID_HANDLE;
+            break;
+        }
+        RtlCopyMemory(
+            BltData->pShadowBuffer,
+            Monitor->Buffer,
+            BltData->BufferSize < Monitor->BufferSize ?
+                BltData->BufferSize : Monitor->BufferSize
+            );
+        ntStatus = STATUS_SUCCESS;
+        break;
+
+    case LCI_USBAV_LOCK_PRIMARY_SURFACE:
+    case LCI_USBAV_UNLOCK_PRIMARY_SURFACE:
+        ntStatus = STATUS_SUCCESS;
+        break;
+
+    default:
+        break;
+    }
+    return ntStatus;
+}
+
+static VOID
+ProxyReleaseInterface(
+    __in PVOID  ProviderContext
+    )
+{
+    UNREFERENCED_PARAMETER(ProviderContext);
+}
+
+/*
+ * Down-call into the driver. LJB_VMON_GenericIoctl answers most
+ * notifications with STATUS_NOT_SUPPORTED even when it acted on them, so,
+ * like ProxyKMD, the benchmark does not look at the status.
+ */
+static VOID
+BenchNotify(
+    __in BENCH_MONITOR *    Monitor,
+    __in ULONG              IoctlCode,
+    __in PVOID              InputBuffer,
+    __in SIZE_T             InputBufferSize
+    )
+{
+    LCI_GENERIC_INTERFACE * CONST   Target = &Monitor->MonitorInterface;
+    ULONG                           BytesReturned;
+
+    (VOID) (*Target->pfnGenericIoctl)(
+        Target->ProviderContext,
+        IoctlCode,
+        InputBuffer,
+        InputBufferSize,
+        NULL,
+        0,
+        &BytesReturned
+        );
+}
+
+static VOID
+BenchPostUpdate(
+    __in BENCH_MONITOR *    Monitor
+    )
+{
+    LCI_PROXYKMD_PRIMARY_SURFACE_UPDATE UpdateData;
+
+    RtlZeroMemory(&UpdateData, sizeof(UpdateData));
+    UpdateData.hPrimarySurface = Monitor->hPrimarySurface;
+    UpdateData.pBuffer = Monitor->Buffer;
+    UpdateData.BufferSize = Monitor->BufferSize;
+    UpdateData.FrameId = ++Monitor->FrameId;
+    UpdateData.Width = Monitor->Width;
+    UpdateData.Height = Monitor->Height;
+    UpdateData.Pitch = Monitor->Width * 4;
+    UpdateData.BytesPerPixel = 4;
+    BenchNotify(
+        Monitor,
+        LCI_PROXYKMD_NOTIFY_PRIMARY_SURFACE_UPDATE,
+        &UpdateData,
+        sizeof(UpdateData)
+        );
+}
+
+static VOID
+BenchPostCursor(
+    __in BENCH_MONITOR *    Monitor,
+    __in BOOLEAN            Shape
+    )
+{
+    static UCHAR                    Pixels[BENCH_CURSOR_SIZE * BENCH_CURSOR_SIZE * 4];
+    DXGKARG_SETPOINTERPOSITION      Position;
+    DXGKARG_SETPOINTERSHAPE         ShapeData;
+    LCI_PROXYKMD_CURSOR_UPDATE      CursorData;
+
+    RtlZeroMemory(&CursorData, sizeof(CursorData));
+    if (Shape)
+    {
+        RtlZeroMemory(&ShapeData, sizeof(ShapeData));
+        ShapeData.Flags.Color = 1;
+        ShapeData.Width = BENCH_CURSOR_SIZE;
+        ShapeData.Height = BENCH_CURSOR_SIZE;
+        ShapeData.Pitch = BENCH_CURSOR_SIZE * 4;
+        ShapeData.pPixels = Pixels;
+        CursorData.pShapeUpdate = &ShapeData;
+    }
+    else
+    {
+        RtlZeroMemory(&Position, sizeof(Position));
+        Monitor->CursorX = (Monitor->CursorX + 1) % (INT) Monitor->Width;
+        Position.X = Monitor->CursorX;
+        Position.Y = (INT) Monitor->Height / 2;
+        Position.Flags.Visible = 1;
+        CursorData.pPositionUpdate = &Position;
+    }
+    BenchNotify(
+        Monitor,
+        LCI_PROXYKMD_NOTIFY_CURSOR_UPDATE,
+        &CursorData,
+        sizeof(CursorData)
+        );
+}
+
+/*
+ * Send a request the driver completes before returning.
+ */
+static NTSTATUS
+BenchSendSync(
+    __in BENCH_MONITOR *    Monitor,
+    __in WDF_REQUEST_TYPE   Type,
+    __in ULONG              IoControlCode,
+    __in PVOID              InputBuffer,
+    __in size_t             InputBufferLength,
+    __out PVOID             OutputBuffer,
+    __in size_t             OutputBufferLength
+    )
+{
+    WDF_HOST_REQUEST    Request;
+    NTSTATUS            ntStatus;
+
+    ntStatus = HostWdfRequestInit(
+        &Request,
+        Type,
+        IoControlCode,
+        InputBuffer,
+        InputBufferLength,
+        OutputBuffer,
+        OutputBufferLength,
+        NULL,
+        NULL
+        );
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+
+    HostWdfSendRequest(Monitor->Device, &Request);
+    if (!Request.Completed)
+    {
+        fprintf(stderr, "func_bench: IOCTL(0x%x) left pending\n", IoControlCode);
+        abort();
+    }
+    return Request.Status;
+}
+
+/*
+ * Name:  BenchStartMonitor
+ *
+ * Description:
+ *    Add and start a device, bind it to the simulated ProxyKMD, commit a
+ *    Width x Height mode and present one surface.
+ */
+static NTSTATUS
+BenchStartMonitor(
+    __out BENCH_MONITOR *   Monitor,
+    __in UINT               Width,
+    __in UINT               Height
+    )
+{
+    static ULONG_PTR                    NextHandle;
+    LJB_VMON_CTX *                      dev_ctx;
+    LCI_PROXYKMD_COMMIT_VIDPN           CommitData;
+    LCI_PROXYKMD_VISIBILITY_UPDATE      VisibilityData;
+    LCI_PROXYKMD_PRIMARY_SURFACE_CREATE CreateData;
+    NTSTATUS                            ntStatus;
+
+    RtlZeroMemory(Monitor, sizeof(*Monitor));
+    Monitor->Width = Width;
+    Monitor->Height = Height;
+    Monitor->BufferSize = (SIZE_T) Width * Height * 4;
+    Monitor->Buffer = malloc(Monitor->BufferSize);
+    if (Monitor->Buffer == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+    RtlFillMemory(Monitor->Buffer, Monitor->BufferSize, 0x80);
+    Monitor->hPrimarySurface = (HANDLE) ++NextHandle;
+
+    ntStatus = HostWdfAddDevice(&Monitor->Device);
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+    dev_ctx = LJB_VMON_GetVMonCtx(Monitor->Device);
+    dev_ctx->DebugLevel = DBGLVL_ERROR;
+    ntStatus = HostWdfStartDevice(Monitor->Device);
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+
+    Monitor->ProxyInterface.Version = LCI_GENERIC_INTERFACE_V1;
+    Monitor->ProxyInterface.Size = sizeof(LCI_GENERIC_INTERFACE);
+    Monitor->ProxyInterface.ProviderContext = Monitor;
+    Monitor->ProxyInterface.pfnGenericIoctl = &ProxyGenericIoctl;
+    Monitor->ProxyInterface.pfnReleaseInterface = &ProxyReleaseInterface;
+    ntStatus = BenchSendSync(
+        Monitor,
+        WdfRequestTypeDeviceControlInternal,
+        INTERNAL_IOCTL_QUERY_USB_MONITOR_INTERFACE,
+        &Monitor->ProxyInterface,
+        sizeof(Monitor->ProxyInterface),
+        &Monitor->MonitorInterface,
+        sizeof(Monitor->MonitorInterface)
+        );
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+
+    RtlZeroMemory(&CommitData, sizeof(CommitData));
+    CommitData.Width = Width;
+    CommitData.Height = Height;
+    CommitData.Pitch = Width * 4;
+    CommitData.BytesPerPixel = 4;
+    CommitData.ContentTransformation.Scaling = D3DKMDT_VPPS_IDENTITY;
+    CommitData.ContentTransformation.Rotation = D3DKMDT_VPPR_IDENTITY;
+    BenchNotify(Monitor, LCI_PROXYKMD_NOTIFY_COMMIT_VIDPN, &CommitData, sizeof(CommitData));
+
+    RtlZeroMemory(&VisibilityData, sizeof(VisibilityData));
+    VisibilityData.Visible = TRUE;
+    BenchNotify(Monitor, LCI_PROXYKMD_NOTIFY_VISIBILITY_UPDATE, &VisibilityData, sizeof(VisibilityData));
+
+    RtlZeroMemory(&CreateData, sizeof(CreateData));
+    CreateData.hPrimarySurface = Monitor->hPrimarySurface;
+    CreateData.pBuffer = Monitor->Buffer;
+    CreateData.BufferSize = Monitor->BufferSize;
+    CreateData.Width = Width;
+    CreateData.Height = Height;
+    CreateData.Pitch = Width * 4;
+    CreateData.BytesPerPixel = 4;
+    BenchNotify(Monitor, LCI_PROXYKMD_NOTIFY_PRIMARY_SURFACE_CREATE, &CreateData, sizeof(CreateData));
+
+    BenchPostUpdate(Monitor);
+    return STATUS_SUCCESS;
+}
+
+/*
+ * The caller has made sure no thread will send another wait request.
+ */
+static VOID
+BenchStopMonitor(
+    __in BENCH_MONITOR *    Monitor
+    )
+{
+    LCI_PROXYKMD_PRIMARY_SURFACE_DESTROY    DestroyData;
+
+    RtlZeroMemory(&DestroyData, sizeof(DestroyData));
+    DestroyData.hPrimarySurface = Monitor->hPrimarySurface;
+    DestroyData.pBuffer = Monitor->Buffer;
+    DestroyData.BufferSize = Monitor->BufferSize;
+    DestroyData.Width = Monitor->Width;
+    DestroyData.Height = Monitor->Height;
+    DestroyData.Pitch = Monitor->Width * 4;
+    DestroyData.BytesPerPixel = 4;
+    BenchNotify(Monitor, LCI_PROXYKMD_NOTIFY_PRIMARY_SURFACE_DESTROY, &DestroyData, sizeof(DestroyData));
+
+    HostWdfSurpriseRemoveDevice(Monitor->Device);
+    HostWdfRemoveDevice(Monitor->Device);
+    free(Monitor->Buffer);
+    Monitor->Buffer = NULL;
+}
+
+static VOID
+BenchWaitComplete(
+    WDFREQUEST  Request,
+    PVOID       Context
+    )
+{
+    BENCH_WAITER * CONST    Waiter = Context;
+
+    UNREFERENCED_PARAMETER(Request);
+    sem_post(&Waiter->Done);
+}
+
+static VOID
+BenchWaiterInit(
+    __out BENCH_WAITER *    Waiter,
+    __in BENCH_MONITOR *    Monitor,
+    __in UINT               Flags
+    )
+{
+    RtlZeroMemory(Waiter, sizeof(*Waiter));
+    Waiter->Monitor = Monitor;
+    sem_init(&Waiter->Done, 0, 0);
+    Waiter->Seen.Flags.Value = Flags;
+    Waiter->Seen.TargetModeData.Width = Monitor->Width;
+    Waiter->Seen.TargetModeData.Height = Monitor->Height;
+    Waiter->Seen.TargetModeData.Rotation = D3DKMDT_VPPR_IDENTITY;
+    Waiter->Seen.VidPnSourceVisibilityData.Visible = TRUE;
+    Waiter->Seen.FrameId = Monitor->FrameId;
+}
+
+/*
+ * Queue (or have completed at once) a WAIT_FOR_MONITOR_EVENT relative to
+ * what the waiter has seen.
+ */
+static VOID
+BenchWaitSend(
+    __inout BENCH_WAITER *  Waiter
+    )
+{
+    NTSTATUS    ntStatus;
+
+    ntStatus = HostWdfRequestInit(
+        &Waiter->Request,
+        WdfRequestTypeDeviceControl,
+        IOCTL_LJB_VMON_WAIT_FOR_MONITOR_EVENT,
+        &Waiter->Seen,
+        sizeof(Waiter->Seen),
+        &Waiter->Event,
+        sizeof(Waiter->Event),
+        &BenchWaitComplete,
+        Waiter
+        );
+    if (!NT_SUCCESS(ntStatus))
+    {
+        /*
+         * fail it the way the driver would, so the waiter still wakes
+         */
+        Waiter->Request.Status = ntStatus;
+        sem_post(&Waiter->Done);
+        return;
+    }
+    HostWdfSendRequest(Waiter->Monitor->Device, &Waiter->Request);
+}
+
+/*
+ * Wait for the request to complete and fold the event into what the
+ * waiter has seen.
+ */
+static NTSTATUS
+BenchWaitDone(
+    __inout BENCH_WAITER *  Waiter
+    )
+{
+    LJB_VMON_MONITOR_EVENT * CONST  Event = &Waiter->Event;
+    NTSTATUS                        ntStatus;
+
+    while (sem_wait(&Waiter->Done) != 0 && errno == EINTR)
+        ;
+    ntStatus = Waiter->Request.Status;
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+
+    if (Event->Flags.ModeChange)
+        Waiter->Seen.TargetModeData = Event->TargetModeData;
+    if (Event->Flags.VidPnSourceVisibilityChange)
+        Waiter->Seen.VidPnSourceVisibilityData = Event->VidPnSourceVisibilityData;
+    if (Event->Flags.VidPnSourceBitmapChange)
+        Waiter->Seen.FrameId = Event->FrameId;
+    if (Event->Flags.PointerPositionChange)
+        Waiter->Seen.PointerPositionData = Event->PointerPositionData;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * Name:  BENCH_LATENCY
+ *
+ * Description:
+ *    One waiter thread and the main thread as producer, in lock step: the
+ *    waiter queues its request and raises Armed, the producer takes the
+ *    time and posts, the waiter takes the time again once it runs.
+ */
+typedef struct _BENCH_LATENCY
+{
+    BENCH_WAITER            Waiter;
+    ULONGLONG *             Samples;
+    UINT                    Count;
+    volatile LONG           Armed;
+    volatile ULONGLONG      Posted;
+    volatile LONG           Failed;
+} BENCH_LATENCY;
+
+static void *
+BenchLatencyWaiter(
+    void *  Context
+    )
+{
+    BENCH_LATENCY * CONST   Latency = Context;
+    ULONGLONG               Now;
+    UINT                    i;
+
+    for (i = 0; i < Latency->Count; i++)
+    {
+        BenchWaitSend(&Latency->Waiter);
+        InterlockedExchange(&Latency->Armed, 1);
+        if (!NT_SUCCESS(BenchWaitDone(&Latency->Waiter)))
+        {
+            InterlockedExchange(&Latency->Failed, 1);
+            break;
+        }
+        Now = BenchTicks();
+        Latency->Samples[i] = Now - Latency->Posted;
+    }
+    return NULL;
+}
+
+/*
+ * Measure Count posts of kind Kind: 0 surface update, 1 pointer move,
+ * 2 pointer shape.
+ */
+static BOOLEAN
+BenchLatency(
+    __in BENCH_MONITOR *    Monitor,
+    __in UINT               Flags,
+    __in UINT               Kind,
+    __in UINT               Count,
+    __out ULONGLONG *       Samples
+    )
+{
+    BENCH_LATENCY   Latency;
+    pthread_t       Thread;
+    UINT            i;
+
+    RtlZeroMemory(&Latency, sizeof(Latency));
+    BenchWaiterInit(&Latency.Waiter, Monitor, Flags);
+    Latency.Samples = Samples;
+    Latency.Count = Count;
+    if (pthread_create(&Thread, NULL, &BenchLatencyWaiter, &Latency) != 0)
+        return FALSE;
+
+    for (i = 0; i < Count && !Latency.Failed; i++)
+    {
+        while (!Latency.Armed && !Latency.Failed)
+            sched_yield();
+        InterlockedExchange(&Latency.Armed, 0);
+        Latency.Posted = BenchTicks();
+        if (Kind == 0)
+            BenchPostUpdate(Monitor);
+        else
+            BenchPostCursor(Monitor, (BOOLEAN) (Kind == 2));
+    }
+    pthread_join(Thread, NULL);
+    sem_destroy(&Latency.Waiter.Done);
+    if (Latency.Failed)
+    {
+        fprintf(stderr, "func_bench: wait failed with 0x%08x\n",
+            (UINT) Latency.Waiter.Request.Status);
+        InterlockedIncrement(&BenchErrors);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static VOID
+WakeSuite(
+    __in UINT   Iterations
+    )
+{
+    BENCH_MONITOR   Monitor;
+    ULONGLONG *     Samples;
+    LJB_VMON_WAIT_FLAGS Flags;
+
+    Samples = malloc(Iterations * sizeof(ULONGLONG));
+    if (Samples == NULL || !NT_SUCCESS(BenchStartMonitor(&Monitor, 1920, 1080)))
+    {
+        fprintf(stderr, "wake: setup failed\n");
+        InterlockedIncrement(&BenchErrors);
+        free(Samples);
+        return;
+    }
+
+    /*
+     * the flags vmon.exe waits with
+     */
+    Flags.Value = 0;
+    Flags.ModeChange = 1;
+    Flags.VidPnSourceVisibilityChange = 1;
+    Flags.VidPnSourceBitmapChange = 1;
+    Flags.PointerPositionChange = 1;
+    Flags.PointerShapeChange = 1;
+    if (BenchLatency(&Monitor, Flags.Value, 0, Iterations, Samples))
+    {
+        printf("{\"suite\":\"wake\",\"event\":\"surface_update\",\"samples\":%u,", Iterations);
+        PrintLatency(Samples, Iterations);
+        printf("}\n");
+    }
+    BenchStopMonitor(&Monitor);
+    free(Samples);
+}
+
+static VOID
+CursorSuite(
+    __in UINT   Iterations
+    )
+{
+    static CONST struct
+    {
+        CONST CHAR *    Name;
+        UINT            Kind;
+    } Events[] =
+    {
+        { "position",   1 },
+        { "shape",      2 },
+    };
+    BENCH_MONITOR       Monitor;
+    ULONGLONG *         Samples;
+    LJB_VMON_WAIT_FLAGS Flags;
+    UINT                e;
+
+    Samples = malloc(Iterations * sizeof(ULONGLONG));
+    if (Samples == NULL || !NT_SUCCESS(BenchStartMonitor(&Monitor, 1920, 1080)))
+    {
+        fprintf(stderr, "cursor: setup failed\n");
+        InterlockedIncrement(&BenchErrors);
+        free(Samples);
+        return;
+    }
+
+    for (e = 0; e < sizeof(Events) / sizeof(Events[0]); e++)
+    {
+        Flags.Value = 0;
+        if (Events[e].Kind == 1)
+            Flags.PointerPositionChange = 1;
+        else
+            Flags.PointerShapeChange = 1;
+        if (!BenchLatency(&Monitor, Flags.Value, Events[e].Kind, Iterations, Samples))
+            break;
+        printf("{\"suite\":\"cursor\",\"event\":\"%s\",\"samples\":%u,",
+            Events[e].Name, Iterations);
+        PrintLatency(Samples, Iterations);
+        printf("}\n");
+    }
+    BenchStopMonitor(&Monitor);
+    free(Samples);
+}
+
+static VOID
+BltSuite(VOID)
+{
+    static CONST struct
+    {
+        UINT    Width;
+        UINT    Height;
+    } Modes[] =
+    {
+        { 1280,  720 },
+        { 1920, 1080 },
+        { 2560, 1440 },
+        { 3840, 2160 },
+    };
+    BENCH_MONITOR   Monitor;
+    BLT_DATA        InBlt;
+    BLT_DATA        OutBlt;
+    UCHAR *         Shadow;
+    ULONGLONG       Start;
+    ULONGLONG       Elapsed;
+    double          Seconds;
+    UINT            Blts;
+    UINT            m;
+    NTSTATUS        ntStatus;
+
+    for (m = 0; m < sizeof(Modes) / sizeof(Modes[0]); m++)
+    {
+        Shadow = malloc((SIZE_T) Modes[m].Width * Modes[m].Height * 4);
+        if (Shadow == NULL ||
+            !NT_SUCCESS(BenchStartMonitor(&Monitor, Modes[m].Width, Modes[m].Height)))
+        {
+            fprintf(stderr, "blt: setup failed\n");
+            InterlockedIncrement(&BenchErrors);
+            free(Shadow);
+            return;
+        }
+        RtlFillMemory(Shadow, Monitor.BufferSize, 0);
+
+        RtlZeroMemory(&InBlt, sizeof(InBlt));
+        InBlt.Width = Monitor.Width;
+        InBlt.Height = Monitor.Height;
+        InBlt.FrameBuffer = (UINT64) (ULONG_PTR) Shadow;
+        Blts = 0;
+        Start = BenchTicks();
+        do
+        {
+            ntStatus = BenchSendSync(
+                &Monitor,
+                WdfRequestTypeDeviceControl,
+                IOCTL_LJB_VMON_BLT_BITMAP,
+                &InBlt,
+                sizeof(InBlt),
+                &OutBlt,
+                sizeof(OutBlt)
+                );
+            if (!NT_SUCCESS(ntStatus))
+            {
+                fprintf(stderr, "blt: BLT_BITMAP failed with 0x%08x\n", (UINT) ntStatus);
+                InterlockedIncrement(&BenchErrors);
+                break;
+            }
+            Blts++;
+            Elapsed = BenchTicks() - Start;
+        } while (BenchSeconds(Elapsed) < BENCH_RUN_SECONDS);
+
+        if (NT_SUCCESS(ntStatus))
+        {
+            Seconds = BenchSeconds(Elapsed);
+            printf("{\"suite\":\"blt\",\"width\":%u,\"height\":%u,\"blts\":%u,"
+                "\"seconds\":%.2f,\"blt_per_sec\":%.1f,\"mb_per_sec\":%.1f,"
+                "\"us_per_blt\":%.1f}\n",
+                Monitor.Width,
+                Monitor.Height,
+                Blts,
+                Seconds,
+                Blts / Seconds,
+                (double) Blts * Monitor.BufferSize / Seconds / (1024.0 * 1024.0),
+                Seconds * 1e6 / Blts
+                );
+        }
+        BenchStopMonitor(&Monitor);
+        free(Shadow);
+    }
+}
+
+/*
+ * Name:  BENCH_CHANNEL
+ *
+ * Description:
+ *    One monitor of the "monitors" suite: a consumer waiting on surface
+ *    updates, as one vmon.exe per monitor would, and a producer posting
+ *    the next update as soon as the consumer has a request queued. Posting
+ *    unpaced would only measure how often the scheduler lets a consumer
+ *    run between two updates.
+ */
+typedef struct _BENCH_CHANNEL
+{
+    BENCH_MONITOR           Monitor;
+    BENCH_WAITER            Waiter;
+    pthread_t               Producer;
+    pthread_t               Consumer;
+    volatile LONG *         Stop;
+    volatile LONG           Armed;
+    volatile LONG           Running;
+    ULONG                   Updates;
+    ULONG                   Events;
+} BENCH_CHANNEL;
+
+static void *
+BenchChannelProducer(
+    void *  Context
+    )
+{
+    BENCH_CHANNEL * CONST   Channel = Context;
+
+    while (!*Channel->Stop)
+    {
+        if (!Channel->Armed)
+        {
+            sched_yield();
+            continue;
+        }
+        InterlockedExchange(&Channel->Armed, 0);
+        BenchPostUpdate(&Channel->Monitor);
+        Channel->Updates++;
+    }
+    return NULL;
+}
+
+static void *
+BenchChannelConsumer(
+    void *  Context
+    )
+{
+    BENCH_CHANNEL * CONST   Channel = Context;
+    NTSTATUS                ntStatus;
+
+    while (!*Channel->Stop)
+    {
+        BenchWaitSend(&Channel->Waiter);
+        InterlockedExchange(&Channel->Armed, 1);
+        ntStatus = BenchWaitDone(&Channel->Waiter);
+        if (ntStatus == STATUS_CANCELLED)
+            break;
+        if (!NT_SUCCESS(ntStatus))
+        {
+            fprintf(stderr, "monitors: wait failed with 0x%08x\n", (UINT) ntStatus);
+            InterlockedIncrement(&BenchErrors);
+            break;
+        }
+        Channel->Events++;
+    }
+    InterlockedExchange(&Channel->Running, 0);
+    return NULL;
+}
+
+static VOID
+MonitorsSuite(VOID)
+{
+    static CONST UINT   Counts[] = { 1, 2, 4, 8, 16 };
+    BENCH_CHANNEL *     Channels;
+    volatile LONG       Stop;
+    ULONGLONG           Start;
+    double              Seconds;
+    ULONG64             Updates;
+    ULONG64             Events;
+    UINT                c;
+    UINT                i;
+
+    Channels = calloc(BENCH_MAX_MONITORS, sizeof(BENCH_CHANNEL));
+    if (Channels == NULL)
+    {
+        InterlockedIncrement(&BenchErrors);
+        return;
+    }
+
+    for (c = 0; c < sizeof(Counts) / sizeof(Counts[0]); c++)
+    {
+        Stop = 0;
+        for (i = 0; i < Counts[c]; i++)
+        {
+            if (!NT_SUCCESS(BenchStartMonitor(&Channels[i].Monitor, 1920, 1080)))
+            {
+                fprintf(stderr, "monitors: setup failed\n");
+                InterlockedIncrement(&BenchErrors);
+                free(Channels);
+                return;
+            }
+            BenchWaiterInit(&Channels[i].Waiter, &Channels[i].Monitor, 0);
+            Channels[i].Waiter.Seen.Flags.VidPnSourceBitmapChange = 1;
+            Channels[i].Waiter.Seen.Flags.PointerPositionChange = 1;
+            Channels[i].Stop = &Stop;
+            Channels[i].Armed = 0;
+            Channels[i].Running = 1;
+            Channels[i].Updates = 0;
+            Channels[i].Events = 0;
+        }
+
+        Start = BenchTicks();
+        for (i = 0; i < Counts[c]; i++)
+        {
+            pthread_create(&Channels[i].Consumer, NULL, &BenchChannelConsumer, &Channels[i]);
+            pthread_create(&Channels[i].Producer, NULL, &BenchChannelProducer, &Channels[i]);
+        }
+        while (BenchSeconds(BenchTicks() - Start) < BENCH_RUN_SECONDS)
+        {
+            struct timespec ts = { 0, 10 * 1000000L };
+
+            nanosleep(&ts, NULL);
+        }
+        InterlockedExchange(&Stop, 1);
+        Updates = 0;
+        Events = 0;
+        for (i = 0; i < Counts[c]; i++)
+        {
+            pthread_join(Channels[i].Producer, NULL);
+            Updates += Channels[i].Updates;
+        }
+        Seconds = BenchSeconds(BenchTicks() - Start);
+
+        /*
+         * cancel whatever the consumers still have queued, again if one
+         * queued another wait behind the removal
+         */
+        for (i = 0; i < Counts[c]; i++)
+        {
+            while (Channels[i].Running)
+            {
+                struct timespec ts = { 0, 1000000L };
+
+                HostWdfSurpriseRemoveDevice(Channels[i].Monitor.Device);
+                nanosleep(&ts, NULL);
+            }
+            pthread_join(Channels[i].Consumer, NULL);
+            sem_destroy(&Channels[i].Waiter.Done);
+            Events += Channels[i].Events;
+            BenchStopMonitor(&Channels[i].Monitor);
+        }
+
+        printf("{\"suite\":\"monitors\",\"monitors\":%u,\"seconds\":%.2f,"
+            "\"updates\":%llu,\"events\":%llu,\"events_per_sec\":%.0f,"
+            "\"events_per_sec_per_monitor\":%.0f}\n",
+            Counts[c],
+            Seconds,
+            (unsigned long long) Updates,
+            (unsigned long long) Events,
+            Events / Seconds,
+            Events / Seconds / Counts[c]
+            );
+    }
+    free(Channels);
+}
+
+/*
+ * Name:  BENCH_TRACE
+ *
+ * Description:
+ *    The trace suite's drain side: turns the trace on and off through
+ *    IOCTL_LJB_VMON_TRACE_CONTROL and appends what IOCTL_LJB_VMON_TRACE_DRAIN
+ *    returns to File, laid out as in ljb_vmon_trace.h.
+ */
+typedef struct _BENCH_TRACE
+{
+    BENCH_MONITOR *                 Monitor;
+    FILE *                          File;
+    LJB_VMON_TRACE_CONTROL_DATA     Control;
+    LJB_VMON_TRACE_DRAIN_DATA *     Drain;
+    SIZE_T                          DrainSize;
+    ULONG64                         Records;
+    ULONG64                         Dropped;
+    ULONG64                         Bytes;
+    ULONGLONG                       DrainTicks;
+    ULONG                           Drains;
+} BENCH_TRACE;
+
+static BOOLEAN
+BenchTraceControl(
+    __inout BENCH_TRACE *   Trace,
+    __in BOOLEAN            Enable
+    )
+{
+    LJB_VMON_TRACE_CONTROL_DATA     ControlData;
+    NTSTATUS                        ntStatus;
+
+    RtlZeroMemory(&ControlData, sizeof(ControlData));
+    ControlData.Enable = Enable;
+    ntStatus = BenchSendSync(
+        Trace->Monitor,
+        WdfRequestTypeDeviceControl,
+        IOCTL_LJB_VMON_TRACE_CONTROL,
+        &ControlData,
+        sizeof(ControlData),
+        &Trace->Control,
+        sizeof(Trace->Control)
+        );
+    if (!NT_SUCCESS(ntStatus))
+    {
+        fprintf(stderr, "trace: TRACE_CONTROL failed with 0x%08x\n", (UINT) ntStatus);
+        InterlockedIncrement(&BenchErrors);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Drain until the driver has nothing left, writing the records to the file
+ * when Keep is set.
+ */
+static BOOLEAN
+BenchTraceDrain(
+    __inout BENCH_TRACE *   Trace,
+    __in BOOLEAN            Keep
+    )
+{
+    ULONGLONG   Start;
+    SIZE_T      Size;
+    NTSTATUS    ntStatus;
+
+    do
+    {
+        Start = BenchTicks();
+        ntStatus = BenchSendSync(
+            Trace->Monitor,
+            WdfRequestTypeDeviceControl,
+            IOCTL_LJB_VMON_TRACE_DRAIN,
+            NULL,
+            0,
+            Trace->Drain,
+            Trace->DrainSize
+            );
+        if (!NT_SUCCESS(ntStatus))
+        {
+            fprintf(stderr, "trace: TRACE_DRAIN failed with 0x%08x\n", (UINT) ntStatus);
+            InterlockedIncrement(&BenchErrors);
+            return FALSE;
+        }
+        if (!Keep)
+            continue;
+
+        Trace->DrainTicks += BenchTicks() - Start;
+        Trace->Drains++;
+        Size = sizeof(LJB_VMON_TRACE_DRAIN_DATA) +
+            Trace->Drain->NumRecords * sizeof(LJB_VMON_TRACE_RECORD);
+        Trace->Records += Trace->Drain->NumRecords;
+        Trace->Dropped += Trace->Drain->DroppedRecords;
+        Trace->Bytes += Size;
+        if (Trace->File != NULL && fwrite(Trace->Drain, Size, 1, Trace->File) != 1)
+        {
+            perror("trace");
+            InterlockedIncrement(&BenchErrors);
+            return FALSE;
+        }
+    } while (Trace->Drain->NumRecords != 0);
+    return TRUE;
+}
+
+static VOID
+TraceSuite(
+    __in UINT           Iterations,
+    __in_opt CONST CHAR * TracePath
+    )
+{
+    BENCH_MONITOR               Monitor;
+    BENCH_TRACE                 Trace;
+    BENCH_WAITER                Waiter;
+    LJB_VMON_TRACE_FILE_HEADER  Header;
+    LJB_VMON_CTX *              dev_ctx;
+    LJB_VMON_WAIT_FLAGS         Flags;
+    BLT_DATA                    InBlt;
+    BLT_DATA                    OutBlt;
+    UCHAR *                     Shadow;
+    ULONGLONG *                 Samples;
+    ULONGLONG                   Start;
+    double                      Cost[2];
+    UINT                        Chunk;
+    UINT                        Done;
+    UINT                        i;
+    INT                         On;
+    NTSTATUS                    ntStatus;
+
+    RtlZeroMemory(&Trace, sizeof(Trace));
+    Trace.Monitor = &Monitor;
+    Trace.DrainSize = sizeof(LJB_VMON_TRACE_DRAIN_DATA) +
+        LJB_VMON_TRACE_RECORDS_PER_CPU * sizeof(LJB_VMON_TRACE_RECORD);
+    Trace.Drain = malloc(Trace.DrainSize);
+    Samples = malloc(Iterations * sizeof(ULONGLONG));
+    Shadow = malloc(1280 * 720 * 4);
+    if (Trace.Drain == NULL || Samples == NULL || Shadow == NULL ||
+        !NT_SUCCESS(BenchStartMonitor(&Monitor, 1280, 720)))
+    {
+        fprintf(stderr, "trace: setup failed\n");
+        InterlockedIncrement(&BenchErrors);
+        free(Trace.Drain);
+        free(Samples);
+        free(Shadow);
+        return;
+    }
+    dev_ctx = LJB_VMON_GetVMonCtx(Monitor.Device);
+
+    /*
+     * what a traced path pays per event, with the trace off and on
+     */
+    for (On = 0; On < 2; On++)
+    {
+        if (!BenchTraceControl(&Trace, (BOOLEAN) On))
+            goto exit;
+        Start = BenchTicks();
+        for (i = 0; i < BENCH_TRACE_EVENTS; i++)
+        {
+            LJB_VMON_TraceEvent(
+                dev_ctx,
+                LJB_VMON_TRACE_NOTIFY,
+                LCI_PROXYKMD_NOTIFY_PRIMARY_SURFACE_UPDATE,
+                i,
+                Monitor.hPrimarySurface,
+                LJB_VMON_TraceTimestamp(dev_ctx),
+                STATUS_SUCCESS
+                );
+        }
+        Cost[On] = BenchSeconds(BenchTicks() - Start) * 1e9 / BENCH_TRACE_EVENTS;
+    }
+    if (!BenchTraceControl(&Trace, FALSE) || !BenchTraceDrain(&Trace, FALSE))
+        goto exit;
+    printf("{\"suite\":\"trace\",\"event\":\"trace_event\",\"calls\":%u,"
+        "\"ns_per_call_off\":%.1f,\"ns_per_call_on\":%.1f,\"cpus\":%u,"
+        "\"records_per_cpu\":%u}\n",
+        BENCH_TRACE_EVENTS,
+        Cost[0],
+        Cost[1],
+        Trace.Control.NumCpus,
+        Trace.Control.RecordsPerCpu
+        );
+
+    /*
+     * wakeup latency with the trace off, then on and drained between chunks
+     */
+    Flags.Value = 0;
+    Flags.ModeChange = 1;
+    Flags.VidPnSourceVisibilityChange = 1;
+    Flags.VidPnSourceBitmapChange = 1;
+    Flags.PointerPositionChange = 1;
+    Flags.PointerShapeChange = 1;
+    for (On = 0; On < 2; On++)
+    {
+        if (!BenchTraceControl(&Trace, (BOOLEAN) On))
+            goto exit;
+        for (Done = 0; Done < Iterations; Done += Chunk)
+        {
+            Chunk = Iterations - Done < BENCH_TRACE_CHUNK ? Iterations - Done : BENCH_TRACE_CHUNK;
+            if (!BenchLatency(&Monitor, Flags.Value, 0, Chunk, Samples + Done))
+                goto exit;
+            if (On && !BenchTraceDrain(&Trace, FALSE))
+                goto exit;
+        }
+        printf("{\"suite\":\"trace\",\"event\":\"surface_update\",\"tracing\":%s,"
+            "\"samples\":%u,",
+            On ? "true" : "false",
+            Iterations
+            );
+        PrintLatency(Samples, Iterations);
+        printf("}\n");
+    }
+
+    /*
+     * the capture loop, traced into the file
+     */
+    if (TracePath != NULL)
+    {
+        Trace.File = fopen(TracePath, "wb");
+        if (Trace.File == NULL)
+        {
+            perror(TracePath);
+            InterlockedIncrement(&BenchErrors);
+            goto exit;
+        }
+        RtlZeroMemory(&Header, sizeof(Header));
+        RtlCopyMemory(Header.Signature, LJB_VMON_TRACE_SIGNATURE, sizeof(Header.Signature));
+        Header.Version = LJB_VMON_TRACE_VERSION;
+        Header.HeaderSize = sizeof(Header);
+        Header.TimestampFrequency = Trace.Control.TimestampFrequency;
+        Header.NumCpus = Trace.Control.NumCpus;
+        Header.RecordSize = sizeof(LJB_VMON_TRACE_RECORD);
+        fwrite(&Header, sizeof(Header), 1, Trace.File);
+    }
+
+    BenchWaiterInit(&Waiter, &Monitor, Flags.Value);
+    RtlZeroMemory(&InBlt, sizeof(InBlt));
+    InBlt.Width = Monitor.Width;
+    InBlt.Height = Monitor.Height;
+    InBlt.FrameBuffer = (UINT64) (ULONG_PTR) Shadow;
+    Start = BenchTicks();
+    for (i = 0; i < Iterations; i++)
+    {
+        BenchPostUpdate(&Monitor);
+        BenchWaitSend(&Waiter);
+        if (!NT_SUCCESS(BenchWaitDone(&Waiter)))
+        {
+            fprintf(stderr, "trace: wait failed with 0x%08x\n", (UINT) Waiter.Request.Status);
+            InterlockedIncrement(&BenchErrors);
+            break;
+        }
+        ntStatus = BenchSendSync(
+            &Monitor,
+            WdfRequestTypeDeviceControl,
+            IOCTL_LJB_VMON_BLT_BITMAP,
+            &InBlt,
+            sizeof(InBlt),
+            &OutBlt,
+            sizeof(OutBlt)
+            );
+        if (!NT_SUCCESS(ntStatus))
+        {
+            fprintf(stderr, "trace: BLT_BITMAP failed with 0x%08x\n", (UINT) ntStatus);
+            InterlockedIncrement(&BenchErrors);
+            break;
+        }
+        if ((i + 1) % BENCH_TRACE_CHUNK == 0 && !BenchTraceDrain(&Trace, TRUE))
+            break;
+    }
+    sem_destroy(&Waiter.Done);
+    if (BenchTraceControl(&Trace, FALSE) && BenchTraceDrain(&Trace, TRUE))
+    {
+        printf("{\"suite\":\"trace\",\"event\":\"capture\",\"frames\":%u,"
+            "\"seconds\":%.2f,\"records\":%llu,\"dropped\":%llu,\"bytes\":%llu,"
+            "\"drains\":%u,\"us_per_drain\":%.1f}\n",
+            i,
+            BenchSeconds(BenchTicks() - Start),
+            (unsigned long long) Trace.Records,
+            (unsigned long long) Trace.Dropped,
+            (unsigned long long) Trace.Bytes,
+            Trace.Drains,
+            Trace.Drains != 0 ? BenchSeconds(Trace.DrainTicks) * 1e6 / Trace.Drains : 0.0
+            );
+    }
+
+exit:
+    if (Trace.File != NULL && fclose(Trace.File) != 0)
+    {
+        perror(TracePath);
+        InterlockedIncrement(&BenchErrors);
+    }
+    BenchStopMonitor(&Monitor);
+    free(Trace.Drain);
+    free(Samples);
+    free(Shadow);
+}
+
+int
+main(
+    int     argc,
+    char ** argv
+    )
+{
+    static DRIVER_OBJECT    DriverObject;
+    static UNICODE_STRING   RegistryPath;
+    CONST CHAR *            Suite = "all";
+    CONST CHAR *            TracePath = NULL;
+    UINT                    Iterations = 20000;
+    BOOLEAN                 All;
+    LONG                    Leaked;
+    int                     i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            Iterations = (UINT) strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            TracePath = argv[++i];
+        else
+            Suite = argv[i];
+    }
+    if (Iterations == 0)
+        Iterations = 1;
+
+    if (!NT_SUCCESS(DriverEntry(&DriverObject, &RegistryPath)))
+    {
+        fprintf(stderr, "func_bench: DriverEntry failed\n");
+        return 1;
+    }
+
+    All = (BOOLEAN) (strcmp(Suite, "all") == 0);
+    if (All || strcmp(Suite, "wake") == 0)
+        WakeSuite(Iterations);
+    if (All || strcmp(Suite, "blt") == 0)
+        BltSuite();
+    if (All || strcmp(Suite, "cursor") == 0)
+        CursorSuite(Iterations);
+    if (All || strcmp(Suite, "monitors") == 0)
+        MonitorsSuite();
+    if (All || strcmp(Suite, "trace") == 0)
+        TraceSuite(Iterations, TracePath);
+
+    Leaked = HostWdkOutstandingAllocations();
+    if (Leaked != 0)
+    {
+        fprintf(stderr, "func_bench: %ld pool allocations leaked\n", (long) Leaked);
+        return 1;
+    }
+    return BenchErrors != 0 ? 1 : 0;
+}
@@ -0,0 +1,1077 @@
+/*!
+    \file       vmon_func_stress.c
+    \brief      Multi-threaded stress harness for the func/source driver
+    \details    Links the monitor driver's notification, wait, blit and
+                cleanup paths, unmodified, against the user-space kernel and
+                KMDF stand-ins in host/include and vmon_host_wdk.c, then
+                hammers them from many threads. Builds and runs on Linux:
+
+                gcc -std=gnu89 -O2 -Wall -Wno-unknown-pragmas -Wno-multichar \
+                    -pthread -Ihost/include -Iinclude -Ifunc/source \
+                    host/source/vmon_func_stress.c host/source/vmon_host_wdk.c \
+                    func/source/ljb_vmon_driver_entry.c \
+                    func/source/ljb_vmon_power.c \
+                    func/source/ljb_vmon_io_in_caller_ctx.c \
+                    func/source/ljb_vmon_io_stop.c \
+                    func/source/ljb_vmon_ioctl.c \
+                    func/source/ljb_vmon_internal_ioctl.c \
+                    func/source/ljb_vmon_generic_ioctl.c \
+                    func/source/ljb_vmon_guid.c \
+                    func/source/ljb_vmon_trace.c \
+                    -o vmon_func_stress
+
+                vmon_func_stress [-w waiters] [-n notifiers] [-b blitters]
+                                 [-t seconds] [-m WIDTHxHEIGHT] [-c]
+
+                The harness loads the driver, starts the device and hands it
+                a ProxyKMD interface through
+                INTERNAL_IOCTL_QUERY_USB_MONITOR_INTERFACE. Waiter threads
+                (1000 by default) then loop on
+                IOCTL_LJB_VMON_WAIT_FOR_MONITOR_EVENT as vmon.exe does,
+                notifier threads post surface updates, and blitter threads
+                issue IOCTL_LJB_VMON_BLT_BITMAP. Notifier 0 alone also posts
+                pointer, visibility and VidPn updates, since dxgkrnl
+                serializes those DDIs. -c adds a thread that keeps replacing
+                the primary surface, which exercises BltBitmap using a
+                surface it looked up without taking a reference.
+
+                A lost wakeup is a wait request left queued although the
+                state it waits on has already moved past what it last saw.
+                While the run is going, an auditor looks for those on the
+                frame and pointer position, which their notifications update
+                and scan for under ioctl_lock; once the producers stop, every
+                queued request is checked against the final state. The device
+                is then surprise removed until every waiter has been
+                cancelled, and removed.
+
+                Prints one JSON object. Exits with status 1 when a wakeup was
+                lost, a request failed unexpectedly, or pool or MDLs leaked; a
+                request completed twice aborts. Failed blits only count as
+                failures without -c.
+ */
+
+#include <ntddk.h>
+#include <wdf.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <errno.h>
+#include "ljb_vmon_private.h"
+
+#define STRESS_WAITER_STACK_SIZE    (64 * 1024)
+#define STRESS_MAX_SURFACES         2
+#define STRESS_CURSOR_SIZE          32
+#define STRESS_AUDIT_INTERVAL_MS    10
+
+typedef struct _STRESS_SURFACE
+{
+    HANDLE              hPrimarySurface;
+    UCHAR *             Buffer;
+    SIZE_T              BufferSize;
+} STRESS_SURFACE;
+
+typedef struct _STRESS_WAITER
+{
+    struct _STRESS *    Stress;
+    pthread_t           Thread;
+    sem_t               Done;
+    WDF_HOST_REQUEST    Request;
+    BOOLEAN             Lost;           // already counted for this request
+    ULONG               Wakeups;
+    ULONG               Errors;
+} STRESS_WAITER;
+
+typedef struct _STRESS
+{
+    WDFDEVICE               Device;
+    LJB_VMON_CTX *          dev_ctx;
+    LCI_GENERIC_INTERFACE   ProxyInterface;     // up-calls serviced here
+    LCI_GENERIC_INTERFACE   MonitorInterface;   // down-calls go here
+
+    UINT                    Width;
+    UINT                    Height;
+    UINT                    NumWaiters;
+    UINT                    NumNotifiers;
+    UINT                    NumBlitters;
+    UINT                    Seconds;
+    BOOLEAN                 Churn;
+
+    /*
+     * the ProxyKMD side: surfaces[0] is the one being presented
+     */
+    pthread_mutex_t         SurfaceLock;
+    STRESS_SURFACE          Surfaces[STRESS_MAX_SURFACES];
+    ULONG_PTR               NextHandle;
+
+    volatile LONG           StopProducers;
+    volatile LONG           StopWaiters;
+    volatile LONG           WaitersRunning;
+    volatile LONG           FrameId;
+
+    /*
+     * counters
+     */
+    volatile LONG           SurfaceUpdates;
+    volatile LONG           CursorUpdates;
+    volatile LONG           VidPnUpdates;
+    volatile LONG           SurfaceChurns;
+    volatile LONG           Blts;
+    volatile LONG           BltsFailed;
+    volatile LONG           StaleBlts;
+    volatile LONG           LostWakeups;
+    volatile LONG           Errors;
+    LONG                    QueuedAtStop;
+} STRESS;
+
+/*
+ * the driver's WMI code is not part of the host build
+ */
+NTSTATUS
+VMON_WmiRegistration(
+    __in WDFDEVICE Device
+    )
+{
+    UNREFERENCED_PARAMETER(Device);
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+LJB_VMON_FireArrivalEvent(
+    __in WDFDEVICE  Device
+    )
+{
+    UNREFERENCED_PARAMETER(Device);
+    return STATUS_SUCCESS;
+}
+
+static double
+StressNow(VOID)
+{
+    LARGE_INTEGER   Counter;
+    LARGE_INTEGER   Frequency;
+
+    QueryPerformanceCounter(&Counter);
+    QueryPerformanceFrequency(&Frequency);
+    return (double) Counter.QuadPart / (double) Frequency.QuadPart;
+}
+
+static VOID
+StressSleep(
+    __in UINT   Milliseconds
+    )
+{
+    struct timespec ts;
+
+    ts.tv_sec = Milliseconds / 1000;
+    ts.tv_nsec = (long) (Milliseconds % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+static UINT32
+StressRandom(
+    __inout UINT32 *    State
+    )
+{
+    *State ^= *State << 13;
+    *State ^= *State >> 17;
+    *State ^= *State << 5;
+    return *State;
+}
+
+/*
+ * Name:  ProxyGenericIoctl
+ *
+ * Description:
+ *    The up-calls the driver makes into ProxyKMD. A blit naming a surface
+ *    ProxyKMD no longer has is refused and counted as stale; on Windows the
+ *    driver would have read the surface after it was freed.
+ */
+static NTSTATUS
+ProxyGenericIoctl(
+    __in PVOID          ProviderContext,
+    __in ULONG          IoctlCode,
+    __in_opt PVOID      InputBuffer,
+    __in SIZE_T         InputBufferSize,
+    __out_opt PVOID     OutputBuffer,
+    __in SIZE_T         OutputBufferSize,
+    __out ULONG *       BytesReturned
+    )
+{
+    STRESS * CONST          Stress = ProviderContext;
+    LCI_USBAV_BLT_DATA *    BltData;
+    STRESS_SURFACE *        Surface;
+    NTSTATUS                ntStatus;
+    UINT                    i;
+
+    UNREFERENCED_PARAMETER(OutputBuffer);
+    UNREFERENCED_PARAMETER(OutputBufferSize);
+    *BytesReturned = 0;
+    ntStatus = STATUS_NOT_SUPPORTED;
+    switch (IoctlCode)
+    {
+    case LCI_USBAV_BLT_PRIMARY_TO_SHADOW:
+        if (InputBufferSize < sizeof(LCI_USBAV_BLT_DATA))
+        {
+            ntStatus = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+        BltData = InputBuffer;
+        pthread_mutex_lock(&Stress->SurfaceLock);
+        Surface = NULL;
+        for (i = 0; i < STRESS_MAX_SURFACES; i++)
+        {
+            if (Stress->Surfaces[i].Buffer != NULL &&
+                Stress->Surfaces[i].hPrimarySurface == BltData->hPrimarySurface &&
+                Stress->Surfaces[i].Buffer == BltData->pPrimaryBuffer)
+            {
+                Surface = &Stress->Surfaces[i];
+                break;
+            }
+        }
+        if (Surface == NULL)
+        {
+            InterlockedIncrement(&Stress->StaleBlts);
+            ntStatus = STATUS_INVALID_HANDLE;
+        }
+        else
+        {
+            RtlCopyMemory(
+                BltData->pShadowBuffer,
+                Surface->Buffer,
+                BltData->BufferSize < Surface->BufferSize ?
+                    BltData->BufferSize : Surface->BufferSize
+                );
+            ntStatus = STATUS_SUCCESS;
+        }
+        pthread_mutex_unlock(&Stress->SurfaceLock);
+        break;
+
+    case LCI_USBAV_LOCK_PRIMARY_SURFACE:
+    case LCI_USBAV_UNLOCK_PRIMARY_SURFACE:
+        ntStatus = STATUS_SUCCESS;
+        break;
+
+    default:
+        break;
+    }
+    return ntStatus;
+}
+
+static VOID
+ProxyReleaseInterface(
+    __in PVOID  ProviderContext
+    )
+{
+    UNREFERENCED_PARAMETER(ProviderContext);
+}
+
+/*
+ * Down-call into the driver. LJB_VMON_GenericIoctl answers most
+ * notifications with STATUS_NOT_SUPPORTED even when it acted on them, so,
+ * like ProxyKMD, the harness does not look at the status.
+ */
+static VOID
+StressNotify(
+    __in STRESS *       Stress,
+    __in ULONG          IoctlCode,
+    __in PVOID          InputBuffer,
+    __in SIZE_T         InputBufferSize
+    )
+{
+    LCI_GENERIC_INTERFACE * CONST   Monitor = &Stress->MonitorInterface;
+    ULONG                           BytesReturned;
+
+    (VOID) (*Monitor->pfnGenericIoctl)(
+        Monitor->ProviderContext,
+        IoctlCode,
+        InputBuffer,
+        InputBufferSize,
+        NULL,
+        0,
+        &BytesReturned
+        );
+}
+
+/*
+ * Create a primary surface in slot Index and tell the driver about it.
+ */
+static NTSTATUS
+StressCreateSurface(
+    __in STRESS *   Stress,
+    __in UINT       Index
+    )
+{
+    STRESS_SURFACE                      Surface;
+    LCI_PROXYKMD_PRIMARY_SURFACE_CREATE CreateData;
+
+    Surface.BufferSize = (SIZE_T) Stress->Width * Stress->Height * 4;
+    Surface.Buffer = malloc(Surface.BufferSize);
+    if (Surface.Buffer == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+    RtlFillMemory(Surface.Buffer, Surface.BufferSize, 0x80);
+
+    pthread_mutex_lock(&Stress->SurfaceLock);
+    Surface.hPrimarySurface = (HANDLE) ++Stress->NextHandle;
+    Stress->Surfaces[Index] = Surface;
+    pthread_mutex_unlock(&Stress->SurfaceLock);
+
+    RtlZeroMemory(&CreateData, sizeof(CreateData));
+    CreateData.hPrimarySurface = Surface.hPrimarySurface;
+    CreateData.pBuffer = Surface.Buffer;
+    CreateData.BufferSize = Surface.BufferSize;
+    CreateData.Width = Stress->Width;
+    CreateData.Height = Stress->Height;
+    CreateData.Pitch = Stress->Width * 4;
+    CreateData.BytesPerPixel = 4;
+    StressNotify(
+        Stress,
+        LCI_PROXYKMD_NOTIFY_PRIMARY_SURFACE_CREATE,
+        &CreateData,
+        sizeof(CreateData)
+        );
+    return STATUS_SUCCESS;
+}
+
+static VOID
+StressDestroySurface(
+    __in STRESS *   Stress,
+    __in UINT       Index
+    )
+{
+    STRESS_SURFACE                          Surface;
+    LCI_PROXYKMD_PRIMARY_SURFACE_DESTROY    DestroyData;
+
+    Surface = Stress->Surfaces[Index];
+    if (Surface.Buffer == NULL)
+        return;
+
+    RtlZeroMemory(&DestroyData, sizeof(DestroyData));
+    DestroyData.hPrimarySurface = Surface.hPrimarySurface;
+    DestroyData.pBuffer = Surface.Buffer;
+    DestroyData.BufferSize = Surface.BufferSize;
+    DestroyData.Width = Stress->Width;
+    DestroyData.Height = Stress->Height;
+    DestroyData.Pitch = Stress->Width * 4;
+    DestroyData.BytesPerPixel = 4;
+    StressNotify(
+        Stress,
+        LCI_PROXYKMD_NOTIFY_PRIMARY_SURFACE_DESTROY,
+        &DestroyData,
+        sizeof(DestroyData)
+        );
+
+    pthread_mutex_lock(&Stress->SurfaceLock);
+    RtlZeroMemory(&Stress->Surfaces[Index], sizeof(STRESS_SURFACE));
+    pthread_mutex_unlock(&Stress->SurfaceLock);
+    free(Surface.Buffer);
+}
+
+static VOID
+StressPostUpdate(
+    __in STRESS *   Stress
+    )
+{
+    LCI_PROXYKMD_PRIMARY_SURFACE_UPDATE UpdateData;
+
+    RtlZeroMemory(&UpdateData, sizeof(UpdateData));
+    pthread_mutex_lock(&Stress->SurfaceLock);
+    UpdateData.hPrimarySurface = Stress->Surfaces[0].hPrimarySurface;
+    UpdateData.pBuffer = Stress->Surfaces[0].Buffer;
+    UpdateData.BufferSize = Stress->Surfaces[0].BufferSize;
+    pthread_mutex_unlock(&Stress->SurfaceLock);
+    UpdateData.FrameId = (ULONG) InterlockedIncrement(&Stress->FrameId);
+    UpdateData.Width = Stress->Width;
+    UpdateData.Height = Stress->Height;
+    UpdateData.Pitch = Stress->Width * 4;
+    UpdateData.BytesPerPixel = 4;
+    StressNotify(
+        Stress,
+        LCI_PROXYKMD_NOTIFY_PRIMARY_SURFACE_UPDATE,
+        &UpdateData,
+        sizeof(UpdateData)
+        );
+    InterlockedIncrement(&Stress->SurfaceUpdates);
+}
+
+static VOID
+StressPostCommit(
+    __in STRESS *                           Stress,
+    __in D3DKMDT_VIDPN_PRESENT_PATH_ROTATION Rotation
+    )
+{
+    LCI_PROXYKMD_COMMIT_VIDPN   CommitData;
+
+    RtlZeroMemory(&CommitData, sizeof(CommitData));
+    CommitData.Width = Stress->Width;
+    CommitData.Height = Stress->Height;
+    CommitData.Pitch = Stress->Width * 4;
+    CommitData.BytesPerPixel = 4;
+    CommitData.ContentTransformation.Scaling = D3DKMDT_VPPS_IDENTITY;
+    CommitData.ContentTransformation.Rotation = Rotation;
+    StressNotify(
+        Stress,
+        LCI_PROXYKMD_NOTIFY_COMMIT_VIDPN,
+        &CommitData,
+        sizeof(CommitData)
+        );
+}
+
+static VOID
+StressPostVisibility(
+    __in STRESS *   Stress,
+    __in BOOLEAN    Visible
+    )
+{
+    LCI_PROXYKMD_VISIBILITY_UPDATE  VisibilityData;
+
+    RtlZeroMemory(&VisibilityData, sizeof(VisibilityData));
+    VisibilityData.Visible = Visible;
+    StressNotify(
+        Stress,
+        LCI_PROXYKMD_NOTIFY_VISIBILITY_UPDATE,
+        &VisibilityData,
+        sizeof(VisibilityData)
+        );
+}
+
+static VOID
+StressPostCursor(
+    __in STRESS *       Stress,
+    __inout UINT32 *    Random,
+    __in BOOLEAN        Shape
+    )
+{
+    static UCHAR                    Pixels[STRESS_CURSOR_SIZE * STRESS_CURSOR_SIZE * 4];
+    DXGKARG_SETPOINTERPOSITION      Position;
+    DXGKARG_SETPOINTERSHAPE         ShapeData;
+    LCI_PROXYKMD_CURSOR_UPDATE      CursorData;
+
+    RtlZeroMemory(&CursorData, sizeof(CursorData));
+    RtlZeroMemory(&Position, sizeof(Position));
+    Position.X = (INT) (StressRandom(Random) % Stress->Width);
+    Position.Y = (INT) (StressRandom(Random) % Stress->Height);
+    Position.Flags.Visible = 1;
+    CursorData.pPositionUpdate = &Position;
+    if (Shape)
+    {
+        RtlZeroMemory(&ShapeData, sizeof(ShapeData));
+        ShapeData.Flags.Color = 1;
+        ShapeData.Width = STRESS_CURSOR_SIZE;
+        ShapeData.Height = STRESS_CURSOR_SIZE;
+        ShapeData.Pitch = STRESS_CURSOR_SIZE * 4;
+        ShapeData.pPixels = Pixels;
+        CursorData.pShapeUpdate = &ShapeData;
+    }
+    StressNotify(
+        Stress,
+        LCI_PROXYKMD_NOTIFY_CURSOR_UPDATE,
+        &CursorData,
+        sizeof(CursorData)
+        );
+    InterlockedIncrement(&Stress->CursorUpdates);
+}
+
+/*
+ * Name:  StressNotifier
+ *
+ * Description:
+ *    Posts surface updates back to back. Notifier 0 mixes in a pointer
+ *    move every 4th update, a new shape every 64th, and a visibility
+ *    toggle or a rotation change every 1024th.
+ */
+typedef struct _STRESS_NOTIFIER
+{
+    STRESS *    Stress;
+    UINT        Index;
+    pthread_t   Thread;
+} STRESS_NOTIFIER;
+
+static void *
+StressNotifier(
+    void *  Context
+    )
+{
+    STRESS_NOTIFIER * CONST Notifier = Context;
+    STRESS * CONST          Stress = Notifier->Stress;
+    UINT32                  Random;
+    ULONG                   i;
+
+    Random = 0x9E3779B9 ^ Notifier->Index;
+    for (i = 1; !Stress->StopProducers; i++)
+    {
+        StressPostUpdate(Stress);
+        if (Notifier->Index != 0)
+            continue;
+
+        if ((i % 4) == 0)
+            StressPostCursor(Stress, &Random, (BOOLEAN) ((i % 64) == 0));
+        if ((i % 1024) == 0)
+        {
+            if ((i % 2048) == 0)
+            {
+                StressPostCommit(
+                    Stress,
+                    (i % 4096) == 0 ? D3DKMDT_VPPR_IDENTITY : D3DKMDT_VPPR_ROTATE180
+                    );
+            }
+            else
+            {
+                StressPostVisibility(Stress, (BOOLEAN) ((i % 3072) != 0));
+            }
+            InterlockedIncrement(&Stress->VidPnUpdates);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Name:  StressChurn
+ *
+ * Description:
+ *    Replaces the presented surface over and over the way ProxyKMD does on
+ *    a flip chain change: create the new one, present it, destroy the old.
+ */
+static void *
+StressChurn(
+    void *  Context
+    )
+{
+    STRESS * CONST  Stress = Context;
+
+    while (!Stress->StopProducers)
+    {
+        if (!NT_SUCCESS(StressCreateSurface(Stress, 1)))
+            break;
+
+        pthread_mutex_lock(&Stress->SurfaceLock);
+        {
+            STRESS_SURFACE CONST    Old = Stress->Surfaces[0];
+
+            Stress->Surfaces[0] = Stress->Surfaces[1];
+            Stress->Surfaces[1] = Old;
+        }
+        pthread_mutex_unlock(&Stress->SurfaceLock);
+        StressPostUpdate(Stress);
+        StressDestroySurface(Stress, 1);
+        InterlockedIncrement(&Stress->SurfaceChurns);
+        StressSleep(1);
+    }
+    return NULL;
+}
+
+/*
+ * Send a request the driver completes before returning, as the blit and
+ * the interface query are.
+ */
+static NTSTATUS
+StressSendSync(
+    __in STRESS *       Stress,
+    __in WDF_REQUEST_TYPE Type,
+    __in ULONG          IoControlCode,
+    __in PVOID          InputBuffer,
+    __in size_t         InputBufferLength,
+    __out PVOID         OutputBuffer,
+    __in size_t         OutputBufferLength
+    )
+{
+    WDF_HOST_REQUEST    Request;
+    NTSTATUS            ntStatus;
+
+    ntStatus = HostWdfRequestInit(
+        &Request,
+        Type,
+        IoControlCode,
+        InputBuffer,
+        InputBufferLength,
+        OutputBuffer,
+        OutputBufferLength,
+        NULL,
+        NULL
+        );
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+
+    HostWdfSendRequest(Stress->Device, &Request);
+    if (!Request.Completed)
+    {
+        fprintf(stderr, "func_stress: IOCTL(0x%x) left pending\n", IoControlCode);
+        abort();
+    }
+    return Request.Status;
+}
+
+typedef struct _STRESS_BLITTER
+{
+    STRESS *    Stress;
+    pthread_t   Thread;
+} STRESS_BLITTER;
+
+static void *
+StressBlitter(
+    void *  Context
+    )
+{
+    STRESS_BLITTER * CONST  Blitter = Context;
+    STRESS * CONST          Stress = Blitter->Stress;
+    BLT_DATA                InBlt;
+    BLT_DATA                OutBlt;
+    UCHAR *                 Shadow;
+    NTSTATUS                ntStatus;
+
+    Shadow = malloc((SIZE_T) Stress->Width * Stress->Height * 4);
+    if (Shadow == NULL)
+    {
+        InterlockedIncrement(&Stress->Errors);
+        return NULL;
+    }
+
+    RtlZeroMemory(&InBlt, sizeof(InBlt));
+    InBlt.Width = Stress->Width;
+    InBlt.Height = Stress->Height;
+    InBlt.FrameBuffer = (UINT64) (ULONG_PTR) Shadow;
+    while (!Stress->StopProducers)
+    {
+        ntStatus = StressSendSync(
+            Stress,
+            WdfRequestTypeDeviceControl,
+            IOCTL_LJB_VMON_BLT_BITMAP,
+            &InBlt,
+            sizeof(InBlt),
+            &OutBlt,
+            sizeof(OutBlt)
+            );
+        if (NT_SUCCESS(ntStatus))
+            InterlockedIncrement(&Stress->Blts);
+        else
+            InterlockedIncrement(&Stress->BltsFailed);
+    }
+    free(Shadow);
+    return NULL;
+}
+
+static VOID
+StressWaiterComplete(
+    WDFREQUEST  Request,
+    PVOID       Context
+    )
+{
+    STRESS_WAITER * CONST   Waiter = Context;
+
+    UNREFERENCED_PARAMETER(Request);
+    sem_post(&Waiter->Done);
+}
+
+/*
+ * Name:  StressWaiter
+ *
+ * Description:
+ *    What vmon.exe's capture loop does with the wait IOCTL: ask for every
+ *    kind of change relative to the state last reported, and fold each
+ *    answer into that state. Runs until its request is cancelled.
+ */
+static void *
+StressWaiter(
+    void *  Context
+    )
+{
+    STRESS_WAITER * CONST   Waiter = Context;
+    STRESS * CONST          Stress = Waiter->Stress;
+    LJB_VMON_MONITOR_EVENT  Seen;
+    LJB_VMON_MONITOR_EVENT  Event;
+    NTSTATUS                ntStatus;
+
+    RtlZeroMemory(&Seen, sizeof(Seen));
+    Seen.Flags.ModeChange = 1;
+    Seen.Flags.VidPnSourceVisibilityChange = 1;
+    Seen.Flags.VidPnSourceBitmapChange = 1;
+    Seen.Flags.PointerPositionChange = 1;
+    Seen.Flags.PointerShapeChange = 1;
+    while (!Stress->StopWaiters)
+    {
+        Waiter->Lost = FALSE;
+        ntStatus = HostWdfRequestInit(
+            &Waiter->Request,
+            WdfRequestTypeDeviceControl,
+            IOCTL_LJB_VMON_WAIT_FOR_MONITOR_EVENT,
+            &Seen,
+            sizeof(Seen),
+            &Event,
+            sizeof(Event),
+            &StressWaiterComplete,
+            Waiter
+            );
+        if (!NT_SUCCESS(ntStatus))
+        {
+            Waiter->Errors++;
+            break;
+        }
+        HostWdfSendRequest(Stress->Device, &Waiter->Request);
+        while (sem_wait(&Waiter->Done) != 0 && errno == EINTR)
+            ;
+
+        ntStatus = Waiter->Request.Status;
+        if (ntStatus == STATUS_CANCELLED)
+            break;
+        if (!NT_SUCCESS(ntStatus))
+        {
+            fprintf(stderr, "func_stress: wait failed with 0x%08x\n", (UINT) ntStatus);
+            Waiter->Errors++;
+            break;
+        }
+
+        if (Event.Flags.ModeChange)
+            Seen.TargetModeData = Event.TargetModeData;
+        if (Event.Flags.VidPnSourceVisibilityChange)
+            Seen.VidPnSourceVisibilityData = Event.VidPnSourceVisibilityData;
+        if (Event.Flags.VidPnSourceBitmapChange)
+            Seen.FrameId = Event.FrameId;
+        if (Event.Flags.PointerPositionChange)
+            Seen.PointerPositionData = Event.PointerPositionData;
+        Waiter->Wakeups++;
+    }
+    InterlockedDecrement(&Stress->WaitersRunning);
+    return NULL;
+}
+
+/*
+ * Name:  StressAuditQueue
+ *
+ * Description:
+ *    Walk the driver's queued wait requests and count the ones that should
+ *    have been completed already. With Final clear only the frame and the
+ *    pointer position are judged, which are stable while ioctl_lock is
+ *    held; with Final set the producers have stopped and every field is.
+ *
+ * Return Value:
+ *    The number of queued requests.
+ */
+static LONG
+StressAuditQueue(
+    __in STRESS *   Stress,
+    __in BOOLEAN    Final
+    )
+{
+    LJB_VMON_CTX * CONST            dev_ctx = Stress->dev_ctx;
+    LIST_ENTRY * CONST              list_head = &dev_ctx->event_req_list;
+    LIST_ENTRY *                    list_entry;
+    LJB_VMON_WAIT_FOR_EVENT_REQ *   wait_event_req;
+    LJB_VMON_MONITOR_EVENT *        Seen;
+    STRESS_WAITER *                 Waiter;
+    KIRQL                           old_irql_ioctl;
+    KIRQL                           old_irql;
+    BOOLEAN                         Stale;
+    LONG                            Queued;
+
+    Queued = 0;
+    KeAcquireSpinLock(&dev_ctx->ioctl_lock, &old_irql_ioctl);
+    KeAcquireSpinLock(&dev_ctx->event_req_lock, &old_irql);
+    for (list_entry = list_head->Flink;
+        list_entry != list_head;
+        list_entry = list_entry->Flink)
+    {
+        wait_event_req = CONTAINING_RECORD(
+            list_entry,
+            LJB_VMON_WAIT_FOR_EVENT_REQ,
+            list_entry
+            );
+        Seen = wait_event_req->in_event_data;
+        Waiter = wait_event_req->Request->CompleteContext;
+        Queued++;
+
+        Stale =
+            (Seen->Flags.VidPnSourceBitmapChange &&
+            Seen->FrameId != dev_ctx->LatestFrameId) ||
+            (Seen->Flags.PointerPositionChange &&
+            (Seen->PointerPositionData.X != dev_ctx->PointerInfo.X ||
+            Seen->PointerPositionData.Y != dev_ctx->PointerInfo.Y ||
+            Seen->PointerPositionData.Visible != dev_ctx->PointerInfo.Visible));
+        if (Final)
+        {
+            Stale = Stale ||
+                (Seen->Flags.ModeChange &&
+                (Seen->TargetModeData.Width != dev_ctx->Width ||
+                Seen->TargetModeData.Height != dev_ctx->Height ||
+                Seen->TargetModeData.Rotation != dev_ctx->ContentTransformation.Rotation)) ||
+                (Seen->Flags.VidPnSourceVisibilityChange &&
+                Seen->VidPnSourceVisibilityData.Visible != dev_ctx->VidPnVisible);
+        }
+        if (Stale && !Waiter->Lost)
+        {
+            Waiter->Lost = TRUE;
+            InterlockedIncrement(&Stress->LostWakeups);
+        }
+    }
+    KeReleaseSpinLock(&dev_ctx->event_req_lock, old_irql);
+    KeReleaseSpinLock(&dev_ctx->ioctl_lock, old_irql_ioctl);
+    return Queued;
+}
+
+static void *
+StressAuditor(
+    void *  Context
+    )
+{
+    STRESS * CONST  Stress = Context;
+
+    while (!Stress->StopProducers)
+    {
+        StressAuditQueue(Stress, FALSE);
+        StressSleep(STRESS_AUDIT_INTERVAL_MS);
+    }
+    return NULL;
+}
+
+/*
+ * Load the driver and bring the device up as far as vmon.exe needs it:
+ * started, bound to ProxyKMD, a mode committed and a surface presented.
+ */
+static NTSTATUS
+StressStartDevice(
+    __in STRESS *   Stress
+    )
+{
+    static DRIVER_OBJECT    DriverObject;
+    static UNICODE_STRING   RegistryPath;
+    NTSTATUS                ntStatus;
+
+    ntStatus = DriverEntry(&DriverObject, &RegistryPath);
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+    ntStatus = HostWdfAddDevice(&Stress->Device);
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+    Stress->dev_ctx = LJB_VMON_GetVMonCtx(Stress->Device);
+    Stress->dev_ctx->DebugLevel = DBGLVL_ERROR;
+    ntStatus = HostWdfStartDevice(Stress->Device);
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+
+    Stress->ProxyInterface.Version = LCI_GENERIC_INTERFACE_V1;
+    Stress->ProxyInterface.Size = sizeof(LCI_GENERIC_INTERFACE);
+    Stress->ProxyInterface.ProviderContext = Stress;
+    Stress->ProxyInterface.pfnGenericIoctl = &ProxyGenericIoctl;
+    Stress->ProxyInterface.pfnReleaseInterface = &ProxyReleaseInterface;
+    ntStatus = StressSendSync(
+        Stress,
+        WdfRequestTypeDeviceControlInternal,
+        INTERNAL_IOCTL_QUERY_USB_MONITOR_INTERFACE,
+        &Stress->ProxyInterface,
+        sizeof(Stress->ProxyInterface),
+        &Stress->MonitorInterface,
+        sizeof(Stress->MonitorInterface)
+        );
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+
+    StressPostCommit(Stress, D3DKMDT_VPPR_IDENTITY);
+    StressPostVisibility(Stress, TRUE);
+    ntStatus = StressCreateSurface(Stress, 0);
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+    StressPostUpdate(Stress);
+    return STATUS_SUCCESS;
+}
+
+static VOID
+StressUsage(VOID)
+{
+    fprintf(stderr,
+        "usage: vmon_func_stress [-w waiters] [-n notifiers] [-b blitters] "
+        "[-t seconds] [-m WIDTHxHEIGHT] [-c]\n");
+}
+
+int
+main(
+    int     argc,
+    char ** argv
+    )
+{
+    STRESS *            Stress;
+    STRESS_WAITER *     Waiters;
+    STRESS_NOTIFIER *   Notifiers;
+    STRESS_BLITTER *    Blitters;
+    pthread_t           ChurnThread;
+    pthread_t           AuditorThread;
+    pthread_attr_t      WaiterAttr;
+    double              Start;
+    double              Elapsed;
+    ULONG64             Wakeups;
+    LONG                Leaked;
+    UINT                WaiterErrors;
+    NTSTATUS            ntStatus;
+    int                 Status;
+    int                 i;
+
+    Stress = calloc(1, sizeof(*Stress));
+    if (Stress == NULL)
+        return 2;
+    Stress->Width = 1280;
+    Stress->Height = 720;
+    Stress->NumWaiters = 1000;
+    Stress->NumNotifiers = 4;
+    Stress->NumBlitters = 4;
+    Stress->Seconds = 5;
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            Stress->NumWaiters = (UINT) strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            Stress->NumNotifiers = (UINT) strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            Stress->NumBlitters = (UINT) strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            Stress->Seconds = (UINT) strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc &&
+            sscanf(argv[++i], "%ux%u", &Stress->Width, &Stress->Height) == 2)
+            continue;
+        else if (strcmp(argv[i], "-c") == 0)
+            Stress->Churn = TRUE;
+        else
+        {
+            StressUsage();
+            return 2;
+        }
+    }
+    if (Stress->Width == 0 || Stress->Height == 0 || Stress->NumNotifiers == 0)
+    {
+        StressUsage();
+        return 2;
+    }
+
+    pthread_mutex_init(&Stress->SurfaceLock, NULL);
+    ntStatus = StressStartDevice(Stress);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        fprintf(stderr, "func_stress: device start failed with 0x%08x\n", (UINT) ntStatus);
+        return 1;
+    }
+
+    Waiters = calloc(Stress->NumWaiters + 1, sizeof(STRESS_WAITER));
+    Notifiers = calloc(Stress->NumNotifiers, sizeof(STRESS_NOTIFIER));
+    Blitters = calloc(Stress->NumBlitters + 1, sizeof(STRESS_BLITTER));
+    if (Waiters == NULL || Notifiers == NULL || Blitters == NULL)
+    {
+        fprintf(stderr, "func_stress: out of memory\n");
+        return 2;
+    }
+
+    /*
+     * waiters first, so the notifiers find a full queue
+     */
+    pthread_attr_init(&WaiterAttr);
+    pthread_attr_setstacksize(&WaiterAttr, STRESS_WAITER_STACK_SIZE);
+    for (i = 0; i < (int) Stress->NumWaiters; i++)
+    {
+        Waiters[i].Stress = Stress;
+        sem_init(&Waiters[i].Done, 0, 0);
+        InterlockedIncrement(&Stress->WaitersRunning);
+        if (pthread_create(&Waiters[i].Thread, &WaiterAttr, &StressWaiter, &Waiters[i]) != 0)
+        {
+            fprintf(stderr, "func_stress: only %d waiter threads could be started\n", i);
+            InterlockedDecrement(&Stress->WaitersRunning);
+            Stress->NumWaiters = i;
+            break;
+        }
+    }
+    pthread_attr_destroy(&WaiterAttr);
+
+    Start = StressNow();
+    for (i = 0; i < (int) Stress->NumNotifiers; i++)
+    {
+        Notifiers[i].Stress = Stress;
+        Notifiers[i].Index = i;
+        pthread_create(&Notifiers[i].Thread, NULL, &StressNotifier, &Notifiers[i]);
+    }
+    for (i = 0; i < (int) Stress->NumBlitters; i++)
+    {
+        Blitters[i].Stress = Stress;
+        pthread_create(&Blitters[i].Thread, NULL, &StressBlitter, &Blitters[i]);
+    }
+    if (Stress->Churn)
+        pthread_create(&ChurnThread, NULL, &StressChurn, Stress);
+    pthread_create(&AuditorThread, NULL, &StressAuditor, Stress);
+
+    StressSleep(Stress->Seconds * 1000);
+
+    InterlockedExchange(&Stress->StopProducers, 1);
+    for (i = 0; i < (int) Stress->NumNotifiers; i++)
+        pthread_join(Notifiers[i].Thread, NULL);
+    for (i = 0; i < (int) Stress->NumBlitters; i++)
+        pthread_join(Blitters[i].Thread, NULL);
+    if (Stress->Churn)
+        pthread_join(ChurnThread, NULL);
+    pthread_join(AuditorThread, NULL);
+    Elapsed = StressNow() - Start;
+
+    /*
+     * Let the waiters that were just woken queue up again, then judge
+     * what is left in the queue against the final state.
+     */
+    StressSleep(200);
+    Stress->QueuedAtStop = StressAuditQueue(Stress, TRUE);
+
+    InterlockedExchange(&Stress->StopWaiters, 1);
+    while (Stress->WaitersRunning != 0)
+    {
+        HostWdfSurpriseRemoveDevice(Stress->Device);
+        StressSleep(1);
+    }
+    Wakeups = 0;
+    WaiterErrors = 0;
+    for (i = 0; i < (int) Stress->NumWaiters; i++)
+    {
+        pthread_join(Waiters[i].Thread, NULL);
+        sem_destroy(&Waiters[i].Done);
+        Wakeups += Waiters[i].Wakeups;
+        WaiterErrors += Waiters[i].Errors;
+    }
+
+    StressDestroySurface(Stress, 0);
+    HostWdfRemoveDevice(Stress->Device);
+    Leaked = HostWdkOutstandingAllocations();
+
+    printf("{\"suite\":\"func_stress\",\"width\":%u,\"height\":%u,"
+        "\"waiters\":%u,\"notifiers\":%u,\"blitters\":%u,\"churn\":%u,"
+        "\"seconds\":%.2f,\"surface_updates\":%ld,\"updates_per_sec\":%.0f,"
+        "\"cursor_updates\":%ld,\"vidpn_updates\":%ld,\"surface_churns\":%ld,"
+        "\"wakeups\":%llu,\"wakeups_per_sec\":%.0f,"
+        "\"blts\":%ld,\"blts_failed\":%ld,\"stale_blts\":%ld,"
+        "\"queued_at_stop\":%ld,\"lost_wakeups\":%ld,"
+        "\"contended_spinlocks\":%llu,\"leaked\":%ld,\"errors\":%ld}\n",
+        Stress->Width,
+        Stress->Height,
+        Stress->NumWaiters,
+        Stress->NumNotifiers,
+        Stress->NumBlitters,
+        (UINT) Stress->Churn,
+        Elapsed,
+        (long) Stress->SurfaceUpdates,
+        Stress->SurfaceUpdates / Elapsed,
+        (long) Stress->CursorUpdates,
+        (long) Stress->VidPnUpdates,
+        (long) Stress->SurfaceChurns,
+        (unsigned long long) Wakeups,
+        Wakeups / Elapsed,
+        (long) Stress->Blts,
+        (long) Stress->BltsFailed,
+        (long) Stress->StaleBlts,
+        (long) Stress->QueuedAtStop,
+        (long) Stress->LostWakeups,
+        (unsigned long long) HostWdkContendedSpinLocks(),
+        (long) Leaked,
+        (long) (Stress->Errors + WaiterErrors)
+        );
+
+    Status = 0;
+    if (Stress->LostWakeups != 0 || Leaked != 0 || Stress->Errors != 0 || WaiterErrors != 0)
+        Status = 1;
+    if (!Stress->Churn && Stress->BltsFailed != 0)
+        Status = 1;
+
+    pthread_mutex_destroy(&Stress->SurfaceLock);
+    free(Blitters);
+    free(Notifiers);
+    free(Waiters);
+    free(Stress);
+    return Status;
+}
@@ -0,0 +1,883 @@
+/*!
+    \file       vmon_host_wdk.c
+    \brief      Out-of-line half of the host kernel and KMDF stand-ins
+    \details    Implements what host/include/ntddk.h and host/include/wdf.h
+                declare, so func/source can be linked into a Linux program.
+                Objects are heap blocks, pool and MDLs are counted and freed
+                pool is poisoned, spin locks count how often they were found
+                held. A harness drives the
+                device through the HostWdf* routines.
+
+                Nothing here is safe against a misbehaving driver beyond
+                what the checks say: completing a request twice, or freeing
+                a locked MDL, aborts the process.
+ */
+
+#define _GNU_SOURCE
+#include <ntddk.h>
+#include <wdf.h>
+#include <stdarg.h>
+#include <sched.h>
+#include <unistd.h>
+
+#define HOST_WDF_OBJECT_DRIVER      1
+#define HOST_WDF_OBJECT_DEVICE      2
+#define HOST_WDF_OBJECT_QUEUE       3
+
+struct _WDF_HOST_OBJECT
+{
+    ULONG                                   Type;
+    struct _WDF_HOST_OBJECT *               Parent;
+    CONST WDF_OBJECT_CONTEXT_TYPE_INFO *    ContextTypeInfo;
+    PVOID                                   Context;
+    PFN_WDF_OBJECT_CONTEXT_CLEANUP          EvtCleanupCallback;
+
+    /*
+     * HOST_WDF_OBJECT_DRIVER
+     */
+    WDF_DRIVER_CONFIG                       DriverConfig;
+
+    /*
+     * HOST_WDF_OBJECT_DEVICE
+     */
+    WDF_PNPPOWER_EVENT_CALLBACKS            PnpPowerCallbacks;
+    WDF_FILEOBJECT_CONFIG                   FileObjectConfig;
+    PFN_WDF_IO_IN_CALLER_CONTEXT            EvtIoInCallerContext;
+    struct _WDF_HOST_OBJECT *               DefaultQueue;
+    DEVICE_OBJECT                           PhysicalDeviceObject;
+
+    /*
+     * HOST_WDF_OBJECT_QUEUE
+     */
+    WDF_IO_QUEUE_CONFIG                     QueueConfig;
+};
+
+struct _WDFDEVICE_INIT
+{
+    WDF_PNPPOWER_EVENT_CALLBACKS            PnpPowerCallbacks;
+    WDF_FILEOBJECT_CONFIG                   FileObjectConfig;
+    PFN_WDF_IO_IN_CALLER_CONTEXT            EvtIoInCallerContext;
+    WDFDEVICE                               Device;
+};
+
+static struct _WDF_HOST_OBJECT *    HostDriver;
+static volatile LONG                HostOutstandingAllocations;
+static volatile ULONG64             HostContendedSpinLocks;
+
+/*
+ * debug print
+ */
+ULONG
+DbgPrint(
+    __in PCSTR  Format,
+    ...
+    )
+{
+    va_list Args;
+
+    va_start(Args, Format);
+    vfprintf(stderr, Format, Args);
+    va_end(Args);
+    return 0;
+}
+
+/*
+ * Spin locks: test and test-and-set, yielding while the lock is held since
+ * the holder may have been preempted.
+ */
+VOID
+HostWdkAcquireSpinLock(
+    __in KSPIN_LOCK *   SpinLock
+    )
+{
+    if (__sync_lock_test_and_set(SpinLock, 1) == 0)
+        return;
+
+    __sync_add_and_fetch(&HostContendedSpinLocks, 1);
+    for (;;)
+    {
+        while (*SpinLock != 0)
+            sched_yield();
+        if (__sync_lock_test_and_set(SpinLock, 1) == 0)
+            return;
+    }
+}
+
+ULONG64
+HostWdkContendedSpinLocks(VOID)
+{
+    return HostContendedSpinLocks;
+}
+
+LONG
+HostWdkOutstandingAllocations(VOID)
+{
+    return HostOutstandingAllocations;
+}
+
+/*
+ * processors
+ */
+ULONG
+KeQueryActiveProcessorCountEx(
+    __in USHORT             GroupNumber
+    )
+{
+    long    Count;
+
+    UNREFERENCED_PARAMETER(GroupNumber);
+    Count = sysconf(_SC_NPROCESSORS_ONLN);
+    return Count > 0 ? (ULONG) Count : 1;
+}
+
+ULONG
+KeGetCurrentProcessorNumberEx(
+    __out_opt PPROCESSOR_NUMBER ProcNumber
+    )
+{
+    int     Cpu;
+
+    Cpu = sched_getcpu();
+    if (Cpu < 0)
+        Cpu = 0;
+    if (ProcNumber != NULL)
+    {
+        ProcNumber->Group = 0;
+        ProcNumber->Number = (UCHAR) Cpu;
+        ProcNumber->Reserved = 0;
+    }
+    return (ULONG) Cpu;
+}
+
+/*
+ * Pool. Freed blocks are filled with HOST_POOL_POISON first, so a driver
+ * still reading one sees garbage rather than the old contents.
+ */
+#define HOST_POOL_POISON    0xDD
+
+typedef union _HOST_POOL_HEADER
+{
+    SIZE_T      Size;
+    ULONG64     Alignment[2];
+} HOST_POOL_HEADER;
+
+PVOID
+ExAllocatePoolWithTag(
+    __in POOL_TYPE  PoolType,
+    __in SIZE_T     NumberOfBytes,
+    __in ULONG      Tag
+    )
+{
+    HOST_POOL_HEADER *  Header;
+
+    UNREFERENCED_PARAMETER(PoolType);
+    UNREFERENCED_PARAMETER(Tag);
+    Header = malloc(sizeof(HOST_POOL_HEADER) + NumberOfBytes);
+    if (Header == NULL)
+        return NULL;
+    Header->Size = NumberOfBytes;
+    InterlockedIncrement(&HostOutstandingAllocations);
+    return Header + 1;
+}
+
+VOID
+ExFreePoolWithTag(
+    __in PVOID      P,
+    __in ULONG      Tag
+    )
+{
+    HOST_POOL_HEADER * CONST    Header = (HOST_POOL_HEADER *) P - 1;
+
+    UNREFERENCED_PARAMETER(Tag);
+    RtlFillMemory(P, Header->Size, HOST_POOL_POISON);
+    InterlockedDecrement(&HostOutstandingAllocations);
+    free(Header);
+}
+
+/*
+ * MDLs
+ */
+PMDL
+IoAllocateMdl(
+    __in PVOID      VirtualAddress,
+    __in ULONG      Length,
+    __in BOOLEAN    SecondaryBuffer,
+    __in BOOLEAN    ChargeQuota,
+    __in PVOID      Irp
+    )
+{
+    PMDL    Mdl;
+
+    UNREFERENCED_PARAMETER(SecondaryBuffer);
+    UNREFERENCED_PARAMETER(ChargeQuota);
+    UNREFERENCED_PARAMETER(Irp);
+    Mdl = ExAllocatePoolWithTag(NonPagedPool, sizeof(MDL), 0);
+    if (Mdl != NULL)
+    {
+        Mdl->VirtualAddress = VirtualAddress;
+        Mdl->ByteCount = Length;
+        Mdl->Locked = FALSE;
+    }
+    return Mdl;
+}
+
+VOID
+IoFreeMdl(
+    __in PMDL       Mdl
+    )
+{
+    if (Mdl->Locked)
+    {
+        fprintf(stderr, "IoFreeMdl: MDL(%p) is still locked\n", Mdl);
+        abort();
+    }
+    ExFreePoolWithTag(Mdl, 0);
+}
+
+VOID
+MmProbeAndLockPages(
+    __inout PMDL            Mdl,
+    __in KPROCESSOR_MODE    AccessMode,
+    __in LOCK_OPERATION     Operation
+    )
+{
+    UNREFERENCED_PARAMETER(AccessMode);
+    UNREFERENCED_PARAMETER(Operation);
+    assert(!Mdl->Locked);
+    Mdl->Locked = TRUE;
+}
+
+VOID
+MmUnlockPages(
+    __inout PMDL            Mdl
+    )
+{
+    assert(Mdl->Locked);
+    Mdl->Locked = FALSE;
+}
+
+/*
+ * device interfaces
+ */
+NTSTATUS
+IoRegisterDeviceInterface(
+    __in PDEVICE_OBJECT     PhysicalDeviceObject,
+    __in CONST GUID *       InterfaceClassGuid,
+    __in_opt PUNICODE_STRING ReferenceString,
+    __out PUNICODE_STRING   SymbolicLinkName
+    )
+{
+    static CONST CHAR   Name[] = "\\??\\HOST#VMON";
+    USHORT              i;
+
+    UNREFERENCED_PARAMETER(PhysicalDeviceObject);
+    UNREFERENCED_PARAMETER(InterfaceClassGuid);
+    UNREFERENCED_PARAMETER(ReferenceString);
+    SymbolicLinkName->Buffer = ExAllocatePoolWithTag(PagedPool, sizeof(Name) * sizeof(WCHAR), 0);
+    if (SymbolicLinkName->Buffer == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+    for (i = 0; i < sizeof(Name); i++)
+        SymbolicLinkName->Buffer[i] = (WCHAR) Name[i];
+    SymbolicLinkName->Length = (USHORT) ((sizeof(Name) - 1) * sizeof(WCHAR));
+    SymbolicLinkName->MaximumLength = (USHORT) (sizeof(Name) * sizeof(WCHAR));
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+IoSetDeviceInterfaceState(
+    __in PUNICODE_STRING    SymbolicLinkName,
+    __in BOOLEAN            Enable
+    )
+{
+    UNREFERENCED_PARAMETER(Enable);
+    return SymbolicLinkName->Buffer != NULL ? STATUS_SUCCESS : STATUS_INVALID_PARAMETER;
+}
+
+VOID
+RtlFreeUnicodeString(
+    __inout PUNICODE_STRING UnicodeString
+    )
+{
+    if (UnicodeString->Buffer != NULL)
+        ExFreePoolWithTag(UnicodeString->Buffer, 0);
+    UnicodeString->Buffer = NULL;
+    UnicodeString->Length = UnicodeString->MaximumLength = 0;
+}
+
+/*
+ * objects
+ */
+static struct _WDF_HOST_OBJECT *
+HostWdfAllocateObject(
+    __in ULONG                          Type,
+    __in struct _WDF_HOST_OBJECT *      Parent,
+    __in_opt WDF_OBJECT_ATTRIBUTES *    Attributes
+    )
+{
+    struct _WDF_HOST_OBJECT *   Object;
+
+    Object = calloc(1, sizeof(*Object));
+    if (Object == NULL)
+        return NULL;
+
+    Object->Type = Type;
+    Object->Parent = Parent;
+    if (Attributes != NULL)
+    {
+        Object->EvtCleanupCallback = Attributes->EvtCleanupCallback;
+        Object->ContextTypeInfo = Attributes->ContextTypeInfo;
+        if (Object->ContextTypeInfo != NULL)
+        {
+            Object->Context = calloc(1, Object->ContextTypeInfo->ContextSize);
+            if (Object->Context == NULL)
+            {
+                free(Object);
+                return NULL;
+            }
+        }
+    }
+    return Object;
+}
+
+static VOID
+HostWdfDeleteObject(
+    __in struct _WDF_HOST_OBJECT *  Object
+    )
+{
+    if (Object->EvtCleanupCallback != NULL)
+        (*Object->EvtCleanupCallback)(Object);
+    free(Object->Context);
+    free(Object);
+}
+
+PVOID
+WdfObjectGetTypedContextWorker(
+    __in WDFOBJECT                              Handle,
+    __in CONST WDF_OBJECT_CONTEXT_TYPE_INFO *   TypeInfo
+    )
+{
+    /*
+     * each translation unit has its own copy of the type info
+     */
+    assert(Handle->ContextTypeInfo != NULL &&
+        strcmp(Handle->ContextTypeInfo->ContextName, TypeInfo->ContextName) == 0);
+    UNREFERENCED_PARAMETER(TypeInfo);
+    return Handle->Context;
+}
+
+/*
+ * driver
+ */
+NTSTATUS
+WdfDriverCreate(
+    __in PDRIVER_OBJECT             DriverObject,
+    __in PUNICODE_STRING            RegistryPath,
+    __in_opt WDF_OBJECT_ATTRIBUTES * DriverAttributes,
+    __in WDF_DRIVER_CONFIG *        DriverConfig,
+    __out_opt WDFDRIVER *           Driver
+    )
+{
+    UNREFERENCED_PARAMETER(DriverObject);
+    UNREFERENCED_PARAMETER(RegistryPath);
+    if (HostDriver != NULL)
+        return STATUS_UNSUCCESSFUL;
+
+    HostDriver = HostWdfAllocateObject(HOST_WDF_OBJECT_DRIVER, NULL, DriverAttributes);
+    if (HostDriver == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+    HostDriver->DriverConfig = *DriverConfig;
+    if (Driver != NULL)
+        *Driver = HostDriver;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * device initialization
+ */
+VOID
+WdfDeviceInitSetPnpPowerEventCallbacks(
+    __in PWDFDEVICE_INIT                DeviceInit,
+    __in WDF_PNPPOWER_EVENT_CALLBACKS * PnpPowerEventCallbacks
+    )
+{
+    DeviceInit->PnpPowerCallbacks = *PnpPowerEventCallbacks;
+}
+
+VOID
+WdfDeviceInitSetPowerPolicyEventCallbacks(
+    __in PWDFDEVICE_INIT                    DeviceInit,
+    __in WDF_POWER_POLICY_EVENT_CALLBACKS * PowerPolicyEventCallbacks
+    )
+{
+    /*
+     * there is no idle or wake on the host
+     */
+    UNREFERENCED_PARAMETER(DeviceInit);
+    UNREFERENCED_PARAMETER(PowerPolicyEventCallbacks);
+}
+
+VOID
+WdfDeviceInitSetFileObjectConfig(
+    __in PWDFDEVICE_INIT                DeviceInit,
+    __in WDF_FILEOBJECT_CONFIG *        FileObjectConfig,
+    __in_opt WDF_OBJECT_ATTRIBUTES *    FileObjectAttributes
+    )
+{
+    UNREFERENCED_PARAMETER(FileObjectAttributes);
+    DeviceInit->FileObjectConfig = *FileObjectConfig;
+}
+
+VOID
+WdfDeviceInitSetIoInCallerContextCallback(
+    __in PWDFDEVICE_INIT                DeviceInit,
+    __in PFN_WDF_IO_IN_CALLER_CONTEXT   EvtIoInCallerContext
+    )
+{
+    DeviceInit->EvtIoInCallerContext = EvtIoInCallerContext;
+}
+
+/*
+ * device
+ */
+NTSTATUS
+WdfDeviceCreate(
+    __inout PWDFDEVICE_INIT *           DeviceInit,
+    __in_opt WDF_OBJECT_ATTRIBUTES *    DeviceAttributes,
+    __out WDFDEVICE *                   Device
+    )
+{
+    PWDFDEVICE_INIT CONST   Init = *DeviceInit;
+    WDFDEVICE               NewDevice;
+
+    NewDevice = HostWdfAllocateObject(HOST_WDF_OBJECT_DEVICE, HostDriver, DeviceAttributes);
+    if (NewDevice == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    NewDevice->PnpPowerCallbacks = Init->PnpPowerCallbacks;
+    NewDevice->FileObjectConfig = Init->FileObjectConfig;
+    NewDevice->EvtIoInCallerContext = Init->EvtIoInCallerContext;
+    Init->Device = NewDevice;
+    *DeviceInit = NULL;
+    *Device = NewDevice;
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfDeviceCreateDeviceInterface(
+    __in WDFDEVICE                      Device,
+    __in CONST GUID *                   InterfaceClassGUID,
+    __in_opt PUNICODE_STRING            ReferenceString
+    )
+{
+    UNREFERENCED_PARAMETER(Device);
+    UNREFERENCED_PARAMETER(InterfaceClassGUID);
+    UNREFERENCED_PARAMETER(ReferenceString);
+    return STATUS_SUCCESS;
+}
+
+PDEVICE_OBJECT
+WdfDeviceWdmGetPhysicalDevice(
+    __in WDFDEVICE                      Device
+    )
+{
+    return &Device->PhysicalDeviceObject;
+}
+
+NTSTATUS
+WdfFdoQueryForInterface(
+    __in WDFDEVICE                      Fdo,
+    __in LPCGUID                        InterfaceType,
+    __out PINTERFACE                    Interface,
+    __in USHORT                         Size,
+    __in USHORT                         Version,
+    __in_opt PVOID                      InterfaceSpecificData
+    )
+{
+    /*
+     * there is no bus driver below us
+     */
+    UNREFERENCED_PARAMETER(Fdo);
+    UNREFERENCED_PARAMETER(InterfaceType);
+    UNREFERENCED_PARAMETER(Interface);
+    UNREFERENCED_PARAMETER(Size);
+    UNREFERENCED_PARAMETER(Version);
+    UNREFERENCED_PARAMETER(InterfaceSpecificData);
+    return STATUS_NOT_SUPPORTED;
+}
+
+NTSTATUS
+WdfDeviceAssignS0IdleSettings(
+    __in WDFDEVICE                                  Device,
+    __in WDF_DEVICE_POWER_POLICY_IDLE_SETTINGS *    Settings
+    )
+{
+    UNREFERENCED_PARAMETER(Device);
+    UNREFERENCED_PARAMETER(Settings);
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfDeviceAssignSxWakeSettings(
+    __in WDFDEVICE                                  Device,
+    __in WDF_DEVICE_POWER_POLICY_WAKE_SETTINGS *    Settings
+    )
+{
+    UNREFERENCED_PARAMETER(Device);
+    UNREFERENCED_PARAMETER(Settings);
+    return STATUS_SUCCESS;
+}
+
+WDFDEVICE
+WdfFileObjectGetDevice(
+    __in WDFFILEOBJECT                  FileObject
+    )
+{
+    return FileObject->Parent;
+}
+
+/*
+ * queues
+ */
+NTSTATUS
+WdfIoQueueCreate(
+    __in WDFDEVICE                      Device,
+    __in WDF_IO_QUEUE_CONFIG *          Config,
+    __in_opt WDF_OBJECT_ATTRIBUTES *    QueueAttributes,
+    __out_opt WDFQUEUE *                Queue
+    )
+{
+    WDFQUEUE    NewQueue;
+
+    if (Config->DefaultQueue && Device->DefaultQueue != NULL)
+        return STATUS_INVALID_DEVICE_REQUEST;
+
+    NewQueue = HostWdfAllocateObject(HOST_WDF_OBJECT_QUEUE, Device, QueueAttributes);
+    if (NewQueue == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    NewQueue->QueueConfig = *Config;
+    if (Config->DefaultQueue)
+        Device->DefaultQueue = NewQueue;
+    if (Queue != NULL)
+        *Queue = NewQueue;
+    return STATUS_SUCCESS;
+}
+
+WDFDEVICE
+WdfIoQueueGetDevice(
+    __in WDFQUEUE                       Queue
+    )
+{
+    return Queue->Parent;
+}
+
+/*
+ * Requests go to the default queue right away. The queue is parallel
+ * whatever its configuration says, which is what the driver asks for.
+ */
+NTSTATUS
+WdfDeviceEnqueueRequest(
+    __in WDFDEVICE                      Device,
+    __in WDFREQUEST                     Request
+    )
+{
+    WDFQUEUE CONST  Queue = Device->DefaultQueue;
+
+    if (Queue == NULL)
+        return STATUS_INVALID_DEVICE_REQUEST;
+
+    switch (Request->Type)
+    {
+    case WdfRequestTypeDeviceControl:
+        if (Queue->QueueConfig.EvtIoDeviceControl == NULL)
+            break;
+        (*Queue->QueueConfig.EvtIoDeviceControl)(
+            Queue,
+            Request,
+            Request->OutputBufferLength,
+            Request->InputBufferLength,
+            Request->IoControlCode
+            );
+        return STATUS_SUCCESS;
+
+    case WdfRequestTypeDeviceControlInternal:
+        if (Queue->QueueConfig.EvtIoInternalDeviceControl == NULL)
+            break;
+        (*Queue->QueueConfig.EvtIoInternalDeviceControl)(
+            Queue,
+            Request,
+            Request->OutputBufferLength,
+            Request->InputBufferLength,
+            Request->IoControlCode
+            );
+        return STATUS_SUCCESS;
+
+    default:
+        break;
+    }
+    WdfRequestComplete(Request, STATUS_INVALID_DEVICE_REQUEST);
+    return STATUS_SUCCESS;
+}
+
+/*
+ * requests
+ */
+NTSTATUS
+HostWdfRequestRetrieveInputBuffer(
+    __in WDFREQUEST     Request,
+    __in size_t         MinimumRequiredLength,
+    __out PVOID *       Buffer,
+    __out_opt size_t *  Length
+    )
+{
+    PVOID CONST Input = Request->SystemBuffer != NULL ?
+        Request->SystemBuffer : Request->InputBuffer;
+
+    if (Input == NULL || Request->InputBufferLength == 0)
+        return STATUS_BUFFER_TOO_SMALL;
+    if (Request->InputBufferLength < MinimumRequiredLength)
+        return STATUS_BUFFER_TOO_SMALL;
+
+    *Buffer = Input;
+    if (Length != NULL)
+        *Length = Request->InputBufferLength;
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+HostWdfRequestRetrieveOutputBuffer(
+    __in WDFREQUEST     Request,
+    __in size_t         MinimumRequiredSize,
+    __out PVOID *       Buffer,
+    __out_opt size_t *  Length
+    )
+{
+    PVOID CONST Output = Request->SystemBuffer != NULL ?
+        Request->SystemBuffer : Request->OutputBuffer;
+
+    if (Output == NULL || Request->OutputBufferLength == 0)
+        return STATUS_BUFFER_TOO_SMALL;
+    if (Request->OutputBufferLength < MinimumRequiredSize)
+        return STATUS_BUFFER_TOO_SMALL;
+
+    *Buffer = Output;
+    if (Length != NULL)
+        *Length = Request->OutputBufferLength;
+    return STATUS_SUCCESS;
+}
+
+VOID
+WdfRequestCompleteWithInformation(
+    __in WDFREQUEST     Request,
+    __in NTSTATUS       Status,
+    __in ULONG_PTR      Information
+    )
+{
+    SIZE_T  CopyBack;
+
+    if (InterlockedExchange(&Request->Completed, 1) != 0)
+    {
+        fprintf(stderr,
+            "WdfRequestComplete: Request(%p) IOCTL(0x%x) completed twice\n",
+            Request, Request->IoControlCode);
+        abort();
+    }
+
+    Request->Status = Status;
+    Request->Information = Information;
+    if (Request->SystemBuffer != NULL)
+    {
+        CopyBack = Information < Request->OutputBufferLength ?
+            Information : Request->OutputBufferLength;
+        if (NT_SUCCESS(Status) && CopyBack != 0)
+            RtlCopyMemory(Request->OutputBuffer, Request->SystemBuffer, CopyBack);
+        free(Request->SystemBuffer);
+        Request->SystemBuffer = NULL;
+    }
+
+    /*
+     * the request may be reused as soon as its owner hears about it
+     */
+    if (Request->EvtComplete != NULL)
+        (*Request->EvtComplete)(Request, Request->CompleteContext);
+}
+
+VOID
+WdfRequestGetParameters(
+    __in WDFREQUEST                 Request,
+    __out WDF_REQUEST_PARAMETERS *  Parameters
+    )
+{
+    Parameters->Type = Request->Type;
+    Parameters->Parameters.DeviceIoControl.OutputBufferLength = Request->OutputBufferLength;
+    Parameters->Parameters.DeviceIoControl.InputBufferLength = Request->InputBufferLength;
+    Parameters->Parameters.DeviceIoControl.IoControlCode = Request->IoControlCode;
+    Parameters->Parameters.DeviceIoControl.Type3InputBuffer = Request->InputBuffer;
+}
+
+VOID
+WdfRequestStopAcknowledge(
+    __in WDFREQUEST     Request,
+    __in BOOLEAN        Requeue
+    )
+{
+    UNREFERENCED_PARAMETER(Request);
+    UNREFERENCED_PARAMETER(Requeue);
+}
+
+static VOID
+HostWdfDeleteDevice(
+    __in WDFDEVICE                      Device
+    )
+{
+    if (Device->DefaultQueue != NULL)
+        HostWdfDeleteObject(Device->DefaultQueue);
+    HostWdfDeleteObject(Device);
+}
+
+/*
+ * the harness side
+ */
+NTSTATUS
+HostWdfRequestInit(
+    __out WDFREQUEST                    Request,
+    __in WDF_REQUEST_TYPE               Type,
+    __in ULONG                          IoControlCode,
+    __in_opt PVOID                      InputBuffer,
+    __in size_t                         InputBufferLength,
+    __out_opt PVOID                     OutputBuffer,
+    __in size_t                         OutputBufferLength,
+    __in_opt WDF_HOST_REQUEST_COMPLETE * EvtComplete,
+    __in_opt PVOID                      CompleteContext
+    )
+{
+    size_t  SystemBufferLength;
+
+    RtlZeroMemory(Request, sizeof(*Request));
+    Request->Type = Type;
+    Request->IoControlCode = IoControlCode;
+    Request->InputBuffer = InputBuffer;
+    Request->InputBufferLength = InputBufferLength;
+    Request->OutputBuffer = OutputBuffer;
+    Request->OutputBufferLength = OutputBufferLength;
+    Request->EvtComplete = EvtComplete;
+    Request->CompleteContext = CompleteContext;
+    Request->Status = STATUS_PENDING;
+
+    if ((IoControlCode & 3) == METHOD_BUFFERED)
+    {
+        SystemBufferLength = InputBufferLength > OutputBufferLength ?
+            InputBufferLength : OutputBufferLength;
+        if (SystemBufferLength != 0)
+        {
+            Request->SystemBuffer = malloc(SystemBufferLength);
+            if (Request->SystemBuffer == NULL)
+                return STATUS_INSUFFICIENT_RESOURCES;
+            RtlZeroMemory(Request->SystemBuffer, SystemBufferLength);
+            if (InputBufferLength != 0)
+                RtlCopyMemory(Request->SystemBuffer, InputBuffer, InputBufferLength);
+        }
+    }
+    return STATUS_SUCCESS;
+}
+
+VOID
+HostWdfSendRequest(
+    __in WDFDEVICE                      Device,
+    __in WDFREQUEST                     Request
+    )
+{
+    NTSTATUS    ntStatus;
+
+    if (Device->EvtIoInCallerContext != NULL)
+    {
+        (*Device->EvtIoInCallerContext)(Device, Request);
+        return;
+    }
+    ntStatus = WdfDeviceEnqueueRequest(Device, Request);
+    if (!NT_SUCCESS(ntStatus))
+        WdfRequestComplete(Request, ntStatus);
+}
+
+NTSTATUS
+HostWdfAddDevice(
+    __out WDFDEVICE *                   Device
+    )
+{
+    WDFDEVICE_INIT      Init;
+    PWDFDEVICE_INIT     DeviceInit;
+    NTSTATUS            ntStatus;
+
+    if (HostDriver == NULL || HostDriver->DriverConfig.EvtDriverDeviceAdd == NULL)
+        return STATUS_INVALID_DEVICE_REQUEST;
+
+    RtlZeroMemory(&Init, sizeof(Init));
+    DeviceInit = &Init;
+    ntStatus = (*HostDriver->DriverConfig.EvtDriverDeviceAdd)(HostDriver, DeviceInit);
+    if (!NT_SUCCESS(ntStatus))
+    {
+        if (Init.Device != NULL)
+            HostWdfDeleteDevice(Init.Device);
+        return ntStatus;
+    }
+    if (Init.Device == NULL)
+        return STATUS_UNSUCCESSFUL;
+    *Device = Init.Device;
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+HostWdfStartDevice(
+    __in WDFDEVICE                      Device
+    )
+{
+    WDF_PNPPOWER_EVENT_CALLBACKS * CONST    Callbacks = &Device->PnpPowerCallbacks;
+    NTSTATUS                                ntStatus;
+
+    if (Callbacks->EvtDevicePrepareHardware != NULL)
+    {
+        ntStatus = (*Callbacks->EvtDevicePrepareHardware)(Device, NULL, NULL);
+        if (!NT_SUCCESS(ntStatus))
+            return ntStatus;
+    }
+    if (Callbacks->EvtDeviceD0Entry != NULL)
+    {
+        ntStatus = (*Callbacks->EvtDeviceD0Entry)(Device, WdfPowerDeviceD3Final);
+        if (!NT_SUCCESS(ntStatus))
+            return ntStatus;
+    }
+    if (Callbacks->EvtDeviceSelfManagedIoInit != NULL)
+    {
+        ntStatus = (*Callbacks->EvtDeviceSelfManagedIoInit)(Device);
+        if (!NT_SUCCESS(ntStatus))
+            return ntStatus;
+    }
+    return STATUS_SUCCESS;
+}
+
+VOID
+HostWdfSurpriseRemoveDevice(
+    __in WDFDEVICE                      Device
+    )
+{
+    if (Device->PnpPowerCallbacks.EvtDeviceSurpriseRemoval != NULL)
+        (*Device->PnpPowerCallbacks.EvtDeviceSurpriseRemoval)(Device);
+}
+
+/*
+ * D0Exit, ReleaseHardware, then the objects go away with their cleanup
+ * callbacks. The caller makes sure no request is still in flight.
+ */
+VOID
+HostWdfRemoveDevice(
+    __in WDFDEVICE                      Device
+    )
+{
+    WDF_PNPPOWER_EVENT_CALLBACKS * CONST    Callbacks = &Device->PnpPowerCallbacks;
+
+    if (Callbacks->EvtDeviceD0Exit != NULL)
+        (VOID) (*Callbacks->EvtDeviceD0Exit)(Device, WdfPowerDeviceD3Final);
+    if (Callbacks->EvtDeviceReleaseHardware != NULL)
+        (VOID) (*Callbacks->EvtDeviceReleaseHardware)(Device, NULL);
+    HostWdfDeleteDevice(Device);
+}
@@ -0,0 +1,481 @@
+/*!
+    \file       vmon_logdump.c
+    \brief      Reader for frame logs written by vmon.exe /record
+    \details    Builds and runs on Linux against host/include/windows.h:
+
+                gcc -std=gnu89 -O2 -Wall -Wno-unknown-pragmas \
+                    -Ihost/include -Iinclude -Ipipeline/source \
+                    host/source/vmon_logdump.c \
+                    pipeline/source/ljb_vmon_tile_decoder.c -o vmon_logdump
+
+                vmon_logdump [-q] [-f frame_id -o out.ppm] file
+
+                Prints one line per record and a summary; -q prints the
+                summary only. With -f, the frame with that FrameId is rebuilt
+                from the copies and damaged rectangles recorded up to it and
+                written as a binary PPM. Reads versions 1 and 2, raw and tile
+                encoded frames. See include/ljb_vmon_framelog.h for the
+                format.
+ */
+
+#include <windows.h>
+#include "ljb_vmon_framelog.h"
+#include "ljb_vmon_tile_codec.h"
+
+typedef struct _LOG_STATS
+{
+    ULONG64     Records[LJB_VMON_FRAMELOG_TYPE_GAP + 1];
+    ULONG64     FrameRects;
+    ULONG64     FramePixels;
+    ULONG64     FrameCopies;
+    ULONG64     CopiedPixels;
+    ULONG64     TileFrames;
+    ULONG64     TilePixels;
+    ULONG64     TileBytes;
+    ULONG64     FullFrames;
+    ULONG64     DroppedRecords;
+    ULONG64     DroppedBytes;
+    ULONG64     FirstTimestamp;
+    ULONG64     LastTimestamp;
+} LOG_STATS;
+
+/*
+ * the frame as rebuilt from the log so far
+ */
+typedef struct _LOG_CANVAS
+{
+    ULONG *     Pixels;
+    ULONG       Width;
+    ULONG       Height;
+} LOG_CANVAS;
+
+static CONST CHAR * CONST RecordNames[] =
+{
+    "END", "MODE", "FRAME", "SHAPE", "POSITION", "GAP"
+};
+
+static BOOLEAN
+WritePpm(
+    __in CONST CHAR *           FileName,
+    __in CONST LOG_CANVAS *     Canvas
+    )
+{
+    FILE *  fp;
+    ULONG   i;
+    ULONG   Pixel;
+    UCHAR   Rgb[3];
+
+    fp = fopen(FileName, "wb");
+    if (fp == NULL)
+    {
+        perror(FileName);
+        return FALSE;
+    }
+    fprintf(fp, "P6\n%u %u\n255\n", Canvas->Width, Canvas->Height);
+    for (i = 0; i < Canvas->Width * Canvas->Height; i++)
+    {
+        Pixel = Canvas->Pixels[i];
+        Rgb[0] = (UCHAR) (Pixel >> 16);
+        Rgb[1] = (UCHAR) (Pixel >> 8);
+        Rgb[2] = (UCHAR) Pixel;
+        fwrite(Rgb, 1, 3, fp);
+    }
+    fclose(fp);
+    return TRUE;
+}
+
+/*
+ * Move Copy->Right - Copy->Left by Copy->Bottom - Copy->Top pixels within
+ * the canvas. Rows go in the order that reads each source row before it is
+ * overwritten.
+ */
+static VOID
+ApplyCopy(
+    __inout LOG_CANVAS *                    Canvas,
+    __in CONST LJB_VMON_FRAMELOG_COPY *     Copy
+    )
+{
+    LONG CONST  Rows = Copy->Bottom - Copy->Top;
+    LONG        i, row;
+
+    for (i = 0; i < Rows; i++)
+    {
+        row = (Copy->Top > Copy->SrcTop) ? Rows - 1 - i : i;
+        memmove(
+            Canvas->Pixels + (SIZE_T) (Copy->Top + row) * Canvas->Width + Copy->Left,
+            Canvas->Pixels + (SIZE_T) (Copy->SrcTop + row) * Canvas->Width + Copy->SrcLeft,
+            (Copy->Right - Copy->Left) * 4
+            );
+    }
+}
+
+/*
+ * Check a frame record and, if Canvas is not NULL, apply its copies and
+ * paint its rectangles onto it.
+ */
+static BOOLEAN
+ApplyFrame(
+    __in ULONG                  Version,
+    __in CONST UCHAR *          Payload,
+    __in ULONG                  PayloadSize,
+    __inout LOG_CANVAS *        Canvas,
+    __inout LOG_STATS *         Stats
+    )
+{
+    CONST LJB_VMON_FRAMELOG_FRAME * pFrame = (CONST LJB_VMON_FRAMELOG_FRAME *) Payload;
+    CONST LJB_VMON_FRAMELOG_COPY *  pCopies;
+    CONST LJB_VMON_FRAMELOG_RECT *  pRects;
+    CONST UCHAR *                   pPixels;
+    ULONG64                         Needed;
+    ULONG64                         Area;
+    ULONG                           NumCopies;
+    ULONG                           i;
+    LONG                            row;
+
+    if (PayloadSize < sizeof(*pFrame))
+        return FALSE;
+    if (pFrame->Encoding != LJB_VMON_FRAMELOG_ENCODING_RAW &&
+        pFrame->Encoding != LJB_VMON_FRAMELOG_ENCODING_TILE)
+    {
+        fprintf(stderr, "frame %u: unknown encoding %u\n", pFrame->FrameId, pFrame->Encoding);
+        return FALSE;
+    }
+
+    NumCopies = (Version >= 2) ? pFrame->NumCopies : 0;
+    Needed = sizeof(*pFrame) +
+             (ULONG64) NumCopies * sizeof(*pCopies) +
+             (ULONG64) pFrame->NumRects * sizeof(*pRects);
+    if (Needed > PayloadSize)
+        return FALSE;
+    pCopies = (CONST LJB_VMON_FRAMELOG_COPY *) (pFrame + 1);
+    pRects = (CONST LJB_VMON_FRAMELOG_RECT *) (pCopies + NumCopies);
+    for (i = 0; i < NumCopies; i++)
+    {
+        if (pCopies[i].Left < 0 || pCopies[i].Top < 0 ||
+            pCopies[i].Right <= pCopies[i].Left || pCopies[i].Bottom <= pCopies[i].Top ||
+            (ULONG) pCopies[i].Right > pFrame->Width || (ULONG) pCopies[i].Bottom > pFrame->Height ||
+            pCopies[i].SrcLeft < 0 || pCopies[i].SrcTop < 0 ||
+            (ULONG) (pCopies[i].SrcLeft + pCopies[i].Right - pCopies[i].Left) > pFrame->Width ||
+            (ULONG) (pCopies[i].SrcTop + pCopies[i].Bottom - pCopies[i].Top) > pFrame->Height)
+        {
+            fprintf(stderr, "frame %u: bad copy %u\n", pFrame->FrameId, i);
+            return FALSE;
+        }
+        Stats->CopiedPixels += (ULONG64) (pCopies[i].Right - pCopies[i].Left) *
+                               (pCopies[i].Bottom - pCopies[i].Top);
+    }
+    Area = 0;
+    for (i = 0; i < pFrame->NumRects; i++)
+    {
+        if (pRects[i].Left < 0 || pRects[i].Top < 0 ||
+            pRects[i].Right <= pRects[i].Left || pRects[i].Bottom <= pRects[i].Top ||
+            (ULONG) pRects[i].Right > pFrame->Width || (ULONG) pRects[i].Bottom > pFrame->Height)
+        {
+            fprintf(stderr, "frame %u: bad rectangle %u\n", pFrame->FrameId, i);
+            return FALSE;
+        }
+        Area += (ULONG64) (pRects[i].Right - pRects[i].Left) *
+                (pRects[i].Bottom - pRects[i].Top);
+    }
+    pPixels = (CONST UCHAR *) (pRects + pFrame->NumRects);
+    if (pFrame->Encoding == LJB_VMON_FRAMELOG_ENCODING_RAW && Needed + Area * 4 > PayloadSize)
+        return FALSE;
+
+    Stats->FrameCopies += NumCopies;
+    Stats->FrameRects += pFrame->NumRects;
+    Stats->FramePixels += Area;
+    if (pFrame->NumRects == 1 &&
+        pRects[0].Left == 0 && pRects[0].Top == 0 &&
+        (ULONG) pRects[0].Right == pFrame->Width && (ULONG) pRects[0].Bottom == pFrame->Height)
+        Stats->FullFrames++;
+    if (pFrame->Encoding == LJB_VMON_FRAMELOG_ENCODING_TILE)
+    {
+        Stats->TileFrames++;
+        Stats->TilePixels += Area;
+        Stats->TileBytes += PayloadSize - Needed;
+    }
+
+    if (Canvas == NULL)
+        return TRUE;
+
+    if (Canvas->Width != pFrame->Width || Canvas->Height != pFrame->Height)
+    {
+        if (NumCopies != 0)
+        {
+            fprintf(stderr, "frame %u: copies without a previous frame\n", pFrame->FrameId);
+            return FALSE;
+        }
+        free(Canvas->Pixels);
+        Canvas->Pixels = calloc((SIZE_T) pFrame->Width * pFrame->Height, 4);
+        Canvas->Width = (Canvas->Pixels != NULL) ? pFrame->Width : 0;
+        Canvas->Height = (Canvas->Pixels != NULL) ? pFrame->Height : 0;
+        if (Canvas->Pixels == NULL)
+            return FALSE;
+    }
+
+    for (i = 0; i < NumCopies; i++)
+        ApplyCopy(Canvas, &pCopies[i]);
+
+    if (pFrame->Encoding == LJB_VMON_FRAMELOG_ENCODING_TILE)
+    {
+        /*
+         * the frame and log rectangles are laid out alike.
+         */
+        if (!LJB_VMON_TileDecode(
+                pPixels,
+                PayloadSize - (SIZE_T) Needed,
+                (CONST LJB_VMON_RECT *) pRects,
+                pFrame->NumRects,
+                Canvas->Pixels,
+                Canvas->Width,
+                Canvas->Height,
+                Canvas->Width * 4,
+                NULL))
+        {
+            fprintf(stderr, "frame %u: bad tile stream\n", pFrame->FrameId);
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    for (i = 0; i < pFrame->NumRects; i++)
+    {
+        for (row = pRects[i].Top; row < pRects[i].Bottom; row++)
+        {
+            memcpy(
+                Canvas->Pixels + (SIZE_T) row * Canvas->Width + pRects[i].Left,
+                pPixels,
+                (pRects[i].Right - pRects[i].Left) * 4
+                );
+            pPixels += (pRects[i].Right - pRects[i].Left) * 4;
+        }
+    }
+    return TRUE;
+}
+
+int
+main(
+    int     argc,
+    char ** argv
+    )
+{
+    CONST CHAR *                FileName = NULL;
+    CONST CHAR *                PpmName = NULL;
+    BOOLEAN                     Quiet = FALSE;
+    BOOLEAN                     WantFrame = FALSE;
+    ULONG                       WantFrameId = 0;
+    BOOLEAN                     FrameWritten = FALSE;
+    FILE *                      fp;
+    LJB_VMON_FRAMELOG_HEADER    Header;
+    LJB_VMON_FRAMELOG_RECORD    Record;
+    UCHAR *                     Payload = NULL;
+    ULONG                       PayloadMax = 0;
+    ULONG                       PayloadSize;
+    LOG_STATS                   Stats;
+    LOG_CANVAS                  Canvas;
+    double                      Seconds;
+    double                      Milliseconds;
+    int                         Status = 0;
+    int                         i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-q") == 0)
+            Quiet = TRUE;
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+        {
+            WantFrame = TRUE;
+            WantFrameId = (ULONG) strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            PpmName = argv[++i];
+        else
+            FileName = argv[i];
+    }
+    if (FileName == NULL || (WantFrame && PpmName == NULL))
+    {
+        fprintf(stderr, "usage: vmon_logdump [-q] [-f frame_id -o out.ppm] file\n");
+        return 2;
+    }
+
+    fp = fopen(FileName, "rb");
+    if (fp == NULL)
+    {
+        perror(FileName);
+        return 1;
+    }
+
+    if (fread(&Header, sizeof(Header), 1, fp) != 1 ||
+        memcmp(Header.Signature, LJB_VMON_FRAMELOG_SIGNATURE, sizeof(Header.Signature)) != 0 ||
+        Header.Version < 1 || Header.Version > LJB_VMON_FRAMELOG_VERSION ||
+        Header.HeaderSize < sizeof(Header) ||
+        Header.TimestampFrequency == 0)
+    {
+        fprintf(stderr, "%s: not a version 1 to %u frame log\n", FileName, LJB_VMON_FRAMELOG_VERSION);
+        fclose(fp);
+        return 1;
+    }
+    fseek(fp, Header.HeaderSize, SEEK_SET);
+
+    RtlZeroMemory(&Stats, sizeof(Stats));
+    RtlZeroMemory(&Canvas, sizeof(Canvas));
+
+    while (fread(&Record, sizeof(Record), 1, fp) == 1)
+    {
+        if (Record.Type == LJB_VMON_FRAMELOG_TYPE_END || Record.Size == 0)
+            break;
+        if (Record.Size < sizeof(Record) || (Record.Size & 7) != 0 ||
+            Record.Type > LJB_VMON_FRAMELOG_TYPE_GAP)
+        {
+            fprintf(stderr, "%s: corrupt record at offset %ld\n",
+                FileName, ftell(fp) - (long) sizeof(Record));
+            Status = 1;
+            break;
+        }
+
+        PayloadSize = Record.Size - sizeof(Record);
+        if (PayloadSize > PayloadMax)
+        {
+            free(Payload);
+            Payload = malloc(PayloadSize);
+            PayloadMax = (Payload != NULL) ? PayloadSize : 0;
+            if (Payload == NULL)
+            {
+                fprintf(stderr, "out of memory\n");
+                Status = 1;
+                break;
+            }
+        }
+        if (PayloadSize != 0 && fread(Payload, PayloadSize, 1, fp) != 1)
+        {
+            fprintf(stderr, "%s: log truncated\n", FileName);
+            break;
+        }
+
+        if (Stats.FirstTimestamp == 0)
+            Stats.FirstTimestamp = Record.Timestamp;
+        Stats.LastTimestamp = Record.Timestamp;
+        Stats.Records[Record.Type]++;
+
+        Milliseconds = (double) (LONG64) (Record.Timestamp - Header.StartTimestamp) *
+                       1000.0 / (double) Header.TimestampFrequency;
+        if (!Quiet)
+            printf("%12.3f %-8s", Milliseconds, RecordNames[Record.Type]);
+
+        switch (Record.Type)
+        {
+        case LJB_VMON_FRAMELOG_TYPE_MODE_CHANGE:
+            {
+            CONST LJB_VMON_FRAMELOG_MODE_CHANGE * pMode = (CONST VOID *) Payload;
+
+            if (!Quiet && PayloadSize >= sizeof(*pMode))
+                printf(" %ux%u rotation %u", pMode->Width, pMode->Height, pMode->Rotation);
+            }
+            break;
+
+        case LJB_VMON_FRAMELOG_TYPE_FRAME:
+            {
+            CONST LJB_VMON_FRAMELOG_FRAME * pFrame = (CONST VOID *) Payload;
+
+            if (!ApplyFrame(Header.Version, Payload, PayloadSize, WantFrame ? &Canvas : NULL, &Stats))
+            {
+                fprintf(stderr, "%s: bad frame record\n", FileName);
+                Status = 1;
+                break;
+            }
+            if (!Quiet)
+            {
+                printf(" id %u %ux%u rects %u", pFrame->FrameId, pFrame->Width,
+                    pFrame->Height, pFrame->NumRects);
+                if (pFrame->Encoding == LJB_VMON_FRAMELOG_ENCODING_TILE)
+                    printf(" tiles");
+                if (Header.Version >= 2 && pFrame->NumCopies != 0)
+                    printf(" copies %u", pFrame->NumCopies);
+            }
+            if (WantFrame && !FrameWritten && pFrame->FrameId == WantFrameId)
+            {
+                if (!WritePpm(PpmName, &Canvas))
+                    Status = 1;
+                FrameWritten = TRUE;
+            }
+            }
+            break;
+
+        case LJB_VMON_FRAMELOG_TYPE_CURSOR_SHAPE:
+            {
+            CONST LJB_VMON_FRAMELOG_CURSOR_SHAPE * pShape = (CONST VOID *) Payload;
+
+            if (!Quiet && PayloadSize >= sizeof(*pShape))
+                printf(" flags 0x%x %ux%u pitch %u bytes %u", pShape->Flags,
+                    pShape->Width, pShape->Height, pShape->Pitch, pShape->DataSize);
+            }
+            break;
+
+        case LJB_VMON_FRAMELOG_TYPE_CURSOR_POSITION:
+            {
+            CONST LJB_VMON_FRAMELOG_CURSOR_POSITION * pPosition = (CONST VOID *) Payload;
+
+            if (!Quiet && PayloadSize >= sizeof(*pPosition))
+                printf(" (%d, %d) %s", pPosition->X, pPosition->Y,
+                    pPosition->Visible ? "visible" : "hidden");
+            }
+            break;
+
+        case LJB_VMON_FRAMELOG_TYPE_GAP:
+            {
+            CONST LJB_VMON_FRAMELOG_GAP * pGap = (CONST VOID *) Payload;
+
+            if (PayloadSize >= sizeof(*pGap))
+            {
+                Stats.DroppedRecords += pGap->DroppedRecords;
+                Stats.DroppedBytes += pGap->DroppedBytes;
+                if (!Quiet)
+                    printf(" dropped %u records, %llu bytes", pGap->DroppedRecords,
+                        (unsigned long long) pGap->DroppedBytes);
+            }
+            }
+            break;
+        }
+        if (!Quiet)
+            printf("\n");
+        if (Status != 0)
+            break;
+    }
+
+    Seconds = (double) (LONG64) (Stats.LastTimestamp - Stats.FirstTimestamp) /
+              (double) Header.TimestampFrequency;
+    printf("modes %llu, frames %llu (%llu whole), shapes %llu, positions %llu, gaps %llu\n",
+        (unsigned long long) Stats.Records[LJB_VMON_FRAMELOG_TYPE_MODE_CHANGE],
+        (unsigned long long) Stats.Records[LJB_VMON_FRAMELOG_TYPE_FRAME],
+        (unsigned long long) Stats.FullFrames,
+        (unsigned long long) Stats.Records[LJB_VMON_FRAMELOG_TYPE_CURSOR_SHAPE],
+        (unsigned long long) Stats.Records[LJB_VMON_FRAMELOG_TYPE_CURSOR_POSITION],
+        (unsigned long long) Stats.Records[LJB_VMON_FRAMELOG_TYPE_GAP]);
+    printf("damage %llu rects, %llu pixels; copies %llu, %llu pixels; dropped %llu records, %llu bytes\n",
+        (unsigned long long) Stats.FrameRects,
+        (unsigned long long) Stats.FramePixels,
+        (unsigned long long) Stats.FrameCopies,
+        (unsigned long long) Stats.CopiedPixels,
+        (unsigned long long) Stats.DroppedRecords,
+        (unsigned long long) Stats.DroppedBytes);
+    if (Stats.TileFrames != 0)
+        printf("tile frames %llu, %llu pixels in %llu bytes (%.2f bytes/pixel)\n",
+            (unsigned long long) Stats.TileFrames,
+            (unsigned long long) Stats.TilePixels,
+            (unsigned long long) Stats.TileBytes,
+            (Stats.TilePixels != 0) ? (double) Stats.TileBytes / (double) Stats.TilePixels : 0.0);
+    if (Seconds > 0)
+        printf("duration %.3f s, %.1f frames/s\n", Seconds,
+            (double) Stats.Records[LJB_VMON_FRAMELOG_TYPE_FRAME] / Seconds);
+
+    if (WantFrame && !FrameWritten)
+    {
+        fprintf(stderr, "frame %u not found\n", WantFrameId);
+        Status = 1;
+    }
+
+    free(Canvas.Pixels);
+    free(Payload);
+    fclose(fp);
+    return Status;
+}
@@ -0,0 +1,201 @@
+/*!
+    \file       vmon_netrecv.c
+    \brief      Receiver for the stream of vmon.exe /stream
+    \details    Builds and runs on Linux against host/include/windows.h:
+
+                gcc -std=gnu89 -O2 -Wall -Wno-unknown-pragmas \
+                    -Ihost/include -Iinclude -Ipipeline/source \
+                    host/source/vmon_netrecv.c \
+                    pipeline/source/ljb_vmon_net_receiver.c \
+                    pipeline/source/ljb_vmon_sink.c \
+                    pipeline/source/ljb_vmon_damage.c \
+                    pipeline/source/ljb_vmon_tile_decoder.c -o vmon_netrecv
+
+                vmon_netrecv [-p port] [-n sessions] [-o out.ppm]
+
+                Listens on port (LJB_VMON_NET_DEFAULT_PORT if none) for
+                senders one after the other and rebuilds their frames and
+                cursor. Prints one JSON object per second of a session and
+                one when it ends, "resumed" if the sender came back to the
+                frame of the session before; with -o, the last frame of
+                every session is written as a binary PPM. Stops after -n
+                sessions, never if 0.
+                See include/ljb_vmon_netproto.h for the protocol.
+ */
+
+#include <windows.h>
+#include "ljb_vmon_net.h"
+
+typedef struct _RECV_STATS
+{
+    ULONG64     Frames;
+    ULONG64     FrameBytes;
+    ULONG64     CursorPositions;
+    ULONG64     LatencySum;
+    ULONG       LatencyMax;
+} RECV_STATS;
+
+static double
+RecvNow(VOID)
+{
+    LARGE_INTEGER   Counter;
+    LARGE_INTEGER   Frequency;
+
+    QueryPerformanceCounter(&Counter);
+    QueryPerformanceFrequency(&Frequency);
+    return (double) Counter.QuadPart / (double) Frequency.QuadPart;
+}
+
+static BOOLEAN
+WritePpm(
+    __in CONST CHAR *                   FileName,
+    __in CONST LJB_VMON_NET_RECEIVER *  Receiver
+    )
+{
+    FILE *          fp;
+    CONST UCHAR *   pPixel;
+    ULONG           i;
+    UCHAR           Rgb[3];
+
+    fp = fopen(FileName, "wb");
+    if (fp == NULL)
+    {
+        perror(FileName);
+        return FALSE;
+    }
+    fprintf(fp, "P6\n%u %u\n255\n", Receiver->Width, Receiver->Height);
+    for (i = 0; i < Receiver->Width * Receiver->Height; i++)
+    {
+        pPixel = Receiver->Pixels + i * 4;
+        Rgb[0] = pPixel[2];
+        Rgb[1] = pPixel[1];
+        Rgb[2] = pPixel[0];
+        fwrite(Rgb, 1, 3, fp);
+    }
+    fclose(fp);
+    return TRUE;
+}
+
+static VOID
+PrintStats(
+    __in CONST CHAR *                   Event,
+    __in CONST LJB_VMON_NET_RECEIVER *  Receiver,
+    __in CONST RECV_STATS *             Stats,
+    __in double                         Seconds
+    )
+{
+    printf("{\"event\":\"%s\",\"width\":%u,\"height\":%u,\"seconds\":%.2f,\"frames\":%llu,"
+        "\"fps\":%.1f,\"mbit_per_s\":%.1f,\"latency_us\":{\"mean\":%.0f,\"max\":%u},"
+        "\"cursor_positions\":%llu,\"cursor_shapes\":%llu,\"stale_datagrams\":%llu,"
+        "\"bad_datagrams\":%llu,\"resumed\":%s}\n",
+        Event,
+        Receiver->Width,
+        Receiver->Height,
+        Seconds,
+        (unsigned long long) Stats->Frames,
+        Seconds > 0 ? Stats->Frames / Seconds : 0.0,
+        Seconds > 0 ? Stats->FrameBytes * 8 / Seconds / 1e6 : 0.0,
+        Stats->Frames ? (double) Stats->LatencySum / Stats->Frames : 0.0,
+        (UINT) Stats->LatencyMax,
+        (unsigned long long) Stats->CursorPositions,
+        (unsigned long long) Receiver->Stats.CursorShapes,
+        (unsigned long long) Receiver->Stats.StaleDatagrams,
+        (unsigned long long) Receiver->Stats.BadDatagrams,
+        Receiver->Resumed ? "true" : "false");
+    fflush(stdout);
+}
+
+int
+main(
+    int     argc,
+    char ** argv
+    )
+{
+    static LJB_VMON_NET_RECEIVER    Receiver;
+    CONST CHAR *                    PpmName = NULL;
+    USHORT                          Port = LJB_VMON_NET_DEFAULT_PORT;
+    ULONG                           Sessions = 0;
+    ULONG                           Session;
+    LJB_VMON_NET_EVENT              Event;
+    RECV_STATS                      Interval;
+    RECV_STATS                      Total;
+    ULONG64                         FrameBytes;
+    double                          Start, IntervalStart, Now;
+    int                             Status = 0;
+    int                             i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            Port = (USHORT) strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            Sessions = (ULONG) strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            PpmName = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: vmon_netrecv [-p port] [-n sessions] [-o out.ppm]\n");
+            return 2;
+        }
+    }
+
+    if (!LJB_VMON_NetReceiverInit(&Receiver, Port))
+    {
+        fprintf(stderr, "unable to listen on port %u\n", Port);
+        LJB_VMON_NetReceiverDeInit(&Receiver);
+        return 1;
+    }
+    fprintf(stderr, "listening on port %u\n", Receiver.Port);
+
+    for (Session = 0; Sessions == 0 || Session < Sessions; Session++)
+    {
+        if (!LJB_VMON_NetReceiverAccept(&Receiver))
+        {
+            fprintf(stderr, "a sender that is not one, ignored\n");
+            Session--;
+            continue;
+        }
+        RtlZeroMemory(&Interval, sizeof(Interval));
+        RtlZeroMemory(&Total, sizeof(Total));
+        FrameBytes = Receiver.Stats.FrameBytes;
+        Start = IntervalStart = RecvNow();
+        do
+        {
+            LJB_VMON_NetReceiverPoll(&Receiver, 100, &Event);
+            if (Event.Type == LJB_VMON_NET_EVENT_FRAME)
+            {
+                Interval.Frames++;
+                Interval.FrameBytes += Receiver.Stats.FrameBytes - FrameBytes;
+                FrameBytes = Receiver.Stats.FrameBytes;
+                Interval.LatencySum += Event.Latency;
+                if (Event.Latency > Interval.LatencyMax)
+                    Interval.LatencyMax = Event.Latency;
+            }
+            else if (Event.Type == LJB_VMON_NET_EVENT_CURSOR_POSITION)
+                Interval.CursorPositions++;
+
+            Now = RecvNow();
+            if (Now - IntervalStart >= 1.0 || Event.Type == LJB_VMON_NET_EVENT_CLOSED)
+            {
+                if (Event.Type != LJB_VMON_NET_EVENT_CLOSED)
+                    PrintStats("interval", &Receiver, &Interval, Now - IntervalStart);
+                Total.Frames += Interval.Frames;
+                Total.FrameBytes += Interval.FrameBytes;
+                Total.CursorPositions += Interval.CursorPositions;
+                Total.LatencySum += Interval.LatencySum;
+                if (Interval.LatencyMax > Total.LatencyMax)
+                    Total.LatencyMax = Interval.LatencyMax;
+                RtlZeroMemory(&Interval, sizeof(Interval));
+                IntervalStart = Now;
+            }
+        } while (Event.Type != LJB_VMON_NET_EVENT_CLOSED);
+
+        PrintStats("session", &Receiver, &Total, RecvNow() - Start);
+        if (PpmName != NULL && Receiver.Width != 0 && Receiver.Height != 0 &&
+            !WritePpm(PpmName, &Receiver))
+            Status = 1;
+    }
+
+    LJB_VMON_NetReceiverDeInit(&Receiver);
+    return Status;
+}
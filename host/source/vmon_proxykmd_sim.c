@@ -0,0 +1,1395 @@
+/*!
+    \file       vmon_proxykmd_sim.c
+    \brief      Scriptable stand-in for the LCI ProxyKMD driver
+    \details    Plays the ProxyKMD side of the contract in
+                include/lci_display_internal_ioctl.h, so the down-call and
+                blit paths can be exercised and measured without Windows or
+                the closed-source lci_proxykmd driver. Builds and runs on
+                Linux against host/include:
+
+                gcc -std=gnu89 -O2 -Wall -Wno-unknown-pragmas -pthread \
+                    -Ihost/include -Iinclude -Ipipeline/source \
+                    host/source/vmon_proxykmd_sim.c \
+                    pipeline/source/ljb_vmon_damage.c \
+                    pipeline/source/ljb_vmon_workload.c \
+                    -o vmon_proxykmd_sim
+
+                vmon_proxykmd_sim [script]
+
+                The simulator exchanges LCI_GENERIC_INTERFACE with a monitor
+                the way INTERNAL_IOCTL_QUERY_USB_MONITOR_INTERFACE does, owns
+                the primary surfaces, sends LCI_PROXYKMD_NOTIFY_* down-calls,
+                and services LCI_USBAV_BLT_PRIMARY_TO_SHADOW and the lock
+                up-calls. The monitor here is a stub that mirrors what
+                LJB_VMON_GenericIoctl keeps, with a consumer thread standing in
+                for vmon.exe: it blits every frame it is told about, as
+                IOCTL_LJB_VMON_BLT_BITMAP does.
+
+                Commands are read one per line from the script, or from stdin
+                when no script is given; '#' starts a comment.
+
+                mode <width> <height> [rotation]
+                                    commit a VidPn mode and create its primary
+                                    surface; "mode 0 0" disables the source
+                visible <0|1>       post a visibility update
+                rate <fps>          update rate of "run", 0 for unpaced
+                paint <rows>        rows painted per update, 0 for all
+                workload <name|off> [seed]
+                                    paint every update with a synthetic
+                                    desktop workload of ljb_vmon_workload.h
+                                    (idle, typing, drag, scroll, video,
+                                    slideshow) instead of rows; a present
+                                    that changes nothing is not posted
+                cursor <x> <y> [visible]
+                                    post one pointer position update
+                shape <mono|color|masked> <width> <height>
+                                    post one pointer shape update
+                cursor_rate <hz>    pointer moves per second during "run"
+                update [count]      post updates back to back
+                run <seconds> [label]
+                                    post updates at "rate" and pointer moves
+                                    at "cursor_rate", then print one JSON
+                                    object with the throughput and the update
+                                    to blit latency the monitor saw
+                sleep <ms>
+                quit
+
+                Exits with status 1 when a command fails or a call across
+                the interface returns an error. A blit of a surface destroyed
+                by a mode change in the meantime is not an error.
+ */
+
+#include <windows.h>
+#include <pthread.h>
+#include <errno.h>
+#include "lci_display_internal_ioctl.h"
+#include "ljb_vmon_workload.h"
+
+#define SIM_MAX_SURFACES        4
+#define SIM_MAX_SAMPLES         (1 << 20)
+#define SIM_MAX_POINTER_SIZE    (256 * 256 * 4)
+
+typedef struct _SIM_SURFACE
+{
+    HANDLE              hPrimarySurface;
+    UCHAR *             Buffer;
+    SIZE_T              BufferSize;
+    UINT                Width;
+    UINT                Height;
+    UINT                Pitch;
+    UINT                BytesPerPixel;
+    ULONGLONG           UpdateTimeStamp;    // of the last NOTIFY_PRIMARY_SURFACE_UPDATE
+} SIM_SURFACE;
+
+/*
+ * the ProxyKMD side
+ */
+typedef struct _SIM_PROXYKMD
+{
+    /*
+     * guards the primary surfaces against painting while they are copied
+     * or locked, the tear-free promise of LCI_USBAV_BLT_PRIMARY_TO_SHADOW
+     */
+    pthread_mutex_t         SurfaceLock;
+    SIM_SURFACE             Surfaces[SIM_MAX_SURFACES];
+    ULONG_PTR               NextHandle;
+
+    LCI_GENERIC_INTERFACE   Interface;          // up-calls serviced here
+    LCI_GENERIC_INTERFACE   MonitorInterface;   // down-calls go here
+
+    ULONG64                 Blts;
+    ULONG64                 BltBytes;
+    ULONG64                 BltErrors;
+    ULONG64                 Locks;
+} SIM_PROXYKMD;
+
+/*
+ * the monitor side, keeping what LJB_VMON_CTX keeps
+ */
+typedef struct _SIM_MONITOR
+{
+    pthread_mutex_t         Lock;
+    pthread_cond_t          Wake;
+    pthread_t               Consumer;
+    BOOLEAN                 Stop;
+
+    LCI_GENERIC_INTERFACE   TargetGenericInterface;
+    SIM_SURFACE             Surfaces[SIM_MAX_SURFACES];
+
+    HANDLE                  hLatestPrimarySurface;
+    ULONG                   LatestFrameId;
+    ULONG                   LastSentFrameId;
+    BOOLEAN                 FramePending;
+    BOOLEAN                 Idle;               // consumer waiting, nothing pending
+
+    UINT                    Width;
+    UINT                    Height;
+    UINT                    Rotation;
+    BOOLEAN                 Visible;
+    INT                     PointerX;
+    INT                     PointerY;
+    BOOLEAN                 PointerVisible;
+    UCHAR                   PointerBitmap[SIM_MAX_POINTER_SIZE * 2];
+
+    UCHAR *                 Shadow;             // consumer thread only
+    SIZE_T                  ShadowSize;
+
+    ULONG64                 Updates;
+    ULONG64                 Frames;
+    ULONG64                 Dropped;
+    ULONG64                 CursorUpdates;
+    ULONG64                 ModeChanges;
+    ULONG64                 Stale;              // surface went away before the blit
+    ULONG64                 Errors;
+    ULONG *                 Samples;            // update to blit latency, ns
+    ULONG                   NumSamples;
+} SIM_MONITOR;
+
+/*
+ * what the script drives
+ */
+typedef struct _SIM_PRODUCER
+{
+    SIM_PROXYKMD *          Proxy;
+    SIM_SURFACE *           Primary;
+    ULONG                   FrameId;
+    UINT                    Rate;
+    UINT                    PaintRows;
+    UINT                    PaintRow;
+    BOOLEAN                 UseWorkload;
+    LJB_VMON_WORKLOAD_KIND  WorkloadKind;
+    ULONG                   WorkloadSeed;
+    LJB_VMON_WORKLOAD       Workload;       // sized to Primary
+    ULONG64                 Presents;
+    ULONG64                 DamagedPixels;
+    UINT                    CursorRate;
+    INT                     CursorX;
+    INT                     CursorY;
+    INT                     CursorDx;
+    INT                     CursorDy;
+    UINT                    Runs;
+} SIM_PRODUCER;
+
+static ULONGLONG
+SimNow(VOID)
+{
+    LARGE_INTEGER   Counter;
+
+    QueryPerformanceCounter(&Counter);
+    return (ULONGLONG) Counter.QuadPart;
+}
+
+static VOID
+SimSleepUntil(
+    __in ULONGLONG  Deadline
+    )
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t) (Deadline / 1000000000ULL);
+    ts.tv_nsec = (long) (Deadline % 1000000000ULL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+static SIM_SURFACE *
+SimFindSurface(
+    __in SIM_SURFACE *  Surfaces,
+    __in HANDLE         hPrimarySurface
+    )
+{
+    UINT    i;
+
+    for (i = 0; i < SIM_MAX_SURFACES; i++)
+    {
+        if (Surfaces[i].hPrimarySurface == hPrimarySurface)
+            return &Surfaces[i];
+    }
+    return NULL;
+}
+
+/*
+ * Name:  ProxyGenericIoctl
+ *
+ * Definition:
+ *    static NTSTATUS
+ *    ProxyGenericIoctl(
+ *        __in PVOID          ProviderContext,
+ *        __in ULONG          IoctlCode,
+ *        __in_opt PVOID      InputBuffer,
+ *        __in SIZE_T         InputBufferSize,
+ *        __out_opt PVOID     OutputBuffer,
+ *        __in SIZE_T         OutputBufferSize,
+ *        __out ULONG *       BytesReturned
+ *        );
+ *
+ * Description:
+ *    The up-calls a monitor driver makes into ProxyKMD. The blit copies
+ *    from the primary surface with SurfaceLock held and reports when the
+ *    copied frame was posted in FrameTimeStamp. LOCK leaves SurfaceLock
+ *    held until the matching UNLOCK, so painting stalls meanwhile.
+ *
+ * Return Value:
+ *    STATUS_SUCCESS, or the reason the up-call was refused.
+ */
+static NTSTATUS
+ProxyGenericIoctl(
+    __in PVOID          ProviderContext,
+    __in ULONG          IoctlCode,
+    __in_opt PVOID      InputBuffer,
+    __in SIZE_T         InputBufferSize,
+    __out_opt PVOID     OutputBuffer,
+    __in SIZE_T         OutputBufferSize,
+    __out ULONG *       BytesReturned
+    )
+{
+    SIM_PROXYKMD * CONST    Proxy = ProviderContext;
+    LCI_USBAV_BLT_DATA *    BltData;
+    SIM_SURFACE *           Surface;
+    NTSTATUS                ntStatus;
+
+    (void) OutputBuffer;
+    (void) OutputBufferSize;
+    *BytesReturned = 0;
+    ntStatus = STATUS_NOT_SUPPORTED;
+    switch (IoctlCode)
+    {
+    case LCI_USBAV_BLT_PRIMARY_TO_SHADOW:
+        if (InputBufferSize < sizeof(LCI_USBAV_BLT_DATA))
+        {
+            ntStatus = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+        BltData = InputBuffer;
+        pthread_mutex_lock(&Proxy->SurfaceLock);
+        Surface = SimFindSurface(Proxy->Surfaces, BltData->hPrimarySurface);
+        if (Surface == NULL || Surface->Buffer != BltData->pPrimaryBuffer)
+        {
+            ntStatus = STATUS_INVALID_HANDLE;
+        }
+        else
+        {
+            RtlCopyMemory(
+                BltData->pShadowBuffer,
+                Surface->Buffer,
+                BltData->BufferSize < Surface->BufferSize ?
+                    BltData->BufferSize : Surface->BufferSize
+                );
+            BltData->FrameTimeStamp = Surface->UpdateTimeStamp;
+            Proxy->Blts++;
+            Proxy->BltBytes += BltData->BufferSize;
+            ntStatus = STATUS_SUCCESS;
+        }
+        if (!NT_SUCCESS(ntStatus))
+            Proxy->BltErrors++;
+        pthread_mutex_unlock(&Proxy->SurfaceLock);
+        break;
+
+    case LCI_USBAV_LOCK_PRIMARY_SURFACE:
+        pthread_mutex_lock(&Proxy->SurfaceLock);
+        Proxy->Locks++;
+        ntStatus = STATUS_SUCCESS;
+        break;
+
+    case LCI_USBAV_UNLOCK_PRIMARY_SURFACE:
+        pthread_mutex_unlock(&Proxy->SurfaceLock);
+        ntStatus = STATUS_SUCCESS;
+        break;
+
+    default:
+        break;
+    }
+    return ntStatus;
+}
+
+static VOID
+ProxyReleaseInterface(
+    __in PVOID  ProviderContext
+    )
+{
+    (void) ProviderContext;
+}
+
+/*
+ * Down-call into the monitor.
+ */
+static NTSTATUS
+ProxyNotify(
+    __in SIM_PROXYKMD * Proxy,
+    __in ULONG          IoctlCode,
+    __in PVOID          InputBuffer,
+    __in SIZE_T         InputBufferSize
+    )
+{
+    LCI_GENERIC_INTERFACE * CONST   Monitor = &Proxy->MonitorInterface;
+    ULONG                           BytesReturned;
+    NTSTATUS                        ntStatus;
+
+    ntStatus = (*Monitor->pfnGenericIoctl)(
+        Monitor->ProviderContext,
+        IoctlCode,
+        InputBuffer,
+        InputBufferSize,
+        NULL,
+        0,
+        &BytesReturned
+        );
+    if (!NT_SUCCESS(ntStatus))
+    {
+        fprintf(stderr, "proxykmd: down-call %u failed with 0x%08x\n",
+            IoctlCode, (UINT) ntStatus);
+    }
+    return ntStatus;
+}
+
+/*
+ * Name:  MonitorGenericIoctl
+ *
+ * Description:
+ *    The down-calls as LJB_VMON_GenericIoctl takes them: surfaces are
+ *    remembered by handle, an update only records the latest FrameId and
+ *    surface and wakes the consumer, the pointer is copied out of the
+ *    caller's buffers before the call returns.
+ */
+static NTSTATUS
+MonitorGenericIoctl(
+    __in PVOID          ProviderContext,
+    __in ULONG          IoctlCode,
+    __in_opt PVOID      InputBuffer,
+    __in SIZE_T         InputBufferSize,
+    __out_opt PVOID     OutputBuffer,
+    __in SIZE_T         OutputBufferSize,
+    __out ULONG *       BytesReturned
+    )
+{
+    SIM_MONITOR * CONST                     Monitor = ProviderContext;
+    LCI_PROXYKMD_PRIMARY_SURFACE_CREATE *   CreateData;
+    LCI_PROXYKMD_PRIMARY_SURFACE_DESTROY *  DestroyData;
+    LCI_PROXYKMD_PRIMARY_SURFACE_UPDATE *   UpdateData;
+    LCI_PROXYKMD_CURSOR_UPDATE *            CursorData;
+    LCI_PROXYKMD_VISIBILITY_UPDATE *        VisibilityData;
+    LCI_PROXYKMD_COMMIT_VIDPN *             CommitData;
+    SIM_SURFACE *                           Surface;
+    ULONG                                   BitmapSize;
+    NTSTATUS                                ntStatus;
+
+    (void) OutputBuffer;
+    (void) OutputBufferSize;
+    *BytesReturned = 0;
+    ntStatus = STATUS_NOT_SUPPORTED;
+    pthread_mutex_lock(&Monitor->Lock);
+    switch (IoctlCode)
+    {
+    case LCI_PROXYKMD_NOTIFY_PRIMARY_SURFACE_CREATE:
+        if (InputBufferSize < sizeof(*CreateData))
+        {
+            ntStatus = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+        CreateData = InputBuffer;
+        Surface = SimFindSurface(Monitor->Surfaces, NULL);
+        if (Surface == NULL)
+        {
+            ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+            break;
+        }
+        Surface->hPrimarySurface = CreateData->hPrimarySurface;
+        Surface->Buffer = CreateData->pBuffer;
+        Surface->BufferSize = CreateData->BufferSize;
+        Surface->Width = CreateData->Width;
+        Surface->Height = CreateData->Height;
+        Surface->Pitch = CreateData->Pitch;
+        Surface->BytesPerPixel = CreateData->BytesPerPixel;
+        ntStatus = STATUS_SUCCESS;
+        break;
+
+    case LCI_PROXYKMD_NOTIFY_PRIMARY_SURFACE_DESTROY:
+        if (InputBufferSize < sizeof(*DestroyData))
+        {
+            ntStatus = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+        DestroyData = InputBuffer;
+        Surface = SimFindSurface(Monitor->Surfaces, DestroyData->hPrimarySurface);
+        if (Surface != NULL)
+            RtlZeroMemory(Surface, sizeof(*Surface));
+        ntStatus = STATUS_SUCCESS;
+        break;
+
+    case LCI_PROXYKMD_NOTIFY_PRIMARY_SURFACE_UPDATE:
+        if (InputBufferSize < sizeof(*UpdateData))
+        {
+            ntStatus = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+        UpdateData = InputBuffer;
+        Monitor->LatestFrameId = UpdateData->FrameId;
+        Monitor->hLatestPrimarySurface = UpdateData->hPrimarySurface;
+        Monitor->FramePending = TRUE;
+        Monitor->Updates++;
+        pthread_cond_signal(&Monitor->Wake);
+        ntStatus = STATUS_SUCCESS;
+        break;
+
+    case LCI_PROXYKMD_NOTIFY_CURSOR_UPDATE:
+        if (InputBufferSize < sizeof(*CursorData))
+        {
+            ntStatus = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+        CursorData = InputBuffer;
+        if (CursorData->pPositionUpdate != NULL)
+        {
+            Monitor->PointerX = CursorData->pPositionUpdate->X;
+            Monitor->PointerY = CursorData->pPositionUpdate->Y;
+            Monitor->PointerVisible = CursorData->pPositionUpdate->Flags.Visible == 1;
+        }
+        if (CursorData->pShapeUpdate != NULL)
+        {
+            BitmapSize = CursorData->pShapeUpdate->Pitch * CursorData->pShapeUpdate->Height;
+            if (CursorData->pShapeUpdate->Flags.Monochrome)
+                BitmapSize *= 2;
+            if (BitmapSize > sizeof(Monitor->PointerBitmap))
+            {
+                ntStatus = STATUS_INVALID_PARAMETER;
+                break;
+            }
+            RtlCopyMemory(
+                Monitor->PointerBitmap,
+                CursorData->pShapeUpdate->pPixels,
+                BitmapSize
+                );
+        }
+        Monitor->CursorUpdates++;
+        ntStatus = STATUS_SUCCESS;
+        break;
+
+    case LCI_PROXYKMD_NOTIFY_VISIBILITY_UPDATE:
+        if (InputBufferSize < sizeof(*VisibilityData))
+        {
+            ntStatus = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+        VisibilityData = InputBuffer;
+        Monitor->Visible = VisibilityData->Visible;
+        ntStatus = STATUS_SUCCESS;
+        break;
+
+    case LCI_PROXYKMD_NOTIFY_COMMIT_VIDPN:
+        if (InputBufferSize < sizeof(*CommitData))
+        {
+            ntStatus = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+        CommitData = InputBuffer;
+        Monitor->Width = CommitData->Width;
+        Monitor->Height = CommitData->Height;
+        Monitor->Rotation = CommitData->ContentTransformation.Rotation;
+        Monitor->ModeChanges++;
+        ntStatus = STATUS_SUCCESS;
+        break;
+
+    default:
+        break;
+    }
+    if (!NT_SUCCESS(ntStatus))
+        Monitor->Errors++;
+    pthread_mutex_unlock(&Monitor->Lock);
+    return ntStatus;
+}
+
+static VOID
+MonitorReleaseInterface(
+    __in PVOID  ProviderContext
+    )
+{
+    SIM_MONITOR * CONST Monitor = ProviderContext;
+
+    pthread_mutex_lock(&Monitor->Lock);
+    RtlZeroMemory(&Monitor->TargetGenericInterface, sizeof(LCI_GENERIC_INTERFACE));
+    pthread_mutex_unlock(&Monitor->Lock);
+}
+
+/*
+ * Stands in for vmon.exe: wait for a frame, blit it through the ProxyKMD
+ * up-call into a shadow buffer, note how long after its update it arrived.
+ * Updates posted while a blit is running coalesce into one, as they do in
+ * the driver, and count as dropped.
+ */
+static void *
+MonitorConsumer(
+    void *  Context
+    )
+{
+    SIM_MONITOR * CONST     Monitor = Context;
+    LCI_GENERIC_INTERFACE   Target;
+    LCI_USBAV_BLT_DATA      BltData;
+    SIM_SURFACE *           Surface;
+    ULONG                   FrameId;
+    ULONG                   BytesReturned;
+    ULONGLONG               Latency;
+    NTSTATUS                ntStatus;
+
+    pthread_mutex_lock(&Monitor->Lock);
+    for (;;)
+    {
+        while (!Monitor->Stop && !Monitor->FramePending)
+        {
+            Monitor->Idle = TRUE;
+            pthread_cond_broadcast(&Monitor->Wake);
+            pthread_cond_wait(&Monitor->Wake, &Monitor->Lock);
+        }
+        Monitor->Idle = FALSE;
+        if (Monitor->Stop)
+            break;
+
+        Monitor->FramePending = FALSE;
+        FrameId = Monitor->LatestFrameId;
+        if (Monitor->Frames != 0 && FrameId - Monitor->LastSentFrameId > 1)
+            Monitor->Dropped += FrameId - Monitor->LastSentFrameId - 1;
+        Monitor->LastSentFrameId = FrameId;
+
+        Surface = SimFindSurface(Monitor->Surfaces, Monitor->hLatestPrimarySurface);
+        if (Surface == NULL || Monitor->TargetGenericInterface.pfnGenericIoctl == NULL)
+        {
+            Monitor->Stale++;
+            continue;
+        }
+        RtlZeroMemory(&BltData, sizeof(BltData));
+        BltData.hPrimarySurface = Surface->hPrimarySurface;
+        BltData.pPrimaryBuffer = Surface->Buffer;
+        BltData.BufferSize = Surface->BufferSize;
+        Target = Monitor->TargetGenericInterface;
+        pthread_mutex_unlock(&Monitor->Lock);
+
+        if (Monitor->ShadowSize < BltData.BufferSize)
+        {
+            free(Monitor->Shadow);
+            Monitor->Shadow = malloc(BltData.BufferSize);
+            Monitor->ShadowSize = Monitor->Shadow != NULL ? BltData.BufferSize : 0;
+        }
+        ntStatus = STATUS_INSUFFICIENT_RESOURCES;
+        if (Monitor->Shadow != NULL)
+        {
+            BltData.pShadowBuffer = Monitor->Shadow;
+            ntStatus = (*Target.pfnGenericIoctl)(
+                Target.ProviderContext,
+                LCI_USBAV_BLT_PRIMARY_TO_SHADOW,
+                &BltData,
+                sizeof(BltData),
+                NULL,
+                0,
+                &BytesReturned
+                );
+        }
+        Latency = SimNow() - BltData.FrameTimeStamp;
+
+        pthread_mutex_lock(&Monitor->Lock);
+        if (ntStatus == STATUS_INVALID_HANDLE)
+        {
+            Monitor->Stale++;
+            continue;
+        }
+        if (!NT_SUCCESS(ntStatus))
+        {
+            Monitor->Errors++;
+            continue;
+        }
+        Monitor->Frames++;
+        if (Monitor->NumSamples < SIM_MAX_SAMPLES)
+        {
+            Monitor->Samples[Monitor->NumSamples++] =
+                Latency > 0xFFFFFFFF ? 0xFFFFFFFF : (ULONG) Latency;
+        }
+    }
+    pthread_mutex_unlock(&Monitor->Lock);
+    return NULL;
+}
+
+/*
+ * The interface exchange of INTERNAL_IOCTL_QUERY_USB_MONITOR_INTERFACE: the
+ * monitor keeps ProxyKMD's interface and hands back its own.
+ */
+static NTSTATUS
+MonitorQueryInterface(
+    __in SIM_MONITOR *                  Monitor,
+    __in CONST LCI_GENERIC_INTERFACE *  ProxyInterface,
+    __out LCI_GENERIC_INTERFACE *       MonitorInterface
+    )
+{
+    pthread_mutex_lock(&Monitor->Lock);
+    Monitor->TargetGenericInterface = *ProxyInterface;
+    pthread_mutex_unlock(&Monitor->Lock);
+
+    RtlZeroMemory(MonitorInterface, sizeof(*MonitorInterface));
+    MonitorInterface->Version = LCI_GENERIC_INTERFACE_V1;
+    MonitorInterface->Size = sizeof(*MonitorInterface);
+    MonitorInterface->ProviderContext = Monitor;
+    MonitorInterface->pfnGenericIoctl = &MonitorGenericIoctl;
+    MonitorInterface->pfnReleaseInterface = &MonitorReleaseInterface;
+    return STATUS_SUCCESS;
+}
+
+static BOOLEAN
+MonitorInit(
+    __out SIM_MONITOR * Monitor
+    )
+{
+    RtlZeroMemory(Monitor, sizeof(*Monitor));
+    Monitor->Samples = malloc(SIM_MAX_SAMPLES * sizeof(ULONG));
+    if (Monitor->Samples == NULL)
+        return FALSE;
+    pthread_mutex_init(&Monitor->Lock, NULL);
+    pthread_cond_init(&Monitor->Wake, NULL);
+    if (pthread_create(&Monitor->Consumer, NULL, &MonitorConsumer, Monitor) != 0)
+    {
+        pthread_cond_destroy(&Monitor->Wake);
+        pthread_mutex_destroy(&Monitor->Lock);
+        free(Monitor->Samples);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static VOID
+MonitorDeInit(
+    __in SIM_MONITOR *  Monitor
+    )
+{
+    pthread_mutex_lock(&Monitor->Lock);
+    Monitor->Stop = TRUE;
+    pthread_cond_broadcast(&Monitor->Wake);
+    pthread_mutex_unlock(&Monitor->Lock);
+    pthread_join(Monitor->Consumer, NULL);
+
+    pthread_cond_destroy(&Monitor->Wake);
+    pthread_mutex_destroy(&Monitor->Lock);
+    free(Monitor->Shadow);
+    free(Monitor->Samples);
+}
+
+/*
+ * Wait until the consumer has blitted everything posted so far, or a
+ * second has passed.
+ */
+static VOID
+MonitorDrain(
+    __in SIM_MONITOR *  Monitor
+    )
+{
+    ULONGLONG CONST Deadline = SimNow() + 1000000000ULL;
+
+    pthread_mutex_lock(&Monitor->Lock);
+    while ((Monitor->FramePending || !Monitor->Idle) && SimNow() < Deadline)
+    {
+        pthread_mutex_unlock(&Monitor->Lock);
+        SimSleepUntil(SimNow() + 100000);
+        pthread_mutex_lock(&Monitor->Lock);
+    }
+    pthread_mutex_unlock(&Monitor->Lock);
+}
+
+static int
+CompareSamples(
+    CONST VOID *    a,
+    CONST VOID *    b
+    )
+{
+    ULONG CONST x = *(CONST ULONG *) a;
+    ULONG CONST y = *(CONST ULONG *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * (Re)start the selected workload on the current primary surface, from its
+ * first, fully painted frame.
+ */
+static NTSTATUS
+SimStartWorkload(
+    __in SIM_PRODUCER * Producer
+    )
+{
+    LJB_VMON_WorkloadDeInit(&Producer->Workload);
+    if (!Producer->UseWorkload || Producer->Primary == NULL)
+        return STATUS_SUCCESS;
+
+    if (!LJB_VMON_WorkloadInit(
+            &Producer->Workload,
+            Producer->WorkloadKind,
+            Producer->Primary->Width,
+            Producer->Primary->Height,
+            Producer->WorkloadSeed))
+    {
+        fprintf(stderr, "proxykmd: cannot start workload %s\n",
+            LJB_VMON_WorkloadName(Producer->WorkloadKind));
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS
+SimDestroySurface(
+    __in SIM_PRODUCER * Producer
+    )
+{
+    SIM_PROXYKMD * CONST                    Proxy = Producer->Proxy;
+    SIM_SURFACE * CONST                     Primary = Producer->Primary;
+    LCI_PROXYKMD_PRIMARY_SURFACE_DESTROY    DestroyData;
+    UCHAR *                                 Buffer;
+    NTSTATUS                                ntStatus;
+
+    if (Primary == NULL)
+        return STATUS_SUCCESS;
+
+    RtlZeroMemory(&DestroyData, sizeof(DestroyData));
+    DestroyData.hPrimarySurface = Primary->hPrimarySurface;
+    DestroyData.pBuffer = Primary->Buffer;
+    DestroyData.BufferSize = Primary->BufferSize;
+    DestroyData.Width = Primary->Width;
+    DestroyData.Height = Primary->Height;
+    DestroyData.Pitch = Primary->Pitch;
+    DestroyData.BytesPerPixel = Primary->BytesPerPixel;
+    ntStatus = ProxyNotify(
+        Proxy,
+        LCI_PROXYKMD_NOTIFY_PRIMARY_SURFACE_DESTROY,
+        &DestroyData,
+        sizeof(DestroyData)
+        );
+
+    /*
+     * a blit that is still running finishes before the buffer goes away
+     */
+    pthread_mutex_lock(&Proxy->SurfaceLock);
+    Buffer = Primary->Buffer;
+    RtlZeroMemory(Primary, sizeof(*Primary));
+    pthread_mutex_unlock(&Proxy->SurfaceLock);
+    free(Buffer);
+
+    Producer->Primary = NULL;
+    return ntStatus;
+}
+
+static NTSTATUS
+SimSetMode(
+    __in SIM_PRODUCER * Producer,
+    __in UINT           Width,
+    __in UINT           Height,
+    __in UINT           Rotation
+    )
+{
+    SIM_PROXYKMD * CONST                Proxy = Producer->Proxy;
+    LCI_PROXYKMD_COMMIT_VIDPN           CommitData;
+    LCI_PROXYKMD_PRIMARY_SURFACE_CREATE CreateData;
+    LCI_PROXYKMD_VISIBILITY_UPDATE      VisibilityData;
+    SIM_SURFACE *                       Primary;
+    UCHAR *                             Buffer;
+    NTSTATUS                            ntStatus;
+
+    ntStatus = SimDestroySurface(Producer);
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+
+    RtlZeroMemory(&CommitData, sizeof(CommitData));
+    CommitData.Width = Width;
+    CommitData.Height = Height;
+    CommitData.Pitch = Width * 4;
+    CommitData.BytesPerPixel = 4;
+    CommitData.ContentTransformation.Scaling = D3DKMDT_VPPS_IDENTITY;
+    CommitData.ContentTransformation.Rotation = Rotation;
+    ntStatus = ProxyNotify(
+        Proxy,
+        LCI_PROXYKMD_NOTIFY_COMMIT_VIDPN,
+        &CommitData,
+        sizeof(CommitData)
+        );
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+
+    RtlZeroMemory(&VisibilityData, sizeof(VisibilityData));
+    VisibilityData.Visible = Width != 0;
+    if (Width == 0 || Height == 0)
+    {
+        return ProxyNotify(
+            Proxy,
+            LCI_PROXYKMD_NOTIFY_VISIBILITY_UPDATE,
+            &VisibilityData,
+            sizeof(VisibilityData)
+            );
+    }
+
+    Buffer = calloc(1, (SIZE_T) Width * Height * 4);
+    if (Buffer == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    pthread_mutex_lock(&Proxy->SurfaceLock);
+    Primary = SimFindSurface(Proxy->Surfaces, NULL);
+    Primary->hPrimarySurface = (HANDLE) ++Proxy->NextHandle;
+    Primary->Buffer = Buffer;
+    Primary->BufferSize = (SIZE_T) Width * Height * 4;
+    Primary->Width = Width;
+    Primary->Height = Height;
+    Primary->Pitch = Width * 4;
+    Primary->BytesPerPixel = 4;
+    pthread_mutex_unlock(&Proxy->SurfaceLock);
+    Producer->Primary = Primary;
+    Producer->PaintRow = 0;
+    ntStatus = SimStartWorkload(Producer);
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+
+    RtlZeroMemory(&CreateData, sizeof(CreateData));
+    CreateData.hPrimarySurface = Primary->hPrimarySurface;
+    CreateData.pBuffer = Primary->Buffer;
+    CreateData.BufferSize = Primary->BufferSize;
+    CreateData.Width = Primary->Width;
+    CreateData.Height = Primary->Height;
+    CreateData.Pitch = Primary->Pitch;
+    CreateData.BytesPerPixel = Primary->BytesPerPixel;
+    ntStatus = ProxyNotify(
+        Proxy,
+        LCI_PROXYKMD_NOTIFY_PRIMARY_SURFACE_CREATE,
+        &CreateData,
+        sizeof(CreateData)
+        );
+    if (!NT_SUCCESS(ntStatus))
+        return ntStatus;
+
+    return ProxyNotify(
+        Proxy,
+        LCI_PROXYKMD_NOTIFY_VISIBILITY_UPDATE,
+        &VisibilityData,
+        sizeof(VisibilityData)
+        );
+}
+
+/*
+ * Paint the next band of PaintRows rows with the frame number, as a
+ * render would between two presents, or the next frame of the workload,
+ * then post the update.
+ */
+static NTSTATUS
+SimPostUpdate(
+    __in SIM_PRODUCER * Producer
+    )
+{
+    SIM_PROXYKMD * CONST                Proxy = Producer->Proxy;
+    SIM_SURFACE * CONST                 Primary = Producer->Primary;
+    LCI_PROXYKMD_PRIMARY_SURFACE_UPDATE UpdateData;
+    LJB_VMON_WORKLOAD_FRAME             Frame;
+    ULONG *                             Row;
+    UINT                                Rows;
+    UINT                                x, y;
+
+    if (Primary == NULL)
+    {
+        fprintf(stderr, "proxykmd: no mode set\n");
+        return STATUS_INVALID_HANDLE;
+    }
+
+    pthread_mutex_lock(&Proxy->SurfaceLock);
+    if (Producer->UseWorkload)
+    {
+        LJB_VMON_WorkloadNextFrame(&Producer->Workload, Primary->Buffer, Primary->Pitch, &Frame);
+        Producer->Presents++;
+        if (Frame.Damage.NumRects == 0)
+        {
+            /*
+             * nothing changed, so nothing would have been presented
+             */
+            pthread_mutex_unlock(&Proxy->SurfaceLock);
+            return STATUS_SUCCESS;
+        }
+        Producer->DamagedPixels += LJB_VMON_DamageArea(&Frame.Damage);
+    }
+    else
+    {
+        Rows = Producer->PaintRows;
+        if (Rows == 0 || Rows > Primary->Height)
+            Rows = Primary->Height;
+        for (y = 0; y < Rows; y++)
+        {
+            Row = (ULONG *) (Primary->Buffer + (SIZE_T) Producer->PaintRow * Primary->Pitch);
+            for (x = 0; x < Primary->Width; x++)
+                Row[x] = (Producer->FrameId + 1) * 0x010101 + x;
+            if (++Producer->PaintRow == Primary->Height)
+                Producer->PaintRow = 0;
+        }
+    }
+    Producer->FrameId++;
+    Primary->UpdateTimeStamp = SimNow();
+    pthread_mutex_unlock(&Proxy->SurfaceLock);
+
+    RtlZeroMemory(&UpdateData, sizeof(UpdateData));
+    UpdateData.hPrimarySurface = Primary->hPrimarySurface;
+    UpdateData.pBuffer = Primary->Buffer;
+    UpdateData.BufferSize = Primary->BufferSize;
+    UpdateData.FrameId = Producer->FrameId;
+    UpdateData.Width = Primary->Width;
+    UpdateData.Height = Primary->Height;
+    UpdateData.Pitch = Primary->Pitch;
+    UpdateData.BytesPerPixel = Primary->BytesPerPixel;
+    return ProxyNotify(
+        Proxy,
+        LCI_PROXYKMD_NOTIFY_PRIMARY_SURFACE_UPDATE,
+        &UpdateData,
+        sizeof(UpdateData)
+        );
+}
+
+static NTSTATUS
+SimPostPosition(
+    __in SIM_PRODUCER * Producer,
+    __in INT            X,
+    __in INT            Y,
+    __in BOOLEAN        Visible
+    )
+{
+    DXGKARG_SETPOINTERPOSITION  Position;
+    LCI_PROXYKMD_CURSOR_UPDATE  CursorData;
+
+    RtlZeroMemory(&Position, sizeof(Position));
+    Position.X = X;
+    Position.Y = Y;
+    Position.Flags.Visible = Visible ? 1 : 0;
+    CursorData.pPositionUpdate = &Position;
+    CursorData.pShapeUpdate = NULL;
+    Producer->CursorX = X;
+    Producer->CursorY = Y;
+    return ProxyNotify(
+        Producer->Proxy,
+        LCI_PROXYKMD_NOTIFY_CURSOR_UPDATE,
+        &CursorData,
+        sizeof(CursorData)
+        );
+}
+
+static NTSTATUS
+SimPostShape(
+    __in SIM_PRODUCER * Producer,
+    __in CONST CHAR *   Format,
+    __in UINT           Width,
+    __in UINT           Height
+    )
+{
+    DXGKARG_SETPOINTERSHAPE     Shape;
+    LCI_PROXYKMD_CURSOR_UPDATE  CursorData;
+    UCHAR *                     Pixels;
+    SIZE_T                      Size;
+    SIZE_T                      i;
+    NTSTATUS                    ntStatus;
+
+    if (Width == 0 || Height == 0 || Width > 256 || Height > 256)
+    {
+        fprintf(stderr, "proxykmd: shape %ux%u out of range\n", Width, Height);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    RtlZeroMemory(&Shape, sizeof(Shape));
+    Shape.Width = Width;
+    Shape.Height = Height;
+    if (strcmp(Format, "mono") == 0)
+    {
+        Shape.Flags.Monochrome = 1;
+        Shape.Pitch = (Width + 7) / 8;
+        Size = (SIZE_T) Shape.Pitch * Height * 2;
+    }
+    else if (strcmp(Format, "color") == 0 || strcmp(Format, "masked") == 0)
+    {
+        Shape.Flags.Color = Format[0] == 'c';
+        Shape.Flags.MaskedColor = Format[0] == 'm';
+        Shape.Pitch = Width * 4;
+        Size = (SIZE_T) Shape.Pitch * Height;
+    }
+    else
+    {
+        fprintf(stderr, "proxykmd: unknown shape format %s\n", Format);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    Pixels = malloc(Size);
+    if (Pixels == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+    for (i = 0; i < Size; i++)
+        Pixels[i] = (UCHAR) (i * 7);
+    Shape.pPixels = Pixels;
+
+    CursorData.pPositionUpdate = NULL;
+    CursorData.pShapeUpdate = &Shape;
+    ntStatus = ProxyNotify(
+        Producer->Proxy,
+        LCI_PROXYKMD_NOTIFY_CURSOR_UPDATE,
+        &CursorData,
+        sizeof(CursorData)
+        );
+    free(Pixels);
+    return ntStatus;
+}
+
+/*
+ * Move the pointer one step, bouncing off the edges of the mode.
+ */
+static NTSTATUS
+SimMoveCursor(
+    __in SIM_PRODUCER * Producer
+    )
+{
+    INT CONST   Width = Producer->Primary != NULL ? (INT) Producer->Primary->Width : 1;
+    INT CONST   Height = Producer->Primary != NULL ? (INT) Producer->Primary->Height : 1;
+    INT         X;
+    INT         Y;
+
+    X = Producer->CursorX + Producer->CursorDx;
+    Y = Producer->CursorY + Producer->CursorDy;
+    if (X < 0 || X >= Width)
+    {
+        Producer->CursorDx = -Producer->CursorDx;
+        X = Producer->CursorX + Producer->CursorDx;
+    }
+    if (Y < 0 || Y >= Height)
+    {
+        Producer->CursorDy = -Producer->CursorDy;
+        Y = Producer->CursorY + Producer->CursorDy;
+    }
+    return SimPostPosition(Producer, X, Y, TRUE);
+}
+
+static NTSTATUS
+SimRun(
+    __in SIM_PRODUCER * Producer,
+    __in SIM_MONITOR *  Monitor,
+    __in double         Seconds,
+    __in CONST CHAR *   Label
+    )
+{
+    SIM_PROXYKMD * CONST    Proxy = Producer->Proxy;
+    ULONGLONG CONST         Duration = (ULONGLONG) (Seconds * 1e9);
+    ULONGLONG               Start;
+    ULONGLONG               End;
+    ULONGLONG               Now;
+    ULONGLONG               Wake;
+    ULONGLONG               NextUpdate;
+    ULONGLONG               NextCursor;
+    ULONGLONG               UpdatePeriod;
+    ULONGLONG               CursorPeriod;
+    ULONG64                 Updates;
+    ULONG64                 Frames;
+    ULONG64                 Dropped;
+    ULONG64                 CursorUpdates;
+    ULONG64                 BltBytes;
+    ULONG64                 Stale;
+    ULONG64                 Errors;
+    ULONG64                 Presents;
+    ULONG64                 DamagedPixels;
+    ULONG                   NumSamples;
+    double                  Elapsed;
+    NTSTATUS                ntStatus;
+
+    if (Producer->Primary == NULL)
+    {
+        fprintf(stderr, "proxykmd: run without a mode\n");
+        return STATUS_INVALID_HANDLE;
+    }
+
+    MonitorDrain(Monitor);
+    pthread_mutex_lock(&Monitor->Lock);
+    Updates = Monitor->Updates;
+    Frames = Monitor->Frames;
+    Dropped = Monitor->Dropped;
+    CursorUpdates = Monitor->CursorUpdates;
+    Stale = Monitor->Stale;
+    Errors = Monitor->Errors;
+    Monitor->NumSamples = 0;
+    pthread_mutex_unlock(&Monitor->Lock);
+    pthread_mutex_lock(&Proxy->SurfaceLock);
+    BltBytes = Proxy->BltBytes;
+    pthread_mutex_unlock(&Proxy->SurfaceLock);
+
+    Presents = Producer->Presents;
+    DamagedPixels = Producer->DamagedPixels;
+
+    UpdatePeriod = Producer->Rate ? 1000000000ULL / Producer->Rate : 0;
+    CursorPeriod = Producer->CursorRate ? 1000000000ULL / Producer->CursorRate : 0;
+    if (Producer->CursorDx == 0)
+    {
+        Producer->CursorDx = 7;
+        Producer->CursorDy = 5;
+    }
+
+    ntStatus = STATUS_SUCCESS;
+    Start = SimNow();
+    End = Start + Duration;
+    NextUpdate = Start;
+    NextCursor = CursorPeriod ? Start : End;
+    for (Now = Start; Now < End && NT_SUCCESS(ntStatus); Now = SimNow())
+    {
+        if (Now >= NextCursor)
+        {
+            ntStatus = SimMoveCursor(Producer);
+            NextCursor += CursorPeriod;
+            if (NextCursor < Now)
+                NextCursor = Now + CursorPeriod;
+        }
+        if (Now >= NextUpdate && NT_SUCCESS(ntStatus))
+        {
+            ntStatus = SimPostUpdate(Producer);
+            NextUpdate += UpdatePeriod;
+            if (NextUpdate < Now)
+                NextUpdate = Now + UpdatePeriod;
+        }
+        if (UpdatePeriod != 0 || CursorPeriod != 0)
+        {
+            Wake = NextUpdate < NextCursor ? NextUpdate : NextCursor;
+            SimSleepUntil(Wake < End ? Wake : End);
+        }
+    }
+    Elapsed = (double) (SimNow() - Start) / 1e9;
+    MonitorDrain(Monitor);
+
+    pthread_mutex_lock(&Monitor->Lock);
+    Updates = Monitor->Updates - Updates;
+    Frames = Monitor->Frames - Frames;
+    Dropped = Monitor->Dropped - Dropped;
+    CursorUpdates = Monitor->CursorUpdates - CursorUpdates;
+    Stale = Monitor->Stale - Stale;
+    Errors = Monitor->Errors - Errors;
+    NumSamples = Monitor->NumSamples;
+    qsort(Monitor->Samples, NumSamples, sizeof(ULONG), &CompareSamples);
+    pthread_mutex_lock(&Proxy->SurfaceLock);
+    BltBytes = Proxy->BltBytes - BltBytes;
+    pthread_mutex_unlock(&Proxy->SurfaceLock);
+    Presents = Producer->Presents - Presents;
+    DamagedPixels = Producer->DamagedPixels - DamagedPixels;
+
+    Producer->Runs++;
+    printf("{\"suite\":\"proxykmd\",\"run\":%u,\"label\":\"%s\",\"width\":%u,\"height\":%u,"
+        "\"rate\":%u,\"paint_rows\":%u,\"workload\":\"%s\",\"damage_ratio\":%.4f,\"cursor_rate\":%u,\"seconds\":%.3f,"
+        "\"updates\":%llu,\"update_fps\":%.1f,\"blts\":%llu,\"blt_fps\":%.1f,"
+        "\"blt_mb_per_sec\":%.1f,\"dropped\":%llu,\"cursor_updates\":%llu,\"stale\":%llu,\"errors\":%llu,"
+        "\"latency_us\":{\"min\":%.1f,\"p50\":%.1f,\"p99\":%.1f,\"max\":%.1f}}\n",
+        Producer->Runs,
+        Label,
+        Producer->Primary->Width,
+        Producer->Primary->Height,
+        Producer->Rate,
+        Producer->PaintRows,
+        Producer->UseWorkload ? LJB_VMON_WorkloadName(Producer->WorkloadKind) : "",
+        Presents ? (double) DamagedPixels / Presents /
+            ((double) Producer->Primary->Width * Producer->Primary->Height) : 0.0,
+        Producer->CursorRate,
+        Elapsed,
+        (unsigned long long) Updates,
+        Updates / Elapsed,
+        (unsigned long long) Frames,
+        Frames / Elapsed,
+        BltBytes / Elapsed / 1e6,
+        (unsigned long long) Dropped,
+        (unsigned long long) CursorUpdates,
+        (unsigned long long) Stale,
+        (unsigned long long) Errors,
+        NumSamples ? Monitor->Samples[0] / 1e3 : 0.0,
+        NumSamples ? Monitor->Samples[NumSamples / 2] / 1e3 : 0.0,
+        NumSamples ? Monitor->Samples[(ULONG64) NumSamples * 99 / 100] / 1e3 : 0.0,
+        NumSamples ? Monitor->Samples[NumSamples - 1] / 1e3 : 0.0);
+    fflush(stdout);
+    pthread_mutex_unlock(&Monitor->Lock);
+    return ntStatus;
+}
+
+/*
+ * Run one script line. Returns FALSE on "quit".
+ */
+static BOOLEAN
+SimCommand(
+    __in SIM_PRODUCER * Producer,
+    __in SIM_MONITOR *  Monitor,
+    __in CHAR *         Line,
+    __out NTSTATUS *    pStatus
+    )
+{
+    LCI_PROXYKMD_VISIBILITY_UPDATE  VisibilityData;
+    CHAR *                          Argv[8];
+    CHAR *                          Token;
+    UINT                            Argc;
+    UINT                            Count;
+
+    *pStatus = STATUS_SUCCESS;
+    Token = strchr(Line, '#');
+    if (Token != NULL)
+        *Token = '\0';
+    Argc = 0;
+    for (Token = strtok(Line, " \t\r\n"); Token != NULL && Argc < 8; Token = strtok(NULL, " \t\r\n"))
+        Argv[Argc++] = Token;
+    if (Argc == 0)
+        return TRUE;
+
+    if (strcmp(Argv[0], "quit") == 0)
+    {
+        return FALSE;
+    }
+    else if (strcmp(Argv[0], "mode") == 0 && Argc >= 3)
+    {
+        *pStatus = SimSetMode(
+            Producer,
+            (UINT) strtoul(Argv[1], NULL, 0),
+            (UINT) strtoul(Argv[2], NULL, 0),
+            Argc >= 4 ? (UINT) strtoul(Argv[3], NULL, 0) : D3DKMDT_VPPR_IDENTITY
+            );
+    }
+    else if (strcmp(Argv[0], "visible") == 0 && Argc >= 2)
+    {
+        RtlZeroMemory(&VisibilityData, sizeof(VisibilityData));
+        VisibilityData.Visible = strtoul(Argv[1], NULL, 0) != 0;
+        *pStatus = ProxyNotify(
+            Producer->Proxy,
+            LCI_PROXYKMD_NOTIFY_VISIBILITY_UPDATE,
+            &VisibilityData,
+            sizeof(VisibilityData)
+            );
+    }
+    else if (strcmp(Argv[0], "rate") == 0 && Argc >= 2)
+    {
+        Producer->Rate = (UINT) strtoul(Argv[1], NULL, 0);
+    }
+    else if (strcmp(Argv[0], "paint") == 0 && Argc >= 2)
+    {
+        Producer->PaintRows = (UINT) strtoul(Argv[1], NULL, 0);
+    }
+    else if (strcmp(Argv[0], "workload") == 0 && Argc >= 2)
+    {
+        Producer->UseWorkload = FALSE;
+        if (strcmp(Argv[1], "off") != 0)
+        {
+            if (!LJB_VMON_WorkloadFromName(Argv[1], &Producer->WorkloadKind))
+            {
+                fprintf(stderr, "proxykmd: unknown workload %s\n", Argv[1]);
+                *pStatus = STATUS_INVALID_PARAMETER;
+                return TRUE;
+            }
+            Producer->UseWorkload = TRUE;
+            Producer->WorkloadSeed = Argc >= 3 ? strtoul(Argv[2], NULL, 0) : 1;
+        }
+        *pStatus = SimStartWorkload(Producer);
+    }
+    else if (strcmp(Argv[0], "cursor") == 0 && Argc >= 3)
+    {
+        *pStatus = SimPostPosition(
+            Producer,
+            (INT) strtol(Argv[1], NULL, 0),
+            (INT) strtol(Argv[2], NULL, 0),
+            Argc >= 4 ? strtoul(Argv[3], NULL, 0) != 0 : TRUE
+            );
+    }
+    else if (strcmp(Argv[0], "shape") == 0 && Argc >= 4)
+    {
+        *pStatus = SimPostShape(
+            Producer,
+            Argv[1],
+            (UINT) strtoul(Argv[2], NULL, 0),
+            (UINT) strtoul(Argv[3], NULL, 0)
+            );
+    }
+    else if (strcmp(Argv[0], "cursor_rate") == 0 && Argc >= 2)
+    {
+        Producer->CursorRate = (UINT) strtoul(Argv[1], NULL, 0);
+    }
+    else if (strcmp(Argv[0], "update") == 0)
+    {
+        Count = Argc >= 2 ? (UINT) strtoul(Argv[1], NULL, 0) : 1;
+        while (Count-- != 0 && NT_SUCCESS(*pStatus))
+            *pStatus = SimPostUpdate(Producer);
+    }
+    else if (strcmp(Argv[0], "run") == 0 && Argc >= 2)
+    {
+        *pStatus = SimRun(
+            Producer,
+            Monitor,
+            strtod(Argv[1], NULL),
+            Argc >= 3 ? Argv[2] : ""
+            );
+    }
+    else if (strcmp(Argv[0], "sleep") == 0 && Argc >= 2)
+    {
+        SimSleepUntil(SimNow() + (ULONGLONG) strtoul(Argv[1], NULL, 0) * 1000000ULL);
+    }
+    else
+    {
+        fprintf(stderr, "proxykmd: bad command: %s\n", Argv[0]);
+        *pStatus = STATUS_INVALID_PARAMETER;
+    }
+    return TRUE;
+}
+
+int
+main(
+    int     argc,
+    char ** argv
+    )
+{
+    SIM_PROXYKMD *  Proxy;
+    SIM_MONITOR *   Monitor;
+    SIM_PRODUCER    Producer;
+    FILE *          fp;
+    CHAR            Line[256];
+    NTSTATUS        ntStatus;
+    int             Status;
+
+    if (argc > 2)
+    {
+        fprintf(stderr, "usage: vmon_proxykmd_sim [script]\n");
+        return 2;
+    }
+
+    fp = stdin;
+    if (argc == 2)
+    {
+        fp = fopen(argv[1], "r");
+        if (fp == NULL)
+        {
+            fprintf(stderr, "proxykmd: cannot open %s\n", argv[1]);
+            return 2;
+        }
+    }
+
+    Proxy = calloc(1, sizeof(*Proxy));
+    Monitor = malloc(sizeof(*Monitor));
+    if (Proxy == NULL || Monitor == NULL || !MonitorInit(Monitor))
+    {
+        fprintf(stderr, "proxykmd: out of memory\n");
+        return 2;
+    }
+    pthread_mutex_init(&Proxy->SurfaceLock, NULL);
+    Proxy->Interface.Version = LCI_GENERIC_INTERFACE_V1;
+    Proxy->Interface.Size = sizeof(LCI_GENERIC_INTERFACE);
+    Proxy->Interface.ProviderContext = Proxy;
+    Proxy->Interface.pfnGenericIoctl = &ProxyGenericIoctl;
+    Proxy->Interface.pfnReleaseInterface = &ProxyReleaseInterface;
+    MonitorQueryInterface(Monitor, &Proxy->Interface, &Proxy->MonitorInterface);
+
+    RtlZeroMemory(&Producer, sizeof(Producer));
+    Producer.Proxy = Proxy;
+    Producer.Rate = 60;
+
+    Status = 0;
+    while (fgets(Line, sizeof(Line), fp) != NULL)
+    {
+        if (!SimCommand(&Producer, Monitor, Line, &ntStatus))
+            break;
+        if (!NT_SUCCESS(ntStatus))
+            Status = 1;
+    }
+
+    MonitorDrain(Monitor);
+    SimDestroySurface(&Producer);
+    LJB_VMON_WorkloadDeInit(&Producer.Workload);
+    (*Proxy->MonitorInterface.pfnReleaseInterface)(Proxy->MonitorInterface.ProviderContext);
+    MonitorDeInit(Monitor);
+    if (Monitor->Errors != 0)
+        Status = 1;
+    pthread_mutex_destroy(&Proxy->SurfaceLock);
+    free(Monitor);
+    free(Proxy);
+    if (fp != stdin)
+        fclose(fp);
+    return Status;
+}
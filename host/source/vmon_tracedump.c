@@ -0,0 +1,458 @@
+/*!
+    \file       vmon_tracedump.c
+    \brief      Reader for driver trace files written by vmon.exe /trace
+    \details    Builds and runs on Linux against host/include/windows.h:
+
+                gcc -std=gnu89 -O2 -Wall -Wno-unknown-pragmas \
+                    -Ihost/include -Iinclude \
+                    host/source/vmon_tracedump.c -o vmon_tracedump
+
+                vmon_tracedump [-q] file
+
+                Merges the per processor records of every drain into one
+                timeline and prints it, one line per event, followed by a
+                summary: how long each kind of event took, the pacing of
+                surface updates and of the blits that fetched them, how long
+                a frame took from its update notification to the end of the
+                blit that returned it, and how many updated frames were never
+                fetched. -q prints the summary only. See
+                include/ljb_vmon_trace.h for the format.
+ */
+
+#include <windows.h>
+#include "ljb_vmon_trace.h"
+
+/*
+ * EventId of the pseudo records standing for the records a drain lost;
+ * Duration holds how many
+ */
+#define TRACE_DROPPED       0
+
+#define TRACE_SURFACE_UPDATE    3   // LCI_PROXYKMD_NOTIFY_PRIMARY_SURFACE_UPDATE
+#define TRACE_STATUS_PENDING    0x00000103
+#define TRACE_STATUS_NOT_SUPPORTED  0xC00000BB  // what most notifications return
+
+static CONST CHAR * CONST EventNames[] =
+{
+    "DROPPED", "NOTIFY", "WAIT", "WAKE", "BLT", "BLT_COPY", "SHAPE"
+};
+
+/*
+ * LCI_PROXYKMD_xxx codes of NOTIFY records, see lci_display_internal_ioctl.h
+ */
+static CONST CHAR * CONST NotifyNames[] =
+{
+    "GET_EDID", "SURFACE_CREATE", "SURFACE_DESTROY", "SURFACE_UPDATE",
+    "CURSOR_UPDATE", "VISIBILITY_UPDATE", "VSYNC", "MEDIA_STATE",
+    "COMMIT_VIDPN", "IS_INTEL_GPU"
+};
+
+#define NUM_NOTIFY_NAMES    (sizeof(NotifyNames) / sizeof(NotifyNames[0]))
+
+typedef struct _TRACE_SAMPLES
+{
+    ULONG64 *   Values;
+    ULONG       Count;
+    ULONG       Max;
+} TRACE_SAMPLES;
+
+/*
+ * FrameId -> when its update was first notified, and whether a blit has
+ * returned it yet. Open addressing, Size is a power of 2.
+ */
+typedef struct _TRACE_FRAME
+{
+    ULONG       FrameId;
+    BOOLEAN     Used;
+    BOOLEAN     Blitted;
+    ULONG64     Updated;
+} TRACE_FRAME;
+
+typedef struct _TRACE_FRAMES
+{
+    TRACE_FRAME *   Slots;
+    ULONG           Size;
+} TRACE_FRAMES;
+
+static ULONG64  Frequency;
+
+static BOOLEAN
+AddSample(
+    __inout TRACE_SAMPLES * Samples,
+    __in ULONG64            Value
+    )
+{
+    ULONG64 *   Values;
+    ULONG       Max;
+
+    if (Samples->Count == Samples->Max)
+    {
+        Max = Samples->Max != 0 ? Samples->Max * 2 : 1024;
+        Values = realloc(Samples->Values, Max * sizeof(ULONG64));
+        if (Values == NULL)
+            return FALSE;
+        Samples->Values = Values;
+        Samples->Max = Max;
+    }
+    Samples->Values[Samples->Count++] = Value;
+    return TRUE;
+}
+
+static int
+CompareValues(
+    CONST VOID *    a,
+    CONST VOID *    b
+    )
+{
+    ULONG64 CONST x = *(CONST ULONG64 *) a;
+    ULONG64 CONST y = *(CONST ULONG64 *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int
+CompareRecords(
+    CONST VOID *    a,
+    CONST VOID *    b
+    )
+{
+    CONST LJB_VMON_TRACE_RECORD * CONST x = a;
+    CONST LJB_VMON_TRACE_RECORD * CONST y = b;
+
+    if (x->Timestamp != y->Timestamp)
+        return x->Timestamp < y->Timestamp ? -1 : 1;
+    if (x->Cpu != y->Cpu)
+        return x->Cpu < y->Cpu ? -1 : 1;
+    return x->Sequence < y->Sequence ? -1 : x->Sequence > y->Sequence;
+}
+
+static double
+Microseconds(
+    __in ULONG64    Ticks
+    )
+{
+    return (double) Ticks * 1e6 / (double) Frequency;
+}
+
+/*
+ * Print "name: n, min/p50/p90/p99/max us" for the samples, which get sorted.
+ */
+static VOID
+PrintSamples(
+    __in CONST CHAR *       Name,
+    __inout TRACE_SAMPLES * Samples
+    )
+{
+    ULONG64 * CONST Values = Samples->Values;
+    ULONG CONST     Count = Samples->Count;
+
+    if (Count == 0)
+    {
+        printf("%-34s %8u\n", Name, 0);
+        return;
+    }
+    qsort(Values, Count, sizeof(ULONG64), &CompareValues);
+    printf("%-34s %8u, us min %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f\n",
+        Name,
+        Count,
+        Microseconds(Values[0]),
+        Microseconds(Values[Count / 2]),
+        Microseconds(Values[(Count * 9) / 10]),
+        Microseconds(Values[(Count * 99) / 100]),
+        Microseconds(Values[Count - 1])
+        );
+}
+
+static TRACE_FRAME *
+LookupFrame(
+    __inout TRACE_FRAMES *  Frames,
+    __in ULONG              FrameId
+    )
+{
+    ULONG   i;
+
+    i = (FrameId * 2654435761U) & (Frames->Size - 1);
+    while (Frames->Slots[i].Used && Frames->Slots[i].FrameId != FrameId)
+        i = (i + 1) & (Frames->Size - 1);
+    return &Frames->Slots[i];
+}
+
+static CONST CHAR *
+CodeName(
+    __in CONST LJB_VMON_TRACE_RECORD *  Record
+    )
+{
+    if (Record->EventId == LJB_VMON_TRACE_NOTIFY ||
+        Record->EventId == LJB_VMON_TRACE_WAIT_COMPLETE)
+    {
+        if (Record->IoctlCode < NUM_NOTIFY_NAMES)
+            return NotifyNames[Record->IoctlCode];
+        return "?";
+    }
+    return "";
+}
+
+int
+main(
+    int     argc,
+    char ** argv
+    )
+{
+    CONST CHAR *                FileName = NULL;
+    BOOLEAN                     Quiet = FALSE;
+    FILE *                      fp;
+    LJB_VMON_TRACE_FILE_HEADER  Header;
+    LJB_VMON_TRACE_DRAIN_DATA   Drain;
+    LJB_VMON_TRACE_RECORD *     Records = NULL;
+    LJB_VMON_TRACE_RECORD *     Record;
+    LJB_VMON_TRACE_RECORD *     Grown;
+    ULONG                       NumRecords = 0;
+    ULONG                       MaxRecords = 0;
+    ULONG                       Drains = 0;
+    ULONG64                     Dropped = 0;
+    ULONG64                     Counts[LJB_VMON_TRACE_MAX_EVENT + 1];
+    TRACE_SAMPLES               Durations[LJB_VMON_TRACE_MAX_EVENT + 1];
+    TRACE_SAMPLES               UpdateDurations;
+    TRACE_SAMPLES               UpdateIntervals;
+    TRACE_SAMPLES               BltIntervals;
+    TRACE_SAMPLES               UpdateToBlt;
+    TRACE_FRAMES                Frames;
+    TRACE_FRAME *               Frame;
+    ULONG64                     First;
+    ULONG64                     LastUpdate = 0;
+    ULONG64                     LastBlt = 0;
+    ULONG                       Updates = 0;
+    ULONG                       Updated = 0;
+    ULONG                       Blitted = 0;
+    ULONG                       WaitsQueued = 0;
+    ULONG                       WaitsAtOnce = 0;
+    double                      Seconds;
+    int                         Status = 0;
+    ULONG                       i;
+    int                         a;
+
+    for (a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "-q") == 0)
+            Quiet = TRUE;
+        else
+            FileName = argv[a];
+    }
+    if (FileName == NULL)
+    {
+        fprintf(stderr, "usage: vmon_tracedump [-q] file\n");
+        return 2;
+    }
+
+    fp = fopen(FileName, "rb");
+    if (fp == NULL)
+    {
+        perror(FileName);
+        return 1;
+    }
+
+    if (fread(&Header, sizeof(Header), 1, fp) != 1 ||
+        memcmp(Header.Signature, LJB_VMON_TRACE_SIGNATURE, sizeof(Header.Signature)) != 0 ||
+        Header.Version != LJB_VMON_TRACE_VERSION ||
+        Header.HeaderSize < sizeof(Header) ||
+        Header.RecordSize != sizeof(LJB_VMON_TRACE_RECORD) ||
+        Header.TimestampFrequency == 0)
+    {
+        fprintf(stderr, "%s: not a version %u trace file\n", FileName, LJB_VMON_TRACE_VERSION);
+        fclose(fp);
+        return 1;
+    }
+    Frequency = Header.TimestampFrequency;
+    fseek(fp, Header.HeaderSize, SEEK_SET);
+
+    /*
+     * read every drain block, one more slot per block for its drop record
+     */
+    while (fread(&Drain, sizeof(Drain), 1, fp) == 1)
+    {
+        if (Drain.NumRecords > 0x1000000)
+        {
+            fprintf(stderr, "%s: corrupt drain block at offset %ld\n",
+                FileName, ftell(fp) - (long) sizeof(Drain));
+            Status = 1;
+            break;
+        }
+        if (NumRecords + Drain.NumRecords + 1 > MaxRecords)
+        {
+            MaxRecords = (NumRecords + Drain.NumRecords + 1) * 2;
+            Grown = realloc(Records, MaxRecords * sizeof(LJB_VMON_TRACE_RECORD));
+            if (Grown == NULL)
+            {
+                fprintf(stderr, "out of memory\n");
+                Status = 2;
+                break;
+            }
+            Records = Grown;
+        }
+        if (Drain.NumRecords != 0 &&
+            fread(Records + NumRecords, sizeof(LJB_VMON_TRACE_RECORD), Drain.NumRecords, fp) !=
+                Drain.NumRecords)
+        {
+            fprintf(stderr, "%s: trace truncated\n", FileName);
+            break;
+        }
+        NumRecords += Drain.NumRecords;
+        Drains++;
+        if (Drain.DroppedRecords != 0)
+        {
+            Record = &Records[NumRecords++];
+            RtlZeroMemory(Record, sizeof(*Record));
+            Record->Timestamp = Drain.Timestamp;
+            Record->EventId = TRACE_DROPPED;
+            Record->Duration = Drain.DroppedRecords;
+            Dropped += Drain.DroppedRecords;
+        }
+    }
+    fclose(fp);
+    if (Status != 0)
+    {
+        free(Records);
+        return Status;
+    }
+
+    qsort(Records, NumRecords, sizeof(LJB_VMON_TRACE_RECORD), &CompareRecords);
+
+    RtlZeroMemory(Counts, sizeof(Counts));
+    RtlZeroMemory(Durations, sizeof(Durations));
+    RtlZeroMemory(&UpdateDurations, sizeof(UpdateDurations));
+    RtlZeroMemory(&UpdateIntervals, sizeof(UpdateIntervals));
+    RtlZeroMemory(&BltIntervals, sizeof(BltIntervals));
+    RtlZeroMemory(&UpdateToBlt, sizeof(UpdateToBlt));
+    for (Frames.Size = 1024; Frames.Size < NumRecords * 2; Frames.Size *= 2)
+        ;
+    Frames.Slots = calloc(Frames.Size, sizeof(TRACE_FRAME));
+    if (Frames.Slots == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        free(Records);
+        return 2;
+    }
+
+    First = NumRecords != 0 ? Records[0].Timestamp : 0;
+    for (i = 0; i < NumRecords; i++)
+    {
+        Record = &Records[i];
+        if (!Quiet)
+        {
+            printf("%12.3f %3u %-8s %-17s",
+                (double) (Record->Timestamp - First) * 1e3 / (double) Frequency,
+                Record->Cpu,
+                Record->EventId <= LJB_VMON_TRACE_MAX_EVENT ? EventNames[Record->EventId] : "?",
+                CodeName(Record)
+                );
+            if (Record->EventId == TRACE_DROPPED)
+                printf(" %u records", Record->Duration);
+            else
+            {
+                printf(" frame %u", Record->FrameId);
+                if (Record->Surface != 0)
+                    printf(" surface 0x%llx", (unsigned long long) Record->Surface);
+                if (Record->Duration != 0)
+                    printf(" %.1f us", Microseconds(Record->Duration));
+                if (Record->Status == TRACE_STATUS_PENDING)
+                    printf(" pending");
+                else if (Record->Status != 0 &&
+                    !(Record->EventId == LJB_VMON_TRACE_NOTIFY &&
+                      Record->Status == TRACE_STATUS_NOT_SUPPORTED))
+                    printf(" status 0x%08x", Record->Status);
+            }
+            printf("\n");
+        }
+
+        if (Record->EventId > LJB_VMON_TRACE_MAX_EVENT)
+            continue;
+        Counts[Record->EventId]++;
+        if (Record->EventId != TRACE_DROPPED &&
+            !AddSample(&Durations[Record->EventId], Record->Duration))
+            Status = 2;
+
+        switch (Record->EventId)
+        {
+        case LJB_VMON_TRACE_NOTIFY:
+            if (Record->IoctlCode != TRACE_SURFACE_UPDATE)
+                break;
+            if (!AddSample(&UpdateDurations, Record->Duration))
+                Status = 2;
+            if (Updates != 0 && !AddSample(&UpdateIntervals, Record->Timestamp - LastUpdate))
+                Status = 2;
+            LastUpdate = Record->Timestamp;
+            Updates++;
+            Frame = LookupFrame(&Frames, Record->FrameId);
+            if (!Frame->Used)
+            {
+                Frame->Used = TRUE;
+                Frame->FrameId = Record->FrameId;
+                Frame->Updated = Record->Timestamp;
+                Updated++;
+            }
+            break;
+
+        case LJB_VMON_TRACE_WAIT_REQUEST:
+            if (Record->Status == TRACE_STATUS_PENDING)
+                WaitsQueued++;
+            else if (Record->Status == 0)
+                WaitsAtOnce++;
+            break;
+
+        case LJB_VMON_TRACE_BLT:
+            if (Record->Status != 0)
+                break;
+            if (LastBlt != 0 && !AddSample(&BltIntervals, Record->Timestamp - LastBlt))
+                Status = 2;
+            LastBlt = Record->Timestamp;
+            Frame = LookupFrame(&Frames, Record->FrameId);
+            if (Frame->Used && !Frame->Blitted && Frame->Updated <= Record->Timestamp)
+            {
+                Frame->Blitted = TRUE;
+                Blitted++;
+                if (!AddSample(&UpdateToBlt,
+                    Record->Timestamp + Record->Duration - Frame->Updated))
+                    Status = 2;
+            }
+            break;
+        }
+    }
+    if (Status != 0)
+        fprintf(stderr, "out of memory\n");
+
+    Seconds = NumRecords != 0 ?
+        (double) (Records[NumRecords - 1].Timestamp - First) / (double) Frequency : 0.0;
+    printf("records %u, drains %u, dropped %llu, cpus %u, duration %.3f s\n",
+        NumRecords - (ULONG) Counts[TRACE_DROPPED],
+        Drains,
+        (unsigned long long) Dropped,
+        Header.NumCpus,
+        Seconds
+        );
+    PrintSamples("notify", &Durations[LJB_VMON_TRACE_NOTIFY]);
+    PrintSamples("notify surface update", &UpdateDurations);
+    PrintSamples("wait request", &Durations[LJB_VMON_TRACE_WAIT_REQUEST]);
+    printf("%-34s %8u queued, %u completed at once\n", "", WaitsQueued, WaitsAtOnce);
+    PrintSamples("wait completed by notify", &Durations[LJB_VMON_TRACE_WAIT_COMPLETE]);
+    PrintSamples("blt", &Durations[LJB_VMON_TRACE_BLT]);
+    PrintSamples("blt copy up-call", &Durations[LJB_VMON_TRACE_BLT_COPY]);
+    PrintSamples("pointer shape", &Durations[LJB_VMON_TRACE_POINTER_SHAPE]);
+    PrintSamples("surface update interval", &UpdateIntervals);
+    PrintSamples("blt interval", &BltIntervals);
+    PrintSamples("surface update to blt done", &UpdateToBlt);
+    if (Seconds > 0)
+        printf("surface updates %u (%.1f/s) of %u frames, fetched %u (%.1f/s), "
+            "never fetched %u\n",
+            Updates, Updates / Seconds, Updated, Blitted, Blitted / Seconds,
+            Updated - Blitted);
+
+    for (i = 0; i <= LJB_VMON_TRACE_MAX_EVENT; i++)
+        free(Durations[i].Values);
+    free(UpdateDurations.Values);
+    free(UpdateIntervals.Values);
+    free(BltIntervals.Values);
+    free(UpdateToBlt.Values);
+    free(Frames.Slots);
+    free(Records);
+    return Status;
+}
@@ -0,0 +1,149 @@
+/*!
+    \file       ljb_vmon_framelog.h
+    \brief      On-disk format of the VMON frame log
+    \details    A frame log is what the recorder sink (vmon.exe /record) saw
+                of a capture session: mode changes, frames as damaged
+                rectangles and moves, and the cursor plane. It is written append-only
+                and read back by host/source/vmon_logdump.c.
+
+                Layout: one LJB_VMON_FRAMELOG_HEADER at offset 0, followed by
+                records. Every record starts with LJB_VMON_FRAMELOG_RECORD,
+                whose Size covers the record header and its payload and is a
+                multiple of 8. All fields are little endian.
+
+                A log whose writer did not shut down cleanly ends in zero
+                bytes; a record of type LJB_VMON_FRAMELOG_TYPE_END or a Size of
+                0 marks the end of the log just as end of file does.
+ */
+
+#ifndef _LJB_VMON_FRAMELOG_H_
+#define _LJB_VMON_FRAMELOG_H_
+
+#include <windows.h>
+
+#define LJB_VMON_FRAMELOG_SIGNATURE     "LJBVMLOG"
+#define LJB_VMON_FRAMELOG_VERSION       2
+
+#define LJB_VMON_FRAMELOG_ALIGN(x)      (((x) + 7) & ~7)
+
+typedef struct _LJB_VMON_FRAMELOG_HEADER
+{
+    UCHAR               Signature[8];           // LJB_VMON_FRAMELOG_SIGNATURE
+    ULONG               Version;
+    ULONG               HeaderSize;             // offset of the first record
+    ULONG64             TimestampFrequency;     // ticks per second
+    ULONG64             StartTimestamp;         // in TimestampFrequency ticks
+    ULONG64             StartTime;              // FILETIME of StartTimestamp
+} LJB_VMON_FRAMELOG_HEADER;
+
+/*
+ * record types
+ */
+#define LJB_VMON_FRAMELOG_TYPE_END               0
+#define LJB_VMON_FRAMELOG_TYPE_MODE_CHANGE       1
+#define LJB_VMON_FRAMELOG_TYPE_FRAME             2
+#define LJB_VMON_FRAMELOG_TYPE_CURSOR_SHAPE      3
+#define LJB_VMON_FRAMELOG_TYPE_CURSOR_POSITION   4
+#define LJB_VMON_FRAMELOG_TYPE_GAP               5
+
+typedef struct _LJB_VMON_FRAMELOG_RECORD
+{
+    ULONG               Type;
+    ULONG               Size;
+    ULONG64             Timestamp;      // when the capture loop reported it
+} LJB_VMON_FRAMELOG_RECORD;
+
+typedef struct _LJB_VMON_FRAMELOG_MODE_CHANGE
+{
+    ULONG               Width;          // 0x0 when the source was disabled
+    ULONG               Height;
+    ULONG               Rotation;       // D3DKMDT_VIDPN_PRESENT_PATH_ROTATION
+    ULONG               Reserved;
+} LJB_VMON_FRAMELOG_MODE_CHANGE;
+
+/*
+ * Frame pixel encodings. RAW: for each rectangle, in order, (Right - Left) *
+ * 4 bytes per row, rows top to bottom, 32bpp BGRX. TILE (vmon.exe
+ * /record_tiles): the rectangles as one tile stream, described in
+ * ljb_vmon_tile_format.h, followed by padding up to the record size.
+ */
+#define LJB_VMON_FRAMELOG_ENCODING_RAW      0
+#define LJB_VMON_FRAMELOG_ENCODING_TILE     1
+
+typedef struct _LJB_VMON_FRAMELOG_RECT
+{
+    LONG                Left;
+    LONG                Top;
+    LONG                Right;          // exclusive
+    LONG                Bottom;         // exclusive
+} LJB_VMON_FRAMELOG_RECT;
+
+/*
+ * Content of the previous frame that moved: Right - Left by Bottom - Top
+ * pixels from (SrcLeft, SrcTop) of the previous frame land at (Left, Top).
+ * Source and destination may overlap. Since version 2.
+ */
+typedef struct _LJB_VMON_FRAMELOG_COPY
+{
+    LONG                Left;
+    LONG                Top;
+    LONG                Right;          // exclusive
+    LONG                Bottom;         // exclusive
+    LONG                SrcLeft;
+    LONG                SrcTop;
+} LJB_VMON_FRAMELOG_COPY;
+
+/*
+ * Followed by NumCopies LJB_VMON_FRAMELOG_COPY, then NumRects
+ * LJB_VMON_FRAMELOG_RECT, then the pixels of those rectangles in Encoding.
+ * The copies are applied to the previous frame in order, then the
+ * rectangles are painted over the result. Both are relative to the previous
+ * frame record; the first frame of a log, and the first after a mode change
+ * or a gap, has no copies and one rectangle covering the whole frame.
+ *
+ * Version 1 logs have no copies; NumCopies was reserved and is 0.
+ */
+typedef struct _LJB_VMON_FRAMELOG_FRAME
+{
+    ULONG               FrameId;        // as reported by the driver
+    ULONG               Width;
+    ULONG               Height;
+    ULONG               NumRects;
+    ULONG               Encoding;
+    ULONG               NumCopies;
+} LJB_VMON_FRAMELOG_FRAME;
+
+/*
+ * Followed by DataSize bytes of shape, laid out as POINTER_SHAPE_DATA.Buffer.
+ */
+typedef struct _LJB_VMON_FRAMELOG_CURSOR_SHAPE
+{
+    ULONG               Flags;          // DXGK_POINTERFLAGS
+    ULONG               Width;
+    ULONG               Height;
+    ULONG               Pitch;
+    ULONG               DataSize;
+    ULONG               Reserved;
+} LJB_VMON_FRAMELOG_CURSOR_SHAPE;
+
+typedef struct _LJB_VMON_FRAMELOG_CURSOR_POSITION
+{
+    LONG                X;
+    LONG                Y;
+    ULONG               Visible;
+    ULONG               Reserved;
+} LJB_VMON_FRAMELOG_CURSOR_POSITION;
+
+/*
+ * The writer could not keep up and dropped records before this one. The
+ * next frame record covers the whole frame, and the cursor shape is
+ * recorded again.
+ */
+typedef struct _LJB_VMON_FRAMELOG_GAP
+{
+    ULONG               DroppedRecords;
+    ULONG               Reserved;
+    ULONG64             DroppedBytes;
+} LJB_VMON_FRAMELOG_GAP;
+
+#endif /* _LJB_VMON_FRAMELOG_H_ */
@@ -110,13 +110,15 @@ typedef struct _DXGK_POINTERFLAGS
  *
  * details
  *  This IOCTL mimics a monitor plug-in event. The user mode app sends down
- *  EDID data(128 Bytes) to ljb_vmon driver. The LJB_VMON driver supports only
- *  one virtual monitor. The kernel driver fails the request there is already a
- *  IOCTL_LJB_VMON_PLUGIN_MONITOR call previously.
+ *  EDID data to ljb_vmon driver: the 128 byte base block and the extension
+ *  blocks its byte 126 counts, up to LCI_DEFAULT_EDID_DATA_SIZE in all. The
+ *  LJB_VMON driver supports only one virtual monitor. The kernel driver fails
+ *  the request there is already a IOCTL_LJB_VMON_PLUGIN_MONITOR call
+ *  previously.
  *
  * parameters
- *    InputBuffer:        A buffer of 128 bytes
- *    InputBufferSize:    128
+ *    InputBuffer:        The EDID
+ *    InputBufferSize:    128 per block, 256 with a CTA-861 extension
  *    OutputBuffer:       NULL
  *    OutputBufferSize:   0
  *
@@ -244,6 +246,15 @@ typedef struct _DXGK_POINTERFLAGS
  *    issue IOCTL_LJB_VMON_GET_POINTER_SHAPE to query the current cursor shape
  *    data.
  *
+ *  PowerChange:
+ *    The kernel driver detects PowerChange event when the device enters D0 or
+ *    leaves it for a low power state. Upon output, Powered tells whether the
+ *    device is now in D0. Nothing reaches the virtual monitor while it is
+ *    not, and the user app can release what it captures with until it is.
+ *
+ *    kernel driver checks the input Powered field. If it mismatches the current
+ *    power state, the request is completed immediately.
+ *
  *  The kernel driver only allows 1 IOCTL_LJB_VMON_WAIT_FOR_MONITOR_EVENT at a time
  *  for each opened file handle. If user app sends more than 1 such a request,
  *  the kernel driver fails the 2nd request immediately. User app should send the request
@@ -275,6 +286,7 @@ typedef struct _LJB_VMON_WAIT_FLAGS
         UINT    VidPnSourceBitmapChange: 1;
         UINT    PointerPositionChange: 1;
         UINT    PointerShapeChange:1;
+        UINT    PowerChange:1;
         };
         UINT    Value;
     };
@@ -307,6 +319,7 @@ typedef struct _LJB_VMON_MONITOR_EVENT
     VIDPN_SOURCE_VISIBILITY_DATA    VidPnSourceVisibilityData;
     ULONG                           FrameId;
     POINTER_POSITION_DATA           PointerPositionData;
+    BOOLEAN                         Powered;        // the device is in D0
     } LJB_VMON_MONITOR_EVENT;
 
 /*
@@ -447,4 +460,62 @@ typedef struct _LOCK_BUFFER_DATA
     METHOD_BUFFERED,                                \
     FILE_ANY_ACCESS)
 
+/*
+ * Name:  IOCTL_LJB_VMON_TRACE_CONTROL
+ *
+ * details
+ *  This IOCTL turns the driver's binary event trace on or off, see
+ *  ljb_vmon_trace.h. The first request with Enable set allocates one ring of
+ *  RecordsPerCpu records per processor; the rings are kept until the device
+ *  is removed, so turning the trace off and on again keeps the records not
+ *  yet drained. Upon completion, the kernel driver fills in NumCpus,
+ *  RecordsPerCpu and the TimestampFrequency of the records.
+ *
+ * parameters
+ *    InputBuffer:        pointer to LJB_VMON_TRACE_CONTROL_DATA
+ *    InputBufferSize:    sizeof(LJB_VMON_TRACE_CONTROL_DATA)
+ *    OutputBuffer:       pointer to LJB_VMON_TRACE_CONTROL_DATA
+ *    OutputBufferSize:   sizeof(LJB_VMON_TRACE_CONTROL_DATA)
+ *
+ */
+#define IOCTL_LJB_VMON_TRACE_CONTROL                \
+    CTL_CODE(FILE_DEVICE_UNKNOWN,                   \
+    LJB_VMON_IOCTL_BASE + 7,                        \
+    METHOD_BUFFERED,                                \
+    FILE_ANY_ACCESS)
+
+typedef struct _LJB_VMON_TRACE_CONTROL_DATA
+{
+    ULONG       Enable;
+    ULONG       NumCpus;
+    ULONG       RecordsPerCpu;
+    ULONG       Reserved;
+    UINT64      TimestampFrequency;
+} LJB_VMON_TRACE_CONTROL_DATA;
+
+/*
+ * Name:  IOCTL_LJB_VMON_TRACE_DRAIN
+ *
+ * details
+ *  This IOCTL moves the trace records logged since the previous drain into
+ *  the OutputBuffer, as one LJB_VMON_TRACE_DRAIN_DATA followed by
+ *  NumRecords LJB_VMON_TRACE_RECORD. The kernel driver returns as many
+ *  records as fit, the rest stay for the next drain. Records overwritten
+ *  before they could be drained are counted in DroppedRecords. User app
+ *  should drain often enough, given RecordsPerCpu and the event rate, and
+ *  may keep draining after turning the trace off.
+ *
+ * parameters
+ *    InputBuffer:        NULL
+ *    InputBufferSize:    0
+ *    OutputBuffer:       pointer to LJB_VMON_TRACE_DRAIN_DATA and records
+ *    OutputBufferSize:   at least sizeof(LJB_VMON_TRACE_DRAIN_DATA)
+ *
+ */
+#define IOCTL_LJB_VMON_TRACE_DRAIN                  \
+    CTL_CODE(FILE_DEVICE_UNKNOWN,                   \
+    LJB_VMON_IOCTL_BASE + 8,                        \
+    METHOD_BUFFERED,                                \
+    FILE_ANY_ACCESS)
+
 #endif
@@ -0,0 +1,176 @@
+/*!
+    \file       ljb_vmon_netproto.h
+    \brief      Wire protocol of the VMON network sink
+    \details    A session is what the network sink (vmon.exe /stream) sends
+                a receiver on two channels to the same address and port:
+
+                The frame channel is a TCP connection. It starts with a
+                HELLO message, then carries mode changes and frames in
+                order. Every message is an LJB_VMON_NET_HEADER followed by
+                Size bytes of body.
+
+                A sender whose frame channel fails connects again and says
+                HELLO with the SessionId of the session it had. The
+                receiver answers every HELLO of version 2 with RESUME, the
+                one message that goes its way: if it kept the frame of that
+                session, which frame that is, so that the sender goes on
+                with what changed since; otherwise the sender starts over
+                with a mode change. A frame cut off by the failure may have
+                been painted in part; the sender sends its rectangles again.
+
+                The cursor channel is UDP, so a cursor update never waits
+                behind frame data; the sender also marks its datagrams for
+                low delay. Each datagram is one LJB_VMON_NET_DATAGRAM and its
+                body. Positions may be lost or reordered: the receiver keeps
+                the one of the highest Sequence. Shapes go in fragments of up
+                to LJB_VMON_NET_FRAGMENT_SIZE bytes and are sent again every
+                LJB_VMON_NET_SHAPE_REPEAT positions, so a lost fragment only
+                delays the shape.
+
+                All fields are little endian. Coordinates are 16 bits.
+ */
+
+#ifndef _LJB_VMON_NETPROTO_H_
+#define _LJB_VMON_NETPROTO_H_
+
+#include <windows.h>
+
+#define LJB_VMON_NET_SIGNATURE          "LJBN"
+#define LJB_VMON_NET_VERSION            2
+#define LJB_VMON_NET_DEFAULT_PORT       5995
+
+/*
+ * frame channel message types
+ */
+#define LJB_VMON_NET_TYPE_HELLO             1
+#define LJB_VMON_NET_TYPE_MODE_CHANGE       2
+#define LJB_VMON_NET_TYPE_FRAME             3
+#define LJB_VMON_NET_TYPE_RESUME            4   // receiver to sender
+
+typedef struct _LJB_VMON_NET_HEADER
+{
+    UCHAR               Type;
+    UCHAR               Reserved[3];
+    ULONG               Size;           // of the body that follows
+} LJB_VMON_NET_HEADER;
+
+/*
+ * Version 1 has no SessionId, and gets no RESUME.
+ */
+typedef struct _LJB_VMON_NET_HELLO
+{
+    UCHAR               Signature[4];   // LJB_VMON_NET_SIGNATURE
+    ULONG               Version;
+    ULONG               SessionId;      // picked by the sender, not 0
+} LJB_VMON_NET_HELLO;
+
+/*
+ * Width and Height are 0 if the receiver has no frame of the session; the
+ * frame it has otherwise is FrameId, the last it applied whole.
+ */
+typedef struct _LJB_VMON_NET_RESUME
+{
+    ULONG               SessionId;
+    ULONG               FrameId;
+    USHORT              Width;
+    USHORT              Height;
+} LJB_VMON_NET_RESUME;
+
+typedef struct _LJB_VMON_NET_MODE_CHANGE
+{
+    USHORT              Width;          // 0x0 when the source was disabled
+    USHORT              Height;
+    ULONG               Rotation;       // D3DKMDT_VIDPN_PRESENT_PATH_ROTATION
+} LJB_VMON_NET_MODE_CHANGE;
+
+/*
+ * Frame pixel encodings, as in ljb_vmon_framelog.h. RAW: for each rectangle,
+ * in order, (Right - Left) * 4 bytes per row, rows top to bottom, 32bpp
+ * BGRX. TILE: the rectangles as one tile stream (ljb_vmon_tile_format.h).
+ */
+#define LJB_VMON_NET_ENCODING_RAW       0
+#define LJB_VMON_NET_ENCODING_TILE      1
+
+typedef struct _LJB_VMON_NET_RECT
+{
+    USHORT              Left;
+    USHORT              Top;
+    USHORT              Right;          // exclusive
+    USHORT              Bottom;         // exclusive
+} LJB_VMON_NET_RECT;
+
+/*
+ * Right - Left by Bottom - Top pixels from (SrcLeft, SrcTop) of the
+ * previous frame land at (Left, Top). Source and destination may overlap.
+ */
+typedef struct _LJB_VMON_NET_COPY
+{
+    USHORT              Left;
+    USHORT              Top;
+    USHORT              Right;          // exclusive
+    USHORT              Bottom;         // exclusive
+    USHORT              SrcLeft;
+    USHORT              SrcTop;
+} LJB_VMON_NET_COPY;
+
+/*
+ * Followed by NumCopies LJB_VMON_NET_COPY, then NumRects LJB_VMON_NET_RECT,
+ * then the pixels of those rectangles in Encoding, to the end of the
+ * message. The copies are applied to the previous frame in order, then the
+ * rectangles are painted over the result. A frame of another size than the
+ * one before, and the first of a session, has no copies and one rectangle
+ * covering the whole frame, and comes after a MODE_CHANGE.
+ */
+typedef struct _LJB_VMON_NET_FRAME
+{
+    ULONG               FrameId;        // as reported by the driver
+    ULONG               SendTime;       // sender clock, microseconds, wraps
+    USHORT              Width;
+    USHORT              Height;
+    UCHAR               Encoding;
+    UCHAR               NumCopies;
+    UCHAR               NumRects;
+    UCHAR               Reserved;
+} LJB_VMON_NET_FRAME;
+
+/*
+ * cursor channel datagram types
+ */
+#define LJB_VMON_NET_TYPE_CURSOR_POSITION   1
+#define LJB_VMON_NET_TYPE_CURSOR_SHAPE      2
+
+#define LJB_VMON_NET_FRAGMENT_SIZE      1024
+#define LJB_VMON_NET_SHAPE_REPEAT       64
+
+typedef struct _LJB_VMON_NET_DATAGRAM
+{
+    UCHAR               Type;
+    UCHAR               Reserved;
+    USHORT              ShapeSerial;    // of the shape in use, 0 before the first
+    ULONG               Sequence;       // of the datagram, wraps
+    ULONG               SendTime;       // sender clock, microseconds, wraps
+} LJB_VMON_NET_DATAGRAM;
+
+typedef struct _LJB_VMON_NET_CURSOR_POSITION
+{
+    SHORT               X;
+    SHORT               Y;
+    ULONG               Visible;
+} LJB_VMON_NET_CURSOR_POSITION;
+
+/*
+ * Followed by up to LJB_VMON_NET_FRAGMENT_SIZE bytes of the shape, laid out
+ * as POINTER_SHAPE_DATA.Buffer, from Offset on. DataSize is the size of the
+ * whole shape; ShapeSerial of the datagram tells shapes apart.
+ */
+typedef struct _LJB_VMON_NET_CURSOR_SHAPE
+{
+    ULONG               Flags;          // DXGK_POINTERFLAGS
+    USHORT              Width;
+    USHORT              Height;
+    ULONG               Pitch;
+    ULONG               DataSize;
+    ULONG               Offset;
+} LJB_VMON_NET_CURSOR_SHAPE;
+
+#endif /* _LJB_VMON_NETPROTO_H_ */
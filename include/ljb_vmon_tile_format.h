@@ -0,0 +1,110 @@
+/*!
+    \file       ljb_vmon_tile_format.h
+    \brief      Bitstream of the lossless tile codec
+    \details    A tile stream carries the pixels of a list of rectangles of a
+                32bpp frame; the rectangles themselves travel outside the
+                stream (e.g. as the rectangles of a frame log record). Each
+                rectangle is cut into LJB_VMON_TILE_SIZE square tiles, row by
+                row from its top left corner, the last column and row of
+                tiles clipped to the rectangle. The stream is the tiles of
+                the first rectangle in that order, then those of the second,
+                and so on, with nothing in between.
+
+                Every tile starts with a 32-bit header holding its type in
+                bits 0-7 and the size of the payload that follows in bits
+                8-31, so a reader can skip tiles or hand them to several
+                threads. All multibyte fields are little endian and nothing
+                is aligned. Pixels are 32-bit values copied as they are; all
+                tile types but DCT are lossless for all 32 bits.
+
+                The encoder is pipeline/source/ljb_vmon_tile_encoder.c, the
+                reference decoder pipeline/source/ljb_vmon_tile_decoder.c.
+ */
+
+#ifndef _LJB_VMON_TILE_FORMAT_H_
+#define _LJB_VMON_TILE_FORMAT_H_
+
+#define LJB_VMON_TILE_SIZE              64
+
+#define LJB_VMON_TILE_HEADER(Type, Size)    ((ULONG) (Type) | ((ULONG) (Size) << 8))
+#define LJB_VMON_TILE_HEADER_TYPE(h)        ((h) & 0xFF)
+#define LJB_VMON_TILE_HEADER_SIZE(h)        ((h) >> 8)
+
+/*
+ * SOLID: one pixel value, for the whole tile.
+ */
+#define LJB_VMON_TILE_SOLID             0
+
+/*
+ * PALETTE: a count byte holding NumColors - 1 (2 to 16 colors), NumColors
+ * pixel values, then one row of indices per tile row, each row starting on a
+ * byte boundary. Indices are 1 bit wide for 2 colors, 2 bits for up to 4 and
+ * 4 bits for up to 16, the first pixel in the most significant bits.
+ */
+#define LJB_VMON_TILE_PALETTE           1
+
+/*
+ * PALETTE_RLE: a count byte holding NumColors - 1 (1 to 256 colors),
+ * NumColors pixel values, then runs covering the tile's pixels row by row,
+ * runs crossing row ends. A run is an index byte followed by its length - 1
+ * as a varint: 7 bits per byte, low bits first, bit 7 set on every byte but
+ * the last.
+ */
+#define LJB_VMON_TILE_PALETTE_RLE       2
+
+/*
+ * LZ: the tile's pixels, row by row, as sequences of literal pixels followed
+ * by a match, counted in pixels. A sequence is:
+ *
+ *   token byte     literal count in bits 4-7, match length minus
+ *                  LJB_VMON_TILE_LZ_MIN_MATCH in bits 0-3
+ *   [length bytes] if the literal count field is 15: bytes added to it,
+ *                  the last one below 255
+ *   literals       that many pixel values
+ *   distance       16 bits, 1 to LJB_VMON_TILE_SIZE^2 pixels back; absent
+ *                  when the literals completed the tile
+ *   [length bytes] if the match length field is 15, as for literals
+ *
+ * A match may overlap the pixels it produces (distance below its length) and
+ * is copied one pixel at a time. The tile ends when all its pixels are
+ * produced, after either literals or a match.
+ */
+#define LJB_VMON_TILE_LZ                3
+#define LJB_VMON_TILE_LZ_MIN_MATCH      2
+
+/*
+ * RAW: the tile's pixels, row by row.
+ */
+#define LJB_VMON_TILE_RAW               4
+
+/*
+ * DCT: lossy, for video and pictures. A quality byte (1 to 100) and a byte
+ * that is bits 24-31 of every decoded pixel, then the tile, extended to a
+ * multiple of 16 pixels both ways by repeating its last column and row, as
+ * 16x16 macroblocks row by row. A macroblock is four 8x8 Y blocks (top
+ * left, top right, bottom left, bottom right), then one Cb and one Cr block
+ * holding the macroblock's chroma at half resolution both ways. Y, Cb and Cr
+ * are the JFIF transform of bits 16-23 (R), 8-15 (G) and 0-7 (B), and every
+ * sample has 128 subtracted before its orthonormal 8x8 DCT.
+ *
+ * A block is its 64 coefficients in zigzag order, each divided by its entry
+ * of the quantization table and rounded; the first, DC, minus that of the
+ * previous block of the same component in the tile (0 for the first). The
+ * tables are those of JPEG (ITU T.81 Annex K) scaled by the quality: entry =
+ * (base * s + 50) / 100 clamped to 1..255, s = 5000 / quality below 50 and
+ * 200 - 2 * quality from there on. The coefficients are coded as tokens:
+ *
+ *   bits 0-5       zero coefficients skipped before this one
+ *   bits 6-7       0: end of block, the rest are zero (token byte is 0)
+ *                  1: the coefficient is 1
+ *                  2: the coefficient is -1
+ *                  3: a varint follows (see PALETTE_RLE) holding the
+ *                     coefficient v as (v << 1) ^ (v >> 31)
+ *
+ * Every block ends with an end token.
+ */
+#define LJB_VMON_TILE_DCT               5
+
+#define LJB_VMON_TILE_TYPES             6
+
+#endif /* _LJB_VMON_TILE_FORMAT_H_ */
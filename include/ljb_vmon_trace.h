@@ -0,0 +1,86 @@
+/*!
+    \file       ljb_vmon_trace.h
+    \brief      Binary trace records of the VMON function driver
+    \details    The driver can log the notification, wait and blit paths as
+                fixed size binary records into one ring per processor, at a
+                cost of a timestamp read and one interlocked increment per
+                event. User mode turns it on and drains it with
+                IOCTL_LJB_VMON_TRACE_CONTROL and IOCTL_LJB_VMON_TRACE_DRAIN
+                (see ljb_vmon_ioctl.h); vmon.exe /trace writes what it drains
+                to a trace file, read back by host/source/vmon_tracedump.c.
+
+                Trace file layout: one LJB_VMON_TRACE_FILE_HEADER at offset 0,
+                followed by the output of each drain as returned by the
+                driver, i.e. an LJB_VMON_TRACE_DRAIN_DATA and its NumRecords
+                records. All fields are little endian. A file whose writer did
+                not shut down cleanly may end in a partial drain block, which
+                readers ignore.
+
+                This header is included by the driver as well as by user mode,
+                so it only uses the base types.
+ */
+
+#ifndef _LJB_VMON_TRACE_H_
+#define _LJB_VMON_TRACE_H_
+
+#define LJB_VMON_TRACE_SIGNATURE        "LJBVMTRC"
+#define LJB_VMON_TRACE_VERSION          1
+
+/*
+ * event ids
+ */
+#define LJB_VMON_TRACE_NOTIFY           1   // ProxyKMD down-call, LJB_VMON_GenericIoctl
+#define LJB_VMON_TRACE_WAIT_REQUEST     2   // WAIT_FOR_MONITOR_EVENT received
+#define LJB_VMON_TRACE_WAIT_COMPLETE    3   // queued wait completed by a notification
+#define LJB_VMON_TRACE_BLT              4   // IOCTL_LJB_VMON_BLT_BITMAP
+#define LJB_VMON_TRACE_BLT_COPY         5   // LCI_USBAV_BLT_PRIMARY_TO_SHADOW up-call
+#define LJB_VMON_TRACE_POINTER_SHAPE    6   // IOCTL_LJB_VMON_GET_POINTER_SHAPE
+#define LJB_VMON_TRACE_MAX_EVENT        LJB_VMON_TRACE_POINTER_SHAPE
+
+/*
+ * One event. Timestamp is when the event started and Duration how long it
+ * took, both in TimestampFrequency ticks; events without a duration have 0.
+ * IoctlCode is the LCI_PROXYKMD_xxx or IOCTL_LJB_VMON_xxx code that caused
+ * the event, Status its NTSTATUS, STATUS_PENDING for a queued wait.
+ *
+ * Sequence is the 1-based position of the record in its processor's ring.
+ * The driver writes it last, so a reader skips records whose Sequence does
+ * not match where it found them.
+ */
+typedef struct _LJB_VMON_TRACE_RECORD
+{
+    ULONG64             Timestamp;
+    ULONG               Sequence;
+    USHORT              EventId;
+    UCHAR               Cpu;
+    UCHAR               Reserved;
+    ULONG               IoctlCode;
+    ULONG               FrameId;
+    ULONG64             Surface;        // hPrimarySurface, 0 if none
+    ULONG               Duration;
+    ULONG               Status;
+} LJB_VMON_TRACE_RECORD;
+
+/*
+ * Output of IOCTL_LJB_VMON_TRACE_DRAIN, followed by NumRecords records,
+ * grouped by processor and in order within each processor. DroppedRecords
+ * counts records overwritten before this drain could read them.
+ */
+typedef struct _LJB_VMON_TRACE_DRAIN_DATA
+{
+    ULONG               NumRecords;
+    ULONG               DroppedRecords;
+    ULONG64             Timestamp;      // when the drain ran
+} LJB_VMON_TRACE_DRAIN_DATA;
+
+typedef struct _LJB_VMON_TRACE_FILE_HEADER
+{
+    UCHAR               Signature[8];           // LJB_VMON_TRACE_SIGNATURE
+    ULONG               Version;
+    ULONG               HeaderSize;             // offset of the first drain block
+    ULONG64             TimestampFrequency;     // ticks per second
+    ULONG               NumCpus;
+    ULONG               RecordSize;             // sizeof(LJB_VMON_TRACE_RECORD)
+} LJB_VMON_TRACE_FILE_HEADER;
+
+#endif /* _LJB_VMON_TRACE_H_ */
@@ -0,0 +1,39 @@
+/*!
+    \file       ljb_vmon_usbproto.h
+    \brief      Stream format of the VMON USB bulk sink
+    \details    The USB sink sends one byte stream down a bulk OUT endpoint:
+                the frame channel messages of ljb_vmon_netproto.h, mode
+                changes and frames, each an LJB_VMON_NET_HEADER and its body,
+                with no HELLO; the device knows what it is talking to from
+                its descriptors. Messages run across transfers as they come.
+
+                Transfers are always whole packets of the endpoint's
+                wMaxPacketSize, LJB_VMON_USB_HS_PACKET_SIZE at high speed and
+                LJB_VMON_USB_SS_PACKET_SIZE at SuperSpeed, so that neither
+                a short packet nor a zero length packet ever ends one. To get
+                there the sink ends every frame with a PAD message that fills
+                up to the next packet boundary, and the device skips its
+                body. A PAD is never shorter than its header, so a frame that
+                ends 1 to 7 bytes before a boundary is padded a packet more.
+
+                The cursor is not on this stream; a USB display carries it on
+                an endpoint of its own.
+
+                All fields are little endian.
+ */
+
+#ifndef _LJB_VMON_USBPROTO_H_
+#define _LJB_VMON_USBPROTO_H_
+
+#include "ljb_vmon_netproto.h"
+
+#define LJB_VMON_USB_HS_PACKET_SIZE     512
+#define LJB_VMON_USB_SS_PACKET_SIZE     1024
+
+/*
+ * message type, beside LJB_VMON_NET_TYPE_MODE_CHANGE and _FRAME; Size bytes
+ * of zeros follow.
+ */
+#define LJB_VMON_USB_TYPE_PAD           0x80
+
+#endif /* _LJB_VMON_USBPROTO_H_ */
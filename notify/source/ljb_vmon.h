@@ -12,16 +12,154 @@
 
 #include "ljb_vmon_ioctl.h"
 #include "ljb_vmon_guid.h"
+#include "ljb_vmon_cursor.h"
+#include "ljb_vmon_sink.h"
+#include "ljb_vmon_framelog.h"
+#include "ljb_vmon_net.h"
+#include "ljb_vmon_usb.h"
+#include "ljb_vmon_edid.h"
+#include "ljb_vmon_tile_codec.h"
+#include "ljb_vmon_trace.h"
 
 /*
  Forward declaration
  */
 typedef struct _LJB_VMON_DEV_CTX    LJB_VMON_DEV_CTX;
 
-#define LPARAM_NOTIFY_FRAME_UPDATE  0x12345678
+/*
+ * Posted by the VMON thread to the parent window when a new frame is
+ * published in DEVICE_INFO.FrameQueue, or the cursor in DEVICE_INFO.Cursor
+ * moved or changed shape. See ljb_vmon_viewer.c.
+ */
+#define WM_LJB_VMON_UPDATE          (WM_APP + 1)
+
+/*
+ * Triple-buffered frame hand-off between the VMON thread and the window
+ * procedure. See ljb_vmon_frame_queue.c.
+ */
+#define LJB_VMON_FRAME_QUEUE_DEPTH  3
+
+typedef struct _LJB_VMON_FRAME_SLOT
+{
+    PVOID                        Buffer;
+    SIZE_T                       BufferSize;
+    ULONG                        Width;
+    ULONG                        Height;
+    ULONG                        FrameId;
+    LJB_VMON_DAMAGE              Damage;        // since the previous frame consumed
+} LJB_VMON_FRAME_SLOT;
+
+typedef struct _LJB_VMON_FRAME_QUEUE
+{
+    LJB_VMON_FRAME_SLOT          Slots[LJB_VMON_FRAME_QUEUE_DEPTH];
+    UINT                         WriteIndex;    // producer only
+    UINT                         ReadIndex;     // consumer only
+    volatile LONG                PendingIndex;  // shared, see FRAME_QUEUE_FRESH
+    ULONG                        PublishedFrames;
+    ULONG                        DroppedFrames;
+} LJB_VMON_FRAME_QUEUE;
+
+/*
+ * The viewer's cursor plane. The VMON thread stores the latest shape and
+ * position under Lock; the window procedure picks them up and composites the
+ * cursor onto the frame it is about to paint.
+ */
+typedef struct _LJB_VMON_VIEWER_CURSOR
+{
+    CRITICAL_SECTION             Lock;
+    POINTER_POSITION_DATA        Position;      // guarded by Lock
+    BOOLEAN                      ShapeChanged;  // guarded by Lock
+    POINTER_SHAPE_DATA           Shape;         // guarded by Lock
+    LJB_VMON_CURSOR_COMPOSITOR   Compositor;    // window procedure only
+} LJB_VMON_VIEWER_CURSOR;
+
+/*
+ * Persistent 32bpp DIB section holding what the viewer shows, frame plus
+ * cursor. Only damaged rectangles are copied into it and blitted to the
+ * window. Window procedure only.
+ */
+typedef struct _LJB_VMON_VIEWER_SURFACE
+{
+    HDC                          hMemDC;
+    HBITMAP                      hDib;
+    HGDIOBJ                      hOldBitmap;
+    ULONG *                      Bits;
+    ULONG                        Width;
+    ULONG                        Height;
+    ULONG64                      Paints;
+    ULONG64                      PaintRects;
+    ULONG64                      PaintBytes;
+} LJB_VMON_VIEWER_SURFACE;
+
+/*
+ * Recorder sink, appends what the capture loop reports to a frame log (see
+ * ljb_vmon_framelog.h). The VMON thread only copies records into Ring; a
+ * writer thread moves them into the file through large mapped views. See
+ * ljb_vmon_recorder.c.
+ */
+#define LJB_VMON_RECORDER_RING_SIZE     (64 * 1024 * 1024)
+#define LJB_VMON_RECORDER_VIEW_SIZE     (64 * 1024 * 1024)
+
+typedef struct _LJB_VMON_RECORDER
+{
+    HANDLE                       hFile;
+    HANDLE                       hWriterThread;
+    HANDLE                       hDataEvent;
+    volatile LONG                Stop;
+
+    /*
+     * single producer (VMON thread), single consumer (writer thread) byte
+     * ring. Head and Tail count bytes and wrap at 2^32.
+     */
+    UCHAR *                      Ring;
+    volatile ULONG               Head;
+    volatile ULONG               Tail;
+
+    /*
+     * VMON thread only
+     */
+    BOOLEAN                      Resync;
+    ULONG                        DroppedRecords;
+    ULONG64                      DroppedBytes;
+    POINTER_SHAPE_DATA *         LastShape;
+    BOOLEAN                      HasShape;
+    POINTER_POSITION_DATA        LastPosition;
+    ULONG                        CommitPosition;
+    ULONG64                      Records;
+    ULONG64                      FrameBytes;
+    BOOLEAN                      Tiles;         // ENCODING_TILE, vmon.exe /record_tiles
+    UINT                         Quality;       // lossy video tiles, vmon.exe /record_lossy
+    LJB_VMON_TILE_ENCODER        TileEncoder;
+
+    /*
+     * writer thread only
+     */
+    HANDLE                       hMapping;
+    UCHAR *                      View;
+    ULONG64                      ViewOffset;
+    ULONG64                      FileSize;
+} LJB_VMON_RECORDER;
+
+/*
+ * Tracer, turns on the driver's trace rings and periodically drains them
+ * into a trace file (see ljb_vmon_trace.h) from a thread of its own. See
+ * ljb_vmon_tracer.c.
+ */
+#define LJB_VMON_TRACER_DRAIN_INTERVAL  100     // ms
+
+typedef struct _LJB_VMON_TRACER
+{
+    HANDLE                       hFile;
+    HANDLE                       hDevice;
+    HANDLE                       hThread;
+    HANDLE                       hStopEvent;
+    HANDLE                       hIoEvent;
+    UCHAR *                      Drain;
+    ULONG                        DrainSize;
+    ULONG64                      Records;
+    ULONG64                      DroppedRecords;
+} LJB_VMON_TRACER;
 
-// From notify.h
-typedef struct _DEVICE_INFO
 {
    HANDLE                       hDevice; // file handle
    HDEVNOTIFY                   hHandleNotification; // notification handle
@@ -31,14 +169,78 @@ typedef struct _DEVICE_INFO
    LIST_ENTRY                   ListEntry;
    HANDLE                       VMONThread;
    ULONG                        VMONThreadId;
-   PVOID                        BitmapBuffer;
-   ULONG                        Width;
-   ULONG                        Height;
+   LJB_VMON_FRAME_QUEUE         FrameQueue;
+   LJB_VMON_VIEWER_CURSOR       Cursor;
+   volatile LONG                UpdatePosted;   // WM_LJB_VMON_UPDATE in flight
+   LJB_VMON_DAMAGE              UnseenDamage;   // VMON thread only
+   LJB_VMON_DAMAGE              SlotDamage[LJB_VMON_FRAME_QUEUE_DEPTH]; // VMON thread only, since each slot was filled
+   BOOLEAN                      SlotEmpty[LJB_VMON_FRAME_QUEUE_DEPTH];  // VMON thread only, no frame of this size in it
+   ULONG64                      CopyBytes;      // VMON thread only, into the frame queue
+   LJB_VMON_VIEWER_SURFACE      Surface;
+   CHAR                         RecordPath[MAX_PATH]; // vmon.exe /record
+   BOOLEAN                      RecordTiles;          // vmon.exe /record_tiles
+   UINT                         RecordQuality;        // vmon.exe /record_lossy
+   CHAR                         TracePath[MAX_PATH];  // vmon.exe /trace
+   CHAR                         StreamAddress[MAX_PATH]; // vmon.exe /stream
+   BOOLEAN                      StreamTiles;          // vmon.exe /stream_tiles
+   UINT                         StreamBandwidth;      // Mbit/s, 0 if not given
+   UINT                         UsbBandwidth;         // vmon.exe /usb_loopback, MB/s
+   UINT                         UsbDepth;
+   UINT                         UsbCredits;           // frames on the link, 0 no flow control
+   DWORD                        IdleDelay;            // vmon.exe /idle, ms
+   BOOLEAN                      NullSink;             // vmon.exe /null
+   BOOLEAN                      Headless;             // vmon.exe /service, no viewer
+   ULONG                        MonitorIndex;         // device interface to drive
+   HANDLE                       hStopEvent;           // NULL, or set to stop the VMON thread
+   LJB_VMON_SINK_STATS          SinkStats;            // as the VMON thread left them
    HWND                         hWndList;
    HWND                         hParentWnd;
    LJB_VMON_DEV_CTX *           dev_ctx;
 } DEVICE_INFO, *PDEVICE_INFO;
 
+/*
+ * How long nobody may see the monitor (the source invisible or disabled, or
+ * the device out of D0) before the VMON thread parks capture and frees its
+ * buffers, unless vmon.exe /idle says otherwise. See ljb_vmon_pixel_main.c.
+ */
+#define LJB_VMON_DEFAULT_IDLE_DELAY     5000    // ms
+
+/*
+ * vmon.exe /service drives up to this many monitors with no window, each
+ * on its own VMON thread; vmon.exe /service_stop sets the named event they
+ * all wait on. See ljb_vmon_service.c.
+ */
+#define LJB_VMON_SERVICE_MAX_MONITORS   16
+#define LJB_VMON_SERVICE_STOP_EVENT     "LJB_VMON_Service_Stop"
+
+/*
+ * How long the VMON thread waits for a device that went away to come back,
+ * and holds on to the mode of a source that went to 0x0 as the device came
+ * back or changed power state, before it lets the sinks know. See
+ * ljb_vmon_pixel_main.c.
+ */
+#define LJB_VMON_REATTACH_WINDOW        10000   // ms
+#define LJB_VMON_REATTACH_INTERVAL      250     // ms, between tries to reopen
+
+/*
+ * Where the VMON thread blits frames: address space reserved for the
+ * largest mode the EDID offers, committed up to the largest mode used so
+ * far and locked down for the driver once per growth. Every mode blits to
+ * Base, so that a mode change reuses pages already faulted in. On large
+ * pages, where the process may lock memory, the arena is committed for the
+ * largest mode at once. See ljb_vmon_pixel_main.c.
+ */
+typedef struct _LJB_VMON_FRAME_ARENA
+{
+    UCHAR *                     Base;
+    SIZE_T                      Reserved;
+    SIZE_T                      Committed;      // from Base, in allocation granularity
+    SIZE_T                      Locked;         // locked by the driver, from Base
+    SIZE_T                      MaxModeSize;    // bytes of the largest mode offered
+    SIZE_T                      LargePageSize;  // 0 if no large pages
+    BOOLEAN                     LargePages;     // Base is on large pages
+} LJB_VMON_FRAME_ARENA;
+
 typedef struct _LJB_VMON_DEV_CTX
     {
     HANDLE                              hDevice;
@@ -50,13 +252,21 @@ typedef struct _LJB_VMON_DEV_CTX
 
     TARGET_MODE_DATA                    TargetModeData;
     VIDPN_SOURCE_VISIBILITY_DATA        VisibilityData;
+    BOOLEAN                             Powered;        // the device is in D0
+    BOOLEAN                             Idle;           // capture parked
+    LJB_VMON_FRAME_ARENA                FrameArena;
     POINTER_POSITION_DATA               PointerPositionData;
     POINTER_SHAPE_DATA                  PointerShapeData;
-    UCHAR                               ShadowBitmapBuffer[256*256*4];
-    UCHAR *                             ShadowBitmapPosition;
-    UINT                                ShadowCursorWidth;
-    UINT                                ShadowCursorHeight;
-    BOOLEAN                             FrameBufferIsDirty;
+    LJB_VMON_SINK_LIST                  Sinks;
+    LJB_VMON_DAMAGE_TRACKER             DamageTracker;
+    LJB_VMON_DAMAGE                     Damage;
+    LJB_VMON_MOTION_DETECTOR            MotionDetector;
+    LJB_VMON_MOTION                     Motion;
+    LJB_VMON_RECORDER                   Recorder;
+    LJB_VMON_TRACER                     Tracer;
+    LJB_VMON_NET_SINK                   NetSink;
+    LJB_VMON_USB_LOOPBACK               UsbLoopback;
+    LJB_VMON_USB_SINK                   UsbSink;
     } LJB_VMON_DEV_CTX;
 
 /*
@@ -197,6 +407,119 @@ LJB_VMON_PixelMain(
     __in LJB_VMON_DEV_CTX *     dev_ctx
     );
 
+VOID
+LJB_VMON_FrameQueueInit(
+    __out LJB_VMON_FRAME_QUEUE *    FrameQueue
+    );
+
+VOID
+LJB_VMON_FrameQueueDeInit(
+    __inout LJB_VMON_FRAME_QUEUE *  FrameQueue
+    );
+
+LJB_VMON_FRAME_SLOT *
+LJB_VMON_FrameQueueGetWriteSlot(
+    __inout LJB_VMON_FRAME_QUEUE *  FrameQueue,
+    __in ULONG                      Width,
+    __in ULONG                      Height
+    );
+
+BOOLEAN
+LJB_VMON_FrameQueuePublish(
+    __inout LJB_VMON_FRAME_QUEUE *  FrameQueue
+    );
+
+LJB_VMON_FRAME_SLOT *
+LJB_VMON_FrameQueueAcquireLatest(
+    __inout LJB_VMON_FRAME_QUEUE *  FrameQueue,
+    __out_opt BOOLEAN *             NewFrame
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_ViewerInit(
+    __inout PDEVICE_INFO            pDeviceInfo
+    );
+
+VOID
+LJB_VMON_ViewerDeInit(
+    __inout PDEVICE_INFO            pDeviceInfo
+    );
+
+VOID
+LJB_VMON_ViewerGetSink(
+    __in PDEVICE_INFO               pDeviceInfo,
+    __out LJB_VMON_SINK *           Sink
+    );
+
+VOID
+LJB_VMON_ViewerPresent(
+    __inout PDEVICE_INFO            pDeviceInfo,
+    __in HWND                       hWnd
+    );
+
+VOID
+LJB_VMON_ViewerPaintAll(
+    __inout PDEVICE_INFO            pDeviceInfo,
+    __in HDC                        hdc
+    );
+
+BOOLEAN
+LJB_VMON_ParseOption(
+    __inout PDEVICE_INFO            pDeviceInfo,
+    __inout PSTR                    Option
+    );
+
+BOOLEAN
+LJB_VMON_ParseOptions(
+    __inout PDEVICE_INFO            pDeviceInfo,
+    __in PCSTR                      CmdLine,
+    __out PCSTR *                   pBadOption
+    );
+
+int
+LJB_VMON_ServiceMain(
+    __in PCSTR                      CmdLine
+    );
+
+int
+LJB_VMON_ServiceStop(
+    VOID
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_RecorderInit(
+    __out LJB_VMON_RECORDER *       Recorder,
+    __in PCSTR                      FileName,
+    __in BOOLEAN                    Tiles,
+    __in UINT                       Quality
+    );
+
+VOID
+LJB_VMON_RecorderDeInit(
+    __inout LJB_VMON_RECORDER *     Recorder
+    );
+
+VOID
+LJB_VMON_RecorderGetSink(
+    __in LJB_VMON_RECORDER *        Recorder,
+    __out LJB_VMON_SINK *           Sink
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_TracerInit(
+    __out LJB_VMON_TRACER *         Tracer,
+    __in HANDLE                     hDevice,
+    __in PCSTR                      FileName
+    );
+
+VOID
+LJB_VMON_TracerDeInit(
+    __inout LJB_VMON_TRACER *       Tracer
+    );
+
 VOID
 LJB_VMON_DumpBuffer(
     __in UCHAR  *               pBuf,
@@ -0,0 +1,230 @@
+#include "ljb_vmon.h"
+
+/*
+ * The frame queue is a triple buffer shared by exactly one producer (the VMON
+ * capture thread) and one consumer (the window procedure). At any time each
+ * slot is owned by exactly one party:
+ *
+ *    WriteIndex    - owned by the producer, filled with the next frame.
+ *    ReadIndex     - owned by the consumer, being presented.
+ *    PendingIndex  - the hand-off slot, swapped atomically by either side.
+ *
+ * The producer publishes by exchanging its write slot with the pending slot.
+ * The consumer picks up the latest frame by exchanging its read slot with the
+ * pending slot, but only if the pending slot carries a frame it has not seen.
+ * Neither side ever waits for the other; frames the consumer is too slow to
+ * pick up are simply overwritten.
+ */
+#define FRAME_QUEUE_INDEX_MASK      0x3
+#define FRAME_QUEUE_FRESH           0x4
+
+/*
+ * Name:  LJB_VMON_FrameQueueInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_FrameQueueInit(
+ *        __out LJB_VMON_FRAME_QUEUE *   FrameQueue
+ *        );
+ *
+ * Description:
+ *    Initialize an empty frame queue. Slot buffers are allocated lazily by
+ *    the producer.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_FrameQueueInit(
+    __out LJB_VMON_FRAME_QUEUE *   FrameQueue
+    )
+{
+    RtlZeroMemory(FrameQueue, sizeof(*FrameQueue));
+    FrameQueue->WriteIndex = 0;
+    FrameQueue->PendingIndex = 1;
+    FrameQueue->ReadIndex = 2;
+}
+
+/*
+ * Name:  LJB_VMON_FrameQueueDeInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_FrameQueueDeInit(
+ *        __inout LJB_VMON_FRAME_QUEUE *  FrameQueue
+ *        );
+ *
+ * Description:
+ *    Free all slot buffers. The caller guarantees neither the producer nor
+ *    the consumer is using the queue any more.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_FrameQueueDeInit(
+    __inout LJB_VMON_FRAME_QUEUE *  FrameQueue
+    )
+{
+    HANDLE CONST    hDefaultHeap = GetProcessHeap();
+    UINT            i;
+
+    for (i = 0; i < LJB_VMON_FRAME_QUEUE_DEPTH; i++)
+    {
+        if (FrameQueue->Slots[i].Buffer != NULL)
+        {
+            HeapFree(hDefaultHeap, 0, FrameQueue->Slots[i].Buffer);
+            FrameQueue->Slots[i].Buffer = NULL;
+            FrameQueue->Slots[i].BufferSize = 0;
+        }
+    }
+}
+
+/*
+ * Name:  LJB_VMON_FrameQueueGetWriteSlot
+ *
+ * Definition:
+ *    LJB_VMON_FRAME_SLOT *
+ *    LJB_VMON_FrameQueueGetWriteSlot(
+ *        __inout LJB_VMON_FRAME_QUEUE *  FrameQueue,
+ *        __in ULONG                      Width,
+ *        __in ULONG                      Height
+ *        );
+ *
+ * Description:
+ *    Producer side. Return the slot the producer owns, grown if necessary to
+ *    hold a Width * Height @ 32bpp frame. Growing is safe because nobody else
+ *    can reference the write slot.
+ *
+ * Return Value:
+ *    pointer to the write slot, or NULL if the buffer could not be allocated.
+ *
+ */
+LJB_VMON_FRAME_SLOT *
+LJB_VMON_FrameQueueGetWriteSlot(
+    __inout LJB_VMON_FRAME_QUEUE *  FrameQueue,
+    __in ULONG                      Width,
+    __in ULONG                      Height
+    )
+{
+    HANDLE CONST            hDefaultHeap = GetProcessHeap();
+    LJB_VMON_FRAME_SLOT *   pSlot;
+    SIZE_T                  RequiredSize;
+
+    pSlot = &FrameQueue->Slots[FrameQueue->WriteIndex];
+    RequiredSize = (SIZE_T) Width * Height * 4;
+    if (pSlot->BufferSize < RequiredSize)
+    {
+        if (pSlot->Buffer != NULL)
+        {
+            HeapFree(hDefaultHeap, 0, pSlot->Buffer);
+            pSlot->Buffer = NULL;
+            pSlot->BufferSize = 0;
+        }
+
+        pSlot->Buffer = HeapAlloc(hDefaultHeap, 0, RequiredSize);
+        if (pSlot->Buffer == NULL)
+        {
+            DBG_PRINT(("?" __FUNCTION__
+                ": unable to allocate slot for Width=%u, Height=%u?\n",
+                Width,
+                Height));
+            return NULL;
+        }
+        pSlot->BufferSize = RequiredSize;
+    }
+
+    pSlot->Width = Width;
+    pSlot->Height = Height;
+    return pSlot;
+}
+
+/*
+ * Name:  LJB_VMON_FrameQueuePublish
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_FrameQueuePublish(
+ *        __inout LJB_VMON_FRAME_QUEUE *  FrameQueue
+ *        );
+ *
+ * Description:
+ *    Producer side. Hand the write slot over to the consumer and take the
+ *    previous pending slot as the new write slot.
+ *
+ * Return Value:
+ *    TRUE if the consumer had already picked up the previous frame, FALSE if
+ *    an unconsumed frame was overwritten.
+ *
+ */
+BOOLEAN
+LJB_VMON_FrameQueuePublish(
+    __inout LJB_VMON_FRAME_QUEUE *  FrameQueue
+    )
+{
+    LONG    OldPending;
+
+    OldPending = InterlockedExchange(
+        &FrameQueue->PendingIndex,
+        (LONG) (FrameQueue->WriteIndex | FRAME_QUEUE_FRESH)
+        );
+    FrameQueue->WriteIndex = OldPending & FRAME_QUEUE_INDEX_MASK;
+    FrameQueue->PublishedFrames++;
+
+    if (OldPending & FRAME_QUEUE_FRESH)
+    {
+        FrameQueue->DroppedFrames++;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_FrameQueueAcquireLatest
+ *
+ * Definition:
+ *    LJB_VMON_FRAME_SLOT *
+ *    LJB_VMON_FrameQueueAcquireLatest(
+ *        __inout LJB_VMON_FRAME_QUEUE *  FrameQueue,
+ *        __out_opt BOOLEAN *             NewFrame
+ *        );
+ *
+ * Description:
+ *    Consumer side. If a frame was published since the last call, swap it in
+ *    as the new read slot and set *NewFrame to TRUE. The returned slot stays
+ *    valid, and owned by the consumer, until the next call.
+ *
+ * Return Value:
+ *    pointer to the most recent frame, or NULL if nothing was published yet.
+ *
+ */
+LJB_VMON_FRAME_SLOT *
+LJB_VMON_FrameQueueAcquireLatest(
+    __inout LJB_VMON_FRAME_QUEUE *  FrameQueue,
+    __out_opt BOOLEAN *             NewFrame
+    )
+{
+    LJB_VMON_FRAME_SLOT *   pSlot;
+    LONG                    OldPending;
+
+    if (NewFrame != NULL)
+        *NewFrame = FALSE;
+
+    if (FrameQueue->PendingIndex & FRAME_QUEUE_FRESH)
+    {
+        OldPending = InterlockedExchange(
+            &FrameQueue->PendingIndex,
+            (LONG) FrameQueue->ReadIndex
+            );
+        FrameQueue->ReadIndex = OldPending & FRAME_QUEUE_INDEX_MASK;
+        if (NewFrame != NULL)
+            *NewFrame = TRUE;
+    }
+
+    pSlot = &FrameQueue->Slots[FrameQueue->ReadIndex];
+    if (pSlot->Buffer == NULL || pSlot->Width == 0 || pSlot->Height == 0)
+        return NULL;
+    return pSlot;
+}
@@ -3,44 +3,6 @@
 #include "ljb_vmon.h"
 
 
-/*
- * The following EDID data is borrowed from Samsung SyncMaster 2343
- */
-UCHAR CONST EdidTemplate[128] = {
-//    00    01    02    03    04    05    06    07    08    09    0A    0B    0C    0D    0E    0F
-    0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x4C, 0x2D, 0x85, 0x05, 0x33, 0x32, 0x59, 0x4D,
-    0x01, 0x14, 0x01, 0x03, 0x80, 0x33, 0x1D, 0x78, 0x2A, 0xEE, 0x91, 0xA3, 0x54, 0x4C, 0x99, 0x26,
-    0x0F, 0x50, 0x54, 0x23, 0x08, 0x00, 0x81, 0x80, 0x81, 0x40, 0x81, 0x00, 0x95, 0x00, 0xB3, 0x00,
-    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x3B, 0x3D, 0x00, 0xA0, 0x80, 0x80, 0x21, 0x40, 0x30, 0x20,
-    0x35, 0x00, 0xFE, 0x1F, 0x11, 0x00, 0x00, 0x1A, 0x00, 0x00, 0x00, 0xFD, 0x00, 0x38, 0x3C, 0x1E,
-    0x51, 0x10, 0x00, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0xFC, 0x00, 0x53,
-    0x79, 0x6E, 0x63, 0x4D, 0x61, 0x73, 0x74, 0x65, 0x72, 0x0A, 0x20, 0x20, 0x00, 0x00, 0x00, 0xFF,
-    0x00, 0x48, 0x56, 0x4D, 0x5A, 0x31, 0x30, 0x30, 0x30, 0x38, 0x30, 0x0A, 0x20, 0x20, 0x01, 0x76,
-
-};
-
-static VOID
-SetEdid(
-    __out UCHAR MyEDID[128]
-    );
-
-static VOID
-LJB_VMON_DrawCursorOnFrameBuffer(
-    __in LJB_VMON_DEV_CTX *             dev_ctx,
-    __in TARGET_MODE_DATA               *TargetModeData,
-    __in VIDPN_SOURCE_VISIBILITY_DATA   *VisibilityData,
-    __in POINTER_POSITION_DATA          *PointerPositionData,
-    __in POINTER_SHAPE_DATA             *PointerShapeData,
-    __out PVOID                         FrameBuffer
-    );
-
-static VOID
-LJB_VMON_RestoreFrameBuffer(
-    __in LJB_VMON_DEV_CTX *             dev_ctx,
-    __in TARGET_MODE_DATA               *TargetModeData,
-    __out PVOID                         FrameBuffer
-    );
-
 /*
  * borrow STATUS_NO_SUCH_DEVICE definition from ntstatus.h
  */
@@ -52,6 +14,21 @@ LJB_VMON_RestoreFrameBuffer(
 #endif
 typedef ULONG WINAPI RTL_NT_STATUS_TO_DOS_ERROR(ULONG ntStatus);
 
+/*
+ * large pages came with Windows Server 2003, after the XP this targets
+ */
+#ifndef MEM_LARGE_PAGES
+#define MEM_LARGE_PAGES                  0x20000000
+#endif
+typedef SIZE_T WINAPI GET_LARGE_PAGE_MINIMUM(VOID);
+
+/*
+ * The USB loopback: above what high speed carries it is SuperSpeed, and a
+ * transfer completes a microframe after its last byte.
+ */
+#define VMON_USB_HS_MAX_BANDWIDTH       60      // MB/s
+#define VMON_USB_LATENCY                125     // microseconds
+
 /*
  * Name:  LJB_VMON_GetDevicePath
  *
@@ -104,7 +81,7 @@ LJB_VMON_GetDevicePath(
         HardwareDeviceInfo,
         0,
         InterfaceGuid,
-        0,
+        dev_ctx->pDeviceInfo->MonitorIndex,
         &DeviceInterfaceData
         );
 
@@ -322,9 +299,105 @@ LJB_VMON_PixelMain_Init(
     __in LJB_VMON_DEV_CTX *    dev_ctx
     )
 {
-    HMODULE CONST       hDwmApiDll = LoadLibrary("dwmapi.dll");
+    HMODULE             hDwmApiDll;
     DWM_ENABLE_MMCSS *  DwmEnableMMCSSFn;
+    LJB_VMON_SINK       Sink;
 
+    LJB_VMON_DamageTrackerInit(&dev_ctx->DamageTracker);
+    LJB_VMON_MotionInit(&dev_ctx->MotionDetector);
+
+    /*
+     * the viewer window unless vmon.exe runs as a service, plus the
+     * recorder, the network sink, the USB sink and the null sink if vmon.exe
+     * was asked to record, stream, go over USB or drop frames.
+     */
+    LJB_VMON_SinkListInit(&dev_ctx->Sinks);
+    if (!dev_ctx->pDeviceInfo->Headless)
+    {
+        LJB_VMON_ViewerGetSink(dev_ctx->pDeviceInfo, &Sink);
+        if (!LJB_VMON_SinkListAdd(&dev_ctx->Sinks, &Sink))
+            return FALSE;
+    }
+
+    if (dev_ctx->pDeviceInfo->NullSink)
+    {
+        LJB_VMON_NullSinkGetSink(&Sink);
+        if (!LJB_VMON_SinkListAdd(&dev_ctx->Sinks, &Sink))
+            return FALSE;
+    }
+
+    if (dev_ctx->pDeviceInfo->RecordPath[0] != '\0')
+    {
+        if (!LJB_VMON_RecorderInit(
+                &dev_ctx->Recorder,
+                dev_ctx->pDeviceInfo->RecordPath,
+                dev_ctx->pDeviceInfo->RecordTiles,
+                dev_ctx->pDeviceInfo->RecordQuality))
+            return FALSE;
+        LJB_VMON_RecorderGetSink(&dev_ctx->Recorder, &Sink);
+        if (!LJB_VMON_SinkListAdd(&dev_ctx->Sinks, &Sink))
+            return FALSE;
+    }
+
+    if (dev_ctx->pDeviceInfo->StreamAddress[0] != '\0')
+    {
+        if (!LJB_VMON_NetSinkInit(
+                &dev_ctx->NetSink,
+                dev_ctx->pDeviceInfo->StreamAddress,
+                dev_ctx->pDeviceInfo->StreamTiles,
+                0))
+        {
+            DBG_PRINT(("?" __FUNCTION__ ": unable to stream to %s?\n",
+                dev_ctx->pDeviceInfo->StreamAddress));
+            return FALSE;
+        }
+        LJB_VMON_NetSinkGetSink(&dev_ctx->NetSink, &Sink);
+        if (!LJB_VMON_SinkListAdd(&dev_ctx->Sinks, &Sink))
+            return FALSE;
+    }
+
+    if (dev_ctx->pDeviceInfo->UsbBandwidth != 0)
+    {
+        if (!LJB_VMON_UsbLoopbackInit(
+                &dev_ctx->UsbLoopback,
+                (dev_ctx->pDeviceInfo->UsbBandwidth > VMON_USB_HS_MAX_BANDWIDTH) ?
+                    LJB_VMON_USB_SS_PACKET_SIZE : LJB_VMON_USB_HS_PACKET_SIZE,
+                dev_ctx->pDeviceInfo->UsbBandwidth * 1000000,
+                VMON_USB_LATENCY) ||
+            !LJB_VMON_UsbSinkInit(
+                &dev_ctx->UsbSink,
+                &dev_ctx->UsbLoopback.Endpoint,
+                0,
+                dev_ctx->pDeviceInfo->UsbDepth,
+                TRUE,
+                0,
+                dev_ctx->pDeviceInfo->UsbCredits))
+        {
+            DBG_PRINT(("?" __FUNCTION__ ": unable to set up the USB loopback?\n"));
+            return FALSE;
+        }
+        LJB_VMON_UsbSinkGetSink(&dev_ctx->UsbSink, &Sink);
+        if (!LJB_VMON_SinkListAdd(&dev_ctx->Sinks, &Sink))
+            return FALSE;
+    }
+
+    if (dev_ctx->pDeviceInfo->TracePath[0] != '\0')
+    {
+        if (!LJB_VMON_TracerInit(
+                &dev_ctx->Tracer,
+                dev_ctx->hDevice,
+                dev_ctx->pDeviceInfo->TracePath
+                ))
+            return FALSE;
+    }
+
+    /*
+     * nothing to compose with the desktop without the viewer
+     */
+    if (dev_ctx->pDeviceInfo->Headless)
+        return TRUE;
+
+    hDwmApiDll = LoadLibrary("dwmapi.dll");
     if (hDwmApiDll == NULL)
     {
         DBG_PRINT(("?" __FUNCTION__ ": unable to load dwmapi.dll?\n"));
@@ -367,6 +440,467 @@ LJB_VMON_PixelMain_DeInit(
     __in LJB_VMON_DEV_CTX *    dev_ctx
     )
 {
+    LJB_VMON_TracerDeInit(&dev_ctx->Tracer);
+    LJB_VMON_UsbSinkDeInit(&dev_ctx->UsbSink);
+    LJB_VMON_UsbLoopbackDeInit(&dev_ctx->UsbLoopback);
+    LJB_VMON_NetSinkDeInit(&dev_ctx->NetSink);
+    LJB_VMON_RecorderDeInit(&dev_ctx->Recorder);
+    LJB_VMON_MotionDeInit(&dev_ctx->MotionDetector);
+    LJB_VMON_DamageTrackerDeInit(&dev_ctx->DamageTracker);
+}
+
+/*
+ * The link the VMON feeds that carries the fewest pixels a second: the USB
+ * loopback at the bandwidth it was given, the network at the rate given
+ * with /stream. The viewer has no limit.
+ */
+static VOID
+LJB_VMON_PixelMainGetLink(
+    __in LJB_VMON_DEV_CTX *     dev_ctx,
+    __out LJB_VMON_EDID_LINK *  Link
+    )
+{
+    PDEVICE_INFO CONST  pDeviceInfo = dev_ctx->pDeviceInfo;
+    LJB_VMON_EDID_LINK  Other;
+
+    RtlZeroMemory(Link, sizeof(*Link));
+    if (pDeviceInfo->UsbBandwidth != 0)
+    {
+        Link->Bandwidth = (ULONG64) pDeviceInfo->UsbBandwidth * 1000000;
+        Link->BitsPerPixel = LJB_VMON_EDID_BPP_TILE;
+    }
+    if (pDeviceInfo->StreamAddress[0] != '\0' && pDeviceInfo->StreamBandwidth != 0)
+    {
+        RtlZeroMemory(&Other, sizeof(Other));
+        Other.Bandwidth = (ULONG64) pDeviceInfo->StreamBandwidth * 1000000 / 8;
+        Other.BitsPerPixel = pDeviceInfo->StreamTiles ?
+            LJB_VMON_EDID_BPP_TILE : LJB_VMON_EDID_BPP_RAW;
+        if (Link->Bandwidth == 0 ||
+            Other.Bandwidth * Link->BitsPerPixel < Link->Bandwidth * Other.BitsPerPixel)
+            *Link = Other;
+    }
+}
+
+/*
+ * Blit frame FrameId into FrameBuffer and report what changed.
+ */
+static VOID
+LJB_VMON_PixelMainBlt(
+    __in LJB_VMON_DEV_CTX *    dev_ctx,
+    __in PVOID                 FrameBuffer,
+    __in UINT                  FrameId
+    )
+{
+    BLT_DATA    BltData;
+    ULONG       bytes_returned;
+
+    /*
+     * acquire bitmap from kmd
+     */
+    if (FrameBuffer == NULL)
+        return;
+
+    RtlZeroMemory(&BltData, sizeof(BltData));
+    BltData.Width           = dev_ctx->TargetModeData.Width;
+    BltData.Height          = dev_ctx->TargetModeData.Height;
+    BltData.FrameId         = FrameId;
+    BltData.FrameBufferSize = dev_ctx->TargetModeData.Width *
+                              dev_ctx->TargetModeData.Height * 4;
+    BltData.FrameBuffer     = (UINT64)((ULONG_PTR) FrameBuffer);
+
+    DeviceIoControl(
+        dev_ctx->hDevice,
+        IOCTL_LJB_VMON_BLT_BITMAP,
+        &BltData,
+        sizeof(BltData),
+        &BltData,
+        sizeof(BltData),
+        &bytes_returned,
+        NULL
+        );
+
+    /*
+     * the frame goes out without the cursor; sinks get the cursor as a
+     * separate plane. If the monitor is set to invisible, don't update.
+     *
+     * The driver doesn't tell which part of the surface was drawn to, so
+     * find out by comparing tile hashes against the previous frame
+     * reported. A frame that changed nothing (a DWM redraw, a cursor-only
+     * present, a paused video) is not reported at all. Within the damage,
+     * look for content that only moved (scrolling, dragging), which sinks
+     * can replay as copies of the previous frame.
+     */
+    if (dev_ctx->VisibilityData.Visible)
+    {
+        LJB_VMON_SINK_FRAME Frame;
+
+        Frame.FrameId   = FrameId;
+        Frame.Width     = dev_ctx->TargetModeData.Width;
+        Frame.Height    = dev_ctx->TargetModeData.Height;
+        Frame.Pitch     = dev_ctx->TargetModeData.Width * 4;
+        Frame.Buffer    = FrameBuffer;
+        Frame.Damage    = &dev_ctx->Damage;
+        Frame.Motion    = &dev_ctx->Motion;
+        LJB_VMON_DamageTrackerUpdate(
+            &dev_ctx->DamageTracker,
+            Frame.Buffer,
+            Frame.Width,
+            Frame.Height,
+            Frame.Pitch,
+            &dev_ctx->Damage
+            );
+        if (dev_ctx->Damage.NumRects != 0)
+        {
+            LJB_VMON_MotionUpdate(
+                &dev_ctx->MotionDetector,
+                Frame.Buffer,
+                Frame.Width,
+                Frame.Height,
+                Frame.Pitch,
+                &dev_ctx->Damage,
+                &dev_ctx->Motion
+                );
+            LJB_VMON_SinkListFrameUpdate(&dev_ctx->Sinks, &Frame);
+        }
+    }
+}
+
+/*
+ * Have the driver lock the committed part of the frame arena down for
+ * blits, in place of what it had locked.
+ */
+static VOID
+LJB_VMON_PixelMainLockFrameArena(
+    __in LJB_VMON_DEV_CTX *    dev_ctx
+    )
+{
+    LJB_VMON_FRAME_ARENA * CONST    Arena = &dev_ctx->FrameArena;
+    LOCK_BUFFER_DATA                LockBufferData;
+    ULONG                           bytes_returned;
+
+    RtlZeroMemory(&LockBufferData, sizeof(LockBufferData));
+    LockBufferData.FrameBuffer = (UINT64)((ULONG_PTR) Arena->Base);
+    if (Arena->Locked != 0)
+    {
+        LockBufferData.FrameBufferSize = (ULONG) Arena->Locked;
+        DeviceIoControl(
+            dev_ctx->hDevice,
+            IOCTL_LJB_VMON_UNLOCK_BUFFER,
+            &LockBufferData,
+            sizeof(LockBufferData),
+            NULL,
+            0,
+            &bytes_returned,
+            NULL
+            );
+        Arena->Locked = 0;
+    }
+    if (Arena->Committed != 0)
+    {
+        LockBufferData.FrameBufferSize = (ULONG) Arena->Committed;
+        DeviceIoControl(
+            dev_ctx->hDevice,
+            IOCTL_LJB_VMON_LOCK_BUFFER,
+            &LockBufferData,
+            sizeof(LockBufferData),
+            NULL,
+            0,
+            &bytes_returned,
+            NULL
+            );
+        Arena->Locked = Arena->Committed;
+    }
+}
+
+/*
+ * The large page size if the OS has large pages and this process may use
+ * them, which takes SeLockMemoryPrivilege; 0 otherwise.
+ */
+static SIZE_T
+LJB_VMON_PixelMainEnableLargePages(VOID)
+{
+    GET_LARGE_PAGE_MINIMUM *    GetLargePageMinimumFn;
+    SIZE_T                      LargePageSize;
+    HANDLE                      hToken;
+    TOKEN_PRIVILEGES            Privileges;
+    BOOL                        Enabled;
+
+    GetLargePageMinimumFn = (GET_LARGE_PAGE_MINIMUM *) GetProcAddress(
+        GetModuleHandle(TEXT("kernel32.dll")),
+        "GetLargePageMinimum"
+        );
+    if (GetLargePageMinimumFn == NULL)
+        return 0;
+    LargePageSize = (*GetLargePageMinimumFn)();
+    if (LargePageSize == 0)
+        return 0;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken))
+        return 0;
+    Privileges.PrivilegeCount = 1;
+    Privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    Enabled =
+        LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &Privileges.Privileges[0].Luid) &&
+        AdjustTokenPrivileges(hToken, FALSE, &Privileges, 0, NULL, NULL) &&
+        GetLastError() == ERROR_SUCCESS;
+    CloseHandle(hToken);
+    return Enabled ? LargePageSize : 0;
+}
+
+/*
+ * Unlock and free the frame arena. What it is sized for stays.
+ */
+static VOID
+LJB_VMON_PixelMainReleaseFrameArena(
+    __in LJB_VMON_DEV_CTX *    dev_ctx
+    )
+{
+    LJB_VMON_FRAME_ARENA * CONST    Arena = &dev_ctx->FrameArena;
+
+    if (Arena->Base == NULL)
+        return;
+    Arena->Committed = 0;
+    LJB_VMON_PixelMainLockFrameArena(dev_ctx);
+    VirtualFree(Arena->Base, 0, MEM_RELEASE);
+    DBG_PRINT((__FUNCTION__ ": frame arena(%p) released\n", Arena->Base));
+    Arena->Base = NULL;
+    Arena->Reserved = 0;
+    Arena->LargePages = FALSE;
+}
+
+/*
+ * Get the frame buffer of the current mode from the frame arena, a single
+ * reservation for the largest mode offered. Within what is committed, that
+ * is the pages of an earlier mode, already faulted in and locked down.
+ * Beyond, the commit grows in place, rounded up to the allocation
+ * granularity and touched as it is committed so that no blit takes the
+ * faults. On large pages, if the process may use them, the whole arena is
+ * committed at once instead, so that no later mode has to reallocate it.
+ */
+static PVOID
+LJB_VMON_PixelMainGetFrameBuffer(
+    __in LJB_VMON_DEV_CTX *    dev_ctx
+    )
+{
+    LJB_VMON_FRAME_ARENA * CONST    Arena = &dev_ctx->FrameArena;
+    SIZE_T CONST                    Size =
+        (SIZE_T) dev_ctx->TargetModeData.Width * dev_ctx->TargetModeData.Height * 4;
+    SYSTEM_INFO                     SystemInfo;
+    SIZE_T                          Granularity;
+    SIZE_T                          Reserve;
+    SIZE_T                          Commit;
+    SIZE_T                          Offset;
+
+    if (Size <= Arena->Committed)
+        return Arena->Base;
+
+    GetSystemInfo(&SystemInfo);
+    if (Arena->Base == NULL || Arena->LargePages || Size > Arena->Reserved)
+    {
+        LJB_VMON_PixelMainReleaseFrameArena(dev_ctx);
+        if (Arena->LargePageSize != 0)
+        {
+            Commit = (Size > Arena->MaxModeSize) ? Size : Arena->MaxModeSize;
+            Commit = (Commit + Arena->LargePageSize - 1) & ~(Arena->LargePageSize - 1);
+            Arena->Base = VirtualAlloc(
+                NULL,
+                Commit,
+                MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                PAGE_READWRITE
+                );
+            if (Arena->Base != NULL)
+            {
+                Arena->Reserved = Commit;
+                Arena->Committed = Commit;
+                Arena->LargePages = TRUE;
+            }
+        }
+        if (Arena->Base == NULL)
+        {
+            Granularity = SystemInfo.dwAllocationGranularity;
+            Reserve = (Size > Arena->MaxModeSize) ? Size : Arena->MaxModeSize;
+            Reserve = (Reserve + Granularity - 1) & ~(Granularity - 1);
+            Arena->Base = VirtualAlloc(NULL, Reserve, MEM_RESERVE, PAGE_READWRITE);
+            if (Arena->Base == NULL)
+            {
+                DBG_PRINT(("?" __FUNCTION__ ": unable to reserve %u bytes?\n", (UINT) Reserve));
+                return NULL;
+            }
+            Arena->Reserved = Reserve;
+        }
+    }
+
+    if (Size > Arena->Committed)
+    {
+        Granularity = SystemInfo.dwAllocationGranularity;
+        Commit = (Size + Granularity - 1) & ~(Granularity - 1);
+        if (VirtualAlloc(
+                Arena->Base + Arena->Committed,
+                Commit - Arena->Committed,
+                MEM_COMMIT,
+                PAGE_READWRITE
+                ) == NULL)
+        {
+            DBG_PRINT(("?" __FUNCTION__ ": unable to commit %u bytes?\n", (UINT) Commit));
+            return NULL;
+        }
+        for (Offset = Arena->Committed; Offset < Commit; Offset += SystemInfo.dwPageSize)
+            Arena->Base[Offset] = 0;
+        Arena->Committed = Commit;
+    }
+    LJB_VMON_PixelMainLockFrameArena(dev_ctx);
+
+    DBG_PRINT((__FUNCTION__
+        ": frame arena(%p) at %u of %u bytes%s, for Width=%u, Height=%u\n",
+        Arena->Base,
+        (UINT) Arena->Committed,
+        (UINT) Arena->Reserved,
+        Arena->LargePages ? " on large pages" : "",
+        dev_ctx->TargetModeData.Width,
+        dev_ctx->TargetModeData.Height));
+    return Arena->Base;
+}
+
+/*
+ * Nobody has seen the monitor for the idle delay: stop blitting, and free
+ * the frame arena, the shadow frame of the motion search and what the
+ * sinks can rebuild. The tile hashes of the last frame reported stay, so
+ * that the first frame after this carries only what changed meanwhile.
+ */
+static VOID
+LJB_VMON_PixelMainEnterIdle(
+    __in LJB_VMON_DEV_CTX *    dev_ctx,
+    __inout PVOID *            FrameBuffer
+    )
+{
+    DBG_PRINT((__FUNCTION__ ": visible(%u) powered(%u) mode(%u, %u), parking capture\n",
+        dev_ctx->VisibilityData.Visible,
+        dev_ctx->Powered,
+        dev_ctx->TargetModeData.Width,
+        dev_ctx->TargetModeData.Height
+        ));
+    *FrameBuffer = NULL;
+    LJB_VMON_PixelMainReleaseFrameArena(dev_ctx);
+    LJB_VMON_MotionDeInit(&dev_ctx->MotionDetector);
+    LJB_VMON_MotionInit(&dev_ctx->MotionDetector);
+    LJB_VMON_SinkListIdle(&dev_ctx->Sinks);
+    dev_ctx->Idle = TRUE;
+}
+
+/*
+ * Take on a new mode: a frame buffer of its size from the frame arena
+ * unless idle, tile hashes and a shadow frame that match nothing, and tell
+ * the sinks. A source gone to 0x0 leaves the arena as it is for the next
+ * mode. FALSE if out of memory.
+ */
+static BOOLEAN
+LJB_VMON_PixelMainSetMode(
+    __in LJB_VMON_DEV_CTX *         dev_ctx,
+    __inout PVOID *                 FrameBuffer,
+    __in CONST TARGET_MODE_DATA *   TargetModeData
+    )
+{
+    if (dev_ctx->TargetModeData.Width != TargetModeData->Width ||
+        dev_ctx->TargetModeData.Height != TargetModeData->Height)
+    {
+        *FrameBuffer = NULL;
+
+        /*
+         * while idle, the frame buffer waits for the monitor to be seen
+         * again
+         */
+        dev_ctx->TargetModeData = *TargetModeData;
+        if (dev_ctx->TargetModeData.Width != 0 &&
+            dev_ctx->TargetModeData.Height != 0 &&
+            !dev_ctx->Idle)
+        {
+            *FrameBuffer = LJB_VMON_PixelMainGetFrameBuffer(dev_ctx);
+            if (*FrameBuffer == NULL)
+                return FALSE;
+        }
+    }
+    LJB_VMON_DamageTrackerInvalidate(&dev_ctx->DamageTracker);
+    LJB_VMON_MotionInvalidate(&dev_ctx->MotionDetector);
+    LJB_VMON_SinkListModeChange(&dev_ctx->Sinks, &dev_ctx->TargetModeData);
+    return TRUE;
+}
+
+/*
+ * TRUE once the VMON thread is to leave: exit_vmon_thread, or the stop
+ * event of vmon.exe /service.
+ */
+static BOOLEAN
+LJB_VMON_PixelMainStopping(
+    __in LJB_VMON_DEV_CTX *         dev_ctx
+    )
+{
+    HANDLE CONST    hStopEvent = dev_ctx->pDeviceInfo->hStopEvent;
+
+    if (dev_ctx->exit_vmon_thread)
+        return TRUE;
+    return hStopEvent != NULL && WaitForSingleObject(hStopEvent, 0) == WAIT_OBJECT_0;
+}
+
+/*
+ * The device went away. Give it the reattach window to come back, as it
+ * does when its hub or bus glitches; the mode, the frame, the tile hashes
+ * and the sinks stay as they are meanwhile. Back, it gets the same EDID
+ * and the frame arena locked down again, as the lock went with the handle,
+ * and its events bring the VMON thread up to date. A trace ends with the
+ * device it was taken from.
+ */
+static BOOLEAN
+LJB_VMON_PixelMainReattach(
+    __in LJB_VMON_DEV_CTX *         dev_ctx,
+    __in_bcount(EdidSize) CONST UCHAR * Edid,
+    __in UINT                       EdidSize
+    )
+{
+    DWORD CONST     Start = GetTickCount();
+    ULONG           bytes_returned;
+
+    LJB_VMON_TracerDeInit(&dev_ctx->Tracer);
+    LJB_VMON_CloseDeviceHandle(dev_ctx);
+    dev_ctx->FrameArena.Locked = 0;
+    while (!LJB_VMON_PixelMainStopping(dev_ctx) &&
+           GetTickCount() - Start < LJB_VMON_REATTACH_WINDOW)
+    {
+        Sleep(LJB_VMON_REATTACH_INTERVAL);
+        if (!LJB_VMON_GetDeviceHandle(dev_ctx))
+            continue;
+        if (DeviceIoControl(
+                dev_ctx->hDevice,
+                IOCTL_LJB_VMON_PLUGIN_MONITOR,
+                (PVOID) Edid,
+                EdidSize,
+                NULL,
+                0,
+                &bytes_returned,
+                NULL
+                ))
+        {
+            DBG_PRINT((__FUNCTION__ ": device back after %u ms\n",
+                GetTickCount() - Start));
+            LJB_VMON_PixelMainLockFrameArena(dev_ctx);
+            return TRUE;
+        }
+        LJB_VMON_CloseDeviceHandle(dev_ctx);
+    }
+    DBG_PRINT(("?" __FUNCTION__ ": device did not come back\n"));
+    return FALSE;
+}
+
+/*
+ * What is left of Delay milliseconds from tick Since on.
+ */
+static DWORD
+LJB_VMON_PixelMainTimeLeft(
+    __in DWORD      Since,
+    __in DWORD      Delay
+    )
+{
+    DWORD CONST Elapsed = GetTickCount() - Since;
+
+    return (Elapsed < Delay) ? Delay - Elapsed : 0;
 }
 
 /*
@@ -392,7 +926,6 @@ LJB_VMON_PixelMain(
     __in LJB_VMON_DEV_CTX *    dev_ctx
     )
 {
-    HANDLE CONST                    hDefaultHeap = GetProcessHeap();
     HMODULE CONST                   hNtDll = LoadLibrary("ntdll.dll");
     LJB_VMON_MONITOR_EVENT          MonitorEvent;
     BOOL                            io_ret;
@@ -402,12 +935,31 @@ LJB_VMON_PixelMain(
     PDEVICE_INFO                    pDeviceInfo;
     PVOID                           FrameBuffer;
     UINT                            OutputFrameId;
-    UCHAR                           MyEDID[128];
+    UCHAR                           MyEDID[LJB_VMON_EDID_MAX_SIZE];
+    UINT                            EdidSize;
     ULONG                           bytes_returned;
     BOOLEAN                         PointerPositionChanged;
-
-    RtlCopyMemory(MyEDID, EdidTemplate, 128);
-    SetEdid(MyEDID);
+    OVERLAPPED                      WaitOverlapped;
+    HANDLE                          WaitEvents[2 + LJB_VMON_MAX_SINKS];
+    UINT                            NumCreditEvents;
+    UINT                            NumWaitEvents;
+    DWORD                           WaitResult;
+    BOOLEAN                         WaitPending;
+    BOOLEAN                         BltPending;
+    BOOLEAN                         IdleArmed;
+    DWORD                           UnseenSince;
+    DWORD                           Timeout;
+    BOOLEAN                         ModeHeld;
+    TARGET_MODE_DATA                HeldModeData;
+    DWORD                           HeldSince;
+    BOOLEAN                         ReattachArmed;
+    DWORD                           ReattachSince;
+    LJB_VMON_EDID_LINK              Link;
+    LJB_VMON_EDID_MODE              Modes[LJB_VMON_EDID_MAX_MODES];
+    UINT                            NumModes;
+    LJB_VMON_EDID_MODE              Advertised[LJB_VMON_EDID_MAX_PARSED_MODES];
+    UINT                            NumAdvertised;
+    UINT                            i;
 
     pDeviceInfo = dev_ctx->pDeviceInfo;
     if (hNtDll == NULL)
@@ -423,6 +975,7 @@ LJB_VMON_PixelMain(
     if (RtlNtStatusToDosErrorFn == NULL)
     {
         DBG_PRINT(("?" __FUNCTION__ ": No RtlNtStatusToDosError?\n"));
+        (VOID) FreeLibrary(hNtDll);
         return;
     }
 
@@ -430,13 +983,55 @@ LJB_VMON_PixelMain(
     if (ret == FALSE)
     {
         DBG_PRINT(("?" __FUNCTION__ ": LJB_VMON_PixelMain_Init failed.\n"));
+        (VOID) FreeLibrary(hNtDll);
         LJB_VMON_PixelMain_DeInit(dev_ctx);
         return;
     }
 
+    /*
+     * offer only the modes the slowest link keeps up with
+     */
+    LJB_VMON_PixelMainGetLink(dev_ctx, &Link);
+    NumModes = LJB_VMON_EdidSelectModes(&Link, Modes, LJB_VMON_EDID_MAX_MODES);
+    DBG_PRINT((__FUNCTION__ ": preferred mode %ux%u@%u, %u modes\n",
+        Modes[0].Width, Modes[0].Height, Modes[0].Refresh, NumModes));
+    EdidSize = LJB_VMON_EdidBuild(Modes, NumModes, MyEDID, sizeof(MyEDID));
+    DUMP_BUF(MyEDID, EdidSize);
+
+    /*
+     * read it back the way the OS will, and say which modes did not make it
+     */
+    if (!LJB_VMON_EdidParse(MyEDID, EdidSize, Advertised, LJB_VMON_EDID_MAX_PARSED_MODES, &NumAdvertised))
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": EDID generated is not valid?\n"));
+        (VOID) FreeLibrary(hNtDll);
+        LJB_VMON_PixelMain_DeInit(dev_ctx);
+        return;
+    }
+    for (i = 0; i < NumModes; i++)
+    {
+        if (!LJB_VMON_EdidFindMode(Advertised, NumAdvertised, &Modes[i]))
+            DBG_PRINT((__FUNCTION__ ": %ux%u@%u has no room in the EDID\n",
+                Modes[i].Width, Modes[i].Height, Modes[i].Refresh));
+    }
+
+    /*
+     * the frame arena reserves for the largest mode offered, and uses large
+     * pages where it may
+     */
+    RtlZeroMemory(&dev_ctx->FrameArena, sizeof(dev_ctx->FrameArena));
+    for (i = 0; i < NumModes; i++)
+    {
+        if ((SIZE_T) Modes[i].Width * Modes[i].Height * 4 > dev_ctx->FrameArena.MaxModeSize)
+            dev_ctx->FrameArena.MaxModeSize = (SIZE_T) Modes[i].Width * Modes[i].Height * 4;
+    }
+    dev_ctx->FrameArena.LargePageSize = LJB_VMON_PixelMainEnableLargePages();
+
     RtlZeroMemory(&dev_ctx->TargetModeData, sizeof(TARGET_MODE_DATA));
     RtlZeroMemory(&dev_ctx->VisibilityData, sizeof(VIDPN_SOURCE_VISIBILITY_DATA));
     RtlZeroMemory(&dev_ctx->PointerPositionData, sizeof(POINTER_POSITION_DATA));
+    dev_ctx->Powered = TRUE;
+    dev_ctx->Idle = FALSE;
     OutputFrameId = 0;
     FrameBuffer = NULL;
 
@@ -444,7 +1039,7 @@ LJB_VMON_PixelMain(
         dev_ctx->hDevice,
         IOCTL_LJB_VMON_PLUGIN_MONITOR,
         MyEDID,
-        sizeof(MyEDID),
+        EdidSize,
         NULL,
         0,
         &bytes_returned,
@@ -453,39 +1048,160 @@ LJB_VMON_PixelMain(
     if (!io_ret)
     {
         DBG_PRINT((__FUNCTION__": IOCTL_LJB_VMON_PLUGIN_MONITOR failed\n"));
+        (VOID) FreeLibrary(hNtDll);
+        LJB_VMON_PixelMain_DeInit(dev_ctx);
         return;
     }
 
-    ExitLoop = FALSE;
+    /*
+     * the wait for a monitor event is overlapped, so that while a frame is
+     * held back for credit the loop can wake up for either.
+     */
+    RtlZeroMemory(&WaitOverlapped, sizeof(WaitOverlapped));
+    WaitOverlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (WaitOverlapped.hEvent == NULL)
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": unable to create the wait event?\n"));
+        ExitLoop = TRUE;
+    }
+    else
+        ExitLoop = FALSE;
+    WaitPending = FALSE;
+    BltPending = FALSE;
+    IdleArmed = FALSE;
+    UnseenSince = 0;
+    ModeHeld = FALSE;
+    HeldSince = 0;
+    ReattachArmed = FALSE;
+    ReattachSince = 0;
     while (!ExitLoop)
     {
         LJB_VMON_WAIT_FLAGS         OutputFlags;
-        BOOLEAN                     NeedUpdateImage;
 
-        if (dev_ctx->exit_vmon_thread)
+        if (LJB_VMON_PixelMainStopping(dev_ctx))
             break;
 
         PointerPositionChanged = 0;
-        MonitorEvent.Flags.ModeChange = 1;
-        MonitorEvent.Flags.VidPnSourceVisibilityChange = 1;
-        MonitorEvent.Flags.VidPnSourceBitmapChange = 1;
-        MonitorEvent.Flags.PointerPositionChange = 1;
-        MonitorEvent.Flags.PointerShapeChange = 1;
-        MonitorEvent.TargetModeData = dev_ctx->TargetModeData;
-        MonitorEvent.VidPnSourceVisibilityData = dev_ctx->VisibilityData;
-        MonitorEvent.FrameId = OutputFrameId;
-        MonitorEvent.PointerPositionData = dev_ctx->PointerPositionData;
-
-        io_ret = DeviceIoControl(
-            dev_ctx->hDevice,
-            IOCTL_LJB_VMON_WAIT_FOR_MONITOR_EVENT,
-            &MonitorEvent,
-            sizeof(MonitorEvent),
-            &MonitorEvent,
-            sizeof(MonitorEvent),
-            &bytes_returned,
-            NULL
-            );
+
+        /*
+         * a wait left pending for credit or the idle delay is picked up
+         * where it was. While idle, only what can make the monitor seen
+         * again wakes the thread; frames and the cursor are picked up once
+         * it is.
+         */
+        if (!WaitPending)
+        {
+            MonitorEvent.Flags.Value = 0;
+            MonitorEvent.Flags.ModeChange = 1;
+            MonitorEvent.Flags.VidPnSourceVisibilityChange = 1;
+            MonitorEvent.Flags.PowerChange = 1;
+            if (!dev_ctx->Idle)
+            {
+                MonitorEvent.Flags.VidPnSourceBitmapChange = 1;
+                MonitorEvent.Flags.PointerPositionChange = 1;
+                MonitorEvent.Flags.PointerShapeChange = 1;
+            }
+            MonitorEvent.TargetModeData = ModeHeld ? HeldModeData : dev_ctx->TargetModeData;
+            MonitorEvent.VidPnSourceVisibilityData = dev_ctx->VisibilityData;
+            MonitorEvent.FrameId = OutputFrameId;
+            MonitorEvent.PointerPositionData = dev_ctx->PointerPositionData;
+            MonitorEvent.Powered = dev_ctx->Powered;
+
+            io_ret = DeviceIoControl(
+                dev_ctx->hDevice,
+                IOCTL_LJB_VMON_WAIT_FOR_MONITOR_EVENT,
+                &MonitorEvent,
+                sizeof(MonitorEvent),
+                &MonitorEvent,
+                sizeof(MonitorEvent),
+                &bytes_returned,
+                &WaitOverlapped
+                );
+            WaitPending = io_ret || GetLastError() == ERROR_IO_PENDING;
+        }
+
+        /*
+         * with a stop event, the wait never blocks without it, so that the
+         * wait pending in the driver is cancelled on the way out
+         */
+        if (WaitPending &&
+            (BltPending || IdleArmed || ModeHeld || LJB_VMON_SinkListIsBehind(&dev_ctx->Sinks) ||
+             pDeviceInfo->hStopEvent != NULL))
+        {
+            Timeout = INFINITE;
+            if (IdleArmed)
+                Timeout = LJB_VMON_PixelMainTimeLeft(UnseenSince, pDeviceInfo->IdleDelay);
+            if (ModeHeld &&
+                LJB_VMON_PixelMainTimeLeft(HeldSince, LJB_VMON_REATTACH_WINDOW) < Timeout)
+                Timeout = LJB_VMON_PixelMainTimeLeft(HeldSince, LJB_VMON_REATTACH_WINDOW);
+            WaitEvents[0] = WaitOverlapped.hEvent;
+            NumCreditEvents = LJB_VMON_SinkListGetCreditEvents(
+                &dev_ctx->Sinks,
+                &WaitEvents[1]
+                );
+            NumWaitEvents = 1 + NumCreditEvents;
+            if (pDeviceInfo->hStopEvent != NULL)
+                WaitEvents[NumWaitEvents++] = pDeviceInfo->hStopEvent;
+            WaitResult = WaitForMultipleObjects(
+                NumWaitEvents,
+                WaitEvents,
+                FALSE,
+                Timeout
+                );
+            if (pDeviceInfo->hStopEvent != NULL &&
+                WaitResult == WAIT_OBJECT_0 + 1 + NumCreditEvents)
+                break;
+            if (WaitResult == WAIT_TIMEOUT)
+            {
+                /*
+                 * a mode held over a reattach that did not come back is
+                 * the source gone after all. Still not seen, capture
+                 * parks. Either way the wait stays pending, and completes
+                 * as the monitor may be seen again.
+                 */
+                if (ModeHeld &&
+                    LJB_VMON_PixelMainTimeLeft(HeldSince, LJB_VMON_REATTACH_WINDOW) == 0)
+                {
+                    ModeHeld = FALSE;
+                    ReattachArmed = FALSE;
+                    if (!LJB_VMON_PixelMainSetMode(dev_ctx, &FrameBuffer, &HeldModeData))
+                        break;
+                }
+                if (IdleArmed &&
+                    LJB_VMON_PixelMainTimeLeft(UnseenSince, pDeviceInfo->IdleDelay) == 0)
+                {
+                    IdleArmed = FALSE;
+                    BltPending = FALSE;
+                    LJB_VMON_PixelMainEnterIdle(dev_ctx, &FrameBuffer);
+                }
+                continue;
+            }
+            if (WaitResult != WAIT_OBJECT_0)
+            {
+                /*
+                 * credit came back, or may have; the wait stays pending. A
+                 * sink that missed frames gets the last one reported, with
+                 * what it missed, if the blit reports nothing new.
+                 */
+                if (BltPending && LJB_VMON_SinkListHasCredit(&dev_ctx->Sinks))
+                {
+                    BltPending = FALSE;
+                    LJB_VMON_PixelMainBlt(dev_ctx, FrameBuffer, OutputFrameId);
+                }
+                LJB_VMON_SinkListCatchUp(&dev_ctx->Sinks);
+                continue;
+            }
+        }
+        if (WaitPending)
+        {
+            io_ret = GetOverlappedResult(
+                dev_ctx->hDevice,
+                &WaitOverlapped,
+                &bytes_returned,
+                TRUE
+                );
+            WaitPending = FALSE;
+        }
 
         /*
          * ioctl returns failure. it could be device removed
@@ -501,7 +1217,11 @@ LJB_VMON_PixelMain(
                     "IOCTL_LJB_VMON_WAIT_FOR_MONITOR_EVENT failed. "
                     "Device unplugged, LastError(0x%x)\n",
                     LastError));
-                break;
+                if (!LJB_VMON_PixelMainReattach(dev_ctx, MyEDID, EdidSize))
+                    break;
+                ReattachArmed = TRUE;
+                ReattachSince = GetTickCount();
+                continue;
             }
 
             /*
@@ -520,8 +1240,6 @@ LJB_VMON_PixelMain(
         OutputFlags = MonitorEvent.Flags;
         if (OutputFlags.ModeChange)
         {
-            BOOLEAN ResolutionChanged = FALSE;
-
             DBG_PRINT((__FUNCTION__
                 ": ModeChange, previous mode(%u, %u), new mode(%u, %u)\n",
                 dev_ctx->TargetModeData.Width,
@@ -531,74 +1249,48 @@ LJB_VMON_PixelMain(
                 ));
 
             /*
-             * check if resolution change
+             * soon after the device came back or changed power state, a
+             * source gone to 0x0 is likely on its way back: hold on to the
+             * mode, the frame and the tile hashes for the reattach window,
+             * and tell the sinks nothing. If it comes back as it was, the
+             * next frame is a delta; if not, the sinks hear of it then.
              */
-            if (dev_ctx->TargetModeData.Width != MonitorEvent.TargetModeData.Width ||
-                dev_ctx->TargetModeData.Height != MonitorEvent.TargetModeData.Height)
-                ResolutionChanged = TRUE;
-
-            if (ResolutionChanged)
+            if (!ModeHeld &&
+                ReattachArmed &&
+                LJB_VMON_PixelMainTimeLeft(ReattachSince, LJB_VMON_REATTACH_WINDOW) != 0 &&
+                (MonitorEvent.TargetModeData.Width == 0 ||
+                 MonitorEvent.TargetModeData.Height == 0) &&
+                dev_ctx->TargetModeData.Width != 0 &&
+                dev_ctx->TargetModeData.Height != 0)
             {
-                LOCK_BUFFER_DATA    LockBufferData;
-
-                if (FrameBuffer != NULL)
-                {
-                    RtlZeroMemory(&LockBufferData, sizeof(LockBufferData));
-                    LockBufferData.FrameBuffer = (UINT64)((ULONG_PTR) FrameBuffer);
-                    LockBufferData.FrameBufferSize =
-                        dev_ctx->TargetModeData.Width *
-                        dev_ctx->TargetModeData.Height * 4;
-                    DeviceIoControl(
-                        dev_ctx->hDevice,
-                        IOCTL_LJB_VMON_UNLOCK_BUFFER,
-                        &LockBufferData,
-                        sizeof(LockBufferData),
-                        NULL,
-                        0,
-                        &bytes_returned,
-                        NULL
-                        );
-                    HeapFree(hDefaultHeap, 0, FrameBuffer);
-                    FrameBuffer = NULL;
-                }
-
+                DBG_PRINT((__FUNCTION__ ": holding mode(%u, %u) over the reattach\n",
+                    dev_ctx->TargetModeData.Width,
+                    dev_ctx->TargetModeData.Height
+                    ));
+                ModeHeld = TRUE;
+                HeldModeData = MonitorEvent.TargetModeData;
+                HeldSince = GetTickCount();
+                BltPending = FALSE;
+            }
+            else if (ModeHeld &&
+                MonitorEvent.TargetModeData.Width == dev_ctx->TargetModeData.Width &&
+                MonitorEvent.TargetModeData.Height == dev_ctx->TargetModeData.Height &&
+                MonitorEvent.TargetModeData.Rotation == dev_ctx->TargetModeData.Rotation)
+            {
+                DBG_PRINT((__FUNCTION__ ": mode back as it was, %u ms\n",
+                    GetTickCount() - HeldSince));
+                ModeHeld = FALSE;
+                ReattachArmed = FALSE;
                 dev_ctx->TargetModeData = MonitorEvent.TargetModeData;
-                if (dev_ctx->TargetModeData.Width != 0 &&
-                    dev_ctx->TargetModeData.Height != 0)
-                {
-                    FrameBuffer = HeapAlloc(hDefaultHeap, HEAP_ZERO_MEMORY,
-                        dev_ctx->TargetModeData.Width *
-                        dev_ctx->TargetModeData.Height * 4);
-                    if (FrameBuffer == NULL)
-                    {
-                        DBG_PRINT((__FUNCTION__
-                            ": no FrameBuffer allocated for Width=%u, Height=%u?\n",
-                            dev_ctx->TargetModeData.Width,
-                            dev_ctx->TargetModeData.Height));
-                        break;
-                    }
-                    DBG_PRINT((__FUNCTION__
-                        ": FrameBuffer(%p) allocated for Width=%u, Height=%u\n",
-                        FrameBuffer,
-                        dev_ctx->TargetModeData.Width,
-                        dev_ctx->TargetModeData.Height));
-
-                    RtlZeroMemory(&LockBufferData, sizeof(LockBufferData));
-                    LockBufferData.FrameBuffer = (UINT64)((ULONG_PTR) FrameBuffer);
-                    LockBufferData.FrameBufferSize =
-                        dev_ctx->TargetModeData.Width *
-                        dev_ctx->TargetModeData.Height * 4;
-                    DeviceIoControl(
-                        dev_ctx->hDevice,
-                        IOCTL_LJB_VMON_LOCK_BUFFER,
-                        &LockBufferData,
-                        sizeof(LockBufferData),
-                        NULL,
-                        0,
-                        &bytes_returned,
-                        NULL
-                        );
-                }
+            }
+            else
+            {
+                ModeHeld = FALSE;
+                if (MonitorEvent.TargetModeData.Width != 0 &&
+                    MonitorEvent.TargetModeData.Height != 0)
+                    ReattachArmed = FALSE;
+                if (!LJB_VMON_PixelMainSetMode(dev_ctx, &FrameBuffer, &MonitorEvent.TargetModeData))
+                    break;
             }
         }
         if (OutputFlags.VidPnSourceVisibilityChange)
@@ -612,38 +1304,31 @@ LJB_VMON_PixelMain(
 
         if (OutputFlags.VidPnSourceBitmapChange)
         {
-            BLT_DATA    BltData;
-
             //DBG_PRINT((__FUNCTION__": Bitmap Changed, FrameId(%u => %u)\n",
             //    OutputFrameId,
             //    MonitorEvent.FrameId
             //    ));
             OutputFrameId = MonitorEvent.FrameId;
-            dev_ctx->FrameBufferIsDirty = FALSE;
 
             /*
-             * acquire bitmap from kmd
+             * sinks behind a slow link may have no room for the frame. If
+             * some sink has, those that have not miss it and the sink list
+             * keeps what they missed. If none has, it is blitted once one
+             * has, with whatever the screen shows by that time; the damage
+             * tracker compares against the last frame reported, so that one
+             * update carries every change in between. An invisible source
+             * reports nothing and never waits, and while idle nothing is
+             * blitted at all, nor while a mode is held over a reattach.
              */
-            if (FrameBuffer != NULL)
+            if (dev_ctx->Idle || ModeHeld)
+                BltPending = FALSE;
+            else if (dev_ctx->VisibilityData.Visible &&
+                !LJB_VMON_SinkListHasCredit(&dev_ctx->Sinks))
+                BltPending = TRUE;
+            else
             {
-                RtlZeroMemory(&BltData, sizeof(BltData));
-                BltData.Width           = dev_ctx->TargetModeData.Width;
-                BltData.Height          = dev_ctx->TargetModeData.Height;
-                BltData.FrameId         = OutputFrameId;
-                BltData.FrameBufferSize = dev_ctx->TargetModeData.Width *
-                                          dev_ctx->TargetModeData.Height * 4;
-                BltData.FrameBuffer     = (UINT64)((ULONG_PTR) FrameBuffer);
-
-                DeviceIoControl(
-                    dev_ctx->hDevice,
-                    IOCTL_LJB_VMON_BLT_BITMAP,
-                    &BltData,
-                    sizeof(BltData),
-                    &BltData,
-                    sizeof(BltData),
-                    &bytes_returned,
-                    NULL
-                    );
+                BltPending = FALSE;
+                LJB_VMON_PixelMainBlt(dev_ctx, FrameBuffer, OutputFrameId);
             }
         }
 
@@ -664,6 +1349,13 @@ LJB_VMON_PixelMain(
                 (dev_ctx->PointerPositionData.Visible != MonitorEvent.PointerPositionData.Visible);
 
             dev_ctx->PointerPositionData = MonitorEvent.PointerPositionData;
+            if (PointerPositionChanged)
+            {
+                LJB_VMON_SinkListCursorPosition(
+                    &dev_ctx->Sinks,
+                    &dev_ctx->PointerPositionData
+                    );
+            }
         }
 
         if (OutputFlags.PointerShapeChange)
@@ -679,56 +1371,68 @@ LJB_VMON_PixelMain(
                 &bytes_returned,
                 NULL
                 );
+            LJB_VMON_SinkListCursorShape(
+                &dev_ctx->Sinks,
+                &dev_ctx->PointerShapeData
+                );
+        }
+
+        if (OutputFlags.PowerChange)
+        {
+            DBG_PRINT((__FUNCTION__": PowerChange (%u => %u)\n",
+                dev_ctx->Powered,
+                MonitorEvent.Powered
+                ));
+            dev_ctx->Powered = MonitorEvent.Powered;
+            ReattachArmed = TRUE;
+            ReattachSince = GetTickCount();
         }
 
         /*
-         * now update the final image. If the monitor is set to invisible,
-         * don't update
+         * a monitor nobody sees, invisible, disabled or powered down, parks
+         * capture once it has been so for the idle delay. Seen again, it
+         * comes back at once with what changed on it meanwhile.
          */
-        NeedUpdateImage = FALSE;
-        if (OutputFlags.VidPnSourceBitmapChange ||
-            (OutputFlags.PointerShapeChange && dev_ctx->PointerPositionData.Visible) ||
-            PointerPositionChanged)
-            NeedUpdateImage = TRUE;
-
-        if (FrameBuffer != NULL &&
-            dev_ctx->VisibilityData.Visible &&
-            NeedUpdateImage)
+        if (dev_ctx->VisibilityData.Visible &&
+            dev_ctx->Powered &&
+            !ModeHeld &&
+            dev_ctx->TargetModeData.Width != 0 &&
+            dev_ctx->TargetModeData.Height != 0)
         {
-            /*
-             * overlay cursor image to the final image. Recover previous image first.
-             */
-            if (dev_ctx->FrameBufferIsDirty)
-            {
-                LJB_VMON_RestoreFrameBuffer(
-                    dev_ctx,
-                    &dev_ctx->TargetModeData,
-                    FrameBuffer
-                    );
-            }
-
-            if (dev_ctx->PointerPositionData.Visible)
+            IdleArmed = FALSE;
+            if (dev_ctx->Idle)
             {
-                LJB_VMON_DrawCursorOnFrameBuffer(
-                    dev_ctx,
-                    &dev_ctx->TargetModeData,
-                    &dev_ctx->VisibilityData,
-                    &dev_ctx->PointerPositionData,
-                    &dev_ctx->PointerShapeData,
-                    FrameBuffer
-                    );
+                DBG_PRINT((__FUNCTION__": monitor seen again, resuming capture\n"));
+                dev_ctx->Idle = FALSE;
+                FrameBuffer = LJB_VMON_PixelMainGetFrameBuffer(dev_ctx);
+                if (FrameBuffer == NULL)
+                    break;
+                if (LJB_VMON_SinkListHasCredit(&dev_ctx->Sinks))
+                    LJB_VMON_PixelMainBlt(dev_ctx, FrameBuffer, OutputFrameId);
+                else
+                    BltPending = TRUE;
             }
-
-            pDeviceInfo->BitmapBuffer   = FrameBuffer;
-            pDeviceInfo->Width          = dev_ctx->TargetModeData.Width;
-            pDeviceInfo->Height         = dev_ctx->TargetModeData.Height;
-            pDeviceInfo->dev_ctx        = dev_ctx;
-
-            //output now.
-            SendMessage(pDeviceInfo->hParentWnd, WM_PAINT, LPARAM_NOTIFY_FRAME_UPDATE, 0);
+        }
+        else if (!dev_ctx->Idle && !IdleArmed)
+        {
+            IdleArmed = TRUE;
+            UnseenSince = GetTickCount();
         }
     } /* end of while */
 
+    /*
+     * the driver completes a wait it has queued on the next event, or as
+     * the device goes; MonitorEvent must outlive it.
+     */
+    if (WaitPending)
+    {
+        CancelIo(dev_ctx->hDevice);
+        GetOverlappedResult(dev_ctx->hDevice, &WaitOverlapped, &bytes_returned, TRUE);
+    }
+    if (WaitOverlapped.hEvent != NULL)
+        CloseHandle(WaitOverlapped.hEvent);
+    LJB_VMON_PixelMainReleaseFrameArena(dev_ctx);
+
     DeviceIoControl(
         dev_ctx->hDevice,
         IOCTL_LJB_VMON_UNPLUG_MONITOR,
@@ -744,655 +1448,3 @@ LJB_VMON_PixelMain(
     LJB_VMON_PixelMain_DeInit(dev_ctx);
     DBG_PRINT(("-" __FUNCTION__": leaving.\n"));
 }
-
-#define EDID_RATIO_16_10            0
-#define EDID_RATIO_4_3              1
-#define EDID_RATIO_5_4              2
-#define EDID_RATIO_16_9             3
-
-BOOLEAN CONST  Enable_640_480   = TRUE;
-BOOLEAN CONST  Enable_800_600   = TRUE;
-BOOLEAN CONST  Enable_1024_768  = TRUE;
-BOOLEAN CONST  Enable_1280_960  = TRUE;
-BOOLEAN CONST  Enable_1280_1024 = TRUE;
-BOOLEAN CONST  Enable_1400_1050 = TRUE;
-BOOLEAN CONST  Enable_1440_900  = TRUE;
-BOOLEAN CONST  Enable_1600_900  = TRUE;
-BOOLEAN CONST  Enable_1680_1050 = TRUE;
-BOOLEAN CONST  Enable_1920_1080 = TRUE;
-BOOLEAN CONST  Enable_1920_1200 = TRUE;
-
-typedef struct _DETAILED_TIMING_MODE
-{
-    UINT    Width;
-    UINT    Height;
-}   DETAILED_TIMING_MODE;
-
-DETAILED_TIMING_MODE    DetailedTimingTable[] =
-{
-    {2048, 1152},
-};
-#define NUM_OF_DETAILED_TIMING  (sizeof(DetailedTimingTable)/sizeof(DETAILED_TIMING_MODE))
-
-static VOID
-SetDetailTimingDesc(
-    __out UCHAR MyEDID[128],
-    __in  UINT  Index,
-    __in  UINT  Width,
-    __in  UINT  Height
-    )
-{
-    UINT CONST HBlank = Width / 16;
-    UINT CONST VBlank = Height / 32;
-    UINT CONST PixelClock = (Width + HBlank) * (Height + VBlank) * 60;
-    UINT CONST EdidIndex = 54 + Index * 18;
-    UINT CONST HSyncOffset = HBlank / 4;
-    UINT CONST HSyncPulse = HBlank / 4;
-    UINT CONST VSyncOffset = VBlank / 4;
-    UINT CONST VSyncPulse = VBlank / 4;
-    UINT CONST HDisplayMm = 510;        // hardcoded common monitor size
-    UINT CONST VDisplayMm = 287;        // hardcoded common monitor size
-
-    MyEDID[EdidIndex + 0]   = (PixelClock / 10000) & 0xFF;
-    MyEDID[EdidIndex + 1]   = ((PixelClock / 10000) >> 8) & 0xFF;
-    MyEDID[EdidIndex + 2]   = Width & 0xFF;   // Horizontal Active pixels
-    MyEDID[EdidIndex + 3]   = HBlank & 0xFF;  // Horizontal Blanking pixels
-    MyEDID[EdidIndex + 4]   = ((Width >> 8) & 0x0F) << 4 | (HBlank >> 8) & 0x0F;
-    MyEDID[EdidIndex + 5]   = Height & 0xFF;  // Vertical Active Lines
-    MyEDID[EdidIndex + 6]   = VBlank & 0xFF;  // Vertical blanking Lines
-    MyEDID[EdidIndex + 7]   = ((Height >> 8) & 0x0F) << 4 | (VBlank >> 8) & 0x0F;
-    MyEDID[EdidIndex + 8]   = HSyncOffset & 0xFF;   // Horizontal sync offset
-    MyEDID[EdidIndex + 9]   = HSyncPulse & 0xFF;   // HSyncOffset Pulse
-    MyEDID[EdidIndex + 10]  = ((VSyncOffset & 0x0F) << 4) | (VSyncPulse & 0x0F);
-    MyEDID[EdidIndex + 11]  = ((HSyncOffset >> 8) & 0x03) << 6 |
-                              ((HSyncPulse >> 8) & 0x03) << 4 |
-                              ((VSyncOffset >> 4) & 0x03) << 2 |
-                              ((VSyncPulse >> 4) & 0x03) << 0;
-    MyEDID[EdidIndex + 12]  = HDisplayMm & 0xFF;
-    MyEDID[EdidIndex + 13]  = VDisplayMm & 0xFF;
-    MyEDID[EdidIndex + 14]  = ((HDisplayMm >> 8) & 0x0F) << 4 |
-                              ((VDisplayMm >> 8) & 0x0F);
-    MyEDID[EdidIndex + 15]  = 0;        // horizontal border
-    MyEDID[EdidIndex + 16]  = 0;        // vertical border
-    MyEDID[EdidIndex + 17]  = 0x1A;
-}
-
-#define TO_PNP(c)   (c - 64)
-CONST UCHAR Mfg[3] = {
-    TO_PNP('L'),
-    TO_PNP('J'),
-    TO_PNP('B'),
-};
-static VOID
-SetEdid(
-    __out UCHAR MyEDID[128]
-    )
-{
-    UINT NumOfStdTiming;
-    UINT NumOfDetailedTiming;
-    UINT i;
-    UCHAR checksum;
-
-    // Copy EDID template to our MyEDID
-    //
-    NumOfStdTiming = 0;
-    NumOfDetailedTiming = 0;
-
-    MyEDID[8] = Mfg[0] << 2 | (Mfg[1] >> 3) & 3;
-    MyEDID[9] = (Mfg[1] & 0x07) << 5 | (Mfg[2] & 0x1F);
-    MyEDID[10] = 0x16;
-    MyEDID[11] = 0x20;
-
-    // Established timing bitmap. Supported bitmap for (formerly) very common timing modes.
-    // Byte 35 Bit 0    800X600 @ 60 Hz
-    //         Bit 5    640X480 @ 60 Hz
-    // Byte 36 Bit 3    1024X768 @ 60 Hz
-    //
-    MyEDID[35] = Enable_800_600 << 0 | Enable_640_480 << 5;
-    MyEDID[36] = Enable_1024_768 << 3;
-
-    // Byte 38-53, Standard timing information. Up to 8 2-byte fields describing standard display modes.
-    // Unused fields are filled with 01 01
-    // Byte 0 = X resolution, divided by 8, less 31 (256-2288 pixels, value 00 is reserved and should not be used)
-    // Byte 1 bits 7-6 = X:Y pixel ratio: 00=16:10; 01=4:3; 10=5:4; 11=16:9.
-    // Byte 1 bits 5-0 = Vertical frequency, less 60 (60-123 Hz)
-    // 1366x768 couldn't fit into standard timing information block. It goes to detailed timing descriptor.
-    //
-    if (Enable_1280_960)
-    {
-        //Ratio 4:3 @ 60Hz.
-        MyEDID[38 + NumOfStdTiming * 2] = (1280/8) - 31;
-        MyEDID[39 + NumOfStdTiming * 2] = (EDID_RATIO_4_3 << 6);
-        NumOfStdTiming++;
-        DBG_PRINT((__FUNCTION__ ":1280_960 enabled, NumOfStdTiming(%u)\n",
-            NumOfStdTiming));
-    }
-    if (Enable_1280_1024)
-    {
-        //Ratio 5:4 @ 60Hz.
-        MyEDID[38 + NumOfStdTiming * 2] = (1280/8) - 31;
-        MyEDID[39 + NumOfStdTiming * 2] = (EDID_RATIO_5_4 << 6);
-        NumOfStdTiming++;
-        DBG_PRINT((__FUNCTION__ ":1280_1024 enabled, NumOfStdTiming(%u)\n",
-            NumOfStdTiming));
-    }
-    if (Enable_1400_1050)
-    {
-        //Ratio 4:3 @ 60Hz.
-        MyEDID[38 + NumOfStdTiming * 2] = (1400/8) - 31;
-        MyEDID[39 + NumOfStdTiming * 2] = (EDID_RATIO_4_3 << 6);
-        NumOfStdTiming++;
-        DBG_PRINT((__FUNCTION__ ":1400_1050 enabled, NumOfStdTiming(%u)\n",
-            NumOfStdTiming));
-    }
-    if (Enable_1440_900)
-    {
-        //Ratio 16:10 @ 60Hz.
-        MyEDID[38 + NumOfStdTiming * 2] = (1440/8) - 31;
-        MyEDID[39 + NumOfStdTiming * 2] = (EDID_RATIO_16_10 << 6);
-        NumOfStdTiming++;
-        DBG_PRINT((__FUNCTION__ ":1440_900 enabled, NumOfStdTiming(%u)\n",
-            NumOfStdTiming));
-    }
-    if (Enable_1600_900)
-    {
-        //Ratio 16:9 @ 60Hz.
-        MyEDID[38 + NumOfStdTiming * 2] = (1600/8) - 31;
-        MyEDID[39 + NumOfStdTiming * 2] = (EDID_RATIO_16_9 << 6);
-        NumOfStdTiming++;
-        DBG_PRINT((__FUNCTION__ ":1600_900 enabled, NumOfStdTiming(%u)\n",
-            NumOfStdTiming));
-    }
-    if (Enable_1680_1050)
-    {
-        //Ratio 16:10 @ 60Hz.
-        MyEDID[38 + NumOfStdTiming * 2] = (1680/8) - 31;
-        MyEDID[39 + NumOfStdTiming * 2] = (EDID_RATIO_16_10 << 6);
-        NumOfStdTiming++;
-        DBG_PRINT((__FUNCTION__ ":1680_1050 enabled, NumOfStdTiming(%u)\n",
-            NumOfStdTiming));
-    }
-    if (Enable_1920_1080)
-    {
-        //Ratio 16:9 @ 60Hz.
-        MyEDID[38 + NumOfStdTiming * 2] = (1920/8) - 31;
-        MyEDID[39 + NumOfStdTiming * 2] = (EDID_RATIO_16_9 << 6);
-        NumOfStdTiming++;
-        DBG_PRINT((__FUNCTION__ ":1920_1080 enabled, NumOfStdTiming(%u)\n",
-            NumOfStdTiming));
-    }
-    if (Enable_1920_1200)
-    {
-        //Ratio 16:10 @ 60Hz.
-        MyEDID[38 + NumOfStdTiming * 2] = (1920/8) - 31;
-        MyEDID[39 + NumOfStdTiming * 2] = (EDID_RATIO_16_10 << 6);
-        NumOfStdTiming++;
-        DBG_PRINT((__FUNCTION__ ":1920_1200 enabled, NumOfStdTiming(%u)\n",
-            NumOfStdTiming));
-    }
-
-    while (NumOfStdTiming < 8)
-    {
-        MyEDID[38 + NumOfStdTiming * 2] = 1;
-        MyEDID[39 + NumOfStdTiming * 2] = 1;
-        DBG_PRINT((__FUNCTION__ ":StdTimingEntry[%u] unused\n", NumOfStdTiming));
-        NumOfStdTiming++;
-    }
-
-    // Update EDID Detailed Timing Descriptor
-    // 54-71 = Descriptor 1, 72-89 = Descriptor 2, 90-107 = Descriptor 3, 108-125 = Descriptor = 4
-    for (i = 0; i < NUM_OF_DETAILED_TIMING; i++)
-    {
-        SetDetailTimingDesc(
-            MyEDID,
-            i,
-            DetailedTimingTable[i].Width,
-            DetailedTimingTable[i].Height
-            );
-        NumOfDetailedTiming++;
-    }
-
-    // Monitor range limits (required)
-    // byte[0-1] = zero, indicating not a detailed timing descriptor
-    // byte[2] = 0.
-    // byte[3] = Descriptor type. 0xFD = Monitor Range Descriptor
-    // byte[4] = zero.
-    // byte[5] = Minimum vertical field rate (1-255 Hz)
-    // byte[6] = Maximum vertical field rate (1-255 Hz)
-    // byte[7] = Minimum horizontal line rate (1-255 kHz)
-    // byte[8] = Maximum horizontal line rate (1-255 kHz)
-    // byte[9] = Maximum pixel clock rate, rounded up to 10 MHz multiple (10-2550 MHz)
-    // byte[10]= Extended timing information type:
-    //           00: No information, padded with 0A 20 20 20 20 20 20.
-    //           02: Secondary GTF supported, parameters as follows.
-    // 00 01 02 03 04 05 06 07-08 09 0A 0B 0C 0D 0E 0F
-    // ===============================================
-    // 00 00 00 FD 00 38 4B 1F-53 0E 00 0A 20 20 20 20
-    // 20 20
-    MyEDID[54 + NumOfDetailedTiming*18 + 0] = 0;
-    MyEDID[54 + NumOfDetailedTiming*18 + 1] = 0;
-    MyEDID[54 + NumOfDetailedTiming*18 + 2] = 0;
-    MyEDID[54 + NumOfDetailedTiming*18 + 3] = 0xFD;
-    MyEDID[54 + NumOfDetailedTiming*18 + 4] = 0;
-    MyEDID[54 + NumOfDetailedTiming*18 + 5] = 56;       //56 Hz
-    MyEDID[54 + NumOfDetailedTiming*18 + 6] = 60;       //60 Hz
-    MyEDID[54 + NumOfDetailedTiming*18 + 7] = 30;       //30 KHz
-    MyEDID[54 + NumOfDetailedTiming*18 + 8] = 81;       //81 KHz
-    MyEDID[54 + NumOfDetailedTiming*18 + 9] = 160;      //Maximum Pixel Clock = 160MHz
-    MyEDID[54 + NumOfDetailedTiming*18 + 10]= 0x00;
-    MyEDID[54 + NumOfDetailedTiming*18 + 11]= 0x0A;
-    MyEDID[54 + NumOfDetailedTiming*18 + 12]= ' ';
-    MyEDID[54 + NumOfDetailedTiming*18 + 13]= ' ';
-    MyEDID[54 + NumOfDetailedTiming*18 + 14]= ' ';
-    MyEDID[54 + NumOfDetailedTiming*18 + 15]= ' ';
-    MyEDID[54 + NumOfDetailedTiming*18 + 16]= ' ';
-    MyEDID[54 + NumOfDetailedTiming*18 + 17]= ' ';
-    NumOfDetailedTiming++;
-    DBG_PRINT((__FUNCTION__
-        ":  Populate MonitorRangeLimits, NumOfDetailedTiming(%u)\n",
-        NumOfDetailedTiming));
-
-    // 0xFC: Monitor name (text), padded with 0A 20 20.
-    // Let's have "LuminonCore"
-    // 00 01 02 03 04 05 06 07-08 09 0A 0B 0C 0D 0E 0F
-    // ===============================================
-    // 00 00 00 FC 00 41 63 65-72 20 50 31 39 35 48 51
-    // 4C 0A
-    MyEDID[54 + NumOfDetailedTiming*18 + 0] = 0;
-    MyEDID[54 + NumOfDetailedTiming*18 + 1] = 0;
-    MyEDID[54 + NumOfDetailedTiming*18 + 2] = 0;
-    MyEDID[54 + NumOfDetailedTiming*18 + 3] = 0xFC;
-    MyEDID[54 + NumOfDetailedTiming*18 + 4] = 0;
-    MyEDID[54 + NumOfDetailedTiming*18 + 5] = 'L';
-    MyEDID[54 + NumOfDetailedTiming*18 + 6] = 'J';
-    MyEDID[54 + NumOfDetailedTiming*18 + 7] = 'B';
-    MyEDID[54 + NumOfDetailedTiming*18 + 8] = 'V';
-    MyEDID[54 + NumOfDetailedTiming*18 + 9] = 'M';
-    MyEDID[54 + NumOfDetailedTiming*18 + 10]= 'O';
-    MyEDID[54 + NumOfDetailedTiming*18 + 11]= 'N';
-    MyEDID[54 + NumOfDetailedTiming*18 + 12]= 0x0A;
-    MyEDID[54 + NumOfDetailedTiming*18 + 13]= 0x20;
-    MyEDID[54 + NumOfDetailedTiming*18 + 14]= 0x20;
-    MyEDID[54 + NumOfDetailedTiming*18 + 15]= 0x20;
-    MyEDID[54 + NumOfDetailedTiming*18 + 16]= 0x20;
-    MyEDID[54 + NumOfDetailedTiming*18 + 17]= 0x20;
-    NumOfDetailedTiming++;
-    DBG_PRINT((
-        __FUNCTION__
-        ": Populated monitor name = 'LJBVMON', NumOfDetailedTiming(%u)\n",
-        NumOfDetailedTiming));
-
-    // Serial Number: "LJB2016"
-    // 00 01 02 03 04 05 06 07-08 09 0A 0B 0C 0D 0E 0F
-    // ===============================================
-    // 00 00 00 FF 00 41 42 30-30 30 30 30 30 30 30 30,
-    // 31 0A
-    MyEDID[54 + NumOfDetailedTiming*18 + 0] = 0;
-    MyEDID[54 + NumOfDetailedTiming*18 + 1] = 0;
-    MyEDID[54 + NumOfDetailedTiming*18 + 2] = 0;
-    MyEDID[54 + NumOfDetailedTiming*18 + 3] = 0xFF;
-    MyEDID[54 + NumOfDetailedTiming*18 + 4] = 0;
-    MyEDID[54 + NumOfDetailedTiming*18 + 5] = 'L';
-    MyEDID[54 + NumOfDetailedTiming*18 + 6] = 'J';
-    MyEDID[54 + NumOfDetailedTiming*18 + 7] = 'B';
-    MyEDID[54 + NumOfDetailedTiming*18 + 8] = '2';
-    MyEDID[54 + NumOfDetailedTiming*18 + 9] = '0';
-    MyEDID[54 + NumOfDetailedTiming*18 + 10]= '1';
-    MyEDID[54 + NumOfDetailedTiming*18 + 11]= '6';
-    MyEDID[54 + NumOfDetailedTiming*18 + 12]= 0x0A;
-    MyEDID[54 + NumOfDetailedTiming*18 + 13]= ' ';
-    MyEDID[54 + NumOfDetailedTiming*18 + 14]= ' ';
-    MyEDID[54 + NumOfDetailedTiming*18 + 15]= ' ';
-    MyEDID[54 + NumOfDetailedTiming*18 + 16]= ' ';
-    MyEDID[54 + NumOfDetailedTiming*18 + 17]= ' ';
-    NumOfDetailedTiming++;
-    DBG_PRINT((__FUNCTION__
-        ": Serial Number='LJB2016', NumOfDetailedTiming(%u)\n",
-        NumOfDetailedTiming));
-
-    // Calculate Checksum
-    //
-    checksum = 0;
-    for (i = 0; i < 127; i++)
-    {
-        checksum += MyEDID[i];
-    }
-    MyEDID[127] = -checksum;
-
-    DUMP_BUF(MyEDID, 128);
-}
-
-static VOID
-LJB_VMON_DrawCursorOnFrameBuffer(
-    __in LJB_VMON_DEV_CTX *             dev_ctx,
-    __in TARGET_MODE_DATA               *TargetModeData,
-    __in VIDPN_SOURCE_VISIBILITY_DATA   *VisibilityData,
-    __in POINTER_POSITION_DATA          *PointerPositionData,
-    __in POINTER_SHAPE_DATA             *PointerShapeData,
-    __out PVOID                         FrameBuffer
-    )
-{
-    HANDLE CONST    hDefaultHeap = GetProcessHeap();
-    UINT32 CONST    SurfaceWidth = TargetModeData->Width;
-    UINT32 CONST    SurfaceHeight = TargetModeData->Height;
-    UINT32 CONST    SurfacePitch = SurfaceWidth * 4;
-    INT             CurPosX;
-    INT             CurPosY;
-    UINT            CurWidth;
-    UINT            CurHeight;
-    UINT            CurPitch;
-    UINT            ShadowCursorWidth;
-    UINT            ShadowCursorHeight;
-    UCHAR *         pCurBitmap;
-    UCHAR *         pSurfBitmap;
-    UCHAR *         pFinalBlendCurBuffer;
-    UCHAR *         pFinalBlendCurBufferStart;
-    UCHAR *         pOrigSurfPos;
-    UCHAR *         ShadowBitmapPosition;
-    UINT            row;
-
-    CurPosX = PointerPositionData->X;
-    CurPosY = PointerPositionData->Y;
-
-    /*
-     * If the target monitor is not visible, do not bother to draw cursor.
-     */
-    if (!VisibilityData->Visible)
-        return;
-
-    /*
-     * If cursor is not visible, do not bother to draw cursor.
-     */
-    if (!PointerPositionData->Visible)
-        return;
-
-    /*
-     * sanity check
-     */
-    if (CurPosX > 0)
-    {
-       if ((UINT)CurPosX >= SurfaceWidth)
-           return;
-    }
-    if (CurPosY > 0)
-    {
-       if ((UINT)CurPosY >= SurfaceHeight)
-           return;
-    }
-
-    CurWidth    = PointerShapeData->Width;
-    CurHeight   = PointerShapeData->Height;
-    CurPitch    = PointerShapeData->Pitch;
-
-    ShadowCursorWidth = CurWidth;
-    ShadowCursorHeight= CurHeight;
-    pCurBitmap  = PointerShapeData->Buffer;
-
-    // Calculate effective cursor Width/Height/Position.
-    //
-    if (CurPosX >= 0)
-    {
-        if ((CurPosX + CurWidth) >= (SurfaceWidth - 1))
-            ShadowCursorWidth = SurfaceWidth - 1 - CurPosX;
-    }
-    else
-    {
-        ShadowCursorWidth = CurWidth + CurPosX;
-        CurPosX = 0;
-    }
-
-    if (CurPosY >= 0)
-    {
-        if ((CurPosY + CurHeight) >= (SurfaceHeight - 1))
-            ShadowCursorHeight = SurfaceHeight - 1 - CurPosY;
-    }
-    else
-    {
-        ShadowCursorHeight = CurHeight + CurPosY;
-        CurPosY = 0;
-    }
-
-    if (ShadowCursorWidth == 0 || ShadowCursorHeight == 0 || ShadowCursorWidth > CurWidth || ShadowCursorHeight > CurHeight)
-    {
-        return;
-    }
-
-    pFinalBlendCurBufferStart = HeapAlloc(
-        hDefaultHeap,
-        HEAP_ZERO_MEMORY,
-        ShadowCursorWidth * ShadowCursorHeight * 4
-        );
-
-    if (pFinalBlendCurBufferStart == NULL)
-    {
-        DBG_PRINT((__FUNCTION__
-            ":unable to allocate pFinalBlendCurBufferStart?\n"));
-        return;
-    }
-
-    pFinalBlendCurBuffer = pFinalBlendCurBufferStart;
-    ShadowBitmapPosition= (UCHAR *)FrameBuffer + CurPosY * SurfacePitch + CurPosX * 4;
-    pOrigSurfPos = ShadowBitmapPosition;
-
-    // http://msdn.microsoft.com/en-us/library/windows/hardware/ff559481(v=vs.85).aspx
-    // 1. Monochrome cursor:
-    // A monochrome bitmap whose size is specified by Width and Height in a 1 bits
-    // per pixel (bpp) DIB format AND mask that is followed by another 1 bpp DIB
-    // format XOR mask of the same size.
-    //
-    if (PointerShapeData->Flags.Value == 1)
-    {
-        UCHAR * pANDMask;
-        UCHAR * pXORMask;
-        UINT iByte;
-        UINT iBit;
-
-        for(row = 0; row < ShadowCursorHeight; row++)
-        {
-            pANDMask = pCurBitmap;
-            pXORMask = pCurBitmap + CurHeight * CurPitch;
-            for (iByte = 0, iBit = 7; iByte < ShadowCursorWidth * 4; iByte +=4, iBit--)
-                {
-                // AND first and then XOR.
-                //
-                if ((*pANDMask >> iBit) & 1)
-                {
-                    *((ULONG *) (pFinalBlendCurBuffer + iByte)) =
-                        *((ULONG *) (pOrigSurfPos + iByte)) & 0xFFFFFFFF;
-                }
-                else
-                {
-                    *((ULONG *) (pFinalBlendCurBuffer + iByte)) =
-                        *((ULONG *) (pOrigSurfPos + iByte)) & 0;
-                }
-
-                if ((*pXORMask >> iBit) & 1)
-                {
-                    *((ULONG *) (pFinalBlendCurBuffer + iByte)) ^= 0xFFFFFFFF;
-                }
-                else
-                {
-                    *((ULONG *) (pFinalBlendCurBuffer + iByte)) ^= 0;
-                }
-
-                if (iBit == 0)
-                {
-                    pANDMask++;
-                    pXORMask++;
-                    iBit = 8;
-                }
-            }
-            pOrigSurfPos += SurfaceWidth * 4;
-            pFinalBlendCurBuffer += ShadowCursorWidth * 4;
-            pCurBitmap += CurPitch;
-        }
-    }
-    else
-    {
-        // When the cursor is on the boundary of the screen, CurPosX/CurPosY
-        // can be negative. So the start address of the cursor bitmap need to
-        // be re-calculated for these special cases.
-        //
-        UCHAR CurA;
-        SIZE_T AbsCurPosX;
-        SIZE_T AbsCurPosY;
-        UINT i;
-
-        CurPosX = PointerPositionData->X;
-        CurPosY = PointerPositionData->Y;
-
-        AbsCurPosX = abs(CurPosX);
-        AbsCurPosY = abs(CurPosY);
-
-        if (CurPosX < 0 && CurPosY < 0)
-        {
-            pCurBitmap += AbsCurPosY * CurPitch + AbsCurPosX * 4;
-        }
-
-        else if (CurPosX < 0)
-        {
-            pCurBitmap += AbsCurPosX * 4;
-        }
-
-        else if (CurPosY < 0)
-        {
-            pCurBitmap += AbsCurPosY * CurPitch;
-        }
-
-        // 2. Color cursor:
-        // A color bitmap whose size is specified by Width and Height in a 32 bpp
-        // ARGB device independent bitmap (DIB) format.
-        //
-        if (PointerShapeData->Flags.Value == 2)
-        {
-            UCHAR CurR, CurG, CurB;
-            UCHAR SurfR, SurfG, SurfB;
-
-            for(row = 0; row < ShadowCursorHeight; ++row)
-            {
-                for (i = 0; i < ShadowCursorWidth * 4; i +=4)
-                {
-                    SurfB = pOrigSurfPos[i];
-                    SurfG = pOrigSurfPos[i + 1];
-                    SurfR = pOrigSurfPos[i + 2];
-
-                    CurB = pCurBitmap[i];
-                    CurG = pCurBitmap[i + 1];
-                    CurR = pCurBitmap[i + 2];
-                    CurA = pCurBitmap[i + 3];
-
-                    pFinalBlendCurBuffer[i] = SurfB + (((CurB - SurfB) * CurA) / 255);
-                    pFinalBlendCurBuffer[i + 1] = SurfG + (((CurG - SurfG) * CurA) / 255);
-                    pFinalBlendCurBuffer[i + 2] = SurfR + (((CurR - SurfR) * CurA) / 255);
-                    pFinalBlendCurBuffer[i + 3] = pOrigSurfPos[i + 3];
-                }
-                pOrigSurfPos += SurfaceWidth * 4;
-                pCurBitmap += CurPitch;
-                pFinalBlendCurBuffer += ShadowCursorWidth * 4;
-            }
-        }
-
-        // 3. Masked color cursor:
-        // A 32-bpp ARGB format bitmap with the mask value in the alpha bits. The only
-        // allowed mask values are 0 and 0xFF. When the mask value is 0, the RGB value
-        // should replace the screen pixel. When the mask value is 0xFF, an XOR operation
-        // is performed on the RGB value and the screen pixel; the result should replace
-        // the screen pixel.
-        //
-        if (PointerShapeData->Flags.Value == 4)
-        {
-            for(row = 0; row < ShadowCursorHeight; ++row)
-            {
-                for (i = 0; i < ShadowCursorWidth * 4; i +=4)
-                {
-                    CurA = pCurBitmap[i + 3];
-                    if (CurA == 0)
-                    {
-                        *((ULONG *) (pFinalBlendCurBuffer + i)) =
-                            *((ULONG *) (pCurBitmap + i));
-                    }
-                    else
-                    {
-                        *((ULONG *) (pFinalBlendCurBuffer + i)) =
-                            *((ULONG *) (pOrigSurfPos + i)) ^ *((ULONG *) (pCurBitmap + i));
-                    }
-                    pFinalBlendCurBuffer[i+3] = pOrigSurfPos[i+3];
-                }
-                pCurBitmap += CurPitch;
-                pOrigSurfPos += SurfaceWidth * 4;
-                pFinalBlendCurBuffer += ShadowCursorWidth *4;
-            }
-        }
-    }
-
-    // Back up the replaced section of PrimarySurface before putting the final
-    // cursor image on the PrimarySurface.
-    //
-    dev_ctx->ShadowBitmapPosition = ShadowBitmapPosition;
-    dev_ctx->ShadowCursorWidth = ShadowCursorWidth;
-    dev_ctx->ShadowCursorHeight = ShadowCursorHeight;
-    dev_ctx->FrameBufferIsDirty = TRUE;
-    pSurfBitmap = dev_ctx->ShadowBitmapBuffer;
-
-    pOrigSurfPos = ShadowBitmapPosition;
-    pFinalBlendCurBuffer = pFinalBlendCurBufferStart;
-    for(row = 0; row < ShadowCursorHeight; ++row)
-    {
-        // Back up original PrimarySurface.
-        //
-        RtlCopyMemory(
-            pSurfBitmap,
-            pOrigSurfPos,
-            ShadowCursorWidth * 4
-            );
-        pSurfBitmap += ShadowCursorWidth * 4;
-
-        //Start filling cursor.
-        //
-        RtlCopyMemory(
-            pOrigSurfPos,
-            pFinalBlendCurBuffer,
-            ShadowCursorWidth * 4
-            );
-        pOrigSurfPos += SurfaceWidth * 4;
-        pFinalBlendCurBuffer += ShadowCursorWidth * 4;
-    }
-
-    HeapFree(hDefaultHeap, 0 , pFinalBlendCurBufferStart);
-}
-
-static VOID
-LJB_VMON_RestoreFrameBuffer(
-    __in LJB_VMON_DEV_CTX *             dev_ctx,
-    __in TARGET_MODE_DATA               *TargetModeData,
-    __out PVOID                         FrameBuffer
-    )
-{
-    UINT    row;
-    UINT    ShadowCursorWidth;
-    UINT    ShadowCursorHeight;
-    UCHAR * pSurfBitmap;
-    UCHAR * pOrigSurfPos;
-
-    if (!dev_ctx->FrameBufferIsDirty)
-        return;
-
-    pOrigSurfPos = dev_ctx->ShadowBitmapPosition;
-    pSurfBitmap = dev_ctx->ShadowBitmapBuffer;
-    ShadowCursorWidth = dev_ctx->ShadowCursorWidth;
-    ShadowCursorHeight = dev_ctx->ShadowCursorHeight;
-
-    for(row = 0; row < ShadowCursorHeight; ++row)
-        {
-        RtlCopyMemory(
-            pOrigSurfPos,
-            pSurfBitmap,
-            ShadowCursorWidth * 4
-            );
-
-        pOrigSurfPos += TargetModeData->Width * 4;
-        pSurfBitmap += ShadowCursorWidth * 4;
-        }
-    dev_ctx->FrameBufferIsDirty = FALSE;
-}
-
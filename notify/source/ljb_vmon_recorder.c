@@ -0,0 +1,767 @@
+#include "ljb_vmon.h"
+
+/*
+ * The recorder is a sink of the VMON thread (see ljb_vmon_sink.h) that
+ * writes everything it is told into a frame log (see ljb_vmon_framelog.h).
+ *
+ * The VMON thread never touches the file. It formats each record straight
+ * into a preallocated byte ring and moves Head; a writer thread copies from
+ * Tail into the file through LJB_VMON_RECORDER_VIEW_SIZE mapped views,
+ * mapping the next view, and so growing the file, whenever one fills up. If
+ * the ring has no room for a record, the record is dropped rather than
+ * waiting for the writer. The loss is recorded as a GAP and the recorder
+ * resynchronizes: the next frame is recorded whole, and the cursor shape and
+ * position are recorded again.
+ *
+ * With Tiles, frame pixels are compressed by the tile codec on the VMON
+ * thread (spread over the encoder's threads) before they enter the ring.
+ * With a Quality as well, tiles of video regions may go out lossy; the
+ * encoder adds the refresh of whatever came to rest to the next frame.
+ */
+#define RECORDER_RING_MASK      (LJB_VMON_RECORDER_RING_SIZE - 1)
+
+static ULONG64
+LJB_VMON_RecorderTimestamp(
+    VOID
+    )
+{
+    LARGE_INTEGER   Counter;
+
+    QueryPerformanceCounter(&Counter);
+    return (ULONG64) Counter.QuadPart;
+}
+
+/*
+ * writer thread side
+ */
+static BOOLEAN
+LJB_VMON_RecorderMapNextView(
+    __inout LJB_VMON_RECORDER *         Recorder
+    )
+{
+    ULONG64 NewOffset;
+    ULONG64 MaximumSize;
+
+    if (Recorder->View != NULL)
+    {
+        NewOffset = Recorder->ViewOffset + LJB_VMON_RECORDER_VIEW_SIZE;
+        UnmapViewOfFile(Recorder->View);
+        Recorder->View = NULL;
+    }
+    else
+    {
+        NewOffset = Recorder->FileSize & ~((ULONG64) LJB_VMON_RECORDER_VIEW_SIZE - 1);
+    }
+    if (Recorder->hMapping != NULL)
+    {
+        CloseHandle(Recorder->hMapping);
+        Recorder->hMapping = NULL;
+    }
+
+    MaximumSize = NewOffset + LJB_VMON_RECORDER_VIEW_SIZE;
+    Recorder->hMapping = CreateFileMapping(
+        Recorder->hFile,
+        NULL,
+        PAGE_READWRITE,
+        (DWORD) (MaximumSize >> 32),
+        (DWORD) MaximumSize,
+        NULL
+        );
+    if (Recorder->hMapping == NULL)
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": CreateFileMapping failed, error(%u)?\n",
+            GetLastError()));
+        return FALSE;
+    }
+
+    Recorder->View = MapViewOfFile(
+        Recorder->hMapping,
+        FILE_MAP_WRITE,
+        (DWORD) (NewOffset >> 32),
+        (DWORD) NewOffset,
+        LJB_VMON_RECORDER_VIEW_SIZE
+        );
+    if (Recorder->View == NULL)
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": MapViewOfFile failed, error(%u)?\n",
+            GetLastError()));
+        CloseHandle(Recorder->hMapping);
+        Recorder->hMapping = NULL;
+        return FALSE;
+    }
+    Recorder->ViewOffset = NewOffset;
+    return TRUE;
+}
+
+static BOOLEAN
+LJB_VMON_RecorderWriteFile(
+    __inout LJB_VMON_RECORDER *         Recorder,
+    __in CONST VOID *                   Data,
+    __in ULONG                          Size
+    )
+{
+    CONST UCHAR *   pData = Data;
+    ULONG64         Room;
+    ULONG           Chunk;
+
+    while (Size != 0)
+    {
+        if (Recorder->View == NULL ||
+            Recorder->FileSize == Recorder->ViewOffset + LJB_VMON_RECORDER_VIEW_SIZE)
+        {
+            if (!LJB_VMON_RecorderMapNextView(Recorder))
+                return FALSE;
+        }
+
+        Room = Recorder->ViewOffset + LJB_VMON_RECORDER_VIEW_SIZE - Recorder->FileSize;
+        Chunk = (Size < Room) ? Size : (ULONG) Room;
+        RtlCopyMemory(
+            Recorder->View + (SIZE_T) (Recorder->FileSize - Recorder->ViewOffset),
+            pData,
+            Chunk
+            );
+        Recorder->FileSize += Chunk;
+        pData += Chunk;
+        Size -= Chunk;
+    }
+    return TRUE;
+}
+
+static DWORD
+WINAPI
+LJB_VMON_RecorderWriter(
+    __in LPVOID                         Context
+    )
+{
+    LJB_VMON_RECORDER * CONST   Recorder = Context;
+    ULONG                       Head;
+    ULONG                       Tail;
+    ULONG                       Index;
+    ULONG                       Chunk;
+
+    for (;;)
+    {
+        Head = Recorder->Head;
+        Tail = Recorder->Tail;
+        if (Head == Tail)
+        {
+            if (Recorder->Stop)
+                break;
+            WaitForSingleObject(Recorder->hDataEvent, INFINITE);
+            continue;
+        }
+
+        while (Tail != Head)
+        {
+            Index = Tail & RECORDER_RING_MASK;
+            Chunk = Head - Tail;
+            if (Chunk > LJB_VMON_RECORDER_RING_SIZE - Index)
+                Chunk = LJB_VMON_RECORDER_RING_SIZE - Index;
+
+            if (!LJB_VMON_RecorderWriteFile(Recorder, Recorder->Ring + Index, Chunk))
+            {
+                /*
+                 * keep draining so the VMON thread is not starved; the log
+                 * is cut short at the last complete write.
+                 */
+                DBG_PRINT(("?" __FUNCTION__ ": %u bytes lost?\n", Head - Tail));
+                Tail = Head;
+            }
+            else
+            {
+                Tail += Chunk;
+            }
+            InterlockedExchange((volatile LONG *) &Recorder->Tail, (LONG) Tail);
+        }
+    }
+    return 0;
+}
+
+/*
+ * VMON thread side
+ */
+static VOID
+LJB_VMON_RecorderRingWrite(
+    __inout LJB_VMON_RECORDER *         Recorder,
+    __inout ULONG *                     pPosition,
+    __in CONST VOID *                   Data,
+    __in ULONG                          Size
+    )
+{
+    ULONG CONST Index = *pPosition & RECORDER_RING_MASK;
+    ULONG       First;
+
+    First = LJB_VMON_RECORDER_RING_SIZE - Index;
+    if (First > Size)
+        First = Size;
+    RtlCopyMemory(Recorder->Ring + Index, Data, First);
+    if (Size > First)
+        RtlCopyMemory(Recorder->Ring, (CONST UCHAR *) Data + First, Size - First);
+    *pPosition += Size;
+}
+
+/*
+ * Reserve room for a record of PayloadSize bytes and write its header. On
+ * success, the caller writes exactly PayloadSize bytes at *pPosition and
+ * then calls LJB_VMON_RecorderCommit.
+ */
+static BOOLEAN
+LJB_VMON_RecorderBegin(
+    __inout LJB_VMON_RECORDER *         Recorder,
+    __in ULONG                          Type,
+    __in ULONG64                        PayloadSize,
+    __out ULONG *                       pPosition
+    )
+{
+    LJB_VMON_FRAMELOG_RECORD    Record;
+    LJB_VMON_FRAMELOG_GAP       Gap;
+    ULONG64                     Size;
+    ULONG                       GapSize;
+    ULONG                       Free;
+    ULONG                       Position;
+
+    Size = LJB_VMON_FRAMELOG_ALIGN(sizeof(Record) + PayloadSize);
+    GapSize = 0;
+    if (Recorder->DroppedRecords != 0)
+        GapSize = LJB_VMON_FRAMELOG_ALIGN(sizeof(Record) + sizeof(Gap));
+
+    Free = LJB_VMON_RECORDER_RING_SIZE - (Recorder->Head - Recorder->Tail);
+    if (Size + GapSize > Free)
+    {
+        Recorder->DroppedRecords++;
+        Recorder->DroppedBytes += Size;
+        Recorder->Resync = TRUE;
+        return FALSE;
+    }
+
+    Position = Recorder->Head;
+    Record.Timestamp = LJB_VMON_RecorderTimestamp();
+    if (GapSize != 0)
+    {
+        Record.Type = LJB_VMON_FRAMELOG_TYPE_GAP;
+        Record.Size = GapSize;
+        RtlZeroMemory(&Gap, sizeof(Gap));
+        Gap.DroppedRecords = Recorder->DroppedRecords;
+        Gap.DroppedBytes = Recorder->DroppedBytes;
+        LJB_VMON_RecorderRingWrite(Recorder, &Position, &Record, sizeof(Record));
+        LJB_VMON_RecorderRingWrite(Recorder, &Position, &Gap, sizeof(Gap));
+        Recorder->DroppedRecords = 0;
+        Recorder->DroppedBytes = 0;
+    }
+
+    Record.Type = Type;
+    Record.Size = (ULONG) Size;
+    Recorder->CommitPosition = Position + (ULONG) Size;
+    LJB_VMON_RecorderRingWrite(Recorder, &Position, &Record, sizeof(Record));
+    *pPosition = Position;
+    return TRUE;
+}
+
+static VOID
+LJB_VMON_RecorderCommit(
+    __inout LJB_VMON_RECORDER *         Recorder,
+    __in ULONG                          Position
+    )
+{
+    static CONST UCHAR  Padding[8] = { 0 };
+
+    if (Position != Recorder->CommitPosition)
+    {
+        LJB_VMON_RecorderRingWrite(
+            Recorder,
+            &Position,
+            Padding,
+            Recorder->CommitPosition - Position
+            );
+    }
+
+    InterlockedExchange((volatile LONG *) &Recorder->Head, (LONG) Recorder->CommitPosition);
+    SetEvent(Recorder->hDataEvent);
+    Recorder->Records++;
+}
+
+static VOID
+LJB_VMON_RecorderAppendShape(
+    __inout LJB_VMON_RECORDER *         Recorder
+    )
+{
+    CONST POINTER_SHAPE_DATA * CONST    pShape = Recorder->LastShape;
+    LJB_VMON_FRAMELOG_CURSOR_SHAPE      Body;
+    ULONG                               Position;
+
+    RtlZeroMemory(&Body, sizeof(Body));
+    Body.Flags = pShape->Flags.Value;
+    Body.Width = pShape->Width;
+    Body.Height = pShape->Height;
+    Body.Pitch = pShape->Pitch;
+    Body.DataSize = (ULONG) LJB_VMON_CursorShapeSize(pShape);
+
+    if (!LJB_VMON_RecorderBegin(
+            Recorder,
+            LJB_VMON_FRAMELOG_TYPE_CURSOR_SHAPE,
+            sizeof(Body) + Body.DataSize,
+            &Position))
+        return;
+
+    LJB_VMON_RecorderRingWrite(Recorder, &Position, &Body, sizeof(Body));
+    LJB_VMON_RecorderRingWrite(Recorder, &Position, pShape->Buffer, Body.DataSize);
+    LJB_VMON_RecorderCommit(Recorder, Position);
+}
+
+static VOID
+LJB_VMON_RecorderAppendPosition(
+    __inout LJB_VMON_RECORDER *         Recorder
+    )
+{
+    LJB_VMON_FRAMELOG_CURSOR_POSITION   Body;
+    ULONG                               Position;
+
+    RtlZeroMemory(&Body, sizeof(Body));
+    Body.X = Recorder->LastPosition.X;
+    Body.Y = Recorder->LastPosition.Y;
+    Body.Visible = Recorder->LastPosition.Visible;
+
+    if (!LJB_VMON_RecorderBegin(
+            Recorder,
+            LJB_VMON_FRAMELOG_TYPE_CURSOR_POSITION,
+            sizeof(Body),
+            &Position))
+        return;
+
+    LJB_VMON_RecorderRingWrite(Recorder, &Position, &Body, sizeof(Body));
+    LJB_VMON_RecorderCommit(Recorder, Position);
+}
+
+static VOID
+LJB_VMON_RecorderModeChange(
+    __in PVOID                          SinkContext,
+    __in CONST TARGET_MODE_DATA *       TargetModeData
+    )
+{
+    LJB_VMON_RECORDER * CONST       Recorder = SinkContext;
+    LJB_VMON_FRAMELOG_MODE_CHANGE   Body;
+    ULONG                           Position;
+
+    RtlZeroMemory(&Body, sizeof(Body));
+    Body.Width = TargetModeData->Width;
+    Body.Height = TargetModeData->Height;
+    Body.Rotation = (ULONG) TargetModeData->Rotation;
+
+    if (!LJB_VMON_RecorderBegin(
+            Recorder,
+            LJB_VMON_FRAMELOG_TYPE_MODE_CHANGE,
+            sizeof(Body),
+            &Position))
+        return;
+
+    LJB_VMON_RecorderRingWrite(Recorder, &Position, &Body, sizeof(Body));
+    LJB_VMON_RecorderCommit(Recorder, Position);
+}
+
+static VOID
+LJB_VMON_RecorderFrameUpdate(
+    __in PVOID                          SinkContext,
+    __in CONST LJB_VMON_SINK_FRAME *    Frame
+    )
+{
+    LJB_VMON_RECORDER * CONST   Recorder = SinkContext;
+    CONST LJB_VMON_DAMAGE *     Damage;
+    LJB_VMON_DAMAGE             FullDamage;
+    LJB_VMON_DAMAGE             Sent;
+    CONST LJB_VMON_COPY_RECT *  Copies;
+    UINT                        NumCopies;
+    LJB_VMON_FRAMELOG_FRAME     Body;
+    LJB_VMON_FRAMELOG_COPY      Copy;
+    LJB_VMON_FRAMELOG_RECT      Rect;
+    CONST LJB_VMON_RECT *       pRect;
+    CONST UCHAR *               TileData;
+    SIZE_T                      TileDataSize;
+    ULONG64                     PayloadSize;
+    ULONG                       Position;
+    UINT                        i;
+    LONG                        row;
+
+    /*
+     * moves are recorded as copies, only the residual as pixels.
+     */
+    Damage = Frame->Damage;
+    Copies = NULL;
+    NumCopies = 0;
+    if (Damage != NULL && Frame->Motion != NULL)
+    {
+        Damage = &Frame->Motion->Residual;
+        Copies = Frame->Motion->Copies;
+        NumCopies = Frame->Motion->NumCopies;
+    }
+    if (Damage == NULL || Recorder->Resync)
+    {
+        LJB_VMON_DamageSetFull(&FullDamage, Frame->Width, Frame->Height);
+        Damage = &FullDamage;
+        NumCopies = 0;
+    }
+
+    TileData = NULL;
+    if (Recorder->Tiles)
+    {
+        /*
+         * the lossy path keeps its history per mode, (re)start it on the
+         * first frame of one.
+         */
+        if (Recorder->Quality != 0 &&
+            (Recorder->TileEncoder.Quality == 0 ||
+             Recorder->TileEncoder.Width != Frame->Width ||
+             Recorder->TileEncoder.Height != Frame->Height))
+        {
+            if (!LJB_VMON_TileEncoderSetLossy(
+                    &Recorder->TileEncoder,
+                    Frame->Width,
+                    Frame->Height,
+                    Recorder->Quality))
+            {
+                DBG_PRINT(("?" __FUNCTION__ ": out of memory, recording lossless?\n"));
+                Recorder->Quality = 0;
+            }
+        }
+        Sent = *Damage;
+        LJB_VMON_TileEncoderAddRefresh(&Recorder->TileEncoder, &Sent);
+        Damage = &Sent;
+
+        if (!LJB_VMON_TileEncode(
+                &Recorder->TileEncoder,
+                Frame->Buffer,
+                Frame->Pitch,
+                Damage->Rects,
+                Damage->NumRects,
+                &TileData,
+                &TileDataSize))
+        {
+            Recorder->DroppedRecords++;
+            Recorder->Resync = TRUE;
+            return;
+        }
+    }
+
+    PayloadSize = sizeof(Body) +
+                  NumCopies * sizeof(Copy) +
+                  Damage->NumRects * sizeof(Rect) +
+                  ((TileData != NULL) ? TileDataSize : LJB_VMON_DamageArea(Damage) * 4);
+    if (!LJB_VMON_RecorderBegin(
+            Recorder,
+            LJB_VMON_FRAMELOG_TYPE_FRAME,
+            PayloadSize,
+            &Position))
+        return;
+
+    RtlZeroMemory(&Body, sizeof(Body));
+    Body.FrameId = Frame->FrameId;
+    Body.Width = Frame->Width;
+    Body.Height = Frame->Height;
+    Body.NumRects = Damage->NumRects;
+    Body.Encoding = (TileData != NULL) ?
+        LJB_VMON_FRAMELOG_ENCODING_TILE : LJB_VMON_FRAMELOG_ENCODING_RAW;
+    Body.NumCopies = NumCopies;
+    LJB_VMON_RecorderRingWrite(Recorder, &Position, &Body, sizeof(Body));
+
+    for (i = 0; i < NumCopies; i++)
+    {
+        Copy.Left = Copies[i].Dst.Left;
+        Copy.Top = Copies[i].Dst.Top;
+        Copy.Right = Copies[i].Dst.Right;
+        Copy.Bottom = Copies[i].Dst.Bottom;
+        Copy.SrcLeft = Copies[i].SrcLeft;
+        Copy.SrcTop = Copies[i].SrcTop;
+        LJB_VMON_RecorderRingWrite(Recorder, &Position, &Copy, sizeof(Copy));
+    }
+
+    for (i = 0; i < Damage->NumRects; i++)
+    {
+        pRect = &Damage->Rects[i];
+        Rect.Left = pRect->Left;
+        Rect.Top = pRect->Top;
+        Rect.Right = pRect->Right;
+        Rect.Bottom = pRect->Bottom;
+        LJB_VMON_RecorderRingWrite(Recorder, &Position, &Rect, sizeof(Rect));
+    }
+
+    if (TileData != NULL)
+        LJB_VMON_RecorderRingWrite(Recorder, &Position, TileData, (ULONG) TileDataSize);
+
+    for (i = 0; TileData == NULL && i < Damage->NumRects; i++)
+    {
+        pRect = &Damage->Rects[i];
+        for (row = pRect->Top; row < pRect->Bottom; row++)
+        {
+            LJB_VMON_RecorderRingWrite(
+                Recorder,
+                &Position,
+                (CONST UCHAR *) Frame->Buffer + (SIZE_T) row * Frame->Pitch + pRect->Left * 4,
+                (pRect->Right - pRect->Left) * 4
+                );
+        }
+    }
+    LJB_VMON_RecorderCommit(Recorder, Position);
+    Recorder->FrameBytes += PayloadSize;
+
+    if (Recorder->Resync)
+    {
+        Recorder->Resync = FALSE;
+        if (Recorder->HasShape)
+            LJB_VMON_RecorderAppendShape(Recorder);
+        LJB_VMON_RecorderAppendPosition(Recorder);
+    }
+}
+
+static VOID
+LJB_VMON_RecorderCursorShape(
+    __in PVOID                          SinkContext,
+    __in CONST POINTER_SHAPE_DATA *     PointerShapeData
+    )
+{
+    LJB_VMON_RECORDER * CONST   Recorder = SinkContext;
+
+    RtlCopyMemory(
+        Recorder->LastShape,
+        PointerShapeData,
+        FIELD_OFFSET(POINTER_SHAPE_DATA, Buffer) + LJB_VMON_CursorShapeSize(PointerShapeData)
+        );
+    Recorder->HasShape = TRUE;
+    LJB_VMON_RecorderAppendShape(Recorder);
+}
+
+static VOID
+LJB_VMON_RecorderCursorPosition(
+    __in PVOID                          SinkContext,
+    __in CONST POINTER_POSITION_DATA *  PointerPositionData
+    )
+{
+    LJB_VMON_RECORDER * CONST   Recorder = SinkContext;
+
+    Recorder->LastPosition = *PointerPositionData;
+    LJB_VMON_RecorderAppendPosition(Recorder);
+}
+
+/*
+ * Nothing to record for a while; the ring and the writer stay, the buffers
+ * the tile encoder codes into go until the next frame.
+ */
+static VOID
+LJB_VMON_RecorderIdle(
+    __in PVOID                          SinkContext
+    )
+{
+    LJB_VMON_RECORDER * CONST   Recorder = SinkContext;
+
+    if (Recorder->Tiles)
+        LJB_VMON_TileEncoderTrim(&Recorder->TileEncoder);
+}
+
+/*
+ * Name:  LJB_VMON_RecorderInit
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_RecorderInit(
+ *        __out LJB_VMON_RECORDER * Recorder,
+ *        __in PCSTR                FileName,
+ *        __in BOOLEAN              Tiles,
+ *        __in UINT                 Quality
+ *        );
+ *
+ * Description:
+ *    Create (or truncate) the frame log FileName, write its header and start
+ *    the writer thread. With Tiles, frames are recorded in
+ *    LJB_VMON_FRAMELOG_ENCODING_TILE rather than raw, and a nonzero Quality
+ *    (1 to 100) lets video regions go out lossy at that quality.
+ *
+ * Return Value:
+ *    Return TRUE if success. Return FALSE otherwise; the caller still calls
+ *    LJB_VMON_RecorderDeInit.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_RecorderInit(
+    __out LJB_VMON_RECORDER *           Recorder,
+    __in PCSTR                          FileName,
+    __in BOOLEAN                        Tiles,
+    __in UINT                           Quality
+    )
+{
+    LJB_VMON_FRAMELOG_HEADER    Header;
+    LARGE_INTEGER               Frequency;
+    FILETIME                    StartTime;
+
+    RtlZeroMemory(Recorder, sizeof(*Recorder));
+
+    Recorder->hFile = CreateFileA(
+        FileName,
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ,
+        NULL,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+        );
+    if (Recorder->hFile == INVALID_HANDLE_VALUE)
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": unable to create %s, error(%u)?\n",
+            FileName, GetLastError()));
+        Recorder->hFile = NULL;
+        return FALSE;
+    }
+
+    Recorder->Ring = VirtualAlloc(
+        NULL,
+        LJB_VMON_RECORDER_RING_SIZE,
+        MEM_COMMIT | MEM_RESERVE,
+        PAGE_READWRITE
+        );
+    Recorder->LastShape = HeapAlloc(GetProcessHeap(), 0, sizeof(POINTER_SHAPE_DATA));
+    Recorder->hDataEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (Recorder->Ring == NULL || Recorder->LastShape == NULL || Recorder->hDataEvent == NULL)
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": out of resources?\n"));
+        return FALSE;
+    }
+
+    RtlZeroMemory(&Header, sizeof(Header));
+    RtlCopyMemory(Header.Signature, LJB_VMON_FRAMELOG_SIGNATURE, sizeof(Header.Signature));
+    Header.Version = LJB_VMON_FRAMELOG_VERSION;
+    Header.HeaderSize = sizeof(Header);
+    QueryPerformanceFrequency(&Frequency);
+    Header.TimestampFrequency = (ULONG64) Frequency.QuadPart;
+    GetSystemTimeAsFileTime(&StartTime);
+    Header.StartTimestamp = LJB_VMON_RecorderTimestamp();
+    Header.StartTime = ((ULONG64) StartTime.dwHighDateTime << 32) | StartTime.dwLowDateTime;
+
+    Recorder->Tiles = Tiles;
+    Recorder->Quality = Tiles ? Quality : 0;
+    if (Tiles && !LJB_VMON_TileEncoderInit(&Recorder->TileEncoder, 0))
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": unable to start the tile encoder?\n"));
+        return FALSE;
+    }
+
+    /*
+     * the writer thread is not running yet, the file is ours.
+     */
+    if (!LJB_VMON_RecorderWriteFile(Recorder, &Header, sizeof(Header)))
+        return FALSE;
+
+    /*
+     * start the log with a whole frame and the cursor state.
+     */
+    Recorder->Resync = TRUE;
+
+    Recorder->hWriterThread = CreateThread(
+        NULL,
+        0,
+        &LJB_VMON_RecorderWriter,
+        Recorder,
+        0,
+        NULL
+        );
+    if (Recorder->hWriterThread == NULL)
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": unable to create writer thread?\n"));
+        return FALSE;
+    }
+
+    DBG_PRINT((__FUNCTION__ ": recording to %s\n", FileName));
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_RecorderDeInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_RecorderDeInit(
+ *        __inout LJB_VMON_RECORDER *   Recorder
+ *        );
+ *
+ * Description:
+ *    Let the writer thread drain the ring, then trim the log to what was
+ *    written and close it. The VMON thread must no longer report to the
+ *    recorder sink.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_RecorderDeInit(
+    __inout LJB_VMON_RECORDER *         Recorder
+    )
+{
+    LARGE_INTEGER   FileSize;
+
+    if (Recorder->hWriterThread != NULL)
+    {
+        InterlockedExchange(&Recorder->Stop, 1);
+        SetEvent(Recorder->hDataEvent);
+        WaitForSingleObject(Recorder->hWriterThread, INFINITE);
+        CloseHandle(Recorder->hWriterThread);
+
+        DBG_PRINT((__FUNCTION__
+            ": %I64u records, %I64u frame bytes, %I64u bytes written\n",
+            Recorder->Records,
+            Recorder->FrameBytes,
+            Recorder->FileSize
+            ));
+    }
+
+    if (Recorder->Tiles)
+        LJB_VMON_TileEncoderDeInit(&Recorder->TileEncoder);
+    if (Recorder->View != NULL)
+        UnmapViewOfFile(Recorder->View);
+    if (Recorder->hMapping != NULL)
+        CloseHandle(Recorder->hMapping);
+    if (Recorder->hFile != NULL)
+    {
+        FileSize.QuadPart = (LONGLONG) Recorder->FileSize;
+        if (SetFilePointerEx(Recorder->hFile, FileSize, NULL, FILE_BEGIN))
+            SetEndOfFile(Recorder->hFile);
+        CloseHandle(Recorder->hFile);
+    }
+    if (Recorder->hDataEvent != NULL)
+        CloseHandle(Recorder->hDataEvent);
+    if (Recorder->LastShape != NULL)
+        HeapFree(GetProcessHeap(), 0, Recorder->LastShape);
+    if (Recorder->Ring != NULL)
+        VirtualFree(Recorder->Ring, 0, MEM_RELEASE);
+
+    RtlZeroMemory(Recorder, sizeof(*Recorder));
+}
+
+/*
+ * Name:  LJB_VMON_RecorderGetSink
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_RecorderGetSink(
+ *        __in LJB_VMON_RECORDER *  Recorder,
+ *        __out LJB_VMON_SINK *     Sink
+ *        );
+ *
+ * Description:
+ *    Return the sink through which the VMON thread feeds the recorder.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_RecorderGetSink(
+    __in LJB_VMON_RECORDER *            Recorder,
+    __out LJB_VMON_SINK *               Sink
+    )
+{
+    RtlZeroMemory(Sink, sizeof(*Sink));
+    Sink->SinkContext = Recorder;
+    Sink->pfnModeChange = LJB_VMON_RecorderModeChange;
+    Sink->pfnFrameUpdate = LJB_VMON_RecorderFrameUpdate;
+    Sink->pfnCursorShape = LJB_VMON_RecorderCursorShape;
+    Sink->pfnCursorPosition = LJB_VMON_RecorderCursorPosition;
+    Sink->pfnIdle = LJB_VMON_RecorderIdle;
+}
@@ -0,0 +1,763 @@
+#include "ljb_vmon.h"
+#include "notify.h"
+
+/*
+ * vmon.exe /service runs the VMON threads with no window and no viewer, for
+ * hosts that only stream, record or measure: each monitor gets the sinks its
+ * options ask for, /null for one that drops every frame, and the process
+ * burns nothing on repaints. Options come from the command line and from
+ * config files it names; /monitor starts the options of the next monitor,
+ * which drives the next device interface:
+ *
+ *    vmon.exe /service /config vmon.cfg
+ *    vmon.exe /service /stream_tiles host1 100 /monitor /stream_tiles host2 100
+ *    vmon.exe /service /null /seconds 30
+ *
+ * An option starts at a '/' after white space and runs up to the next one;
+ * in a config file, '#' comments out the rest of the line. The service runs
+ * until Ctrl+C in the console it was started from, vmon.exe /service_stop,
+ * the /seconds given, or until every VMON thread is gone, and then prints
+ * the frames each monitor captured, counted once however many sinks it has,
+ * as one JSON line per monitor.
+ *
+ * The VMON threads wait on the stop event alongside the driver, so that a
+ * wait pending in the driver is cancelled by the thread that issued it.
+ */
+#define LJB_VMON_SERVICE_MAX_CONFIG         (64 * 1024)     // bytes
+#define LJB_VMON_SERVICE_MAX_CONFIG_DEPTH   4               // nested /config
+#define LJB_VMON_SERVICE_POLL_INTERVAL      1000            // ms
+#define LJB_VMON_OPTION_MAX_RATE            (1000 * 1000)   // Mbit/s
+
+typedef struct _LJB_VMON_SERVICE
+{
+    PDEVICE_INFO        Monitors[LJB_VMON_SERVICE_MAX_MONITORS];
+    UINT                NumMonitors;
+    DWORD               Duration;       // ms, INFINITE until stopped
+} LJB_VMON_SERVICE;
+
+static HANDLE   g_hServiceStopEvent = NULL;
+
+/*
+ * Parse the decimal number at *pText and step past it and the blanks after
+ * it. FALSE if there is no number there, something other than a blank
+ * follows it, or it is larger than Max.
+ */
+static BOOLEAN
+LJB_VMON_ParseNumber(
+    __inout PCSTR *             pText,
+    __in ULONG                  Max,
+    __out ULONG *               Value
+    )
+{
+    PSTR    End;
+    ULONG   Number;
+
+    if (**pText < '0' || **pText > '9')
+        return FALSE;
+
+    /*
+     * strtoul saturates at ULONG_MAX, which is above any Max passed here
+     */
+    Number = strtoul(*pText, &End, 10);
+    if (Number > Max || (*End != ' ' && *End != '\0'))
+        return FALSE;
+    while (*End == ' ')
+        End++;
+    *pText = End;
+    *Value = Number;
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_ParseOption
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_ParseOption(
+ *        __inout PDEVICE_INFO      pDeviceInfo,
+ *        __inout PSTR              Option
+ *        );
+ *
+ * Description:
+ *    Apply one vmon.exe option, "/name" followed by its arguments, to the
+ *    monitor pDeviceInfo describes. Option is split in place.
+ *
+ * Return Value:
+ *    TRUE if the option is one of a monitor's and its numbers are numbers
+ *    in range, FALSE otherwise.
+ *
+ */
+BOOLEAN
+LJB_VMON_ParseOption(
+    __inout PDEVICE_INFO        pDeviceInfo,
+    __inout PSTR                Option
+    )
+{
+    PSTR    Args;
+
+    Args = Option;
+    while (*Args != ' ' && *Args != '\0')
+        Args++;
+    if (*Args == ' ')
+        *Args++ = '\0';
+    while (*Args == ' ')
+        Args++;
+
+    //
+    // vmon.exe /record <file> appends the session to a frame log.
+    //
+    // vmon.exe /record_tiles <file> does the same with the frame pixels
+    // compressed by the tile codec.
+    //
+    if (strcmp(Option, "/record") == 0 || strcmp(Option, "/record_tiles") == 0)
+    {
+        if (*Args == '\0')
+            return FALSE;
+        StringCchCopyA(
+            pDeviceInfo->RecordPath,
+            sizeof(pDeviceInfo->RecordPath),
+            Args
+            );
+        pDeviceInfo->RecordTiles = (Option[7] == '_');
+    }
+
+    //
+    // vmon.exe /record_lossy <quality> <file> also lets video regions go
+    // out lossy at quality 1 to 100.
+    //
+    else if (strcmp(Option, "/record_lossy") == 0)
+    {
+        PCSTR   FileName = Args;
+        ULONG   Quality;
+
+        if (!LJB_VMON_ParseNumber(&FileName, 100, &Quality) || Quality == 0 ||
+            *FileName == '\0')
+            return FALSE;
+        pDeviceInfo->RecordQuality = Quality;
+        StringCchCopyA(
+            pDeviceInfo->RecordPath,
+            sizeof(pDeviceInfo->RecordPath),
+            FileName
+            );
+        pDeviceInfo->RecordTiles = TRUE;
+    }
+
+    //
+    // vmon.exe /trace <file> writes the driver's binary trace to a file.
+    //
+    else if (strcmp(Option, "/trace") == 0)
+    {
+        if (*Args == '\0')
+            return FALSE;
+        StringCchCopyA(
+            pDeviceInfo->TracePath,
+            sizeof(pDeviceInfo->TracePath),
+            Args
+            );
+    }
+
+    //
+    // vmon.exe /stream <host>[:port] [<Mbit/s>] streams the session to a
+    // receiver, /stream_tiles <host>[:port] [<Mbit/s>] with the frame pixels
+    // compressed by the tile codec. With a link rate, the monitor only
+    // offers modes the link keeps up with.
+    //
+    else if (strcmp(Option, "/stream") == 0 || strcmp(Option, "/stream_tiles") == 0)
+    {
+        PSTR    Rate;
+        PCSTR   Next;
+        ULONG   Bandwidth;
+
+        StringCchCopyA(
+            pDeviceInfo->StreamAddress,
+            sizeof(pDeviceInfo->StreamAddress),
+            Args
+            );
+        pDeviceInfo->StreamTiles = (Option[7] == '_');
+        Rate = strchr(pDeviceInfo->StreamAddress, ' ');
+        if (Rate != NULL)
+        {
+            *Rate++ = '\0';
+            for (Next = Rate; *Next == ' '; Next++)
+                ;
+            if (!LJB_VMON_ParseNumber(&Next, LJB_VMON_OPTION_MAX_RATE, &Bandwidth) ||
+                *Next != '\0')
+                return FALSE;
+            pDeviceInfo->StreamBandwidth = Bandwidth;
+        }
+    }
+
+    //
+    // vmon.exe /usb_loopback <MB/s> <depth> [<frames>] sends the session,
+    // tile coded, down a stand-in USB bulk endpoint of that bandwidth, depth
+    // transfers in flight; for tuning the USB sink without a device. With
+    // frames, capture skips ahead rather than wait while that many frames
+    // are on the link.
+    //
+    else if (strcmp(Option, "/usb_loopback") == 0)
+    {
+        PCSTR   Next = Args;
+        ULONG   Bandwidth;
+        ULONG   Depth;
+        ULONG   Credits = 0;
+
+        //
+        // the bandwidth goes to the loopback in bytes/s, and a sink compares
+        // its credits as a LONG
+        //
+        if (!LJB_VMON_ParseNumber(&Next, MAXULONG / 1000000, &Bandwidth) ||
+            Bandwidth == 0 ||
+            !LJB_VMON_ParseNumber(&Next, LJB_VMON_USB_MAX_DEPTH, &Depth) ||
+            (*Next != '\0' && !LJB_VMON_ParseNumber(&Next, MAXLONG, &Credits)) ||
+            *Next != '\0')
+            return FALSE;
+        pDeviceInfo->UsbBandwidth = Bandwidth;
+        pDeviceInfo->UsbDepth = Depth;
+        pDeviceInfo->UsbCredits = Credits;
+    }
+
+    //
+    // vmon.exe /idle <seconds> parks capture once nobody has seen the
+    // monitor for that long, LJB_VMON_DEFAULT_IDLE_DELAY otherwise; 0 parks
+    // it as soon as the source goes invisible.
+    //
+    else if (strcmp(Option, "/idle") == 0)
+    {
+        PCSTR   Next = Args;
+        ULONG   Seconds;
+
+        if (!LJB_VMON_ParseNumber(&Next, MAXDWORD / 1000, &Seconds) || *Next != '\0')
+            return FALSE;
+        pDeviceInfo->IdleDelay = Seconds * 1000;
+    }
+
+    //
+    // vmon.exe /null hands every frame to a sink that drops it, to measure
+    // capture with nothing downstream.
+    //
+    else if (strcmp(Option, "/null") == 0)
+        pDeviceInfo->NullSink = TRUE;
+
+    else
+        return FALSE;
+
+    return TRUE;
+}
+
+static BOOL WINAPI
+LJB_VMON_ServiceCtrlHandler(
+    __in DWORD          CtrlType
+    )
+{
+    /*
+     * a logoff is someone else's session ending
+     */
+    if (CtrlType == CTRL_LOGOFF_EVENT)
+        return FALSE;
+    SetEvent(g_hServiceStopEvent);
+    return TRUE;
+}
+
+/*
+ * Option text is parsed with line breaks and tabs as blanks, so that a
+ * config file reads like a command line.
+ */
+static VOID
+LJB_VMON_ServiceBlankText(
+    __inout PSTR        Text
+    )
+{
+    for (; *Text != '\0'; Text++)
+    {
+        if (*Text == '\r' || *Text == '\n' || *Text == '\t')
+            *Text = ' ';
+    }
+}
+
+/*
+ * The contents of a config file, comments blanked out; freed by the caller
+ * from the process heap. NULL if it cannot be read.
+ */
+static PSTR
+LJB_VMON_ServiceReadConfig(
+    __in PCSTR          FileName
+    )
+{
+    HANDLE CONST        hDefaultHeap = GetProcessHeap();
+    HANDLE              hFile;
+    DWORD               FileSize;
+    DWORD               BytesRead;
+    PSTR                Text;
+    BOOLEAN             Comment;
+    DWORD               i;
+
+    hFile = CreateFileA(
+        FileName,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+        );
+    if (hFile == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    Text = NULL;
+    FileSize = GetFileSize(hFile, NULL);
+    if (FileSize != INVALID_FILE_SIZE && FileSize <= LJB_VMON_SERVICE_MAX_CONFIG)
+        Text = HeapAlloc(hDefaultHeap, 0, FileSize + 1);
+    if (Text != NULL)
+    {
+        if (!ReadFile(hFile, Text, FileSize, &BytesRead, NULL))
+        {
+            HeapFree(hDefaultHeap, 0, Text);
+            Text = NULL;
+        }
+    }
+    CloseHandle(hFile);
+    if (Text == NULL)
+        return NULL;
+
+    Text[BytesRead] = '\0';
+    Comment = FALSE;
+    for (i = 0; i < BytesRead; i++)
+    {
+        if (Text[i] == '\n')
+            Comment = FALSE;
+        else if (Text[i] == '#')
+            Comment = TRUE;
+        if (Comment || Text[i] == '\0')
+            Text[i] = ' ';
+    }
+    LJB_VMON_ServiceBlankText(Text);
+    return Text;
+}
+
+static PDEVICE_INFO
+LJB_VMON_ServiceAddMonitor(
+    __inout LJB_VMON_SERVICE *  Service
+    )
+{
+    PDEVICE_INFO    pDeviceInfo;
+
+    if (Service->NumMonitors == LJB_VMON_SERVICE_MAX_MONITORS)
+    {
+        fprintf(stderr, "vmon: no more than %u monitors\n",
+            LJB_VMON_SERVICE_MAX_MONITORS);
+        return NULL;
+    }
+    pDeviceInfo = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(DEVICE_INFO));
+    if (pDeviceInfo == NULL)
+        return NULL;
+
+    InitializeListHead(&pDeviceInfo->ListEntry);
+    pDeviceInfo->IdleDelay = LJB_VMON_DEFAULT_IDLE_DELAY;
+    pDeviceInfo->Headless = TRUE;
+    pDeviceInfo->MonitorIndex = Service->NumMonitors;
+    Service->Monitors[Service->NumMonitors++] = pDeviceInfo;
+    return pDeviceInfo;
+}
+
+/*
+ * Copy the option Text starts with, up to the next '/' after a blank and
+ * without its trailing blanks, to Option. Returns where the next option
+ * starts, or NULL if Text does not start with an option or it does not fit.
+ */
+static PCSTR
+LJB_VMON_NextOption(
+    __in PCSTR                  Text,
+    __out_ecount(OptionSize) PSTR Option,
+    __in SIZE_T                 OptionSize
+    )
+{
+    PCSTR           End;
+    SIZE_T          Length;
+
+    if (*Text != '/')
+        return NULL;
+
+    for (End = Text + 1; *End != '\0'; End++)
+    {
+        if (End[0] == '/' && End[-1] == ' ')
+            break;
+    }
+    Length = End - Text;
+    while (Length > 0 && Text[Length - 1] == ' ')
+        Length--;
+    if (FAILED(StringCchCopyNA(Option, OptionSize, Text, Length)))
+        return NULL;
+    return End;
+}
+
+/*
+ * Name:  LJB_VMON_ParseOptions
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_ParseOptions(
+ *        __inout PDEVICE_INFO      pDeviceInfo,
+ *        __in PCSTR                CmdLine,
+ *        __out PCSTR *             pBadOption
+ *        );
+ *
+ * Description:
+ *    Apply every option of a viewer command line to the monitor pDeviceInfo
+ *    describes, split the way vmon.exe /service splits its own. Only a
+ *    monitor's options are taken; /monitor, /seconds and /config are the
+ *    service's.
+ *
+ * Return Value:
+ *    TRUE if every option was applied. Otherwise FALSE, with pBadOption
+ *    pointing into CmdLine at the first one that was not.
+ *
+ */
+BOOLEAN
+LJB_VMON_ParseOptions(
+    __inout PDEVICE_INFO        pDeviceInfo,
+    __in PCSTR                  CmdLine,
+    __out PCSTR *               pBadOption
+    )
+{
+    HANDLE CONST    hDefaultHeap = GetProcessHeap();
+    CHAR            Option[2 * MAX_PATH];
+    PSTR            Text;
+    PCSTR           Start;
+    PCSTR           Next;
+    SIZE_T          TextSize;
+    BOOLEAN         ret;
+
+    *pBadOption = CmdLine;
+    TextSize = strlen(CmdLine) + 1;
+    Text = HeapAlloc(hDefaultHeap, 0, TextSize);
+    if (Text == NULL)
+        return FALSE;
+    StringCchCopyA(Text, TextSize, CmdLine);
+    LJB_VMON_ServiceBlankText(Text);
+
+    ret = TRUE;
+    Next = Text;
+    while (ret)
+    {
+        while (*Next == ' ')
+            Next++;
+        if (*Next == '\0')
+            break;
+
+        Start = Next;
+        Next = LJB_VMON_NextOption(Start, Option, sizeof(Option));
+        ret = (BOOLEAN) (Next != NULL && LJB_VMON_ParseOption(pDeviceInfo, Option));
+        if (!ret)
+            *pBadOption = CmdLine + (Start - Text);
+    }
+    HeapFree(hDefaultHeap, 0, Text);
+    return ret;
+}
+
+/*
+ * TRUE if Option is Name, with or without arguments.
+ */
+static BOOLEAN
+LJB_VMON_ServiceIsOption(
+    __in PCSTR          Option,
+    __in PCSTR          Name
+    )
+{
+    SIZE_T CONST    Length = strlen(Name);
+
+    return strncmp(Option, Name, Length) == 0 &&
+        (Option[Length] == ' ' || Option[Length] == '\0');
+}
+
+/*
+ * Apply the options in Text, a config file's or the command line's. Options
+ * before the first /monitor are those of the first monitor.
+ */
+static BOOLEAN
+LJB_VMON_ServiceParse(
+    __inout LJB_VMON_SERVICE *  Service,
+    __in PCSTR                  Text,
+    __in UINT                   Depth
+    )
+{
+    CHAR            Option[2 * MAX_PATH];
+    PCSTR           Start;
+    PCSTR           End;
+    PCSTR           Next;
+    PSTR            Args;
+    PSTR            Config;
+    ULONG           Seconds;
+    BOOLEAN         ret;
+
+    while (*Text != '\0')
+    {
+        while (*Text == ' ')
+            Text++;
+        if (*Text == '\0')
+            break;
+
+        if (*Text != '/')
+        {
+            fprintf(stderr, "vmon: expected an option at \"%.32s\"\n", Text);
+            return FALSE;
+        }
+
+        End = LJB_VMON_NextOption(Text, Option, sizeof(Option));
+        if (End == NULL)
+        {
+            fprintf(stderr, "vmon: option too long at \"%.32s\"\n", Text);
+            return FALSE;
+        }
+        Start = Text;
+        Text = End;
+
+        Args = strchr(Option, ' ');
+        if (Args == NULL)
+            Args = Option + strlen(Option);
+        while (*Args == ' ')
+            Args++;
+
+        if (LJB_VMON_ServiceIsOption(Option, "/monitor"))
+        {
+            if (LJB_VMON_ServiceAddMonitor(Service) == NULL)
+                return FALSE;
+        }
+        else if (LJB_VMON_ServiceIsOption(Option, "/seconds"))
+        {
+            Next = Args;
+            if (!LJB_VMON_ParseNumber(&Next, MAXDWORD / 1000, &Seconds) || *Next != '\0')
+            {
+                fprintf(stderr, "vmon: bad option %s\n", Option);
+                return FALSE;
+            }
+            Service->Duration = Seconds * 1000;
+        }
+        else if (LJB_VMON_ServiceIsOption(Option, "/config"))
+        {
+            if (Depth == LJB_VMON_SERVICE_MAX_CONFIG_DEPTH)
+            {
+                fprintf(stderr, "vmon: %s: config files nested too deep\n", Args);
+                return FALSE;
+            }
+            Config = LJB_VMON_ServiceReadConfig(Args);
+            if (Config == NULL)
+            {
+                fprintf(stderr, "vmon: unable to read config file %s\n", Args);
+                return FALSE;
+            }
+            ret = LJB_VMON_ServiceParse(Service, Config, Depth + 1);
+            HeapFree(GetProcessHeap(), 0, Config);
+            if (!ret)
+                return FALSE;
+        }
+        else
+        {
+            if (Service->NumMonitors == 0 &&
+                LJB_VMON_ServiceAddMonitor(Service) == NULL)
+                return FALSE;
+            if (!LJB_VMON_ParseOption(Service->Monitors[Service->NumMonitors - 1], Option))
+            {
+                fprintf(stderr, "vmon: unknown option or bad arguments at \"%.*s\"\n",
+                    (int) (End - Start), Start);
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_ServiceMain
+ *
+ * Definition:
+ *    int
+ *    LJB_VMON_ServiceMain(
+ *        __in PCSTR                CmdLine
+ *        );
+ *
+ * Description:
+ *    vmon.exe /service: run a VMON thread per monitor CmdLine configures,
+ *    headless, until stopped, and print what each monitor captured.
+ *
+ * Return Value:
+ *    0 if the service ran, 1 otherwise.
+ *
+ */
+int
+LJB_VMON_ServiceMain(
+    __in PCSTR          CmdLine
+    )
+{
+    HANDLE CONST        hDefaultHeap = GetProcessHeap();
+    LJB_VMON_SERVICE    Service;
+    HANDLE              hThreads[LJB_VMON_SERVICE_MAX_MONITORS];
+    UINT                NumThreads;
+    PDEVICE_INFO        pDeviceInfo;
+    PSTR                Text;
+    SIZE_T              TextSize;
+    DWORD               Start;
+    DWORD               Elapsed;
+    DWORD               Timeout;
+    double              Seconds;
+    BOOLEAN             ret;
+    UINT                i;
+
+    /*
+     * started from a console, report there; started any other way, there
+     * is nowhere to report to
+     */
+    if (AttachConsole(ATTACH_PARENT_PROCESS))
+    {
+        (VOID) freopen("CONOUT$", "w", stdout);
+        (VOID) freopen("CONOUT$", "w", stderr);
+    }
+
+    RtlZeroMemory(&Service, sizeof(Service));
+    Service.Duration = INFINITE;
+    TextSize = strlen(CmdLine) + 1;
+    Text = HeapAlloc(hDefaultHeap, 0, TextSize);
+    if (Text == NULL)
+        return 1;
+    StringCchCopyA(Text, TextSize, CmdLine);
+    LJB_VMON_ServiceBlankText(Text);
+    ret = LJB_VMON_ServiceParse(&Service, Text, 0);
+    HeapFree(hDefaultHeap, 0, Text);
+    if (!ret || Service.NumMonitors == 0)
+    {
+        fprintf(stderr, "vmon: usage: vmon.exe /service [/config <file>] "
+            "[/seconds <n>] [<options>] [/monitor <options> ...]\n");
+        ret = FALSE;
+    }
+
+    /*
+     * one service at a time: its monitors are the first device interfaces
+     */
+    if (ret)
+    {
+        g_hServiceStopEvent = CreateEventA(NULL, TRUE, FALSE, LJB_VMON_SERVICE_STOP_EVENT);
+        if (g_hServiceStopEvent == NULL)
+        {
+            fprintf(stderr, "vmon: unable to create the stop event\n");
+            ret = FALSE;
+        }
+        else if (GetLastError() == ERROR_ALREADY_EXISTS)
+        {
+            fprintf(stderr, "vmon: a service is already running\n");
+            ret = FALSE;
+        }
+    }
+
+    NumThreads = 0;
+    if (ret)
+    {
+        SetConsoleCtrlHandler(&LJB_VMON_ServiceCtrlHandler, TRUE);
+        for (i = 0; i < Service.NumMonitors; i++)
+        {
+            pDeviceInfo = Service.Monitors[i];
+            pDeviceInfo->hStopEvent = g_hServiceStopEvent;
+            pDeviceInfo->VMONThread = CreateThread(
+                NULL,
+                0,
+                &LJB_VMON_Main,
+                pDeviceInfo,
+                0,
+                &pDeviceInfo->VMONThreadId
+                );
+            if (pDeviceInfo->VMONThread == NULL)
+            {
+                fprintf(stderr, "vmon: unable to start monitor %u\n", i);
+                continue;
+            }
+            hThreads[NumThreads++] = pDeviceInfo->VMONThread;
+        }
+    }
+
+    /*
+     * until stopped, out of time, or every VMON thread gave up
+     */
+    Start = GetTickCount();
+    while (NumThreads != 0)
+    {
+        Timeout = LJB_VMON_SERVICE_POLL_INTERVAL;
+        if (Service.Duration != INFINITE)
+        {
+            Elapsed = GetTickCount() - Start;
+            if (Elapsed >= Service.Duration)
+                break;
+            if (Service.Duration - Elapsed < Timeout)
+                Timeout = Service.Duration - Elapsed;
+        }
+        if (WaitForSingleObject(g_hServiceStopEvent, Timeout) != WAIT_TIMEOUT)
+            break;
+        if (WaitForMultipleObjects(NumThreads, hThreads, TRUE, 0) != WAIT_TIMEOUT)
+            break;
+    }
+    Elapsed = GetTickCount() - Start;
+
+    if (NumThreads != 0)
+    {
+        SetEvent(g_hServiceStopEvent);
+        WaitForMultipleObjects(NumThreads, hThreads, TRUE, INFINITE);
+    }
+
+    Seconds = (Elapsed != 0) ? Elapsed / 1000.0 : 0.001;
+    for (i = 0; i < Service.NumMonitors; i++)
+    {
+        pDeviceInfo = Service.Monitors[i];
+        if (pDeviceInfo->VMONThread != NULL)
+        {
+            printf("{\"monitor\":%u,\"seconds\":%.1f,\"frames\":%I64u,\"fps\":%.1f,"
+                "\"mbyte_per_s\":%.1f,\"credit_stalls\":%I64u,\"catch_ups\":%I64u}\n",
+                i,
+                Seconds,
+                pDeviceInfo->SinkStats.Reported,
+                pDeviceInfo->SinkStats.Reported / Seconds,
+                pDeviceInfo->SinkStats.ReportedBytes / Seconds / 1e6,
+                pDeviceInfo->SinkStats.CreditStalls,
+                pDeviceInfo->SinkStats.CatchUps
+                );
+            CloseHandle(pDeviceInfo->VMONThread);
+        }
+        HeapFree(hDefaultHeap, 0, pDeviceInfo);
+    }
+    fflush(stdout);
+
+    if (g_hServiceStopEvent != NULL)
+    {
+        SetConsoleCtrlHandler(&LJB_VMON_ServiceCtrlHandler, FALSE);
+        CloseHandle(g_hServiceStopEvent);
+        g_hServiceStopEvent = NULL;
+    }
+    return ret ? 0 : 1;
+}
+
+/*
+ * Name:  LJB_VMON_ServiceStop
+ *
+ * Definition:
+ *    int
+ *    LJB_VMON_ServiceStop(
+ *        VOID
+ *        );
+ *
+ * Description:
+ *    vmon.exe /service_stop: stop the service running in this session.
+ *
+ * Return Value:
+ *    0 if a service was told to stop, 1 if none is running.
+ *
+ */
+int
+LJB_VMON_ServiceStop(
+    VOID
+    )
+{
+    HANDLE  hStopEvent;
+
+    hStopEvent = OpenEventA(EVENT_MODIFY_STATE, FALSE, LJB_VMON_SERVICE_STOP_EVENT);
+    if (hStopEvent == NULL)
+        return 1;
+    SetEvent(hStopEvent);
+    CloseHandle(hStopEvent);
+    return 0;
+}
@@ -0,0 +1,311 @@
+#include "ljb_vmon.h"
+
+/*
+ * The tracer turns on the driver's per-processor trace rings (see
+ * ljb_vmon_trace.h) and, every LJB_VMON_TRACER_DRAIN_INTERVAL ms, drains
+ * them with IOCTL_LJB_VMON_TRACE_DRAIN and appends each drain block to the
+ * trace file as is. It runs on a thread of its own, so the VMON thread,
+ * whose wait request may be pending in the driver at the same time, is
+ * never held up by the file.
+ *
+ * The device handle is opened with FILE_FLAG_OVERLAPPED, and the VMON
+ * thread has I/O of its own outstanding on it, so the tracer waits for its
+ * requests on an event of its own instead of the file handle.
+ */
+static BOOLEAN
+LJB_VMON_TracerIoctl(
+    __inout LJB_VMON_TRACER *           Tracer,
+    __in ULONG                          IoctlCode,
+    __in_opt PVOID                      InputBuffer,
+    __in ULONG                          InputBufferLength,
+    __out PVOID                         OutputBuffer,
+    __in ULONG                          OutputBufferLength,
+    __out ULONG *                       BytesReturned
+    )
+{
+    OVERLAPPED  Overlapped;
+    DWORD       Bytes;
+
+    RtlZeroMemory(&Overlapped, sizeof(Overlapped));
+    Overlapped.hEvent = Tracer->hIoEvent;
+
+    *BytesReturned = 0;
+    if (!DeviceIoControl(
+            Tracer->hDevice,
+            IoctlCode,
+            InputBuffer,
+            InputBufferLength,
+            OutputBuffer,
+            OutputBufferLength,
+            NULL,
+            &Overlapped
+            ) &&
+        GetLastError() != ERROR_IO_PENDING)
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": ioctl(0x%x) failed, error(%u)?\n",
+            IoctlCode, GetLastError()));
+        return FALSE;
+    }
+
+    if (!GetOverlappedResult(Tracer->hDevice, &Overlapped, &Bytes, TRUE))
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": ioctl(0x%x) failed, error(%u)?\n",
+            IoctlCode, GetLastError()));
+        return FALSE;
+    }
+    *BytesReturned = Bytes;
+    return TRUE;
+}
+
+static BOOLEAN
+LJB_VMON_TracerControl(
+    __inout LJB_VMON_TRACER *           Tracer,
+    __in ULONG                          Enable,
+    __out LJB_VMON_TRACE_CONTROL_DATA * ControlData
+    )
+{
+    ULONG   BytesReturned;
+
+    RtlZeroMemory(ControlData, sizeof(*ControlData));
+    ControlData->Enable = Enable;
+    if (!LJB_VMON_TracerIoctl(
+            Tracer,
+            IOCTL_LJB_VMON_TRACE_CONTROL,
+            ControlData,
+            sizeof(*ControlData),
+            ControlData,
+            sizeof(*ControlData),
+            &BytesReturned
+            ))
+        return FALSE;
+    return (BytesReturned == sizeof(*ControlData));
+}
+
+/*
+ * drain until the rings are empty. Every drain block, even one holding only
+ * a drop count, goes into the file.
+ */
+static VOID
+LJB_VMON_TracerDrain(
+    __inout LJB_VMON_TRACER *           Tracer
+    )
+{
+    LJB_VMON_TRACE_DRAIN_DATA * CONST   DrainData = (PVOID) Tracer->Drain;
+    ULONG                               BytesReturned;
+    ULONG                               Size;
+    DWORD                               BytesWritten;
+
+    for (;;)
+    {
+        if (!LJB_VMON_TracerIoctl(
+                Tracer,
+                IOCTL_LJB_VMON_TRACE_DRAIN,
+                NULL,
+                0,
+                Tracer->Drain,
+                Tracer->DrainSize,
+                &BytesReturned
+                ))
+            return;
+        if (BytesReturned < sizeof(*DrainData))
+            return;
+
+        Size = sizeof(*DrainData) +
+            DrainData->NumRecords * sizeof(LJB_VMON_TRACE_RECORD);
+        if (DrainData->NumRecords != 0 || DrainData->DroppedRecords != 0)
+        {
+            if (!WriteFile(Tracer->hFile, Tracer->Drain, Size, &BytesWritten, NULL) ||
+                BytesWritten != Size)
+            {
+                DBG_PRINT(("?" __FUNCTION__ ": WriteFile failed, error(%u)?\n",
+                    GetLastError()));
+            }
+            Tracer->Records += DrainData->NumRecords;
+            Tracer->DroppedRecords += DrainData->DroppedRecords;
+        }
+        if (DrainData->NumRecords == 0)
+            return;
+    }
+}
+
+static DWORD
+WINAPI
+LJB_VMON_TracerThread(
+    __in LPVOID                         Context
+    )
+{
+    LJB_VMON_TRACER * CONST         Tracer = Context;
+    LJB_VMON_TRACE_CONTROL_DATA     ControlData;
+
+    while (WaitForSingleObject(Tracer->hStopEvent, LJB_VMON_TRACER_DRAIN_INTERVAL) == WAIT_TIMEOUT)
+        LJB_VMON_TracerDrain(Tracer);
+
+    /*
+     * stop tracing, then pick up what was logged since the last drain.
+     */
+    (VOID) LJB_VMON_TracerControl(Tracer, 0, &ControlData);
+    LJB_VMON_TracerDrain(Tracer);
+    return 0;
+}
+
+/*
+ * Name:  LJB_VMON_TracerInit
+ *
+ * Definition:
+ *    __checkReturn
+ *    BOOLEAN
+ *    LJB_VMON_TracerInit(
+ *        __out LJB_VMON_TRACER *   Tracer,
+ *        __in HANDLE               hDevice,
+ *        __in PCSTR                FileName
+ *        );
+ *
+ * Description:
+ *    Create the trace file, turn driver tracing on and start the drain
+ *    thread. On failure, the caller still calls LJB_VMON_TracerDeInit.
+ *
+ * Return Value:
+ *    TRUE if tracing to FileName, FALSE otherwise.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_TracerInit(
+    __out LJB_VMON_TRACER *             Tracer,
+    __in HANDLE                         hDevice,
+    __in PCSTR                          FileName
+    )
+{
+    LJB_VMON_TRACE_CONTROL_DATA ControlData;
+    LJB_VMON_TRACE_FILE_HEADER  Header;
+    DWORD                       BytesWritten;
+
+    RtlZeroMemory(Tracer, sizeof(*Tracer));
+    Tracer->hDevice = hDevice;
+
+    Tracer->hFile = CreateFileA(
+        FileName,
+        GENERIC_WRITE,
+        FILE_SHARE_READ,
+        NULL,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+        );
+    if (Tracer->hFile == INVALID_HANDLE_VALUE)
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": unable to create %s, error(%u)?\n",
+            FileName, GetLastError()));
+        Tracer->hFile = NULL;
+        return FALSE;
+    }
+
+    Tracer->hStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    Tracer->hIoEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Tracer->hStopEvent == NULL || Tracer->hIoEvent == NULL)
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": out of resources?\n"));
+        return FALSE;
+    }
+
+    if (!LJB_VMON_TracerControl(Tracer, 1, &ControlData))
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": driver tracing not available?\n"));
+        return FALSE;
+    }
+
+    /*
+     * one drain can return every ring full.
+     */
+    Tracer->DrainSize = sizeof(LJB_VMON_TRACE_DRAIN_DATA) +
+        ControlData.NumCpus * ControlData.RecordsPerCpu * sizeof(LJB_VMON_TRACE_RECORD);
+    Tracer->Drain = HeapAlloc(GetProcessHeap(), 0, Tracer->DrainSize);
+    if (Tracer->Drain == NULL)
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": out of resources?\n"));
+        (VOID) LJB_VMON_TracerControl(Tracer, 0, &ControlData);
+        return FALSE;
+    }
+
+    RtlZeroMemory(&Header, sizeof(Header));
+    RtlCopyMemory(Header.Signature, LJB_VMON_TRACE_SIGNATURE, sizeof(Header.Signature));
+    Header.Version = LJB_VMON_TRACE_VERSION;
+    Header.HeaderSize = sizeof(Header);
+    Header.TimestampFrequency = ControlData.TimestampFrequency;
+    Header.NumCpus = ControlData.NumCpus;
+    Header.RecordSize = sizeof(LJB_VMON_TRACE_RECORD);
+    if (!WriteFile(Tracer->hFile, &Header, sizeof(Header), &BytesWritten, NULL) ||
+        BytesWritten != sizeof(Header))
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": WriteFile failed, error(%u)?\n",
+            GetLastError()));
+        (VOID) LJB_VMON_TracerControl(Tracer, 0, &ControlData);
+        return FALSE;
+    }
+
+    Tracer->hThread = CreateThread(
+        NULL,
+        0,
+        &LJB_VMON_TracerThread,
+        Tracer,
+        0,
+        NULL
+        );
+    if (Tracer->hThread == NULL)
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": unable to create drain thread?\n"));
+        (VOID) LJB_VMON_TracerControl(Tracer, 0, &ControlData);
+        return FALSE;
+    }
+
+    DBG_PRINT((__FUNCTION__ ": tracing %u processors to %s\n",
+        ControlData.NumCpus, FileName));
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_TracerDeInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_TracerDeInit(
+ *        __inout LJB_VMON_TRACER *  Tracer
+ *        );
+ *
+ * Description:
+ *    Stop the drain thread, which turns driver tracing off and drains the
+ *    rings one last time, then close the trace file. Must be called before
+ *    the device handle is closed.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_TracerDeInit(
+    __inout LJB_VMON_TRACER *           Tracer
+    )
+{
+    if (Tracer->hThread != NULL)
+    {
+        SetEvent(Tracer->hStopEvent);
+        WaitForSingleObject(Tracer->hThread, INFINITE);
+        CloseHandle(Tracer->hThread);
+
+        DBG_PRINT((__FUNCTION__ ": %I64u records, %I64u dropped\n",
+            Tracer->Records,
+            Tracer->DroppedRecords
+            ));
+    }
+
+    if (Tracer->hFile != NULL)
+        CloseHandle(Tracer->hFile);
+    if (Tracer->hStopEvent != NULL)
+        CloseHandle(Tracer->hStopEvent);
+    if (Tracer->hIoEvent != NULL)
+        CloseHandle(Tracer->hIoEvent);
+    if (Tracer->Drain != NULL)
+        HeapFree(GetProcessHeap(), 0, Tracer->Drain);
+
+    RtlZeroMemory(Tracer, sizeof(*Tracer));
+}
@@ -0,0 +1,580 @@
+#include "ljb_vmon.h"
+
+/*
+ * The viewer is a sink of the VMON thread (see ljb_vmon_sink.h). Frames
+ * arrive without the cursor and go through DEVICE_INFO.FrameQueue; cursor
+ * shape and position go through DEVICE_INFO.Cursor. Both post a single
+ * coalesced WM_LJB_VMON_UPDATE, and the window procedure composites the
+ * cursor onto the frame it paints. A cursor move therefore costs a
+ * POINTER_POSITION_DATA hand-off instead of a full frame copy.
+ *
+ * The VMON thread keeps, for each slot of the frame queue, what changed
+ * since the slot was last filled, and copies only that into it.
+ *
+ * The window procedure keeps what it shows in a persistent DIB section
+ * (DEVICE_INFO.Surface). Each frame carries the rectangles that changed
+ * since the frame the window procedure last picked up; only those, plus the
+ * rectangles the cursor left and entered, are copied into the DIB section
+ * and blitted to the window. The cursor is drawn into the DIB section and
+ * restored in place before the next update.
+ */
+
+static VOID
+LJB_VMON_ViewerPostUpdate(
+    __in PDEVICE_INFO                   pDeviceInfo
+    )
+{
+    if (InterlockedExchange(&pDeviceInfo->UpdatePosted, 1) == 0)
+    {
+        if (!PostMessage(pDeviceInfo->hParentWnd, WM_LJB_VMON_UPDATE, 0, 0))
+            InterlockedExchange(&pDeviceInfo->UpdatePosted, 0);
+    }
+}
+
+static VOID
+LJB_VMON_ViewerFrameUpdate(
+    __in PVOID                          SinkContext,
+    __in CONST LJB_VMON_SINK_FRAME *    Frame
+    )
+{
+    PDEVICE_INFO CONST      pDeviceInfo = SinkContext;
+    LJB_VMON_FRAME_QUEUE *  FrameQueue = &pDeviceInfo->FrameQueue;
+    LJB_VMON_FRAME_SLOT *   FrameSlot;
+    LJB_VMON_DAMAGE         FrameDamage;
+    LJB_VMON_DAMAGE         CopyDamage;
+    LJB_VMON_RECT           Rect;
+    UINT                    Slot;
+    UINT                    row;
+    UINT                    i;
+
+    if (Frame->Damage != NULL)
+        FrameDamage = *Frame->Damage;
+    else
+        LJB_VMON_DamageSetFull(&FrameDamage, Frame->Width, Frame->Height);
+
+    /*
+     * a slot holds the frame it was last filled with, possibly older than
+     * the one the window procedure last picked up; what changed since then
+     * is all that needs copying into it. A slot of another size, or never
+     * filled, gets the whole frame.
+     */
+    Slot = FrameQueue->WriteIndex;
+    if (FrameQueue->Slots[Slot].Buffer == NULL ||
+        FrameQueue->Slots[Slot].Width != Frame->Width ||
+        FrameQueue->Slots[Slot].Height != Frame->Height)
+        pDeviceInfo->SlotEmpty[Slot] = TRUE;
+
+    FrameSlot = LJB_VMON_FrameQueueGetWriteSlot(
+        FrameQueue,
+        Frame->Width,
+        Frame->Height
+        );
+    if (FrameSlot == NULL)
+    {
+        /*
+         * the next frame is relative to this one all the same
+         */
+        for (i = 0; i < LJB_VMON_FRAME_QUEUE_DEPTH; i++)
+            LJB_VMON_DamageAddDamage(&pDeviceInfo->SlotDamage[i], &FrameDamage);
+        LJB_VMON_DamageAddDamage(&pDeviceInfo->UnseenDamage, &FrameDamage);
+        return;
+    }
+
+    if (pDeviceInfo->SlotEmpty[Slot])
+        LJB_VMON_DamageSetFull(&CopyDamage, Frame->Width, Frame->Height);
+    else
+    {
+        CopyDamage = pDeviceInfo->SlotDamage[Slot];
+        LJB_VMON_DamageAddDamage(&CopyDamage, &FrameDamage);
+    }
+    for (i = 0; i < CopyDamage.NumRects; i++)
+    {
+        Rect = CopyDamage.Rects[i];
+        if (Rect.Left < 0)
+            Rect.Left = 0;
+        if (Rect.Top < 0)
+            Rect.Top = 0;
+        if (Rect.Right > (LONG) Frame->Width)
+            Rect.Right = (LONG) Frame->Width;
+        if (Rect.Bottom > (LONG) Frame->Height)
+            Rect.Bottom = (LONG) Frame->Height;
+        if (Rect.Right <= Rect.Left || Rect.Bottom <= Rect.Top)
+            continue;
+        for (row = (UINT) Rect.Top; row < (UINT) Rect.Bottom; row++)
+        {
+            RtlCopyMemory(
+                (UCHAR *) FrameSlot->Buffer + ((SIZE_T) row * Frame->Width + Rect.Left) * 4,
+                (CONST UCHAR *) Frame->Buffer + (SIZE_T) row * Frame->Pitch + Rect.Left * 4,
+                (Rect.Right - Rect.Left) * 4
+                );
+        }
+        pDeviceInfo->CopyBytes += (ULONG64) (Rect.Right - Rect.Left) * (Rect.Bottom - Rect.Top) * 4;
+    }
+    pDeviceInfo->SlotEmpty[Slot] = FALSE;
+    LJB_VMON_DamageReset(&pDeviceInfo->SlotDamage[Slot]);
+    for (i = 0; i < LJB_VMON_FRAME_QUEUE_DEPTH; i++)
+    {
+        if (i != Slot)
+            LJB_VMON_DamageAddDamage(&pDeviceInfo->SlotDamage[i], &FrameDamage);
+    }
+    FrameSlot->FrameId = Frame->FrameId;
+
+    /*
+     * The window procedure may skip frames. Until it is known to have picked
+     * one up, the damage of every later frame has to be carried along.
+     */
+    LJB_VMON_DamageAddDamage(&pDeviceInfo->UnseenDamage, &FrameDamage);
+    FrameSlot->Damage = pDeviceInfo->UnseenDamage;
+
+    if (LJB_VMON_FrameQueuePublish(&pDeviceInfo->FrameQueue))
+        pDeviceInfo->UnseenDamage = FrameDamage;
+    LJB_VMON_ViewerPostUpdate(pDeviceInfo);
+}
+
+static VOID
+LJB_VMON_ViewerCursorShape(
+    __in PVOID                          SinkContext,
+    __in CONST POINTER_SHAPE_DATA *     PointerShapeData
+    )
+{
+    PDEVICE_INFO CONST  pDeviceInfo = SinkContext;
+    SIZE_T CONST        ShapeSize = LJB_VMON_CursorShapeSize(PointerShapeData);
+
+    EnterCriticalSection(&pDeviceInfo->Cursor.Lock);
+    RtlCopyMemory(
+        &pDeviceInfo->Cursor.Shape,
+        PointerShapeData,
+        FIELD_OFFSET(POINTER_SHAPE_DATA, Buffer) + ShapeSize
+        );
+    pDeviceInfo->Cursor.ShapeChanged = TRUE;
+    LeaveCriticalSection(&pDeviceInfo->Cursor.Lock);
+
+    if (pDeviceInfo->Cursor.Position.Visible)
+        LJB_VMON_ViewerPostUpdate(pDeviceInfo);
+}
+
+static VOID
+LJB_VMON_ViewerCursorPosition(
+    __in PVOID                          SinkContext,
+    __in CONST POINTER_POSITION_DATA *  PointerPositionData
+    )
+{
+    PDEVICE_INFO CONST  pDeviceInfo = SinkContext;
+
+    EnterCriticalSection(&pDeviceInfo->Cursor.Lock);
+    pDeviceInfo->Cursor.Position = *PointerPositionData;
+    LeaveCriticalSection(&pDeviceInfo->Cursor.Lock);
+
+    LJB_VMON_ViewerPostUpdate(pDeviceInfo);
+}
+
+static VOID
+LJB_VMON_ViewerSurfaceDestroy(
+    __inout LJB_VMON_VIEWER_SURFACE *   pSurface
+    )
+{
+    if (pSurface->hMemDC != NULL)
+    {
+        if (pSurface->hOldBitmap != NULL)
+            SelectObject(pSurface->hMemDC, pSurface->hOldBitmap);
+        DeleteDC(pSurface->hMemDC);
+    }
+    if (pSurface->hDib != NULL)
+        DeleteObject(pSurface->hDib);
+
+    pSurface->hMemDC = NULL;
+    pSurface->hDib = NULL;
+    pSurface->hOldBitmap = NULL;
+    pSurface->Bits = NULL;
+    pSurface->Width = 0;
+    pSurface->Height = 0;
+}
+
+static BOOLEAN
+LJB_VMON_ViewerSurfaceCreate(
+    __inout LJB_VMON_VIEWER_SURFACE *   pSurface,
+    __in ULONG                          Width,
+    __in ULONG                          Height
+    )
+{
+    BITMAPINFO  BitmapInfo;
+    PVOID       Bits;
+
+    LJB_VMON_ViewerSurfaceDestroy(pSurface);
+
+    RtlZeroMemory(&BitmapInfo, sizeof(BitmapInfo));
+    BitmapInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    BitmapInfo.bmiHeader.biWidth = (LONG) Width;
+    BitmapInfo.bmiHeader.biHeight = -(LONG) Height;     // top down
+    BitmapInfo.bmiHeader.biPlanes = 1;
+    BitmapInfo.bmiHeader.biBitCount = 32;
+    BitmapInfo.bmiHeader.biCompression = BI_RGB;
+
+    pSurface->hMemDC = CreateCompatibleDC(NULL);
+    if (pSurface->hMemDC == NULL)
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": CreateCompatibleDC failed?\n"));
+        return FALSE;
+    }
+
+    pSurface->hDib = CreateDIBSection(
+        pSurface->hMemDC,
+        &BitmapInfo,
+        DIB_RGB_COLORS,
+        &Bits,
+        NULL,
+        0
+        );
+    if (pSurface->hDib == NULL)
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": CreateDIBSection(%u, %u) failed?\n",
+            Width, Height));
+        LJB_VMON_ViewerSurfaceDestroy(pSurface);
+        return FALSE;
+    }
+
+    pSurface->hOldBitmap = SelectObject(pSurface->hMemDC, pSurface->hDib);
+    pSurface->Bits = Bits;
+    pSurface->Width = Width;
+    pSurface->Height = Height;
+    return TRUE;
+}
+
+/*
+ * copy one rectangle of a frame into the DIB section, clipped to both.
+ */
+static BOOLEAN
+LJB_VMON_ViewerSurfaceCopyRect(
+    __inout LJB_VMON_VIEWER_SURFACE *   pSurface,
+    __in CONST LJB_VMON_FRAME_SLOT *    FrameSlot,
+    __inout LJB_VMON_RECT *             Rect
+    )
+{
+    CONST ULONG *   pSrc;
+    ULONG *         pDst;
+    LONG            row;
+
+    if (Rect->Left < 0)
+        Rect->Left = 0;
+    if (Rect->Top < 0)
+        Rect->Top = 0;
+    if (Rect->Right > (LONG) pSurface->Width)
+        Rect->Right = (LONG) pSurface->Width;
+    if (Rect->Bottom > (LONG) pSurface->Height)
+        Rect->Bottom = (LONG) pSurface->Height;
+    if (Rect->Right <= Rect->Left || Rect->Bottom <= Rect->Top)
+        return FALSE;
+
+    pSrc = (CONST ULONG *) FrameSlot->Buffer + (SIZE_T) Rect->Top * FrameSlot->Width + Rect->Left;
+    pDst = pSurface->Bits + (SIZE_T) Rect->Top * pSurface->Width + Rect->Left;
+    for (row = Rect->Top; row < Rect->Bottom; row++)
+    {
+        RtlCopyMemory(pDst, pSrc, (Rect->Right - Rect->Left) * 4);
+        pSrc += FrameSlot->Width;
+        pDst += pSurface->Width;
+    }
+    return TRUE;
+}
+
+static VOID
+LJB_VMON_ViewerSurfacePaint(
+    __inout LJB_VMON_VIEWER_SURFACE *   pSurface,
+    __in HDC                            hdc,
+    __in CONST LJB_VMON_DAMAGE *        Damage
+    )
+{
+    CONST LJB_VMON_RECT *   pRect;
+    UINT                    i;
+
+    for (i = 0; i < Damage->NumRects; i++)
+    {
+        pRect = &Damage->Rects[i];
+        BitBlt(
+            hdc,
+            pRect->Left,
+            pRect->Top,
+            pRect->Right - pRect->Left,
+            pRect->Bottom - pRect->Top,
+            pSurface->hMemDC,
+            pRect->Left,
+            pRect->Top,
+            SRCCOPY
+            );
+    }
+    pSurface->Paints++;
+    pSurface->PaintRects += Damage->NumRects;
+    pSurface->PaintBytes += LJB_VMON_DamageArea(Damage) * 4;
+}
+
+/*
+ * Name:  LJB_VMON_ViewerInit
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_ViewerInit(
+ *        __inout PDEVICE_INFO      pDeviceInfo
+ *        );
+ *
+ * Description:
+ *    Initialize the frame queue and the cursor plane of a device.
+ *
+ * Return Value:
+ *    Return TRUE if success. Return FALSE otherwise.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_ViewerInit(
+    __inout PDEVICE_INFO                pDeviceInfo
+    )
+{
+    UINT    i;
+
+    LJB_VMON_FrameQueueInit(&pDeviceInfo->FrameQueue);
+    pDeviceInfo->UpdatePosted = 0;
+    LJB_VMON_DamageReset(&pDeviceInfo->UnseenDamage);
+    for (i = 0; i < LJB_VMON_FRAME_QUEUE_DEPTH; i++)
+    {
+        LJB_VMON_DamageReset(&pDeviceInfo->SlotDamage[i]);
+        pDeviceInfo->SlotEmpty[i] = TRUE;
+    }
+    pDeviceInfo->CopyBytes = 0;
+    RtlZeroMemory(&pDeviceInfo->Surface, sizeof(pDeviceInfo->Surface));
+    if (!LJB_VMON_CursorInit(&pDeviceInfo->Cursor.Compositor))
+    {
+        DBG_PRINT(("?" __FUNCTION__ ": unable to allocate cursor compositor?\n"));
+        return FALSE;
+    }
+    InitializeCriticalSection(&pDeviceInfo->Cursor.Lock);
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_ViewerDeInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_ViewerDeInit(
+ *        __inout PDEVICE_INFO      pDeviceInfo
+ *        );
+ *
+ * Description:
+ *    Release everything LJB_VMON_ViewerInit set up. The VMON thread must no
+ *    longer report to the viewer sink.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_ViewerDeInit(
+    __inout PDEVICE_INFO                pDeviceInfo
+    )
+{
+    DBG_PRINT((__FUNCTION__ ": %I64u paints, %I64u rects, %I64u bytes, "
+        "%I64u bytes copied into the frame queue\n",
+        pDeviceInfo->Surface.Paints,
+        pDeviceInfo->Surface.PaintRects,
+        pDeviceInfo->Surface.PaintBytes,
+        pDeviceInfo->CopyBytes
+        ));
+    LJB_VMON_ViewerSurfaceDestroy(&pDeviceInfo->Surface);
+
+    if (pDeviceInfo->Cursor.Compositor.ArenaAllocation != NULL)
+    {
+        LJB_VMON_CursorDeInit(&pDeviceInfo->Cursor.Compositor);
+        DeleteCriticalSection(&pDeviceInfo->Cursor.Lock);
+    }
+    LJB_VMON_FrameQueueDeInit(&pDeviceInfo->FrameQueue);
+}
+
+/*
+ * Name:  LJB_VMON_ViewerGetSink
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_ViewerGetSink(
+ *        __in PDEVICE_INFO         pDeviceInfo,
+ *        __out LJB_VMON_SINK *     Sink
+ *        );
+ *
+ * Description:
+ *    Return the sink through which the VMON thread feeds the viewer.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_ViewerGetSink(
+    __in PDEVICE_INFO                   pDeviceInfo,
+    __out LJB_VMON_SINK *               Sink
+    )
+{
+    RtlZeroMemory(Sink, sizeof(*Sink));
+    Sink->SinkContext = pDeviceInfo;
+    Sink->pfnFrameUpdate = LJB_VMON_ViewerFrameUpdate;
+    Sink->pfnCursorShape = LJB_VMON_ViewerCursorShape;
+    Sink->pfnCursorPosition = LJB_VMON_ViewerCursorPosition;
+}
+
+/*
+ * Name:  LJB_VMON_ViewerPresent
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_ViewerPresent(
+ *        __inout PDEVICE_INFO      pDeviceInfo,
+ *        __in HWND                 hWnd
+ *        );
+ *
+ * Description:
+ *    Window procedure side of WM_LJB_VMON_UPDATE. Pick up the latest frame
+ *    and cursor state, bring the DIB section up to date and repaint the
+ *    damaged rectangles of hWnd.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_ViewerPresent(
+    __inout PDEVICE_INFO                pDeviceInfo,
+    __in HWND                           hWnd
+    )
+{
+    LJB_VMON_VIEWER_CURSOR * CONST  pCursor = &pDeviceInfo->Cursor;
+    LJB_VMON_VIEWER_SURFACE * CONST pSurface = &pDeviceInfo->Surface;
+    LJB_VMON_FRAME_SLOT *           FrameSlot;
+    POINTER_POSITION_DATA           Position;
+    BOOLEAN                         NewFrame;
+    LJB_VMON_DAMAGE                 Damage;
+    LJB_VMON_RECT                   Rect;
+    HDC                             hdc;
+    UINT                            i;
+
+    /*
+     * Re-arm the notification before picking anything up, so an update
+     * reported while we paint posts a new WM_LJB_VMON_UPDATE.
+     */
+    InterlockedExchange(&pDeviceInfo->UpdatePosted, 0);
+
+    FrameSlot = LJB_VMON_FrameQueueAcquireLatest(&pDeviceInfo->FrameQueue, &NewFrame);
+    LJB_VMON_DamageReset(&Damage);
+
+    /*
+     * GDI may still be reading the DIB section from the previous paint.
+     */
+    GdiFlush();
+
+    if (FrameSlot != NULL &&
+        (FrameSlot->Width != pSurface->Width || FrameSlot->Height != pSurface->Height))
+    {
+        LJB_VMON_CursorDiscardSave(&pCursor->Compositor);
+        if (LJB_VMON_ViewerSurfaceCreate(pSurface, FrameSlot->Width, FrameSlot->Height))
+        {
+            RtlCopyMemory(
+                pSurface->Bits,
+                FrameSlot->Buffer,
+                (SIZE_T) FrameSlot->Width * FrameSlot->Height * 4
+                );
+            LJB_VMON_DamageSetFull(&Damage, FrameSlot->Width, FrameSlot->Height);
+        }
+    }
+    else if (pSurface->Bits != NULL)
+    {
+        if (pCursor->Compositor.Saved)
+        {
+            Rect.Left = (LONG) pCursor->Compositor.SavedX;
+            Rect.Top = (LONG) pCursor->Compositor.SavedY;
+            Rect.Right = Rect.Left + (LONG) pCursor->Compositor.SavedWidth;
+            Rect.Bottom = Rect.Top + (LONG) pCursor->Compositor.SavedHeight;
+            LJB_VMON_DamageAddRect(&Damage, &Rect);
+            LJB_VMON_CursorRestore(&pCursor->Compositor);
+        }
+        if (NewFrame && FrameSlot != NULL)
+        {
+            for (i = 0; i < FrameSlot->Damage.NumRects; i++)
+            {
+                Rect = FrameSlot->Damage.Rects[i];
+                if (LJB_VMON_ViewerSurfaceCopyRect(pSurface, FrameSlot, &Rect))
+                    LJB_VMON_DamageAddRect(&Damage, &Rect);
+            }
+        }
+    }
+
+    EnterCriticalSection(&pCursor->Lock);
+    if (pCursor->ShapeChanged)
+    {
+        LJB_VMON_CursorSetShape(&pCursor->Compositor, &pCursor->Shape);
+        pCursor->ShapeChanged = FALSE;
+    }
+    Position = pCursor->Position;
+    LeaveCriticalSection(&pCursor->Lock);
+
+    if (pSurface->Bits == NULL)
+        return;
+
+    if (Position.Visible)
+    {
+        LJB_VMON_CursorDraw(
+            &pCursor->Compositor,
+            Position.X,
+            Position.Y,
+            pSurface->Bits,
+            pSurface->Width,
+            pSurface->Height
+            );
+        if (pCursor->Compositor.Saved)
+        {
+            Rect.Left = (LONG) pCursor->Compositor.SavedX;
+            Rect.Top = (LONG) pCursor->Compositor.SavedY;
+            Rect.Right = Rect.Left + (LONG) pCursor->Compositor.SavedWidth;
+            Rect.Bottom = Rect.Top + (LONG) pCursor->Compositor.SavedHeight;
+            LJB_VMON_DamageAddRect(&Damage, &Rect);
+        }
+    }
+
+    if (Damage.NumRects == 0)
+        return;
+
+    hdc = GetDC(hWnd);
+    if (hdc == NULL)
+        return;
+    LJB_VMON_ViewerSurfacePaint(pSurface, hdc, &Damage);
+    ReleaseDC(hWnd, hdc);
+}
+
+/*
+ * Name:  LJB_VMON_ViewerPaintAll
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_ViewerPaintAll(
+ *        __inout PDEVICE_INFO      pDeviceInfo,
+ *        __in HDC                  hdc
+ *        );
+ *
+ * Description:
+ *    Repaint everything the viewer shows, e.g. after the window was
+ *    uncovered. Nothing is picked up from the VMON thread.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_ViewerPaintAll(
+    __inout PDEVICE_INFO                pDeviceInfo,
+    __in HDC                            hdc
+    )
+{
+    LJB_VMON_VIEWER_SURFACE * CONST pSurface = &pDeviceInfo->Surface;
+    LJB_VMON_DAMAGE                 Damage;
+
+    if (pSurface->Bits == NULL)
+        return;
+
+    LJB_VMON_DamageSetFull(&Damage, pSurface->Width, pSurface->Height);
+    LJB_VMON_ViewerSurfacePaint(pSurface, hdc, &Damage);
+}
@@ -20,19 +20,22 @@ LJB_VMON_Main(
     }
 
     /*
-     * Check the existence of the device
+     * Check the existence of the device, the one pDeviceInfo->MonitorIndex
+     * says
      */
+    dev_ctx->pDeviceInfo = pDeviceInfo;
     bRet = LJB_VMON_GetDeviceHandle(dev_ctx);
     if (bRet)
     {
-        dev_ctx->pDeviceInfo = pDeviceInfo;
         pDeviceInfo->dev_ctx = dev_ctx;
         dev_ctx->exit_vmon_thread = FALSE;
         LJB_VMON_PixelMain(dev_ctx);
 
         // stop
         LJB_VMON_CloseDeviceHandle(dev_ctx);
+        pDeviceInfo->SinkStats = dev_ctx->Sinks.Stats;
     }
+    pDeviceInfo->dev_ctx = NULL;
     HeapFree(hDefaultHeap, 0, dev_ctx);
 
     return 1;
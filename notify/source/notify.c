@@ -74,6 +74,7 @@ UINT        ListBoxIndex = 0;
 GUID        InterfaceGuid;// = LJB_MONITOR_INTERFACE_GUID;
 BOOLEAN     Verbose= FALSE;
 PDEVICE_INFO   gDeviceInfo = NULL;
+WNDPROC     ListBoxWndProc = NULL;
 
 
 _inline BOOLEAN
@@ -97,58 +98,6 @@ IsValid(
     return FALSE;
 }
 
-void makebmp(BYTE* pBits, long width, long height, HDC hdc, HWND hWnd)
-{
-    int                 iRet;
-    RECT                rect;
-    BOOL                Status;
-    BITMAPINFO          BitmapInfo;
-    BITMAPINFO * CONST  pBMI = &BitmapInfo;
-
-    memset(pBMI, 0, sizeof(BITMAPINFO));
-    pBMI->bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-
-    pBMI->bmiHeader.biWidth = width;
-    pBMI->bmiHeader.biHeight = -height;  // negative means top down!!!!
-    pBMI->bmiHeader.biPlanes = 1;
-    pBMI->bmiHeader.biBitCount = 32;
-    pBMI->bmiHeader.biCompression = BI_RGB;//BI_BITFIELDS;//BI_RGB;
-    pBMI->bmiHeader.biSizeImage = width*height*4;
-    pBMI->bmiHeader.biXPelsPerMeter = 0;
-    pBMI->bmiHeader.biYPelsPerMeter = 0;
-    pBMI->bmiHeader.biClrUsed = 0;
-    pBMI->bmiHeader.biClrImportant = 0;
-
-    //memcpy(pBMI+ sizeof(BITMAPINFOHEADER), bmiColors, sizeof(RGBQUAD)*3);
-    Status = GetWindowRect(
-        hWnd,
-        &rect
-        );
-
-    if (Status == 0)
-    {
-        DBG_PRINT(("?"__FUNCTION__":Failed to get rect?\n"));
-    }
-    else
-    {
-        iRet = StretchDIBits(
-            hdc,
-            0,//rect.left,//0,
-            0,//rect.top,//0,
-            width,//rect.right - rect.left,//width,
-            height,//rect.bottom - rect.top,//height,
-            0,
-            0,
-            width,
-            height,
-            pBits,
-            pBMI,
-            DIB_RGB_COLORS,//DIB_PAL_COLORS,
-            SRCCOPY
-            );
-    }
-}
-
 int PASCAL
 WinMain (
     __in HINSTANCE hInstance,
@@ -159,12 +108,11 @@ WinMain (
 {
     static    TCHAR szAppName[]=TEXT("LJB_VMON Notify");
     PDEVICE_INFO deviceInfo;
+    PCSTR     BadOption;
     HWND      hWnd;
     MSG       msg;
     WNDCLASS  wndclass;
 
-    UNREFERENCED_PARAMETER( lpCmdLine );
-
     InterfaceGuid = LJB_MONITOR_INTERFACE_GUID;
     hInst=hInstance;
 
@@ -172,12 +120,51 @@ WinMain (
     g_pDebugHandler = AddVectoredExceptionHandler(1, LJB_VMON_VectorHandler);
 #endif
 
+    //
+    // vmon.exe /service [<options>] runs the monitors with no window, until
+    // vmon.exe /service_stop. See ljb_vmon_service.c.
+    //
+    if (lpCmdLine != NULL && strncmp(lpCmdLine, "/service_stop", 13) == 0)
+        return LJB_VMON_ServiceStop();
+    if (lpCmdLine != NULL && strncmp(lpCmdLine, "/service", 8) == 0 &&
+        (lpCmdLine[8] == ' ' || lpCmdLine[8] == '\0'))
+        return LJB_VMON_ServiceMain(lpCmdLine + 8);
+
     deviceInfo = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(DEVICE_INFO));
     if(!deviceInfo)
         return FALSE;
 
+    //
+    // vmon.exe /record, /stream, /idle and the like, as many as the one
+    // monitor takes. See LJB_VMON_ParseOption.
+    //
+    deviceInfo->IdleDelay = LJB_VMON_DEFAULT_IDLE_DELAY;
+    if (lpCmdLine != NULL &&
+        !LJB_VMON_ParseOptions(deviceInfo, lpCmdLine, &BadOption))
+    {
+        CHAR    Message[256];
+
+        StringCchPrintfA(
+            Message,
+            sizeof(Message),
+            "Bad option at \"%.64s\".\n\n"
+            "usage: vmon.exe [<options>]\n"
+            "       vmon.exe /service [/config <file>] [/seconds <n>] [<options>] [/monitor <options> ...]",
+            BadOption
+            );
+        MessageBoxA(NULL, Message, "vmon", MB_OK | MB_ICONERROR);
+        HeapFree(GetProcessHeap(), 0, deviceInfo);
+        return FALSE;
+    }
+
     InitializeListHead(&ListHead);
     InitializeListHead(&deviceInfo->ListEntry);
+    if (!LJB_VMON_ViewerInit(deviceInfo))
+    {
+        LJB_VMON_ViewerDeInit(deviceInfo);
+        HeapFree(GetProcessHeap(), 0, deviceInfo);
+        return FALSE;
+    }
     InsertTailList(&ListHead, &deviceInfo->ListEntry);
 
     if (!hPrevInstance)
@@ -210,19 +197,23 @@ WinMain (
         NULL);
 
     /*
-     * create VMON main thread.
+     * create VMON main thread, with the event Cleanup stops it by.
      */
     deviceInfo->hWndList = hWndList;
     deviceInfo->hParentWnd = hWnd;
     gDeviceInfo = deviceInfo;
-    deviceInfo->VMONThread = CreateThread(
-        NULL,
-        0,      /* use default statck size */
-        &LJB_VMON_Main,
-        deviceInfo,
-        0,       /* the thread runs after completion */
-        &deviceInfo->VMONThreadId
-        );
+    deviceInfo->hStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (deviceInfo->hStopEvent != NULL)
+    {
+        deviceInfo->VMONThread = CreateThread(
+            NULL,
+            0,      /* use default statck size */
+            &LJB_VMON_Main,
+            deviceInfo,
+            0,       /* the thread runs after completion */
+            &deviceInfo->VMONThreadId
+            );
+    }
 
     ShowWindow(hWnd, nShowCmd);
     UpdateWindow(hWnd);
@@ -249,32 +240,13 @@ WndProc(
     DWORD nEventType = (DWORD)wParam;
     PDEV_BROADCAST_HDR p = (PDEV_BROADCAST_HDR) lParam;
     DEV_BROADCAST_DEVICEINTERFACE filter;
-    // For WM_PAINT
-    PAINTSTRUCT ps;
-    HDC hdc;
 
     switch (message)
     {
-    case WM_PAINT:
-        if (gDeviceInfo != NULL && gDeviceInfo->BitmapBuffer != NULL &&
-            wParam == LPARAM_NOTIFY_FRAME_UPDATE)
-        {
-            //hdc = BeginPaint(hWndList, &ps);
-            hdc = GetDC(hWndList);
-            makebmp(
-                gDeviceInfo->BitmapBuffer,  // pBits,
-                gDeviceInfo->Width,         //width,
-                gDeviceInfo->Height,        //height,
-                hdc,
-                hWndList
-                );
-            ReleaseDC(
-                hWndList,
-                hdc
-                );
-            //EndPaint(hWndList, &ps);
-        }
-        return DefWindowProc(hWnd,message, wParam, lParam);
+    case WM_LJB_VMON_UPDATE:
+        if (gDeviceInfo != NULL)
+            LJB_VMON_ViewerPresent(gDeviceInfo, hWndList);
+        return 0;
 
     case WM_COMMAND:
             HandleCommands(hWnd, message, wParam, lParam);
@@ -299,6 +271,19 @@ WndProc(
                          (HMENU)ID_EDIT,
                          hInst,
                          NULL);
+
+            //
+            // The viewer only repaints what changed; the list box has to
+            // get the whole picture back whenever it repaints itself.
+            //
+            if (hWndList != NULL)
+            {
+                ListBoxWndProc = (WNDPROC) SetWindowLongPtr(
+                    hWndList,
+                    GWLP_WNDPROC,
+                    (LONG_PTR) ListWndProc
+                    );
+            }
             return 0;
 
     case WM_SIZE:
@@ -340,6 +325,31 @@ WndProc(
 }
 
 
+LRESULT
+FAR PASCAL
+ListWndProc(
+    HWND hWnd,
+    UINT message,
+    WPARAM wParam,
+    LPARAM lParam
+    )
+{
+    LRESULT lResult;
+    HDC     hdc;
+
+    lResult = CallWindowProc(ListBoxWndProc, hWnd, message, wParam, lParam);
+    if (message == WM_PAINT && gDeviceInfo != NULL)
+    {
+        hdc = GetDC(hWnd);
+        if (hdc != NULL)
+        {
+            LJB_VMON_ViewerPaintAll(gDeviceInfo, hdc);
+            ReleaseDC(hWnd, hdc);
+        }
+    }
+    return lResult;
+}
+
 LRESULT
 HandleCommands(
     HWND     hWnd,
@@ -454,6 +464,25 @@ BOOLEAN Cleanup(HWND hWnd)
     {
         thisEntry = RemoveHeadList(&ListHead);
         deviceInfo = CONTAINING_RECORD(thisEntry, DEVICE_INFO, ListEntry);
+
+        /*
+         * the VMON thread uses the frame queue and the cursor the viewer
+         * frees, so it is gone first. It only posts to the window, so
+         * waiting for it here cannot deadlock.
+         */
+        if (deviceInfo->VMONThread != NULL)
+        {
+            SetEvent(deviceInfo->hStopEvent);
+            WaitForSingleObject(deviceInfo->VMONThread, INFINITE);
+            CloseHandle(deviceInfo->VMONThread);
+            deviceInfo->VMONThread = NULL;
+        }
+        if (deviceInfo->hStopEvent != NULL)
+        {
+            CloseHandle(deviceInfo->hStopEvent);
+            deviceInfo->hStopEvent = NULL;
+        }
+
         if (deviceInfo->hHandleNotification)
         {
             UnregisterDeviceNotification(deviceInfo->hHandleNotification);
@@ -468,6 +497,7 @@ BOOLEAN Cleanup(HWND hWnd)
             DBG_PRINT(("Closed handle to device %ws",
                 deviceInfo->DeviceName));
         }
+        LJB_VMON_ViewerDeInit(deviceInfo);
         HeapFree(GetProcessHeap(), 0, deviceInfo);
     }
     return TRUE;
@@ -72,6 +72,14 @@ WndProc (
     LPARAM lParam
     );
 
+LRESULT FAR PASCAL
+ListWndProc (
+    HWND hwnd,
+    UINT message,
+    WPARAM wParam,
+    LPARAM lParam
+    );
+
 LRESULT
 HandleCommands(
     HWND     hWnd,
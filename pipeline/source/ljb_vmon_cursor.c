@@ -0,0 +1,615 @@
+#include "ljb_vmon_cursor.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define LJB_VMON_CURSOR_SSE2        1
+#else
+#define LJB_VMON_CURSOR_SSE2        0
+#endif
+
+/*
+ * All three DXGK pointer formats are reduced, once per shape, to one of two
+ * per-pixel operations:
+ *
+ *   AND/XOR (monochrome and masked color cursors)
+ *      Dst = (Dst & AndPlane) ^ XorPlane
+ *
+ *      A monochrome AND/XOR bit pair is expanded to 0 or 0xFFFFFFFF. A masked
+ *      color pixel with mask 0 becomes AND=0xFF000000, XOR=RGB (replace the
+ *      color, keep the surface alpha byte); with mask 0xFF it becomes
+ *      AND=0xFFFFFFFF, XOR=RGB (XOR the color, keep the surface alpha byte).
+ *
+ *   premultiplied blend (color cursors)
+ *      Dst = Dst + (CurPremult - Dst * CurAlpha) / 255
+ *
+ *      CurPremult holds Cur * CurAlpha per channel as 16 bit lanes, so the
+ *      per-draw work is one multiply per channel. The alpha lane of both
+ *      planes is 0, which leaves the surface alpha byte untouched. The
+ *      division truncates toward zero, which makes the result identical to
+ *      the original straight-alpha formula Surf + ((Cur - Surf) * A) / 255.
+ *
+ * The planes live in ShapePlanes with a pitch of Width pixels.
+ */
+#define CURSOR_AND_PLANE(c)         ((ULONG *) (c)->ShapePlanes)
+#define CURSOR_XOR_PLANE(c)         (CURSOR_AND_PLANE(c) + LJB_VMON_CURSOR_MAX_PIXELS)
+#define CURSOR_PREMULT_PLANE(c)     ((USHORT *) (c)->ShapePlanes)
+#define CURSOR_ALPHA_PLANE(c)       (CURSOR_PREMULT_PLANE(c) + LJB_VMON_CURSOR_MAX_PIXELS * 4)
+
+#define CURSOR_SAVE_BUFFER_SIZE     (LJB_VMON_CURSOR_MAX_PIXELS * 4)
+#define CURSOR_SHAPE_PLANES_SIZE    (LJB_VMON_CURSOR_MAX_PIXELS * 16)
+
+static VOID
+CursorAndXorRow(
+    __inout ULONG *                 Dst,
+    __in CONST ULONG *              AndPlane,
+    __in CONST ULONG *              XorPlane,
+    __in UINT                       Count
+    )
+{
+    UINT    i;
+
+    for (i = 0; i < Count; i++)
+        Dst[i] = (Dst[i] & AndPlane[i]) ^ XorPlane[i];
+}
+
+static VOID
+CursorBlendRow(
+    __inout ULONG *                 Dst,
+    __in CONST USHORT *             Premult,
+    __in CONST USHORT *             Alpha,
+    __in UINT                       Count
+    )
+{
+    UCHAR * CONST   pDst = (UCHAR *) Dst;
+    UINT            i;
+    INT             Surf;
+
+    for (i = 0; i < Count * 4; i++)
+    {
+        Surf = pDst[i];
+        pDst[i] = (UCHAR) (Surf + ((INT) Premult[i] - Surf * (INT) Alpha[i]) / 255);
+    }
+}
+
+#if LJB_VMON_CURSOR_SSE2
+static VOID
+CursorAndXorRowSse2(
+    __inout ULONG *                 Dst,
+    __in CONST ULONG *              AndPlane,
+    __in CONST ULONG *              XorPlane,
+    __in UINT                       Count
+    )
+{
+    __m128i D, A, X;
+    UINT    i;
+
+    for (i = 0; i + 4 <= Count; i += 4)
+    {
+        D = _mm_loadu_si128((__m128i const *) (Dst + i));
+        A = _mm_loadu_si128((__m128i const *) (AndPlane + i));
+        X = _mm_loadu_si128((__m128i const *) (XorPlane + i));
+        _mm_storeu_si128((__m128i *) (Dst + i), _mm_xor_si128(_mm_and_si128(D, A), X));
+    }
+    CursorAndXorRow(Dst + i, AndPlane + i, XorPlane + i, Count - i);
+}
+
+/*
+ * exact floor(p / 255) for 0 <= p <= 255 * 255, on eight 16 bit lanes
+ */
+#define CURSOR_DIV255_EPU16(p, one) \
+    _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16((p), (one)), _mm_srli_epi16((p), 8)), 8)
+
+static VOID
+CursorBlendRowSse2(
+    __inout ULONG *                 Dst,
+    __in CONST USHORT *             Premult,
+    __in CONST USHORT *             Alpha,
+    __in UINT                       Count
+    )
+{
+    __m128i CONST   Zero = _mm_setzero_si128();
+    __m128i CONST   One = _mm_set1_epi16(1);
+    __m128i         D, Lo, Hi, SurfA, Pos, Neg;
+    UINT            i;
+
+    for (i = 0; i + 4 <= Count; i += 4)
+    {
+        D  = _mm_loadu_si128((__m128i const *) (Dst + i));
+
+        Lo = _mm_unpacklo_epi8(D, Zero);
+        SurfA = _mm_mullo_epi16(Lo, _mm_loadu_si128((__m128i const *) (Alpha + i * 4)));
+        Pos = _mm_loadu_si128((__m128i const *) (Premult + i * 4));
+        Neg = _mm_subs_epu16(SurfA, Pos);
+        Pos = _mm_subs_epu16(Pos, SurfA);
+        Lo = _mm_sub_epi16(
+            _mm_add_epi16(Lo, CURSOR_DIV255_EPU16(Pos, One)),
+            CURSOR_DIV255_EPU16(Neg, One)
+            );
+
+        Hi = _mm_unpackhi_epi8(D, Zero);
+        SurfA = _mm_mullo_epi16(Hi, _mm_loadu_si128((__m128i const *) (Alpha + i * 4 + 8)));
+        Pos = _mm_loadu_si128((__m128i const *) (Premult + i * 4 + 8));
+        Neg = _mm_subs_epu16(SurfA, Pos);
+        Pos = _mm_subs_epu16(Pos, SurfA);
+        Hi = _mm_sub_epi16(
+            _mm_add_epi16(Hi, CURSOR_DIV255_EPU16(Pos, One)),
+            CURSOR_DIV255_EPU16(Neg, One)
+            );
+
+        _mm_storeu_si128((__m128i *) (Dst + i), _mm_packus_epi16(Lo, Hi));
+    }
+    CursorBlendRow(Dst + i, Premult + i * 4, Alpha + i * 4, Count - i);
+}
+#endif
+
+/*
+ * Name:  LJB_VMON_CursorInit
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_CursorInit(
+ *        __out LJB_VMON_CURSOR_COMPOSITOR *    Compositor
+ *        );
+ *
+ * Description:
+ *    Allocate the compositor arena, large enough for the biggest cursor the
+ *    ProxyKMD can report (MAXIMUM_POINTER_WIDTH x MAXIMUM_POINTER_HEIGHT),
+ *    and pick the row kernels for this CPU.
+ *
+ * Return Value:
+ *    Return TRUE if success. Return FALSE otherwise.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_CursorInit(
+    __out LJB_VMON_CURSOR_COMPOSITOR *      Compositor
+    )
+{
+    UCHAR * pArena;
+
+    RtlZeroMemory(Compositor, sizeof(*Compositor));
+
+    pArena = HeapAlloc(
+        GetProcessHeap(),
+        0,
+        CURSOR_SAVE_BUFFER_SIZE + CURSOR_SHAPE_PLANES_SIZE
+        );
+    if (pArena == NULL)
+        return FALSE;
+
+    Compositor->ArenaAllocation = pArena;
+    Compositor->SaveBuffer = (ULONG *) pArena;
+    Compositor->ShapePlanes = pArena + CURSOR_SAVE_BUFFER_SIZE;
+
+#if defined(_M_X64) || defined(__SSE2__)
+    Compositor->UseSse2 = TRUE;
+#elif LJB_VMON_CURSOR_SSE2
+    Compositor->UseSse2 = (BOOLEAN) IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+#endif
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_CursorDeInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_CursorDeInit(
+ *        __inout LJB_VMON_CURSOR_COMPOSITOR *  Compositor
+ *        );
+ *
+ * Description:
+ *    Free the compositor arena. Safe to call on a zeroed compositor.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_CursorDeInit(
+    __inout LJB_VMON_CURSOR_COMPOSITOR *    Compositor
+    )
+{
+    if (Compositor->ArenaAllocation != NULL)
+        HeapFree(GetProcessHeap(), 0, Compositor->ArenaAllocation);
+    RtlZeroMemory(Compositor, sizeof(*Compositor));
+}
+
+/*
+ * Name:  LJB_VMON_CursorSetShape
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_CursorSetShape(
+ *        __inout LJB_VMON_CURSOR_COMPOSITOR *  Compositor,
+ *        __in CONST POINTER_SHAPE_DATA *       PointerShapeData
+ *        );
+ *
+ * Description:
+ *    Expand a new cursor shape into the shape planes. Unknown formats and
+ *    oversized shapes leave the compositor with an empty cursor, which
+ *    LJB_VMON_CursorDraw then ignores.
+ *
+ *    http://msdn.microsoft.com/en-us/library/windows/hardware/ff559481(v=vs.85).aspx
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_CursorSetShape(
+    __inout LJB_VMON_CURSOR_COMPOSITOR *    Compositor,
+    __in CONST POINTER_SHAPE_DATA *         PointerShapeData
+    )
+{
+    UINT CONST      CurWidth = PointerShapeData->Width;
+    UINT CONST      CurHeight = PointerShapeData->Height;
+    UINT CONST      CurPitch = PointerShapeData->Pitch;
+    UCHAR CONST *   pCurRow;
+    ULONG *         pAnd;
+    ULONG *         pXor;
+    USHORT *        pPremult;
+    USHORT *        pAlpha;
+    ULONG           Pixel;
+    UCHAR           CurA;
+    UINT            row;
+    UINT            col;
+
+    Compositor->Flags.Value = 0;
+    Compositor->Width = 0;
+    Compositor->Height = 0;
+
+    if (Compositor->ShapePlanes == NULL ||
+        CurWidth == 0 || CurWidth > MAXIMUM_POINTER_WIDTH ||
+        CurHeight == 0 || CurHeight > MAXIMUM_POINTER_HEIGHT)
+        return;
+
+    pAnd = CURSOR_AND_PLANE(Compositor);
+    pXor = CURSOR_XOR_PLANE(Compositor);
+    pPremult = CURSOR_PREMULT_PLANE(Compositor);
+    pAlpha = CURSOR_ALPHA_PLANE(Compositor);
+
+    switch (PointerShapeData->Flags.Value)
+    {
+    case 1:
+        /*
+         * Monochrome cursor: a 1bpp AND mask followed by a 1bpp XOR mask of
+         * the same size, most significant bit first.
+         */
+        if ((SIZE_T) CurPitch * CurHeight * 2 > sizeof(PointerShapeData->Buffer) ||
+            CurPitch * 8 < CurWidth)
+            return;
+
+        for (row = 0; row < CurHeight; row++)
+        {
+            UCHAR CONST * CONST pANDMask = PointerShapeData->Buffer + row * CurPitch;
+            UCHAR CONST * CONST pXORMask = pANDMask + CurHeight * CurPitch;
+
+            for (col = 0; col < CurWidth; col++)
+            {
+                *pAnd++ = ((pANDMask[col >> 3] >> (7 - (col & 7))) & 1) ? 0xFFFFFFFF : 0;
+                *pXor++ = ((pXORMask[col >> 3] >> (7 - (col & 7))) & 1) ? 0xFFFFFFFF : 0;
+            }
+        }
+        break;
+
+    case 2:
+        /*
+         * Color cursor: 32bpp ARGB, alpha blended.
+         */
+        if ((SIZE_T) CurPitch * CurHeight > sizeof(PointerShapeData->Buffer) ||
+            CurPitch < CurWidth * 4)
+            return;
+
+        for (row = 0; row < CurHeight; row++)
+        {
+            pCurRow = PointerShapeData->Buffer + row * CurPitch;
+            for (col = 0; col < CurWidth; col++)
+            {
+                CurA = pCurRow[col * 4 + 3];
+                pPremult[0] = (USHORT) (pCurRow[col * 4 + 0] * CurA);
+                pPremult[1] = (USHORT) (pCurRow[col * 4 + 1] * CurA);
+                pPremult[2] = (USHORT) (pCurRow[col * 4 + 2] * CurA);
+                pPremult[3] = 0;
+                pAlpha[0] = pAlpha[1] = pAlpha[2] = CurA;
+                pAlpha[3] = 0;
+                pPremult += 4;
+                pAlpha += 4;
+            }
+        }
+        break;
+
+    case 4:
+        /*
+         * Masked color cursor: 32bpp ARGB with an alpha of 0 (replace) or
+         * 0xFF (XOR).
+         */
+        if ((SIZE_T) CurPitch * CurHeight > sizeof(PointerShapeData->Buffer) ||
+            CurPitch < CurWidth * 4)
+            return;
+
+        for (row = 0; row < CurHeight; row++)
+        {
+            pCurRow = PointerShapeData->Buffer + row * CurPitch;
+            for (col = 0; col < CurWidth; col++)
+            {
+                RtlCopyMemory(&Pixel, pCurRow + col * 4, sizeof(Pixel));
+                *pAnd++ = (pCurRow[col * 4 + 3] == 0) ? 0xFF000000 : 0xFFFFFFFF;
+                *pXor++ = Pixel & 0x00FFFFFF;
+            }
+        }
+        break;
+
+    default:
+        return;
+    }
+
+    Compositor->Flags = PointerShapeData->Flags;
+    Compositor->Width = CurWidth;
+    Compositor->Height = CurHeight;
+}
+
+/*
+ * Name:  LJB_VMON_CursorClip
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_CursorClip(
+ *        __in CONST LJB_VMON_CURSOR_COMPOSITOR * Compositor,
+ *        __in INT                                PosX,
+ *        __in INT                                PosY,
+ *        __in UINT                               SurfaceWidth,
+ *        __in UINT                               SurfaceHeight,
+ *        __out LJB_VMON_CURSOR_CLIP *            Clip
+ *        );
+ *
+ * Description:
+ *    Intersect the current cursor, placed at (PosX, PosY), with the frame
+ *    buffer. PosX/PosY can be negative when the cursor hangs off the left or
+ *    top edge; the hidden part is skipped through SrcX/SrcY.
+ *
+ * Return Value:
+ *    TRUE if any part of the cursor is visible, FALSE otherwise.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_CursorClip(
+    __in CONST LJB_VMON_CURSOR_COMPOSITOR * Compositor,
+    __in INT                                PosX,
+    __in INT                                PosY,
+    __in UINT                               SurfaceWidth,
+    __in UINT                               SurfaceHeight,
+    __out LJB_VMON_CURSOR_CLIP *            Clip
+    )
+{
+    UINT CONST  CurWidth = Compositor->Width;
+    UINT CONST  CurHeight = Compositor->Height;
+
+    RtlZeroMemory(Clip, sizeof(*Clip));
+
+    if (CurWidth == 0 || CurHeight == 0)
+        return FALSE;
+
+    if (PosX < 0)
+    {
+        if ((UINT) -PosX >= CurWidth)
+            return FALSE;
+        Clip->SrcX = (UINT) -PosX;
+    }
+    else
+    {
+        if ((UINT) PosX >= SurfaceWidth)
+            return FALSE;
+        Clip->DstX = (UINT) PosX;
+    }
+
+    if (PosY < 0)
+    {
+        if ((UINT) -PosY >= CurHeight)
+            return FALSE;
+        Clip->SrcY = (UINT) -PosY;
+    }
+    else
+    {
+        if ((UINT) PosY >= SurfaceHeight)
+            return FALSE;
+        Clip->DstY = (UINT) PosY;
+    }
+
+    Clip->Width = CurWidth - Clip->SrcX;
+    if (Clip->Width > SurfaceWidth - Clip->DstX)
+        Clip->Width = SurfaceWidth - Clip->DstX;
+
+    Clip->Height = CurHeight - Clip->SrcY;
+    if (Clip->Height > SurfaceHeight - Clip->DstY)
+        Clip->Height = SurfaceHeight - Clip->DstY;
+
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_CursorDraw
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_CursorDraw(
+ *        __inout LJB_VMON_CURSOR_COMPOSITOR *  Compositor,
+ *        __in INT                              PosX,
+ *        __in INT                              PosY,
+ *        __inout PVOID                         FrameBuffer,
+ *        __in UINT                             SurfaceWidth,
+ *        __in UINT                             SurfaceHeight
+ *        );
+ *
+ * Description:
+ *    Put any previously drawn cursor back, save the pixels under the new
+ *    cursor position, then composite the cursor in place. The frame buffer is
+ *    a packed 32bpp surface of SurfaceWidth x SurfaceHeight.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_CursorDraw(
+    __inout LJB_VMON_CURSOR_COMPOSITOR *    Compositor,
+    __in INT                                PosX,
+    __in INT                                PosY,
+    __inout PVOID                           FrameBuffer,
+    __in UINT                               SurfaceWidth,
+    __in UINT                               SurfaceHeight
+    )
+{
+    UINT CONST              SurfacePitch = SurfaceWidth * 4;
+    LJB_VMON_CURSOR_CLIP    Clip;
+    UCHAR *                 pSurfRow;
+    ULONG *                 pSave;
+    SIZE_T                  PlaneOffset;
+    UINT                    row;
+
+    LJB_VMON_CursorRestore(Compositor);
+
+    if (!LJB_VMON_CursorClip(
+            Compositor,
+            PosX,
+            PosY,
+            SurfaceWidth,
+            SurfaceHeight,
+            &Clip))
+        return;
+
+    /*
+     * back up the region of the frame buffer the cursor is about to cover
+     */
+    pSurfRow = (UCHAR *) FrameBuffer + (SIZE_T) Clip.DstY * SurfacePitch + Clip.DstX * 4;
+    pSave = Compositor->SaveBuffer;
+    for (row = 0; row < Clip.Height; row++)
+    {
+        RtlCopyMemory(pSave, pSurfRow + (SIZE_T) row * SurfacePitch, Clip.Width * 4);
+        pSave += Clip.Width;
+    }
+    Compositor->Saved = TRUE;
+    Compositor->SavedPosition = pSurfRow;
+    Compositor->SavedX = Clip.DstX;
+    Compositor->SavedY = Clip.DstY;
+    Compositor->SavedWidth = Clip.Width;
+    Compositor->SavedHeight = Clip.Height;
+    Compositor->SavedPitch = SurfacePitch;
+
+    for (row = 0; row < Clip.Height; row++)
+    {
+        ULONG * CONST   pDst = (ULONG *) (pSurfRow + (SIZE_T) row * SurfacePitch);
+
+        PlaneOffset = (SIZE_T) (Clip.SrcY + row) * Compositor->Width + Clip.SrcX;
+        if (Compositor->Flags.Value == 2)
+        {
+#if LJB_VMON_CURSOR_SSE2
+            if (Compositor->UseSse2)
+            {
+                CursorBlendRowSse2(
+                    pDst,
+                    CURSOR_PREMULT_PLANE(Compositor) + PlaneOffset * 4,
+                    CURSOR_ALPHA_PLANE(Compositor) + PlaneOffset * 4,
+                    Clip.Width
+                    );
+                continue;
+            }
+#endif
+            CursorBlendRow(
+                pDst,
+                CURSOR_PREMULT_PLANE(Compositor) + PlaneOffset * 4,
+                CURSOR_ALPHA_PLANE(Compositor) + PlaneOffset * 4,
+                Clip.Width
+                );
+        }
+        else
+        {
+#if LJB_VMON_CURSOR_SSE2
+            if (Compositor->UseSse2)
+            {
+                CursorAndXorRowSse2(
+                    pDst,
+                    CURSOR_AND_PLANE(Compositor) + PlaneOffset,
+                    CURSOR_XOR_PLANE(Compositor) + PlaneOffset,
+                    Clip.Width
+                    );
+                continue;
+            }
+#endif
+            CursorAndXorRow(
+                pDst,
+                CURSOR_AND_PLANE(Compositor) + PlaneOffset,
+                CURSOR_XOR_PLANE(Compositor) + PlaneOffset,
+                Clip.Width
+                );
+        }
+    }
+}
+
+/*
+ * Name:  LJB_VMON_CursorRestore
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_CursorRestore(
+ *        __inout LJB_VMON_CURSOR_COMPOSITOR *  Compositor
+ *        );
+ *
+ * Description:
+ *    Put back the frame buffer pixels saved by the last LJB_VMON_CursorDraw.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_CursorRestore(
+    __inout LJB_VMON_CURSOR_COMPOSITOR *    Compositor
+    )
+{
+    UCHAR *         pSurfRow;
+    ULONG CONST *   pSave;
+    UINT            row;
+
+    if (!Compositor->Saved)
+        return;
+
+    pSurfRow = Compositor->SavedPosition;
+    pSave = Compositor->SaveBuffer;
+    for (row = 0; row < Compositor->SavedHeight; row++)
+    {
+        RtlCopyMemory(pSurfRow, pSave, Compositor->SavedWidth * 4);
+        pSurfRow += Compositor->SavedPitch;
+        pSave += Compositor->SavedWidth;
+    }
+    Compositor->Saved = FALSE;
+}
+
+/*
+ * Name:  LJB_VMON_CursorDiscardSave
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_CursorDiscardSave(
+ *        __inout LJB_VMON_CURSOR_COMPOSITOR *  Compositor
+ *        );
+ *
+ * Description:
+ *    Forget the saved pixels. Called when the frame buffer was overwritten
+ *    (a new BLT) or freed (a mode change), so a later restore must not write
+ *    stale pixels back.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_CursorDiscardSave(
+    __inout LJB_VMON_CURSOR_COMPOSITOR *    Compositor
+    )
+{
+    Compositor->Saved = FALSE;
+    Compositor->SavedPosition = NULL;
+}
@@ -0,0 +1,112 @@
+/*!
+    \file       ljb_vmon_cursor.h
+    \brief      Cursor compositing on a 32bpp frame buffer
+    \details    The compositor owns one persistent arena, allocated once, that
+                holds the pixels saved from under the cursor and the current
+                cursor shape pre-expanded into a layout the per-draw kernels
+                can consume directly. Shape preparation happens only on
+                IOCTL_LJB_VMON_GET_POINTER_SHAPE; drawing a cursor never
+                allocates.
+ */
+
+#ifndef _LJB_VMON_CURSOR_H_
+#define _LJB_VMON_CURSOR_H_
+
+#include <windows.h>
+#include "ljb_vmon_ioctl.h"
+
+#define LJB_VMON_CURSOR_MAX_PIXELS  (MAXIMUM_POINTER_WIDTH * MAXIMUM_POINTER_HEIGHT)
+
+/*
+ * Cursor rectangle after clipping against the frame buffer. Computed once per
+ * draw, before any pixel is touched.
+ */
+typedef struct _LJB_VMON_CURSOR_CLIP
+{
+    UINT                DstX;       // first frame buffer column covered
+    UINT                DstY;       // first frame buffer row covered
+    UINT                SrcX;       // first cursor column visible
+    UINT                SrcY;       // first cursor row visible
+    UINT                Width;      // visible columns
+    UINT                Height;     // visible rows
+} LJB_VMON_CURSOR_CLIP;
+
+typedef struct _LJB_VMON_CURSOR_COMPOSITOR
+{
+    /*
+     * arena, allocated by LJB_VMON_CursorInit and kept until DeInit
+     */
+    PVOID               ArenaAllocation;
+    ULONG *             SaveBuffer;     // LJB_VMON_CURSOR_MAX_PIXELS pixels
+    PVOID               ShapePlanes;    // LJB_VMON_CURSOR_MAX_PIXELS * 16 bytes
+
+    /*
+     * current shape, see LJB_VMON_CursorSetShape
+     */
+    DXGK_POINTERFLAGS   Flags;
+    UINT                Width;
+    UINT                Height;
+
+    /*
+     * the frame buffer region currently covered by the cursor
+     */
+    BOOLEAN             Saved;
+    UCHAR *             SavedPosition;
+    UINT                SavedX;
+    UINT                SavedY;
+    UINT                SavedWidth;
+    UINT                SavedHeight;
+    UINT                SavedPitch;
+
+    BOOLEAN             UseSse2;
+} LJB_VMON_CURSOR_COMPOSITOR;
+
+__checkReturn
+BOOLEAN
+LJB_VMON_CursorInit(
+    __out LJB_VMON_CURSOR_COMPOSITOR *      Compositor
+    );
+
+VOID
+LJB_VMON_CursorDeInit(
+    __inout LJB_VMON_CURSOR_COMPOSITOR *    Compositor
+    );
+
+VOID
+LJB_VMON_CursorSetShape(
+    __inout LJB_VMON_CURSOR_COMPOSITOR *    Compositor,
+    __in CONST POINTER_SHAPE_DATA *         PointerShapeData
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_CursorClip(
+    __in CONST LJB_VMON_CURSOR_COMPOSITOR * Compositor,
+    __in INT                                PosX,
+    __in INT                                PosY,
+    __in UINT                               SurfaceWidth,
+    __in UINT                               SurfaceHeight,
+    __out LJB_VMON_CURSOR_CLIP *            Clip
+    );
+
+VOID
+LJB_VMON_CursorDraw(
+    __inout LJB_VMON_CURSOR_COMPOSITOR *    Compositor,
+    __in INT                                PosX,
+    __in INT                                PosY,
+    __inout PVOID                           FrameBuffer,
+    __in UINT                               SurfaceWidth,
+    __in UINT                               SurfaceHeight
+    );
+
+VOID
+LJB_VMON_CursorRestore(
+    __inout LJB_VMON_CURSOR_COMPOSITOR *    Compositor
+    );
+
+VOID
+LJB_VMON_CursorDiscardSave(
+    __inout LJB_VMON_CURSOR_COMPOSITOR *    Compositor
+    );
+
+#endif /* _LJB_VMON_CURSOR_H_ */
@@ -0,0 +1,709 @@
+#include "ljb_vmon_damage.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define LJB_VMON_DAMAGE_SSE2        1
+#else
+#define LJB_VMON_DAMAGE_SSE2        0
+#endif
+
+/*
+ * Tile hash, after the XXH3 long input loop. Eight 64-bit lanes take one
+ * 64 byte stripe (16 pixels) at a time:
+ *
+ *      dk = d[j] ^ Key[r * HASH_STRIPES + s + j]
+ *      Acc[j ^ 1] += d[j]
+ *      Acc[j] += (dk & 0xFFFFFFFF) * (dk >> 32)
+ *
+ * where s is the stripe's position in its row and r the row's position in
+ * a block of HASH_BLOCK_ROWS rows, so equal stripes swapped within a block
+ * do not cancel out. The lanes stay in registers for the whole block and
+ * are scrambled once at its end, which makes the sums order dependent
+ * across blocks too, and are mixed down to 64 bits at the end of the tile.
+ * SSE2 does two lanes per register with one _mm_mul_epu32; tiles whose
+ * width is not a multiple of 16 pixels are left to the scalar code, which
+ * gives the same hash for the same pixels.
+ *
+ * Scrambling per block rather than per row is what lets the SSE2 hash of a
+ * 1080p frame beat a memcmp of it against a shadow copy; see the damage
+ * suite of vmon_bench.
+ *
+ * This is not meant to be cryptographic, only to make an unchanged tile
+ * hash equal and a changed one, with overwhelming probability, not.
+ */
+#define HASH_PRIME32_1  0x9E3779B1U
+#define HASH_PRIME64_1  0x9E3779B185EBCA87ULL
+#define HASH_PRIME64_2  0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME64_3  0x165667B19E3779F9ULL
+#define HASH_PRIME64_4  0x85EBCA77C2B2AE63ULL
+
+#define HASH_LANES      8
+#define HASH_STRIPE     16      // pixels
+#define HASH_STRIPES    (LJB_VMON_DAMAGE_TILE_SIZE / HASH_STRIPE)
+#define HASH_BLOCK_ROWS 4
+
+static CONST ULONG64 HashKey[HASH_LANES + HASH_BLOCK_ROWS * HASH_STRIPES - 1] =
+{
+    0xBE4BA423396CFEB8ULL, 0x1CAD21F72C81017CULL, 0xDB979083E96DD4DEULL,
+    0x1F67B3B7A4A44072ULL, 0x78E5C0CC4EE679CBULL, 0x2172FFCC7DD05A82ULL,
+    0x8E2443F7744608B8ULL, 0x4C263A81E69035E0ULL, 0xCB00C391BB52283CULL,
+    0xA32E531B8B65D088ULL, 0x4EF90DA297486471ULL, 0x50E4DC3B5BF82AEEULL,
+    0x48BC6B9A24968CD9ULL, 0x3BB2B8701093A0F5ULL, 0x602014D15F4742DFULL,
+    0x10703C16EB9E11DFULL, 0x7DA3522EBDBA07BEULL, 0xDA61ECC51DFE1C9DULL,
+    0x97E8A630751967A8ULL, 0xBD08BC048B2AFCF3ULL, 0x50507451C024FB75ULL,
+    0xD7F8D9EB2C6D6746ULL, 0x0FD70048BE7FF805ULL,
+};
+
+static CONST ULONG64 HashInit[HASH_LANES] =
+{
+    0xC2B2AE3DULL, HASH_PRIME64_1, HASH_PRIME64_2, HASH_PRIME64_3,
+    HASH_PRIME64_4, 0x85EBCA77ULL, 0x27D4EB2F165667C5ULL, HASH_PRIME32_1,
+};
+
+#define HASH_READ64(p)  (((ULONG64) (p)[1] << 32) | (p)[0])
+
+static ULONG64
+HashMerge(
+    __in CONST ULONG64 *        Acc,
+    __in UINT                   Cols,
+    __in UINT                   Rows
+    )
+{
+    ULONG64 h = (((ULONG64) Cols << 32) | Rows) * HASH_PRIME64_1;
+    ULONG64 m;
+    UINT    j;
+
+    for (j = 0; j < HASH_LANES; j += 2)
+    {
+        m = (Acc[j] ^ HashKey[j]) * ((Acc[j + 1] ^ HashKey[j + 1]) | 1);
+        h += m ^ (m >> 32);
+    }
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+/*
+ * up to HASH_BLOCK_ROWS rows of one tile, then the scramble
+ */
+static VOID
+HashBlockScalar(
+    __inout ULONG64 *           Acc,
+    __in CONST UCHAR *          pBlock,
+    __in UINT                   Pitch,
+    __in UINT                   Cols,
+    __in UINT                   Rows
+    )
+{
+    CONST ULONG *   p;
+    CONST ULONG64 * Key;
+    ULONG64         d, dk;
+    UINT            r, x, j, s;
+
+    for (r = 0; r < Rows; r++, pBlock += Pitch)
+    {
+        p = (CONST ULONG *) pBlock;
+        Key = HashKey + r * HASH_STRIPES;
+        for (x = 0, s = 0; x + HASH_STRIPE <= Cols; x += HASH_STRIPE, s++)
+        {
+            for (j = 0; j < HASH_LANES; j++)
+            {
+                d = HASH_READ64(p + x + j * 2);
+                dk = d ^ Key[s + j];
+                Acc[j ^ 1] += d;
+                Acc[j] += (dk & 0xFFFFFFFF) * (dk >> 32);
+            }
+        }
+        for (j = 0; x < Cols; x++, j++)
+        {
+            dk = (ULONG64) p[x] ^ Key[(j & 7) + (j >> 3)];
+            Acc[(j & 7) ^ 1] += p[x];
+            Acc[j & 7] += (dk & 0xFFFFFFFF) * (dk >> 32);
+        }
+    }
+
+    for (j = 0; j < HASH_LANES; j++)
+    {
+        Acc[j] ^= Acc[j] >> 47;
+        Acc[j] ^= HashKey[j + 1];
+        Acc[j] *= HASH_PRIME32_1;
+    }
+}
+
+#if LJB_VMON_DAMAGE_SSE2
+#define HASH_ACCUMULATE_SSE2(Acc, pData, pKey)                              \
+    do {                                                                    \
+        __m128i CONST d = _mm_loadu_si128((__m128i const *) (pData));       \
+        __m128i CONST dk = _mm_xor_si128(d, _mm_loadu_si128((__m128i const *) (pKey))); \
+        (Acc) = _mm_add_epi64((Acc), _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2))); \
+        (Acc) = _mm_add_epi64((Acc), _mm_mul_epu32(dk, _mm_srli_epi64(dk, 32))); \
+    } while (0)
+
+#define HASH_SCRAMBLE_SSE2(Acc, pKey)                                       \
+    do {                                                                    \
+        (Acc) = _mm_xor_si128((Acc), _mm_srli_epi64((Acc), 47));            \
+        (Acc) = _mm_xor_si128((Acc), _mm_loadu_si128((__m128i const *) (pKey))); \
+        (Acc) = _mm_add_epi64(                                              \
+            _mm_mul_epu32((Acc), Prime),                                    \
+            _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64((Acc), 32), Prime), 32)); \
+    } while (0)
+
+/*
+ * Cols must be a multiple of HASH_STRIPE
+ */
+static VOID
+HashBlockSse2(
+    __inout ULONG64 *           Acc,
+    __in CONST UCHAR *          pBlock,
+    __in UINT                   Pitch,
+    __in UINT                   Cols,
+    __in UINT                   Rows
+    )
+{
+    __m128i CONST   Prime = _mm_set1_epi32((int) HASH_PRIME32_1);
+    __m128i         Acc0, Acc1, Acc2, Acc3;
+    CONST UCHAR *   p;
+    CONST ULONG64 * Key;
+    UINT            r, x;
+
+    Acc0 = _mm_loadu_si128((__m128i const *) (Acc + 0));
+    Acc1 = _mm_loadu_si128((__m128i const *) (Acc + 2));
+    Acc2 = _mm_loadu_si128((__m128i const *) (Acc + 4));
+    Acc3 = _mm_loadu_si128((__m128i const *) (Acc + 6));
+
+    for (r = 0; r < Rows; r++, pBlock += Pitch)
+    {
+        p = pBlock;
+        Key = HashKey + r * HASH_STRIPES;
+        for (x = 0; x < Cols; x += HASH_STRIPE, p += HASH_STRIPE * 4, Key++)
+        {
+            HASH_ACCUMULATE_SSE2(Acc0, p + 0, Key + 0);
+            HASH_ACCUMULATE_SSE2(Acc1, p + 16, Key + 2);
+            HASH_ACCUMULATE_SSE2(Acc2, p + 32, Key + 4);
+            HASH_ACCUMULATE_SSE2(Acc3, p + 48, Key + 6);
+        }
+    }
+    HASH_SCRAMBLE_SSE2(Acc0, HashKey + 1);
+    HASH_SCRAMBLE_SSE2(Acc1, HashKey + 3);
+    HASH_SCRAMBLE_SSE2(Acc2, HashKey + 5);
+    HASH_SCRAMBLE_SSE2(Acc3, HashKey + 7);
+
+    _mm_storeu_si128((__m128i *) (Acc + 0), Acc0);
+    _mm_storeu_si128((__m128i *) (Acc + 2), Acc1);
+    _mm_storeu_si128((__m128i *) (Acc + 4), Acc2);
+    _mm_storeu_si128((__m128i *) (Acc + 6), Acc3);
+}
+#endif
+
+static VOID
+HashBlock(
+    __in BOOLEAN                UseSse2,
+    __inout ULONG64 *           Acc,
+    __in CONST UCHAR *          pBlock,
+    __in UINT                   Pitch,
+    __in UINT                   Cols,
+    __in UINT                   Rows
+    )
+{
+#if LJB_VMON_DAMAGE_SSE2
+    if (UseSse2 && (Cols % HASH_STRIPE) == 0)
+    {
+        HashBlockSse2(Acc, pBlock, Pitch, Cols, Rows);
+        return;
+    }
+#else
+    UNREFERENCED_PARAMETER(UseSse2);
+#endif
+    HashBlockScalar(Acc, pBlock, Pitch, Cols, Rows);
+}
+
+static ULONG64
+RectArea(
+    __in CONST LJB_VMON_RECT *  Rect
+    )
+{
+    return (ULONG64) (Rect->Right - Rect->Left) * (ULONG64) (Rect->Bottom - Rect->Top);
+}
+
+static VOID
+RectUnion(
+    __out LJB_VMON_RECT *       Result,
+    __in CONST LJB_VMON_RECT *  A,
+    __in CONST LJB_VMON_RECT *  B
+    )
+{
+    Result->Left   = A->Left   < B->Left   ? A->Left   : B->Left;
+    Result->Top    = A->Top    < B->Top    ? A->Top    : B->Top;
+    Result->Right  = A->Right  > B->Right  ? A->Right  : B->Right;
+    Result->Bottom = A->Bottom > B->Bottom ? A->Bottom : B->Bottom;
+}
+
+/*
+ * Name:  LJB_VMON_DamageReset
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_DamageReset(
+ *        __out LJB_VMON_DAMAGE *   Damage
+ *        );
+ *
+ * Description:
+ *    Empty a damage list.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_DamageReset(
+    __out LJB_VMON_DAMAGE *                 Damage
+    )
+{
+    Damage->NumRects = 0;
+}
+
+/*
+ * Name:  LJB_VMON_DamageAddRect
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_DamageAddRect(
+ *        __inout LJB_VMON_DAMAGE *     Damage,
+ *        __in CONST LJB_VMON_RECT *    Rect
+ *        );
+ *
+ * Description:
+ *    Add a rectangle to a damage list. Rectangles that overlap or touch an
+ *    existing one without growing the covered area are merged into it; when
+ *    the list is full everything collapses into the bounding box.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_DamageAddRect(
+    __inout LJB_VMON_DAMAGE *               Damage,
+    __in CONST LJB_VMON_RECT *              Rect
+    )
+{
+    LJB_VMON_RECT   New;
+    LJB_VMON_RECT   Union;
+    UINT            i;
+
+    if (Rect->Right <= Rect->Left || Rect->Bottom <= Rect->Top)
+        return;
+
+    New = *Rect;
+    i = 0;
+    while (i < Damage->NumRects)
+    {
+        LJB_VMON_RECT * CONST   pOld = &Damage->Rects[i];
+
+        RectUnion(&Union, pOld, &New);
+        if (RectArea(&Union) == RectArea(pOld))
+            return;
+
+        if (RectArea(&Union) <= RectArea(pOld) + RectArea(&New))
+        {
+            /*
+             * merge, then retry against the remaining rectangles since the
+             * merged one may now touch them too.
+             */
+            New = Union;
+            *pOld = Damage->Rects[--Damage->NumRects];
+            i = 0;
+            continue;
+        }
+        i++;
+    }
+
+    if (Damage->NumRects < LJB_VMON_MAX_DAMAGE_RECTS)
+    {
+        Damage->Rects[Damage->NumRects++] = New;
+        return;
+    }
+
+    for (i = 0; i < Damage->NumRects; i++)
+        RectUnion(&New, &New, &Damage->Rects[i]);
+    Damage->Rects[0] = New;
+    Damage->NumRects = 1;
+}
+
+/*
+ * Name:  LJB_VMON_DamageAddDamage
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_DamageAddDamage(
+ *        __inout LJB_VMON_DAMAGE *     Damage,
+ *        __in CONST LJB_VMON_DAMAGE *  Other
+ *        );
+ *
+ * Description:
+ *    Add every rectangle of Other to Damage.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_DamageAddDamage(
+    __inout LJB_VMON_DAMAGE *               Damage,
+    __in CONST LJB_VMON_DAMAGE *            Other
+    )
+{
+    UINT    i;
+
+    for (i = 0; i < Other->NumRects; i++)
+        LJB_VMON_DamageAddRect(Damage, &Other->Rects[i]);
+}
+
+/*
+ * Name:  LJB_VMON_DamageSetFull
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_DamageSetFull(
+ *        __out LJB_VMON_DAMAGE *   Damage,
+ *        __in UINT                 Width,
+ *        __in UINT                 Height
+ *        );
+ *
+ * Description:
+ *    Mark a whole Width x Height frame as damaged.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_DamageSetFull(
+    __out LJB_VMON_DAMAGE *                 Damage,
+    __in UINT                               Width,
+    __in UINT                               Height
+    )
+{
+    Damage->NumRects = 0;
+    if (Width == 0 || Height == 0)
+        return;
+
+    Damage->Rects[0].Left = 0;
+    Damage->Rects[0].Top = 0;
+    Damage->Rects[0].Right = (LONG) Width;
+    Damage->Rects[0].Bottom = (LONG) Height;
+    Damage->NumRects = 1;
+}
+
+/*
+ * Name:  LJB_VMON_DamageArea
+ *
+ * Definition:
+ *    ULONG64
+ *    LJB_VMON_DamageArea(
+ *        __in CONST LJB_VMON_DAMAGE *  Damage
+ *        );
+ *
+ * Description:
+ *    Sum of the rectangle areas. Rectangles of one list may still overlap a
+ *    little, so this can be slightly more than the damaged pixel count.
+ *
+ * Return Value:
+ *    number of pixels.
+ *
+ */
+ULONG64
+LJB_VMON_DamageArea(
+    __in CONST LJB_VMON_DAMAGE *            Damage
+    )
+{
+    ULONG64 Area = 0;
+    UINT    i;
+
+    for (i = 0; i < Damage->NumRects; i++)
+        Area += RectArea(&Damage->Rects[i]);
+    return Area;
+}
+
+/*
+ * Name:  LJB_VMON_DamageHashTile
+ *
+ * Definition:
+ *    ULONG64
+ *    LJB_VMON_DamageHashTile(
+ *        __in CONST LJB_VMON_DAMAGE_TRACKER *  Tracker,
+ *        __in CONST VOID *                     Tile,
+ *        __in UINT                             Pitch,
+ *        __in UINT                             Cols,
+ *        __in UINT                             Rows
+ *        );
+ *
+ * Description:
+ *    Hash Cols x Rows 32bpp pixels starting at Tile, Pitch bytes apart, with
+ *    the kernel Tracker is set to use. Cols is at most
+ *    LJB_VMON_DAMAGE_TILE_SIZE.
+ *
+ * Return Value:
+ *    64-bit hash of the pixels and the tile size.
+ *
+ */
+ULONG64
+LJB_VMON_DamageHashTile(
+    __in CONST LJB_VMON_DAMAGE_TRACKER *    Tracker,
+    __in CONST VOID *                       Tile,
+    __in UINT                               Pitch,
+    __in UINT                               Cols,
+    __in UINT                               Rows
+    )
+{
+    CONST UCHAR *   pRow = Tile;
+    ULONG64         Acc[HASH_LANES];
+    UINT            row, Block;
+
+    RtlCopyMemory(Acc, HashInit, sizeof(Acc));
+    for (row = 0; row < Rows; row += HASH_BLOCK_ROWS, pRow += (SIZE_T) Pitch * HASH_BLOCK_ROWS)
+    {
+        Block = Rows - row;
+        if (Block > HASH_BLOCK_ROWS)
+            Block = HASH_BLOCK_ROWS;
+        HashBlock(Tracker->UseSse2, Acc, pRow, Pitch, Cols, Block);
+    }
+    return HashMerge(Acc, Cols, Rows);
+}
+
+/*
+ * Name:  LJB_VMON_DamageTrackerInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_DamageTrackerInit(
+ *        __out LJB_VMON_DAMAGE_TRACKER *   Tracker
+ *        );
+ *
+ * Description:
+ *    Initialize a tracker. The tile hashes are allocated by the first update.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_DamageTrackerInit(
+    __out LJB_VMON_DAMAGE_TRACKER *         Tracker
+    )
+{
+    RtlZeroMemory(Tracker, sizeof(*Tracker));
+#if defined(_M_X64) || defined(__SSE2__)
+    Tracker->UseSse2 = TRUE;
+#elif LJB_VMON_DAMAGE_SSE2
+    Tracker->UseSse2 = (BOOLEAN) IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+#endif
+}
+
+/*
+ * Name:  LJB_VMON_DamageTrackerDeInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_DamageTrackerDeInit(
+ *        __inout LJB_VMON_DAMAGE_TRACKER * Tracker
+ *        );
+ *
+ * Description:
+ *    Free the tile hashes and hash state.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_DamageTrackerDeInit(
+    __inout LJB_VMON_DAMAGE_TRACKER *       Tracker
+    )
+{
+    if (Tracker->TileHashes != NULL)
+        HeapFree(GetProcessHeap(), 0, Tracker->TileHashes);
+    if (Tracker->TileLanes != NULL)
+        HeapFree(GetProcessHeap(), 0, Tracker->TileLanes);
+    RtlZeroMemory(Tracker, sizeof(*Tracker));
+}
+
+/*
+ * Name:  LJB_VMON_DamageTrackerInvalidate
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_DamageTrackerInvalidate(
+ *        __inout LJB_VMON_DAMAGE_TRACKER * Tracker
+ *        );
+ *
+ * Description:
+ *    Make the next update report the whole frame as damaged.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_DamageTrackerInvalidate(
+    __inout LJB_VMON_DAMAGE_TRACKER *       Tracker
+    )
+{
+    Tracker->Valid = FALSE;
+}
+
+/*
+ * Name:  LJB_VMON_DamageTrackerUpdate
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_DamageTrackerUpdate(
+ *        __inout LJB_VMON_DAMAGE_TRACKER * Tracker,
+ *        __in CONST VOID *                 FrameBuffer,
+ *        __in UINT                         Width,
+ *        __in UINT                         Height,
+ *        __in UINT                         Pitch,
+ *        __out LJB_VMON_DAMAGE *           Damage
+ *        );
+ *
+ * Description:
+ *    Hash every tile of FrameBuffer, report the tiles whose hash differs
+ *    from the previous frame passed to this routine and remember the new
+ *    hashes. Changed tiles of one tile row are reported as horizontal runs,
+ *    which LJB_VMON_DamageAddRect then merges vertically.
+ *
+ *    Only the new frame is read, once; the previous frame need not be kept.
+ *
+ * Return Value:
+ *    None. Damage is empty if nothing changed.
+ *
+ */
+VOID
+LJB_VMON_DamageTrackerUpdate(
+    __inout LJB_VMON_DAMAGE_TRACKER *       Tracker,
+    __in CONST VOID *                       FrameBuffer,
+    __in UINT                               Width,
+    __in UINT                               Height,
+    __in UINT                               Pitch,
+    __out LJB_VMON_DAMAGE *                 Damage
+    )
+{
+    UINT CONST      TileCols = (Width + LJB_VMON_DAMAGE_TILE_SIZE - 1) / LJB_VMON_DAMAGE_TILE_SIZE;
+    UINT CONST      TileRows = (Height + LJB_VMON_DAMAGE_TILE_SIZE - 1) / LJB_VMON_DAMAGE_TILE_SIZE;
+    UCHAR CONST *   pRow;
+    ULONG64 *       pHash;
+    ULONG64 *       pLanes;
+    ULONG64         Hash;
+    LJB_VMON_RECT   Run;
+    UINT            x, y, row, col;
+    UINT            Cols, Rows, Block;
+    BOOLEAN         Full;
+    BOOLEAN         RunOpen;
+
+    Full = (BOOLEAN) (!Tracker->Valid || Tracker->Width != Width || Tracker->Height != Height);
+    if (Full)
+    {
+        LJB_VMON_DamageSetFull(Damage, Width, Height);
+
+        if (Tracker->MaxTiles < TileCols * TileRows || Tracker->MaxTileCols < TileCols)
+        {
+            if (Tracker->TileHashes != NULL)
+                HeapFree(GetProcessHeap(), 0, Tracker->TileHashes);
+            if (Tracker->TileLanes != NULL)
+                HeapFree(GetProcessHeap(), 0, Tracker->TileLanes);
+            Tracker->MaxTiles = 0;
+            Tracker->MaxTileCols = 0;
+            Tracker->TileHashes = HeapAlloc(
+                GetProcessHeap(),
+                0,
+                (SIZE_T) TileCols * TileRows * sizeof(ULONG64)
+                );
+            Tracker->TileLanes = HeapAlloc(
+                GetProcessHeap(),
+                0,
+                (SIZE_T) TileCols * HASH_LANES * sizeof(ULONG64)
+                );
+            if (Tracker->TileHashes == NULL || Tracker->TileLanes == NULL)
+            {
+                Tracker->Valid = FALSE;
+                return;
+            }
+            Tracker->MaxTiles = TileCols * TileRows;
+            Tracker->MaxTileCols = TileCols;
+        }
+        Tracker->Width = Width;
+        Tracker->Height = Height;
+        Tracker->Valid = TRUE;
+    }
+    else
+    {
+        LJB_VMON_DamageReset(Damage);
+    }
+
+    pHash = Tracker->TileHashes;
+    for (y = 0; y < Height; y += LJB_VMON_DAMAGE_TILE_SIZE)
+    {
+        Rows = Height - y;
+        if (Rows > LJB_VMON_DAMAGE_TILE_SIZE)
+            Rows = LJB_VMON_DAMAGE_TILE_SIZE;
+
+        /*
+         * hash the whole tile row one block of pixel rows at a time, so the
+         * frame is read almost front to back rather than a tile column at a
+         * time.
+         */
+        pLanes = Tracker->TileLanes;
+        for (col = 0; col < TileCols; col++)
+            RtlCopyMemory(pLanes + col * HASH_LANES, HashInit, sizeof(HashInit));
+
+        pRow = (CONST UCHAR *) FrameBuffer + (SIZE_T) y * Pitch;
+        for (row = 0; row < Rows; row += HASH_BLOCK_ROWS, pRow += (SIZE_T) Pitch * HASH_BLOCK_ROWS)
+        {
+            Block = Rows - row;
+            if (Block > HASH_BLOCK_ROWS)
+                Block = HASH_BLOCK_ROWS;
+            for (x = 0, col = 0; x < Width; x += LJB_VMON_DAMAGE_TILE_SIZE, col++)
+            {
+                Cols = Width - x;
+                if (Cols > LJB_VMON_DAMAGE_TILE_SIZE)
+                    Cols = LJB_VMON_DAMAGE_TILE_SIZE;
+                HashBlock(Tracker->UseSse2, pLanes + col * HASH_LANES, pRow + x * 4, Pitch, Cols, Block);
+            }
+        }
+
+        RunOpen = FALSE;
+        Run.Top = (LONG) y;
+        Run.Bottom = (LONG) (y + Rows);
+        Run.Left = Run.Right = 0;
+
+        for (x = 0, col = 0; x < Width; x += LJB_VMON_DAMAGE_TILE_SIZE, col++, pHash++)
+        {
+            Cols = Width - x;
+            if (Cols > LJB_VMON_DAMAGE_TILE_SIZE)
+                Cols = LJB_VMON_DAMAGE_TILE_SIZE;
+
+            Hash = HashMerge(pLanes + col * HASH_LANES, Cols, Rows);
+            if (!Full && Hash == *pHash)
+            {
+                if (RunOpen)
+                {
+                    LJB_VMON_DamageAddRect(Damage, &Run);
+                    RunOpen = FALSE;
+                }
+                continue;
+            }
+            *pHash = Hash;
+
+            if (!RunOpen)
+            {
+                Run.Left = (LONG) x;
+                RunOpen = TRUE;
+            }
+            Run.Right = (LONG) (x + Cols);
+        }
+
+        if (RunOpen && !Full)
+            LJB_VMON_DamageAddRect(Damage, &Run);
+    }
+}
@@ -0,0 +1,124 @@
+/*!
+    \file       ljb_vmon_damage.h
+    \brief      Damaged rectangle lists and frame-to-frame damage tracking
+    \details    The ProxyKMD reports a whole new frame on every
+                VidPnSourceBitmapChange without saying what changed, even
+                when the present drew the same pixels again. The damage
+                tracker keeps a 64-bit hash of every tile of the last frame
+                handed to the sinks and compares the new frame's tile hashes
+                against them, so consumers only have to process what actually
+                changed, and a present that changed nothing is not passed on
+                at all.
+ */
+
+#ifndef _LJB_VMON_DAMAGE_H_
+#define _LJB_VMON_DAMAGE_H_
+
+#include <windows.h>
+
+/*
+ * Right and Bottom are exclusive, as in a Win32 RECT.
+ */
+typedef struct _LJB_VMON_RECT
+{
+    LONG                Left;
+    LONG                Top;
+    LONG                Right;
+    LONG                Bottom;
+} LJB_VMON_RECT;
+
+/*
+ * A damage list never holds more than LJB_VMON_MAX_DAMAGE_RECTS rectangles.
+ * When a rectangle does not fit, the whole list collapses into its bounding
+ * box, which is always a superset of the real damage.
+ */
+#define LJB_VMON_MAX_DAMAGE_RECTS   16
+
+typedef struct _LJB_VMON_DAMAGE
+{
+    UINT                NumRects;
+    LJB_VMON_RECT       Rects[LJB_VMON_MAX_DAMAGE_RECTS];
+} LJB_VMON_DAMAGE;
+
+/*
+ * Tiles compared by the tracker. 64 pixels is one cache line per 16 pixels
+ * of a row, and keeps a 4K frame at 60x34 tiles.
+ */
+#define LJB_VMON_DAMAGE_TILE_SIZE   64
+
+typedef struct _LJB_VMON_DAMAGE_TRACKER
+{
+    ULONG64 *           TileHashes;     // last frame handed out, row major
+    UINT                MaxTiles;
+    ULONG64 *           TileLanes;      // hash state of the tile row being hashed
+    UINT                MaxTileCols;
+    UINT                Width;
+    UINT                Height;
+    BOOLEAN             Valid;
+    BOOLEAN             UseSse2;
+} LJB_VMON_DAMAGE_TRACKER;
+
+VOID
+LJB_VMON_DamageReset(
+    __out LJB_VMON_DAMAGE *                 Damage
+    );
+
+VOID
+LJB_VMON_DamageAddRect(
+    __inout LJB_VMON_DAMAGE *               Damage,
+    __in CONST LJB_VMON_RECT *              Rect
+    );
+
+VOID
+LJB_VMON_DamageAddDamage(
+    __inout LJB_VMON_DAMAGE *               Damage,
+    __in CONST LJB_VMON_DAMAGE *            Other
+    );
+
+VOID
+LJB_VMON_DamageSetFull(
+    __out LJB_VMON_DAMAGE *                 Damage,
+    __in UINT                               Width,
+    __in UINT                               Height
+    );
+
+ULONG64
+LJB_VMON_DamageArea(
+    __in CONST LJB_VMON_DAMAGE *            Damage
+    );
+
+ULONG64
+LJB_VMON_DamageHashTile(
+    __in CONST LJB_VMON_DAMAGE_TRACKER *    Tracker,
+    __in CONST VOID *                       Tile,
+    __in UINT                               Pitch,
+    __in UINT                               Cols,
+    __in UINT                               Rows
+    );
+
+VOID
+LJB_VMON_DamageTrackerInit(
+    __out LJB_VMON_DAMAGE_TRACKER *         Tracker
+    );
+
+VOID
+LJB_VMON_DamageTrackerDeInit(
+    __inout LJB_VMON_DAMAGE_TRACKER *       Tracker
+    );
+
+VOID
+LJB_VMON_DamageTrackerInvalidate(
+    __inout LJB_VMON_DAMAGE_TRACKER *       Tracker
+    );
+
+VOID
+LJB_VMON_DamageTrackerUpdate(
+    __inout LJB_VMON_DAMAGE_TRACKER *       Tracker,
+    __in CONST VOID *                       FrameBuffer,
+    __in UINT                               Width,
+    __in UINT                               Height,
+    __in UINT                               Pitch,
+    __out LJB_VMON_DAMAGE *                 Damage
+    );
+
+#endif /* _LJB_VMON_DAMAGE_H_ */
@@ -0,0 +1,988 @@
+#include "ljb_vmon_edid.h"
+
+/*
+ * Resolutions the VMON may offer, largest area first; the first that fits is
+ * the preferred mode.
+ */
+static CONST struct
+{
+    UINT    Width;
+    UINT    Height;
+} LJB_VMON_EdidResolutions[] =
+{
+    { 3840, 2160 },
+    { 2560, 1600 },
+    { 2560, 1440 },
+    { 2048, 1152 },
+    { 1920, 1200 },
+    { 1920, 1080 },
+    { 1680, 1050 },
+    { 1400, 1050 },
+    { 1600, 900  },
+    { 1280, 1024 },
+    { 1440, 900  },
+    { 1280, 960  },
+    { 1024, 768  },
+    { 800,  600  },
+    { 640,  480  },
+};
+
+static CONST UINT LJB_VMON_EdidRefreshRates[] = { 60, 50, 30 };
+
+/*
+ * Resolutions also offered at a high refresh rate, the highest of
+ * LJB_VMON_EdidHighRefreshRates that fits, after the others.
+ */
+static CONST struct
+{
+    UINT    Width;
+    UINT    Height;
+} LJB_VMON_EdidHighRefreshResolutions[] =
+{
+    { 2560, 1440 },
+    { 1920, 1080 },
+};
+
+static CONST UINT LJB_VMON_EdidHighRefreshRates[] = { 144, 120 };
+
+/*
+ * The established timings of bytes 35 to 37 of the base block
+ */
+static CONST struct
+{
+    UCHAR   Byte;
+    UCHAR   Bit;
+    UINT    Width;
+    UINT    Height;
+    UINT    Refresh;
+} LJB_VMON_EdidEstablished[] =
+{
+    { 35, 7, 720,  400,  70 },
+    { 35, 6, 720,  400,  88 },
+    { 35, 5, 640,  480,  60 },
+    { 35, 4, 640,  480,  67 },
+    { 35, 3, 640,  480,  72 },
+    { 35, 2, 640,  480,  75 },
+    { 35, 1, 800,  600,  56 },
+    { 35, 0, 800,  600,  60 },
+    { 36, 7, 800,  600,  72 },
+    { 36, 6, 800,  600,  75 },
+    { 36, 5, 832,  624,  75 },
+    { 36, 4, 1024, 768,  87 },
+    { 36, 3, 1024, 768,  60 },
+    { 36, 2, 1024, 768,  70 },
+    { 36, 1, 1024, 768,  75 },
+    { 36, 0, 1280, 1024, 75 },
+    { 37, 7, 1152, 870,  75 },
+};
+
+/*
+ * Aspect ratio codes of a standard timing, EDID 1.3
+ */
+static CONST struct
+{
+    UINT    X;
+    UINT    Y;
+} LJB_VMON_EdidStdRatios[4] =
+{
+    { 16, 10 },
+    { 4,  3  },
+    { 5,  4  },
+    { 16, 9  },
+};
+
+/*
+ * CTA-861 video identification codes of the modes the VMON may offer
+ */
+static CONST struct
+{
+    UCHAR   Vic;
+    UINT    Width;
+    UINT    Height;
+    UINT    Refresh;
+} LJB_VMON_EdidVics[] =
+{
+    { 1,  640,  480,  60  },
+    { 4,  1280, 720,  60  },
+    { 16, 1920, 1080, 60  },
+    { 19, 1280, 720,  50  },
+    { 31, 1920, 1080, 50  },
+    { 34, 1920, 1080, 30  },
+    { 63, 1920, 1080, 120 },
+    { 95, 3840, 2160, 30  },
+    { 96, 3840, 2160, 50  },
+    { 97, 3840, 2160, 60  },
+};
+
+/*
+ * CVT reduced blanking vertical sync width by aspect ratio, 10 otherwise
+ */
+static CONST struct
+{
+    UINT    X;
+    UINT    Y;
+    UINT    VSyncPulse;
+} LJB_VMON_EdidCvtVSync[] =
+{
+    { 4,  3,  4 },
+    { 16, 9,  5 },
+    { 16, 10, 6 },
+    { 5,  4,  7 },
+    { 15, 9,  7 },
+};
+
+/*
+ * The base block the VMON's is made from, borrowed from a Samsung
+ * SyncMaster 2343; identity, timings and descriptors are overwritten.
+ */
+static CONST UCHAR LJB_VMON_EdidTemplate[LJB_VMON_EDID_BLOCK_SIZE] = {
+//    00    01    02    03    04    05    06    07    08    09    0A    0B    0C    0D    0E    0F
+    0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x4C, 0x2D, 0x85, 0x05, 0x33, 0x32, 0x59, 0x4D,
+    0x01, 0x14, 0x01, 0x03, 0x80, 0x33, 0x1D, 0x78, 0x2A, 0xEE, 0x91, 0xA3, 0x54, 0x4C, 0x99, 0x26,
+    0x0F, 0x50, 0x54, 0x23, 0x08, 0x00, 0x81, 0x80, 0x81, 0x40, 0x81, 0x00, 0x95, 0x00, 0xB3, 0x00,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x3B, 0x3D, 0x00, 0xA0, 0x80, 0x80, 0x21, 0x40, 0x30, 0x20,
+    0x35, 0x00, 0xFE, 0x1F, 0x11, 0x00, 0x00, 0x1A, 0x00, 0x00, 0x00, 0xFD, 0x00, 0x38, 0x3C, 0x1E,
+    0x51, 0x10, 0x00, 0x0A, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0xFC, 0x00, 0x53,
+    0x79, 0x6E, 0x63, 0x4D, 0x61, 0x73, 0x74, 0x65, 0x72, 0x0A, 0x20, 0x20, 0x00, 0x00, 0x00, 0xFF,
+    0x00, 0x48, 0x56, 0x4D, 0x5A, 0x31, 0x30, 0x30, 0x30, 0x38, 0x30, 0x0A, 0x20, 0x20, 0x01, 0x76,
+};
+
+#define TO_PNP(c)   ((c) - 64)
+
+#define EDID_STD_TIMING             38      // 8 of 2 bytes
+#define EDID_DESCRIPTOR             54      // 4 of 18 bytes
+#define EDID_DESCRIPTOR_SIZE        18
+#define EDID_EXTENSION_COUNT        126
+#define EDID_CTA_TAG                0x02
+#define EDID_CTA_VIDEO_BLOCK        2
+#define EDID_HDISPLAY_MM            510     // hardcoded common monitor size
+#define EDID_VDISPLAY_MM            287
+
+/*
+ * Name:  LJB_VMON_EdidModeFits
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_EdidModeFits(
+ *        __in CONST LJB_VMON_EDID_LINK *   Link,
+ *        __in CONST LJB_VMON_EDID_MODE *   Mode
+ *        );
+ *
+ * Description:
+ *    Tell whether Link keeps up with Mode: Activity percent of its pixels
+ *    changing every frame, at Link->BitsPerPixel each, Mode->Refresh times
+ *    a second.
+ *
+ * Return Value:
+ *    Return TRUE if it does, or if the link has no limit. Return FALSE
+ *    otherwise.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_EdidModeFits(
+    __in CONST LJB_VMON_EDID_LINK *     Link,
+    __in CONST LJB_VMON_EDID_MODE *     Mode
+    )
+{
+    UINT CONST  Activity = (Link->Activity != 0) ?
+                    Link->Activity : LJB_VMON_EDID_DEFAULT_ACTIVITY;
+    ULONG64     Bits;
+
+    if (Link->Bandwidth == 0)
+        return TRUE;
+
+    /*
+     * in hundredths of a bit and percent of the screen
+     */
+    Bits = (ULONG64) Mode->Width * Mode->Height * Mode->Refresh * Activity * Link->BitsPerPixel;
+    return Bits <= Link->Bandwidth * 8 * 100 * 100;
+}
+
+/*
+ * Name:  LJB_VMON_EdidTimingFits
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_EdidTimingFits(
+ *        __in CONST LJB_VMON_EDID_MODE *   Mode
+ *        );
+ *
+ * Description:
+ *    Tell whether the detailed timing of Mode fits an 18 byte descriptor:
+ *    a pixel clock of 655.35 MHz at most, and sizes within their fields.
+ *
+ * Return Value:
+ *    Return TRUE if it does, FALSE otherwise.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_EdidTimingFits(
+    __in CONST LJB_VMON_EDID_MODE *     Mode
+    )
+{
+    LJB_VMON_EDID_TIMING    Timing;
+
+    if (Mode->Width == 0 || Mode->Height == 0 || Mode->Refresh == 0 ||
+        Mode->Width > 4095 || Mode->Height > 4095)
+        return FALSE;
+
+    LJB_VMON_EdidGetTiming(Mode, &Timing);
+    return Timing.PixelClock <= 0xFFFF &&
+           Timing.HBlank <= 4095 && Timing.VBlank <= 4095 &&
+           Timing.HSyncOffset <= 1023 && Timing.HSyncPulse <= 1023 &&
+           Timing.VSyncOffset <= 63 && Timing.VSyncPulse <= 63;
+}
+
+/*
+ * Name:  LJB_VMON_EdidSelectModes
+ *
+ * Definition:
+ *    UINT
+ *    LJB_VMON_EdidSelectModes(
+ *        __in CONST LJB_VMON_EDID_LINK *   Link,
+ *        __out LJB_VMON_EDID_MODE *        Modes,
+ *        __in UINT                         MaxModes
+ *        );
+ *
+ * Description:
+ *    List the modes to advertise on Link, largest first, each resolution at
+ *    the highest refresh rate it fits at, then the high refresh rate modes
+ *    that fit. If not even the smallest fits at the lowest rate, that one is
+ *    listed all the same; a monitor without a mode is of no use.
+ *
+ * Return Value:
+ *    Number of modes in Modes, at least 1 if MaxModes is.
+ *
+ */
+UINT
+LJB_VMON_EdidSelectModes(
+    __in CONST LJB_VMON_EDID_LINK *     Link,
+    __out_ecount(MaxModes) LJB_VMON_EDID_MODE * Modes,
+    __in UINT                           MaxModes
+    )
+{
+    UINT CONST          NumResolutions =
+        sizeof(LJB_VMON_EdidResolutions) / sizeof(LJB_VMON_EdidResolutions[0]);
+    UINT CONST          NumRates =
+        sizeof(LJB_VMON_EdidRefreshRates) / sizeof(LJB_VMON_EdidRefreshRates[0]);
+    UINT CONST          NumHighResolutions =
+        sizeof(LJB_VMON_EdidHighRefreshResolutions) / sizeof(LJB_VMON_EdidHighRefreshResolutions[0]);
+    UINT CONST          NumHighRates =
+        sizeof(LJB_VMON_EdidHighRefreshRates) / sizeof(LJB_VMON_EdidHighRefreshRates[0]);
+    LJB_VMON_EDID_MODE  Mode;
+    UINT                NumModes;
+    UINT                i, j;
+
+    NumModes = 0;
+    for (i = 0; i < NumResolutions && NumModes < MaxModes; i++)
+    {
+        Mode.Width = LJB_VMON_EdidResolutions[i].Width;
+        Mode.Height = LJB_VMON_EdidResolutions[i].Height;
+        for (j = 0; j < NumRates; j++)
+        {
+            Mode.Refresh = LJB_VMON_EdidRefreshRates[j];
+            if (LJB_VMON_EdidModeFits(Link, &Mode) && LJB_VMON_EdidTimingFits(&Mode))
+            {
+                Modes[NumModes++] = Mode;
+                break;
+            }
+        }
+    }
+
+    if (NumModes == 0 && MaxModes != 0)
+    {
+        Modes[0].Width = LJB_VMON_EdidResolutions[NumResolutions - 1].Width;
+        Modes[0].Height = LJB_VMON_EdidResolutions[NumResolutions - 1].Height;
+        Modes[0].Refresh = LJB_VMON_EdidRefreshRates[NumRates - 1];
+        return 1;
+    }
+
+    for (i = 0; i < NumHighResolutions && NumModes < MaxModes; i++)
+    {
+        Mode.Width = LJB_VMON_EdidHighRefreshResolutions[i].Width;
+        Mode.Height = LJB_VMON_EdidHighRefreshResolutions[i].Height;
+        for (j = 0; j < NumHighRates; j++)
+        {
+            Mode.Refresh = LJB_VMON_EdidHighRefreshRates[j];
+            if (LJB_VMON_EdidModeFits(Link, &Mode) && LJB_VMON_EdidTimingFits(&Mode))
+            {
+                Modes[NumModes++] = Mode;
+                break;
+            }
+        }
+    }
+    return NumModes;
+}
+
+/*
+ * Name:  LJB_VMON_EdidGetTiming
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_EdidGetTiming(
+ *        __in CONST LJB_VMON_EDID_MODE *   Mode,
+ *        __out LJB_VMON_EDID_TIMING *      Timing
+ *        );
+ *
+ * Description:
+ *    Work out the detailed timing of Mode. Nothing is scanned out, so the
+ *    blanking only has to be plausible to the OS: 1/16 of the width and
+ *    1/32 of the height, as the VMON always had, up to 165 MHz, and CVT
+ *    reduced blanking (version 1) above, where 4K and high refresh rates
+ *    would otherwise not fit a descriptor.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_EdidGetTiming(
+    __in CONST LJB_VMON_EDID_MODE *     Mode,
+    __out LJB_VMON_EDID_TIMING *        Timing
+    )
+{
+    ULONG64     HPeriod;                // nanoseconds
+    UINT        MinVBlank;
+    UINT        i;
+
+    Timing->HBlank = Mode->Width / 16;
+    Timing->VBlank = Mode->Height / 32;
+    Timing->HSyncOffset = Timing->HBlank / 4;
+    Timing->HSyncPulse = Timing->HBlank / 4;
+    Timing->VSyncOffset = Timing->VBlank / 4;
+    Timing->VSyncPulse = Timing->VBlank / 4;
+    Timing->PixelClock = (ULONG) (((ULONG64) (Mode->Width + Timing->HBlank) *
+        (Mode->Height + Timing->VBlank) * Mode->Refresh + 9999) / 10000);
+    if (Timing->PixelClock <= 16500 || Mode->Height == 0 || Mode->Refresh == 0)
+        return;
+
+    /*
+     * CVT-RB: 160 pixels of horizontal blanking, 460 us of vertical
+     */
+    Timing->HBlank = 160;
+    Timing->HSyncOffset = 48;
+    Timing->HSyncPulse = 32;
+    Timing->VSyncOffset = 3;
+    Timing->VSyncPulse = 10;
+    for (i = 0; i < sizeof(LJB_VMON_EdidCvtVSync) / sizeof(LJB_VMON_EdidCvtVSync[0]); i++)
+    {
+        if (Mode->Width * LJB_VMON_EdidCvtVSync[i].Y == Mode->Height * LJB_VMON_EdidCvtVSync[i].X)
+        {
+            Timing->VSyncPulse = LJB_VMON_EdidCvtVSync[i].VSyncPulse;
+            break;
+        }
+    }
+    HPeriod = (1000000000 / Mode->Refresh - 460000) / Mode->Height;
+    if (HPeriod == 0)
+        HPeriod = 1;
+    Timing->VBlank = (UINT) (460000 / HPeriod + 1);
+    MinVBlank = Timing->VSyncOffset + Timing->VSyncPulse + 6;
+    if (Timing->VBlank < MinVBlank)
+        Timing->VBlank = MinVBlank;
+    Timing->PixelClock = (ULONG) (((ULONG64) (Mode->Width + Timing->HBlank) *
+        (Mode->Height + Timing->VBlank) * Mode->Refresh + 9999) / 10000);
+}
+
+/*
+ * index in LJB_VMON_EdidEstablished of Mode, or -1
+ */
+static INT
+LJB_VMON_EdidFindEstablished(
+    __in CONST LJB_VMON_EDID_MODE *     Mode
+    )
+{
+    UINT    i;
+
+    for (i = 0; i < sizeof(LJB_VMON_EdidEstablished) / sizeof(LJB_VMON_EdidEstablished[0]); i++)
+    {
+        if (LJB_VMON_EdidEstablished[i].Width == Mode->Width &&
+            LJB_VMON_EdidEstablished[i].Height == Mode->Height &&
+            LJB_VMON_EdidEstablished[i].Refresh == Mode->Refresh)
+            return (INT) i;
+    }
+    return -1;
+}
+
+/*
+ * VIC of Mode, or 0
+ */
+static UCHAR
+LJB_VMON_EdidFindVic(
+    __in CONST LJB_VMON_EDID_MODE *     Mode
+    )
+{
+    UINT    i;
+
+    for (i = 0; i < sizeof(LJB_VMON_EdidVics) / sizeof(LJB_VMON_EdidVics[0]); i++)
+    {
+        if (LJB_VMON_EdidVics[i].Width == Mode->Width &&
+            LJB_VMON_EdidVics[i].Height == Mode->Height &&
+            LJB_VMON_EdidVics[i].Refresh == Mode->Refresh)
+            return LJB_VMON_EdidVics[i].Vic;
+    }
+    return 0;
+}
+
+/*
+ * Encode Mode as a standard timing, if it can be one: 60 to 123 Hz, a
+ * width of 256 to 2288 in steps of 8, and one of the four aspect ratios.
+ */
+static BOOLEAN
+LJB_VMON_EdidPutStdTiming(
+    __out UCHAR                         StdTiming[2],
+    __in CONST LJB_VMON_EDID_MODE *     Mode
+    )
+{
+    UINT    i;
+
+    if (Mode->Refresh < 60 || Mode->Refresh > 123 ||
+        Mode->Width < 256 || Mode->Width > 2288 || Mode->Width % 8 != 0)
+        return FALSE;
+
+    for (i = 0; i < 4; i++)
+    {
+        if (Mode->Width * LJB_VMON_EdidStdRatios[i].Y == Mode->Height * LJB_VMON_EdidStdRatios[i].X)
+        {
+            StdTiming[0] = (UCHAR) (Mode->Width / 8 - 31);
+            StdTiming[1] = (UCHAR) (i << 6 | (Mode->Refresh - 60));
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static VOID
+LJB_VMON_EdidPutDetailedTiming(
+    __out UCHAR                         Desc[EDID_DESCRIPTOR_SIZE],
+    __in CONST LJB_VMON_EDID_MODE *     Mode
+    )
+{
+    LJB_VMON_EDID_TIMING    Timing;
+    UINT CONST              Width = Mode->Width;
+    UINT CONST              Height = Mode->Height;
+
+    LJB_VMON_EdidGetTiming(Mode, &Timing);
+    Desc[0]  = Timing.PixelClock & 0xFF;
+    Desc[1]  = (Timing.PixelClock >> 8) & 0xFF;
+    Desc[2]  = Width & 0xFF;                // Horizontal Active pixels
+    Desc[3]  = Timing.HBlank & 0xFF;        // Horizontal Blanking pixels
+    Desc[4]  = ((Width >> 8) & 0x0F) << 4 | ((Timing.HBlank >> 8) & 0x0F);
+    Desc[5]  = Height & 0xFF;               // Vertical Active Lines
+    Desc[6]  = Timing.VBlank & 0xFF;        // Vertical blanking Lines
+    Desc[7]  = ((Height >> 8) & 0x0F) << 4 | ((Timing.VBlank >> 8) & 0x0F);
+    Desc[8]  = Timing.HSyncOffset & 0xFF;
+    Desc[9]  = Timing.HSyncPulse & 0xFF;
+    Desc[10] = ((Timing.VSyncOffset & 0x0F) << 4) | (Timing.VSyncPulse & 0x0F);
+    Desc[11] = ((Timing.HSyncOffset >> 8) & 0x03) << 6 |
+               ((Timing.HSyncPulse >> 8) & 0x03) << 4 |
+               ((Timing.VSyncOffset >> 4) & 0x03) << 2 |
+               ((Timing.VSyncPulse >> 4) & 0x03) << 0;
+    Desc[12] = EDID_HDISPLAY_MM & 0xFF;
+    Desc[13] = EDID_VDISPLAY_MM & 0xFF;
+    Desc[14] = ((EDID_HDISPLAY_MM >> 8) & 0x0F) << 4 | ((EDID_VDISPLAY_MM >> 8) & 0x0F);
+    Desc[15] = 0;                           // horizontal border
+    Desc[16] = 0;                           // vertical border
+    Desc[17] = 0x1A;                        // digital separate sync, +H -V
+}
+
+/*
+ * Decode a detailed timing descriptor; FALSE if it makes no sense.
+ */
+static BOOLEAN
+LJB_VMON_EdidGetDetailedTiming(
+    __in CONST UCHAR                    Desc[EDID_DESCRIPTOR_SIZE],
+    __out LJB_VMON_EDID_MODE *          Mode
+    )
+{
+    ULONG CONST PixelClock = Desc[0] | Desc[1] << 8;
+    UINT CONST  HBlank = Desc[3] | (Desc[4] & 0x0F) << 8;
+    UINT CONST  VBlank = Desc[6] | (Desc[7] & 0x0F) << 8;
+    UINT CONST  HSyncOffset = Desc[8] | ((Desc[11] >> 6) & 0x03) << 8;
+    UINT CONST  HSyncPulse = Desc[9] | ((Desc[11] >> 4) & 0x03) << 8;
+    UINT CONST  VSyncOffset = (Desc[10] >> 4) | ((Desc[11] >> 2) & 0x03) << 4;
+    UINT CONST  VSyncPulse = (Desc[10] & 0x0F) | (Desc[11] & 0x03) << 4;
+    ULONG64     Total;
+
+    Mode->Width = Desc[2] | (Desc[4] >> 4) << 8;
+    Mode->Height = Desc[5] | (Desc[7] >> 4) << 8;
+    if (Mode->Width == 0 || Mode->Height == 0 ||
+        HSyncOffset + HSyncPulse > HBlank || VSyncOffset + VSyncPulse > VBlank)
+        return FALSE;
+
+    Total = (ULONG64) (Mode->Width + HBlank) * (Mode->Height + VBlank);
+    Mode->Refresh = (UINT) (((ULONG64) PixelClock * 10000 + Total / 2) / Total);
+    return Mode->Refresh != 0;
+}
+
+/*
+ * A display descriptor, Tag 0xFC, 0xFE or 0xFF, holding Text
+ */
+static VOID
+LJB_VMON_EdidPutText(
+    __out UCHAR                         Desc[EDID_DESCRIPTOR_SIZE],
+    __in UCHAR                          Tag,
+    __in CONST CHAR *                   Text
+    )
+{
+    UINT    i;
+
+    RtlZeroMemory(Desc, 5);
+    Desc[3] = Tag;
+    for (i = 0; i < 13 && Text[i] != '\0'; i++)
+        Desc[5 + i] = Text[i];
+    if (i < 13)
+        Desc[5 + i++] = 0x0A;
+    for (; i < 13; i++)
+        Desc[5 + i] = ' ';
+}
+
+/*
+ * The range limits descriptor, wide enough for every mode offered. Windows
+ * works out the clock of a standard timing with GTF or CVT, and a VIC has
+ * the CTA-861 timing, whose blanking may be up to a third more than ours.
+ */
+static VOID
+LJB_VMON_EdidPutRangeLimits(
+    __out UCHAR                         Desc[EDID_DESCRIPTOR_SIZE],
+    __in_ecount(NumModes) CONST LJB_VMON_EDID_MODE * Modes,
+    __in UINT                           NumModes
+    )
+{
+    LJB_VMON_EDID_TIMING    Timing;
+    UINT                    MinRefresh;
+    UINT                    MaxRefresh;
+    ULONG                   MinLineRate;    // kHz
+    ULONG                   MaxLineRate;
+    ULONG                   LineRate;
+    ULONG                   MaxPixelClock;  // 10 kHz units
+    UINT                    i;
+
+    MinRefresh = 56;
+    MaxRefresh = 60;
+    MinLineRate = 30;
+    MaxLineRate = 81;
+    MaxPixelClock = 0;
+    for (i = 0; i < NumModes; i++)
+    {
+        LJB_VMON_EdidGetTiming(&Modes[i], &Timing);
+        if (Modes[i].Refresh < MinRefresh)
+            MinRefresh = Modes[i].Refresh;
+        if (Modes[i].Refresh > MaxRefresh)
+            MaxRefresh = Modes[i].Refresh;
+        LineRate = Timing.PixelClock * 10 / (Modes[i].Width + Timing.HBlank);
+        if (LineRate < MinLineRate)
+            MinLineRate = LineRate;
+        if (LineRate * 4 / 3 + 1 > MaxLineRate)
+            MaxLineRate = LineRate * 4 / 3 + 1;
+        if (Timing.PixelClock * 4 / 3 > MaxPixelClock)
+            MaxPixelClock = Timing.PixelClock * 4 / 3;
+    }
+    MaxPixelClock = (MaxPixelClock + 999) / 1000;      // 10 kHz to 10 MHz units
+    if (MaxPixelClock < 16)
+        MaxPixelClock = 16;
+    if (MaxPixelClock > 255)
+        MaxPixelClock = 255;
+    if (MinLineRate < 1)
+        MinLineRate = 1;
+    if (MaxLineRate > 255)
+        MaxLineRate = 255;
+    if (MaxRefresh > 255)
+        MaxRefresh = 255;
+
+    RtlZeroMemory(Desc, EDID_DESCRIPTOR_SIZE);
+    Desc[3]  = 0xFD;
+    Desc[5]  = (UCHAR) MinRefresh;          // Hz
+    Desc[6]  = (UCHAR) MaxRefresh;
+    Desc[7]  = (UCHAR) MinLineRate;         // kHz
+    Desc[8]  = (UCHAR) MaxLineRate;
+    Desc[9]  = (UCHAR) MaxPixelClock;       // 10 MHz units
+    Desc[10] = 0x00;                        // default GTF
+    Desc[11] = 0x0A;
+    for (i = 12; i < EDID_DESCRIPTOR_SIZE; i++)
+        Desc[i] = ' ';
+}
+
+static VOID
+LJB_VMON_EdidPutChecksum(
+    __inout UCHAR                       Block[LJB_VMON_EDID_BLOCK_SIZE]
+    )
+{
+    UCHAR   Checksum;
+    UINT    i;
+
+    Checksum = 0;
+    for (i = 0; i < LJB_VMON_EDID_BLOCK_SIZE - 1; i++)
+        Checksum += Block[i];
+    Block[LJB_VMON_EDID_BLOCK_SIZE - 1] = (UCHAR) -Checksum;
+}
+
+/*
+ * Name:  LJB_VMON_EdidBuild
+ *
+ * Definition:
+ *    UINT
+ *    LJB_VMON_EdidBuild(
+ *        __in CONST LJB_VMON_EDID_MODE *   Modes,
+ *        __in UINT                         NumModes,
+ *        __out UCHAR *                     Edid,
+ *        __in UINT                         MaxSize
+ *        );
+ *
+ * Description:
+ *    Generate the EDID of the VMON offering Modes, Modes[0] preferred. The
+ *    preferred mode takes the first detailed timing descriptor, the others
+ *    in turn an established timing, a standard timing while there is room,
+ *    a short video descriptor if they have a VIC, or a detailed timing
+ *    descriptor of the CTA-861 extension. The extension is only added if a
+ *    mode needs it and MaxSize has room for it. A mode that finds no room
+ *    is left out; LJB_VMON_EdidParse tells which made it.
+ *
+ * Return Value:
+ *    Bytes of Edid written, LJB_VMON_EDID_BLOCK_SIZE or twice that, or 0 if
+ *    there are no modes or MaxSize is less than a block.
+ *
+ */
+UINT
+LJB_VMON_EdidBuild(
+    __in_ecount(NumModes) CONST LJB_VMON_EDID_MODE * Modes,
+    __in UINT                           NumModes,
+    __out_bcount(MaxSize) UCHAR *       Edid,
+    __in UINT                           MaxSize
+    )
+{
+    UCHAR * CONST               Extension = Edid + LJB_VMON_EDID_BLOCK_SIZE;
+    UCHAR                       Vics[LJB_VMON_EDID_MAX_MODES];
+    CONST LJB_VMON_EDID_MODE *  Detailed[LJB_VMON_EDID_MAX_MODES];
+    UINT                        NumVics;
+    UINT                        NumDetailed;
+    UINT                        NumStdTiming;
+    UINT                        Offset;
+    UINT                        Size;
+    UINT                        i;
+    INT                         Established;
+    UCHAR                       Vic;
+
+    if (NumModes == 0 || MaxSize < LJB_VMON_EDID_BLOCK_SIZE)
+        return 0;
+
+    RtlCopyMemory(Edid, LJB_VMON_EdidTemplate, LJB_VMON_EDID_BLOCK_SIZE);
+
+    /*
+     * manufacturer "LJB", product 0x2016
+     */
+    Edid[8] = (UCHAR) (TO_PNP('L') << 2 | ((TO_PNP('J') >> 3) & 3));
+    Edid[9] = (UCHAR) ((TO_PNP('J') & 0x07) << 5 | (TO_PNP('B') & 0x1F));
+    Edid[10] = 0x16;
+    Edid[11] = 0x20;
+
+    Edid[35] = 0;
+    Edid[36] = 0;
+    Edid[37] = 0;
+    NumStdTiming = 0;
+    NumVics = 0;
+    NumDetailed = 0;
+    for (i = 1; i < NumModes; i++)
+    {
+        Established = LJB_VMON_EdidFindEstablished(&Modes[i]);
+        if (Established >= 0)
+        {
+            Edid[LJB_VMON_EdidEstablished[Established].Byte] |=
+                1 << LJB_VMON_EdidEstablished[Established].Bit;
+            continue;
+        }
+        if (NumStdTiming < 8 &&
+            LJB_VMON_EdidPutStdTiming(&Edid[EDID_STD_TIMING + NumStdTiming * 2], &Modes[i]))
+        {
+            NumStdTiming++;
+            continue;
+        }
+        Vic = LJB_VMON_EdidFindVic(&Modes[i]);
+        if (Vic != 0 && NumVics < LJB_VMON_EDID_MAX_MODES)
+            Vics[NumVics++] = Vic;
+        else if (Vic == 0 && NumDetailed < LJB_VMON_EDID_MAX_MODES)
+            Detailed[NumDetailed++] = &Modes[i];
+    }
+    for (; NumStdTiming < 8; NumStdTiming++)
+    {
+        Edid[EDID_STD_TIMING + NumStdTiming * 2] = 1;
+        Edid[EDID_STD_TIMING + NumStdTiming * 2 + 1] = 1;
+    }
+
+    LJB_VMON_EdidPutDetailedTiming(&Edid[EDID_DESCRIPTOR], &Modes[0]);
+    LJB_VMON_EdidPutRangeLimits(&Edid[EDID_DESCRIPTOR + EDID_DESCRIPTOR_SIZE], Modes, NumModes);
+    LJB_VMON_EdidPutText(&Edid[EDID_DESCRIPTOR + 2 * EDID_DESCRIPTOR_SIZE], 0xFC, "LJBVMON");
+    LJB_VMON_EdidPutText(&Edid[EDID_DESCRIPTOR + 3 * EDID_DESCRIPTOR_SIZE], 0xFF, "LJB2016");
+
+    Edid[EDID_EXTENSION_COUNT] = 0;
+    Size = LJB_VMON_EDID_BLOCK_SIZE;
+    if ((NumVics != 0 || NumDetailed != 0) && MaxSize >= 2 * LJB_VMON_EDID_BLOCK_SIZE)
+    {
+        /*
+         * CTA-861 revision 3: a video data block, then the detailed timings
+         */
+        RtlZeroMemory(Extension, LJB_VMON_EDID_BLOCK_SIZE);
+        Extension[0] = EDID_CTA_TAG;
+        Extension[1] = 3;
+        Offset = 4;
+        if (NumVics != 0)
+        {
+            Extension[Offset++] = (UCHAR) (EDID_CTA_VIDEO_BLOCK << 5 | NumVics);
+            RtlCopyMemory(&Extension[Offset], Vics, NumVics);
+            Offset += NumVics;
+        }
+        Extension[2] = (UCHAR) Offset;
+        Extension[3] = 0;
+        for (i = 0; i < NumDetailed &&
+            Offset + EDID_DESCRIPTOR_SIZE < LJB_VMON_EDID_BLOCK_SIZE; i++)
+        {
+            LJB_VMON_EdidPutDetailedTiming(&Extension[Offset], Detailed[i]);
+            Offset += EDID_DESCRIPTOR_SIZE;
+        }
+        LJB_VMON_EdidPutChecksum(Extension);
+
+        Edid[EDID_EXTENSION_COUNT] = 1;
+        Size = 2 * LJB_VMON_EDID_BLOCK_SIZE;
+    }
+    LJB_VMON_EdidPutChecksum(Edid);
+    return Size;
+}
+
+/*
+ * Name:  LJB_VMON_EdidFindMode
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_EdidFindMode(
+ *        __in CONST LJB_VMON_EDID_MODE *   Modes,
+ *        __in UINT                         NumModes,
+ *        __in CONST LJB_VMON_EDID_MODE *   Mode
+ *        );
+ *
+ * Description:
+ *    Look Mode up in Modes.
+ *
+ * Return Value:
+ *    Return TRUE if it is there, FALSE otherwise.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_EdidFindMode(
+    __in_ecount(NumModes) CONST LJB_VMON_EDID_MODE * Modes,
+    __in UINT                           NumModes,
+    __in CONST LJB_VMON_EDID_MODE *     Mode
+    )
+{
+    UINT    i;
+
+    for (i = 0; i < NumModes; i++)
+    {
+        if (Modes[i].Width == Mode->Width &&
+            Modes[i].Height == Mode->Height &&
+            Modes[i].Refresh == Mode->Refresh)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static VOID
+LJB_VMON_EdidAddMode(
+    __inout_ecount(MaxModes) LJB_VMON_EDID_MODE * Modes,
+    __in UINT                           MaxModes,
+    __inout UINT *                      NumModes,
+    __in UINT                           Width,
+    __in UINT                           Height,
+    __in UINT                           Refresh
+    )
+{
+    LJB_VMON_EDID_MODE  Mode;
+
+    Mode.Width = Width;
+    Mode.Height = Height;
+    Mode.Refresh = Refresh;
+    if (*NumModes < MaxModes && !LJB_VMON_EdidFindMode(Modes, *NumModes, &Mode))
+        Modes[(*NumModes)++] = Mode;
+}
+
+/*
+ * Name:  LJB_VMON_EdidParse
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_EdidParse(
+ *        __in CONST UCHAR *                Edid,
+ *        __in UINT                         Size,
+ *        __out LJB_VMON_EDID_MODE *        Modes,
+ *        __in UINT                         MaxModes,
+ *        __out UINT *                      NumModes
+ *        );
+ *
+ * Description:
+ *    Validate an EDID of Size bytes and list the modes it advertises:
+ *    established and standard timings, detailed timings of the base block
+ *    and of CTA-861 extensions, and the VICs of their video data blocks
+ *    that LJB_VMON_EdidVics knows. The header, the checksum of every block,
+ *    the extension count against Size, the layout of CTA-861 blocks and the
+ *    sync of every detailed timing are checked, and every mode must be
+ *    within the range limits if there are any. Modes past MaxModes are
+ *    not listed.
+ *
+ * Return Value:
+ *    Return TRUE if the EDID is valid, FALSE otherwise.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_EdidParse(
+    __in_bcount(Size) CONST UCHAR *     Edid,
+    __in UINT                           Size,
+    __out_ecount(MaxModes) LJB_VMON_EDID_MODE * Modes,
+    __in UINT                           MaxModes,
+    __out UINT *                        NumModes
+    )
+{
+    static CONST UCHAR  Header[8] = { 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
+    CONST UCHAR *       Block;
+    CONST UCHAR *       Desc;
+    LJB_VMON_EDID_MODE  Mode;
+    UINT                NumBlocks;
+    UINT                MinRefresh;
+    UINT                MaxRefresh;
+    UINT                Offset;
+    UINT                Length;
+    UINT                Vic;
+    UINT                Ratio;
+    UINT                b, i, j, k;
+    UCHAR               Checksum;
+
+    *NumModes = 0;
+    if (Size < LJB_VMON_EDID_BLOCK_SIZE || Size % LJB_VMON_EDID_BLOCK_SIZE != 0)
+        return FALSE;
+
+    for (i = 0; i < sizeof(Header); i++)
+    {
+        if (Edid[i] != Header[i])
+            return FALSE;
+    }
+
+    NumBlocks = Size / LJB_VMON_EDID_BLOCK_SIZE;
+    if (Edid[EDID_EXTENSION_COUNT] + 1U != NumBlocks)
+        return FALSE;
+
+    for (b = 0; b < NumBlocks; b++)
+    {
+        Block = Edid + b * LJB_VMON_EDID_BLOCK_SIZE;
+        Checksum = 0;
+        for (i = 0; i < LJB_VMON_EDID_BLOCK_SIZE; i++)
+            Checksum += Block[i];
+        if (Checksum != 0)
+            return FALSE;
+    }
+
+    if (Edid[18] != 1 || Edid[19] < 3)
+        return FALSE;
+
+    for (i = 0; i < sizeof(LJB_VMON_EdidEstablished) / sizeof(LJB_VMON_EdidEstablished[0]); i++)
+    {
+        if (Edid[LJB_VMON_EdidEstablished[i].Byte] & (1 << LJB_VMON_EdidEstablished[i].Bit))
+            LJB_VMON_EdidAddMode(Modes, MaxModes, NumModes,
+                LJB_VMON_EdidEstablished[i].Width,
+                LJB_VMON_EdidEstablished[i].Height,
+                LJB_VMON_EdidEstablished[i].Refresh);
+    }
+
+    for (i = 0; i < 8; i++)
+    {
+        Desc = &Edid[EDID_STD_TIMING + i * 2];
+        if (Desc[0] == 0 || (Desc[0] == 1 && Desc[1] == 1))
+            continue;
+        Ratio = Desc[1] >> 6;
+        LJB_VMON_EdidAddMode(Modes, MaxModes, NumModes,
+            (Desc[0] + 31) * 8,
+            (Desc[0] + 31) * 8 * LJB_VMON_EdidStdRatios[Ratio].Y / LJB_VMON_EdidStdRatios[Ratio].X,
+            (Desc[1] & 0x3F) + 60);
+    }
+
+    MinRefresh = 0;
+    MaxRefresh = 0;
+    for (i = 0; i < 4; i++)
+    {
+        Desc = &Edid[EDID_DESCRIPTOR + i * EDID_DESCRIPTOR_SIZE];
+        if (Desc[0] != 0 || Desc[1] != 0)
+        {
+            if (!LJB_VMON_EdidGetDetailedTiming(Desc, &Mode))
+                return FALSE;
+            LJB_VMON_EdidAddMode(Modes, MaxModes, NumModes, Mode.Width, Mode.Height, Mode.Refresh);
+        }
+        else if (Desc[3] == 0xFD)
+        {
+            MinRefresh = Desc[5];
+            MaxRefresh = Desc[6];
+            if (MinRefresh > MaxRefresh || Desc[7] > Desc[8])
+                return FALSE;
+        }
+    }
+
+    for (b = 1; b < NumBlocks; b++)
+    {
+        Block = Edid + b * LJB_VMON_EDID_BLOCK_SIZE;
+        if (Block[0] != EDID_CTA_TAG)
+            continue;
+
+        /*
+         * data blocks from byte 4 up to the detailed timings at Block[2]
+         */
+        Offset = Block[2];
+        if (Offset == 0)
+            continue;
+        if (Block[1] == 0 || Offset < 4 || Offset >= LJB_VMON_EDID_BLOCK_SIZE)
+            return FALSE;
+
+        for (i = 4; i < Offset; i += 1 + Length)
+        {
+            Length = Block[i] & 0x1F;
+            if (i + 1 + Length > Offset)
+                return FALSE;
+            if ((Block[i] >> 5) != EDID_CTA_VIDEO_BLOCK)
+                continue;
+            for (j = 0; j < Length; j++)
+            {
+                Vic = Block[i + 1 + j];
+                if (Vic >= 129 && Vic <= 192)
+                    Vic &= 0x7F;                // native
+                for (k = 0; k < sizeof(LJB_VMON_EdidVics) / sizeof(LJB_VMON_EdidVics[0]); k++)
+                {
+                    if (LJB_VMON_EdidVics[k].Vic == Vic)
+                    {
+                        LJB_VMON_EdidAddMode(Modes, MaxModes, NumModes,
+                            LJB_VMON_EdidVics[k].Width,
+                            LJB_VMON_EdidVics[k].Height,
+                            LJB_VMON_EdidVics[k].Refresh);
+                        break;
+                    }
+                }
+            }
+        }
+
+        for (i = Offset; i + EDID_DESCRIPTOR_SIZE < LJB_VMON_EDID_BLOCK_SIZE; i += EDID_DESCRIPTOR_SIZE)
+        {
+            if (Block[i] == 0 && Block[i + 1] == 0)
+                break;
+            if (!LJB_VMON_EdidGetDetailedTiming(&Block[i], &Mode))
+                return FALSE;
+            LJB_VMON_EdidAddMode(Modes, MaxModes, NumModes, Mode.Width, Mode.Height, Mode.Refresh);
+        }
+    }
+
+    if (MaxRefresh != 0)
+    {
+        for (i = 0; i < *NumModes; i++)
+        {
+            if (Modes[i].Refresh < MinRefresh || Modes[i].Refresh > MaxRefresh)
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
@@ -0,0 +1,142 @@
+/*!
+    \file       ljb_vmon_edid.h
+    \brief      Display modes a link can sustain, and the EDID of the VMON
+    \details    Windows picks the largest mode the EDID offers, whether or
+                not the link behind the virtual monitor can carry it. The
+                VMON therefore only advertises modes whose update rate the
+                link keeps up with: a mode is sustainable if the bits the
+                codec needs for the share of the screen that changes in a
+                busy frame, times the refresh rate, fit the link's
+                bandwidth. Each resolution is offered at the highest of 60,
+                50 and 30 Hz that fits, so that a large desktop still comes
+                up at 30 Hz on a slow link rather than not at all; the
+                common 16:9 resolutions are offered at 144 or 120 Hz as
+                well when the link keeps up with that.
+
+                The EDID is generated from the modes chosen: a base block
+                with the preferred mode in its detailed timing descriptor,
+                the 60 Hz modes it has room for as established and standard
+                timings, and, when some modes are left over, a CTA-861
+                extension block carrying them as short video descriptors
+                where a VIC exists and as detailed timings otherwise. Modes
+                whose timing the legacy blanking would push over 165 MHz get
+                CVT reduced blanking. The parser reads an EDID back into the
+                modes it advertises, so that what was chosen can be checked
+                against what Windows will see.
+ */
+
+#ifndef _LJB_VMON_EDID_H_
+#define _LJB_VMON_EDID_H_
+
+#include <windows.h>
+
+/*
+ * What the codec sends per changed pixel, in hundredths of a bit: raw
+ * pixels, the lossless tile codec on desktop content, and the tile codec
+ * with lossy video regions.
+ */
+#define LJB_VMON_EDID_BPP_RAW           3200
+#define LJB_VMON_EDID_BPP_TILE          400
+#define LJB_VMON_EDID_BPP_LOSSY         100
+
+/*
+ * share of the screen, in percent, a busy frame changes
+ */
+#define LJB_VMON_EDID_DEFAULT_ACTIVITY  25
+
+#define LJB_VMON_EDID_MAX_MODES         24
+
+/*
+ * The base block and one CTA-861 extension, LCI_DEFAULT_EDID_DATA_SIZE
+ */
+#define LJB_VMON_EDID_BLOCK_SIZE        128
+#define LJB_VMON_EDID_MAX_SIZE          256
+
+/*
+ * modes an EDID the parser reads may list, established timings included
+ */
+#define LJB_VMON_EDID_MAX_PARSED_MODES  64
+
+typedef struct _LJB_VMON_EDID_LINK
+{
+    ULONG64             Bandwidth;      // bytes per second sustained, 0 if no limit
+    UINT                BitsPerPixel;   // LJB_VMON_EDID_BPP_*
+    UINT                Activity;       // percent, 0 for LJB_VMON_EDID_DEFAULT_ACTIVITY
+} LJB_VMON_EDID_LINK;
+
+typedef struct _LJB_VMON_EDID_MODE
+{
+    UINT                Width;
+    UINT                Height;
+    UINT                Refresh;        // Hz
+} LJB_VMON_EDID_MODE;
+
+/*
+ * The detailed timing the VMON gives a mode: blanking of 1/16 of the width
+ * and 1/32 of the height, sync pulses a quarter of the blanking each, or
+ * CVT reduced blanking for modes that would be over 165 MHz that way.
+ */
+typedef struct _LJB_VMON_EDID_TIMING
+{
+    UINT                HBlank;
+    UINT                VBlank;
+    UINT                HSyncOffset;
+    UINT                HSyncPulse;
+    UINT                VSyncOffset;
+    UINT                VSyncPulse;
+    ULONG               PixelClock;     // 10 kHz units, as in the EDID
+} LJB_VMON_EDID_TIMING;
+
+__checkReturn
+BOOLEAN
+LJB_VMON_EdidModeFits(
+    __in CONST LJB_VMON_EDID_LINK *     Link,
+    __in CONST LJB_VMON_EDID_MODE *     Mode
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_EdidTimingFits(
+    __in CONST LJB_VMON_EDID_MODE *     Mode
+    );
+
+UINT
+LJB_VMON_EdidSelectModes(
+    __in CONST LJB_VMON_EDID_LINK *     Link,
+    __out_ecount(MaxModes) LJB_VMON_EDID_MODE * Modes,
+    __in UINT                           MaxModes
+    );
+
+VOID
+LJB_VMON_EdidGetTiming(
+    __in CONST LJB_VMON_EDID_MODE *     Mode,
+    __out LJB_VMON_EDID_TIMING *        Timing
+    );
+
+UINT
+LJB_VMON_EdidBuild(
+    __in_ecount(NumModes) CONST LJB_VMON_EDID_MODE * Modes,
+    __in UINT                           NumModes,
+    __out_bcount(MaxSize) UCHAR *       Edid,
+    __in UINT                           MaxSize
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_EdidParse(
+    __in_bcount(Size) CONST UCHAR *     Edid,
+    __in UINT                           Size,
+    __out_ecount(MaxModes) LJB_VMON_EDID_MODE * Modes,
+    __in UINT                           MaxModes,
+    __out UINT *                        NumModes
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_EdidFindMode(
+    __in_ecount(NumModes) CONST LJB_VMON_EDID_MODE * Modes,
+    __in UINT                           NumModes,
+    __in CONST LJB_VMON_EDID_MODE *     Mode
+    );
+
+#endif /* _LJB_VMON_EDID_H_ */
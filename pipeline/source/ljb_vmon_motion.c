@@ -0,0 +1,763 @@
+#include "ljb_vmon_motion.h"
+
+/*
+ * Detection runs over the damage of one frame in four steps:
+ *
+ * 1. Keys: runs of LJB_VMON_MOTION_KEY_PIXELS pixels sampled on a grid over
+ *    each damage rectangle of the new frame, skipping flat runs (which match
+ *    anywhere) and runs that did not change. Keys whose hash occurs twice
+ *    are kept but ignored, they cannot tell where they came from.
+ *
+ * 2. Votes: a polynomial rolling hash slides over every fourth row of the
+ *    previous frame inside the damage, and each position whose hash is a
+ *    key is noted with the key. Key rows are an odd number of rows apart,
+ *    so for any dy some of them line up with scanned rows. A key found in
+ *    exactly one place votes for the translation (dx, dy) from there to the
+ *    key; text and patterns repeat, and keys found in several places would
+ *    only spread votes around.
+ *
+ * 3. Growing: starting from a key that voted for the most popular
+ *    translation, the copy grows up and down while the key's columns still
+ *    match the previous frame translated, then left and right as far as all
+ *    of those rows do, within the bounds of the damage. Every comparison is
+ *    exact, so hash collisions can cost time but never correctness.
+ *
+ * 4. Residual: the damage minus the destinations of the copies found.
+ *
+ * Moves come from scrolling and dragging, which damage the source as well
+ * as the destination, so only the damage of the previous frame is searched.
+ */
+#define MOTION_HASH_BASE        0x9E3779B97F4A7C15ULL
+#define MOTION_KEY_ROW_STEP     9       // odd, see MOTION_SCAN_ROW_STEP
+#define MOTION_KEY_COL_STEP     64
+#define MOTION_SCAN_ROW_STEP    4
+#define MOTION_MIN_RECT_WIDTH   (LJB_VMON_MOTION_KEY_PIXELS * 2)
+#define MOTION_MIN_RECT_HEIGHT  16
+#define MOTION_MIN_VOTES        3
+#define MOTION_MIN_COPY_AREA    (LJB_VMON_DAMAGE_TILE_SIZE * LJB_VMON_DAMAGE_TILE_SIZE)
+#define MOTION_MAX_PIECES       64
+
+#define MOTION_ROW(Base, Pitch, y)  \
+    ((CONST ULONG *) ((CONST UCHAR *) (Base) + (SIZE_T) (y) * (Pitch)))
+
+static UINT
+MotionKeySlot(
+    __in ULONG64                Hash
+    )
+{
+    return (UINT) (Hash >> 40) & (LJB_VMON_MOTION_KEY_SLOTS - 1);
+}
+
+static UINT
+MotionFilterBit(
+    __in ULONG64                Hash
+    )
+{
+    return (UINT) (Hash >> 51) & (LJB_VMON_MOTION_FILTER_BITS - 1);
+}
+
+static UINT
+MotionVoteSlot(
+    __in LONG                   Dx,
+    __in LONG                   Dy
+    )
+{
+    ULONG64 CONST   h = ((ULONG64) (ULONG) Dx << 32 | (ULONG) Dy) * MOTION_HASH_BASE;
+
+    return (UINT) (h >> 40) & (LJB_VMON_MOTION_VOTE_SLOTS - 1);
+}
+
+static ULONG64
+MotionHashRun(
+    __in CONST ULONG *          p
+    )
+{
+    ULONG64 Hash = 0;
+    UINT    i;
+
+    for (i = 0; i < LJB_VMON_MOTION_KEY_PIXELS; i++)
+        Hash = Hash * MOTION_HASH_BASE + p[i];
+    return Hash;
+}
+
+static BOOLEAN
+MotionAddKey(
+    __inout LJB_VMON_MOTION_DETECTOR *  Detector,
+    __in ULONG64                        Hash,
+    __in LONG                           X,
+    __in LONG                           Y
+    )
+{
+    UINT CONST  Bit = MotionFilterBit(Hash);
+    UINT        Slot = MotionKeySlot(Hash);
+    UINT        i;
+
+    Detector->Filter[Bit / 32] |= 1UL << (Bit % 32);
+
+    for (i = 0; i < LJB_VMON_MOTION_KEY_SLOTS; i++)
+    {
+        LJB_VMON_MOTION_KEY * CONST pKey = &Detector->Keys[Slot];
+
+        if (pKey->X < 0)
+        {
+            pKey->Hash = Hash;
+            pKey->X = X;
+            pKey->Y = Y;
+            pKey->Hits = 0;
+            return TRUE;
+        }
+        if (pKey->Hash == Hash)
+        {
+            pKey->Y = -1;
+            return FALSE;
+        }
+        Slot = (Slot + 1) & (LJB_VMON_MOTION_KEY_SLOTS - 1);
+    }
+    return FALSE;
+}
+
+static LJB_VMON_MOTION_KEY *
+MotionFindKey(
+    __inout LJB_VMON_MOTION_DETECTOR *  Detector,
+    __in ULONG64                        Hash
+    )
+{
+    UINT    Slot = MotionKeySlot(Hash);
+
+    for (;;)
+    {
+        LJB_VMON_MOTION_KEY * CONST pKey = &Detector->Keys[Slot];
+
+        if (pKey->X < 0)
+            return NULL;
+        if (pKey->Hash == Hash)
+            return (pKey->Y >= 0) ? pKey : NULL;
+        Slot = (Slot + 1) & (LJB_VMON_MOTION_KEY_SLOTS - 1);
+    }
+}
+
+static VOID
+MotionVote(
+    __inout LJB_VMON_MOTION_DETECTOR *  Detector,
+    __in CONST LJB_VMON_MOTION_KEY *    Key
+    )
+{
+    LONG CONST  Dx = Key->X - Key->HitX;
+    LONG CONST  Dy = Key->Y - Key->HitY;
+    UINT        Slot = MotionVoteSlot(Dx, Dy);
+    UINT        i;
+
+    for (i = 0; i < LJB_VMON_MOTION_VOTE_SLOTS; i++)
+    {
+        LJB_VMON_MOTION_VOTE * CONST    pVote = &Detector->Votes[Slot];
+
+        if (pVote->Votes == 0)
+        {
+            pVote->Dx = Dx;
+            pVote->Dy = Dy;
+            pVote->Votes = 1;
+            pVote->SeedX = Key->X;
+            pVote->SeedY = Key->Y;
+            return;
+        }
+        if (pVote->Dx == Dx && pVote->Dy == Dy)
+        {
+            pVote->Votes++;
+            return;
+        }
+        Slot = (Slot + 1) & (LJB_VMON_MOTION_VOTE_SLOTS - 1);
+    }
+}
+
+static BOOLEAN
+RectIntersect(
+    __out LJB_VMON_RECT *       Result,
+    __in CONST LJB_VMON_RECT *  A,
+    __in CONST LJB_VMON_RECT *  B
+    )
+{
+    Result->Left   = A->Left   > B->Left   ? A->Left   : B->Left;
+    Result->Top    = A->Top    > B->Top    ? A->Top    : B->Top;
+    Result->Right  = A->Right  < B->Right  ? A->Right  : B->Right;
+    Result->Bottom = A->Bottom < B->Bottom ? A->Bottom : B->Bottom;
+    return (BOOLEAN) (Result->Left < Result->Right && Result->Top < Result->Bottom);
+}
+
+/*
+ * A minus B, as up to four rectangles
+ */
+static UINT
+RectSubtract(
+    __in CONST LJB_VMON_RECT *  A,
+    __in CONST LJB_VMON_RECT *  B,
+    __out LJB_VMON_RECT *       Pieces
+    )
+{
+    LJB_VMON_RECT   i;
+    UINT            n = 0;
+
+    if (!RectIntersect(&i, A, B))
+    {
+        Pieces[n++] = *A;
+        return n;
+    }
+    if (i.Top > A->Top)
+    {
+        Pieces[n].Left = A->Left; Pieces[n].Top = A->Top;
+        Pieces[n].Right = A->Right; Pieces[n].Bottom = i.Top;
+        n++;
+    }
+    if (i.Bottom < A->Bottom)
+    {
+        Pieces[n].Left = A->Left; Pieces[n].Top = i.Bottom;
+        Pieces[n].Right = A->Right; Pieces[n].Bottom = A->Bottom;
+        n++;
+    }
+    if (i.Left > A->Left)
+    {
+        Pieces[n].Left = A->Left; Pieces[n].Top = i.Top;
+        Pieces[n].Right = i.Left; Pieces[n].Bottom = i.Bottom;
+        n++;
+    }
+    if (i.Right < A->Right)
+    {
+        Pieces[n].Left = i.Right; Pieces[n].Top = i.Top;
+        Pieces[n].Right = A->Right; Pieces[n].Bottom = i.Bottom;
+        n++;
+    }
+    return n;
+}
+
+/*
+ * Sample the keys of every damage rectangle large enough to hold a move,
+ * on rows MOTION_KEY_ROW_STEP apart across the frame, spreading
+ * LJB_VMON_MOTION_MAX_KEYS over those rows. Successive rows start at
+ * different columns.
+ */
+static UINT
+MotionSampleKeys(
+    __inout LJB_VMON_MOTION_DETECTOR *  Detector,
+    __in CONST VOID *                   FrameBuffer,
+    __in UINT                           Pitch,
+    __in CONST LJB_VMON_DAMAGE *        Damage
+    )
+{
+    UINT CONST      ShadowPitch = Detector->Width * 4;
+    CONST ULONG *   p;
+    UINT            NumKeys = 0;
+    UINT            NumRows = 0;
+    UINT            KeysPerRow;
+    LONG            ColStep;
+    UINT            r, i;
+    LONG            x, y;
+
+#define MOTION_KEY_RECT(pRect)                                                  \
+    ((pRect)->Right - (pRect)->Left >= MOTION_MIN_RECT_WIDTH &&                 \
+     (pRect)->Bottom - (pRect)->Top >= MOTION_MIN_RECT_HEIGHT)
+
+    for (r = 0; r < Damage->NumRects; r++)
+    {
+        if (MOTION_KEY_RECT(&Damage->Rects[r]))
+            NumRows += (Damage->Rects[r].Bottom - Damage->Rects[r].Top) / MOTION_KEY_ROW_STEP + 1;
+    }
+    if (NumRows == 0)
+        return 0;
+    KeysPerRow = LJB_VMON_MOTION_MAX_KEYS / NumRows;
+    if (KeysPerRow == 0)
+        KeysPerRow = 1;
+
+    for (r = 0; r < Damage->NumRects && NumKeys < LJB_VMON_MOTION_MAX_KEYS; r++)
+    {
+        CONST LJB_VMON_RECT * CONST pRect = &Damage->Rects[r];
+
+        if (!MOTION_KEY_RECT(pRect))
+            continue;
+
+        ColStep = (pRect->Right - pRect->Left - LJB_VMON_MOTION_KEY_PIXELS) / KeysPerRow;
+        if (ColStep < MOTION_KEY_COL_STEP)
+            ColStep = MOTION_KEY_COL_STEP;
+
+        y = (pRect->Top + MOTION_KEY_ROW_STEP - 1) / MOTION_KEY_ROW_STEP * MOTION_KEY_ROW_STEP;
+        for (; y < pRect->Bottom && NumKeys < LJB_VMON_MOTION_MAX_KEYS; y += MOTION_KEY_ROW_STEP)
+        for (x = pRect->Left + (y / MOTION_KEY_ROW_STEP * 37) % ColStep;
+             x + LJB_VMON_MOTION_KEY_PIXELS <= pRect->Right && NumKeys < LJB_VMON_MOTION_MAX_KEYS;
+             x += ColStep)
+        {
+            p = MOTION_ROW(FrameBuffer, Pitch, y) + x;
+            for (i = 1; i < LJB_VMON_MOTION_KEY_PIXELS && p[i] == p[0]; i++)
+                ;
+            if (i == LJB_VMON_MOTION_KEY_PIXELS)
+                continue;
+            if (memcmp(p, MOTION_ROW(Detector->Shadow, ShadowPitch, y) + x,
+                    LJB_VMON_MOTION_KEY_PIXELS * 4) == 0)
+                continue;
+
+            if (MotionAddKey(Detector, MotionHashRun(p), x, y))
+                NumKeys++;
+        }
+    }
+
+#undef MOTION_KEY_RECT
+
+    return NumKeys;
+}
+
+/*
+ * Slide over the damage of the previous frame, note where keys are found,
+ * then let the keys found once vote.
+ */
+static VOID
+MotionScan(
+    __inout LJB_VMON_MOTION_DETECTOR *  Detector,
+    __in CONST LJB_VMON_DAMAGE *        Damage
+    )
+{
+    UINT CONST              ShadowPitch = Detector->Width * 4;
+    ULONG64 CONST           KeyPower = Detector->KeyPower;
+    CONST ULONG * CONST     Filter = Detector->Filter;
+    LJB_VMON_MOTION_KEY *   pKey;
+    CONST ULONG *           p;
+    ULONG64                 Hash;
+    UINT                    Bit;
+    UINT                    r, i;
+    LONG                    x, y;
+
+    for (r = 0; r < Damage->NumRects; r++)
+    {
+        CONST LJB_VMON_RECT * CONST pRect = &Damage->Rects[r];
+
+        if (pRect->Right - pRect->Left < LJB_VMON_MOTION_KEY_PIXELS)
+            continue;
+
+        y = (pRect->Top + MOTION_SCAN_ROW_STEP - 1) & ~(MOTION_SCAN_ROW_STEP - 1);
+        for (; y < pRect->Bottom; y += MOTION_SCAN_ROW_STEP)
+        {
+            p = MOTION_ROW(Detector->Shadow, ShadowPitch, y);
+            x = pRect->Left;
+            Hash = MotionHashRun(p + x);
+            for (;;)
+            {
+                Bit = MotionFilterBit(Hash);
+                if (Filter[Bit / 32] & (1UL << (Bit % 32)))
+                {
+                    pKey = MotionFindKey(Detector, Hash);
+                    if (pKey != NULL && (pKey->X != x || pKey->Y != y))
+                    {
+                        if (pKey->Hits++ == 0)
+                        {
+                            pKey->HitX = x;
+                            pKey->HitY = y;
+                        }
+                    }
+                }
+
+                if (x + LJB_VMON_MOTION_KEY_PIXELS >= pRect->Right)
+                    break;
+                Hash = (Hash - p[x] * KeyPower) * MOTION_HASH_BASE + p[x + LJB_VMON_MOTION_KEY_PIXELS];
+                x++;
+            }
+        }
+    }
+
+    for (i = 0; i < LJB_VMON_MOTION_KEY_SLOTS; i++)
+    {
+        pKey = &Detector->Keys[i];
+        if (pKey->X >= 0 && pKey->Y >= 0 && pKey->Hits == 1)
+            MotionVote(Detector, pKey);
+    }
+}
+
+/*
+ * How far left of x0 and right of x1 the row Cur still matches the row Prev
+ * of the previous frame shifted right by Dx, without going past *Left and
+ * *Right, which are narrowed to that.
+ */
+static VOID
+MotionRowExtent(
+    __in CONST ULONG *          Cur,
+    __in CONST ULONG *          Prev,
+    __in LONG                   Dx,
+    __in LONG                   x0,
+    __in LONG                   x1,
+    __inout LONG *              Left,
+    __inout LONG *              Right
+    )
+{
+    LONG    x;
+
+    if (memcmp(Cur + *Left, Prev + *Left - Dx, (SIZE_T) (x0 - *Left) * 4) != 0)
+    {
+        for (x = x0; x > *Left && Cur[x - 1] == Prev[x - 1 - Dx]; x--)
+            ;
+        *Left = x;
+    }
+    if (memcmp(Cur + x1, Prev + x1 - Dx, (SIZE_T) (*Right - x1) * 4) != 0)
+    {
+        for (x = x1; x < *Right && Cur[x] == Prev[x - Dx]; x++)
+            ;
+        *Right = x;
+    }
+}
+
+/*
+ * Grow the copy of translation (Dx, Dy) around the key at (SeedX, SeedY),
+ * inside Rect. Pixels of Rect that did not change can be part of the copy,
+ * a copy that writes what is already there is still exact.
+ */
+static BOOLEAN
+MotionGrow(
+    __in CONST LJB_VMON_MOTION_DETECTOR *   Detector,
+    __in CONST VOID *                       FrameBuffer,
+    __in UINT                               Pitch,
+    __in CONST LJB_VMON_RECT *              Rect,
+    __in CONST LJB_VMON_MOTION_VOTE *       Vote,
+    __out LJB_VMON_COPY_RECT *              Copy
+    )
+{
+    UINT CONST  ShadowPitch = Detector->Width * 4;
+    LONG CONST  Width = (LONG) Detector->Width;
+    LONG CONST  Height = (LONG) Detector->Height;
+    LONG CONST  Dx = Vote->Dx;
+    LONG CONST  Dy = Vote->Dy;
+    LONG        x0, x1, y0, y1;
+    LONG        Left, Right;
+    LONG        y;
+
+    x0 = Vote->SeedX;
+    x1 = Vote->SeedX + LJB_VMON_MOTION_KEY_PIXELS;
+    y0 = Vote->SeedY;
+    y1 = Vote->SeedY + 1;
+
+#define MOTION_ROW_MATCHES(y)                                               \
+    (memcmp(MOTION_ROW(FrameBuffer, Pitch, (y)) + x0,                       \
+            MOTION_ROW(Detector->Shadow, ShadowPitch, (y) - Dy) + x0 - Dx,  \
+            (SIZE_T) (x1 - x0) * 4) == 0)
+
+    if (!MOTION_ROW_MATCHES(y0))
+        return FALSE;
+    while (y0 > Rect->Top && y0 - 1 - Dy >= 0 && MOTION_ROW_MATCHES(y0 - 1))
+        y0--;
+    while (y1 < Rect->Bottom && y1 - Dy < Height && MOTION_ROW_MATCHES(y1))
+        y1++;
+
+#undef MOTION_ROW_MATCHES
+
+    /*
+     * widen as far as every row allows.
+     */
+    Left = (Rect->Left > Dx) ? Rect->Left : Dx;
+    Right = (Rect->Right < Width + Dx) ? Rect->Right : Width + Dx;
+    for (y = y0; y < y1; y++)
+    {
+        MotionRowExtent(
+            MOTION_ROW(FrameBuffer, Pitch, y),
+            MOTION_ROW(Detector->Shadow, ShadowPitch, y - Dy),
+            Dx,
+            x0,
+            x1,
+            &Left,
+            &Right
+            );
+    }
+    x0 = Left;
+    x1 = Right;
+
+    if ((x1 - x0) * (y1 - y0) < MOTION_MIN_COPY_AREA)
+        return FALSE;
+
+    Copy->Dst.Left = x0;
+    Copy->Dst.Top = y0;
+    Copy->Dst.Right = x1;
+    Copy->Dst.Bottom = y1;
+    Copy->SrcLeft = x0 - Dx;
+    Copy->SrcTop = y0 - Dy;
+    return TRUE;
+}
+
+/*
+ * Residual = Damage minus the copy destinations. If that does not fit the
+ * scratch list, drop the copies and send the damage as it is.
+ */
+static VOID
+MotionResidual(
+    __in CONST LJB_VMON_DAMAGE *            Damage,
+    __inout LJB_VMON_MOTION *               Motion
+    )
+{
+    LJB_VMON_RECT   Pieces[2][MOTION_MAX_PIECES];
+    UINT            NumPieces[2];
+    UINT            Cur, Next;
+    UINT            c, i;
+
+    RtlCopyMemory(Pieces[0], Damage->Rects, Damage->NumRects * sizeof(LJB_VMON_RECT));
+    NumPieces[0] = Damage->NumRects;
+    Cur = 0;
+
+    for (c = 0; c < Motion->NumCopies; c++)
+    {
+        Next = Cur ^ 1;
+        NumPieces[Next] = 0;
+        for (i = 0; i < NumPieces[Cur]; i++)
+        {
+            if (NumPieces[Next] + 4 > MOTION_MAX_PIECES)
+            {
+                Motion->NumCopies = 0;
+                Motion->Residual = *Damage;
+                return;
+            }
+            NumPieces[Next] += RectSubtract(
+                &Pieces[Cur][i],
+                &Motion->Copies[c].Dst,
+                &Pieces[Next][NumPieces[Next]]
+                );
+        }
+        Cur = Next;
+    }
+
+    LJB_VMON_DamageReset(&Motion->Residual);
+    for (i = 0; i < NumPieces[Cur]; i++)
+        LJB_VMON_DamageAddRect(&Motion->Residual, &Pieces[Cur][i]);
+}
+
+/*
+ * Name:  LJB_VMON_MotionInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_MotionInit(
+ *        __out LJB_VMON_MOTION_DETECTOR *  Detector
+ *        );
+ *
+ * Description:
+ *    Initialize a detector. The previous frame copy is allocated by the
+ *    first update.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_MotionInit(
+    __out LJB_VMON_MOTION_DETECTOR *        Detector
+    )
+{
+    UINT    i;
+
+    RtlZeroMemory(Detector, sizeof(*Detector));
+    Detector->KeyPower = 1;
+    for (i = 1; i < LJB_VMON_MOTION_KEY_PIXELS; i++)
+        Detector->KeyPower *= MOTION_HASH_BASE;
+}
+
+/*
+ * Name:  LJB_VMON_MotionDeInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_MotionDeInit(
+ *        __inout LJB_VMON_MOTION_DETECTOR *    Detector
+ *        );
+ *
+ * Description:
+ *    Free the previous frame copy.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_MotionDeInit(
+    __inout LJB_VMON_MOTION_DETECTOR *      Detector
+    )
+{
+    if (Detector->Shadow != NULL)
+        HeapFree(GetProcessHeap(), 0, Detector->Shadow);
+    RtlZeroMemory(Detector, sizeof(*Detector));
+}
+
+/*
+ * Name:  LJB_VMON_MotionInvalidate
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_MotionInvalidate(
+ *        __inout LJB_VMON_MOTION_DETECTOR *    Detector
+ *        );
+ *
+ * Description:
+ *    Forget the previous frame; the next update finds no moves.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_MotionInvalidate(
+    __inout LJB_VMON_MOTION_DETECTOR *      Detector
+    )
+{
+    Detector->Valid = FALSE;
+}
+
+/*
+ * Name:  LJB_VMON_MotionUpdate
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_MotionUpdate(
+ *        __inout LJB_VMON_MOTION_DETECTOR *    Detector,
+ *        __in CONST VOID *                     FrameBuffer,
+ *        __in UINT                             Width,
+ *        __in UINT                             Height,
+ *        __in UINT                             Pitch,
+ *        __in CONST LJB_VMON_DAMAGE *          Damage,
+ *        __out LJB_VMON_MOTION *               Motion
+ *        );
+ *
+ * Description:
+ *    Look for content of the previous frame passed to this routine that
+ *    moved within Damage, the damage of FrameBuffer relative to that frame,
+ *    and split Damage into copies and residual. Then take the damaged
+ *    pixels over into the previous frame copy.
+ *
+ * Return Value:
+ *    None. Without a previous frame, Motion has no copies and the residual
+ *    is Damage.
+ *
+ */
+VOID
+LJB_VMON_MotionUpdate(
+    __inout LJB_VMON_MOTION_DETECTOR *      Detector,
+    __in CONST VOID *                       FrameBuffer,
+    __in UINT                               Width,
+    __in UINT                               Height,
+    __in UINT                               Pitch,
+    __in CONST LJB_VMON_DAMAGE *            Damage,
+    __out LJB_VMON_MOTION *                 Motion
+    )
+{
+    UINT CONST                  ShadowPitch = Width * 4;
+    SIZE_T CONST                RequiredSize = (SIZE_T) ShadowPitch * Height;
+    LJB_VMON_MOTION_VOTE *      pBest;
+    LJB_VMON_COPY_RECT          Copy;
+    LJB_VMON_RECT               Bounds;
+    LJB_VMON_RECT               Src;
+    LJB_VMON_RECT               Overlap;
+    UINT                        Tries;
+    UINT                        i, r;
+    LONG                        y;
+
+    Motion->NumCopies = 0;
+    Motion->Residual = *Damage;
+
+    if (!Detector->Valid || Detector->Width != Width || Detector->Height != Height)
+    {
+        if (Detector->ShadowSize < RequiredSize)
+        {
+            if (Detector->Shadow != NULL)
+                HeapFree(GetProcessHeap(), 0, Detector->Shadow);
+            Detector->ShadowSize = 0;
+            Detector->Shadow = HeapAlloc(GetProcessHeap(), 0, RequiredSize);
+            if (Detector->Shadow == NULL)
+            {
+                Detector->Valid = FALSE;
+                return;
+            }
+            Detector->ShadowSize = RequiredSize;
+        }
+        for (y = 0; y < (LONG) Height; y++)
+        {
+            RtlCopyMemory(
+                (PVOID) MOTION_ROW(Detector->Shadow, ShadowPitch, y),
+                MOTION_ROW(FrameBuffer, Pitch, y),
+                ShadowPitch
+                );
+        }
+        Detector->Width = Width;
+        Detector->Height = Height;
+        Detector->Valid = TRUE;
+        return;
+    }
+
+    if (LJB_VMON_DamageArea(Damage) >= 2 * MOTION_MIN_COPY_AREA)
+    {
+        for (i = 0; i < LJB_VMON_MOTION_KEY_SLOTS; i++)
+            Detector->Keys[i].X = -1;
+        RtlZeroMemory(Detector->Filter, sizeof(Detector->Filter));
+        RtlZeroMemory(Detector->Votes, sizeof(Detector->Votes));
+
+        if (MotionSampleKeys(Detector, FrameBuffer, Pitch, Damage) != 0)
+            MotionScan(Detector, Damage);
+
+        Bounds = Damage->Rects[0];
+        for (r = 1; r < Damage->NumRects; r++)
+        {
+            CONST LJB_VMON_RECT * CONST pRect = &Damage->Rects[r];
+
+            Bounds.Left   = pRect->Left   < Bounds.Left   ? pRect->Left   : Bounds.Left;
+            Bounds.Top    = pRect->Top    < Bounds.Top    ? pRect->Top    : Bounds.Top;
+            Bounds.Right  = pRect->Right  > Bounds.Right  ? pRect->Right  : Bounds.Right;
+            Bounds.Bottom = pRect->Bottom > Bounds.Bottom ? pRect->Bottom : Bounds.Bottom;
+        }
+
+        /*
+         * try the most voted translations first.
+         */
+        for (Tries = 0; Tries < LJB_VMON_MAX_COPY_RECTS; Tries++)
+        {
+            pBest = NULL;
+            for (i = 0; i < LJB_VMON_MOTION_VOTE_SLOTS; i++)
+            {
+                if (Detector->Votes[i].Votes >= MOTION_MIN_VOTES &&
+                    (pBest == NULL || Detector->Votes[i].Votes > pBest->Votes))
+                    pBest = &Detector->Votes[i];
+            }
+            if (pBest == NULL)
+                break;
+
+            if (MotionGrow(
+                    Detector,
+                    FrameBuffer,
+                    Pitch,
+                    &Bounds,
+                    pBest,
+                    &Copy
+                    ))
+            {
+                Src.Left = Copy.SrcLeft;
+                Src.Top = Copy.SrcTop;
+                Src.Right = Copy.SrcLeft + (Copy.Dst.Right - Copy.Dst.Left);
+                Src.Bottom = Copy.SrcTop + (Copy.Dst.Bottom - Copy.Dst.Top);
+                for (i = 0; i < Motion->NumCopies; i++)
+                {
+                    if (RectIntersect(&Overlap, &Src, &Motion->Copies[i].Dst) ||
+                        RectIntersect(&Overlap, &Copy.Dst, &Motion->Copies[i].Dst))
+                        break;
+                }
+                if (i == Motion->NumCopies)
+                    Motion->Copies[Motion->NumCopies++] = Copy;
+            }
+            pBest->Votes = 0;
+        }
+
+        if (Motion->NumCopies != 0)
+            MotionResidual(Damage, Motion);
+    }
+
+    /*
+     * the new frame becomes the previous one.
+     */
+    for (r = 0; r < Damage->NumRects; r++)
+    {
+        CONST LJB_VMON_RECT * CONST pRect = &Damage->Rects[r];
+
+        for (y = pRect->Top; y < pRect->Bottom; y++)
+        {
+            RtlCopyMemory(
+                (PVOID) (MOTION_ROW(Detector->Shadow, ShadowPitch, y) + pRect->Left),
+                MOTION_ROW(FrameBuffer, Pitch, y) + pRect->Left,
+                (SIZE_T) (pRect->Right - pRect->Left) * 4
+                );
+        }
+    }
+}
@@ -0,0 +1,122 @@
+/*!
+    \file       ljb_vmon_motion.h
+    \brief      Scroll and move detection between consecutive frames
+    \details    When a window is scrolled or dragged, nearly every tile of it
+                is damaged, yet most of the new pixels are old pixels at a
+                new place. The motion detector keeps its own copy of the
+                previous frame and looks for such translations inside the
+                damage reported by the damage tracker. What it finds is
+                reported as copy rectangles, to be applied to the previous
+                frame, plus the residual damage the copies do not explain, so
+                a sink with a link to feed sends a few copy commands and the
+                newly exposed strips instead of the whole region.
+
+                Every copy is checked pixel for pixel, a copy rectangle always
+                reproduces its destination exactly.
+ */
+
+#ifndef _LJB_VMON_MOTION_H_
+#define _LJB_VMON_MOTION_H_
+
+#include <windows.h>
+#include "ljb_vmon_damage.h"
+
+/*
+ * Dst is where the pixels land in the new frame; (SrcLeft, SrcTop) is the
+ * top left corner of where they were in the previous frame. Copies are
+ * applied in order, each as if its source was read whole before its
+ * destination is written (source and destination of one copy overlap when
+ * content scrolls). No copy reads pixels an earlier copy of the same frame
+ * wrote.
+ */
+#define LJB_VMON_MAX_COPY_RECTS     4
+
+typedef struct _LJB_VMON_COPY_RECT
+{
+    LJB_VMON_RECT       Dst;
+    LONG                SrcLeft;
+    LONG                SrcTop;
+} LJB_VMON_COPY_RECT;
+
+/*
+ * The previous frame with Copies applied, then the Residual rectangles taken
+ * from the new frame, is the new frame.
+ */
+typedef struct _LJB_VMON_MOTION
+{
+    UINT                NumCopies;
+    LJB_VMON_COPY_RECT  Copies[LJB_VMON_MAX_COPY_RECTS];
+    LJB_VMON_DAMAGE     Residual;
+} LJB_VMON_MOTION;
+
+/*
+ * Candidate translations are found by hashing short horizontal runs of the
+ * new frame's damage (keys) and looking for them in the previous frame with
+ * a rolling hash; each key found in exactly one place votes for one
+ * (dx, dy).
+ */
+#define LJB_VMON_MOTION_KEY_PIXELS  32
+#define LJB_VMON_MOTION_MAX_KEYS    512
+#define LJB_VMON_MOTION_KEY_SLOTS   1024    // power of 2
+#define LJB_VMON_MOTION_FILTER_BITS 8192    // power of 2
+#define LJB_VMON_MOTION_VOTE_SLOTS  1024    // power of 2, at least MAX_KEYS
+
+typedef struct _LJB_VMON_MOTION_KEY
+{
+    ULONG64             Hash;
+    LONG                X;              // -1 if the slot is free
+    LONG                Y;              // -1 if the hash is not unique
+    ULONG               Hits;           // places found in the previous frame
+    LONG                HitX;           // the first of them
+    LONG                HitY;
+} LJB_VMON_MOTION_KEY;
+
+typedef struct _LJB_VMON_MOTION_VOTE
+{
+    LONG                Dx;
+    LONG                Dy;
+    ULONG               Votes;          // 0 if the slot is free
+    LONG                SeedX;          // first key that voted
+    LONG                SeedY;
+} LJB_VMON_MOTION_VOTE;
+
+typedef struct _LJB_VMON_MOTION_DETECTOR
+{
+    PVOID                   Shadow;     // previous frame, Width * 4 pitch
+    SIZE_T                  ShadowSize;
+    UINT                    Width;
+    UINT                    Height;
+    BOOLEAN                 Valid;
+    ULONG64                 KeyPower;   // base ^ (LJB_VMON_MOTION_KEY_PIXELS - 1)
+    LJB_VMON_MOTION_KEY     Keys[LJB_VMON_MOTION_KEY_SLOTS];
+    ULONG                   Filter[LJB_VMON_MOTION_FILTER_BITS / 32];   // key hashes present
+    LJB_VMON_MOTION_VOTE    Votes[LJB_VMON_MOTION_VOTE_SLOTS];
+} LJB_VMON_MOTION_DETECTOR;
+
+VOID
+LJB_VMON_MotionInit(
+    __out LJB_VMON_MOTION_DETECTOR *        Detector
+    );
+
+VOID
+LJB_VMON_MotionDeInit(
+    __inout LJB_VMON_MOTION_DETECTOR *      Detector
+    );
+
+VOID
+LJB_VMON_MotionInvalidate(
+    __inout LJB_VMON_MOTION_DETECTOR *      Detector
+    );
+
+VOID
+LJB_VMON_MotionUpdate(
+    __inout LJB_VMON_MOTION_DETECTOR *      Detector,
+    __in CONST VOID *                       FrameBuffer,
+    __in UINT                               Width,
+    __in UINT                               Height,
+    __in UINT                               Pitch,
+    __in CONST LJB_VMON_DAMAGE *            Damage,
+    __out LJB_VMON_MOTION *                 Motion
+    );
+
+#endif /* _LJB_VMON_MOTION_H_ */
@@ -0,0 +1,282 @@
+/*!
+    \file       ljb_vmon_net.h
+    \brief      Network sink and receiver of the VMON capture loop
+    \details    The network sink streams what the VMON thread reports to a
+                receiver with the protocol of ljb_vmon_netproto.h: frames on
+                a TCP connection, the cursor in UDP datagrams. A frame goes
+                out in one gathered send of a small header block plus the
+                pixels where they lie, the rows of every damaged rectangle
+                straight from the frame buffer (rows that follow each other
+                in memory as one buffer) or the tile encoder's output; pixels
+                are never copied. Sends block the VMON thread. Once the
+                frame channel fails, a thread of the sink connects again
+                every LJB_VMON_NET_RECONNECT_INTERVAL; meanwhile the sink
+                has no credit, so that the sink list keeps what it misses.
+                Back, it sends what changed since the frame the receiver
+                says it has, and the whole frame only if that is none the
+                sink knows.
+
+                The receiver accepts one sender at a time and rebuilds its
+                frames and cursor, and keeps the frame for a sender that
+                comes back to its session. It is the reference decoder of the
+                protocol and checks every size and rectangle it reads. Raw
+                rows are received straight into the frame. It also applies
+                frame channel messages that came another way, as over USB.
+
+                Sockets are kept as ULONG_PTR so that this header does not
+                need winsock2.h, which must come before windows.h.
+ */
+
+#ifndef _LJB_VMON_NET_H_
+#define _LJB_VMON_NET_H_
+
+#include <windows.h>
+#include "ljb_vmon_netproto.h"
+#include "ljb_vmon_sink.h"
+#include "ljb_vmon_tile_codec.h"
+
+/*
+ * buffers gathered by one send call
+ */
+#define LJB_VMON_NET_MAX_BUFFERS        256
+
+/*
+ * header block of a frame message
+ */
+#define LJB_VMON_NET_FRAME_HEAD_SIZE                    \
+    (sizeof(LJB_VMON_NET_HEADER) +                      \
+     sizeof(LJB_VMON_NET_FRAME) +                       \
+     LJB_VMON_MAX_COPY_RECTS * sizeof(LJB_VMON_NET_COPY) + \
+     LJB_VMON_MAX_DAMAGE_RECTS * sizeof(LJB_VMON_NET_RECT))
+
+/*
+ * The sink's reconnect thread tries every RECONNECT_INTERVAL, gives a try
+ * CONNECT_TIMEOUT to connect and RESUME_TIMEOUT for the receiver's answer.
+ */
+#define LJB_VMON_NET_RECONNECT_INTERVAL 500     // ms
+#define LJB_VMON_NET_CONNECT_TIMEOUT    3000    // ms
+#define LJB_VMON_NET_RESUME_TIMEOUT     2000    // ms
+
+/*
+ * LJB_VMON_NET_SINK.Connected
+ */
+#define LJB_VMON_NET_SINK_DOWN          0   // reconnecting, if ever connected
+#define LJB_VMON_NET_SINK_UP            1
+#define LJB_VMON_NET_SINK_BACK          2   // up again; the VMON thread has yet to see Resume
+
+/*
+ * The clock of LJB_VMON_NET_FRAME.SendTime and LJB_VMON_NET_DATAGRAM.SendTime,
+ * in microseconds, wrapping around. Senders and receivers on one machine
+ * share it, so the difference of two readings is a latency.
+ */
+FORCEINLINE
+ULONG
+LJB_VMON_NetMicroseconds(
+    VOID
+    )
+{
+    LARGE_INTEGER   Counter;
+    LARGE_INTEGER   Frequency;
+
+    QueryPerformanceCounter(&Counter);
+    QueryPerformanceFrequency(&Frequency);
+    return (ULONG) ((ULONG64) (Counter.QuadPart / Frequency.QuadPart) * 1000000 +
+                    (ULONG64) (Counter.QuadPart % Frequency.QuadPart) * 1000000 /
+                    (ULONG64) Frequency.QuadPart);
+}
+
+typedef struct _LJB_VMON_NET_SINK_STATS
+{
+    ULONG64             Frames;
+    ULONG64             FrameBytes;         // on the wire, headers included
+    ULONG64             Sends;              // send calls
+    ULONG64             Buffers;            // buffers they gathered
+    ULONG64             CursorDatagrams;
+    ULONG64             CursorBytes;
+    ULONG64             DroppedFrames;      // the frame channel failed under them
+    ULONG64             Reconnects;
+    ULONG64             Resumes;            // reconnects that went on with a delta
+} LJB_VMON_NET_SINK_STATS;
+
+typedef struct _LJB_VMON_NET_SINK
+{
+    ULONG_PTR                   FrameSocket;    // SOCKET
+    ULONG_PTR                   CursorSocket;   // SOCKET, connected UDP
+    BOOLEAN                     WsaStarted;
+    volatile LONG               Connected;      // LJB_VMON_NET_SINK_*
+    BOOLEAN                     Tiles;          // ENCODING_TILE rather than RAW
+    UINT                        Quality;        // of video regions, 0 lossless
+    LJB_VMON_TILE_ENCODER       TileEncoder;
+    UINT                        Width;          // of the last frame sent
+    UINT                        Height;
+    ULONG                       Rotation;
+    ULONG                       FrameId;        // of the last frame sent whole
+    ULONG                       FailedFrameId;  // of the frame a failure cut off
+    BOOLEAN                     HasPending;
+    LJB_VMON_DAMAGE             Pending;        // what a failure may have left half painted
+
+    /*
+     * reconnection; the thread writes the sockets and Resume while the
+     * sink is down, then sets it LJB_VMON_NET_SINK_BACK
+     */
+    CHAR                        Host[256];
+    CHAR                        Port[8];
+    ULONG                       SessionId;
+    HANDLE                      hReconnectThread;
+    HANDLE                      hReconnectEvent;
+    volatile LONG               Stop;
+    LJB_VMON_NET_RESUME         Resume;
+    HANDLE                      hCreditEvent;   // the frame channel is back
+
+    POINTER_SHAPE_DATA *        LastShape;
+    USHORT                      ShapeSerial;    // 0 until the first shape
+    UINT                        PositionsSinceShape;
+    ULONG                       CursorSequence;
+
+    LJB_VMON_NET_SINK_STATS     Stats;
+} LJB_VMON_NET_SINK;
+
+/*
+ * What LJB_VMON_NetReceiverPoll handled.
+ */
+#define LJB_VMON_NET_EVENT_NONE             0   // timed out
+#define LJB_VMON_NET_EVENT_MODE_CHANGE      1
+#define LJB_VMON_NET_EVENT_FRAME            2
+#define LJB_VMON_NET_EVENT_CURSOR_SHAPE     3
+#define LJB_VMON_NET_EVENT_CURSOR_POSITION  4
+#define LJB_VMON_NET_EVENT_CLOSED           5   // the sender left, or broke the protocol
+
+typedef struct _LJB_VMON_NET_EVENT
+{
+    UINT                Type;
+    ULONG               FrameId;
+    ULONG               Latency;        // microseconds since it was sent
+} LJB_VMON_NET_EVENT;
+
+typedef struct _LJB_VMON_NET_RECEIVER_STATS
+{
+    ULONG64             Frames;
+    ULONG64             FrameBytes;         // on the wire, headers included
+    ULONG64             CursorPositions;
+    ULONG64             CursorShapes;
+    ULONG64             CursorDatagrams;
+    ULONG64             StaleDatagrams;     // older than a position applied
+    ULONG64             BadDatagrams;
+    ULONG64             Resumes;            // senders back to the frame kept for them
+} LJB_VMON_NET_RECEIVER_STATS;
+
+typedef struct _LJB_VMON_NET_RECEIVER
+{
+    ULONG_PTR                   ListenSocket;   // SOCKET
+    ULONG_PTR                   FrameSocket;
+    ULONG_PTR                   CursorSocket;
+    BOOLEAN                     WsaStarted;
+    BOOLEAN                     Listening;
+    BOOLEAN                     Connected;
+    USHORT                      Port;
+    ULONG                       SessionId;      // of the sender, 0 for version 1
+    BOOLEAN                     Resumed;        // the sender came back to its session
+
+    /*
+     * the frame, Width x Height 32bpp pixels, Width * 4 bytes per row
+     */
+    UINT                        Width;
+    UINT                        Height;
+    ULONG                       Rotation;
+    BOOLEAN                     HasFrame;
+    ULONG                       FrameId;        // the last applied whole
+    UCHAR *                     Pixels;
+    SIZE_T                      MaxPixels;
+    UCHAR *                     Message;
+    SIZE_T                      MaxMessage;
+    CONST UCHAR *               Source;         // of LJB_VMON_NetReceiverApply
+    SIZE_T                      SourceSize;
+
+    /*
+     * the cursor; Shape is valid once ShapeSerial is not 0
+     */
+    POINTER_SHAPE_DATA *        Shape;
+    USHORT                      ShapeSerial;
+    POINTER_SHAPE_DATA *        Assembly;       // shape being received
+    USHORT                      AssemblySerial;
+    ULONG                       AssemblySize;
+    UINT                        AssemblyMissing;
+    UCHAR                       AssemblyReceived[
+        (sizeof(((POINTER_SHAPE_DATA *) 0)->Buffer) / LJB_VMON_NET_FRAGMENT_SIZE + 7) / 8];
+    LONG                        CursorX;
+    LONG                        CursorY;
+    BOOLEAN                     CursorVisible;
+    USHORT                      CursorShapeSerial;
+    BOOLEAN                     HasPosition;
+    ULONG                       PositionSequence;
+
+    LJB_VMON_NET_RECEIVER_STATS Stats;
+} LJB_VMON_NET_RECEIVER;
+
+__checkReturn
+BOOLEAN
+LJB_VMON_NetSinkInit(
+    __out LJB_VMON_NET_SINK *           NetSink,
+    __in PCSTR                          Address,
+    __in BOOLEAN                        Tiles,
+    __in UINT                           Quality
+    );
+
+VOID
+LJB_VMON_NetSinkDeInit(
+    __inout LJB_VMON_NET_SINK *         NetSink
+    );
+
+VOID
+LJB_VMON_NetSinkGetSink(
+    __in LJB_VMON_NET_SINK *            NetSink,
+    __out LJB_VMON_SINK *               Sink
+    );
+
+ULONG
+LJB_VMON_NetFrameHead(
+    __out UCHAR *                       Head,
+    __in CONST LJB_VMON_SINK_FRAME *    Frame,
+    __in ULONG                          SendTime,
+    __in UCHAR                          Encoding,
+    __in CONST LJB_VMON_COPY_RECT *     Copies,
+    __in UINT                           NumCopies,
+    __in CONST LJB_VMON_DAMAGE *        Damage,
+    __in ULONG64                        PixelsSize
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_NetReceiverInit(
+    __out LJB_VMON_NET_RECEIVER *       Receiver,
+    __in USHORT                         Port
+    );
+
+VOID
+LJB_VMON_NetReceiverDeInit(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_NetReceiverAccept(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver
+    );
+
+VOID
+LJB_VMON_NetReceiverPoll(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver,
+    __in ULONG                          Timeout,
+    __out LJB_VMON_NET_EVENT *          Event
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_NetReceiverApply(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver,
+    __in CONST VOID *                   Message,
+    __in SIZE_T                         Size,
+    __out LJB_VMON_NET_EVENT *          Event
+    );
+
+#endif /* _LJB_VMON_NET_H_ */
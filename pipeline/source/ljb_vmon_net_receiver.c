@@ -0,0 +1,781 @@
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "ljb_vmon_net.h"
+
+/*
+ * largest mode a sender may announce
+ */
+#define NET_MAX_DIMENSION       16384
+
+#define NET_RECEIVE_BUFFER_SIZE (4 * 1024 * 1024)
+
+#define NET_MAX_DATAGRAM                    \
+    (sizeof(LJB_VMON_NET_DATAGRAM) +        \
+     sizeof(LJB_VMON_NET_CURSOR_SHAPE) +    \
+     LJB_VMON_NET_FRAGMENT_SIZE)
+
+/*
+ * Receive exactly Size bytes from the frame channel, or from the message
+ * LJB_VMON_NetReceiverApply is given.
+ */
+static BOOLEAN
+LJB_VMON_NetReceiveAll(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver,
+    __out VOID *                        Buffer,
+    __in SIZE_T                         Size
+    )
+{
+    UCHAR * pBuffer = Buffer;
+    int     Received;
+
+    if (Receiver->Source != NULL)
+    {
+        if (Size > Receiver->SourceSize)
+            return FALSE;
+        RtlCopyMemory(Buffer, Receiver->Source, Size);
+        Receiver->Source += Size;
+        Receiver->SourceSize -= Size;
+        return TRUE;
+    }
+
+    while (Size != 0)
+    {
+        Received = recv(
+            (SOCKET) Receiver->FrameSocket,
+            (CHAR *) pBuffer,
+            (int) ((Size < 0x40000000) ? Size : 0x40000000),
+            0
+            );
+        if (Received <= 0)
+            return FALSE;
+        pBuffer += Received;
+        Size -= Received;
+    }
+    return TRUE;
+}
+
+static VOID
+LJB_VMON_NetReceiverClose(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver
+    )
+{
+    if (!Receiver->Connected)
+        return;
+    closesocket((SOCKET) Receiver->FrameSocket);
+    Receiver->Connected = FALSE;
+}
+
+static BOOLEAN
+LJB_VMON_NetReceiveModeChange(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver,
+    __in ULONG                          Size
+    )
+{
+    LJB_VMON_NET_MODE_CHANGE    Body;
+    SIZE_T                      PixelsSize;
+
+    if (Size != sizeof(Body) ||
+        !LJB_VMON_NetReceiveAll(Receiver, &Body, sizeof(Body)) ||
+        Body.Width > NET_MAX_DIMENSION ||
+        Body.Height > NET_MAX_DIMENSION)
+        return FALSE;
+
+    PixelsSize = (SIZE_T) Body.Width * Body.Height * 4;
+    if (PixelsSize > Receiver->MaxPixels)
+    {
+        if (Receiver->Pixels != NULL)
+            HeapFree(GetProcessHeap(), 0, Receiver->Pixels);
+        Receiver->MaxPixels = 0;
+        Receiver->Pixels = HeapAlloc(GetProcessHeap(), 0, PixelsSize);
+        if (Receiver->Pixels == NULL)
+            return FALSE;
+        Receiver->MaxPixels = PixelsSize;
+    }
+    if (PixelsSize != 0)
+        RtlZeroMemory(Receiver->Pixels, PixelsSize);
+
+    Receiver->Width = Body.Width;
+    Receiver->Height = Body.Height;
+    Receiver->Rotation = Body.Rotation;
+    Receiver->HasFrame = FALSE;
+    return TRUE;
+}
+
+/*
+ * Copy->Right - Copy->Left by Copy->Bottom - Copy->Top pixels from
+ * (SrcLeft, SrcTop) to (Left, Top), rows in the order that keeps an
+ * overlapping source intact.
+ */
+static VOID
+LJB_VMON_NetApplyCopy(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver,
+    __in CONST LJB_VMON_NET_COPY *      Copy
+    )
+{
+    SIZE_T CONST    Pitch = (SIZE_T) Receiver->Width * 4;
+    LONG CONST      Rows = Copy->Bottom - Copy->Top;
+    LONG            i, row;
+
+    for (i = 0; i < Rows; i++)
+    {
+        row = (Copy->Top > Copy->SrcTop) ? Rows - 1 - i : i;
+        memmove(
+            Receiver->Pixels + (Copy->Top + row) * Pitch + Copy->Left * 4,
+            Receiver->Pixels + (Copy->SrcTop + row) * Pitch + Copy->SrcLeft * 4,
+            (Copy->Right - Copy->Left) * 4
+            );
+    }
+}
+
+static BOOLEAN
+LJB_VMON_NetReceiveFrame(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver,
+    __in ULONG                          Size,
+    __out LJB_VMON_NET_EVENT *          Event
+    )
+{
+    LJB_VMON_NET_FRAME      Body;
+    LJB_VMON_NET_COPY       Copies[LJB_VMON_MAX_COPY_RECTS];
+    LJB_VMON_NET_RECT       NetRects[LJB_VMON_MAX_DAMAGE_RECTS];
+    LJB_VMON_RECT           Rects[LJB_VMON_MAX_DAMAGE_RECTS];
+    ULONG64                 HeadSize;
+    ULONG64                 PixelsSize;
+    ULONG64                 MaxTileSize;
+    SIZE_T                  Pitch;
+    UINT                    i;
+    LONG                    row;
+
+    if (Size < sizeof(Body) ||
+        !LJB_VMON_NetReceiveAll(Receiver, &Body, sizeof(Body)))
+        return FALSE;
+    if (Body.Width != Receiver->Width ||
+        Body.Height != Receiver->Height ||
+        Body.Width == 0 ||
+        Body.Height == 0 ||
+        Body.NumCopies > LJB_VMON_MAX_COPY_RECTS ||
+        Body.NumRects > LJB_VMON_MAX_DAMAGE_RECTS ||
+        (Body.Encoding != LJB_VMON_NET_ENCODING_RAW &&
+         Body.Encoding != LJB_VMON_NET_ENCODING_TILE))
+        return FALSE;
+
+    HeadSize = sizeof(Body) +
+               Body.NumCopies * sizeof(Copies[0]) +
+               Body.NumRects * sizeof(NetRects[0]);
+    if (Size < HeadSize ||
+        !LJB_VMON_NetReceiveAll(Receiver, Copies, Body.NumCopies * sizeof(Copies[0])) ||
+        !LJB_VMON_NetReceiveAll(Receiver, NetRects, Body.NumRects * sizeof(NetRects[0])))
+        return FALSE;
+
+    for (i = 0; i < Body.NumCopies; i++)
+    {
+        if (Copies[i].Left >= Copies[i].Right ||
+            Copies[i].Top >= Copies[i].Bottom ||
+            Copies[i].Right > Body.Width ||
+            Copies[i].Bottom > Body.Height ||
+            Copies[i].SrcLeft + (Copies[i].Right - Copies[i].Left) > Body.Width ||
+            Copies[i].SrcTop + (Copies[i].Bottom - Copies[i].Top) > Body.Height)
+            return FALSE;
+    }
+
+    /*
+     * what the pixels of the rectangles may take, exactly for RAW, at most
+     * for TILE.
+     */
+    PixelsSize = 0;
+    MaxTileSize = 0;
+    for (i = 0; i < Body.NumRects; i++)
+    {
+        if (NetRects[i].Left >= NetRects[i].Right ||
+            NetRects[i].Top >= NetRects[i].Bottom ||
+            NetRects[i].Right > Body.Width ||
+            NetRects[i].Bottom > Body.Height)
+            return FALSE;
+        Rects[i].Left = NetRects[i].Left;
+        Rects[i].Top = NetRects[i].Top;
+        Rects[i].Right = NetRects[i].Right;
+        Rects[i].Bottom = NetRects[i].Bottom;
+        PixelsSize += (ULONG64) (Rects[i].Right - Rects[i].Left) *
+                      (Rects[i].Bottom - Rects[i].Top) * 4;
+        MaxTileSize += LJB_VMON_TILE_MAX_BYTES(LJB_VMON_TILE_SIZE, LJB_VMON_TILE_SIZE) *
+                       ((Rects[i].Right - Rects[i].Left + LJB_VMON_TILE_SIZE - 1) / LJB_VMON_TILE_SIZE) *
+                       ((Rects[i].Bottom - Rects[i].Top + LJB_VMON_TILE_SIZE - 1) / LJB_VMON_TILE_SIZE);
+    }
+
+    for (i = 0; i < Body.NumCopies; i++)
+        LJB_VMON_NetApplyCopy(Receiver, &Copies[i]);
+
+    Pitch = (SIZE_T) Receiver->Width * 4;
+    if (Body.Encoding == LJB_VMON_NET_ENCODING_RAW)
+    {
+        if (Size - HeadSize != PixelsSize)
+            return FALSE;
+
+        /*
+         * rows land where they belong, no staging.
+         */
+        for (i = 0; i < Body.NumRects; i++)
+        {
+            for (row = Rects[i].Top; row < Rects[i].Bottom; row++)
+            {
+                if (!LJB_VMON_NetReceiveAll(
+                        Receiver,
+                        Receiver->Pixels + row * Pitch + Rects[i].Left * 4,
+                        (Rects[i].Right - Rects[i].Left) * 4))
+                    return FALSE;
+            }
+        }
+    }
+    else
+    {
+        if (Size - HeadSize > MaxTileSize)
+            return FALSE;
+        if (Size - HeadSize > Receiver->MaxMessage)
+        {
+            if (Receiver->Message != NULL)
+                HeapFree(GetProcessHeap(), 0, Receiver->Message);
+            Receiver->MaxMessage = 0;
+            Receiver->Message = HeapAlloc(GetProcessHeap(), 0, (SIZE_T) MaxTileSize);
+            if (Receiver->Message == NULL)
+                return FALSE;
+            Receiver->MaxMessage = (SIZE_T) MaxTileSize;
+        }
+        if (!LJB_VMON_NetReceiveAll(Receiver, Receiver->Message, (SIZE_T) (Size - HeadSize)) ||
+            !LJB_VMON_TileDecode(
+                Receiver->Message,
+                (SIZE_T) (Size - HeadSize),
+                Rects,
+                Body.NumRects,
+                Receiver->Pixels,
+                Receiver->Width,
+                Receiver->Height,
+                (UINT) Pitch,
+                NULL))
+            return FALSE;
+    }
+
+    Receiver->HasFrame = TRUE;
+    Receiver->FrameId = Body.FrameId;
+    Receiver->Stats.Frames++;
+    Receiver->Stats.FrameBytes += sizeof(LJB_VMON_NET_HEADER) + Size;
+    Event->Type = LJB_VMON_NET_EVENT_FRAME;
+    Event->FrameId = Body.FrameId;
+    Event->Latency = LJB_VMON_NetMicroseconds() - Body.SendTime;
+    return TRUE;
+}
+
+/*
+ * Read a mode change or a frame and apply it.
+ */
+static BOOLEAN
+LJB_VMON_NetReceiveMessage(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver,
+    __out LJB_VMON_NET_EVENT *          Event
+    )
+{
+    LJB_VMON_NET_HEADER Header;
+
+    if (!LJB_VMON_NetReceiveAll(Receiver, &Header, sizeof(Header)))
+        return FALSE;
+    switch (Header.Type)
+    {
+    case LJB_VMON_NET_TYPE_MODE_CHANGE:
+        Event->Type = LJB_VMON_NET_EVENT_MODE_CHANGE;
+        return LJB_VMON_NetReceiveModeChange(Receiver, Header.Size);
+
+    case LJB_VMON_NET_TYPE_FRAME:
+        return LJB_VMON_NetReceiveFrame(Receiver, Header.Size, Event);
+
+    default:
+        return FALSE;
+    }
+}
+
+static VOID
+LJB_VMON_NetReceiveDatagram(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver,
+    __out LJB_VMON_NET_EVENT *          Event
+    )
+{
+    UCHAR                           Datagram[NET_MAX_DATAGRAM + 1];
+    LJB_VMON_NET_DATAGRAM           Header;
+    LJB_VMON_NET_CURSOR_POSITION    Position;
+    LJB_VMON_NET_CURSOR_SHAPE       Shape;
+    POINTER_SHAPE_DATA *            Assembly;
+    ULONG                           Fragment;
+    ULONG                           FragmentSize;
+    ULONG                           NumFragments;
+    int                             Size;
+
+    Size = recv((SOCKET) Receiver->CursorSocket, (CHAR *) Datagram, sizeof(Datagram), 0);
+    if (Size < 0)
+        return;
+    Receiver->Stats.CursorDatagrams++;
+    if ((ULONG) Size < sizeof(Header))
+    {
+        Receiver->Stats.BadDatagrams++;
+        return;
+    }
+    RtlCopyMemory(&Header, Datagram, sizeof(Header));
+
+    if (Header.Type == LJB_VMON_NET_TYPE_CURSOR_POSITION)
+    {
+        if ((ULONG) Size != sizeof(Header) + sizeof(Position))
+        {
+            Receiver->Stats.BadDatagrams++;
+            return;
+        }
+
+        /*
+         * a position older than the one shown is of no use.
+         */
+        if (Receiver->HasPosition &&
+            (LONG) (Header.Sequence - Receiver->PositionSequence) <= 0)
+        {
+            Receiver->Stats.StaleDatagrams++;
+            return;
+        }
+        RtlCopyMemory(&Position, Datagram + sizeof(Header), sizeof(Position));
+        Receiver->CursorX = Position.X;
+        Receiver->CursorY = Position.Y;
+        Receiver->CursorVisible = (BOOLEAN) (Position.Visible != 0);
+        Receiver->CursorShapeSerial = Header.ShapeSerial;
+        Receiver->HasPosition = TRUE;
+        Receiver->PositionSequence = Header.Sequence;
+        Receiver->Stats.CursorPositions++;
+        Event->Type = LJB_VMON_NET_EVENT_CURSOR_POSITION;
+        Event->Latency = LJB_VMON_NetMicroseconds() - Header.SendTime;
+        return;
+    }
+
+    if (Header.Type != LJB_VMON_NET_TYPE_CURSOR_SHAPE ||
+        (ULONG) Size < sizeof(Header) + sizeof(Shape) ||
+        Header.ShapeSerial == 0)
+    {
+        Receiver->Stats.BadDatagrams++;
+        return;
+    }
+    RtlCopyMemory(&Shape, Datagram + sizeof(Header), sizeof(Shape));
+    FragmentSize = Size - sizeof(Header) - sizeof(Shape);
+
+    /*
+     * a repeat of the shape in use
+     */
+    if (Header.ShapeSerial == Receiver->ShapeSerial)
+        return;
+
+    /*
+     * the first fragment of a shape sets up its assembly; the size it
+     * claims must be the size its own fields give.
+     */
+    Assembly = Receiver->Assembly;
+    if (Header.ShapeSerial != Receiver->AssemblySerial ||
+        Shape.DataSize != Receiver->AssemblySize)
+    {
+        if (Shape.DataSize > sizeof(Assembly->Buffer))
+        {
+            Receiver->Stats.BadDatagrams++;
+            return;
+        }
+        Assembly->Flags.Value = Shape.Flags;
+        Assembly->Width = Shape.Width;
+        Assembly->Height = Shape.Height;
+        Assembly->Pitch = Shape.Pitch;
+        if (LJB_VMON_CursorShapeSize(Assembly) != Shape.DataSize)
+        {
+            Receiver->AssemblySerial = 0;
+            Receiver->Stats.BadDatagrams++;
+            return;
+        }
+        NumFragments = (Shape.DataSize + LJB_VMON_NET_FRAGMENT_SIZE - 1) / LJB_VMON_NET_FRAGMENT_SIZE;
+        Receiver->AssemblySerial = Header.ShapeSerial;
+        Receiver->AssemblySize = Shape.DataSize;
+        Receiver->AssemblyMissing = (NumFragments != 0) ? NumFragments : 1;
+        RtlZeroMemory(Receiver->AssemblyReceived, sizeof(Receiver->AssemblyReceived));
+    }
+
+    if (Shape.Flags != Assembly->Flags.Value ||
+        Shape.Width != Assembly->Width ||
+        Shape.Height != Assembly->Height ||
+        Shape.Pitch != Assembly->Pitch ||
+        Shape.Offset % LJB_VMON_NET_FRAGMENT_SIZE != 0 ||
+        (Shape.Offset >= Shape.DataSize && Shape.Offset != 0) ||
+        FragmentSize != ((Shape.DataSize - Shape.Offset < LJB_VMON_NET_FRAGMENT_SIZE) ?
+                         Shape.DataSize - Shape.Offset : LJB_VMON_NET_FRAGMENT_SIZE))
+    {
+        Receiver->Stats.BadDatagrams++;
+        return;
+    }
+
+    Fragment = Shape.Offset / LJB_VMON_NET_FRAGMENT_SIZE;
+    if (Receiver->AssemblyReceived[Fragment / 8] & (1 << (Fragment % 8)))
+        return;
+    Receiver->AssemblyReceived[Fragment / 8] |= (UCHAR) (1 << (Fragment % 8));
+    RtlCopyMemory(
+        Assembly->Buffer + Shape.Offset,
+        Datagram + sizeof(Header) + sizeof(Shape),
+        FragmentSize
+        );
+    if (--Receiver->AssemblyMissing != 0)
+        return;
+
+    Receiver->Assembly = Receiver->Shape;
+    Receiver->Shape = Assembly;
+    Receiver->ShapeSerial = Header.ShapeSerial;
+    Receiver->AssemblySerial = 0;
+    Receiver->AssemblySize = 0;
+    Receiver->Stats.CursorShapes++;
+    Event->Type = LJB_VMON_NET_EVENT_CURSOR_SHAPE;
+    Event->Latency = LJB_VMON_NetMicroseconds() - Header.SendTime;
+}
+
+/*
+ * Name:  LJB_VMON_NetReceiverInit
+ *
+ * Definition:
+ *    __checkReturn
+ *    BOOLEAN
+ *    LJB_VMON_NetReceiverInit(
+ *        __out LJB_VMON_NET_RECEIVER * Receiver,
+ *        __in USHORT                   Port
+ *        );
+ *
+ * Description:
+ *    Listen for a sender on Port of every local address, TCP for its frame
+ *    channel and UDP for its cursor channel. Port 0 picks a free port,
+ *    Receiver->Port tells which.
+ *
+ * Return Value:
+ *    TRUE if listening. FALSE otherwise; the caller still calls
+ *    LJB_VMON_NetReceiverDeInit.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_NetReceiverInit(
+    __out LJB_VMON_NET_RECEIVER *       Receiver,
+    __in USHORT                         Port
+    )
+{
+    WSADATA             WsaData;
+    struct sockaddr_in  Address;
+    SOCKET              ListenSocket;
+    SOCKET              CursorSocket;
+    int                 AddressSize;
+    int                 Option;
+
+    RtlZeroMemory(Receiver, sizeof(*Receiver));
+
+    Receiver->Shape = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(POINTER_SHAPE_DATA));
+    Receiver->Assembly = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(POINTER_SHAPE_DATA));
+    if (Receiver->Shape == NULL || Receiver->Assembly == NULL)
+        return FALSE;
+
+    if (WSAStartup(MAKEWORD(2, 2), &WsaData) != 0)
+        return FALSE;
+    Receiver->WsaStarted = TRUE;
+
+    ListenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (ListenSocket == INVALID_SOCKET)
+        return FALSE;
+    Option = 1;
+    setsockopt(ListenSocket, SOL_SOCKET, SO_REUSEADDR, (CONST CHAR *) &Option, sizeof(Option));
+
+    RtlZeroMemory(&Address, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_ANY);
+    Address.sin_port = htons(Port);
+    AddressSize = sizeof(Address);
+    if (bind(ListenSocket, (struct sockaddr *) &Address, sizeof(Address)) == SOCKET_ERROR ||
+        listen(ListenSocket, 1) == SOCKET_ERROR ||
+        getsockname(ListenSocket, (struct sockaddr *) &Address, &AddressSize) == SOCKET_ERROR)
+    {
+        closesocket(ListenSocket);
+        return FALSE;
+    }
+
+    /*
+     * the cursor channel on the port the frame channel got
+     */
+    CursorSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (CursorSocket == INVALID_SOCKET ||
+        bind(CursorSocket, (struct sockaddr *) &Address, sizeof(Address)) == SOCKET_ERROR)
+    {
+        if (CursorSocket != INVALID_SOCKET)
+            closesocket(CursorSocket);
+        closesocket(ListenSocket);
+        return FALSE;
+    }
+    Option = NET_RECEIVE_BUFFER_SIZE;
+    setsockopt(CursorSocket, SOL_SOCKET, SO_RCVBUF, (CONST CHAR *) &Option, sizeof(Option));
+
+    Receiver->ListenSocket = (ULONG_PTR) ListenSocket;
+    Receiver->CursorSocket = (ULONG_PTR) CursorSocket;
+    Receiver->Listening = TRUE;
+    Receiver->Port = ntohs(Address.sin_port);
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_NetReceiverDeInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_NetReceiverDeInit(
+ *        __inout LJB_VMON_NET_RECEIVER *   Receiver
+ *        );
+ *
+ * Description:
+ *    Close the sockets and free the frame and cursor.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_NetReceiverDeInit(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver
+    )
+{
+    LJB_VMON_NetReceiverClose(Receiver);
+    if (Receiver->Listening)
+    {
+        closesocket((SOCKET) Receiver->ListenSocket);
+        closesocket((SOCKET) Receiver->CursorSocket);
+    }
+    if (Receiver->WsaStarted)
+        WSACleanup();
+    if (Receiver->Pixels != NULL)
+        HeapFree(GetProcessHeap(), 0, Receiver->Pixels);
+    if (Receiver->Message != NULL)
+        HeapFree(GetProcessHeap(), 0, Receiver->Message);
+    if (Receiver->Shape != NULL)
+        HeapFree(GetProcessHeap(), 0, Receiver->Shape);
+    if (Receiver->Assembly != NULL)
+        HeapFree(GetProcessHeap(), 0, Receiver->Assembly);
+    RtlZeroMemory(Receiver, sizeof(*Receiver));
+}
+
+/*
+ * Name:  LJB_VMON_NetReceiverAccept
+ *
+ * Definition:
+ *    __checkReturn
+ *    BOOLEAN
+ *    LJB_VMON_NetReceiverAccept(
+ *        __inout LJB_VMON_NET_RECEIVER *   Receiver
+ *        );
+ *
+ * Description:
+ *    Wait for a sender and check its HELLO. The cursor is forgotten. A
+ *    sender back to the session it had finds the frame as it was and goes
+ *    on from there, Receiver->Resumed tells; for any other the frame is
+ *    cleared and the sender starts with a mode change.
+ *
+ * Return Value:
+ *    TRUE if a sender is connected, FALSE if the one that came was not one.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_NetReceiverAccept(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver
+    )
+{
+    struct
+    {
+        LJB_VMON_NET_HEADER     Header;
+        LJB_VMON_NET_RESUME     Body;
+    }                   Resume;
+    LJB_VMON_NET_HEADER Header;
+    LJB_VMON_NET_HELLO  Hello;
+    SOCKET              FrameSocket;
+    WSABUF              Buffer;
+    DWORD               Sent;
+    int                 Option;
+
+    LJB_VMON_NetReceiverClose(Receiver);
+    if (!Receiver->Listening)
+        return FALSE;
+
+    FrameSocket = accept((SOCKET) Receiver->ListenSocket, NULL, NULL);
+    if (FrameSocket == INVALID_SOCKET)
+        return FALSE;
+    Option = NET_RECEIVE_BUFFER_SIZE;
+    setsockopt(FrameSocket, SOL_SOCKET, SO_RCVBUF, (CONST CHAR *) &Option, sizeof(Option));
+    Receiver->FrameSocket = (ULONG_PTR) FrameSocket;
+    Receiver->Connected = TRUE;
+
+    Receiver->ShapeSerial = 0;
+    Receiver->AssemblySerial = 0;
+    Receiver->AssemblySize = 0;
+    Receiver->CursorShapeSerial = 0;
+    Receiver->HasPosition = FALSE;
+
+    RtlZeroMemory(&Hello, sizeof(Hello));
+    if (!LJB_VMON_NetReceiveAll(Receiver, &Header, sizeof(Header)) ||
+        Header.Type != LJB_VMON_NET_TYPE_HELLO ||
+        (Header.Size != sizeof(Hello) &&
+         Header.Size != FIELD_OFFSET(LJB_VMON_NET_HELLO, SessionId)) ||
+        !LJB_VMON_NetReceiveAll(Receiver, &Hello, Header.Size) ||
+        memcmp(Hello.Signature, LJB_VMON_NET_SIGNATURE, sizeof(Hello.Signature)) != 0 ||
+        Hello.Version != ((Header.Size == sizeof(Hello)) ? LJB_VMON_NET_VERSION : 1))
+    {
+        LJB_VMON_NetReceiverClose(Receiver);
+        return FALSE;
+    }
+
+    Receiver->Resumed =
+        Hello.SessionId != 0 &&
+        Hello.SessionId == Receiver->SessionId &&
+        Receiver->HasFrame;
+    Receiver->SessionId = Hello.SessionId;
+    if (Receiver->Resumed)
+        Receiver->Stats.Resumes++;
+    else
+    {
+        Receiver->Width = 0;
+        Receiver->Height = 0;
+        Receiver->Rotation = 0;
+        Receiver->HasFrame = FALSE;
+    }
+    if (Hello.Version == 1)
+        return TRUE;
+
+    RtlZeroMemory(&Resume, sizeof(Resume));
+    Resume.Header.Type = LJB_VMON_NET_TYPE_RESUME;
+    Resume.Header.Size = sizeof(Resume.Body);
+    Resume.Body.SessionId = Hello.SessionId;
+    if (Receiver->Resumed)
+    {
+        Resume.Body.FrameId = Receiver->FrameId;
+        Resume.Body.Width = (USHORT) Receiver->Width;
+        Resume.Body.Height = (USHORT) Receiver->Height;
+    }
+    Buffer.buf = (CHAR *) &Resume;
+    Buffer.len = sizeof(Resume);
+    if (WSASend(FrameSocket, &Buffer, 1, &Sent, 0, NULL, NULL) == SOCKET_ERROR ||
+        Sent != sizeof(Resume))
+    {
+        LJB_VMON_NetReceiverClose(Receiver);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_NetReceiverPoll
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_NetReceiverPoll(
+ *        __inout LJB_VMON_NET_RECEIVER *   Receiver,
+ *        __in ULONG                        Timeout,
+ *        __out LJB_VMON_NET_EVENT *        Event
+ *        );
+ *
+ * Description:
+ *    Wait up to Timeout milliseconds for a message or a datagram and apply
+ *    it. Datagrams go first. A datagram that changes nothing, a repeated or
+ *    stale one, reports LJB_VMON_NET_EVENT_NONE. On LJB_VMON_NET_EVENT_CLOSED
+ *    the frame channel is closed; call LJB_VMON_NetReceiverAccept for the
+ *    next sender.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_NetReceiverPoll(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver,
+    __in ULONG                          Timeout,
+    __out LJB_VMON_NET_EVENT *          Event
+    )
+{
+    fd_set              ReadSet;
+    struct timeval      Wait;
+    ULONG_PTR           Nfds;
+
+    RtlZeroMemory(Event, sizeof(*Event));
+    if (!Receiver->Listening)
+    {
+        Event->Type = LJB_VMON_NET_EVENT_CLOSED;
+        return;
+    }
+
+    FD_ZERO(&ReadSet);
+    FD_SET((SOCKET) Receiver->CursorSocket, &ReadSet);
+    Nfds = Receiver->CursorSocket;
+    if (Receiver->Connected)
+    {
+        FD_SET((SOCKET) Receiver->FrameSocket, &ReadSet);
+        if (Receiver->FrameSocket > Nfds)
+            Nfds = Receiver->FrameSocket;
+    }
+    Wait.tv_sec = Timeout / 1000;
+    Wait.tv_usec = (Timeout % 1000) * 1000;
+
+    /*
+     * the first argument is ignored by Winsock
+     */
+    if (select((int) Nfds + 1, &ReadSet, NULL, NULL, &Wait) <= 0)
+        return;
+
+    if (FD_ISSET((SOCKET) Receiver->CursorSocket, &ReadSet))
+    {
+        LJB_VMON_NetReceiveDatagram(Receiver, Event);
+        return;
+    }
+    if (!Receiver->Connected || !FD_ISSET((SOCKET) Receiver->FrameSocket, &ReadSet))
+        return;
+
+    if (!LJB_VMON_NetReceiveMessage(Receiver, Event))
+    {
+        LJB_VMON_NetReceiverClose(Receiver);
+        Event->Type = LJB_VMON_NET_EVENT_CLOSED;
+    }
+}
+
+/*
+ * Name:  LJB_VMON_NetReceiverApply
+ *
+ * Definition:
+ *    __checkReturn
+ *    BOOLEAN
+ *    LJB_VMON_NetReceiverApply(
+ *        __inout LJB_VMON_NET_RECEIVER *   Receiver,
+ *        __in CONST VOID *                 Message,
+ *        __in SIZE_T                       Size,
+ *        __out LJB_VMON_NET_EVENT *        Event
+ *        );
+ *
+ * Description:
+ *    Apply one whole frame channel message, header included, that came by
+ *    some other way than the frame channel. Receiver needs no sockets; a
+ *    zeroed one will do, and LJB_VMON_NetReceiverDeInit frees its frame.
+ *
+ * Return Value:
+ *    TRUE if the message was a mode change or a frame of exactly Size bytes
+ *    and was applied. FALSE otherwise; the frame may be left half painted.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_NetReceiverApply(
+    __inout LJB_VMON_NET_RECEIVER *     Receiver,
+    __in CONST VOID *                   Message,
+    __in SIZE_T                         Size,
+    __out LJB_VMON_NET_EVENT *          Event
+    )
+{
+    BOOLEAN Success;
+
+    RtlZeroMemory(Event, sizeof(*Event));
+    Receiver->Source = Message;
+    Receiver->SourceSize = Size;
+    Success = LJB_VMON_NetReceiveMessage(Receiver, Event);
+    if (Receiver->SourceSize != 0)
+        Success = FALSE;
+    Receiver->Source = NULL;
+    Receiver->SourceSize = 0;
+    return Success;
+}
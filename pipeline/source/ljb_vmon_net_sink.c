@@ -0,0 +1,994 @@
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "ljb_vmon_net.h"
+
+/*
+ * DSCP expedited forwarding, for the cursor channel
+ */
+#define NET_TOS_LOW_DELAY       0xB8
+
+#define NET_SEND_BUFFER_SIZE    (4 * 1024 * 1024)
+
+/*
+ * Send Buffers as one stream, LJB_VMON_NET_MAX_BUFFERS per call, picking up
+ * after partial sends. Buffers is consumed.
+ */
+static BOOLEAN
+LJB_VMON_NetSinkSend(
+    __inout LJB_VMON_NET_SINK *         NetSink,
+    __inout WSABUF *                    Buffers,
+    __in UINT                           NumBuffers
+    )
+{
+    DWORD   Sent;
+    UINT    Count;
+
+    while (NumBuffers != 0)
+    {
+        Count = (NumBuffers < LJB_VMON_NET_MAX_BUFFERS) ? NumBuffers : LJB_VMON_NET_MAX_BUFFERS;
+        if (WSASend(
+                (SOCKET) NetSink->FrameSocket,
+                Buffers,
+                Count,
+                &Sent,
+                0,
+                NULL,
+                NULL) == SOCKET_ERROR)
+            return FALSE;
+        NetSink->Stats.Sends++;
+        NetSink->Stats.Buffers += Count;
+
+        while (NumBuffers != 0 && Sent >= Buffers->len)
+        {
+            Sent -= Buffers->len;
+            Buffers++;
+            NumBuffers--;
+        }
+        if (NumBuffers != 0)
+        {
+            Buffers->buf += Sent;
+            Buffers->len -= Sent;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * The frame channel failed: stop using it, and have the reconnect thread
+ * bring it back.
+ */
+static VOID
+LJB_VMON_NetSinkDisconnect(
+    __inout LJB_VMON_NET_SINK *         NetSink
+    )
+{
+    if (InterlockedCompareExchange(&NetSink->Connected, 0, 0) == LJB_VMON_NET_SINK_DOWN)
+        return;
+    closesocket((SOCKET) NetSink->FrameSocket);
+    closesocket((SOCKET) NetSink->CursorSocket);
+    InterlockedExchange(&NetSink->Connected, LJB_VMON_NET_SINK_DOWN);
+    if (NetSink->hReconnectEvent != NULL)
+        SetEvent(NetSink->hReconnectEvent);
+}
+
+/*
+ * The frame channel failed while Frame went out as Sent, or whole if
+ * NULL: keep what the receiver may have painted in part, for when the
+ * sink is back.
+ */
+static VOID
+LJB_VMON_NetSinkFailed(
+    __inout LJB_VMON_NET_SINK *         NetSink,
+    __in CONST LJB_VMON_SINK_FRAME *    Frame,
+    __in_opt CONST LJB_VMON_DAMAGE *    Sent
+    )
+{
+    LJB_VMON_DAMAGE FullDamage;
+
+    if (!NetSink->HasPending)
+        LJB_VMON_DamageReset(&NetSink->Pending);
+    if (Sent == NULL || Frame->Damage == NULL)
+    {
+        LJB_VMON_DamageSetFull(&FullDamage, Frame->Width, Frame->Height);
+        LJB_VMON_DamageAddDamage(&NetSink->Pending, &FullDamage);
+    }
+    else
+    {
+        LJB_VMON_DamageAddDamage(&NetSink->Pending, Frame->Damage);
+        LJB_VMON_DamageAddDamage(&NetSink->Pending, Sent);
+    }
+    NetSink->HasPending = TRUE;
+    NetSink->FailedFrameId = Frame->FrameId;
+    NetSink->Stats.DroppedFrames++;
+    LJB_VMON_NetSinkDisconnect(NetSink);
+}
+
+static VOID
+LJB_VMON_NetSinkSendDatagram(
+    __inout LJB_VMON_NET_SINK *         NetSink,
+    __in UCHAR                          Type,
+    __in CONST VOID *                   Body,
+    __in ULONG                          BodySize,
+    __in_opt CONST VOID *               Data,
+    __in ULONG                          DataSize
+    )
+{
+    UCHAR                   Datagram[
+        sizeof(LJB_VMON_NET_DATAGRAM) +
+        sizeof(LJB_VMON_NET_CURSOR_SHAPE) +
+        LJB_VMON_NET_FRAGMENT_SIZE];
+    LJB_VMON_NET_DATAGRAM   Header;
+
+    RtlZeroMemory(&Header, sizeof(Header));
+    Header.Type = Type;
+    Header.ShapeSerial = NetSink->ShapeSerial;
+    Header.Sequence = ++NetSink->CursorSequence;
+    Header.SendTime = LJB_VMON_NetMicroseconds();
+
+    RtlCopyMemory(Datagram, &Header, sizeof(Header));
+    RtlCopyMemory(Datagram + sizeof(Header), Body, BodySize);
+    if (Data != NULL)
+        RtlCopyMemory(Datagram + sizeof(Header) + BodySize, Data, DataSize);
+
+    /*
+     * a lost datagram is not an error, the next position replaces it.
+     */
+    if (send(
+            (SOCKET) NetSink->CursorSocket,
+            (CONST CHAR *) Datagram,
+            (int) (sizeof(Header) + BodySize + DataSize),
+            0) != SOCKET_ERROR)
+    {
+        NetSink->Stats.CursorDatagrams++;
+        NetSink->Stats.CursorBytes += sizeof(Header) + BodySize + DataSize;
+    }
+}
+
+static VOID
+LJB_VMON_NetSinkSendShape(
+    __inout LJB_VMON_NET_SINK *         NetSink
+    )
+{
+    CONST POINTER_SHAPE_DATA * CONST    pShape = NetSink->LastShape;
+    LJB_VMON_NET_CURSOR_SHAPE           Body;
+    ULONG                               Size;
+
+    RtlZeroMemory(&Body, sizeof(Body));
+    Body.Flags = pShape->Flags.Value;
+    Body.Width = (USHORT) pShape->Width;
+    Body.Height = (USHORT) pShape->Height;
+    Body.Pitch = pShape->Pitch;
+    Body.DataSize = (ULONG) LJB_VMON_CursorShapeSize(pShape);
+
+    do
+    {
+        Size = Body.DataSize - Body.Offset;
+        if (Size > LJB_VMON_NET_FRAGMENT_SIZE)
+            Size = LJB_VMON_NET_FRAGMENT_SIZE;
+        LJB_VMON_NetSinkSendDatagram(
+            NetSink,
+            LJB_VMON_NET_TYPE_CURSOR_SHAPE,
+            &Body,
+            sizeof(Body),
+            pShape->Buffer + Body.Offset,
+            Size
+            );
+        Body.Offset += Size;
+    } while (Body.Offset < Body.DataSize);
+    NetSink->PositionsSinceShape = 0;
+}
+
+/*
+ * Whether the channels are up, for the VMON thread. Back after a failure,
+ * the receiver gets what changed since the frame it kept, if that is the
+ * last one sent or the one the failure cut off, whose rectangles go again;
+ * otherwise the whole frame. It forgot the cursor.
+ */
+static BOOLEAN
+LJB_VMON_NetSinkIsUp(
+    __inout LJB_VMON_NET_SINK *         NetSink
+    )
+{
+    switch (InterlockedCompareExchange(&NetSink->Connected, 0, 0))
+    {
+    case LJB_VMON_NET_SINK_UP:
+        return TRUE;
+
+    case LJB_VMON_NET_SINK_BACK:
+        break;
+
+    default:
+        return FALSE;
+    }
+
+    NetSink->Stats.Reconnects++;
+    if (NetSink->Resume.Width != 0 &&
+        NetSink->Resume.Width == NetSink->Width &&
+        NetSink->Resume.Height == NetSink->Height &&
+        (NetSink->Resume.FrameId == NetSink->FrameId ||
+         (NetSink->HasPending && NetSink->Resume.FrameId == NetSink->FailedFrameId)))
+        NetSink->Stats.Resumes++;
+    else
+    {
+        NetSink->Width = 0;
+        NetSink->Height = 0;
+        NetSink->HasPending = FALSE;
+    }
+    InterlockedExchange(&NetSink->Connected, LJB_VMON_NET_SINK_UP);
+    if (NetSink->ShapeSerial != 0)
+        LJB_VMON_NetSinkSendShape(NetSink);
+    return TRUE;
+}
+
+static BOOLEAN
+LJB_VMON_NetSinkSendModeChange(
+    __inout LJB_VMON_NET_SINK *         NetSink,
+    __in UINT                           Width,
+    __in UINT                           Height,
+    __in ULONG                          Rotation
+    )
+{
+    struct
+    {
+        LJB_VMON_NET_HEADER         Header;
+        LJB_VMON_NET_MODE_CHANGE    Body;
+    }       Message;
+    WSABUF  Buffer;
+
+    RtlZeroMemory(&Message, sizeof(Message));
+    Message.Header.Type = LJB_VMON_NET_TYPE_MODE_CHANGE;
+    Message.Header.Size = sizeof(Message.Body);
+    Message.Body.Width = (USHORT) Width;
+    Message.Body.Height = (USHORT) Height;
+    Message.Body.Rotation = Rotation;
+
+    Buffer.buf = (CHAR *) &Message;
+    Buffer.len = sizeof(Message);
+    if (!LJB_VMON_NetSinkSend(NetSink, &Buffer, 1))
+        return FALSE;
+
+    NetSink->Width = Width;
+    NetSink->Height = Height;
+    NetSink->Rotation = Rotation;
+    return TRUE;
+}
+
+static VOID
+LJB_VMON_NetSinkModeChange(
+    __in PVOID                          SinkContext,
+    __in CONST TARGET_MODE_DATA *       TargetModeData
+    )
+{
+    LJB_VMON_NET_SINK * CONST   NetSink = SinkContext;
+
+    /*
+     * the next frame announces its mode and goes whole, also if the sink
+     * is down now; a disabled source is announced now, it has no frames.
+     */
+    NetSink->Rotation = (ULONG) TargetModeData->Rotation;
+    NetSink->Width = 0;
+    NetSink->Height = 0;
+    if (!LJB_VMON_NetSinkIsUp(NetSink))
+        return;
+    if ((!TargetModeData->Enabled ||
+         TargetModeData->Width == 0 ||
+         TargetModeData->Height == 0) &&
+        !LJB_VMON_NetSinkSendModeChange(NetSink, 0, 0, NetSink->Rotation))
+        LJB_VMON_NetSinkDisconnect(NetSink);
+}
+
+/*
+ * Name:  LJB_VMON_NetFrameHead
+ *
+ * Definition:
+ *    ULONG
+ *    LJB_VMON_NetFrameHead(
+ *        __out UCHAR *                         Head,
+ *        __in CONST LJB_VMON_SINK_FRAME *      Frame,
+ *        __in ULONG                            SendTime,
+ *        __in UCHAR                            Encoding,
+ *        __in CONST LJB_VMON_COPY_RECT *       Copies,
+ *        __in UINT                             NumCopies,
+ *        __in CONST LJB_VMON_DAMAGE *          Damage,
+ *        __in ULONG64                          PixelsSize
+ *        );
+ *
+ * Description:
+ *    Lay out in Head, LJB_VMON_NET_FRAME_HEAD_SIZE bytes, the header, body,
+ *    copies and rectangles of a FRAME message whose pixels, PixelsSize bytes
+ *    in Encoding, follow.
+ *
+ * Return Value:
+ *    The bytes of Head used.
+ *
+ */
+ULONG
+LJB_VMON_NetFrameHead(
+    __out UCHAR *                       Head,
+    __in CONST LJB_VMON_SINK_FRAME *    Frame,
+    __in ULONG                          SendTime,
+    __in UCHAR                          Encoding,
+    __in CONST LJB_VMON_COPY_RECT *     Copies,
+    __in UINT                           NumCopies,
+    __in CONST LJB_VMON_DAMAGE *        Damage,
+    __in ULONG64                        PixelsSize
+    )
+{
+    LJB_VMON_NET_HEADER Header;
+    LJB_VMON_NET_FRAME  Body;
+    LJB_VMON_NET_COPY   Copy;
+    LJB_VMON_NET_RECT   Rect;
+    ULONG               HeadSize;
+    UINT                i;
+
+    HeadSize = sizeof(Header) +
+               sizeof(Body) +
+               NumCopies * sizeof(Copy) +
+               Damage->NumRects * sizeof(Rect);
+
+    RtlZeroMemory(&Header, sizeof(Header));
+    Header.Type = LJB_VMON_NET_TYPE_FRAME;
+    Header.Size = (ULONG) (HeadSize - sizeof(Header) + PixelsSize);
+    RtlCopyMemory(Head, &Header, sizeof(Header));
+
+    RtlZeroMemory(&Body, sizeof(Body));
+    Body.FrameId = Frame->FrameId;
+    Body.SendTime = SendTime;
+    Body.Width = (USHORT) Frame->Width;
+    Body.Height = (USHORT) Frame->Height;
+    Body.Encoding = Encoding;
+    Body.NumCopies = (UCHAR) NumCopies;
+    Body.NumRects = (UCHAR) Damage->NumRects;
+    RtlCopyMemory(Head + sizeof(Header), &Body, sizeof(Body));
+    HeadSize = sizeof(Header) + sizeof(Body);
+
+    for (i = 0; i < NumCopies; i++)
+    {
+        Copy.Left = (USHORT) Copies[i].Dst.Left;
+        Copy.Top = (USHORT) Copies[i].Dst.Top;
+        Copy.Right = (USHORT) Copies[i].Dst.Right;
+        Copy.Bottom = (USHORT) Copies[i].Dst.Bottom;
+        Copy.SrcLeft = (USHORT) Copies[i].SrcLeft;
+        Copy.SrcTop = (USHORT) Copies[i].SrcTop;
+        RtlCopyMemory(Head + HeadSize, &Copy, sizeof(Copy));
+        HeadSize += sizeof(Copy);
+    }
+    for (i = 0; i < Damage->NumRects; i++)
+    {
+        Rect.Left = (USHORT) Damage->Rects[i].Left;
+        Rect.Top = (USHORT) Damage->Rects[i].Top;
+        Rect.Right = (USHORT) Damage->Rects[i].Right;
+        Rect.Bottom = (USHORT) Damage->Rects[i].Bottom;
+        RtlCopyMemory(Head + HeadSize, &Rect, sizeof(Rect));
+        HeadSize += sizeof(Rect);
+    }
+    return HeadSize;
+}
+
+static VOID
+LJB_VMON_NetSinkFrameUpdate(
+    __in PVOID                          SinkContext,
+    __in CONST LJB_VMON_SINK_FRAME *    Frame
+    )
+{
+    LJB_VMON_NET_SINK * CONST   NetSink = SinkContext;
+    UCHAR                       Head[LJB_VMON_NET_FRAME_HEAD_SIZE];
+    WSABUF                      Buffers[LJB_VMON_NET_MAX_BUFFERS];
+    CONST LJB_VMON_DAMAGE *     Damage;
+    LJB_VMON_DAMAGE             FullDamage;
+    LJB_VMON_DAMAGE             Resent;
+    LJB_VMON_DAMAGE             Sent;
+    CONST LJB_VMON_COPY_RECT *  Copies;
+    CONST LJB_VMON_RECT *       pRect;
+    CONST UCHAR *               TileData;
+    SIZE_T                      TileDataSize;
+    CONST UCHAR *               pRow;
+    ULONG                       SendTime;
+    ULONG                       HeadSize;
+    ULONG64                     MessageSize;
+    UINT                        NumCopies;
+    UINT                        NumBuffers;
+    UINT                        i;
+    LONG                        row;
+
+    if (!LJB_VMON_NetSinkIsUp(NetSink))
+    {
+        NetSink->Stats.DroppedFrames++;
+        return;
+    }
+    SendTime = LJB_VMON_NetMicroseconds();
+
+    /*
+     * moves go as copies, only the residual as pixels. What a failure may
+     * have left painted in part goes again, and then no moves, which are
+     * relative to a frame the receiver may not have. A new size goes
+     * whole, after a mode change.
+     */
+    Damage = Frame->Damage;
+    Copies = NULL;
+    NumCopies = 0;
+    if (Damage != NULL && NetSink->HasPending)
+    {
+        Resent = *Damage;
+        LJB_VMON_DamageAddDamage(&Resent, &NetSink->Pending);
+        Damage = &Resent;
+    }
+    else if (Damage != NULL && Frame->Motion != NULL)
+    {
+        Damage = &Frame->Motion->Residual;
+        Copies = Frame->Motion->Copies;
+        NumCopies = Frame->Motion->NumCopies;
+    }
+    if (Frame->Width != NetSink->Width || Frame->Height != NetSink->Height)
+    {
+        if (!LJB_VMON_NetSinkSendModeChange(
+                NetSink,
+                Frame->Width,
+                Frame->Height,
+                NetSink->Rotation))
+        {
+            LJB_VMON_NetSinkFailed(NetSink, Frame, NULL);
+            return;
+        }
+        Damage = NULL;
+    }
+    if (Damage == NULL)
+    {
+        LJB_VMON_DamageSetFull(&FullDamage, Frame->Width, Frame->Height);
+        Damage = &FullDamage;
+        NumCopies = 0;
+    }
+
+    TileData = NULL;
+    if (NetSink->Tiles)
+    {
+        if (NetSink->Quality != 0 &&
+            (NetSink->TileEncoder.Quality == 0 ||
+             NetSink->TileEncoder.Width != Frame->Width ||
+             NetSink->TileEncoder.Height != Frame->Height))
+        {
+            /*
+             * the lossy path keeps its history per mode; out of memory,
+             * go on lossless.
+             */
+            if (!LJB_VMON_TileEncoderSetLossy(
+                    &NetSink->TileEncoder,
+                    Frame->Width,
+                    Frame->Height,
+                    NetSink->Quality))
+                NetSink->Quality = 0;
+        }
+        Sent = *Damage;
+        LJB_VMON_TileEncoderAddRefresh(&NetSink->TileEncoder, &Sent);
+        Damage = &Sent;
+
+        if (!LJB_VMON_TileEncode(
+                &NetSink->TileEncoder,
+                Frame->Buffer,
+                Frame->Pitch,
+                Damage->Rects,
+                Damage->NumRects,
+                &TileData,
+                &TileDataSize))
+        {
+            /*
+             * the receiver is left with the previous frame; resend it whole
+             * once memory allows.
+             */
+            NetSink->Width = 0;
+            NetSink->Height = 0;
+            NetSink->Stats.DroppedFrames++;
+            return;
+        }
+    }
+
+    MessageSize = (TileData != NULL) ? TileDataSize : LJB_VMON_DamageArea(Damage) * 4;
+    HeadSize = LJB_VMON_NetFrameHead(
+        Head,
+        Frame,
+        SendTime,
+        (UCHAR) ((TileData != NULL) ? LJB_VMON_NET_ENCODING_TILE : LJB_VMON_NET_ENCODING_RAW),
+        Copies,
+        NumCopies,
+        Damage,
+        MessageSize
+        );
+    MessageSize += HeadSize;
+
+    /*
+     * gather the head and the pixels where they are; rows that follow each
+     * other in the frame buffer go as one buffer.
+     */
+    Buffers[0].buf = (CHAR *) Head;
+    Buffers[0].len = HeadSize;
+    NumBuffers = 1;
+    if (TileData != NULL)
+    {
+        Buffers[1].buf = (CHAR *) TileData;
+        Buffers[1].len = (ULONG) TileDataSize;
+        NumBuffers = 2;
+    }
+    for (i = 0; TileData == NULL && i < Damage->NumRects; i++)
+    {
+        pRect = &Damage->Rects[i];
+        for (row = pRect->Top; row < pRect->Bottom; row++)
+        {
+            pRow = (CONST UCHAR *) Frame->Buffer + (SIZE_T) row * Frame->Pitch + pRect->Left * 4;
+            if (NumBuffers != 0 &&
+                Buffers[NumBuffers - 1].buf + Buffers[NumBuffers - 1].len == (CONST CHAR *) pRow)
+            {
+                Buffers[NumBuffers - 1].len += (pRect->Right - pRect->Left) * 4;
+                continue;
+            }
+            if (NumBuffers == LJB_VMON_NET_MAX_BUFFERS)
+            {
+                if (!LJB_VMON_NetSinkSend(NetSink, Buffers, NumBuffers))
+                    break;
+                NumBuffers = 0;
+            }
+            Buffers[NumBuffers].buf = (CHAR *) pRow;
+            Buffers[NumBuffers].len = (pRect->Right - pRect->Left) * 4;
+            NumBuffers++;
+        }
+        if (row < pRect->Bottom)
+        {
+            LJB_VMON_NetSinkFailed(NetSink, Frame, Damage);
+            return;
+        }
+    }
+    if (!LJB_VMON_NetSinkSend(NetSink, Buffers, NumBuffers))
+    {
+        LJB_VMON_NetSinkFailed(NetSink, Frame, Damage);
+        return;
+    }
+
+    NetSink->FrameId = Frame->FrameId;
+    NetSink->HasPending = FALSE;
+    NetSink->Stats.Frames++;
+    NetSink->Stats.FrameBytes += MessageSize;
+}
+
+static VOID
+LJB_VMON_NetSinkCursorShape(
+    __in PVOID                          SinkContext,
+    __in CONST POINTER_SHAPE_DATA *     PointerShapeData
+    )
+{
+    LJB_VMON_NET_SINK * CONST   NetSink = SinkContext;
+
+    RtlCopyMemory(
+        NetSink->LastShape,
+        PointerShapeData,
+        FIELD_OFFSET(POINTER_SHAPE_DATA, Buffer) + LJB_VMON_CursorShapeSize(PointerShapeData)
+        );
+    if (++NetSink->ShapeSerial == 0)
+        NetSink->ShapeSerial = 1;
+    if (LJB_VMON_NetSinkIsUp(NetSink))
+        LJB_VMON_NetSinkSendShape(NetSink);
+}
+
+static VOID
+LJB_VMON_NetSinkCursorPosition(
+    __in PVOID                          SinkContext,
+    __in CONST POINTER_POSITION_DATA *  PointerPositionData
+    )
+{
+    LJB_VMON_NET_SINK * CONST       NetSink = SinkContext;
+    LJB_VMON_NET_CURSOR_POSITION    Body;
+
+    if (!LJB_VMON_NetSinkIsUp(NetSink))
+        return;
+
+    /*
+     * every so often the shape again, in case a fragment of it was lost.
+     */
+    if (NetSink->ShapeSerial != 0 &&
+        ++NetSink->PositionsSinceShape >= LJB_VMON_NET_SHAPE_REPEAT)
+        LJB_VMON_NetSinkSendShape(NetSink);
+
+    RtlZeroMemory(&Body, sizeof(Body));
+    Body.X = (SHORT) PointerPositionData->X;
+    Body.Y = (SHORT) PointerPositionData->Y;
+    Body.Visible = PointerPositionData->Visible;
+    LJB_VMON_NetSinkSendDatagram(
+        NetSink,
+        LJB_VMON_NET_TYPE_CURSOR_POSITION,
+        &Body,
+        sizeof(Body),
+        NULL,
+        0
+        );
+}
+
+/*
+ * Nothing to send for a while; the connection stays, the buffers the tile
+ * encoder codes into go until the next frame.
+ */
+static VOID
+LJB_VMON_NetSinkIdle(
+    __in PVOID                          SinkContext
+    )
+{
+    LJB_VMON_NET_SINK * CONST   NetSink = SinkContext;
+
+    if (NetSink->Tiles)
+        LJB_VMON_TileEncoderTrim(&NetSink->TileEncoder);
+}
+
+/*
+ * Credit while the frame channel is up. Down, the sink list keeps what the
+ * sink misses, and hCreditEvent tells when it is back.
+ */
+static BOOLEAN
+LJB_VMON_NetSinkHasCredit(
+    __in PVOID                          SinkContext
+    )
+{
+    LJB_VMON_NET_SINK * CONST   NetSink = SinkContext;
+
+    return InterlockedCompareExchange(&NetSink->Connected, 0, 0) != LJB_VMON_NET_SINK_DOWN;
+}
+
+/*
+ * Connect Socket to Address, waiting LJB_VMON_NET_CONNECT_TIMEOUT at most
+ * for a receiver that is gone. Whatever connect says without blocking,
+ * select and SO_ERROR tell how it went; what they miss, the HELLO does.
+ */
+static BOOLEAN
+LJB_VMON_NetSinkConnectSocket(
+    __in SOCKET                         Socket,
+    __in CONST struct sockaddr *        Address,
+    __in int                            AddressSize
+    )
+{
+    fd_set          WriteSet;
+    fd_set          ErrorSet;
+    struct timeval  Wait;
+    u_long          NonBlocking;
+    int             Error;
+    int             ErrorSize;
+
+    NonBlocking = 1;
+    if (ioctlsocket(Socket, FIONBIO, &NonBlocking) == SOCKET_ERROR)
+        return FALSE;
+    if (connect(Socket, Address, AddressSize) == SOCKET_ERROR)
+    {
+        FD_ZERO(&WriteSet);
+        FD_SET(Socket, &WriteSet);
+        FD_ZERO(&ErrorSet);
+        FD_SET(Socket, &ErrorSet);
+        Wait.tv_sec = LJB_VMON_NET_CONNECT_TIMEOUT / 1000;
+        Wait.tv_usec = (LJB_VMON_NET_CONNECT_TIMEOUT % 1000) * 1000;
+        if (select((int) Socket + 1, NULL, &WriteSet, &ErrorSet, &Wait) <= 0)
+            return FALSE;
+        Error = 0;
+        ErrorSize = sizeof(Error);
+        if (getsockopt(Socket, SOL_SOCKET, SO_ERROR, (CHAR *) &Error, &ErrorSize) == SOCKET_ERROR ||
+            Error != 0)
+            return FALSE;
+    }
+    NonBlocking = 0;
+    return ioctlsocket(Socket, FIONBIO, &NonBlocking) != SOCKET_ERROR;
+}
+
+/*
+ * Receive exactly Size bytes, waiting LJB_VMON_NET_RESUME_TIMEOUT at most
+ * for each part.
+ */
+static BOOLEAN
+LJB_VMON_NetSinkReceive(
+    __in SOCKET                         Socket,
+    __out VOID *                        Buffer,
+    __in int                            Size
+    )
+{
+    CHAR *          pBuffer = Buffer;
+    fd_set          ReadSet;
+    struct timeval  Wait;
+    int             Received;
+
+    while (Size != 0)
+    {
+        FD_ZERO(&ReadSet);
+        FD_SET(Socket, &ReadSet);
+        Wait.tv_sec = LJB_VMON_NET_RESUME_TIMEOUT / 1000;
+        Wait.tv_usec = (LJB_VMON_NET_RESUME_TIMEOUT % 1000) * 1000;
+        if (select((int) Socket + 1, &ReadSet, NULL, NULL, &Wait) <= 0)
+            return FALSE;
+        Received = recv(Socket, pBuffer, Size, 0);
+        if (Received <= 0)
+            return FALSE;
+        pBuffer += Received;
+        Size -= Received;
+    }
+    return TRUE;
+}
+
+/*
+ * Connect both channels to the receiver, say HELLO and read its RESUME.
+ * The sockets are the sink's from then on.
+ */
+static BOOLEAN
+LJB_VMON_NetSinkConnect(
+    __inout LJB_VMON_NET_SINK *         NetSink,
+    __out LJB_VMON_NET_RESUME *         Resume
+    )
+{
+    struct
+    {
+        LJB_VMON_NET_HEADER     Header;
+        LJB_VMON_NET_HELLO      Body;
+    }                   Hello;
+    struct
+    {
+        LJB_VMON_NET_HEADER     Header;
+        LJB_VMON_NET_RESUME     Body;
+    }                   Answer;
+    struct addrinfo     Hints;
+    struct addrinfo *   Result;
+    SOCKET              FrameSocket;
+    SOCKET              CursorSocket;
+    WSABUF              Buffer;
+    DWORD               Sent;
+    BOOLEAN             Connected;
+    int                 Option;
+
+    RtlZeroMemory(&Hints, sizeof(Hints));
+    Hints.ai_family = AF_INET;
+    Hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(NetSink->Host, NetSink->Port, &Hints, &Result) != 0)
+        return FALSE;
+
+    FrameSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    CursorSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    Connected =
+        FrameSocket != INVALID_SOCKET &&
+        CursorSocket != INVALID_SOCKET &&
+        LJB_VMON_NetSinkConnectSocket(FrameSocket, Result->ai_addr, (int) Result->ai_addrlen) &&
+        connect(CursorSocket, Result->ai_addr, (int) Result->ai_addrlen) != SOCKET_ERROR;
+    freeaddrinfo(Result);
+
+    if (Connected)
+    {
+        /*
+         * the tail of a frame must not wait for an ack, and a frame should
+         * fit in the send buffer. The cursor asks for low delay.
+         */
+        Option = 1;
+        setsockopt(FrameSocket, IPPROTO_TCP, TCP_NODELAY, (CONST CHAR *) &Option, sizeof(Option));
+        Option = NET_SEND_BUFFER_SIZE;
+        setsockopt(FrameSocket, SOL_SOCKET, SO_SNDBUF, (CONST CHAR *) &Option, sizeof(Option));
+        Option = NET_TOS_LOW_DELAY;
+        setsockopt(CursorSocket, IPPROTO_IP, IP_TOS, (CONST CHAR *) &Option, sizeof(Option));
+
+        RtlZeroMemory(&Hello, sizeof(Hello));
+        Hello.Header.Type = LJB_VMON_NET_TYPE_HELLO;
+        Hello.Header.Size = sizeof(Hello.Body);
+        RtlCopyMemory(Hello.Body.Signature, LJB_VMON_NET_SIGNATURE, sizeof(Hello.Body.Signature));
+        Hello.Body.Version = LJB_VMON_NET_VERSION;
+        Hello.Body.SessionId = NetSink->SessionId;
+        Buffer.buf = (CHAR *) &Hello;
+        Buffer.len = sizeof(Hello);
+        Connected =
+            WSASend(FrameSocket, &Buffer, 1, &Sent, 0, NULL, NULL) != SOCKET_ERROR &&
+            Sent == sizeof(Hello) &&
+            LJB_VMON_NetSinkReceive(FrameSocket, &Answer, sizeof(Answer)) &&
+            Answer.Header.Type == LJB_VMON_NET_TYPE_RESUME &&
+            Answer.Header.Size == sizeof(Answer.Body) &&
+            Answer.Body.SessionId == NetSink->SessionId;
+    }
+    if (!Connected)
+    {
+        if (FrameSocket != INVALID_SOCKET)
+            closesocket(FrameSocket);
+        if (CursorSocket != INVALID_SOCKET)
+            closesocket(CursorSocket);
+        return FALSE;
+    }
+
+    NetSink->FrameSocket = (ULONG_PTR) FrameSocket;
+    NetSink->CursorSocket = (ULONG_PTR) CursorSocket;
+    *Resume = Answer.Body;
+    return TRUE;
+}
+
+/*
+ * Bring the channels back whenever the VMON thread finds them failed,
+ * trying every LJB_VMON_NET_RECONNECT_INTERVAL until the receiver is there.
+ */
+static DWORD WINAPI
+LJB_VMON_NetSinkReconnectThread(
+    __in LPVOID                         Context
+    )
+{
+    LJB_VMON_NET_SINK * CONST   NetSink = Context;
+    LJB_VMON_NET_RESUME         Resume;
+
+    while (WaitForSingleObject(NetSink->hReconnectEvent, INFINITE) == WAIT_OBJECT_0 &&
+           !NetSink->Stop)
+    {
+        while (!NetSink->Stop &&
+               InterlockedCompareExchange(&NetSink->Connected, 0, 0) == LJB_VMON_NET_SINK_DOWN)
+        {
+            if (LJB_VMON_NetSinkConnect(NetSink, &Resume))
+            {
+                NetSink->Resume = Resume;
+                InterlockedExchange(&NetSink->Connected, LJB_VMON_NET_SINK_BACK);
+                SetEvent(NetSink->hCreditEvent);
+                break;
+            }
+            WaitForSingleObject(NetSink->hReconnectEvent, LJB_VMON_NET_RECONNECT_INTERVAL);
+        }
+    }
+    return 0;
+}
+
+/*
+ * Name:  LJB_VMON_NetSinkInit
+ *
+ * Definition:
+ *    __checkReturn
+ *    BOOLEAN
+ *    LJB_VMON_NetSinkInit(
+ *        __out LJB_VMON_NET_SINK *     NetSink,
+ *        __in PCSTR                    Address,
+ *        __in BOOLEAN                  Tiles,
+ *        __in UINT                     Quality
+ *        );
+ *
+ * Description:
+ *    Connect the frame and cursor channels to the receiver at Address,
+ *    "host" or "host:port" (LJB_VMON_NET_DEFAULT_PORT if none), say HELLO,
+ *    and start the thread that connects again should the frame channel
+ *    fail. With Tiles, frames go as LJB_VMON_NET_ENCODING_TILE rather than
+ *    raw, and a nonzero Quality (1 to 100) lets video regions go out lossy.
+ *
+ * Return Value:
+ *    TRUE if connected. FALSE otherwise; the caller still calls
+ *    LJB_VMON_NetSinkDeInit.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_NetSinkInit(
+    __out LJB_VMON_NET_SINK *           NetSink,
+    __in PCSTR                          Address,
+    __in BOOLEAN                        Tiles,
+    __in UINT                           Quality
+    )
+{
+    WSADATA             WsaData;
+    CHAR *              Port;
+
+    RtlZeroMemory(NetSink, sizeof(*NetSink));
+
+    NetSink->LastShape = HeapAlloc(GetProcessHeap(), 0, sizeof(POINTER_SHAPE_DATA));
+    if (NetSink->LastShape == NULL)
+        return FALSE;
+
+    NetSink->Tiles = Tiles;
+    NetSink->Quality = Quality;
+    if (Tiles && !LJB_VMON_TileEncoderInit(&NetSink->TileEncoder, 0))
+        return FALSE;
+
+    if (WSAStartup(MAKEWORD(2, 2), &WsaData) != 0)
+        return FALSE;
+    NetSink->WsaStarted = TRUE;
+
+    if (strlen(Address) >= sizeof(NetSink->Host))
+        return FALSE;
+    strcpy(NetSink->Host, Address);
+    Port = strrchr(NetSink->Host, ':');
+    if (Port != NULL)
+    {
+        *Port++ = '\0';
+        if (strlen(Port) >= sizeof(NetSink->Port))
+            return FALSE;
+        strcpy(NetSink->Port, Port);
+    }
+    else
+        sprintf(NetSink->Port, "%u", LJB_VMON_NET_DEFAULT_PORT);
+
+    /*
+     * a receiver tells sessions apart by this; it only has to differ from
+     * the one before
+     */
+    NetSink->SessionId = LJB_VMON_NetMicroseconds() ^ (ULONG) (ULONG_PTR) NetSink;
+    if (NetSink->SessionId == 0)
+        NetSink->SessionId = 1;
+
+    NetSink->hReconnectEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    NetSink->hCreditEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (NetSink->hReconnectEvent == NULL || NetSink->hCreditEvent == NULL)
+        return FALSE;
+
+    if (!LJB_VMON_NetSinkConnect(NetSink, &NetSink->Resume))
+        return FALSE;
+    NetSink->Connected = LJB_VMON_NET_SINK_UP;
+
+    NetSink->hReconnectThread = CreateThread(
+        NULL,
+        0,
+        &LJB_VMON_NetSinkReconnectThread,
+        NetSink,
+        0,
+        NULL
+        );
+    return NetSink->hReconnectThread != NULL;
+}
+
+/*
+ * Name:  LJB_VMON_NetSinkDeInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_NetSinkDeInit(
+ *        __inout LJB_VMON_NET_SINK *   NetSink
+ *        );
+ *
+ * Description:
+ *    Stop reconnecting, close both channels and free the sink. The VMON
+ *    thread must no longer report to it.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_NetSinkDeInit(
+    __inout LJB_VMON_NET_SINK *         NetSink
+    )
+{
+    if (NetSink->hReconnectThread != NULL)
+    {
+        InterlockedExchange(&NetSink->Stop, 1);
+        SetEvent(NetSink->hReconnectEvent);
+        WaitForSingleObject(NetSink->hReconnectThread, INFINITE);
+        CloseHandle(NetSink->hReconnectThread);
+    }
+    LJB_VMON_NetSinkDisconnect(NetSink);
+    if (NetSink->hReconnectEvent != NULL)
+        CloseHandle(NetSink->hReconnectEvent);
+    if (NetSink->hCreditEvent != NULL)
+        CloseHandle(NetSink->hCreditEvent);
+    if (NetSink->WsaStarted)
+        WSACleanup();
+    if (NetSink->Tiles)
+        LJB_VMON_TileEncoderDeInit(&NetSink->TileEncoder);
+    if (NetSink->LastShape != NULL)
+        HeapFree(GetProcessHeap(), 0, NetSink->LastShape);
+    RtlZeroMemory(NetSink, sizeof(*NetSink));
+}
+
+/*
+ * Name:  LJB_VMON_NetSinkGetSink
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_NetSinkGetSink(
+ *        __in LJB_VMON_NET_SINK *      NetSink,
+ *        __out LJB_VMON_SINK *         Sink
+ *        );
+ *
+ * Description:
+ *    Return the sink through which the VMON thread feeds the network sink.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_NetSinkGetSink(
+    __in LJB_VMON_NET_SINK *            NetSink,
+    __out LJB_VMON_SINK *               Sink
+    )
+{
+    Sink->SinkContext = NetSink;
+    Sink->pfnModeChange = &LJB_VMON_NetSinkModeChange;
+    Sink->pfnFrameUpdate = &LJB_VMON_NetSinkFrameUpdate;
+    Sink->pfnCursorShape = &LJB_VMON_NetSinkCursorShape;
+    Sink->pfnCursorPosition = &LJB_VMON_NetSinkCursorPosition;
+    Sink->pfnHasCredit = &LJB_VMON_NetSinkHasCredit;
+    Sink->hCreditEvent = NetSink->hCreditEvent;
+    Sink->pfnIdle = &LJB_VMON_NetSinkIdle;
+}
@@ -0,0 +1,563 @@
+#include "ljb_vmon_sink.h"
+
+/*
+ * Name:  LJB_VMON_SinkListInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_SinkListInit(
+ *        __out LJB_VMON_SINK_LIST *    SinkList
+ *        );
+ *
+ * Description:
+ *    Initialize an empty sink list.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_SinkListInit(
+    __out LJB_VMON_SINK_LIST *          SinkList
+    )
+{
+    RtlZeroMemory(SinkList, sizeof(*SinkList));
+}
+
+/*
+ * Name:  LJB_VMON_SinkListAdd
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_SinkListAdd(
+ *        __inout LJB_VMON_SINK_LIST *  SinkList,
+ *        __in CONST LJB_VMON_SINK *    Sink
+ *        );
+ *
+ * Description:
+ *    Append a copy of Sink to the list. Sinks are called in the order they
+ *    were added. Must be called before the VMON thread starts reporting.
+ *
+ * Return Value:
+ *    Return TRUE if success. Return FALSE if the list is full.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_SinkListAdd(
+    __inout LJB_VMON_SINK_LIST *        SinkList,
+    __in CONST LJB_VMON_SINK *          Sink
+    )
+{
+    if (SinkList->NumSinks >= LJB_VMON_MAX_SINKS)
+        return FALSE;
+
+    SinkList->Sinks[SinkList->NumSinks++] = *Sink;
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_SinkListModeChange
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_SinkListModeChange(
+ *        __inout LJB_VMON_SINK_LIST *      SinkList,
+ *        __in CONST TARGET_MODE_DATA *     TargetModeData
+ *        );
+ *
+ * Description:
+ *    Report a new target mode. A 0x0 mode means the source was disabled.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_SinkListModeChange(
+    __inout LJB_VMON_SINK_LIST *        SinkList,
+    __in CONST TARGET_MODE_DATA *       TargetModeData
+    )
+{
+    UINT    i;
+
+    /*
+     * what a sink missed is of the old mode; the next frame goes whole
+     */
+    for (i = 0; i < SinkList->NumSinks; i++)
+        SinkList->Behind[i] = FALSE;
+    SinkList->LastFrame.Buffer = NULL;
+
+    for (i = 0; i < SinkList->NumSinks; i++)
+    {
+        if (SinkList->Sinks[i].pfnModeChange != NULL)
+            SinkList->Sinks[i].pfnModeChange(
+                SinkList->Sinks[i].SinkContext,
+                TargetModeData
+                );
+    }
+}
+
+/*
+ * Hand Frame to sink i and count it.
+ */
+static VOID
+LJB_VMON_SinkListDeliver(
+    __inout LJB_VMON_SINK_LIST *        SinkList,
+    __in UINT                           i,
+    __in CONST LJB_VMON_SINK_FRAME *    Frame
+    )
+{
+    ULONG64 Bytes;
+
+    SinkList->Sinks[i].pfnFrameUpdate(
+        SinkList->Sinks[i].SinkContext,
+        Frame
+        );
+    SinkList->Stats.Frames++;
+    if (Frame->Damage != NULL)
+        Bytes = LJB_VMON_DamageArea(Frame->Damage) * 4;
+    else
+        Bytes = (ULONG64) Frame->Width * Frame->Height * 4;
+    SinkList->Stats.FrameBytes += Bytes;
+    if (Frame->Motion != NULL)
+    {
+        SinkList->Stats.FrameCopies += Frame->Motion->NumCopies;
+        Bytes = Frame->Motion->NumCopies * sizeof(LJB_VMON_COPY_RECT) +
+            LJB_VMON_DamageArea(&Frame->Motion->Residual) * 4;
+    }
+    SinkList->Stats.MotionBytes += Bytes;
+}
+
+/*
+ * TRUE if sink i can take a frame now.
+ */
+static BOOLEAN
+LJB_VMON_SinkListSinkHasCredit(
+    __in CONST LJB_VMON_SINK_LIST *     SinkList,
+    __in UINT                           i
+    )
+{
+    if (SinkList->Sinks[i].pfnHasCredit == NULL)
+        return TRUE;
+    return SinkList->Sinks[i].pfnHasCredit(SinkList->Sinks[i].SinkContext);
+}
+
+/*
+ * Name:  LJB_VMON_SinkListFrameUpdate
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_SinkListFrameUpdate(
+ *        __inout LJB_VMON_SINK_LIST *      SinkList,
+ *        __in CONST LJB_VMON_SINK_FRAME *  Frame
+ *        );
+ *
+ * Description:
+ *    Report a new frame, without the cursor. Frame->Damage is relative to
+ *    the previous frame reported; NULL means the whole frame changed.
+ *    Frame->Motion, if not NULL, describes the same change as moves of the
+ *    previous frame plus residual damage.
+ *
+ *    A sink out of credit does not get the frame; its damage is added to
+ *    what the sink missed, a rectangle list that collapses into its
+ *    bounding box when full. The next frame the sink gets carries that
+ *    damage as well, and no moves, since they are relative to a frame it
+ *    never saw. Frame->Buffer must stay as it is until the next frame or
+ *    mode change, for LJB_VMON_SinkListCatchUp.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_SinkListFrameUpdate(
+    __inout LJB_VMON_SINK_LIST *        SinkList,
+    __in CONST LJB_VMON_SINK_FRAME *    Frame
+    )
+{
+    LJB_VMON_SINK_FRAME CatchUpFrame;
+    LJB_VMON_DAMAGE     FullDamage;
+    UINT                i;
+
+    SinkList->LastFrame = *Frame;
+    SinkList->LastFrame.Damage = NULL;
+    SinkList->LastFrame.Motion = NULL;
+    LJB_VMON_DamageSetFull(&FullDamage, Frame->Width, Frame->Height);
+
+    SinkList->Stats.Reported++;
+    SinkList->Stats.ReportedBytes += LJB_VMON_DamageArea(
+        (Frame->Damage != NULL) ? Frame->Damage : &FullDamage) * 4;
+
+    for (i = 0; i < SinkList->NumSinks; i++)
+    {
+        if (SinkList->Sinks[i].pfnFrameUpdate == NULL)
+            continue;
+
+        if (!SinkList->Behind[i])
+            LJB_VMON_DamageReset(&SinkList->Missed[i]);
+        if (!LJB_VMON_SinkListSinkHasCredit(SinkList, i))
+        {
+            SinkList->Behind[i] = TRUE;
+            LJB_VMON_DamageAddDamage(
+                &SinkList->Missed[i],
+                (Frame->Damage != NULL) ? Frame->Damage : &FullDamage
+                );
+            SinkList->Stats.CreditSkips++;
+            continue;
+        }
+
+        if (SinkList->Behind[i])
+        {
+            LJB_VMON_DamageAddDamage(
+                &SinkList->Missed[i],
+                (Frame->Damage != NULL) ? Frame->Damage : &FullDamage
+                );
+            CatchUpFrame = *Frame;
+            CatchUpFrame.Damage = &SinkList->Missed[i];
+            CatchUpFrame.Motion = NULL;
+            SinkList->Behind[i] = FALSE;
+            SinkList->Stats.CatchUps++;
+            LJB_VMON_SinkListDeliver(SinkList, i, &CatchUpFrame);
+        }
+        else
+            LJB_VMON_SinkListDeliver(SinkList, i, Frame);
+    }
+}
+
+/*
+ * Name:  LJB_VMON_SinkListCursorShape
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_SinkListCursorShape(
+ *        __inout LJB_VMON_SINK_LIST *      SinkList,
+ *        __in CONST POINTER_SHAPE_DATA *   PointerShapeData
+ *        );
+ *
+ * Description:
+ *    Report a new cursor shape. Positions reported afterwards refer to it.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_SinkListCursorShape(
+    __inout LJB_VMON_SINK_LIST *        SinkList,
+    __in CONST POINTER_SHAPE_DATA *     PointerShapeData
+    )
+{
+    UINT    i;
+
+    for (i = 0; i < SinkList->NumSinks; i++)
+    {
+        if (SinkList->Sinks[i].pfnCursorShape != NULL)
+        {
+            SinkList->Sinks[i].pfnCursorShape(
+                SinkList->Sinks[i].SinkContext,
+                PointerShapeData
+                );
+            SinkList->Stats.CursorShapes++;
+            SinkList->Stats.CursorShapeBytes += LJB_VMON_CursorShapeSize(PointerShapeData);
+        }
+    }
+}
+
+/*
+ * Name:  LJB_VMON_SinkListCursorPosition
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_SinkListCursorPosition(
+ *        __inout LJB_VMON_SINK_LIST *          SinkList,
+ *        __in CONST POINTER_POSITION_DATA *    PointerPositionData
+ *        );
+ *
+ * Description:
+ *    Report a cursor move or a cursor visibility change.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_SinkListCursorPosition(
+    __inout LJB_VMON_SINK_LIST *        SinkList,
+    __in CONST POINTER_POSITION_DATA *  PointerPositionData
+    )
+{
+    UINT    i;
+
+    for (i = 0; i < SinkList->NumSinks; i++)
+    {
+        if (SinkList->Sinks[i].pfnCursorPosition != NULL)
+        {
+            SinkList->Sinks[i].pfnCursorPosition(
+                SinkList->Sinks[i].SinkContext,
+                PointerPositionData
+                );
+            SinkList->Stats.CursorMoves++;
+            SinkList->Stats.CursorMoveBytes += sizeof(*PointerPositionData);
+        }
+    }
+}
+
+/*
+ * Name:  LJB_VMON_SinkListHasCredit
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_SinkListHasCredit(
+ *        __inout LJB_VMON_SINK_LIST *  SinkList
+ *        );
+ *
+ * Description:
+ *    Ask whether a frame reported now would go anywhere. Sinks without flow
+ *    control always take it; sinks with it are asked. A sink out of credit
+ *    while others take frames only misses them, see
+ *    LJB_VMON_SinkListFrameUpdate, so the fastest sink paces the blits.
+ *
+ * Return Value:
+ *    Return TRUE if some sink can take a frame, or none takes frames.
+ *    Return FALSE otherwise;
+ *    one of the events of LJB_VMON_SinkListGetCreditEvents is signaled when
+ *    it may be worth asking again.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_SinkListHasCredit(
+    __inout LJB_VMON_SINK_LIST *        SinkList
+    )
+{
+    BOOLEAN AnySink = FALSE;
+    UINT    i;
+
+    for (i = 0; i < SinkList->NumSinks; i++)
+    {
+        if (SinkList->Sinks[i].pfnFrameUpdate == NULL)
+            continue;
+        if (LJB_VMON_SinkListSinkHasCredit(SinkList, i))
+            return TRUE;
+        AnySink = TRUE;
+    }
+    if (!AnySink)
+        return TRUE;
+    SinkList->Stats.CreditStalls++;
+    return FALSE;
+}
+
+/*
+ * Name:  LJB_VMON_SinkListGetCreditEvents
+ *
+ * Definition:
+ *    UINT
+ *    LJB_VMON_SinkListGetCreditEvents(
+ *        __in CONST LJB_VMON_SINK_LIST *   SinkList,
+ *        __out HANDLE *                    Events
+ *        );
+ *
+ * Description:
+ *    Copy the credit events of the sinks with flow control to Events, room
+ *    for LJB_VMON_MAX_SINKS of them.
+ *
+ * Return Value:
+ *    Number of events copied, 0 if no sink has flow control.
+ *
+ */
+UINT
+LJB_VMON_SinkListGetCreditEvents(
+    __in CONST LJB_VMON_SINK_LIST *     SinkList,
+    __out_ecount(LJB_VMON_MAX_SINKS) HANDLE * Events
+    )
+{
+    UINT    NumEvents;
+    UINT    i;
+
+    NumEvents = 0;
+    for (i = 0; i < SinkList->NumSinks; i++)
+    {
+        if (SinkList->Sinks[i].pfnHasCredit != NULL)
+            Events[NumEvents++] = SinkList->Sinks[i].hCreditEvent;
+    }
+    return NumEvents;
+}
+
+/*
+ * Name:  LJB_VMON_SinkListIsBehind
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_SinkListIsBehind(
+ *        __in CONST LJB_VMON_SINK_LIST *   SinkList
+ *        );
+ *
+ * Description:
+ *    Tell whether a sink missed frames for lack of credit and has not been
+ *    caught up yet.
+ *
+ * Return Value:
+ *    Return TRUE if one has. Return FALSE otherwise.
+ *
+ */
+BOOLEAN
+LJB_VMON_SinkListIsBehind(
+    __in CONST LJB_VMON_SINK_LIST *     SinkList
+    )
+{
+    UINT    i;
+
+    for (i = 0; i < SinkList->NumSinks; i++)
+    {
+        if (SinkList->Behind[i])
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Name:  LJB_VMON_SinkListCatchUp
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_SinkListCatchUp(
+ *        __inout LJB_VMON_SINK_LIST *  SinkList
+ *        );
+ *
+ * Description:
+ *    Give every sink that is behind and has credit again the last frame
+ *    reported, with what it missed as damage. For when credit comes back
+ *    and there is no new frame to carry it.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_SinkListCatchUp(
+    __inout LJB_VMON_SINK_LIST *        SinkList
+    )
+{
+    LJB_VMON_SINK_FRAME Frame;
+    UINT                i;
+
+    if (SinkList->LastFrame.Buffer == NULL)
+        return;
+
+    for (i = 0; i < SinkList->NumSinks; i++)
+    {
+        if (!SinkList->Behind[i] || !LJB_VMON_SinkListSinkHasCredit(SinkList, i))
+            continue;
+
+        Frame = SinkList->LastFrame;
+        Frame.Damage = &SinkList->Missed[i];
+        SinkList->Behind[i] = FALSE;
+        SinkList->Stats.CatchUps++;
+        LJB_VMON_SinkListDeliver(SinkList, i, &Frame);
+    }
+}
+
+/*
+ * Name:  LJB_VMON_SinkListIdle
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_SinkListIdle(
+ *        __inout LJB_VMON_SINK_LIST *  SinkList
+ *        );
+ *
+ * Description:
+ *    Report that no frame comes for a while. The last frame reported is
+ *    forgotten, so that the caller may free its buffer now; what sinks
+ *    missed is kept. The next frame reported need only carry what changed
+ *    since the one before, as ever.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_SinkListIdle(
+    __inout LJB_VMON_SINK_LIST *        SinkList
+    )
+{
+    UINT    i;
+
+    SinkList->LastFrame.Buffer = NULL;
+
+    for (i = 0; i < SinkList->NumSinks; i++)
+    {
+        if (SinkList->Sinks[i].pfnIdle != NULL)
+            SinkList->Sinks[i].pfnIdle(SinkList->Sinks[i].SinkContext);
+    }
+}
+
+static VOID
+LJB_VMON_NullSinkFrameUpdate(
+    __in PVOID                          SinkContext,
+    __in CONST LJB_VMON_SINK_FRAME *    Frame
+    )
+{
+    UNREFERENCED_PARAMETER(SinkContext);
+    UNREFERENCED_PARAMETER(Frame);
+}
+
+/*
+ * Name:  LJB_VMON_NullSinkGetSink
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_NullSinkGetSink(
+ *        __out LJB_VMON_SINK *             Sink
+ *        );
+ *
+ * Description:
+ *    A sink that takes every frame and drops it, always with credit. Frames
+ *    it is handed are counted in the list stats like any other, so that
+ *    capture can be measured with nothing downstream to slow it.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_NullSinkGetSink(
+    __out LJB_VMON_SINK *               Sink
+    )
+{
+    RtlZeroMemory(Sink, sizeof(*Sink));
+    Sink->pfnFrameUpdate = &LJB_VMON_NullSinkFrameUpdate;
+}
+
+/*
+ * Name:  LJB_VMON_CursorShapeSize
+ *
+ * Definition:
+ *    SIZE_T
+ *    LJB_VMON_CursorShapeSize(
+ *        __in CONST POINTER_SHAPE_DATA *   PointerShapeData
+ *        );
+ *
+ * Description:
+ *    Number of meaningful bytes at the start of PointerShapeData->Buffer. A
+ *    monochrome shape holds an AND mask followed by an XOR mask.
+ *
+ * Return Value:
+ *    Size in bytes, never more than sizeof(PointerShapeData->Buffer).
+ *
+ */
+SIZE_T
+LJB_VMON_CursorShapeSize(
+    __in CONST POINTER_SHAPE_DATA *     PointerShapeData
+    )
+{
+    SIZE_T  Size;
+
+    Size = (SIZE_T) PointerShapeData->Pitch * PointerShapeData->Height;
+    if (PointerShapeData->Flags.Monochrome)
+        Size *= 2;
+    if (Size > sizeof(PointerShapeData->Buffer))
+        Size = sizeof(PointerShapeData->Buffer);
+    return Size;
+}
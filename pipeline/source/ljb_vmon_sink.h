@@ -0,0 +1,227 @@
+/*!
+    \file       ljb_vmon_sink.h
+    \brief      Consumer interface of the VMON capture loop
+    \details    LJB_VMON_PixelMain reports what it receives from the driver
+                to a list of sinks: mode changes, clean frames and the cursor
+                as a separate plane (shape once, then positions). Frames never
+                carry the cursor. A sink that has a hardware cursor forwards
+                shape and position to its device and never composites; a
+                sink that shows pixels composites the cursor itself, at its
+                output, with the compositor in ljb_vmon_cursor.h.
+
+                All callbacks run on the VMON thread. Data passed by pointer
+                is only valid for the duration of the call.
+
+                A sink behind a link slower than the display can hold the
+                VMON thread back with credits. Frames reported while it has
+                none go to the other sinks only; the list adds their damage
+                up for it, and once it signals hCreditEvent it is caught up
+                with the latest frame and the union of what it missed. When
+                no sink has credit, frames are not blitted at all and the
+                screen changes in between pile up in the damage tracker.
+
+                While nobody can see the monitor (the source is invisible or
+                disabled, or the device is out of D0) for a while, the VMON
+                thread goes idle: it stops blitting and tells the sinks,
+                which free what the next frame can rebuild. Sinks keep the
+                frame they last got, and so does the VMON thread keep the
+                tile hashes of the last frame reported, so that the first
+                frame after that carries only what changed while idle.
+ */
+
+#ifndef _LJB_VMON_SINK_H_
+#define _LJB_VMON_SINK_H_
+
+#include <windows.h>
+#include "ljb_vmon_ioctl.h"
+#include "ljb_vmon_damage.h"
+#include "ljb_vmon_motion.h"
+
+typedef struct _LJB_VMON_SINK_FRAME
+{
+    ULONG                       FrameId;
+    UINT                        Width;
+    UINT                        Height;
+    UINT                        Pitch;
+    CONST VOID *                Buffer;     // 32bpp, Height rows of Pitch bytes
+    CONST LJB_VMON_DAMAGE *     Damage;     // changed since the previous frame
+    CONST LJB_VMON_MOTION *     Motion;     // NULL, or Damage as copies + residual
+} LJB_VMON_SINK_FRAME;
+
+typedef VOID
+LJB_VMON_SINK_MODE_CHANGE(
+    __in PVOID                          SinkContext,
+    __in CONST TARGET_MODE_DATA *       TargetModeData
+    );
+
+typedef VOID
+LJB_VMON_SINK_FRAME_UPDATE(
+    __in PVOID                          SinkContext,
+    __in CONST LJB_VMON_SINK_FRAME *    Frame
+    );
+
+typedef VOID
+LJB_VMON_SINK_CURSOR_SHAPE(
+    __in PVOID                          SinkContext,
+    __in CONST POINTER_SHAPE_DATA *     PointerShapeData
+    );
+
+typedef VOID
+LJB_VMON_SINK_CURSOR_POSITION(
+    __in PVOID                          SinkContext,
+    __in CONST POINTER_POSITION_DATA *  PointerPositionData
+    );
+
+/*
+ * TRUE if the sink can take another frame without holding up the VMON
+ * thread. Called on the VMON thread.
+ */
+typedef BOOLEAN
+LJB_VMON_SINK_HAS_CREDIT(
+    __in PVOID                          SinkContext
+    );
+
+/*
+ * No frame comes for a while; free what the next one can rebuild. The next
+ * frame the sink gets is relative to the last one it got, as ever.
+ */
+typedef VOID
+LJB_VMON_SINK_IDLE(
+    __in PVOID                          SinkContext
+    );
+
+/*
+ * Any callback can be NULL if the sink is not interested in the event. A
+ * sink with no pfnHasCredit always has credit; one with it sets
+ * hCreditEvent, an auto-reset event it signals whenever credit may have
+ * come back.
+ */
+typedef struct _LJB_VMON_SINK
+{
+    PVOID                               SinkContext;
+    LJB_VMON_SINK_MODE_CHANGE *         pfnModeChange;
+    LJB_VMON_SINK_FRAME_UPDATE *        pfnFrameUpdate;
+    LJB_VMON_SINK_CURSOR_SHAPE *        pfnCursorShape;
+    LJB_VMON_SINK_CURSOR_POSITION *     pfnCursorPosition;
+    LJB_VMON_SINK_HAS_CREDIT *          pfnHasCredit;
+    HANDLE                              hCreditEvent;
+    LJB_VMON_SINK_IDLE *                pfnIdle;
+} LJB_VMON_SINK;
+
+#define LJB_VMON_MAX_SINKS              8
+
+/*
+ * Counters are the payload bytes handed to each sink, i.e. what a sink that
+ * sends everything it receives over a link would transmit before encoding.
+ * MotionBytes is what it would send if it applied the copies of
+ * LJB_VMON_SINK_FRAME.Motion and sent the residual only. Reported and
+ * ReportedBytes count the frames reported to the list, once however many
+ * sinks get them.
+ */
+typedef struct _LJB_VMON_SINK_STATS
+{
+    ULONG64             Reported;
+    ULONG64             ReportedBytes;
+    ULONG64             Frames;
+    ULONG64             FrameBytes;
+    ULONG64             FrameCopies;
+    ULONG64             MotionBytes;
+    ULONG64             CursorShapes;
+    ULONG64             CursorShapeBytes;
+    ULONG64             CursorMoves;
+    ULONG64             CursorMoveBytes;
+    ULONG64             CreditStalls;       // checks that found no sink with credit
+    ULONG64             CreditSkips;        // frames a sink out of credit missed
+    ULONG64             CatchUps;           // missed frames made up for at once
+} LJB_VMON_SINK_STATS;
+
+typedef struct _LJB_VMON_SINK_LIST
+{
+    UINT                NumSinks;
+    LJB_VMON_SINK       Sinks[LJB_VMON_MAX_SINKS];
+
+    /*
+     * what each sink missed for lack of credit since the last frame it got,
+     * and the last frame reported, to catch it up from
+     */
+    BOOLEAN             Behind[LJB_VMON_MAX_SINKS];
+    LJB_VMON_DAMAGE     Missed[LJB_VMON_MAX_SINKS];
+    LJB_VMON_SINK_FRAME LastFrame;
+
+    LJB_VMON_SINK_STATS Stats;
+} LJB_VMON_SINK_LIST;
+
+VOID
+LJB_VMON_SinkListInit(
+    __out LJB_VMON_SINK_LIST *          SinkList
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_SinkListAdd(
+    __inout LJB_VMON_SINK_LIST *        SinkList,
+    __in CONST LJB_VMON_SINK *          Sink
+    );
+
+VOID
+LJB_VMON_SinkListModeChange(
+    __inout LJB_VMON_SINK_LIST *        SinkList,
+    __in CONST TARGET_MODE_DATA *       TargetModeData
+    );
+
+VOID
+LJB_VMON_SinkListFrameUpdate(
+    __inout LJB_VMON_SINK_LIST *        SinkList,
+    __in CONST LJB_VMON_SINK_FRAME *    Frame
+    );
+
+VOID
+LJB_VMON_SinkListCursorShape(
+    __inout LJB_VMON_SINK_LIST *        SinkList,
+    __in CONST POINTER_SHAPE_DATA *     PointerShapeData
+    );
+
+VOID
+LJB_VMON_SinkListCursorPosition(
+    __inout LJB_VMON_SINK_LIST *        SinkList,
+    __in CONST POINTER_POSITION_DATA *  PointerPositionData
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_SinkListHasCredit(
+    __inout LJB_VMON_SINK_LIST *        SinkList
+    );
+
+UINT
+LJB_VMON_SinkListGetCreditEvents(
+    __in CONST LJB_VMON_SINK_LIST *     SinkList,
+    __out_ecount(LJB_VMON_MAX_SINKS) HANDLE * Events
+    );
+
+BOOLEAN
+LJB_VMON_SinkListIsBehind(
+    __in CONST LJB_VMON_SINK_LIST *     SinkList
+    );
+
+VOID
+LJB_VMON_SinkListCatchUp(
+    __inout LJB_VMON_SINK_LIST *        SinkList
+    );
+
+VOID
+LJB_VMON_SinkListIdle(
+    __inout LJB_VMON_SINK_LIST *        SinkList
+    );
+
+VOID
+LJB_VMON_NullSinkGetSink(
+    __out LJB_VMON_SINK *               Sink
+    );
+
+SIZE_T
+LJB_VMON_CursorShapeSize(
+    __in CONST POINTER_SHAPE_DATA *     PointerShapeData
+    );
+
+#endif /* _LJB_VMON_SINK_H_ */
@@ -0,0 +1,284 @@
+/*!
+    \file       ljb_vmon_tile_codec.h
+    \brief      Lossless tile codec for frame updates sent over a link
+    \details    Encodes the damaged rectangles of a 32bpp frame as a tile
+                stream (see ljb_vmon_tile_format.h). Each 64x64 tile is coded
+                the cheapest way it allows: one color, a packed palette of up
+                to 16 colors, a palette of up to 256 colors with run lengths,
+                an LZ pass over the pixels, or raw.
+
+                With a quality set (LJB_VMON_TileEncoderSetLossy), the
+                encoder also keeps the change history of every 64x64 cell of
+                the frame. A tile of a cell that changed in most recent
+                frames and holds more than 256 colors is video or an
+                animation and goes out lossy, as a DCT tile, when that is
+                smaller; text and UI never have that many colors and stay
+                lossless. Once a cell sent lossy has not changed for
+                LJB_VMON_TILE_REFRESH_FRAMES frames, the caller is told to
+                send it again (LJB_VMON_TileEncoderAddRefresh), and it goes
+                out lossless. A frame that changes nothing is not encoded,
+                so on a desktop that goes completely still the refresh rides
+                with the next update.
+
+                The frame encoder codes tiles on threads of its own plus the
+                caller's. A submitted frame is cut into tiles and every
+                worker gets a contiguous range of them in a deque of its
+                own; a worker that runs dry steals the back half of another
+                worker's oldest range. Up to LJB_VMON_TILE_ENCODER_MAX_FRAMES
+                frames may be in flight, so the tiles of frame N+1 keep the
+                workers busy while the last ones of frame N finish; each
+                frame completes on its own count of tiles left. Tiles are
+                coded in place and the stream is assembled in tile order at
+                completion, so it is the same whatever the number of threads
+                and whoever coded which tile. LJB_VMON_TileDecode is the reference
+                decoder; it checks every length it reads and never writes
+                outside the rectangles given.
+ */
+
+#ifndef _LJB_VMON_TILE_CODEC_H_
+#define _LJB_VMON_TILE_CODEC_H_
+
+#include <windows.h>
+#include "ljb_vmon_damage.h"
+#include "ljb_vmon_tile_format.h"
+
+/*
+ * Largest encoding of one tile of Width x Height pixels, the header included.
+ */
+#define LJB_VMON_TILE_MAX_BYTES(Width, Height)  (4 + (SIZE_T) (Width) * (Height) * 4)
+
+#define LJB_VMON_TILE_ENCODER_MAX_THREADS       16
+#define LJB_VMON_TILE_ENCODER_MAX_FRAMES        2
+
+/*
+ * Lossy classification, in frames encoded: a cell is video if it changed in
+ * the previous frame and in at least LJB_VMON_TILE_VIDEO_CHANGES of the last
+ * 16, this one included.
+ */
+#define LJB_VMON_TILE_VIDEO_CHANGES             8
+#define LJB_VMON_TILE_REFRESH_FRAMES            4
+
+/*
+ * Tiles, pixels and encoded bytes (headers included) by tile type.
+ */
+typedef struct _LJB_VMON_TILE_STATS
+{
+    ULONG64             Tiles[LJB_VMON_TILE_TYPES];
+    ULONG64             Pixels[LJB_VMON_TILE_TYPES];
+    ULONG64             Bytes[LJB_VMON_TILE_TYPES];
+} LJB_VMON_TILE_STATS;
+
+typedef struct _LJB_VMON_TILE
+{
+    LONG                Left;
+    LONG                Top;
+    UINT                Width;
+    UINT                Height;
+    BOOLEAN             Video;          // may go out lossy
+    UCHAR               Type;           // as encoded
+    SIZE_T              Offset;         // in the frame's output, room for the largest encoding
+    ULONG               Size;           // as encoded
+} LJB_VMON_TILE;
+
+typedef struct _LJB_VMON_TILE_CELL
+{
+    USHORT              Changes;        // bit 0 this frame, bit 1 the one before...
+    BOOLEAN             Lossy;          // holds lossy pixels at the receiver
+} LJB_VMON_TILE_CELL;
+
+typedef struct _LJB_VMON_TILE_RANGE
+{
+    UINT                Frame;          // index in Frames
+    UINT                FirstTile;
+    UINT                NumTiles;
+} LJB_VMON_TILE_RANGE;
+
+/*
+ * A worker holds at most one range per frame in flight, plus one it stole.
+ */
+#define LJB_VMON_TILE_WORKER_MAX_RANGES     (LJB_VMON_TILE_ENCODER_MAX_FRAMES + 1)
+
+struct _LJB_VMON_TILE_ENCODER;
+
+typedef struct _LJB_VMON_TILE_WORKER
+{
+    struct _LJB_VMON_TILE_ENCODER * Encoder;
+    UINT                            Index;
+    HANDLE                          hThread;        // NULL for the caller's
+    HANDLE                          hStartEvent;
+
+    /*
+     * the deque, oldest frame first, under Lock
+     */
+    volatile LONG                   Lock;
+    UINT                            NumRanges;
+    LJB_VMON_TILE_RANGE             Ranges[LJB_VMON_TILE_WORKER_MAX_RANGES];
+
+    ULONG64                         TilesEncoded;   // by this worker
+    ULONG64                         TilesStolen;    // from other workers
+} LJB_VMON_TILE_WORKER;
+
+typedef struct _LJB_VMON_TILE_FRAME
+{
+    CONST VOID *            FrameBuffer;
+    UINT                    Pitch;
+    UINT                    Quality;            // of the lossy path when submitted
+    LJB_VMON_TILE *         Tiles;
+    UINT                    MaxTiles;
+    UINT                    NumTiles;
+    UCHAR *                 Output;
+    SIZE_T                  MaxOutput;
+    volatile LONG           Remaining;          // tiles not coded yet
+    HANDLE                  hDoneEvent;         // set when Remaining drops to 0
+} LJB_VMON_TILE_FRAME;
+
+typedef struct _LJB_VMON_TILE_ENCODER
+{
+    UINT                    NumThreads;         // workers, the caller included
+    LJB_VMON_TILE_WORKER    Workers[LJB_VMON_TILE_ENCODER_MAX_THREADS];
+    volatile LONG           Stop;
+    BOOLEAN                 UseSse2;
+
+    /*
+     * lossy path, off while Quality is 0
+     */
+    UINT                    Quality;
+    UINT                    Width;
+    UINT                    Height;
+    UINT                    CellCols;
+    UINT                    CellRows;
+    LJB_VMON_TILE_CELL *    Cells;
+    UINT                    MaxCells;
+
+    /*
+     * frames in flight, oldest at FirstFrame
+     */
+    LJB_VMON_TILE_FRAME     Frames[LJB_VMON_TILE_ENCODER_MAX_FRAMES];
+    UINT                    FirstFrame;
+    UINT                    NumFrames;
+    volatile LONG           Unclaimed;          // tiles in flight no worker has taken
+
+    LJB_VMON_TILE_STATS     Stats;              // since LJB_VMON_TileEncoderInit
+} LJB_VMON_TILE_ENCODER;
+
+/*
+ * DCT basis scaled by 2^14, zigzag order and JPEG base tables, shared by the
+ * encoder and the reference decoder.
+ */
+extern CONST SHORT  LJB_VMON_TileDctBasis[64];
+extern CONST UCHAR  LJB_VMON_TileZigzag[64];
+
+VOID
+LJB_VMON_TileDctQuantTable(
+    __in UINT                               Quality,
+    __in BOOLEAN                            Chroma,
+    __out USHORT *                          Table
+    );
+
+VOID
+LJB_VMON_TileForwardDct(
+    __in BOOLEAN                            UseSse2,
+    __in CONST SHORT *                      Samples,
+    __out SHORT *                           Coefficients
+    );
+
+SIZE_T
+LJB_VMON_TileEncodeDct(
+    __in BOOLEAN                            UseSse2,
+    __in CONST ULONG *                      Pixels,
+    __in UINT                               Width,
+    __in UINT                               Height,
+    __in UINT                               Quality,
+    __in SIZE_T                             Limit,
+    __out UCHAR *                           Output
+    );
+
+SIZE_T
+LJB_VMON_TileEncodeTile(
+    __in CONST LJB_VMON_TILE_ENCODER *      Encoder,
+    __in CONST VOID *                       Pixels,
+    __in UINT                               Pitch,
+    __in UINT                               Width,
+    __in UINT                               Height,
+    __in UINT                               Quality,
+    __out UCHAR *                           Output,
+    __inout_opt LJB_VMON_TILE_STATS *       Stats
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_TileEncoderInit(
+    __out LJB_VMON_TILE_ENCODER *           Encoder,
+    __in UINT                               NumThreads
+    );
+
+VOID
+LJB_VMON_TileEncoderDeInit(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_TileEncoderSetLossy(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder,
+    __in UINT                               Width,
+    __in UINT                               Height,
+    __in UINT                               Quality
+    );
+
+VOID
+LJB_VMON_TileEncoderAddRefresh(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder,
+    __inout LJB_VMON_DAMAGE *               Damage
+    );
+
+VOID
+LJB_VMON_TileEncoderTrim(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_TileEncoderSubmit(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder,
+    __in CONST VOID *                       FrameBuffer,
+    __in UINT                               Pitch,
+    __in CONST LJB_VMON_RECT *              Rects,
+    __in UINT                               NumRects
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_TileEncoderComplete(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder,
+    __out CONST UCHAR **                    Data,
+    __out SIZE_T *                          DataSize
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_TileEncode(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder,
+    __in CONST VOID *                       FrameBuffer,
+    __in UINT                               Pitch,
+    __in CONST LJB_VMON_RECT *              Rects,
+    __in UINT                               NumRects,
+    __out CONST UCHAR **                    Data,
+    __out SIZE_T *                          DataSize
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_TileDecode(
+    __in CONST VOID *                       Data,
+    __in SIZE_T                             DataSize,
+    __in CONST LJB_VMON_RECT *              Rects,
+    __in UINT                               NumRects,
+    __inout VOID *                          FrameBuffer,
+    __in UINT                               Width,
+    __in UINT                               Height,
+    __in UINT                               Pitch,
+    __out_opt SIZE_T *                      BytesUsed
+    );
+
+#endif /* _LJB_VMON_TILE_CODEC_H_ */
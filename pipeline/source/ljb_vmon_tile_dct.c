@@ -0,0 +1,373 @@
+#include "ljb_vmon_tile_codec.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define LJB_VMON_TILE_DCT_SSE2      1
+#else
+#define LJB_VMON_TILE_DCT_SSE2      0
+#endif
+
+/*
+ * The forward DCT is two passes of the 8x8 basis over 16-bit samples with
+ * 32-bit sums: columns first, keeping 3 fractional bits, then rows. Every
+ * sum fits in 32 bits and every result in 16, so the SSE2 version, which
+ * does the row pass as a column pass between two transposes, gives exactly
+ * the scalar results.
+ */
+#define DCT_PASS1_SHIFT     11
+#define DCT_PASS2_SHIFT     17
+
+#define MACROBLOCK_SIZE     16
+
+static SHORT
+DctRound(
+    __in LONG           Sum,
+    __in UINT           Shift
+    )
+{
+    Sum = (Sum + (1L << (Shift - 1))) >> Shift;
+    return (SHORT) ((Sum > 32767) ? 32767 : (Sum < -32768) ? -32768 : Sum);
+}
+
+static VOID
+ForwardDctScalar(
+    __in CONST SHORT *  Samples,
+    __out SHORT *       Coefficients
+    )
+{
+    SHORT   Columns[64];
+    LONG    Sum;
+    UINT    u, v, i;
+
+    for (u = 0; u < 8; u++)
+    for (v = 0; v < 8; v++)
+    {
+        Sum = 0;
+        for (i = 0; i < 8; i++)
+            Sum += (LONG) LJB_VMON_TileDctBasis[u * 8 + i] * Samples[i * 8 + v];
+        Columns[u * 8 + v] = DctRound(Sum, DCT_PASS1_SHIFT);
+    }
+
+    for (u = 0; u < 8; u++)
+    for (v = 0; v < 8; v++)
+    {
+        Sum = 0;
+        for (i = 0; i < 8; i++)
+            Sum += (LONG) LJB_VMON_TileDctBasis[v * 8 + i] * Columns[u * 8 + i];
+        Coefficients[u * 8 + v] = DctRound(Sum, DCT_PASS2_SHIFT);
+    }
+}
+
+#if LJB_VMON_TILE_DCT_SSE2
+static VOID
+Transpose8x8Sse2(
+    __inout __m128i *   r
+    )
+{
+    __m128i a0, a1, a2, a3, a4, a5, a6, a7;
+    __m128i b0, b1, b2, b3, b4, b5, b6, b7;
+
+    a0 = _mm_unpacklo_epi16(r[0], r[1]);
+    a1 = _mm_unpackhi_epi16(r[0], r[1]);
+    a2 = _mm_unpacklo_epi16(r[2], r[3]);
+    a3 = _mm_unpackhi_epi16(r[2], r[3]);
+    a4 = _mm_unpacklo_epi16(r[4], r[5]);
+    a5 = _mm_unpackhi_epi16(r[4], r[5]);
+    a6 = _mm_unpacklo_epi16(r[6], r[7]);
+    a7 = _mm_unpackhi_epi16(r[6], r[7]);
+
+    b0 = _mm_unpacklo_epi32(a0, a2);
+    b1 = _mm_unpackhi_epi32(a0, a2);
+    b2 = _mm_unpacklo_epi32(a1, a3);
+    b3 = _mm_unpackhi_epi32(a1, a3);
+    b4 = _mm_unpacklo_epi32(a4, a6);
+    b5 = _mm_unpackhi_epi32(a4, a6);
+    b6 = _mm_unpacklo_epi32(a5, a7);
+    b7 = _mm_unpackhi_epi32(a5, a7);
+
+    r[0] = _mm_unpacklo_epi64(b0, b4);
+    r[1] = _mm_unpackhi_epi64(b0, b4);
+    r[2] = _mm_unpacklo_epi64(b1, b5);
+    r[3] = _mm_unpackhi_epi64(b1, b5);
+    r[4] = _mm_unpacklo_epi64(b2, b6);
+    r[5] = _mm_unpackhi_epi64(b2, b6);
+    r[6] = _mm_unpacklo_epi64(b3, b7);
+    r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+/*
+ * out[u] = sum over i of basis[u][i] * in[i], eight 16-bit columns at a
+ * time. Rows are interleaved in pairs so that one pmaddwd does two terms.
+ */
+static VOID
+DctColumnsSse2(
+    __in CONST __m128i *    In,
+    __out __m128i *         Out,
+    __in int                Shift
+    )
+{
+    __m128i CONST   Round = _mm_set1_epi32(1 << (Shift - 1));
+    __m128i         Lo[4], Hi[4];
+    __m128i         SumLo, SumHi, Pair;
+    UINT            u, i;
+
+    for (i = 0; i < 4; i++)
+    {
+        Lo[i] = _mm_unpacklo_epi16(In[i * 2], In[i * 2 + 1]);
+        Hi[i] = _mm_unpackhi_epi16(In[i * 2], In[i * 2 + 1]);
+    }
+
+    for (u = 0; u < 8; u++)
+    {
+        SumLo = Round;
+        SumHi = Round;
+        for (i = 0; i < 4; i++)
+        {
+            Pair = _mm_set1_epi32(
+                (int) (((ULONG) (USHORT) LJB_VMON_TileDctBasis[u * 8 + i * 2 + 1] << 16) |
+                       (USHORT) LJB_VMON_TileDctBasis[u * 8 + i * 2])
+                );
+            SumLo = _mm_add_epi32(SumLo, _mm_madd_epi16(Lo[i], Pair));
+            SumHi = _mm_add_epi32(SumHi, _mm_madd_epi16(Hi[i], Pair));
+        }
+        Out[u] = _mm_packs_epi32(_mm_srai_epi32(SumLo, Shift), _mm_srai_epi32(SumHi, Shift));
+    }
+}
+
+static VOID
+ForwardDctSse2(
+    __in CONST SHORT *  Samples,
+    __out SHORT *       Coefficients
+    )
+{
+    __m128i Rows[8];
+    __m128i Columns[8];
+    UINT    i;
+
+    for (i = 0; i < 8; i++)
+        Rows[i] = _mm_loadu_si128((CONST __m128i *) (Samples + i * 8));
+
+    DctColumnsSse2(Rows, Columns, DCT_PASS1_SHIFT);
+    Transpose8x8Sse2(Columns);
+    DctColumnsSse2(Columns, Rows, DCT_PASS2_SHIFT);
+    Transpose8x8Sse2(Rows);
+
+    for (i = 0; i < 8; i++)
+        _mm_storeu_si128((__m128i *) (Coefficients + i * 8), Rows[i]);
+}
+#endif
+
+/*
+ * Name:  LJB_VMON_TileForwardDct
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_TileForwardDct(
+ *        __in BOOLEAN          UseSse2,
+ *        __in CONST SHORT *    Samples,
+ *        __out SHORT *         Coefficients
+ *        );
+ *
+ * Description:
+ *    Orthonormal 8x8 DCT of level shifted samples (-128 to 127), row major
+ *    in and out. Both versions give the same coefficients.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_TileForwardDct(
+    __in BOOLEAN                            UseSse2,
+    __in CONST SHORT *                      Samples,
+    __out SHORT *                           Coefficients
+    )
+{
+#if LJB_VMON_TILE_DCT_SSE2
+    if (UseSse2)
+    {
+        ForwardDctSse2(Samples, Coefficients);
+        return;
+    }
+#else
+    UNREFERENCED_PARAMETER(UseSse2);
+#endif
+    ForwardDctScalar(Samples, Coefficients);
+}
+
+static UCHAR *
+PutVarint(
+    __out UCHAR *       p,
+    __in ULONG          Value
+    )
+{
+    while (Value >= 0x80)
+    {
+        *p++ = (UCHAR) (Value | 0x80);
+        Value >>= 7;
+    }
+    *p++ = (UCHAR) Value;
+    return p;
+}
+
+/*
+ * Transform, quantize and write one block. Returns where the block ends.
+ */
+static UCHAR *
+EncodeBlock(
+    __in BOOLEAN            UseSse2,
+    __in CONST SHORT *      Samples,
+    __in CONST USHORT *     Table,
+    __inout LONG *          PreviousDc,
+    __out UCHAR *           p
+    )
+{
+    SHORT   Coefficients[64];
+    LONG    Quantized[64];
+    LONG    Value;
+    UINT    Run;
+    UINT    Last;
+    UINT    Q;
+    UINT    i, n;
+
+    LJB_VMON_TileForwardDct(UseSse2, Samples, Coefficients);
+
+    Last = 0;
+    for (i = 0; i < 64; i++)
+    {
+        n = LJB_VMON_TileZigzag[i];
+        Q = Table[n];
+        Value = Coefficients[n];
+        Value = (Value >= 0) ? (LONG) ((Value + Q / 2) / Q) : -(LONG) ((-Value + Q / 2) / Q);
+        if (i == 0)
+        {
+            LONG CONST  Dc = Value;
+
+            Value -= *PreviousDc;
+            *PreviousDc = Dc;
+        }
+        Quantized[i] = Value;
+        if (Value != 0)
+            Last = i + 1;
+    }
+
+    Run = 0;
+    for (i = 0; i < Last; i++)
+    {
+        Value = Quantized[i];
+        if (Value == 0)
+        {
+            Run++;
+            continue;
+        }
+        if (Value == 1 || Value == -1)
+            *p++ = (UCHAR) (((Value == 1) ? 1 : 2) << 6 | Run);
+        else
+        {
+            *p++ = (UCHAR) (3 << 6 | Run);
+            p = PutVarint(p, ((ULONG) Value << 1) ^ (ULONG) (Value >> 31));
+        }
+        Run = 0;
+    }
+    *p++ = 0;
+    return p;
+}
+
+/*
+ * Largest block: a token and a 3-byte varint per coefficient, then the end.
+ */
+#define DCT_MAX_BLOCK_BYTES     (64 * 4 + 1)
+
+/*
+ * Name:  LJB_VMON_TileEncodeDct
+ *
+ * Definition:
+ *    SIZE_T
+ *    LJB_VMON_TileEncodeDct(
+ *        __in BOOLEAN          UseSse2,
+ *        __in CONST ULONG *    Pixels,
+ *        __in UINT             Width,
+ *        __in UINT             Height,
+ *        __in UINT             Quality,
+ *        __in SIZE_T           Limit,
+ *        __out UCHAR *         Output
+ *        );
+ *
+ * Description:
+ *    Write the payload of a DCT tile of Width x Height packed pixels at
+ *    Quality (1 to 100), in fewer than Limit bytes.
+ *
+ * Return Value:
+ *    Bytes written, 0 if the payload would not fit in Limit.
+ *
+ */
+SIZE_T
+LJB_VMON_TileEncodeDct(
+    __in BOOLEAN                            UseSse2,
+    __in CONST ULONG *                      Pixels,
+    __in UINT                               Width,
+    __in UINT                               Height,
+    __in UINT                               Quality,
+    __in SIZE_T                             Limit,
+    __out UCHAR *                           Output
+    )
+{
+    USHORT          LumaTable[64];
+    USHORT          ChromaTable[64];
+    SHORT           Y[4][64];
+    SHORT           Cb[64];
+    SHORT           Cr[64];
+    LONG            CbSum[64];
+    LONG            CrSum[64];
+    LONG            PreviousDc[3] = { 0, 0, 0 };
+    UCHAR *         p = Output;
+    ULONG           Pixel;
+    LONG            R, G, B;
+    UINT            mx, my, x, y, px, py, b, i;
+
+    if (Limit <= 2)
+        return 0;
+
+    LJB_VMON_TileDctQuantTable(Quality, FALSE, LumaTable);
+    LJB_VMON_TileDctQuantTable(Quality, TRUE, ChromaTable);
+    *p++ = (UCHAR) Quality;
+    *p++ = (UCHAR) (Pixels[0] >> 24);
+
+    for (my = 0; my < Height; my += MACROBLOCK_SIZE)
+    for (mx = 0; mx < Width; mx += MACROBLOCK_SIZE)
+    {
+        if ((SIZE_T) (p - Output) + 6 * DCT_MAX_BLOCK_BYTES >= Limit)
+            return 0;
+
+        RtlZeroMemory(CbSum, sizeof(CbSum));
+        RtlZeroMemory(CrSum, sizeof(CrSum));
+        for (y = 0; y < MACROBLOCK_SIZE; y++)
+        for (x = 0; x < MACROBLOCK_SIZE; x++)
+        {
+            px = (mx + x < Width) ? mx + x : Width - 1;
+            py = (my + y < Height) ? my + y : Height - 1;
+            Pixel = Pixels[py * Width + px];
+            R = (LONG) (Pixel >> 16) & 0xFF;
+            G = (LONG) (Pixel >> 8) & 0xFF;
+            B = (LONG) Pixel & 0xFF;
+
+            b = (y / 8) * 2 + x / 8;
+            Y[b][(y % 8) * 8 + x % 8] =
+                (SHORT) (((19595 * R + 38470 * G + 7471 * B + 32768) >> 16) - 128);
+            i = (y / 2) * 8 + x / 2;
+            CbSum[i] += (-11059 * R - 21709 * G + 32768 * B + 32768) >> 16;
+            CrSum[i] += (32768 * R - 27439 * G - 5329 * B + 32768) >> 16;
+        }
+        for (i = 0; i < 64; i++)
+        {
+            Cb[i] = (SHORT) ((CbSum[i] + 2) >> 2);
+            Cr[i] = (SHORT) ((CrSum[i] + 2) >> 2);
+        }
+
+        for (b = 0; b < 4; b++)
+            p = EncodeBlock(UseSse2, Y[b], LumaTable, &PreviousDc[0], p);
+        p = EncodeBlock(UseSse2, Cb, ChromaTable, &PreviousDc[1], p);
+        p = EncodeBlock(UseSse2, Cr, ChromaTable, &PreviousDc[2], p);
+    }
+    return p - Output;
+}
@@ -0,0 +1,591 @@
+#include "ljb_vmon_tile_codec.h"
+
+CONST SHORT LJB_VMON_TileDctBasis[64] =
+{
+    5793,  5793,  5793,  5793,  5793,  5793,  5793,  5793,
+    8035,  6811,  4551,  1598, -1598, -4551, -6811, -8035,
+    7568,  3135, -3135, -7568, -7568, -3135,  3135,  7568,
+    6811, -1598, -8035, -4551,  4551,  8035,  1598, -6811,
+    5793, -5793, -5793,  5793,  5793, -5793, -5793,  5793,
+    4551, -8035,  1598,  6811, -6811, -1598,  8035, -4551,
+    3135, -7568,  7568, -3135, -3135,  7568, -7568,  3135,
+    1598, -4551,  6811, -8035,  8035, -6811,  4551, -1598
+};
+
+CONST UCHAR LJB_VMON_TileZigzag[64] =
+{
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63
+};
+
+static CONST UCHAR LumaBase[64] =
+{
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99
+};
+
+static CONST UCHAR ChromaBase[64] =
+{
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99
+};
+
+/*
+ * Name:  LJB_VMON_TileDctQuantTable
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_TileDctQuantTable(
+ *        __in UINT         Quality,
+ *        __in BOOLEAN      Chroma,
+ *        __out USHORT *    Table
+ *        );
+ *
+ * Description:
+ *    The 64 quantization steps, row major, of DCT tiles at Quality (1 to
+ *    100) for luma or chroma blocks, as ljb_vmon_tile_format.h defines them.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_TileDctQuantTable(
+    __in UINT                               Quality,
+    __in BOOLEAN                            Chroma,
+    __out USHORT *                          Table
+    )
+{
+    CONST UCHAR * CONST Base = Chroma ? ChromaBase : LumaBase;
+    UINT                Scale;
+    UINT                Step;
+    UINT                i;
+
+    Scale = (Quality < 50) ? 5000 / Quality : 200 - 2 * Quality;
+    for (i = 0; i < 64; i++)
+    {
+        Step = (Base[i] * Scale + 50) / 100;
+        Table[i] = (USHORT) ((Step < 1) ? 1 : (Step > 255) ? 255 : Step);
+    }
+}
+
+static ULONG
+GetUlong(
+    __in CONST UCHAR *  p
+    )
+{
+    return (ULONG) p[0] | (ULONG) p[1] << 8 | (ULONG) p[2] << 16 | (ULONG) p[3] << 24;
+}
+
+static BOOLEAN
+GetLength(
+    __inout CONST UCHAR **  pp,
+    __in CONST UCHAR *      End,
+    __inout UINT *          Length
+    )
+{
+    CONST UCHAR *   p = *pp;
+    UCHAR           Byte;
+
+    do
+    {
+        if (p == End || *Length > LJB_VMON_TILE_SIZE * LJB_VMON_TILE_SIZE)
+            return FALSE;
+        Byte = *p++;
+        *Length += Byte;
+    } while (Byte == 255);
+
+    *pp = p;
+    return TRUE;
+}
+
+static BOOLEAN
+DecodePalette(
+    __in CONST UCHAR *      p,
+    __in CONST UCHAR *      End,
+    __out ULONG *           Palette,
+    __out UINT *            NumColors,
+    __out CONST UCHAR **    Next
+    )
+{
+    UINT    i;
+
+    if (p == End)
+        return FALSE;
+    *NumColors = *p++ + 1u;
+    if ((SIZE_T) (End - p) < *NumColors * 4)
+        return FALSE;
+    for (i = 0; i < *NumColors; i++, p += 4)
+        Palette[i] = GetUlong(p);
+    *Next = p;
+    return TRUE;
+}
+
+static BOOLEAN
+DecodePalettePacked(
+    __in CONST UCHAR *      p,
+    __in CONST UCHAR *      End,
+    __in UINT               Width,
+    __in UINT               Height,
+    __out ULONG *           Pixels
+    )
+{
+    ULONG   Palette[256];
+    UINT    NumColors;
+    UINT    Bits;
+    UINT    RowBytes;
+    UINT    Index;
+    UINT    x, y;
+
+    if (!DecodePalette(p, End, Palette, &NumColors, &p))
+        return FALSE;
+    if (NumColors < 2 || NumColors > 16)
+        return FALSE;
+
+    Bits = (NumColors <= 2) ? 1 : (NumColors <= 4) ? 2 : 4;
+    RowBytes = (Width * Bits + 7) / 8;
+    if ((SIZE_T) (End - p) != (SIZE_T) RowBytes * Height)
+        return FALSE;
+
+    for (y = 0; y < Height; y++, p += RowBytes)
+    {
+        for (x = 0; x < Width; x++)
+        {
+            Index = (p[x * Bits / 8] >> (8 - Bits - x * Bits % 8)) & ((1u << Bits) - 1);
+            if (Index >= NumColors)
+                return FALSE;
+            *Pixels++ = Palette[Index];
+        }
+    }
+    return TRUE;
+}
+
+static BOOLEAN
+DecodePaletteRle(
+    __in CONST UCHAR *      p,
+    __in CONST UCHAR *      End,
+    __in UINT               NumPixels,
+    __out ULONG *           Pixels
+    )
+{
+    ULONG   Palette[256];
+    UINT    NumColors;
+    UINT    Index;
+    UINT    Run;
+    UINT    Shift;
+    UINT    i;
+
+    if (!DecodePalette(p, End, Palette, &NumColors, &p))
+        return FALSE;
+
+    i = 0;
+    while (i < NumPixels)
+    {
+        if (p == End)
+            return FALSE;
+        Index = *p++;
+        if (Index >= NumColors)
+            return FALSE;
+
+        Run = 0;
+        Shift = 0;
+        do
+        {
+            if (p == End || Shift > 14)
+                return FALSE;
+            Run |= (UINT) (*p & 0x7F) << Shift;
+            Shift += 7;
+        } while (*p++ & 0x80);
+        Run++;
+
+        if (Run > NumPixels - i)
+            return FALSE;
+        while (Run-- != 0)
+            Pixels[i++] = Palette[Index];
+    }
+    return p == End;
+}
+
+static BOOLEAN
+DecodeLz(
+    __in CONST UCHAR *      p,
+    __in CONST UCHAR *      End,
+    __in UINT               NumPixels,
+    __out ULONG *           Pixels
+    )
+{
+    UINT    Token;
+    UINT    Literals;
+    UINT    Length;
+    UINT    Distance;
+    UINT    i = 0;
+
+    while (i < NumPixels)
+    {
+        if (p == End)
+            return FALSE;
+        Token = *p++;
+
+        Literals = Token >> 4;
+        if (Literals == 15 && !GetLength(&p, End, &Literals))
+            return FALSE;
+        if (Literals > NumPixels - i || (SIZE_T) (End - p) < Literals * 4)
+            return FALSE;
+        RtlCopyMemory(Pixels + i, p, Literals * 4);
+        p += Literals * 4;
+        i += Literals;
+        if (i == NumPixels)
+            break;
+
+        if (End - p < 2)
+            return FALSE;
+        Distance = (UINT) p[0] | (UINT) p[1] << 8;
+        p += 2;
+        Length = Token & 0x0F;
+        if (Length == 15 && !GetLength(&p, End, &Length))
+            return FALSE;
+        Length += LJB_VMON_TILE_LZ_MIN_MATCH;
+
+        if (Distance == 0 || Distance > i || Length > NumPixels - i)
+            return FALSE;
+        while (Length-- != 0)
+        {
+            Pixels[i] = Pixels[i - Distance];
+            i++;
+        }
+    }
+    return p == End;
+}
+
+/*
+ * Inverse of the encoder's DCT, in the same fixed point. Coefficients are
+ * clamped first so that no input overflows the 32-bit sums.
+ */
+#define IDCT_MAX_COEFFICIENT    4096
+#define IDCT_PASS1_SHIFT        12
+#define IDCT_PASS2_SHIFT        16
+
+static VOID
+InverseDct(
+    __in CONST LONG *       Coefficients,
+    __out UCHAR *           Samples
+    )
+{
+    LONG    Columns[64];
+    LONG    Sum;
+    UINT    u, x, y;
+
+    for (y = 0; y < 8; y++)
+    for (x = 0; x < 8; x++)
+    {
+        Sum = 0;
+        for (u = 0; u < 8; u++)
+            Sum += LJB_VMON_TileDctBasis[u * 8 + y] * Coefficients[u * 8 + x];
+        Columns[y * 8 + x] = (Sum + (1L << (IDCT_PASS1_SHIFT - 1))) >> IDCT_PASS1_SHIFT;
+    }
+
+    for (y = 0; y < 8; y++)
+    for (x = 0; x < 8; x++)
+    {
+        Sum = 0;
+        for (u = 0; u < 8; u++)
+            Sum += LJB_VMON_TileDctBasis[u * 8 + x] * Columns[y * 8 + u];
+        Sum = ((Sum + (1L << (IDCT_PASS2_SHIFT - 1))) >> IDCT_PASS2_SHIFT) + 128;
+        Samples[y * 8 + x] = (UCHAR) ((Sum < 0) ? 0 : (Sum > 255) ? 255 : Sum);
+    }
+}
+
+static BOOLEAN
+DecodeBlock(
+    __inout CONST UCHAR **  pp,
+    __in CONST UCHAR *      End,
+    __in CONST USHORT *     Table,
+    __inout LONG *          PreviousDc,
+    __out UCHAR *           Samples
+    )
+{
+    CONST UCHAR *   p = *pp;
+    LONG            Quantized[64];
+    LONG            Coefficients[64];
+    LONG            Value;
+    ULONG           Code;
+    UINT            Shift;
+    UINT            Token;
+    UINT            i, n;
+
+    RtlZeroMemory(Quantized, sizeof(Quantized));
+    i = 0;
+    for (;;)
+    {
+        if (p == End)
+            return FALSE;
+        Token = *p++;
+        if (Token == 0)
+            break;
+        if ((Token >> 6) == 0)
+            return FALSE;
+        i += Token & 0x3F;
+        if (i >= 64)
+            return FALSE;
+
+        switch (Token >> 6)
+        {
+        case 1:
+            Value = 1;
+            break;
+        case 2:
+            Value = -1;
+            break;
+        default:
+            Code = 0;
+            Shift = 0;
+            do
+            {
+                if (p == End || Shift > 14)
+                    return FALSE;
+                Code |= (ULONG) (*p & 0x7F) << Shift;
+                Shift += 7;
+            } while (*p++ & 0x80);
+            Value = (LONG) (Code >> 1) ^ -(LONG) (Code & 1);
+            break;
+        }
+        Quantized[i++] = Value;
+    }
+
+    Quantized[0] += *PreviousDc;
+    *PreviousDc = Quantized[0];
+
+    for (i = 0; i < 64; i++)
+    {
+        n = LJB_VMON_TileZigzag[i];
+        Value = Quantized[i];
+        Value = (Value > IDCT_MAX_COEFFICIENT) ? IDCT_MAX_COEFFICIENT :
+                (Value < -IDCT_MAX_COEFFICIENT) ? -IDCT_MAX_COEFFICIENT : Value;
+        Value *= (LONG) Table[n];
+        Coefficients[n] = (Value > IDCT_MAX_COEFFICIENT) ? IDCT_MAX_COEFFICIENT :
+                          (Value < -IDCT_MAX_COEFFICIENT) ? -IDCT_MAX_COEFFICIENT : Value;
+    }
+    InverseDct(Coefficients, Samples);
+
+    *pp = p;
+    return TRUE;
+}
+
+static UCHAR
+ClampSample(
+    __in LONG           Value
+    )
+{
+    return (UCHAR) ((Value < 0) ? 0 : (Value > 255) ? 255 : Value);
+}
+
+static BOOLEAN
+DecodeDct(
+    __in CONST UCHAR *      p,
+    __in CONST UCHAR *      End,
+    __in UINT               Width,
+    __in UINT               Height,
+    __out ULONG *           Pixels
+    )
+{
+    USHORT  LumaTable[64];
+    USHORT  ChromaTable[64];
+    UCHAR   Y[4][64];
+    UCHAR   Cb[64];
+    UCHAR   Cr[64];
+    LONG    PreviousDc[3] = { 0, 0, 0 };
+    ULONG   Alpha;
+    LONG    Luma, BlueDiff, RedDiff;
+    UINT    Quality;
+    UINT    mx, my, x, y, b, i;
+
+    if (End - p < 2)
+        return FALSE;
+    Quality = *p++;
+    Alpha = (ULONG) *p++ << 24;
+    if (Quality < 1 || Quality > 100)
+        return FALSE;
+    LJB_VMON_TileDctQuantTable(Quality, FALSE, LumaTable);
+    LJB_VMON_TileDctQuantTable(Quality, TRUE, ChromaTable);
+
+    for (my = 0; my < Height; my += 16)
+    for (mx = 0; mx < Width; mx += 16)
+    {
+        for (b = 0; b < 4; b++)
+        {
+            if (!DecodeBlock(&p, End, LumaTable, &PreviousDc[0], Y[b]))
+                return FALSE;
+        }
+        if (!DecodeBlock(&p, End, ChromaTable, &PreviousDc[1], Cb) ||
+            !DecodeBlock(&p, End, ChromaTable, &PreviousDc[2], Cr))
+            return FALSE;
+
+        for (y = 0; y < 16 && my + y < Height; y++)
+        for (x = 0; x < 16 && mx + x < Width; x++)
+        {
+            b = (y / 8) * 2 + x / 8;
+            i = (y / 2) * 8 + x / 2;
+            Luma = Y[b][(y % 8) * 8 + x % 8];
+            BlueDiff = (LONG) Cb[i] - 128;
+            RedDiff = (LONG) Cr[i] - 128;
+            Pixels[(my + y) * Width + mx + x] = Alpha |
+                (ULONG) ClampSample(Luma + ((91881 * RedDiff + 32768) >> 16)) << 16 |
+                (ULONG) ClampSample(Luma + ((-22554 * BlueDiff - 46802 * RedDiff + 32768) >> 16)) << 8 |
+                (ULONG) ClampSample(Luma + ((116130 * BlueDiff + 32768) >> 16));
+        }
+    }
+    return p == End;
+}
+
+/*
+ * Name:  LJB_VMON_TileDecode
+ *
+ * Definition:
+ *    __checkReturn
+ *    BOOLEAN
+ *    LJB_VMON_TileDecode(
+ *        __in CONST VOID *                 Data,
+ *        __in SIZE_T                       DataSize,
+ *        __in CONST LJB_VMON_RECT *        Rects,
+ *        __in UINT                         NumRects,
+ *        __inout VOID *                    FrameBuffer,
+ *        __in UINT                         Width,
+ *        __in UINT                         Height,
+ *        __in UINT                         Pitch,
+ *        __out_opt SIZE_T *                BytesUsed
+ *        );
+ *
+ * Description:
+ *    Decode the tile stream of Rects into the 32bpp FrameBuffer of Width x
+ *    Height pixels. The stream may be followed by other data; BytesUsed
+ *    receives the size of the stream itself. On failure, the rectangles may
+ *    be partly written.
+ *
+ * Return Value:
+ *    TRUE on success, FALSE if a rectangle is outside the frame or the stream
+ *    is truncated or malformed.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_TileDecode(
+    __in CONST VOID *                       Data,
+    __in SIZE_T                             DataSize,
+    __in CONST LJB_VMON_RECT *              Rects,
+    __in UINT                               NumRects,
+    __inout VOID *                          FrameBuffer,
+    __in UINT                               Width,
+    __in UINT                               Height,
+    __in UINT                               Pitch,
+    __out_opt SIZE_T *                      BytesUsed
+    )
+{
+    CONST UCHAR *   p = Data;
+    CONST UCHAR *   End = p + DataSize;
+    CONST UCHAR *   Payload;
+    ULONG           Pixels[LJB_VMON_TILE_SIZE * LJB_VMON_TILE_SIZE];
+    ULONG           Header;
+    SIZE_T          Size;
+    UINT            TileWidth;
+    UINT            TileHeight;
+    UINT            NumPixels;
+    UINT            r, i;
+    LONG            x, y;
+    BOOLEAN         Ok;
+
+    if (BytesUsed != NULL)
+        *BytesUsed = 0;
+
+    for (r = 0; r < NumRects; r++)
+    {
+        if (Rects[r].Left < 0 || Rects[r].Top < 0 ||
+            Rects[r].Right > (LONG) Width || Rects[r].Bottom > (LONG) Height ||
+            Rects[r].Left > Rects[r].Right || Rects[r].Top > Rects[r].Bottom)
+            return FALSE;
+
+        for (y = Rects[r].Top; y < Rects[r].Bottom; y += LJB_VMON_TILE_SIZE)
+        for (x = Rects[r].Left; x < Rects[r].Right; x += LJB_VMON_TILE_SIZE)
+        {
+            TileWidth = (UINT) ((Rects[r].Right - x < LJB_VMON_TILE_SIZE) ?
+                Rects[r].Right - x : LJB_VMON_TILE_SIZE);
+            TileHeight = (UINT) ((Rects[r].Bottom - y < LJB_VMON_TILE_SIZE) ?
+                Rects[r].Bottom - y : LJB_VMON_TILE_SIZE);
+            NumPixels = TileWidth * TileHeight;
+
+            if (End - p < 4)
+                return FALSE;
+            Header = GetUlong(p);
+            Size = LJB_VMON_TILE_HEADER_SIZE(Header);
+            Payload = p + 4;
+            if ((SIZE_T) (End - Payload) < Size)
+                return FALSE;
+            p = Payload + Size;
+
+            switch (LJB_VMON_TILE_HEADER_TYPE(Header))
+            {
+            case LJB_VMON_TILE_SOLID:
+                Ok = (Size == 4);
+                if (Ok)
+                {
+                    Pixels[0] = GetUlong(Payload);
+                    for (i = 1; i < NumPixels; i++)
+                        Pixels[i] = Pixels[0];
+                }
+                break;
+            case LJB_VMON_TILE_PALETTE:
+                Ok = DecodePalettePacked(Payload, p, TileWidth, TileHeight, Pixels);
+                break;
+            case LJB_VMON_TILE_PALETTE_RLE:
+                Ok = DecodePaletteRle(Payload, p, NumPixels, Pixels);
+                break;
+            case LJB_VMON_TILE_LZ:
+                Ok = DecodeLz(Payload, p, NumPixels, Pixels);
+                break;
+            case LJB_VMON_TILE_RAW:
+                Ok = (Size == (SIZE_T) NumPixels * 4);
+                if (Ok)
+                    RtlCopyMemory(Pixels, Payload, Size);
+                break;
+            case LJB_VMON_TILE_DCT:
+                Ok = DecodeDct(Payload, p, TileWidth, TileHeight, Pixels);
+                break;
+            default:
+                Ok = FALSE;
+                break;
+            }
+            if (!Ok)
+                return FALSE;
+
+            for (i = 0; i < TileHeight; i++)
+            {
+                RtlCopyMemory(
+                    (UCHAR *) FrameBuffer + (SIZE_T) (y + i) * Pitch + (SIZE_T) x * 4,
+                    Pixels + i * TileWidth,
+                    TileWidth * 4
+                    );
+            }
+        }
+    }
+
+    if (BytesUsed != NULL)
+        *BytesUsed = p - (CONST UCHAR *) Data;
+    return TRUE;
+}
@@ -0,0 +1,1369 @@
+#include "ljb_vmon_tile_codec.h"
+
+#define TILE_PIXELS             (LJB_VMON_TILE_SIZE * LJB_VMON_TILE_SIZE)
+#define PALETTE_SLOTS           512     // power of 2, twice the largest palette
+#define PALETTE_MAX_PACKED      16
+#define PALETTE_MAX_RLE         256
+#define LZ_HASH_BITS            12
+
+/*
+ * What one pass over a tile finds out about its colors: the palette, up to
+ * PALETTE_MAX_RLE colors, each pixel's index in it, and what the runs would
+ * cost as PALETTE_RLE.
+ */
+typedef struct _TILE_ANALYSIS
+{
+    UINT                NumColors;      // PALETTE_MAX_RLE + 1 if more
+    ULONG               Palette[PALETTE_MAX_RLE];
+    UCHAR               Indices[TILE_PIXELS];
+    SIZE_T              RunBytes;
+} TILE_ANALYSIS;
+
+static VOID
+PutUshort(
+    __out UCHAR *       p,
+    __in ULONG          Value
+    )
+{
+    p[0] = (UCHAR) Value;
+    p[1] = (UCHAR) (Value >> 8);
+}
+
+static VOID
+PutUlong(
+    __out UCHAR *       p,
+    __in ULONG          Value
+    )
+{
+    p[0] = (UCHAR) Value;
+    p[1] = (UCHAR) (Value >> 8);
+    p[2] = (UCHAR) (Value >> 16);
+    p[3] = (UCHAR) (Value >> 24);
+}
+
+static UINT
+VarintSize(
+    __in ULONG          Value
+    )
+{
+    UINT    Size = 1;
+
+    while (Value >= 0x80)
+    {
+        Value >>= 7;
+        Size++;
+    }
+    return Size;
+}
+
+static UCHAR *
+PutVarint(
+    __out UCHAR *       p,
+    __in ULONG          Value
+    )
+{
+    while (Value >= 0x80)
+    {
+        *p++ = (UCHAR) (Value | 0x80);
+        Value >>= 7;
+    }
+    *p++ = (UCHAR) Value;
+    return p;
+}
+
+static VOID
+AnalyzeTile(
+    __in CONST ULONG *          Pixels,
+    __in UINT                   NumPixels,
+    __out TILE_ANALYSIS *       Analysis
+    )
+{
+    USHORT  Slots[PALETTE_SLOTS];   // palette index + 1, 0 if free
+    ULONG   Color;
+    UINT    Slot;
+    UINT    Index;
+    UINT    Run;
+    UINT    i, j;
+
+    RtlZeroMemory(Slots, sizeof(Slots));
+    Analysis->NumColors = 0;
+    Analysis->RunBytes = 0;
+
+    /*
+     * look the color up once per run of equal pixels.
+     */
+    for (i = 0; i < NumPixels; i += Run)
+    {
+        Color = Pixels[i];
+        for (Run = 1; i + Run < NumPixels && Pixels[i + Run] == Color; Run++)
+            ;
+
+        Slot = (UINT) ((ULONG) (Color * 0x9E3779B1UL) >> (32 - 9)) & (PALETTE_SLOTS - 1);
+        for (;;)
+        {
+            if (Slots[Slot] == 0)
+            {
+                if (Analysis->NumColors == PALETTE_MAX_RLE)
+                {
+                    Analysis->NumColors++;
+                    return;
+                }
+                Analysis->Palette[Analysis->NumColors] = Color;
+                Slots[Slot] = (USHORT) ++Analysis->NumColors;
+                break;
+            }
+            if (Analysis->Palette[Slots[Slot] - 1] == Color)
+                break;
+            Slot = (Slot + 1) & (PALETTE_SLOTS - 1);
+        }
+        Index = Slots[Slot] - 1;
+
+        for (j = 0; j < Run; j++)
+            Analysis->Indices[i + j] = (UCHAR) Index;
+        Analysis->RunBytes += 1 + VarintSize(Run - 1);
+    }
+}
+
+static SIZE_T
+PalettePackedSize(
+    __in CONST TILE_ANALYSIS *  Analysis,
+    __in UINT                   Width,
+    __in UINT                   Height
+    )
+{
+    UINT CONST  Bits = (Analysis->NumColors <= 2) ? 1 : (Analysis->NumColors <= 4) ? 2 : 4;
+
+    return 1 + Analysis->NumColors * 4 + (SIZE_T) Height * ((Width * Bits + 7) / 8);
+}
+
+static SIZE_T
+WritePalette(
+    __in CONST TILE_ANALYSIS *  Analysis,
+    __out UCHAR *               Output
+    )
+{
+    UINT    i;
+
+    Output[0] = (UCHAR) (Analysis->NumColors - 1);
+    for (i = 0; i < Analysis->NumColors; i++)
+        PutUlong(Output + 1 + i * 4, Analysis->Palette[i]);
+    return 1 + Analysis->NumColors * 4;
+}
+
+static SIZE_T
+WritePalettePacked(
+    __in CONST TILE_ANALYSIS *  Analysis,
+    __in UINT                   Width,
+    __in UINT                   Height,
+    __out UCHAR *               Output
+    )
+{
+    UINT CONST      Bits = (Analysis->NumColors <= 2) ? 1 : (Analysis->NumColors <= 4) ? 2 : 4;
+    CONST UCHAR *   pIndex = Analysis->Indices;
+    UCHAR *         p = Output + WritePalette(Analysis, Output);
+    UINT            Acc;
+    UINT            Filled;
+    UINT            x, y;
+
+    for (y = 0; y < Height; y++)
+    {
+        Acc = 0;
+        Filled = 0;
+        for (x = 0; x < Width; x++)
+        {
+            Acc = (Acc << Bits) | *pIndex++;
+            Filled += Bits;
+            if (Filled == 8)
+            {
+                *p++ = (UCHAR) Acc;
+                Acc = 0;
+                Filled = 0;
+            }
+        }
+        if (Filled != 0)
+            *p++ = (UCHAR) (Acc << (8 - Filled));
+    }
+    return p - Output;
+}
+
+static SIZE_T
+WritePaletteRle(
+    __in CONST TILE_ANALYSIS *  Analysis,
+    __in UINT                   NumPixels,
+    __out UCHAR *               Output
+    )
+{
+    CONST UCHAR *   Indices = Analysis->Indices;
+    UCHAR *         p = Output + WritePalette(Analysis, Output);
+    UINT            Run;
+    UINT            i;
+
+    /*
+     * runs of equal indices are runs of equal pixels, as analyzed.
+     */
+    for (i = 0; i < NumPixels; i += Run)
+    {
+        for (Run = 1; i + Run < NumPixels && Indices[i + Run] == Indices[i]; Run++)
+            ;
+        *p++ = Indices[i];
+        p = PutVarint(p, Run - 1);
+    }
+    return p - Output;
+}
+
+static UCHAR *
+PutLength(
+    __out UCHAR *       p,
+    __in UINT           Length
+    )
+{
+    while (Length >= 255)
+    {
+        *p++ = 255;
+        Length -= 255;
+    }
+    *p++ = (UCHAR) Length;
+    return p;
+}
+
+/*
+ * Room a sequence of Literals literals and a match needs at most.
+ */
+#define LZ_SEQUENCE_BYTES(Literals)     (1 + (Literals) / 255 + 1 + (Literals) * 4 + 2 + TILE_PIXELS / 255 + 1)
+
+static UCHAR *
+LzPutSequence(
+    __out UCHAR *           p,
+    __in CONST ULONG *      Literals,
+    __in UINT               NumLiterals,
+    __in UINT               Distance,
+    __in UINT               MatchLength
+    )
+{
+    UINT CONST  MatchCode = (Distance != 0) ? MatchLength - LJB_VMON_TILE_LZ_MIN_MATCH : 0;
+    UCHAR *     pToken = p++;
+
+    *pToken = (UCHAR) (((NumLiterals < 15) ? NumLiterals : 15) << 4 |
+                       ((MatchCode < 15) ? MatchCode : 15));
+    if (NumLiterals >= 15)
+        p = PutLength(p, NumLiterals - 15);
+    RtlCopyMemory(p, Literals, NumLiterals * 4);
+    p += NumLiterals * 4;
+
+    if (Distance != 0)
+    {
+        PutUshort(p, Distance);
+        p += 2;
+        if (MatchCode >= 15)
+            p = PutLength(p, MatchCode - 15);
+    }
+    return p;
+}
+
+static UINT
+LzMatchLength(
+    __in CONST ULONG *      Pixels,
+    __in UINT               Position,
+    __in UINT               Candidate,
+    __in UINT               NumPixels
+    )
+{
+    UINT    Length = 0;
+
+    while (Position + Length < NumPixels && Pixels[Position + Length] == Pixels[Candidate + Length])
+        Length++;
+    return Length;
+}
+
+/*
+ * Greedy LZ over the tile's pixels. Each position tries the pixel before
+ * (runs), the pixel above (content repeating down the tile) and the last
+ * position whose next two pixels hashed alike. Returns the payload size, or
+ * 0 if it would not be smaller than Limit.
+ */
+static SIZE_T
+WriteLz(
+    __in CONST ULONG *      Pixels,
+    __in UINT               Width,
+    __in UINT               NumPixels,
+    __in SIZE_T             Limit,
+    __out UCHAR *           Output
+    )
+{
+    USHORT          Table[1 << LZ_HASH_BITS];   // position + 1, 0 if free
+    UCHAR *         p = Output;
+    UINT            Anchor = 0;
+    UINT            Position = 0;
+    UINT            Candidates[3];
+    UINT            Best, BestLength;
+    UINT            Length;
+    UINT            Hash;
+    UINT            c;
+
+    RtlZeroMemory(Table, sizeof(Table));
+
+    while (Position + LJB_VMON_TILE_LZ_MIN_MATCH <= NumPixels)
+    {
+        Hash = (UINT) ((ULONG) ((Pixels[Position] * 0x9E3779B1UL) ^ (Pixels[Position + 1] * 0x85EBCA77UL)) >>
+                       (32 - LZ_HASH_BITS));
+        Candidates[0] = (Position >= 1) ? Position - 1 : Position;
+        Candidates[1] = (Position >= Width) ? Position - Width : Position;
+        Candidates[2] = (Table[Hash] != 0) ? Table[Hash] - 1u : Position;
+        Table[Hash] = (USHORT) (Position + 1);
+
+        Best = Position;
+        BestLength = 0;
+        for (c = 0; c < 3; c++)
+        {
+            if (Candidates[c] == Position)
+                continue;
+            Length = LzMatchLength(Pixels, Position, Candidates[c], NumPixels);
+            if (Length > BestLength)
+            {
+                Best = Candidates[c];
+                BestLength = Length;
+            }
+        }
+
+        if (BestLength < LJB_VMON_TILE_LZ_MIN_MATCH)
+        {
+            Position++;
+            continue;
+        }
+
+        if ((SIZE_T) (p - Output) + LZ_SEQUENCE_BYTES(Position - Anchor) >= Limit)
+            return 0;
+        p = LzPutSequence(p, Pixels + Anchor, Position - Anchor, Position - Best, BestLength);
+        Position += BestLength;
+        Anchor = Position;
+    }
+
+    if (Anchor < NumPixels)
+    {
+        if ((SIZE_T) (p - Output) + LZ_SEQUENCE_BYTES(NumPixels - Anchor) >= Limit)
+            return 0;
+        p = LzPutSequence(p, Pixels + Anchor, NumPixels - Anchor, 0, 0);
+    }
+    return p - Output;
+}
+
+/*
+ * Write the smallest lossless payload of a tile of more than one color.
+ * Returns its type.
+ */
+static UINT
+EncodeLossless(
+    __in CONST ULONG *              Tile,
+    __in CONST TILE_ANALYSIS *      Analysis,
+    __in UINT                       Width,
+    __in UINT                       Height,
+    __out UCHAR *                   Payload,
+    __out SIZE_T *                  pSize
+    )
+{
+    UINT CONST      NumPixels = Width * Height;
+    SIZE_T CONST    RawSize = (SIZE_T) NumPixels * 4;
+    SIZE_T          Size;
+    SIZE_T          PackedSize;
+    SIZE_T          RleSize;
+    SIZE_T          LzSize;
+    UINT            Type;
+
+    PackedSize = (Analysis->NumColors <= PALETTE_MAX_PACKED) ?
+        PalettePackedSize(Analysis, Width, Height) : RawSize;
+    RleSize = (Analysis->NumColors <= PALETTE_MAX_RLE) ?
+        1 + Analysis->NumColors * 4 + Analysis->RunBytes : RawSize;
+
+    Type = LJB_VMON_TILE_RAW;
+    Size = RawSize;
+    if (PackedSize < Size)
+    {
+        Type = LJB_VMON_TILE_PALETTE;
+        Size = PackedSize;
+    }
+    if (RleSize < Size)
+    {
+        Type = LJB_VMON_TILE_PALETTE_RLE;
+        Size = RleSize;
+    }
+
+    /*
+     * a palette at a byte per pixel or less is as good as LZ gets on such
+     * content; anything else tries LZ.
+     */
+    if (Size > NumPixels)
+    {
+        LzSize = WriteLz(Tile, Width, NumPixels, Size, Payload);
+        if (LzSize != 0)
+        {
+            Type = LJB_VMON_TILE_LZ;
+            Size = LzSize;
+        }
+    }
+
+    switch (Type)
+    {
+    case LJB_VMON_TILE_PALETTE:
+        Size = WritePalettePacked(Analysis, Width, Height, Payload);
+        break;
+    case LJB_VMON_TILE_PALETTE_RLE:
+        Size = WritePaletteRle(Analysis, NumPixels, Payload);
+        break;
+    case LJB_VMON_TILE_RAW:
+        RtlCopyMemory(Payload, Tile, RawSize);
+        break;
+    }
+
+    *pSize = Size;
+    return Type;
+}
+
+/*
+ * Name:  LJB_VMON_TileEncodeTile
+ *
+ * Definition:
+ *    SIZE_T
+ *    LJB_VMON_TileEncodeTile(
+ *        __in CONST LJB_VMON_TILE_ENCODER *    Encoder,
+ *        __in CONST VOID *                     Pixels,
+ *        __in UINT                             Pitch,
+ *        __in UINT                             Width,
+ *        __in UINT                             Height,
+ *        __in UINT                             Quality,
+ *        __out UCHAR *                         Output,
+ *        __inout_opt LJB_VMON_TILE_STATS *     Stats
+ *        );
+ *
+ * Description:
+ *    Encode one tile of Width x Height 32bpp pixels, Pitch bytes apart, at
+ *    most LJB_VMON_TILE_SIZE square, header included. Output has room for
+ *    LJB_VMON_TILE_MAX_BYTES(Width, Height) bytes. With a Quality (1 to
+ *    100), a tile of more than 256 colors goes out as DCT at that quality if
+ *    that is smaller than raw; with 0 the tile is lossless.
+ *
+ * Return Value:
+ *    Bytes written.
+ *
+ */
+SIZE_T
+LJB_VMON_TileEncodeTile(
+    __in CONST LJB_VMON_TILE_ENCODER *      Encoder,
+    __in CONST VOID *                       Pixels,
+    __in UINT                               Pitch,
+    __in UINT                               Width,
+    __in UINT                               Height,
+    __in UINT                               Quality,
+    __out UCHAR *                           Output,
+    __inout_opt LJB_VMON_TILE_STATS *       Stats
+    )
+{
+    UINT CONST      NumPixels = Width * Height;
+    ULONG           Tile[TILE_PIXELS];
+    TILE_ANALYSIS   Analysis;
+    UCHAR * CONST   Payload = Output + 4;
+    SIZE_T          Size;
+    UINT            Type;
+    UINT            y;
+
+    for (y = 0; y < Height; y++)
+    {
+        RtlCopyMemory(
+            Tile + y * Width,
+            (CONST UCHAR *) Pixels + (SIZE_T) y * Pitch,
+            Width * 4
+            );
+    }
+
+    AnalyzeTile(Tile, NumPixels, &Analysis);
+
+    if (Analysis.NumColors == 1)
+    {
+        Type = LJB_VMON_TILE_SOLID;
+        PutUlong(Payload, Tile[0]);
+        Size = 4;
+    }
+    else
+    {
+        Size = 0;
+        if (Quality != 0 && Analysis.NumColors > PALETTE_MAX_RLE)
+        {
+            Size = LJB_VMON_TileEncodeDct(
+                Encoder->UseSse2,
+                Tile,
+                Width,
+                Height,
+                Quality,
+                (SIZE_T) NumPixels * 4,
+                Payload
+                );
+        }
+        if (Size != 0)
+            Type = LJB_VMON_TILE_DCT;
+        else
+            Type = EncodeLossless(Tile, &Analysis, Width, Height, Payload, &Size);
+    }
+
+    PutUlong(Output, LJB_VMON_TILE_HEADER(Type, Size));
+    if (Stats != NULL)
+    {
+        Stats->Tiles[Type]++;
+        Stats->Pixels[Type] += NumPixels;
+        Stats->Bytes[Type] += 4 + Size;
+    }
+    return 4 + Size;
+}
+
+/*
+ * Deques. A worker codes the first tile of the oldest range in its own
+ * deque; with its deque empty, it steals the back half of the oldest range
+ * of another worker, keeps the first tile of it and puts the rest in its
+ * own deque. Unclaimed only drops when a tile is taken to be coded, so the
+ * tiles a thief holds on the way to its deque still count and nobody goes
+ * to sleep on them.
+ */
+static VOID
+LJB_VMON_TileLock(
+    __inout volatile LONG *                 Lock
+    )
+{
+    while (InterlockedExchange(Lock, 1) != 0)
+    {
+        while (*Lock != 0)
+            YieldProcessor();
+    }
+}
+
+static VOID
+LJB_VMON_TileUnlock(
+    __inout volatile LONG *                 Lock
+    )
+{
+    InterlockedExchange(Lock, 0);
+}
+
+static BOOLEAN
+LJB_VMON_TileClaim(
+    __inout LJB_VMON_TILE_WORKER *          Worker,
+    __out UINT *                            Frame,
+    __out UINT *                            Tile
+    )
+{
+    LJB_VMON_TILE_ENCODER * CONST   Encoder = Worker->Encoder;
+    LJB_VMON_TILE_WORKER *          Victim;
+    LJB_VMON_TILE_RANGE *           pRange;
+    LJB_VMON_TILE_RANGE             Stolen;
+    UINT                            i;
+
+    LJB_VMON_TileLock(&Worker->Lock);
+    if (Worker->NumRanges != 0)
+    {
+        pRange = &Worker->Ranges[0];
+        *Frame = pRange->Frame;
+        *Tile = pRange->FirstTile++;
+        if (--pRange->NumTiles == 0)
+        {
+            Worker->NumRanges--;
+            RtlMoveMemory(
+                &Worker->Ranges[0],
+                &Worker->Ranges[1],
+                Worker->NumRanges * sizeof(Worker->Ranges[0])
+                );
+        }
+        LJB_VMON_TileUnlock(&Worker->Lock);
+        InterlockedDecrement(&Encoder->Unclaimed);
+        return TRUE;
+    }
+    LJB_VMON_TileUnlock(&Worker->Lock);
+
+    Stolen.NumTiles = 0;
+    for (i = 1; i < Encoder->NumThreads && Stolen.NumTiles == 0; i++)
+    {
+        Victim = &Encoder->Workers[(Worker->Index + i) % Encoder->NumThreads];
+        if (Victim->NumRanges == 0)
+            continue;
+
+        LJB_VMON_TileLock(&Victim->Lock);
+        if (Victim->NumRanges != 0)
+        {
+            pRange = &Victim->Ranges[0];
+            Stolen.Frame = pRange->Frame;
+            Stolen.NumTiles = (pRange->NumTiles + 1) / 2;
+            pRange->NumTiles -= Stolen.NumTiles;
+            Stolen.FirstTile = pRange->FirstTile + pRange->NumTiles;
+            if (pRange->NumTiles == 0)
+            {
+                Victim->NumRanges--;
+                RtlMoveMemory(
+                    &Victim->Ranges[0],
+                    &Victim->Ranges[1],
+                    Victim->NumRanges * sizeof(Victim->Ranges[0])
+                    );
+            }
+        }
+        LJB_VMON_TileUnlock(&Victim->Lock);
+    }
+    if (Stolen.NumTiles == 0)
+        return FALSE;
+
+    Worker->TilesStolen += Stolen.NumTiles;
+    *Frame = Stolen.Frame;
+    *Tile = Stolen.FirstTile;
+    if (Stolen.NumTiles > 1)
+    {
+        /*
+         * frames submitted meanwhile are newer, the stolen range goes first.
+         */
+        Stolen.FirstTile++;
+        Stolen.NumTiles--;
+        LJB_VMON_TileLock(&Worker->Lock);
+        RtlMoveMemory(
+            &Worker->Ranges[1],
+            &Worker->Ranges[0],
+            Worker->NumRanges * sizeof(Worker->Ranges[0])
+            );
+        Worker->Ranges[0] = Stolen;
+        Worker->NumRanges++;
+        LJB_VMON_TileUnlock(&Worker->Lock);
+    }
+    InterlockedDecrement(&Encoder->Unclaimed);
+    return TRUE;
+}
+
+static VOID
+LJB_VMON_TileRun(
+    __inout LJB_VMON_TILE_WORKER *          Worker,
+    __in UINT                               FrameIndex,
+    __in UINT                               TileIndex
+    )
+{
+    LJB_VMON_TILE_ENCODER * CONST   Encoder = Worker->Encoder;
+    LJB_VMON_TILE_FRAME * CONST     Frame = &Encoder->Frames[FrameIndex];
+    LJB_VMON_TILE * CONST           pTile = &Frame->Tiles[TileIndex];
+    UCHAR * CONST                   pOutput = Frame->Output + pTile->Offset;
+
+    pTile->Size = (ULONG) LJB_VMON_TileEncodeTile(
+        Encoder,
+        (CONST UCHAR *) Frame->FrameBuffer +
+            (SIZE_T) pTile->Top * Frame->Pitch + (SIZE_T) pTile->Left * 4,
+        Frame->Pitch,
+        pTile->Width,
+        pTile->Height,
+        pTile->Video ? Frame->Quality : 0,
+        pOutput,
+        NULL
+        );
+    pTile->Type = (UCHAR) LJB_VMON_TILE_HEADER_TYPE(pOutput[0]);
+    Worker->TilesEncoded++;
+
+    if (InterlockedDecrement(&Frame->Remaining) == 0)
+        SetEvent(Frame->hDoneEvent);
+}
+
+static DWORD
+WINAPI
+LJB_VMON_TileWorkerThread(
+    __in LPVOID                             Context
+    )
+{
+    LJB_VMON_TILE_WORKER * CONST    Worker = Context;
+    LJB_VMON_TILE_ENCODER * CONST   Encoder = Worker->Encoder;
+    UINT                            Frame;
+    UINT                            Tile;
+
+    for (;;)
+    {
+        WaitForSingleObject(Worker->hStartEvent, INFINITE);
+        if (Encoder->Stop)
+            break;
+        while (Encoder->Unclaimed != 0)
+        {
+            if (LJB_VMON_TileClaim(Worker, &Frame, &Tile))
+                LJB_VMON_TileRun(Worker, Frame, Tile);
+            else
+                SwitchToThread();
+        }
+    }
+    return 0;
+}
+
+/*
+ * Name:  LJB_VMON_TileEncoderInit
+ *
+ * Definition:
+ *    __checkReturn
+ *    BOOLEAN
+ *    LJB_VMON_TileEncoderInit(
+ *        __out LJB_VMON_TILE_ENCODER *     Encoder,
+ *        __in UINT                         NumThreads
+ *        );
+ *
+ * Description:
+ *    Initialize an encoder that codes frames on NumThreads threads, the
+ *    calling thread included; 0 means one per processor. Up to
+ *    LJB_VMON_TILE_ENCODER_MAX_THREADS. On failure, the caller still calls
+ *    LJB_VMON_TileEncoderDeInit.
+ *
+ * Return Value:
+ *    TRUE on success, FALSE if threads or events could not be created.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_TileEncoderInit(
+    __out LJB_VMON_TILE_ENCODER *           Encoder,
+    __in UINT                               NumThreads
+    )
+{
+    LJB_VMON_TILE_WORKER *  Worker;
+    SYSTEM_INFO             SystemInfo;
+    UINT                    i;
+
+    RtlZeroMemory(Encoder, sizeof(*Encoder));
+    for (i = 0; i < LJB_VMON_TILE_ENCODER_MAX_FRAMES; i++)
+    {
+        Encoder->Frames[i].hDoneEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (Encoder->Frames[i].hDoneEvent == NULL)
+            return FALSE;
+    }
+#if defined(_M_X64) || defined(__SSE2__)
+    Encoder->UseSse2 = TRUE;
+#elif defined(_M_IX86)
+    Encoder->UseSse2 = (BOOLEAN) IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+#endif
+    if (NumThreads == 0)
+    {
+        GetSystemInfo(&SystemInfo);
+        NumThreads = SystemInfo.dwNumberOfProcessors;
+    }
+    if (NumThreads == 0)
+        NumThreads = 1;
+    if (NumThreads > LJB_VMON_TILE_ENCODER_MAX_THREADS)
+        NumThreads = LJB_VMON_TILE_ENCODER_MAX_THREADS;
+
+    Encoder->Workers[0].Encoder = Encoder;
+    Encoder->NumThreads = 1;
+    for (i = 1; i < NumThreads; i++)
+    {
+        Worker = &Encoder->Workers[i];
+        Worker->Encoder = Encoder;
+        Worker->Index = i;
+        Worker->hStartEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (Worker->hStartEvent == NULL)
+            return FALSE;
+
+        Worker->hThread = CreateThread(
+            NULL,
+            0,
+            &LJB_VMON_TileWorkerThread,
+            Worker,
+            0,
+            NULL
+            );
+        if (Worker->hThread == NULL)
+            return FALSE;
+        Encoder->NumThreads++;
+    }
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_TileEncoderDeInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_TileEncoderDeInit(
+ *        __inout LJB_VMON_TILE_ENCODER *   Encoder
+ *        );
+ *
+ * Description:
+ *    Stop the encoder threads and free the buffers. Frames still in flight
+ *    are dropped.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_TileEncoderDeInit(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder
+    )
+{
+    LJB_VMON_TILE_WORKER *  Worker;
+    LJB_VMON_TILE_FRAME *   Frame;
+    UINT                    i;
+
+    InterlockedExchange(&Encoder->Stop, 1);
+    for (i = 0; i < LJB_VMON_TILE_ENCODER_MAX_THREADS; i++)
+    {
+        Worker = &Encoder->Workers[i];
+        if (Worker->hThread != NULL)
+        {
+            SetEvent(Worker->hStartEvent);
+            WaitForSingleObject(Worker->hThread, INFINITE);
+            CloseHandle(Worker->hThread);
+        }
+        if (Worker->hStartEvent != NULL)
+            CloseHandle(Worker->hStartEvent);
+    }
+    for (i = 0; i < LJB_VMON_TILE_ENCODER_MAX_FRAMES; i++)
+    {
+        Frame = &Encoder->Frames[i];
+        if (Frame->hDoneEvent != NULL)
+            CloseHandle(Frame->hDoneEvent);
+        if (Frame->Tiles != NULL)
+            HeapFree(GetProcessHeap(), 0, Frame->Tiles);
+        if (Frame->Output != NULL)
+            HeapFree(GetProcessHeap(), 0, Frame->Output);
+    }
+    if (Encoder->Cells != NULL)
+        HeapFree(GetProcessHeap(), 0, Encoder->Cells);
+    RtlZeroMemory(Encoder, sizeof(*Encoder));
+}
+
+/*
+ * Name:  LJB_VMON_TileEncoderSetLossy
+ *
+ * Definition:
+ *    __checkReturn
+ *    BOOLEAN
+ *    LJB_VMON_TileEncoderSetLossy(
+ *        __inout LJB_VMON_TILE_ENCODER *   Encoder,
+ *        __in UINT                         Width,
+ *        __in UINT                         Height,
+ *        __in UINT                         Quality
+ *        );
+ *
+ * Description:
+ *    Let tiles of video regions of a Width x Height frame go out lossy at
+ *    Quality (1 to 100), or keep everything lossless with 0. Forgets the
+ *    change history; call again on every mode change, after which the
+ *    receiver is expected to get the whole frame.
+ *
+ * Return Value:
+ *    TRUE on success, FALSE if out of memory (the encoder is then lossless).
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_TileEncoderSetLossy(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder,
+    __in UINT                               Width,
+    __in UINT                               Height,
+    __in UINT                               Quality
+    )
+{
+    UINT CONST  CellCols = (Width + LJB_VMON_TILE_SIZE - 1) / LJB_VMON_TILE_SIZE;
+    UINT CONST  CellRows = (Height + LJB_VMON_TILE_SIZE - 1) / LJB_VMON_TILE_SIZE;
+
+    Encoder->Quality = 0;
+    if (Quality == 0 || CellCols == 0 || CellRows == 0)
+        return TRUE;
+
+    if (Encoder->MaxCells < CellCols * CellRows)
+    {
+        if (Encoder->Cells != NULL)
+            HeapFree(GetProcessHeap(), 0, Encoder->Cells);
+        Encoder->MaxCells = 0;
+        Encoder->Cells = HeapAlloc(
+            GetProcessHeap(),
+            0,
+            CellCols * CellRows * sizeof(LJB_VMON_TILE_CELL)
+            );
+        if (Encoder->Cells == NULL)
+            return FALSE;
+        Encoder->MaxCells = CellCols * CellRows;
+    }
+    RtlZeroMemory(Encoder->Cells, CellCols * CellRows * sizeof(LJB_VMON_TILE_CELL));
+
+    Encoder->Width = Width;
+    Encoder->Height = Height;
+    Encoder->CellCols = CellCols;
+    Encoder->CellRows = CellRows;
+    Encoder->Quality = (Quality > 100) ? 100 : Quality;
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_TileEncoderAddRefresh
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_TileEncoderAddRefresh(
+ *        __inout LJB_VMON_TILE_ENCODER *   Encoder,
+ *        __inout LJB_VMON_DAMAGE *         Damage
+ *        );
+ *
+ * Description:
+ *    Add to Damage every cell sent lossy that has been still for
+ *    LJB_VMON_TILE_REFRESH_FRAMES frames, and count it as clean. The caller
+ *    encodes Damage with this encoder next; the cells are not classified as
+ *    video and go out lossless.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_TileEncoderAddRefresh(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder,
+    __inout LJB_VMON_DAMAGE *               Damage
+    )
+{
+    LJB_VMON_TILE_CELL *    pCell;
+    LJB_VMON_RECT           Rect;
+    UINT                    x, y;
+
+    if (Encoder->Quality == 0)
+        return;
+
+    for (y = 0; y < Encoder->CellRows; y++)
+    for (x = 0; x < Encoder->CellCols; x++)
+    {
+        pCell = &Encoder->Cells[y * Encoder->CellCols + x];
+        if (!pCell->Lossy ||
+            (pCell->Changes & ((1u << LJB_VMON_TILE_REFRESH_FRAMES) - 1)) != 0)
+            continue;
+
+        Rect.Left = x * LJB_VMON_TILE_SIZE;
+        Rect.Top = y * LJB_VMON_TILE_SIZE;
+        Rect.Right = (Rect.Left + LJB_VMON_TILE_SIZE < (LONG) Encoder->Width) ?
+            Rect.Left + LJB_VMON_TILE_SIZE : (LONG) Encoder->Width;
+        Rect.Bottom = (Rect.Top + LJB_VMON_TILE_SIZE < (LONG) Encoder->Height) ?
+            Rect.Top + LJB_VMON_TILE_SIZE : (LONG) Encoder->Height;
+        LJB_VMON_DamageAddRect(Damage, &Rect);
+        pCell->Lossy = FALSE;
+    }
+}
+
+/*
+ * Name:  LJB_VMON_TileEncoderTrim
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_TileEncoderTrim(
+ *        __inout LJB_VMON_TILE_ENCODER *   Encoder
+ *        );
+ *
+ * Description:
+ *    Free the buffers frames are coded into, for while nothing is encoded
+ *    for a long time. The threads stay, idle on their start events, and so
+ *    does the change history of the lossy path, which is small: the
+ *    receiver keeps its frame, and what comes next is coded against it. No
+ *    frame may be in flight, and the stream last completed is no longer
+ *    valid. The buffers come back with the next frame submitted.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_TileEncoderTrim(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder
+    )
+{
+    LJB_VMON_TILE_FRAME *   Frame;
+    UINT                    i;
+
+    if (Encoder->NumFrames != 0)
+        return;
+
+    for (i = 0; i < LJB_VMON_TILE_ENCODER_MAX_FRAMES; i++)
+    {
+        Frame = &Encoder->Frames[i];
+        if (Frame->Tiles != NULL)
+            HeapFree(GetProcessHeap(), 0, Frame->Tiles);
+        if (Frame->Output != NULL)
+            HeapFree(GetProcessHeap(), 0, Frame->Output);
+        Frame->Tiles = NULL;
+        Frame->MaxTiles = 0;
+        Frame->NumTiles = 0;
+        Frame->Output = NULL;
+        Frame->MaxOutput = 0;
+    }
+}
+
+/*
+ * The cell holding the center of a tile. Tiles are cut from damage
+ * rectangles and need not line up with cells.
+ */
+static LJB_VMON_TILE_CELL *
+LJB_VMON_TileCell(
+    __in CONST LJB_VMON_TILE_ENCODER *      Encoder,
+    __in CONST LJB_VMON_TILE *              Tile
+    )
+{
+    UINT    x = (UINT) (Tile->Left + Tile->Width / 2) / LJB_VMON_TILE_SIZE;
+    UINT    y = (UINT) (Tile->Top + Tile->Height / 2) / LJB_VMON_TILE_SIZE;
+
+    x = (x < Encoder->CellCols) ? x : Encoder->CellCols - 1;
+    y = (y < Encoder->CellRows) ? y : Encoder->CellRows - 1;
+    return &Encoder->Cells[y * Encoder->CellCols + x];
+}
+
+static UINT
+LJB_VMON_TileBitCount(
+    __in ULONG                              Bits
+    )
+{
+    UINT    Count = 0;
+
+    for (; Bits != 0; Bits &= Bits - 1)
+        Count++;
+    return Count;
+}
+
+/*
+ * Age the change history of every cell, record the cells the tiles of a
+ * new frame fall in and classify the tiles.
+ */
+static VOID
+LJB_VMON_TileClassify(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder,
+    __inout LJB_VMON_TILE_FRAME *           Frame
+    )
+{
+    LJB_VMON_TILE_CELL *    pCell;
+    UINT                    i;
+
+    for (i = 0; i < Encoder->CellCols * Encoder->CellRows; i++)
+        Encoder->Cells[i].Changes <<= 1;
+
+    for (i = 0; i < Frame->NumTiles; i++)
+        LJB_VMON_TileCell(Encoder, &Frame->Tiles[i])->Changes |= 1;
+
+    for (i = 0; i < Frame->NumTiles; i++)
+    {
+        pCell = LJB_VMON_TileCell(Encoder, &Frame->Tiles[i]);
+        Frame->Tiles[i].Video =
+            (pCell->Changes & 2) != 0 &&
+            LJB_VMON_TileBitCount(pCell->Changes) >= LJB_VMON_TILE_VIDEO_CHANGES;
+    }
+}
+
+/*
+ * Mark every cell a lossy tile of a completed frame overlaps.
+ */
+static VOID
+LJB_VMON_TileMarkLossy(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder,
+    __in CONST LJB_VMON_TILE_FRAME *        Frame
+    )
+{
+    CONST LJB_VMON_TILE *   pTile;
+    UINT                    Left, Top, Right, Bottom;
+    UINT                    i, x, y;
+
+    for (i = 0; i < Frame->NumTiles; i++)
+    {
+        pTile = &Frame->Tiles[i];
+        if (pTile->Type != LJB_VMON_TILE_DCT)
+            continue;
+
+        Left = (UINT) pTile->Left / LJB_VMON_TILE_SIZE;
+        Top = (UINT) pTile->Top / LJB_VMON_TILE_SIZE;
+        Right = ((UINT) pTile->Left + pTile->Width - 1) / LJB_VMON_TILE_SIZE;
+        Bottom = ((UINT) pTile->Top + pTile->Height - 1) / LJB_VMON_TILE_SIZE;
+        Right = (Right < Encoder->CellCols) ? Right : Encoder->CellCols - 1;
+        Bottom = (Bottom < Encoder->CellRows) ? Bottom : Encoder->CellRows - 1;
+        for (y = Top; y <= Bottom; y++)
+        for (x = Left; x <= Right; x++)
+            Encoder->Cells[y * Encoder->CellCols + x].Lossy = TRUE;
+    }
+}
+
+static BOOLEAN
+LJB_VMON_TileReserve(
+    __inout PVOID *                         Buffer,
+    __inout SIZE_T *                        MaxSize,
+    __in SIZE_T                             Size
+    )
+{
+    if (*MaxSize >= Size)
+        return TRUE;
+    if (*Buffer != NULL)
+        HeapFree(GetProcessHeap(), 0, *Buffer);
+    *MaxSize = 0;
+    *Buffer = HeapAlloc(GetProcessHeap(), 0, Size);
+    if (*Buffer == NULL)
+        return FALSE;
+    *MaxSize = Size;
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_TileEncoderSubmit
+ *
+ * Definition:
+ *    __checkReturn
+ *    BOOLEAN
+ *    LJB_VMON_TileEncoderSubmit(
+ *        __inout LJB_VMON_TILE_ENCODER *   Encoder,
+ *        __in CONST VOID *                 FrameBuffer,
+ *        __in UINT                         Pitch,
+ *        __in CONST LJB_VMON_RECT *        Rects,
+ *        __in UINT                         NumRects
+ *        );
+ *
+ * Description:
+ *    Start encoding the pixels of Rects, which lie within the 32bpp
+ *    FrameBuffer, as one tile stream, and return without waiting for it.
+ *    The pixels of Rects must not change until the frame is completed by
+ *    LJB_VMON_TileEncoderComplete, which returns frames in the order they
+ *    were submitted. Up to LJB_VMON_TILE_ENCODER_MAX_FRAMES frames may be in
+ *    flight. The stream last completed stays valid until this is called.
+ *    With the lossy path on, every frame is one frame of change history,
+ *    even one with no rectangles.
+ *
+ *    Submit and complete from one thread, the one that also calls
+ *    LJB_VMON_TileEncoderSetLossy and LJB_VMON_TileEncoderAddRefresh.
+ *
+ * Return Value:
+ *    TRUE on success. FALSE if out of memory or too many frames are in
+ *    flight; the frame is then not submitted.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_TileEncoderSubmit(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder,
+    __in CONST VOID *                       FrameBuffer,
+    __in UINT                               Pitch,
+    __in CONST LJB_VMON_RECT *              Rects,
+    __in UINT                               NumRects
+    )
+{
+    LJB_VMON_TILE_FRAME *   Frame;
+    LJB_VMON_TILE_WORKER *  Worker;
+    LJB_VMON_TILE *         pTile;
+    LJB_VMON_TILE_RANGE     Range;
+    SIZE_T                  Share;
+    SIZE_T                  Pixels;
+    SIZE_T                  TotalPixels;
+    SIZE_T                  OutputSize;
+    UINT                    FrameIndex;
+    UINT                    NumTiles;
+    UINT                    MaxTiles;
+    UINT                    r, i, t;
+    LONG                    x, y;
+
+    if (Encoder->NumFrames == LJB_VMON_TILE_ENCODER_MAX_FRAMES)
+        return FALSE;
+    FrameIndex = (Encoder->FirstFrame + Encoder->NumFrames) % LJB_VMON_TILE_ENCODER_MAX_FRAMES;
+    Frame = &Encoder->Frames[FrameIndex];
+
+    NumTiles = 0;
+    for (r = 0; r < NumRects; r++)
+    {
+        NumTiles +=
+            ((Rects[r].Right - Rects[r].Left + LJB_VMON_TILE_SIZE - 1) / LJB_VMON_TILE_SIZE) *
+            ((Rects[r].Bottom - Rects[r].Top + LJB_VMON_TILE_SIZE - 1) / LJB_VMON_TILE_SIZE);
+    }
+    if (Frame->MaxTiles < NumTiles)
+    {
+        if (Frame->Tiles != NULL)
+            HeapFree(GetProcessHeap(), 0, Frame->Tiles);
+        MaxTiles = NumTiles;
+        Frame->MaxTiles = 0;
+        Frame->Tiles = HeapAlloc(GetProcessHeap(), 0, MaxTiles * sizeof(LJB_VMON_TILE));
+        if (Frame->Tiles == NULL)
+            return FALSE;
+        Frame->MaxTiles = MaxTiles;
+    }
+
+    /*
+     * every tile gets room for its largest encoding, the stream is
+     * compacted at completion.
+     */
+    TotalPixels = 0;
+    OutputSize = 0;
+    pTile = Frame->Tiles;
+    for (r = 0; r < NumRects; r++)
+    {
+        for (y = Rects[r].Top; y < Rects[r].Bottom; y += LJB_VMON_TILE_SIZE)
+        for (x = Rects[r].Left; x < Rects[r].Right; x += LJB_VMON_TILE_SIZE)
+        {
+            pTile->Left = x;
+            pTile->Top = y;
+            pTile->Width = (UINT) ((Rects[r].Right - x < LJB_VMON_TILE_SIZE) ?
+                Rects[r].Right - x : LJB_VMON_TILE_SIZE);
+            pTile->Height = (UINT) ((Rects[r].Bottom - y < LJB_VMON_TILE_SIZE) ?
+                Rects[r].Bottom - y : LJB_VMON_TILE_SIZE);
+            pTile->Video = FALSE;
+            pTile->Offset = OutputSize;
+            TotalPixels += (SIZE_T) pTile->Width * pTile->Height;
+            OutputSize += LJB_VMON_TILE_MAX_BYTES(pTile->Width, pTile->Height);
+            pTile++;
+        }
+    }
+    if (!LJB_VMON_TileReserve((PVOID *) &Frame->Output, &Frame->MaxOutput, OutputSize))
+        return FALSE;
+
+    Frame->FrameBuffer = FrameBuffer;
+    Frame->Pitch = Pitch;
+    Frame->NumTiles = NumTiles;
+    Frame->Quality = Encoder->Quality;
+    if (Frame->Quality != 0)
+        LJB_VMON_TileClassify(Encoder, Frame);
+
+    Frame->Remaining = (LONG) NumTiles;
+    ResetEvent(Frame->hDoneEvent);
+    Encoder->NumFrames++;
+    if (NumTiles == 0)
+        return TRUE;
+
+    /*
+     * contiguous ranges of about the same number of pixels, one per worker.
+     * Unclaimed goes up first so that no worker can take it below zero.
+     */
+    InterlockedExchangeAdd(&Encoder->Unclaimed, (LONG) NumTiles);
+    t = 0;
+    Pixels = 0;
+    for (i = 0; i < Encoder->NumThreads; i++)
+    {
+        Worker = &Encoder->Workers[i];
+        Range.Frame = FrameIndex;
+        Range.FirstTile = t;
+        Share = TotalPixels * (i + 1) / Encoder->NumThreads;
+        while (t < NumTiles && (Pixels < Share || i + 1 == Encoder->NumThreads))
+        {
+            Pixels += (SIZE_T) Frame->Tiles[t].Width * Frame->Tiles[t].Height;
+            t++;
+        }
+        Range.NumTiles = t - Range.FirstTile;
+        if (Range.NumTiles == 0)
+            continue;
+
+        LJB_VMON_TileLock(&Worker->Lock);
+        Worker->Ranges[Worker->NumRanges++] = Range;
+        LJB_VMON_TileUnlock(&Worker->Lock);
+    }
+
+    for (i = 1; i < Encoder->NumThreads; i++)
+        SetEvent(Encoder->Workers[i].hStartEvent);
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_TileEncoderComplete
+ *
+ * Definition:
+ *    __checkReturn
+ *    BOOLEAN
+ *    LJB_VMON_TileEncoderComplete(
+ *        __inout LJB_VMON_TILE_ENCODER *   Encoder,
+ *        __out CONST UCHAR **              Data,
+ *        __out SIZE_T *                    DataSize
+ *        );
+ *
+ * Description:
+ *    Wait for the oldest frame in flight, coding tiles on the calling
+ *    thread meanwhile, and assemble its stream. The stream stays in the
+ *    encoder until the next LJB_VMON_TileEncoderSubmit.
+ *
+ * Return Value:
+ *    TRUE on success, FALSE if no frame is in flight.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_TileEncoderComplete(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder,
+    __out CONST UCHAR **                    Data,
+    __out SIZE_T *                          DataSize
+    )
+{
+    LJB_VMON_TILE_FRAME *   Frame;
+    CONST LJB_VMON_TILE *   pTile;
+    SIZE_T                  Size;
+    UINT                    FrameIndex;
+    UINT                    TileIndex;
+    UINT                    t;
+
+    *Data = NULL;
+    *DataSize = 0;
+    if (Encoder->NumFrames == 0)
+        return FALSE;
+    Frame = &Encoder->Frames[Encoder->FirstFrame];
+
+    /*
+     * the done event may be left over from a frame before, only Remaining
+     * says when this one is done; read it interlocked, the tiles are the
+     * workers' until then.
+     */
+    while (InterlockedCompareExchange(&Frame->Remaining, 0, 0) != 0)
+    {
+        if (LJB_VMON_TileClaim(&Encoder->Workers[0], &FrameIndex, &TileIndex))
+            LJB_VMON_TileRun(&Encoder->Workers[0], FrameIndex, TileIndex);
+        else if (Encoder->Unclaimed != 0)
+            SwitchToThread();
+        else
+            WaitForSingleObject(Frame->hDoneEvent, INFINITE);
+    }
+
+    Size = 0;
+    for (t = 0; t < Frame->NumTiles; t++)
+    {
+        pTile = &Frame->Tiles[t];
+        if (pTile->Offset != Size)
+            RtlMoveMemory(Frame->Output + Size, Frame->Output + pTile->Offset, pTile->Size);
+        Size += pTile->Size;
+
+        Encoder->Stats.Tiles[pTile->Type]++;
+        Encoder->Stats.Pixels[pTile->Type] += (ULONG64) pTile->Width * pTile->Height;
+        Encoder->Stats.Bytes[pTile->Type] += pTile->Size;
+    }
+
+    if (Frame->Quality != 0 && Encoder->Quality != 0)
+        LJB_VMON_TileMarkLossy(Encoder, Frame);
+
+    Encoder->FirstFrame = (Encoder->FirstFrame + 1) % LJB_VMON_TILE_ENCODER_MAX_FRAMES;
+    Encoder->NumFrames--;
+    *Data = Frame->Output;
+    *DataSize = Size;
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_TileEncode
+ *
+ * Definition:
+ *    __checkReturn
+ *    BOOLEAN
+ *    LJB_VMON_TileEncode(
+ *        __inout LJB_VMON_TILE_ENCODER *   Encoder,
+ *        __in CONST VOID *                 FrameBuffer,
+ *        __in UINT                         Pitch,
+ *        __in CONST LJB_VMON_RECT *        Rects,
+ *        __in UINT                         NumRects,
+ *        __out CONST UCHAR **              Data,
+ *        __out SIZE_T *                    DataSize
+ *        );
+ *
+ * Description:
+ *    Submit a frame and complete it, for callers that do not overlap
+ *    frames; no other frame may be in flight. The stream stays in the
+ *    encoder until the next call.
+ *
+ * Return Value:
+ *    TRUE on success, FALSE if out of memory.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_TileEncode(
+    __inout LJB_VMON_TILE_ENCODER *         Encoder,
+    __in CONST VOID *                       FrameBuffer,
+    __in UINT                               Pitch,
+    __in CONST LJB_VMON_RECT *              Rects,
+    __in UINT                               NumRects,
+    __out CONST UCHAR **                    Data,
+    __out SIZE_T *                          DataSize
+    )
+{
+    *Data = NULL;
+    *DataSize = 0;
+    if (Encoder->NumFrames != 0 ||
+        !LJB_VMON_TileEncoderSubmit(Encoder, FrameBuffer, Pitch, Rects, NumRects))
+        return FALSE;
+    return LJB_VMON_TileEncoderComplete(Encoder, Data, DataSize);
+}
@@ -0,0 +1,217 @@
+/*!
+    \file       ljb_vmon_usb.h
+    \brief      USB bulk sink of the VMON capture loop
+    \details    The USB sink packs what the VMON thread reports into bulk
+                OUT transfers in the stream format of ljb_vmon_usbproto.h.
+                Every transfer is TransferSize bytes, a multiple of the
+                endpoint's packet size, but the last of a frame, which is
+                padded to whole packets. Up to Depth transfers are in flight
+                while the next one fills; buffers come from a pool of
+                Depth + 1 that completions return to. With all of them out
+                the VMON thread waits for a completion.
+
+                With Credits set, the sink also tells the VMON thread to hold
+                off, through the flow control of ljb_vmon_sink.h, while that
+                many frames are on their way: a frame is on its way from the
+                time it is handed over until the transfer that ends it
+                completes. The VMON thread then never waits on the link, and
+                the screen changes it skips meanwhile go as one frame later.
+
+                The sink sees the endpoint as an LJB_VMON_USB_ENDPOINT, a
+                submit call and a completion callback, the way a WinUSB
+                overlapped write or a URB would behave. There is no USB
+                device in this tree; the loopback endpoint stands in for one:
+                a thread that carries transfers at a set bandwidth, completes
+                each a set latency after its last byte, and rebuilds frames
+                from the stream with the receiver of ljb_vmon_net.h, so that
+                queue depth and transfer size can be tuned without hardware.
+ */
+
+#ifndef _LJB_VMON_USB_H_
+#define _LJB_VMON_USB_H_
+
+#include <windows.h>
+#include "ljb_vmon_usbproto.h"
+#include "ljb_vmon_net.h"
+
+#define LJB_VMON_USB_MAX_DEPTH              16
+#define LJB_VMON_USB_DEFAULT_TRANSFER_SIZE  (64 * 1024)
+
+typedef struct _LJB_VMON_USB_TRANSFER
+{
+    UCHAR *                             Buffer;
+    ULONG                               Size;       // bytes to send
+    BOOLEAN                             EndsFrame;  // the last of a frame
+    struct _LJB_VMON_USB_TRANSFER *     Next;       // in the free list
+} LJB_VMON_USB_TRANSFER;
+
+/*
+ * Queue Transfer on the endpoint; FALSE if it cannot be, and then it never
+ * completes. Called on the VMON thread.
+ */
+typedef BOOLEAN
+LJB_VMON_USB_SUBMIT(
+    __in PVOID                          EndpointContext,
+    __in LJB_VMON_USB_TRANSFER *        Transfer
+    );
+
+/*
+ * Transfer is done with, sent or not. Called on any thread, once per
+ * transfer submitted, in the order they were.
+ */
+typedef VOID
+LJB_VMON_USB_COMPLETE(
+    __in PVOID                          CompletionContext,
+    __in LJB_VMON_USB_TRANSFER *        Transfer,
+    __in BOOLEAN                        Success
+    );
+
+typedef struct _LJB_VMON_USB_ENDPOINT
+{
+    PVOID                       EndpointContext;
+    LJB_VMON_USB_SUBMIT *       pfnSubmit;
+    ULONG                       MaxPacketSize;      // wMaxPacketSize
+
+    /*
+     * set by LJB_VMON_UsbSinkInit
+     */
+    PVOID                       CompletionContext;
+    LJB_VMON_USB_COMPLETE *     pfnComplete;
+} LJB_VMON_USB_ENDPOINT;
+
+typedef struct _LJB_VMON_USB_SINK_STATS
+{
+    ULONG64             Frames;
+    ULONG64             FrameBytes;         // messages, headers included
+    ULONG64             PadBytes;           // PAD messages, headers included
+    ULONG64             Transfers;
+    ULONG64             Packets;
+    ULONG64             Waits;              // for a transfer to complete
+    ULONG64             WaitTime;           // microseconds
+    ULONG64             DroppedFrames;      // the endpoint had failed
+} LJB_VMON_USB_SINK_STATS;
+
+typedef struct _LJB_VMON_USB_SINK
+{
+    LJB_VMON_USB_ENDPOINT *     Endpoint;
+    ULONG                       TransferSize;
+    UINT                        Depth;
+    BOOLEAN                     Tiles;          // ENCODING_TILE rather than RAW
+    UINT                        Quality;        // of video regions, 0 lossless
+    UINT                        Credits;        // frames on their way at most, 0 no flow control
+    LJB_VMON_TILE_ENCODER       TileEncoder;
+    UINT                        Width;          // of the last frame sent
+    UINT                        Height;
+    ULONG                       Rotation;
+
+    /*
+     * the pool; FreeList under Lock, the rest on the VMON thread
+     */
+    LJB_VMON_USB_TRANSFER       Transfers[LJB_VMON_USB_MAX_DEPTH + 1];
+    UINT                        NumTransfers;
+    volatile LONG               Lock;
+    LJB_VMON_USB_TRANSFER *     FreeList;
+    volatile LONG               InFlight;
+    volatile LONG               Failed;         // a transfer did not go
+    HANDLE                      hCompleteEvent;
+    LJB_VMON_USB_TRANSFER *     Current;        // being filled, or NULL
+    volatile LONG               FramesInFlight;
+    HANDLE                      hCreditEvent;
+
+    LJB_VMON_USB_SINK_STATS     Stats;
+} LJB_VMON_USB_SINK;
+
+typedef struct _LJB_VMON_USB_LOOPBACK_STATS
+{
+    ULONG64             Transfers;
+    ULONG64             Bytes;
+    ULONG64             BusyTime;           // microseconds the bus carried data
+    ULONG64             Frames;             // rebuilt
+    ULONG64             LatencySum;         // microseconds, send to rebuilt
+    ULONG               LatencyMax;
+} LJB_VMON_USB_LOOPBACK_STATS;
+
+typedef struct _LJB_VMON_USB_LOOPBACK_PENDING
+{
+    LJB_VMON_USB_TRANSFER *     Transfer;
+    ULONG                       Due;            // LJB_VMON_NetMicroseconds
+} LJB_VMON_USB_LOOPBACK_PENDING;
+
+typedef struct _LJB_VMON_USB_LOOPBACK
+{
+    LJB_VMON_USB_ENDPOINT           Endpoint;
+    ULONG                           Bandwidth;      // bytes per second
+    ULONG                           Latency;        // microseconds, last byte to completion
+
+    HANDLE                          hThread;
+    HANDLE                          hWorkEvent;
+    volatile LONG                   Stop;
+
+    /*
+     * submitted, not yet on the bus; under Lock
+     */
+    volatile LONG                   Lock;
+    LJB_VMON_USB_TRANSFER *         Queue[LJB_VMON_USB_MAX_DEPTH];
+    UINT                            QueueHead;
+    UINT                            QueueCount;
+
+    /*
+     * the rest on the loopback thread
+     */
+    LJB_VMON_USB_TRANSFER *         OnBus;
+    ULONG                           BusFree;        // when the bus is done with OnBus
+    LJB_VMON_USB_LOOPBACK_PENDING   Pending[LJB_VMON_USB_MAX_DEPTH];
+    UINT                            NumPending;
+
+    /*
+     * the device: the message being put together and what it shows. Once
+     * the stream breaks the protocol, Broken is set and the rest ignored.
+     */
+    LJB_VMON_NET_RECEIVER           Device;
+    UCHAR *                         Message;
+    SIZE_T                          MaxMessage;
+    SIZE_T                          MessageSize;    // bytes of it in
+    SIZE_T                          MessageNeed;    // bytes it takes, 0 until its header is in
+    volatile LONG                   Broken;
+
+    LJB_VMON_USB_LOOPBACK_STATS     Stats;
+} LJB_VMON_USB_LOOPBACK;
+
+__checkReturn
+BOOLEAN
+LJB_VMON_UsbSinkInit(
+    __out LJB_VMON_USB_SINK *           UsbSink,
+    __in LJB_VMON_USB_ENDPOINT *        Endpoint,
+    __in ULONG                          TransferSize,
+    __in UINT                           Depth,
+    __in BOOLEAN                        Tiles,
+    __in UINT                           Quality,
+    __in UINT                           Credits
+    );
+
+VOID
+LJB_VMON_UsbSinkDeInit(
+    __inout LJB_VMON_USB_SINK *         UsbSink
+    );
+
+VOID
+LJB_VMON_UsbSinkGetSink(
+    __in LJB_VMON_USB_SINK *            UsbSink,
+    __out LJB_VMON_SINK *               Sink
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_UsbLoopbackInit(
+    __out LJB_VMON_USB_LOOPBACK *       Loopback,
+    __in ULONG                          MaxPacketSize,
+    __in ULONG                          Bandwidth,
+    __in ULONG                          Latency
+    );
+
+VOID
+LJB_VMON_UsbLoopbackDeInit(
+    __inout LJB_VMON_USB_LOOPBACK *     Loopback
+    );
+
+#endif /* _LJB_VMON_USB_H_ */
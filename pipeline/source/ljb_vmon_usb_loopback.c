@@ -0,0 +1,375 @@
+#include "ljb_vmon_usb.h"
+
+static VOID
+LJB_VMON_UsbLoopbackLock(
+    __inout volatile LONG *             Lock
+    )
+{
+    while (InterlockedExchange(Lock, 1) != 0)
+    {
+        while (*Lock != 0)
+            YieldProcessor();
+    }
+}
+
+static VOID
+LJB_VMON_UsbLoopbackUnlock(
+    __inout volatile LONG *             Lock
+    )
+{
+    InterlockedExchange(Lock, 0);
+}
+
+static BOOLEAN
+LJB_VMON_UsbLoopbackSubmit(
+    __in PVOID                          EndpointContext,
+    __in LJB_VMON_USB_TRANSFER *        Transfer
+    )
+{
+    LJB_VMON_USB_LOOPBACK * CONST   Loopback = EndpointContext;
+    BOOLEAN                         Queued = FALSE;
+
+    LJB_VMON_UsbLoopbackLock(&Loopback->Lock);
+    if (Loopback->QueueCount < LJB_VMON_USB_MAX_DEPTH && !Loopback->Stop)
+    {
+        Loopback->Queue[(Loopback->QueueHead + Loopback->QueueCount) % LJB_VMON_USB_MAX_DEPTH] = Transfer;
+        Loopback->QueueCount++;
+        Queued = TRUE;
+    }
+    LJB_VMON_UsbLoopbackUnlock(&Loopback->Lock);
+    if (Queued)
+        SetEvent(Loopback->hWorkEvent);
+    return Queued;
+}
+
+/*
+ * A whole message is in: skip a PAD, have the receiver apply the rest.
+ */
+static BOOLEAN
+LJB_VMON_UsbLoopbackApply(
+    __inout LJB_VMON_USB_LOOPBACK *     Loopback
+    )
+{
+    LJB_VMON_NET_EVENT  Event;
+
+    if (Loopback->Message[0] == LJB_VMON_USB_TYPE_PAD)
+        return TRUE;
+    if (!LJB_VMON_NetReceiverApply(
+            &Loopback->Device,
+            Loopback->Message,
+            Loopback->MessageSize,
+            &Event))
+        return FALSE;
+    if (Event.Type == LJB_VMON_NET_EVENT_FRAME)
+    {
+        Loopback->Stats.Frames++;
+        Loopback->Stats.LatencySum += Event.Latency;
+        if (Event.Latency > Loopback->Stats.LatencyMax)
+            Loopback->Stats.LatencyMax = Event.Latency;
+    }
+    return TRUE;
+}
+
+/*
+ * What the device does with a transfer that came in: cut the stream into
+ * messages again. A message may start in one transfer and end in another.
+ */
+static BOOLEAN
+LJB_VMON_UsbLoopbackReceive(
+    __inout LJB_VMON_USB_LOOPBACK *     Loopback,
+    __in CONST UCHAR *                  Data,
+    __in SIZE_T                         Size
+    )
+{
+    LJB_VMON_NET_HEADER Header;
+    SIZE_T              MaxSize;
+    SIZE_T              Count;
+    UCHAR *             Message;
+
+    while (Size != 0)
+    {
+        Count = ((Loopback->MessageNeed != 0) ? Loopback->MessageNeed : sizeof(Header)) -
+                Loopback->MessageSize;
+        if (Count > Size)
+            Count = Size;
+        RtlCopyMemory(Loopback->Message + Loopback->MessageSize, Data, Count);
+        Loopback->MessageSize += Count;
+        Data += Count;
+        Size -= Count;
+
+        if (Loopback->MessageNeed == 0)
+        {
+            if (Loopback->MessageSize < sizeof(Header))
+                break;
+
+            /*
+             * a PAD is at most a packet and a header, a frame at most the
+             * tiles of the whole mode the device is in.
+             */
+            RtlCopyMemory(&Header, Loopback->Message, sizeof(Header));
+            switch (Header.Type)
+            {
+            case LJB_VMON_USB_TYPE_PAD:
+                MaxSize = Loopback->Endpoint.MaxPacketSize + sizeof(Header);
+                break;
+
+            case LJB_VMON_NET_TYPE_MODE_CHANGE:
+                MaxSize = sizeof(Header) + sizeof(LJB_VMON_NET_MODE_CHANGE);
+                break;
+
+            case LJB_VMON_NET_TYPE_FRAME:
+                MaxSize = LJB_VMON_NET_FRAME_HEAD_SIZE +
+                    LJB_VMON_TILE_MAX_BYTES(LJB_VMON_TILE_SIZE, LJB_VMON_TILE_SIZE) *
+                    ((Loopback->Device.Width + LJB_VMON_TILE_SIZE - 1) / LJB_VMON_TILE_SIZE) *
+                    ((Loopback->Device.Height + LJB_VMON_TILE_SIZE - 1) / LJB_VMON_TILE_SIZE);
+                break;
+
+            default:
+                return FALSE;
+            }
+            if (Header.Size > MaxSize - sizeof(Header))
+                return FALSE;
+            Loopback->MessageNeed = sizeof(Header) + Header.Size;
+            if (Loopback->MessageNeed > Loopback->MaxMessage)
+            {
+                Message = HeapAlloc(GetProcessHeap(), 0, Loopback->MessageNeed);
+                if (Message == NULL)
+                    return FALSE;
+                RtlCopyMemory(Message, Loopback->Message, sizeof(Header));
+                HeapFree(GetProcessHeap(), 0, Loopback->Message);
+                Loopback->Message = Message;
+                Loopback->MaxMessage = Loopback->MessageNeed;
+            }
+        }
+        if (Loopback->MessageSize == Loopback->MessageNeed)
+        {
+            if (!LJB_VMON_UsbLoopbackApply(Loopback))
+                return FALSE;
+            Loopback->MessageSize = 0;
+            Loopback->MessageNeed = 0;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * The bus: one transfer on it at a time, taking Size / Bandwidth; it lands
+ * on the device when its last byte does and completes Latency later, while
+ * the next one is already on the bus. A queue that runs dry leaves the bus
+ * idle.
+ */
+static DWORD
+WINAPI
+LJB_VMON_UsbLoopbackThread(
+    __in LPVOID                         Context
+    )
+{
+    LJB_VMON_USB_LOOPBACK * CONST   Loopback = Context;
+    LJB_VMON_USB_TRANSFER *         Transfer;
+    ULONG                           Now;
+    ULONG                           Next;
+    ULONG                           Duration;
+    LONG                            Wait;
+    BOOLEAN                         HasNext;
+
+    for (;;)
+    {
+        Now = LJB_VMON_NetMicroseconds();
+
+        if (Loopback->NumPending != 0 && (LONG) (Now - Loopback->Pending[0].Due) >= 0)
+        {
+            Transfer = Loopback->Pending[0].Transfer;
+            Loopback->NumPending--;
+            RtlMoveMemory(
+                &Loopback->Pending[0],
+                &Loopback->Pending[1],
+                Loopback->NumPending * sizeof(Loopback->Pending[0])
+                );
+            Loopback->Endpoint.pfnComplete(Loopback->Endpoint.CompletionContext, Transfer, TRUE);
+            continue;
+        }
+
+        if (Loopback->OnBus != NULL &&
+            (LONG) (Now - Loopback->BusFree) >= 0 &&
+            Loopback->NumPending < LJB_VMON_USB_MAX_DEPTH)
+        {
+            Transfer = Loopback->OnBus;
+            Loopback->OnBus = NULL;
+            if (!Loopback->Broken &&
+                !LJB_VMON_UsbLoopbackReceive(Loopback, Transfer->Buffer, Transfer->Size))
+                InterlockedExchange(&Loopback->Broken, 1);
+            Loopback->Pending[Loopback->NumPending].Transfer = Transfer;
+            Loopback->Pending[Loopback->NumPending].Due = Loopback->BusFree + Loopback->Latency;
+            Loopback->NumPending++;
+            continue;
+        }
+
+        if (Loopback->OnBus == NULL)
+        {
+            LJB_VMON_UsbLoopbackLock(&Loopback->Lock);
+            Transfer = NULL;
+            if (Loopback->QueueCount != 0)
+            {
+                Transfer = Loopback->Queue[Loopback->QueueHead];
+                Loopback->QueueHead = (Loopback->QueueHead + 1) % LJB_VMON_USB_MAX_DEPTH;
+                Loopback->QueueCount--;
+            }
+            LJB_VMON_UsbLoopbackUnlock(&Loopback->Lock);
+            if (Transfer != NULL)
+            {
+                Duration = (ULONG) ((ULONG64) Transfer->Size * 1000000 / Loopback->Bandwidth);
+                if ((LONG) (Now - Loopback->BusFree) > 0)
+                    Loopback->BusFree = Now;
+                Loopback->BusFree += Duration;
+                Loopback->OnBus = Transfer;
+                Loopback->Stats.Transfers++;
+                Loopback->Stats.Bytes += Transfer->Size;
+                Loopback->Stats.BusyTime += Duration;
+                continue;
+            }
+        }
+
+        if (Loopback->Stop &&
+            Loopback->OnBus == NULL &&
+            Loopback->NumPending == 0)
+            break;
+
+        /*
+         * sleep to the next thing due, coarsely, then yield the rest of
+         * the way; a submit wakes us up early.
+         */
+        HasNext = FALSE;
+        Next = 0;
+        if (Loopback->OnBus != NULL)
+        {
+            Next = Loopback->BusFree;
+            HasNext = TRUE;
+        }
+        if (Loopback->NumPending != 0 &&
+            (!HasNext || (LONG) (Loopback->Pending[0].Due - Next) < 0))
+        {
+            Next = Loopback->Pending[0].Due;
+            HasNext = TRUE;
+        }
+        if (!HasNext)
+        {
+            WaitForSingleObject(Loopback->hWorkEvent, INFINITE);
+            continue;
+        }
+        Wait = (LONG) (Next - Now);
+        if (Wait > 2000)
+            WaitForSingleObject(Loopback->hWorkEvent, (DWORD) (Wait / 1000 - 1));
+        else
+            SwitchToThread();
+    }
+    return 0;
+}
+
+/*
+ * Name:  LJB_VMON_UsbLoopbackInit
+ *
+ * Definition:
+ *    __checkReturn
+ *    BOOLEAN
+ *    LJB_VMON_UsbLoopbackInit(
+ *        __out LJB_VMON_USB_LOOPBACK * Loopback,
+ *        __in ULONG                    MaxPacketSize,
+ *        __in ULONG                    Bandwidth,
+ *        __in ULONG                    Latency
+ *        );
+ *
+ * Description:
+ *    Start a stand-in bulk OUT endpoint of MaxPacketSize byte packets that
+ *    carries Bandwidth bytes per second and completes a transfer Latency
+ *    microseconds after its last byte. Loopback->Endpoint is what to give
+ *    LJB_VMON_UsbSinkInit; Loopback->Device shows what the device rebuilt,
+ *    read it once the sink has nothing in flight.
+ *
+ * Return Value:
+ *    TRUE if running. FALSE otherwise; the caller still calls
+ *    LJB_VMON_UsbLoopbackDeInit.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_UsbLoopbackInit(
+    __out LJB_VMON_USB_LOOPBACK *       Loopback,
+    __in ULONG                          MaxPacketSize,
+    __in ULONG                          Bandwidth,
+    __in ULONG                          Latency
+    )
+{
+    RtlZeroMemory(Loopback, sizeof(*Loopback));
+    Loopback->Endpoint.EndpointContext = Loopback;
+    Loopback->Endpoint.pfnSubmit = &LJB_VMON_UsbLoopbackSubmit;
+    Loopback->Endpoint.MaxPacketSize = MaxPacketSize;
+    Loopback->Bandwidth = (Bandwidth != 0) ? Bandwidth : 1;
+    Loopback->Latency = Latency;
+    Loopback->BusFree = LJB_VMON_NetMicroseconds();
+
+    if (MaxPacketSize == 0)
+        return FALSE;
+    Loopback->Message = HeapAlloc(GetProcessHeap(), 0, sizeof(LJB_VMON_NET_HEADER));
+    if (Loopback->Message == NULL)
+        return FALSE;
+    Loopback->MaxMessage = sizeof(LJB_VMON_NET_HEADER);
+
+    Loopback->hWorkEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (Loopback->hWorkEvent == NULL)
+        return FALSE;
+    Loopback->hThread = CreateThread(
+        NULL,
+        0,
+        &LJB_VMON_UsbLoopbackThread,
+        Loopback,
+        0,
+        NULL
+        );
+    return (BOOLEAN) (Loopback->hThread != NULL);
+}
+
+/*
+ * Name:  LJB_VMON_UsbLoopbackDeInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_UsbLoopbackDeInit(
+ *        __inout LJB_VMON_USB_LOOPBACK *   Loopback
+ *        );
+ *
+ * Description:
+ *    Stop the endpoint and free the device. Call LJB_VMON_UsbSinkDeInit
+ *    first; a transfer still queued completes as failed.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_UsbLoopbackDeInit(
+    __inout LJB_VMON_USB_LOOPBACK *     Loopback
+    )
+{
+    LJB_VMON_USB_TRANSFER * Transfer;
+
+    if (Loopback->hThread != NULL)
+    {
+        InterlockedExchange(&Loopback->Stop, 1);
+        SetEvent(Loopback->hWorkEvent);
+        WaitForSingleObject(Loopback->hThread, INFINITE);
+        CloseHandle(Loopback->hThread);
+    }
+    while (Loopback->QueueCount != 0)
+    {
+        Transfer = Loopback->Queue[Loopback->QueueHead];
+        Loopback->QueueHead = (Loopback->QueueHead + 1) % LJB_VMON_USB_MAX_DEPTH;
+        Loopback->QueueCount--;
+        Loopback->Endpoint.pfnComplete(Loopback->Endpoint.CompletionContext, Transfer, FALSE);
+    }
+    if (Loopback->hWorkEvent != NULL)
+        CloseHandle(Loopback->hWorkEvent);
+    if (Loopback->Message != NULL)
+        HeapFree(GetProcessHeap(), 0, Loopback->Message);
+    LJB_VMON_NetReceiverDeInit(&Loopback->Device);
+    RtlZeroMemory(Loopback, sizeof(*Loopback));
+}
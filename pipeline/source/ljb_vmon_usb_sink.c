@@ -0,0 +1,601 @@
+#include "ljb_vmon_usb.h"
+
+static VOID
+LJB_VMON_UsbLock(
+    __inout volatile LONG *             Lock
+    )
+{
+    while (InterlockedExchange(Lock, 1) != 0)
+    {
+        while (*Lock != 0)
+            YieldProcessor();
+    }
+}
+
+static VOID
+LJB_VMON_UsbUnlock(
+    __inout volatile LONG *             Lock
+    )
+{
+    InterlockedExchange(Lock, 0);
+}
+
+static VOID
+LJB_VMON_UsbSinkComplete(
+    __in PVOID                          CompletionContext,
+    __in LJB_VMON_USB_TRANSFER *        Transfer,
+    __in BOOLEAN                        Success
+    )
+{
+    LJB_VMON_USB_SINK * CONST   UsbSink = CompletionContext;
+
+    if (!Success)
+        InterlockedExchange(&UsbSink->Failed, 1);
+    LJB_VMON_UsbLock(&UsbSink->Lock);
+    Transfer->Next = UsbSink->FreeList;
+    UsbSink->FreeList = Transfer;
+    LJB_VMON_UsbUnlock(&UsbSink->Lock);
+    InterlockedDecrement(&UsbSink->InFlight);
+    SetEvent(UsbSink->hCompleteEvent);
+    if (Transfer->EndsFrame)
+    {
+        InterlockedDecrement(&UsbSink->FramesInFlight);
+        SetEvent(UsbSink->hCreditEvent);
+    }
+}
+
+/*
+ * Wait for the next completion; the VMON thread is held up by the link.
+ */
+static VOID
+LJB_VMON_UsbSinkWait(
+    __inout LJB_VMON_USB_SINK *         UsbSink
+    )
+{
+    ULONG   Start;
+
+    Start = LJB_VMON_NetMicroseconds();
+    WaitForSingleObject(UsbSink->hCompleteEvent, INFINITE);
+    UsbSink->Stats.WaitTime += LJB_VMON_NetMicroseconds() - Start;
+}
+
+/*
+ * Hand Current to the endpoint once fewer than Depth transfers are out.
+ */
+static BOOLEAN
+LJB_VMON_UsbSinkSubmit(
+    __inout LJB_VMON_USB_SINK *         UsbSink
+    )
+{
+    LJB_VMON_USB_TRANSFER * CONST   Transfer = UsbSink->Current;
+    BOOLEAN                         Waited = FALSE;
+
+    UsbSink->Current = NULL;
+    while (InterlockedCompareExchange(&UsbSink->InFlight, 0, 0) >= (LONG) UsbSink->Depth &&
+           !UsbSink->Failed)
+    {
+        if (!Waited)
+            UsbSink->Stats.Waits++;
+        Waited = TRUE;
+        LJB_VMON_UsbSinkWait(UsbSink);
+    }
+
+    InterlockedIncrement(&UsbSink->InFlight);
+    if (UsbSink->Failed ||
+        !UsbSink->Endpoint->pfnSubmit(UsbSink->Endpoint->EndpointContext, Transfer))
+    {
+        LJB_VMON_UsbSinkComplete(UsbSink, Transfer, FALSE);
+        return FALSE;
+    }
+    UsbSink->Stats.Transfers++;
+    UsbSink->Stats.Packets +=
+        (Transfer->Size + UsbSink->Endpoint->MaxPacketSize - 1) / UsbSink->Endpoint->MaxPacketSize;
+    return TRUE;
+}
+
+/*
+ * Put Size bytes of Data, zeros if NULL, on the stream; a transfer that has
+ * filled up goes once more is to come, so that the last of a frame is still
+ * Current when the frame is flushed.
+ */
+static BOOLEAN
+LJB_VMON_UsbSinkAppend(
+    __inout LJB_VMON_USB_SINK *         UsbSink,
+    __in_opt CONST VOID *               Data,
+    __in SIZE_T                         Size
+    )
+{
+    CONST UCHAR *   pData = Data;
+    BOOLEAN         Waited = FALSE;
+    ULONG           Count;
+
+    while (Size != 0)
+    {
+        if (UsbSink->Current != NULL &&
+            UsbSink->Current->Size == UsbSink->TransferSize &&
+            !LJB_VMON_UsbSinkSubmit(UsbSink))
+            return FALSE;
+        while (UsbSink->Current == NULL)
+        {
+            if (UsbSink->Failed)
+                return FALSE;
+            LJB_VMON_UsbLock(&UsbSink->Lock);
+            UsbSink->Current = UsbSink->FreeList;
+            if (UsbSink->Current != NULL)
+                UsbSink->FreeList = UsbSink->Current->Next;
+            LJB_VMON_UsbUnlock(&UsbSink->Lock);
+            if (UsbSink->Current != NULL)
+            {
+                UsbSink->Current->Size = 0;
+                UsbSink->Current->EndsFrame = FALSE;
+                break;
+            }
+            if (!Waited)
+                UsbSink->Stats.Waits++;
+            Waited = TRUE;
+            LJB_VMON_UsbSinkWait(UsbSink);
+        }
+
+        Count = UsbSink->TransferSize - UsbSink->Current->Size;
+        if (Count > Size)
+            Count = (ULONG) Size;
+        if (pData != NULL)
+        {
+            RtlCopyMemory(UsbSink->Current->Buffer + UsbSink->Current->Size, pData, Count);
+            pData += Count;
+        }
+        else
+            RtlZeroMemory(UsbSink->Current->Buffer + UsbSink->Current->Size, Count);
+        UsbSink->Current->Size += Count;
+        Size -= Count;
+    }
+    return TRUE;
+}
+
+/*
+ * End what is on the stream at a packet boundary and send it. It counts as
+ * a frame on its way until its last transfer completes.
+ */
+static BOOLEAN
+LJB_VMON_UsbSinkFlush(
+    __inout LJB_VMON_USB_SINK *         UsbSink
+    )
+{
+    ULONG CONST         PacketSize = UsbSink->Endpoint->MaxPacketSize;
+    LJB_VMON_NET_HEADER Pad;
+    ULONG               PadSize;
+
+    if (UsbSink->Current == NULL)
+        return TRUE;
+
+    PadSize = (PacketSize - UsbSink->Current->Size % PacketSize) % PacketSize;
+    if (PadSize != 0)
+    {
+        if (PadSize < sizeof(Pad))
+            PadSize += PacketSize;
+        RtlZeroMemory(&Pad, sizeof(Pad));
+        Pad.Type = LJB_VMON_USB_TYPE_PAD;
+        Pad.Size = PadSize - sizeof(Pad);
+        if (!LJB_VMON_UsbSinkAppend(UsbSink, &Pad, sizeof(Pad)) ||
+            !LJB_VMON_UsbSinkAppend(UsbSink, NULL, Pad.Size))
+            return FALSE;
+        UsbSink->Stats.PadBytes += PadSize;
+    }
+    UsbSink->Current->EndsFrame = TRUE;
+    InterlockedIncrement(&UsbSink->FramesInFlight);
+    return LJB_VMON_UsbSinkSubmit(UsbSink);
+}
+
+static BOOLEAN
+LJB_VMON_UsbSinkSendModeChange(
+    __inout LJB_VMON_USB_SINK *         UsbSink,
+    __in UINT                           Width,
+    __in UINT                           Height,
+    __in ULONG                          Rotation
+    )
+{
+    struct
+    {
+        LJB_VMON_NET_HEADER         Header;
+        LJB_VMON_NET_MODE_CHANGE    Body;
+    }       Message;
+
+    RtlZeroMemory(&Message, sizeof(Message));
+    Message.Header.Type = LJB_VMON_NET_TYPE_MODE_CHANGE;
+    Message.Header.Size = sizeof(Message.Body);
+    Message.Body.Width = (USHORT) Width;
+    Message.Body.Height = (USHORT) Height;
+    Message.Body.Rotation = Rotation;
+    if (!LJB_VMON_UsbSinkAppend(UsbSink, &Message, sizeof(Message)))
+        return FALSE;
+
+    UsbSink->Width = Width;
+    UsbSink->Height = Height;
+    UsbSink->Rotation = Rotation;
+    return TRUE;
+}
+
+static VOID
+LJB_VMON_UsbSinkModeChange(
+    __in PVOID                          SinkContext,
+    __in CONST TARGET_MODE_DATA *       TargetModeData
+    )
+{
+    LJB_VMON_USB_SINK * CONST   UsbSink = SinkContext;
+
+    UsbSink->Rotation = (ULONG) TargetModeData->Rotation;
+    if (UsbSink->Failed)
+        return;
+
+    /*
+     * the next frame announces its mode and goes whole; a disabled source
+     * is announced now, it has no frames.
+     */
+    UsbSink->Width = 0;
+    UsbSink->Height = 0;
+    if (!TargetModeData->Enabled ||
+        TargetModeData->Width == 0 ||
+        TargetModeData->Height == 0)
+    {
+        if (LJB_VMON_UsbSinkSendModeChange(UsbSink, 0, 0, UsbSink->Rotation))
+            LJB_VMON_UsbSinkFlush(UsbSink);
+    }
+}
+
+static VOID
+LJB_VMON_UsbSinkFrameUpdate(
+    __in PVOID                          SinkContext,
+    __in CONST LJB_VMON_SINK_FRAME *    Frame
+    )
+{
+    LJB_VMON_USB_SINK * CONST   UsbSink = SinkContext;
+    UCHAR                       Head[LJB_VMON_NET_FRAME_HEAD_SIZE];
+    CONST LJB_VMON_DAMAGE *     Damage;
+    LJB_VMON_DAMAGE             FullDamage;
+    LJB_VMON_DAMAGE             Sent;
+    CONST LJB_VMON_COPY_RECT *  Copies;
+    CONST LJB_VMON_RECT *       pRect;
+    CONST UCHAR *               TileData;
+    SIZE_T                      TileDataSize;
+    ULONG                       SendTime;
+    ULONG                       HeadSize;
+    ULONG64                     PixelsSize;
+    UINT                        NumCopies;
+    UINT                        i;
+    LONG                        row;
+
+    if (UsbSink->Failed)
+    {
+        UsbSink->Stats.DroppedFrames++;
+        return;
+    }
+    SendTime = LJB_VMON_NetMicroseconds();
+
+    /*
+     * moves go as copies, only the residual as pixels. A new size goes
+     * whole, after a mode change.
+     */
+    Damage = Frame->Damage;
+    Copies = NULL;
+    NumCopies = 0;
+    if (Damage != NULL && Frame->Motion != NULL)
+    {
+        Damage = &Frame->Motion->Residual;
+        Copies = Frame->Motion->Copies;
+        NumCopies = Frame->Motion->NumCopies;
+    }
+    if (Frame->Width != UsbSink->Width || Frame->Height != UsbSink->Height)
+    {
+        if (!LJB_VMON_UsbSinkSendModeChange(
+                UsbSink,
+                Frame->Width,
+                Frame->Height,
+                UsbSink->Rotation))
+        {
+            UsbSink->Stats.DroppedFrames++;
+            return;
+        }
+        Damage = NULL;
+    }
+    if (Damage == NULL)
+    {
+        LJB_VMON_DamageSetFull(&FullDamage, Frame->Width, Frame->Height);
+        Damage = &FullDamage;
+        NumCopies = 0;
+    }
+
+    TileData = NULL;
+    if (UsbSink->Tiles)
+    {
+        if (UsbSink->Quality != 0 &&
+            (UsbSink->TileEncoder.Quality == 0 ||
+             UsbSink->TileEncoder.Width != Frame->Width ||
+             UsbSink->TileEncoder.Height != Frame->Height))
+        {
+            /*
+             * the lossy path keeps its history per mode; out of memory,
+             * go on lossless.
+             */
+            if (!LJB_VMON_TileEncoderSetLossy(
+                    &UsbSink->TileEncoder,
+                    Frame->Width,
+                    Frame->Height,
+                    UsbSink->Quality))
+                UsbSink->Quality = 0;
+        }
+        Sent = *Damage;
+        LJB_VMON_TileEncoderAddRefresh(&UsbSink->TileEncoder, &Sent);
+        Damage = &Sent;
+
+        if (!LJB_VMON_TileEncode(
+                &UsbSink->TileEncoder,
+                Frame->Buffer,
+                Frame->Pitch,
+                Damage->Rects,
+                Damage->NumRects,
+                &TileData,
+                &TileDataSize))
+        {
+            /*
+             * the device is left with the previous frame; resend it whole
+             * once memory allows. A mode change already on the stream goes
+             * out with the next frame.
+             */
+            UsbSink->Width = 0;
+            UsbSink->Height = 0;
+            UsbSink->Stats.DroppedFrames++;
+            return;
+        }
+    }
+
+    PixelsSize = (TileData != NULL) ? TileDataSize : LJB_VMON_DamageArea(Damage) * 4;
+    HeadSize = LJB_VMON_NetFrameHead(
+        Head,
+        Frame,
+        SendTime,
+        (UCHAR) ((TileData != NULL) ? LJB_VMON_NET_ENCODING_TILE : LJB_VMON_NET_ENCODING_RAW),
+        Copies,
+        NumCopies,
+        Damage,
+        PixelsSize
+        );
+
+    /*
+     * the rows of every rectangle are packed back to back into the
+     * transfers; a transfer buffer is the only copy a pixel goes through.
+     */
+    if (!LJB_VMON_UsbSinkAppend(UsbSink, Head, HeadSize))
+    {
+        UsbSink->Stats.DroppedFrames++;
+        return;
+    }
+    if (TileData != NULL)
+    {
+        if (!LJB_VMON_UsbSinkAppend(UsbSink, TileData, TileDataSize))
+        {
+            UsbSink->Stats.DroppedFrames++;
+            return;
+        }
+    }
+    for (i = 0; TileData == NULL && i < Damage->NumRects; i++)
+    {
+        pRect = &Damage->Rects[i];
+        for (row = pRect->Top; row < pRect->Bottom; row++)
+        {
+            if (!LJB_VMON_UsbSinkAppend(
+                    UsbSink,
+                    (CONST UCHAR *) Frame->Buffer + (SIZE_T) row * Frame->Pitch + pRect->Left * 4,
+                    (pRect->Right - pRect->Left) * 4))
+            {
+                UsbSink->Stats.DroppedFrames++;
+                return;
+            }
+        }
+    }
+    if (!LJB_VMON_UsbSinkFlush(UsbSink))
+    {
+        UsbSink->Stats.DroppedFrames++;
+        return;
+    }
+
+    UsbSink->Stats.Frames++;
+    UsbSink->Stats.FrameBytes += HeadSize + PixelsSize;
+}
+
+/*
+ * Room for another frame while fewer than Credits are on their way. A sink
+ * whose endpoint failed drops what it gets, so it never holds anything up.
+ */
+static BOOLEAN
+LJB_VMON_UsbSinkHasCredit(
+    __in PVOID                          SinkContext
+    )
+{
+    LJB_VMON_USB_SINK * CONST   UsbSink = SinkContext;
+
+    if (UsbSink->Failed)
+        return TRUE;
+    return InterlockedCompareExchange(&UsbSink->FramesInFlight, 0, 0) < (LONG) UsbSink->Credits;
+}
+
+/*
+ * Nothing to send for a while; the transfer pool stays, the buffers the
+ * tile encoder codes into go until the next frame.
+ */
+static VOID
+LJB_VMON_UsbSinkIdle(
+    __in PVOID                          SinkContext
+    )
+{
+    LJB_VMON_USB_SINK * CONST   UsbSink = SinkContext;
+
+    if (UsbSink->Tiles)
+        LJB_VMON_TileEncoderTrim(&UsbSink->TileEncoder);
+}
+
+/*
+ * Name:  LJB_VMON_UsbSinkInit
+ *
+ * Definition:
+ *    __checkReturn
+ *    BOOLEAN
+ *    LJB_VMON_UsbSinkInit(
+ *        __out LJB_VMON_USB_SINK *     UsbSink,
+ *        __in LJB_VMON_USB_ENDPOINT *  Endpoint,
+ *        __in ULONG                    TransferSize,
+ *        __in UINT                     Depth,
+ *        __in BOOLEAN                  Tiles,
+ *        __in UINT                     Quality,
+ *        __in UINT                     Credits
+ *        );
+ *
+ * Description:
+ *    Set up a sink that sends to the bulk OUT Endpoint, transfers of
+ *    TransferSize bytes (LJB_VMON_USB_DEFAULT_TRANSFER_SIZE if 0, rounded
+ *    down to whole packets), Depth of them in flight at most (1 to
+ *    LJB_VMON_USB_MAX_DEPTH). With Tiles, frames go as
+ *    LJB_VMON_NET_ENCODING_TILE rather than raw, and a nonzero Quality
+ *    (1 to 100) lets video regions go out lossy. A nonzero Credits lets the
+ *    VMON thread hand over another frame only while fewer than that many
+ *    are on their way; 0 leaves it to wait on the link. The sink takes over
+ *    the completion callback of Endpoint.
+ *
+ * Return Value:
+ *    TRUE if set up. FALSE otherwise; the caller still calls
+ *    LJB_VMON_UsbSinkDeInit.
+ *
+ */
+__checkReturn
+BOOLEAN
+LJB_VMON_UsbSinkInit(
+    __out LJB_VMON_USB_SINK *           UsbSink,
+    __in LJB_VMON_USB_ENDPOINT *        Endpoint,
+    __in ULONG                          TransferSize,
+    __in UINT                           Depth,
+    __in BOOLEAN                        Tiles,
+    __in UINT                           Quality,
+    __in UINT                           Credits
+    )
+{
+    LJB_VMON_USB_TRANSFER * Transfer;
+    UINT                    i;
+
+    RtlZeroMemory(UsbSink, sizeof(*UsbSink));
+
+    if (TransferSize == 0)
+        TransferSize = LJB_VMON_USB_DEFAULT_TRANSFER_SIZE;
+    TransferSize -= TransferSize % Endpoint->MaxPacketSize;
+    if (TransferSize == 0)
+        TransferSize = Endpoint->MaxPacketSize;
+    if (Depth == 0)
+        Depth = 1;
+    if (Depth > LJB_VMON_USB_MAX_DEPTH)
+        Depth = LJB_VMON_USB_MAX_DEPTH;
+    UsbSink->Endpoint = Endpoint;
+    UsbSink->TransferSize = TransferSize;
+    UsbSink->Depth = Depth;
+
+    UsbSink->Tiles = Tiles;
+    UsbSink->Quality = Quality;
+    UsbSink->Credits = Credits;
+    if (Tiles && !LJB_VMON_TileEncoderInit(&UsbSink->TileEncoder, 0))
+        return FALSE;
+
+    UsbSink->hCompleteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (UsbSink->hCompleteEvent == NULL)
+        return FALSE;
+    UsbSink->hCreditEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (UsbSink->hCreditEvent == NULL)
+        return FALSE;
+
+    /*
+     * Depth out and one filling
+     */
+    for (i = 0; i < Depth + 1; i++)
+    {
+        Transfer = &UsbSink->Transfers[i];
+        Transfer->Buffer = HeapAlloc(GetProcessHeap(), 0, TransferSize);
+        if (Transfer->Buffer == NULL)
+            return FALSE;
+        Transfer->Next = UsbSink->FreeList;
+        UsbSink->FreeList = Transfer;
+        UsbSink->NumTransfers++;
+    }
+
+    Endpoint->CompletionContext = UsbSink;
+    Endpoint->pfnComplete = &LJB_VMON_UsbSinkComplete;
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_UsbSinkDeInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_UsbSinkDeInit(
+ *        __inout LJB_VMON_USB_SINK *   UsbSink
+ *        );
+ *
+ * Description:
+ *    Wait for the transfers in flight to complete and free the sink. The
+ *    VMON thread must no longer report to it, and the endpoint must still
+ *    be running.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_UsbSinkDeInit(
+    __inout LJB_VMON_USB_SINK *         UsbSink
+    )
+{
+    UINT    i;
+
+    while (InterlockedCompareExchange(&UsbSink->InFlight, 0, 0) != 0)
+        WaitForSingleObject(UsbSink->hCompleteEvent, INFINITE);
+    for (i = 0; i < UsbSink->NumTransfers; i++)
+        HeapFree(GetProcessHeap(), 0, UsbSink->Transfers[i].Buffer);
+    if (UsbSink->hCompleteEvent != NULL)
+        CloseHandle(UsbSink->hCompleteEvent);
+    if (UsbSink->hCreditEvent != NULL)
+        CloseHandle(UsbSink->hCreditEvent);
+    if (UsbSink->Tiles)
+        LJB_VMON_TileEncoderDeInit(&UsbSink->TileEncoder);
+    RtlZeroMemory(UsbSink, sizeof(*UsbSink));
+}
+
+/*
+ * Name:  LJB_VMON_UsbSinkGetSink
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_UsbSinkGetSink(
+ *        __in LJB_VMON_USB_SINK *      UsbSink,
+ *        __out LJB_VMON_SINK *         Sink
+ *        );
+ *
+ * Description:
+ *    Return the sink through which the VMON thread feeds the USB sink. The
+ *    cursor is not on the bulk stream, so its callbacks are NULL. Flow
+ *    control is only there if the sink was set up with credits.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_UsbSinkGetSink(
+    __in LJB_VMON_USB_SINK *            UsbSink,
+    __out LJB_VMON_SINK *               Sink
+    )
+{
+    Sink->SinkContext = UsbSink;
+    Sink->pfnModeChange = &LJB_VMON_UsbSinkModeChange;
+    Sink->pfnFrameUpdate = &LJB_VMON_UsbSinkFrameUpdate;
+    Sink->pfnCursorShape = NULL;
+    Sink->pfnCursorPosition = NULL;
+    Sink->pfnHasCredit = (UsbSink->Credits != 0) ? &LJB_VMON_UsbSinkHasCredit : NULL;
+    Sink->hCreditEvent = UsbSink->hCreditEvent;
+    Sink->pfnIdle = &LJB_VMON_UsbSinkIdle;
+}
@@ -0,0 +1,1232 @@
+#include "ljb_vmon_workload.h"
+
+#define TASKBAR_HEIGHT          40
+#define TITLE_HEIGHT            24
+#define TEXT_MARGIN             4
+#define CELL_WIDTH              8
+#define CELL_HEIGHT             16
+#define MAX_COLUMNS             256
+
+#define CARET_WIDTH             2
+#define CARET_BLINK_FRAMES      32      // 530 ms at 60 Hz
+#define SCROLL_FRAMES           90      // one flick and the pause after it
+#define SLIDE_FRAMES            240
+#define FADE_FRAMES             16
+#define SLIDE_CIRCLES           6
+
+#define COLOR_TEXT              0x00202020
+#define COLOR_PAPER             0x00FFFFFF
+#define COLOR_FRAME             0x00606060
+#define COLOR_TITLE             0x002B579A
+#define COLOR_TITLE_TEXT        0x00F0F0F0
+#define COLOR_TASKBAR           0x00303038
+
+static CONST CHAR * CONST   WorkloadNames[LJB_VMON_WORKLOAD_COUNT] =
+{
+    "idle",
+    "typing",
+    "drag",
+    "scroll",
+    "video",
+    "slideshow",
+};
+
+static UINT32
+WorkloadRandom(
+    __inout LJB_VMON_WORKLOAD * Workload
+    )
+{
+    UINT32  x = Workload->Random;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    Workload->Random = x;
+    return x;
+}
+
+static UINT32
+Mix(
+    __in UINT32 x
+    )
+{
+    x ^= x >> 16;
+    x *= 0x7FEB352D;
+    x ^= x >> 15;
+    x *= 0x846CA68B;
+    x ^= x >> 16;
+    return x;
+}
+
+static UINT
+IntSqrt(
+    __in UINT   Value
+    )
+{
+    UINT    Root = 0;
+    UINT    Bit = 1u << 30;
+
+    while (Bit > Value)
+        Bit >>= 2;
+    while (Bit != 0)
+    {
+        if (Value >= Root + Bit)
+        {
+            Value -= Root + Bit;
+            Root = (Root >> 1) + Bit;
+        }
+        else
+        {
+            Root >>= 1;
+        }
+        Bit >>= 2;
+    }
+    return Root;
+}
+
+static VOID
+MakeRect(
+    __out LJB_VMON_RECT *   Rect,
+    __in LONG               Left,
+    __in LONG               Top,
+    __in LONG               Right,
+    __in LONG               Bottom
+    )
+{
+    Rect->Left = Left;
+    Rect->Top = Top;
+    Rect->Right = Right;
+    Rect->Bottom = Bottom;
+}
+
+/*
+ * Clip Rect against the frame. Returns FALSE if nothing is left.
+ */
+static BOOLEAN
+RectClip(
+    __in CONST LJB_VMON_WORKLOAD *  Workload,
+    __inout LJB_VMON_RECT *         Rect
+    )
+{
+    if (Rect->Left < 0)
+        Rect->Left = 0;
+    if (Rect->Top < 0)
+        Rect->Top = 0;
+    if (Rect->Right > (LONG) Workload->Width)
+        Rect->Right = (LONG) Workload->Width;
+    if (Rect->Bottom > (LONG) Workload->Height)
+        Rect->Bottom = (LONG) Workload->Height;
+    return (BOOLEAN) (Rect->Left < Rect->Right && Rect->Top < Rect->Bottom);
+}
+
+/*
+ * The parts of A not covered by B, at most four rectangles.
+ */
+static UINT
+RectSubtract(
+    __in CONST LJB_VMON_RECT *  A,
+    __in CONST LJB_VMON_RECT *  B,
+    __out LJB_VMON_RECT *       Out
+    )
+{
+    LONG    Top;
+    LONG    Bottom;
+    UINT    Count = 0;
+
+    if (B->Right <= A->Left || B->Left >= A->Right ||
+        B->Bottom <= A->Top || B->Top >= A->Bottom)
+    {
+        Out[0] = *A;
+        return 1;
+    }
+
+    Top = A->Top;
+    Bottom = A->Bottom;
+    if (B->Top > Top)
+    {
+        MakeRect(&Out[Count++], A->Left, Top, A->Right, B->Top);
+        Top = B->Top;
+    }
+    if (B->Bottom < Bottom)
+    {
+        MakeRect(&Out[Count++], A->Left, B->Bottom, A->Right, Bottom);
+        Bottom = B->Bottom;
+    }
+    if (B->Left > A->Left)
+        MakeRect(&Out[Count++], A->Left, Top, B->Left, Bottom);
+    if (B->Right < A->Right)
+        MakeRect(&Out[Count++], B->Right, Top, A->Right, Bottom);
+    return Count;
+}
+
+static ULONG *
+PixelAt(
+    __in PVOID  FrameBuffer,
+    __in UINT   Pitch,
+    __in LONG   x,
+    __in LONG   y
+    )
+{
+    return (ULONG *) ((UCHAR *) FrameBuffer + (SIZE_T) y * Pitch) + x;
+}
+
+static VOID
+FillPixels(
+    __in CONST LJB_VMON_WORKLOAD *  Workload,
+    __inout PVOID                   FrameBuffer,
+    __in UINT                       Pitch,
+    __in CONST LJB_VMON_RECT *      Rect,
+    __in ULONG                      Color
+    )
+{
+    LJB_VMON_RECT   Clip = *Rect;
+    ULONG *         Row;
+    LONG            x, y;
+
+    if (!RectClip(Workload, &Clip))
+        return;
+
+    for (y = Clip.Top; y < Clip.Bottom; y++)
+    {
+        Row = PixelAt(FrameBuffer, Pitch, 0, y);
+        for (x = Clip.Left; x < Clip.Right; x++)
+            Row[x] = Color;
+    }
+}
+
+/*
+ * Desktop wallpaper and taskbar, which are a function of the position only
+ * so that any part of them can be repainted.
+ */
+static VOID
+PaintDesktop(
+    __in CONST LJB_VMON_WORKLOAD *  Workload,
+    __inout PVOID                   FrameBuffer,
+    __in UINT                       Pitch,
+    __in CONST LJB_VMON_RECT *      Rect
+    )
+{
+    LONG CONST      TaskbarTop = (LONG) Workload->Height - TASKBAR_HEIGHT;
+    LJB_VMON_RECT   Clip = *Rect;
+    ULONG *         Row;
+    ULONG           Base;
+    LONG            x, y;
+
+    if (!RectClip(Workload, &Clip))
+        return;
+
+    for (y = Clip.Top; y < Clip.Bottom; y++)
+    {
+        Row = PixelAt(FrameBuffer, Pitch, 0, y);
+        if (y >= TaskbarTop)
+        {
+            for (x = Clip.Left; x < Clip.Right; x++)
+                Row[x] = COLOR_TASKBAR;
+            continue;
+        }
+
+        Base = 0x00180000 | (0x70 + (ULONG) y * 0x50 / Workload->Height);
+        for (x = Clip.Left; x < Clip.Right; x++)
+            Row[x] = Base | ((0x40 + (ULONG) x * 0x30 / Workload->Width) << 8);
+    }
+}
+
+/*
+ * Eight pixel wide bit pattern of glyph row Row. Letters get a body of
+ * pseudo random strokes, taller for ascenders and lower for descenders,
+ * which is all a codec can tell apart from real text.
+ */
+static UINT
+GlyphRow(
+    __in CHAR   Char,
+    __in UINT   Row
+    )
+{
+    UINT    First = 6;
+    UINT    Last = 12;
+
+    if (Char < 'a' || Char > 'z')
+        return 0;
+    if (strchr("bdfhklt", Char) != NULL)
+        First = 2;
+    if (strchr("gjpqy", Char) != NULL)
+        Last = 15;
+    if (Row < First || Row > Last)
+        return 0;
+    if (Row == First || Row == Last)
+        return 0x3C;
+    return (Mix((UINT32) Char * 16 + Row) & 0x7E) | 0x40;
+}
+
+/*
+ * Draw Length characters at (X, Y), only the pixels inside Clip. The cells
+ * must already hold their background.
+ */
+static VOID
+DrawGlyphs(
+    __in CONST LJB_VMON_WORKLOAD *  Workload,
+    __inout PVOID                   FrameBuffer,
+    __in UINT                       Pitch,
+    __in LONG                       X,
+    __in LONG                       Y,
+    __in CONST CHAR *               Text,
+    __in UINT                       Length,
+    __in CONST LJB_VMON_RECT *      Clip,
+    __in ULONG                      Color
+    )
+{
+    LJB_VMON_RECT   Bounds = *Clip;
+    ULONG *         Row;
+    UINT            Bits;
+    UINT            i, r, b;
+    LONG            x, y;
+
+    if (!RectClip(Workload, &Bounds))
+        return;
+
+    for (r = 0; r < CELL_HEIGHT; r++)
+    {
+        y = Y + (LONG) r;
+        if (y < Bounds.Top || y >= Bounds.Bottom)
+            continue;
+
+        Row = PixelAt(FrameBuffer, Pitch, 0, y);
+        for (i = 0; i < Length; i++)
+        {
+            Bits = GlyphRow(Text[i], r);
+            for (b = 0; Bits != 0; b++, Bits = (Bits << 1) & 0xFF)
+            {
+                if ((Bits & 0x80) == 0)
+                    continue;
+                x = X + (LONG) (i * CELL_WIDTH + b);
+                if (x >= Bounds.Left && x < Bounds.Right)
+                    Row[x] = Color;
+            }
+        }
+    }
+}
+
+/*
+ * Line Line of the document every text workload shows: words of one to
+ * nine letters, some lines short and some empty, at most Columns long.
+ */
+static UINT
+DocumentLine(
+    __in CONST LJB_VMON_WORKLOAD *  Workload,
+    __in UINT                       Line,
+    __out CHAR *                    Text
+    )
+{
+    UINT32  r = Mix(Workload->Seed ^ (Line * 0x9E3779B9));
+    UINT    Length;
+    UINT    Target;
+    UINT    Word;
+
+    if (Workload->Columns == 0 || r % 9 == 0)
+        return 0;
+
+    Target = Workload->Columns / 2 + (r >> 8) % (Workload->Columns / 2 + 1);
+    if (Target > Workload->Columns)
+        Target = Workload->Columns;
+    Length = 0;
+    while (Length < Target)
+    {
+        r = Mix(r);
+        Word = 1 + r % 9;
+        while (Word-- != 0 && Length < Target)
+        {
+            r = Mix(r + Length);
+            Text[Length++] = (CHAR) ('a' + r % 26);
+        }
+        if (Length < Target - 1)
+            Text[Length++] = ' ';
+    }
+    return Length;
+}
+
+/*
+ * Paint the document rows of Client that fall within [Top, Bottom), the
+ * document scrolled by ScrollY pixels.
+ */
+static VOID
+PaintDocument(
+    __in CONST LJB_VMON_WORKLOAD *  Workload,
+    __inout PVOID                   FrameBuffer,
+    __in UINT                       Pitch,
+    __in LONG                       Top,
+    __in LONG                       Bottom
+    )
+{
+    CHAR            Text[MAX_COLUMNS];
+    LJB_VMON_RECT   Band;
+    LONG            Origin;
+    UINT            First;
+    UINT            Line;
+    UINT            Length;
+
+    MakeRect(&Band, Workload->Client.Left, Top, Workload->Client.Right, Bottom);
+    FillPixels(Workload, FrameBuffer, Pitch, &Band, COLOR_PAPER);
+
+    /*
+     * document line L starts at Origin + L * CELL_HEIGHT
+     */
+    Origin = Workload->Client.Top + TEXT_MARGIN - (LONG) Workload->ScrollY;
+    First = 0;
+    if (Top - CELL_HEIGHT >= Origin)
+        First = (UINT) ((Top - CELL_HEIGHT - Origin) / CELL_HEIGHT);
+    for (Line = First; Origin + (LONG) (Line * CELL_HEIGHT) < Bottom; Line++)
+    {
+        Length = DocumentLine(Workload, Line, Text);
+        DrawGlyphs(
+            Workload,
+            FrameBuffer,
+            Pitch,
+            Workload->Client.Left + TEXT_MARGIN,
+            Origin + (LONG) (Line * CELL_HEIGHT),
+            Text,
+            Length,
+            &Band,
+            COLOR_TEXT
+            );
+    }
+}
+
+/*
+ * Frame, title bar and the title, with the client area left to the caller.
+ */
+static VOID
+PaintWindowFrame(
+    __in CONST LJB_VMON_WORKLOAD *  Workload,
+    __inout PVOID                   FrameBuffer,
+    __in UINT                       Pitch
+    )
+{
+    static CONST CHAR   Title[] = "untitled document";
+    LJB_VMON_RECT       Rect;
+
+    FillPixels(Workload, FrameBuffer, Pitch, &Workload->Window, COLOR_FRAME);
+    Rect = Workload->Window;
+    Rect.Left += 1;
+    Rect.Top += 1;
+    Rect.Right -= 1;
+    Rect.Bottom = Rect.Top + TITLE_HEIGHT;
+    FillPixels(Workload, FrameBuffer, Pitch, &Rect, COLOR_TITLE);
+    DrawGlyphs(
+        Workload,
+        FrameBuffer,
+        Pitch,
+        Rect.Left + TEXT_MARGIN,
+        Rect.Top + (TITLE_HEIGHT - CELL_HEIGHT) / 2,
+        Title,
+        sizeof(Title) - 1,
+        &Rect,
+        COLOR_TITLE_TEXT
+        );
+}
+
+/*
+ * Place the window and derive its client area and text grid.
+ */
+static VOID
+SetWindow(
+    __inout LJB_VMON_WORKLOAD * Workload,
+    __in LONG                   Left,
+    __in LONG                   Top,
+    __in LONG                   Right,
+    __in LONG                   Bottom
+    )
+{
+    LONG    Width;
+    LONG    Height;
+
+    MakeRect(&Workload->Window, Left, Top, Right, Bottom);
+    MakeRect(&Workload->Client, Left + 1, Top + 1 + TITLE_HEIGHT, Right - 1, Bottom - 1);
+    if (Workload->Client.Bottom < Workload->Client.Top)
+        Workload->Client.Bottom = Workload->Client.Top;
+    if (Workload->Client.Right < Workload->Client.Left)
+        Workload->Client.Right = Workload->Client.Left;
+
+    Width = Workload->Client.Right - Workload->Client.Left - 2 * TEXT_MARGIN;
+    Height = Workload->Client.Bottom - Workload->Client.Top - 2 * TEXT_MARGIN;
+    Workload->Columns = Width > 0 ? (UINT) Width / CELL_WIDTH : 0;
+    Workload->Rows = Height > 0 ? (UINT) Height / CELL_HEIGHT : 0;
+    if (Workload->Columns > MAX_COLUMNS)
+        Workload->Columns = MAX_COLUMNS;
+}
+
+/*
+ * Copy the pixels of Dst offset by (-Dx, -Dy) into Dst, both inside the
+ * frame and possibly overlapping.
+ */
+static VOID
+MovePixels(
+    __inout PVOID                   FrameBuffer,
+    __in UINT                       Pitch,
+    __in CONST LJB_VMON_RECT *      Dst,
+    __in INT                        Dx,
+    __in INT                        Dy
+    )
+{
+    SIZE_T CONST    Bytes = (SIZE_T) (Dst->Right - Dst->Left) * 4;
+    LONG            y;
+
+    if (Dy > 0)
+    {
+        for (y = Dst->Bottom - 1; y >= Dst->Top; y--)
+        {
+            memmove(
+                PixelAt(FrameBuffer, Pitch, Dst->Left, y),
+                PixelAt(FrameBuffer, Pitch, Dst->Left - Dx, y - Dy),
+                Bytes
+                );
+        }
+    }
+    else
+    {
+        for (y = Dst->Top; y < Dst->Bottom; y++)
+        {
+            memmove(
+                PixelAt(FrameBuffer, Pitch, Dst->Left, y),
+                PixelAt(FrameBuffer, Pitch, Dst->Left - Dx, y - Dy),
+                Bytes
+                );
+        }
+    }
+}
+
+static VOID
+CaretRect(
+    __in CONST LJB_VMON_WORKLOAD *  Workload,
+    __out LJB_VMON_RECT *           Rect
+    )
+{
+    LONG CONST  x = Workload->Client.Left + TEXT_MARGIN + (LONG) (Workload->Column * CELL_WIDTH);
+    LONG CONST  y = Workload->Client.Top + TEXT_MARGIN + (LONG) (Workload->Row * CELL_HEIGHT);
+
+    MakeRect(Rect, x, y, x + CARET_WIDTH, y + CELL_HEIGHT);
+}
+
+static VOID
+SetMove(
+    __out LJB_VMON_WORKLOAD_FRAME * Frame,
+    __in CONST LJB_VMON_RECT *      Rect,
+    __in INT                        Dx,
+    __in INT                        Dy
+    )
+{
+    Frame->HasMove = TRUE;
+    Frame->MoveRect = *Rect;
+    Frame->MoveDx = Dx;
+    Frame->MoveDy = Dy;
+}
+
+static VOID
+IdleFrame(
+    __inout LJB_VMON_WORKLOAD *     Workload,
+    __inout PVOID                   FrameBuffer,
+    __in UINT                       Pitch,
+    __inout LJB_VMON_WORKLOAD_FRAME * Frame
+    )
+{
+    LJB_VMON_RECT   Caret;
+
+    if (Workload->Rows == 0 || Workload->FrameIndex % CARET_BLINK_FRAMES != 0)
+        return;
+
+    Workload->CaretOn = (BOOLEAN) !Workload->CaretOn;
+    CaretRect(Workload, &Caret);
+    FillPixels(Workload, FrameBuffer, Pitch, &Caret,
+        Workload->CaretOn ? COLOR_TEXT : COLOR_PAPER);
+    LJB_VMON_DamageAddRect(&Frame->Damage, &Caret);
+}
+
+/*
+ * One key stroke every few frames, a new line at the end of each document
+ * line, and the text scrolled up one line when the caret leaves the bottom.
+ */
+static VOID
+TypingFrame(
+    __inout LJB_VMON_WORKLOAD *     Workload,
+    __inout PVOID                   FrameBuffer,
+    __in UINT                       Pitch,
+    __inout LJB_VMON_WORKLOAD_FRAME * Frame
+    )
+{
+    CHAR            Text[MAX_COLUMNS];
+    LJB_VMON_RECT   Rect;
+    LJB_VMON_RECT   Caret;
+    UINT            Length;
+
+    if (Workload->Rows == 0 || Workload->Columns == 0)
+        return;
+    if (Workload->NextKey != 0)
+    {
+        Workload->NextKey--;
+        return;
+    }
+
+    CaretRect(Workload, &Caret);
+    FillPixels(Workload, FrameBuffer, Pitch, &Caret, COLOR_PAPER);
+    LJB_VMON_DamageAddRect(&Frame->Damage, &Caret);
+
+    Length = DocumentLine(Workload, Workload->Line, Text);
+    if (Workload->Column < Length)
+    {
+        DrawGlyphs(
+            Workload,
+            FrameBuffer,
+            Pitch,
+            Caret.Left,
+            Caret.Top,
+            &Text[Workload->Column],
+            1,
+            &Workload->Client,
+            COLOR_TEXT
+            );
+        MakeRect(&Rect, Caret.Left, Caret.Top, Caret.Left + CELL_WIDTH, Caret.Bottom);
+        LJB_VMON_DamageAddRect(&Frame->Damage, &Rect);
+        Workload->Column++;
+        Workload->NextKey = 2 + WorkloadRandom(Workload) % 10;
+    }
+    else
+    {
+        Workload->Line++;
+        Workload->Column = 0;
+        if (Workload->Row + 1 < Workload->Rows)
+        {
+            Workload->Row++;
+        }
+        else if (Workload->Rows > 1)
+        {
+            /*
+             * lines above the finished one move up, the finished one is
+             * painted again without the caret, the last row is cleared
+             */
+            MakeRect(
+                &Rect,
+                Workload->Client.Left,
+                Workload->Client.Top + TEXT_MARGIN,
+                Workload->Client.Right,
+                Workload->Client.Top + TEXT_MARGIN + (LONG) ((Workload->Rows - 2) * CELL_HEIGHT)
+                );
+            if (Rect.Bottom > Rect.Top)
+            {
+                MovePixels(FrameBuffer, Pitch, &Rect, 0, -CELL_HEIGHT);
+                SetMove(Frame, &Rect, 0, -CELL_HEIGHT);
+                LJB_VMON_DamageAddRect(&Frame->Damage, &Rect);
+            }
+
+            Rect.Top = Rect.Bottom;
+            Rect.Bottom += 2 * CELL_HEIGHT;
+            FillPixels(Workload, FrameBuffer, Pitch, &Rect, COLOR_PAPER);
+            DrawGlyphs(
+                Workload,
+                FrameBuffer,
+                Pitch,
+                Workload->Client.Left + TEXT_MARGIN,
+                Rect.Top,
+                Text,
+                Length,
+                &Rect,
+                COLOR_TEXT
+                );
+            LJB_VMON_DamageAddRect(&Frame->Damage, &Rect);
+        }
+        else
+        {
+            MakeRect(&Rect, Caret.Left - (LONG) (Length * CELL_WIDTH), Caret.Top,
+                Workload->Client.Right, Caret.Bottom);
+            FillPixels(Workload, FrameBuffer, Pitch, &Rect, COLOR_PAPER);
+            LJB_VMON_DamageAddRect(&Frame->Damage, &Rect);
+        }
+        Workload->NextKey = 20 + WorkloadRandom(Workload) % 40;
+    }
+
+    CaretRect(Workload, &Caret);
+    FillPixels(Workload, FrameBuffer, Pitch, &Caret, COLOR_TEXT);
+    LJB_VMON_DamageAddRect(&Frame->Damage, &Caret);
+}
+
+/*
+ * Move the window by its velocity, bouncing off the desktop edges, and
+ * repaint the wallpaper it uncovered.
+ */
+static VOID
+DragFrame(
+    __inout LJB_VMON_WORKLOAD *     Workload,
+    __inout PVOID                   FrameBuffer,
+    __in UINT                       Pitch,
+    __inout LJB_VMON_WORKLOAD_FRAME * Frame
+    )
+{
+    LONG CONST      DesktopBottom = (LONG) Workload->Height - TASKBAR_HEIGHT;
+    LJB_VMON_RECT   Old = Workload->Window;
+    LJB_VMON_RECT   New;
+    LJB_VMON_RECT   Uncovered[4];
+    UINT            Count;
+    UINT            i;
+
+    if (Old.Left + Workload->VelocityX < 0 ||
+        Old.Right + Workload->VelocityX > (LONG) Workload->Width)
+        Workload->VelocityX = -Workload->VelocityX;
+    if (Old.Top + Workload->VelocityY < 0 ||
+        Old.Bottom + Workload->VelocityY > DesktopBottom)
+        Workload->VelocityY = -Workload->VelocityY;
+
+    New = Old;
+    if (Old.Left + Workload->VelocityX >= 0 &&
+        Old.Right + Workload->VelocityX <= (LONG) Workload->Width)
+    {
+        New.Left += Workload->VelocityX;
+        New.Right += Workload->VelocityX;
+    }
+    if (Old.Top + Workload->VelocityY >= 0 &&
+        Old.Bottom + Workload->VelocityY <= DesktopBottom)
+    {
+        New.Top += Workload->VelocityY;
+        New.Bottom += Workload->VelocityY;
+    }
+    if (New.Left == Old.Left && New.Top == Old.Top)
+        return;
+
+    MovePixels(FrameBuffer, Pitch, &New, New.Left - Old.Left, New.Top - Old.Top);
+    SetMove(Frame, &New, New.Left - Old.Left, New.Top - Old.Top);
+    Count = RectSubtract(&Old, &New, Uncovered);
+    for (i = 0; i < Count; i++)
+        PaintDesktop(Workload, FrameBuffer, Pitch, &Uncovered[i]);
+    SetWindow(Workload, New.Left, New.Top, New.Right, New.Bottom);
+
+    LJB_VMON_DamageAddRect(&Frame->Damage, &Old);
+    LJB_VMON_DamageAddRect(&Frame->Damage, &New);
+}
+
+/*
+ * A flick: fast at first, slowing down to a stop, then a pause.
+ */
+static VOID
+ScrollFrame(
+    __inout LJB_VMON_WORKLOAD *     Workload,
+    __inout PVOID                   FrameBuffer,
+    __in UINT                       Pitch,
+    __inout LJB_VMON_WORKLOAD_FRAME * Frame
+    )
+{
+    UINT CONST      Phase = Workload->FrameIndex % SCROLL_FRAMES;
+    LONG CONST      ClientHeight = Workload->Client.Bottom - Workload->Client.Top;
+    LJB_VMON_RECT   Rect;
+    LONG            Step;
+
+    if (Phase == 0 || Phase > SCROLL_FRAMES / 2 || ClientHeight <= 0)
+        return;
+
+    Step = (SCROLL_FRAMES / 2 + 3 - (LONG) Phase) / 3;
+    Workload->ScrollY += (UINT) Step;
+    if (Step < ClientHeight)
+    {
+        MakeRect(
+            &Rect,
+            Workload->Client.Left,
+            Workload->Client.Top,
+            Workload->Client.Right,
+            Workload->Client.Bottom - Step
+            );
+        MovePixels(FrameBuffer, Pitch, &Rect, 0, -Step);
+        SetMove(Frame, &Rect, 0, -Step);
+        PaintDocument(Workload, FrameBuffer, Pitch, Rect.Bottom, Workload->Client.Bottom);
+    }
+    else
+    {
+        PaintDocument(Workload, FrameBuffer, Pitch, Workload->Client.Top, Workload->Client.Bottom);
+    }
+    LJB_VMON_DamageAddRect(&Frame->Damage, &Workload->Client);
+}
+
+/*
+ * Smooth moving color fields with sensor noise, new every other present.
+ */
+static VOID
+VideoFrame(
+    __inout LJB_VMON_WORKLOAD *     Workload,
+    __inout PVOID                   FrameBuffer,
+    __in UINT                       Pitch,
+    __inout LJB_VMON_WORKLOAD_FRAME * Frame
+    )
+{
+    UCHAR CONST *   Sine = Workload->Sine;
+    UINT CONST      t = Workload->FrameIndex / 2;
+    LJB_VMON_RECT   Clip = Workload->Client;
+    ULONG *         Row;
+    UINT            a, b, c;
+    UINT            Noise;
+    LONG            x, y;
+
+    if ((Workload->FrameIndex & 1) != 0 || !RectClip(Workload, &Clip))
+        return;
+
+    for (y = Clip.Top; y < Clip.Bottom; y++)
+    {
+        Row = PixelAt(FrameBuffer, Pitch, 0, y);
+        b = Sine[((UINT) (y - Clip.Top) / 3 - t) & 255];
+        for (x = Clip.Left; x < Clip.Right; x++)
+        {
+            a = Sine[((UINT) (x - Clip.Left) / 4 + t * 2) & 255];
+            c = Sine[((UINT) (x - Clip.Left + y - Clip.Top) / 6 + t) & 255];
+            Noise = WorkloadRandom(Workload) & 0x0F;
+            Row[x] =
+                ((((a + b) >> 1) * 7 / 8 + Noise) << 16) |
+                ((((b + c) >> 1) * 7 / 8 + Noise) << 8) |
+                (((a + c) >> 1) * 7 / 8 + Noise);
+        }
+    }
+    LJB_VMON_DamageAddRect(&Frame->Damage, &Clip);
+}
+
+/*
+ * Row y of picture Slide: a gradient between four corner colors, a few
+ * translucent discs, and fine grain.
+ */
+static VOID
+SlideRow(
+    __in CONST LJB_VMON_WORKLOAD *  Workload,
+    __in UINT                       Slide,
+    __in UINT                       y,
+    __out ULONG *                   Row
+    )
+{
+    UINT32 CONST    Key = Mix(Workload->Seed ^ (Slide * 0x85EBCA77));
+    LONG            Value[3];
+    LONG            Step[3];
+    UINT32          Corner[4];
+    UINT32          Disc;
+    UINT            Grain;
+    UINT            Half;
+    LONG            Dy;
+    LONG            Cx, Cy, Radius;
+    LONG            x, x0, x1;
+    UINT            i, k;
+
+    for (i = 0; i < 4; i++)
+        Corner[i] = Mix(Key + i);
+
+    /*
+     * 16.16 fixed point channels, interpolated down the edges and across
+     */
+    for (k = 0; k < 3; k++)
+    {
+        LONG CONST  TopLeft = (LONG) ((Corner[0] >> (k * 8)) & 0xFF);
+        LONG CONST  TopRight = (LONG) ((Corner[1] >> (k * 8)) & 0xFF);
+        LONG CONST  BottomLeft = (LONG) ((Corner[2] >> (k * 8)) & 0xFF);
+        LONG CONST  BottomRight = (LONG) ((Corner[3] >> (k * 8)) & 0xFF);
+        LONG        Left;
+        LONG        Right;
+
+        Left = (TopLeft << 16) + (BottomLeft - TopLeft) * 65536 / (LONG) Workload->Height * (LONG) y;
+        Right = (TopRight << 16) + (BottomRight - TopRight) * 65536 / (LONG) Workload->Height * (LONG) y;
+        Value[k] = Left;
+        Step[k] = (Right - Left) / (LONG) Workload->Width;
+    }
+    for (x = 0; x < (LONG) Workload->Width; x++)
+    {
+        Grain = (((UINT32) x * 0x9E3779B1u) ^ ((UINT32) y * 0x85EBCA77u) ^ Key) >> 29;
+        Row[x] =
+            ((((ULONG) Value[2] >> 16) & 0xFF) * 7 / 8 + Grain) << 16 |
+            ((((ULONG) Value[1] >> 16) & 0xFF) * 7 / 8 + Grain) << 8 |
+            ((((ULONG) Value[0] >> 16) & 0xFF) * 7 / 8 + Grain);
+        for (k = 0; k < 3; k++)
+            Value[k] += Step[k];
+    }
+
+    for (i = 0; i < SLIDE_CIRCLES; i++)
+    {
+        Disc = Mix(Key ^ (0x1000 + i));
+        Cx = (LONG) ((Disc & 0xFFFF) % Workload->Width);
+        Cy = (LONG) ((Disc >> 16) % Workload->Height);
+        Disc = Mix(Disc);
+        Radius = (LONG) (Workload->Height / 16 + Disc % (Workload->Height / 4 + 1));
+        Dy = (LONG) y - Cy;
+        if (Dy <= -Radius || Dy >= Radius)
+            continue;
+
+        Half = IntSqrt((UINT) (Radius * Radius - Dy * Dy));
+        x0 = Cx - (LONG) Half;
+        x1 = Cx + (LONG) Half;
+        if (x0 < 0)
+            x0 = 0;
+        if (x1 > (LONG) Workload->Width)
+            x1 = (LONG) Workload->Width;
+        for (x = x0; x < x1; x++)
+            Row[x] = ((Row[x] >> 1) & 0x007F7F7F) + ((Disc >> 8) & 0x007F7F7F);
+    }
+}
+
+/*
+ * A new picture every SLIDE_FRAMES presents, faded in over FADE_FRAMES.
+ */
+static VOID
+SlideshowFrame(
+    __inout LJB_VMON_WORKLOAD *     Workload,
+    __inout PVOID                   FrameBuffer,
+    __in UINT                       Pitch,
+    __inout LJB_VMON_WORKLOAD_FRAME * Frame
+    )
+{
+    UINT CONST  Phase = Workload->FrameIndex % SLIDE_FRAMES;
+    UINT        Remaining;
+    ULONG *     Row;
+    ULONG       Old, New;
+    UINT        Blend;
+    UINT        x, y, k;
+
+    if (Workload->FrameIndex < SLIDE_FRAMES || Phase >= FADE_FRAMES ||
+        Workload->RowBuffer == NULL)
+        return;
+
+    /*
+     * each step covers 1/Remaining of the way left, so the last one lands
+     * exactly on the new picture
+     */
+    Workload->Slide = Workload->FrameIndex / SLIDE_FRAMES;
+    Remaining = FADE_FRAMES - Phase;
+    for (y = 0; y < Workload->Height; y++)
+    {
+        Row = PixelAt(FrameBuffer, Pitch, 0, (LONG) y);
+        SlideRow(Workload, Workload->Slide, y, Workload->RowBuffer);
+        if (Remaining == 1)
+        {
+            RtlCopyMemory(Row, Workload->RowBuffer, Workload->Width * 4);
+            continue;
+        }
+        for (x = 0; x < Workload->Width; x++)
+        {
+            Old = Row[x];
+            New = Workload->RowBuffer[x];
+            Blend = 0;
+            for (k = 0; k < 24; k += 8)
+            {
+                INT CONST   From = (INT) ((Old >> k) & 0xFF);
+                INT CONST   To = (INT) ((New >> k) & 0xFF);
+
+                Blend |= (UINT) (From + (To - From) / (INT) Remaining) << k;
+            }
+            Row[x] = Blend;
+        }
+    }
+    LJB_VMON_DamageSetFull(&Frame->Damage, Workload->Width, Workload->Height);
+}
+
+/*
+ * The first frame of every workload, reported as damaged as a whole.
+ */
+static VOID
+FirstFrame(
+    __inout LJB_VMON_WORKLOAD *     Workload,
+    __inout PVOID                   FrameBuffer,
+    __in UINT                       Pitch,
+    __inout LJB_VMON_WORKLOAD_FRAME * Frame
+    )
+{
+    LJB_VMON_RECT   Rect;
+    LJB_VMON_RECT   Caret;
+    UINT            Row;
+
+    MakeRect(&Rect, 0, 0, (LONG) Workload->Width, (LONG) Workload->Height);
+    PaintDesktop(Workload, FrameBuffer, Pitch, &Rect);
+    LJB_VMON_DamageSetFull(&Frame->Damage, Workload->Width, Workload->Height);
+
+    switch (Workload->Kind)
+    {
+    case LJB_VMON_WORKLOAD_IDLE:
+    case LJB_VMON_WORKLOAD_TYPING:
+    case LJB_VMON_WORKLOAD_DRAG:
+    case LJB_VMON_WORKLOAD_SCROLL:
+        PaintWindowFrame(Workload, FrameBuffer, Pitch);
+        PaintDocument(Workload, FrameBuffer, Pitch, Workload->Client.Top, Workload->Client.Bottom);
+        break;
+
+    case LJB_VMON_WORKLOAD_VIDEO:
+        PaintWindowFrame(Workload, FrameBuffer, Pitch);
+        VideoFrame(Workload, FrameBuffer, Pitch, Frame);
+        break;
+
+    case LJB_VMON_WORKLOAD_SLIDESHOW:
+        Workload->Slide = 0;
+        for (Row = 0; Row < Workload->Height && Workload->RowBuffer != NULL; Row++)
+        {
+            SlideRow(Workload, 0, Row, Workload->RowBuffer);
+            RtlCopyMemory(
+                PixelAt(FrameBuffer, Pitch, 0, (LONG) Row),
+                Workload->RowBuffer,
+                Workload->Width * 4
+                );
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    if (Workload->Kind == LJB_VMON_WORKLOAD_TYPING && Workload->Rows != 0)
+    {
+        /*
+         * the document shows up to the line being typed, which starts empty
+         */
+        MakeRect(
+            &Rect,
+            Workload->Client.Left,
+            Workload->Client.Top + TEXT_MARGIN + (LONG) (Workload->Row * CELL_HEIGHT),
+            Workload->Client.Right,
+            Workload->Client.Bottom
+            );
+        FillPixels(Workload, FrameBuffer, Pitch, &Rect, COLOR_PAPER);
+    }
+    if ((Workload->Kind == LJB_VMON_WORKLOAD_IDLE ||
+         Workload->Kind == LJB_VMON_WORKLOAD_TYPING) && Workload->Rows != 0)
+    {
+        CaretRect(Workload, &Caret);
+        FillPixels(Workload, FrameBuffer, Pitch, &Caret, COLOR_TEXT);
+        Workload->CaretOn = TRUE;
+    }
+}
+
+/*
+ * Name:  LJB_VMON_WorkloadInit
+ *
+ * Definition:
+ *    BOOLEAN
+ *    LJB_VMON_WorkloadInit(
+ *        __out LJB_VMON_WORKLOAD *     Workload,
+ *        __in LJB_VMON_WORKLOAD_KIND   Kind,
+ *        __in UINT                     Width,
+ *        __in UINT                     Height,
+ *        __in ULONG                    Seed
+ *        );
+ *
+ * Description:
+ *    Set up a Width x Height workload. Nothing is painted until the first
+ *    LJB_VMON_WorkloadNextFrame.
+ *
+ * Return Value:
+ *    FALSE if Kind is unknown, the size is zero or out of memory.
+ *
+ */
+BOOLEAN
+LJB_VMON_WorkloadInit(
+    __out LJB_VMON_WORKLOAD *               Workload,
+    __in LJB_VMON_WORKLOAD_KIND             Kind,
+    __in UINT                               Width,
+    __in UINT                               Height,
+    __in ULONG                              Seed
+    )
+{
+    CHAR    Text[MAX_COLUMNS];
+    LONG    DesktopBottom;
+    LONG    w, h;
+    UINT    i, Half;
+
+    RtlZeroMemory(Workload, sizeof(*Workload));
+    if ((UINT) Kind >= LJB_VMON_WORKLOAD_COUNT || Width == 0 || Height == 0)
+        return FALSE;
+
+    Workload->Kind = Kind;
+    Workload->Width = Width;
+    Workload->Height = Height;
+    Workload->Seed = Seed;
+    Workload->Random = Mix(Seed ^ 0xA5A5A5A5);
+    if (Workload->Random == 0)
+        Workload->Random = 1;
+
+    /*
+     * a parabola per half period is close enough to a sine for this
+     */
+    for (i = 0; i < 256; i++)
+    {
+        Half = i & 127;
+        Half = Half * (128 - Half) * 127 / 4096;
+        Workload->Sine[i] = (UCHAR) (i < 128 ? 128 + Half : 128 - Half);
+    }
+
+    DesktopBottom = (LONG) Height - TASKBAR_HEIGHT;
+    if (DesktopBottom < 0)
+        DesktopBottom = 0;
+    switch (Kind)
+    {
+    case LJB_VMON_WORKLOAD_IDLE:
+    case LJB_VMON_WORKLOAD_TYPING:
+        SetWindow(
+            Workload,
+            (LONG) Width / 8,
+            DesktopBottom / 12,
+            (LONG) Width - (LONG) Width / 8,
+            DesktopBottom - DesktopBottom / 12
+            );
+        if (Kind == LJB_VMON_WORKLOAD_IDLE)
+        {
+            Workload->Row = Workload->Rows / 2;
+            Workload->Column = DocumentLine(Workload, Workload->Row, Text);
+        }
+        else
+        {
+            Workload->Row = Workload->Rows / 2;
+            Workload->Line = Workload->Row;
+        }
+        break;
+
+    case LJB_VMON_WORKLOAD_DRAG:
+        w = (LONG) Width * 2 / 5;
+        h = DesktopBottom * 2 / 5;
+        SetWindow(Workload, (LONG) Width / 16, DesktopBottom / 16,
+            (LONG) Width / 16 + w, DesktopBottom / 16 + h);
+        Workload->VelocityX = (INT) Width / 240 + 1;
+        Workload->VelocityY = (INT) Height / 270 + 1;
+        break;
+
+    case LJB_VMON_WORKLOAD_SCROLL:
+        SetWindow(Workload, 0, 0, (LONG) Width, DesktopBottom);
+        break;
+
+    case LJB_VMON_WORKLOAD_VIDEO:
+        w = (LONG) Width / 2;
+        h = w * 9 / 16 + TITLE_HEIGHT + 2;
+        if (h > DesktopBottom)
+            h = DesktopBottom;
+        SetWindow(Workload, (LONG) Width / 5, DesktopBottom / 6,
+            (LONG) Width / 5 + w, DesktopBottom / 6 + h);
+        break;
+
+    case LJB_VMON_WORKLOAD_SLIDESHOW:
+        Workload->RowBuffer = HeapAlloc(GetProcessHeap(), 0, (SIZE_T) Width * 4);
+        if (Workload->RowBuffer == NULL)
+            return FALSE;
+        break;
+
+    default:
+        break;
+    }
+    return TRUE;
+}
+
+/*
+ * Name:  LJB_VMON_WorkloadDeInit
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_WorkloadDeInit(
+ *        __inout LJB_VMON_WORKLOAD *   Workload
+ *        );
+ *
+ * Description:
+ *    Free what LJB_VMON_WorkloadInit allocated.
+ *
+ * Return Value:
+ *    None.
+ *
+ */
+VOID
+LJB_VMON_WorkloadDeInit(
+    __inout LJB_VMON_WORKLOAD *             Workload
+    )
+{
+    if (Workload->RowBuffer != NULL)
+        HeapFree(GetProcessHeap(), 0, Workload->RowBuffer);
+    RtlZeroMemory(Workload, sizeof(*Workload));
+}
+
+/*
+ * Name:  LJB_VMON_WorkloadNextFrame
+ *
+ * Definition:
+ *    VOID
+ *    LJB_VMON_WorkloadNextFrame(
+ *        __inout LJB_VMON_WORKLOAD *       Workload,
+ *        __inout PVOID                     FrameBuffer,
+ *        __in UINT                         Pitch,
+ *        __out LJB_VMON_WORKLOAD_FRAME *   Frame
+ *        );
+ *
+ * Description:
+ *    Paint the next present into FrameBuffer, which must still hold the
+ *    frame the previous call painted: only what changed is touched. The
+ *    first call paints everything.
+ *
+ * Return Value:
+ *    None. Frame->Damage is empty if the present changed nothing.
+ *
+ */
+VOID
+LJB_VMON_WorkloadNextFrame(
+    __inout LJB_VMON_WORKLOAD *             Workload,
+    __inout PVOID                           FrameBuffer,
+    __in UINT                               Pitch,
+    __out LJB_VMON_WORKLOAD_FRAME *         Frame
+    )
+{
+    RtlZeroMemory(Frame, sizeof(*Frame));
+    Frame->FrameIndex = Workload->FrameIndex;
+
+    if (Workload->FrameIndex == 0)
+    {
+        FirstFrame(Workload, FrameBuffer, Pitch, Frame);
+    }
+    else
+    {
+        switch (Workload->Kind)
+        {
+        case LJB_VMON_WORKLOAD_IDLE:
+            IdleFrame(Workload, FrameBuffer, Pitch, Frame);
+            break;
+
+        case LJB_VMON_WORKLOAD_TYPING:
+            TypingFrame(Workload, FrameBuffer, Pitch, Frame);
+            break;
+
+        case LJB_VMON_WORKLOAD_DRAG:
+            DragFrame(Workload, FrameBuffer, Pitch, Frame);
+            break;
+
+        case LJB_VMON_WORKLOAD_SCROLL:
+            ScrollFrame(Workload, FrameBuffer, Pitch, Frame);
+            break;
+
+        case LJB_VMON_WORKLOAD_VIDEO:
+            VideoFrame(Workload, FrameBuffer, Pitch, Frame);
+            break;
+
+        case LJB_VMON_WORKLOAD_SLIDESHOW:
+            SlideshowFrame(Workload, FrameBuffer, Pitch, Frame);
+            break;
+
+        default:
+            break;
+        }
+    }
+    Workload->FrameIndex++;
+}
+
+CONST CHAR *
+LJB_VMON_WorkloadName(
+    __in LJB_VMON_WORKLOAD_KIND             Kind
+    )
+{
+    if ((UINT) Kind >= LJB_VMON_WORKLOAD_COUNT)
+        return "unknown";
+    return WorkloadNames[Kind];
+}
+
+BOOLEAN
+LJB_VMON_WorkloadFromName(
+    __in CONST CHAR *                       Name,
+    __out LJB_VMON_WORKLOAD_KIND *          Kind
+    )
+{
+    UINT    i;
+
+    for (i = 0; i < LJB_VMON_WORKLOAD_COUNT; i++)
+    {
+        if (strcmp(Name, WorkloadNames[i]) == 0)
+        {
+            *Kind = (LJB_VMON_WORKLOAD_KIND) i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
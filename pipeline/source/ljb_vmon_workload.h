@@ -0,0 +1,115 @@
+/*!
+    \file       ljb_vmon_workload.h
+    \brief      Deterministic synthetic desktop frame streams
+    \details    Stands in for a live desktop behind hPrimarySurface when
+                codecs, damage tracking or transports are measured. Each
+                workload paints one 32bpp BGRA frame per 60 Hz present into a
+                caller-owned frame buffer and reports what it changed, and
+                where content only moved, what moved. The same kind, size
+                and seed always give the same frames, on Windows and on the
+                host build alike.
+ */
+
+#ifndef _LJB_VMON_WORKLOAD_H_
+#define _LJB_VMON_WORKLOAD_H_
+
+#include <windows.h>
+#include "ljb_vmon_damage.h"
+
+typedef enum _LJB_VMON_WORKLOAD_KIND
+{
+    LJB_VMON_WORKLOAD_IDLE = 0,     // editor with a blinking caret
+    LJB_VMON_WORKLOAD_TYPING,       // typing into the editor, scrolling at the bottom
+    LJB_VMON_WORKLOAD_DRAG,         // a window dragged across the desktop
+    LJB_VMON_WORKLOAD_SCROLL,       // maximized text window, flick scrolling
+    LJB_VMON_WORKLOAD_VIDEO,        // 30 fps video playing in a window
+    LJB_VMON_WORKLOAD_SLIDESHOW,    // full screen pictures, cross faded
+    LJB_VMON_WORKLOAD_COUNT
+} LJB_VMON_WORKLOAD_KIND;
+
+/*
+ * What one LJB_VMON_WorkloadNextFrame changed. Damage covers every pixel that
+ * differs from the previous frame. When HasMove is set, the pixels of MoveRect
+ * are those of MoveRect offset by (-MoveDx, -MoveDy) in the previous frame,
+ * i.e. a COPY_RECT would reproduce them; MoveRect is inside Damage.
+ */
+typedef struct _LJB_VMON_WORKLOAD_FRAME
+{
+    ULONG               FrameIndex;
+    LJB_VMON_DAMAGE     Damage;
+    BOOLEAN             HasMove;
+    LJB_VMON_RECT       MoveRect;
+    INT                 MoveDx;
+    INT                 MoveDy;
+} LJB_VMON_WORKLOAD_FRAME;
+
+typedef struct _LJB_VMON_WORKLOAD
+{
+    LJB_VMON_WORKLOAD_KIND  Kind;
+    UINT                    Width;
+    UINT                    Height;
+    ULONG                   Seed;
+    ULONG                   FrameIndex;
+    UINT32                  Random;
+    ULONG *                 RowBuffer;      // one row, Width pixels
+
+    /*
+     * the application window and its client area
+     */
+    LJB_VMON_RECT           Window;
+    LJB_VMON_RECT           Client;
+    INT                     VelocityX;
+    INT                     VelocityY;
+
+    /*
+     * text grid of Client, and the text cursor in it
+     */
+    UINT                    Columns;
+    UINT                    Rows;
+    UINT                    Column;
+    UINT                    Row;
+    UINT                    Line;           // document line typed at Row
+    UINT                    NextKey;        // frames until the next key stroke
+    BOOLEAN                 CaretOn;
+
+    UINT                    ScrollY;        // document pixels above Client
+    UINT                    Slide;
+    UCHAR                   Sine[256];      // one period, 0..255
+} LJB_VMON_WORKLOAD;
+
+__checkReturn
+BOOLEAN
+LJB_VMON_WorkloadInit(
+    __out LJB_VMON_WORKLOAD *               Workload,
+    __in LJB_VMON_WORKLOAD_KIND             Kind,
+    __in UINT                               Width,
+    __in UINT                               Height,
+    __in ULONG                              Seed
+    );
+
+VOID
+LJB_VMON_WorkloadDeInit(
+    __inout LJB_VMON_WORKLOAD *             Workload
+    );
+
+VOID
+LJB_VMON_WorkloadNextFrame(
+    __inout LJB_VMON_WORKLOAD *             Workload,
+    __inout PVOID                           FrameBuffer,
+    __in UINT                               Pitch,
+    __out LJB_VMON_WORKLOAD_FRAME *         Frame
+    );
+
+CONST CHAR *
+LJB_VMON_WorkloadName(
+    __in LJB_VMON_WORKLOAD_KIND             Kind
+    );
+
+__checkReturn
+BOOLEAN
+LJB_VMON_WorkloadFromName(
+    __in CONST CHAR *                       Name,
+    __out LJB_VMON_WORKLOAD_KIND *          Kind
+    );
+
+#endif /* _LJB_VMON_WORKLOAD_H_ */